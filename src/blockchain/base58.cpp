@@ -0,0 +1,90 @@
+// RecoverySoftNetz — Bitcoin base58 / base58check
+
+#include "blockchain/base58.h"
+
+#include "common/crypto.h"
+
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+// Digit value per ASCII byte, -1 outside the alphabet.
+struct Base58Table
+{
+  int8_t value[256];
+
+  Base58Table()
+  {
+    static const char ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    std::memset(value, -1, sizeof(value));
+    for (int i = 0; i < 58; ++i)
+    {
+      value[static_cast<uint8_t>(ALPHABET[i])] = static_cast<int8_t>(i);
+    }
+  }
+};
+
+const Base58Table BASE58;
+
+}  // namespace
+
+bool base58Decode(const char* text, size_t length, std::vector<uint8_t>& out)
+{
+  size_t zeros = 0;
+  while (zeros < length && text[zeros] == '1')
+  {
+    ++zeros;
+  }
+  // log(58) / log(256) ~= 0.733; big-endian accumulator.
+  std::vector<uint8_t> acc((length - zeros) * 733 / 1000 + 1, 0);
+  for (size_t i = zeros; i < length; ++i)
+  {
+    int digit = BASE58.value[static_cast<uint8_t>(text[i])];
+    if (digit < 0)
+    {
+      return false;
+    }
+    uint32_t carry = static_cast<uint32_t>(digit);
+    for (size_t j = acc.size(); j-- > 0;)
+    {
+      carry += 58u * acc[j];
+      acc[j] = static_cast<uint8_t>(carry);
+      carry >>= 8;
+    }
+    if (carry != 0)
+    {
+      return false;
+    }
+  }
+  size_t skip = 0;
+  while (skip < acc.size() && acc[skip] == 0)
+  {
+    ++skip;
+  }
+  out.assign(zeros, 0);
+  out.insert(out.end(), acc.begin() + static_cast<std::ptrdiff_t>(skip), acc.end());
+  return true;
+}
+
+bool base58CheckDecode(const char* text, size_t length, std::vector<uint8_t>& payload)
+{
+  if (!base58Decode(text, length, payload) || payload.size() < 4)
+  {
+    return false;
+  }
+  size_t body = payload.size() - 4;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256d(payload.data(), body, digest);
+  if (std::memcmp(digest, payload.data() + body, 4) != 0)
+  {
+    return false;
+  }
+  payload.resize(body);
+  return true;
+}
+
+}  // namespace rsn
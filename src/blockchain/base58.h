@@ -0,0 +1,18 @@
+// RecoverySoftNetz — Bitcoin base58 / base58check
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+/// Decode Bitcoin-alphabet base58. Returns false on an invalid character.
+bool base58Decode(const char* text, size_t length, std::vector<uint8_t>& out);
+
+/// Decode and verify the 4-byte double-SHA256 checksum; `payload` excludes it.
+bool base58CheckDecode(const char* text, size_t length, std::vector<uint8_t>& payload);
+
+}  // namespace rsn
@@ -0,0 +1,236 @@
+// RecoverySoftNetz — BIP39 wordlists with perfect-hash lookup
+
+#include "blockchain/bip39_wordlist.h"
+
+#include "common/crypto.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint64_t DISPLACE_STEP = 0x9e3779b97f4a7c15ull;
+constexpr uint32_t MAX_DISPLACEMENT = 1u << 20;
+
+inline uint64_t mix64(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+inline uint64_t packPrefix(const uint8_t* p, size_t n)
+{
+  uint64_t v = 0;
+  std::memcpy(&v, p, n < 8 ? n : 8);
+  return v;
+}
+
+inline uint64_t wordHash(const uint8_t* p, size_t n)
+{
+  uint64_t h = mix64(packPrefix(p, n) ^ (static_cast<uint64_t>(n) << 56));
+  for (size_t i = 8; i < n; i += 8)
+  {
+    h = mix64(h ^ packPrefix(p + i, n - i));
+  }
+  return h;
+}
+
+inline uint64_t nextPow2(uint64_t v)
+{
+  uint64_t p = 1;
+  while (p < v)
+  {
+    p <<= 1;
+  }
+  return p;
+}
+
+}  // namespace
+
+const Bip39Wordlist& Bip39Wordlist::english()
+{
+  static const std::unique_ptr<Bip39Wordlist> list = []() {
+    std::vector<std::string> words(BIP39_ENGLISH, BIP39_ENGLISH + BIP39_WORD_COUNT);
+    return fromWords("english", words);
+  }();
+  return *list;
+}
+
+std::unique_ptr<Bip39Wordlist> Bip39Wordlist::fromWords(const std::string& name,
+                                                        const std::vector<std::string>& words)
+{
+  if (words.size() != BIP39_WORD_COUNT)
+  {
+    return nullptr;
+  }
+  std::unique_ptr<Bip39Wordlist> list(new Bip39Wordlist());
+  list->name_ = name;
+  list->words_ = words;
+  for (const auto& w : list->words_)
+  {
+    if (w.empty() || w.size() > BIP39_MAX_WORD_BYTES)
+    {
+      return nullptr;
+    }
+  }
+  if (!list->build())
+  {
+    return nullptr;
+  }
+  return list;
+}
+
+std::unique_ptr<Bip39Wordlist> Bip39Wordlist::fromFile(const std::string& name,
+                                                       const std::string& path)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    return nullptr;
+  }
+  std::vector<std::string> words;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+    {
+      line.pop_back();
+    }
+    if (!line.empty())
+    {
+      words.push_back(line);
+    }
+  }
+  return fromWords(name, words);
+}
+
+bool Bip39Wordlist::build()
+{
+  // Hash and displace: bucket keys by one hash half, then find per bucket a
+  // displacement that drops every key of the bucket into a free slot.
+  size_t n = words_.size();
+  size_t bucket_count = nextPow2(n / 4);
+  size_t slot_count = nextPow2(n * 2);
+  bucket_mask_ = bucket_count - 1;
+  slot_mask_ = slot_count - 1;
+  displacement_.assign(bucket_count, 0);
+  slots_.assign(slot_count, Slot());
+
+  std::vector<uint64_t> hashes(n);
+  std::vector<std::vector<uint16_t>> buckets(bucket_count);
+  for (size_t i = 0; i < n; ++i)
+  {
+    const auto* w = reinterpret_cast<const uint8_t*>(words_[i].data());
+    hashes[i] = wordHash(w, words_[i].size());
+    buckets[(hashes[i] >> 32) & bucket_mask_].push_back(static_cast<uint16_t>(i));
+  }
+  std::vector<size_t> order(bucket_count);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+  std::vector<size_t> trial;
+  for (size_t b : order)
+  {
+    const auto& keys = buckets[b];
+    if (keys.empty())
+    {
+      break;
+    }
+    bool placed = false;
+    for (uint32_t d = 0; d < MAX_DISPLACEMENT && !placed; ++d)
+    {
+      trial.clear();
+      placed = true;
+      for (uint16_t k : keys)
+      {
+        size_t s = mix64(hashes[k] + d * DISPLACE_STEP) & slot_mask_;
+        if (slots_[s].used || std::find(trial.begin(), trial.end(), s) != trial.end())
+        {
+          placed = false;
+          break;
+        }
+        trial.push_back(s);
+      }
+      if (placed)
+      {
+        displacement_[b] = d;
+        for (size_t j = 0; j < keys.size(); ++j)
+        {
+          const std::string& w = words_[keys[j]];
+          Slot& slot = slots_[trial[j]];
+          slot.key = packPrefix(reinterpret_cast<const uint8_t*>(w.data()), w.size());
+          slot.length = static_cast<uint16_t>(w.size());
+          slot.index = keys[j];
+          slot.used = true;
+        }
+      }
+    }
+    if (!placed)
+    {
+      return false;  // duplicate words
+    }
+  }
+  return true;
+}
+
+int Bip39Wordlist::lookup(const uint8_t* word, size_t length) const
+{
+  if (length == 0 || length > BIP39_MAX_WORD_BYTES)
+  {
+    return -1;
+  }
+  uint64_t h = wordHash(word, length);
+  uint32_t d = displacement_[(h >> 32) & bucket_mask_];
+  const Slot& slot = slots_[mix64(h + d * DISPLACE_STEP) & slot_mask_];
+  if (!slot.used || slot.length != length || slot.key != packPrefix(word, length))
+  {
+    return -1;
+  }
+  if (length > 8 && std::memcmp(words_[slot.index].data() + 8, word + 8, length - 8) != 0)
+  {
+    return -1;
+  }
+  return slot.index;
+}
+
+bool bip39ChecksumValid(const uint16_t* indices, size_t count)
+{
+  if (count < 12 || count > 24 || count % 3 != 0)
+  {
+    return false;
+  }
+  size_t total_bits = count * 11;
+  size_t checksum_bits = count / 3;
+  size_t entropy_bytes = (total_bits - checksum_bits) / 8;
+
+  uint8_t bits[33] = {};
+  size_t pos = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    for (int b = 10; b >= 0; --b, ++pos)
+    {
+      if ((indices[i] >> b) & 1)
+      {
+        bits[pos / 8] |= static_cast<uint8_t>(0x80 >> (pos % 8));
+      }
+    }
+  }
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256(bits, entropy_bytes, digest);
+  uint8_t expected = static_cast<uint8_t>(digest[0] >> (8 - checksum_bits));
+  uint8_t actual = static_cast<uint8_t>(bits[entropy_bytes] >> (8 - checksum_bits));
+  return expected == actual;
+}
+
+}  // namespace rsn
@@ -0,0 +1,67 @@
+// RecoverySoftNetz — BIP39 wordlists with perfect-hash lookup
+//
+// Word lookup is the inner loop of the seed phrase detector, so every list is
+// compiled into a collision-free (hash-and-displace) table: one 64-bit hash,
+// one displacement fetch and one packed-key compare per token, no probing.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+constexpr size_t BIP39_WORD_COUNT = 2048;
+constexpr size_t BIP39_MAX_WORD_BYTES = 32;
+
+extern const char* const BIP39_ENGLISH[BIP39_WORD_COUNT];
+
+class Bip39Wordlist
+{
+public:
+  /// Built-in English list (shared, built on first use).
+  static const Bip39Wordlist& english();
+
+  /// Build from exactly 2048 distinct UTF-8 words; nullptr otherwise.
+  static std::unique_ptr<Bip39Wordlist> fromWords(const std::string& name,
+                                                  const std::vector<std::string>& words);
+
+  /// Load a bip-0039 style text file (one word per line).
+  static std::unique_ptr<Bip39Wordlist> fromFile(const std::string& name,
+                                                 const std::string& path);
+
+  /// Index of a lower-case word, or -1.
+  int lookup(const uint8_t* word, size_t length) const;
+
+  const std::string& word(size_t index) const { return words_[index]; }
+  const std::string& name() const { return name_; }
+
+private:
+  struct Slot
+  {
+    uint64_t key = 0;   // first 8 bytes, zero padded
+    uint16_t length = 0;
+    uint16_t index = 0;
+    bool used = false;
+  };
+
+  Bip39Wordlist() = default;
+  bool build();
+
+  std::string name_;
+  std::vector<std::string> words_;
+  std::vector<uint32_t> displacement_;
+  std::vector<Slot> slots_;
+  uint64_t bucket_mask_ = 0;
+  uint64_t slot_mask_ = 0;
+};
+
+/// True when the 11-bit word indices form a valid BIP39 mnemonic
+/// (12/15/18/21/24 words, SHA-256 checksum bits match).
+bool bip39ChecksumValid(const uint16_t* indices, size_t count);
+
+}  // namespace rsn
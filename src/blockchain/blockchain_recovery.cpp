@@ -0,0 +1,46 @@
+// RecoverySoftNetz — cryptocurrency wallet recovery
+
+#include "blockchain/blockchain_recovery.h"
+
+namespace rsn
+{
+
+void BlockchainRecovery::attach(CarvePipeline& pipeline)
+{
+  pipeline.addStage(wallet_stage_);
+  pipeline.addStage(seed_stage_);
+  pipeline.addStage(key_stage_);
+}
+
+std::vector<RecoveredFile> BlockchainRecovery::scanForWallets(Device& device,
+                                                              FileRegistry& registry)
+{
+  CarvePipeline pipeline(options_);
+  pipeline.addStage(wallet_stage_);
+  pipeline.run(device, registry);
+  return registry.byTypePrefix("wallet/");
+}
+
+std::vector<std::string> BlockchainRecovery::recoverSeedPhrases(Device& device,
+                                                               FileRegistry& registry)
+{
+  CarvePipeline pipeline(options_);
+  pipeline.addStage(seed_stage_);
+  pipeline.run(device, registry);
+  std::vector<std::string> seeds;
+  for (const auto& phrase : seed_stage_.phrases())
+  {
+    seeds.push_back(phrase.text());
+  }
+  return seeds;
+}
+
+std::vector<RecoveredKey> BlockchainRecovery::recoverKeys(Device& device, FileRegistry& registry)
+{
+  CarvePipeline pipeline(options_);
+  pipeline.addStage(key_stage_);
+  pipeline.run(device, registry);
+  return key_stage_.keys();
+}
+
+}  // namespace rsn
@@ -0,0 +1,53 @@
+// RecoverySoftNetz — cryptocurrency wallet recovery
+//
+// Entry point for the blockchain recovery feature. Detection runs as stages of
+// the streaming carve pipeline, so wallets are found in allocated and
+// unallocated space alike and can share one device pass with other stages.
+
+#pragma once
+
+#include "blockchain/key_scanner.h"
+#include "blockchain/seed_phrase_detector.h"
+#include "blockchain/wallet_scanner.h"
+#include "core/carve_pipeline.h"
+
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+class BlockchainRecovery
+{
+public:
+  explicit BlockchainRecovery(PipelineOptions options = PipelineOptions(),
+                              std::vector<const Bip39Wordlist*> wordlists = {})
+    : options_(options), seed_stage_(std::move(wordlists))
+  {
+  }
+
+  /// Add the wallet, seed phrase and key stages to a pipeline that other stages also run on.
+  void attach(CarvePipeline& pipeline);
+
+  /// Standalone scan: one pass over `device` with only the wallet stages.
+  /// Results are added to `registry`; the wallet entries are also returned.
+  std::vector<RecoveredFile> scanForWallets(Device& device, FileRegistry& registry);
+
+  /// Standalone scan for BIP39 mnemonics; returns the checksum-valid phrases.
+  std::vector<std::string> recoverSeedPhrases(Device& device, FileRegistry& registry);
+
+  /// Standalone scan for WIF, extended, hex and DER private keys; returns the valid ones.
+  std::vector<RecoveredKey> recoverKeys(Device& device, FileRegistry& registry);
+
+  const WalletArtifactStage& walletStage() const { return wallet_stage_; }
+  const SeedPhraseStage& seedStage() const { return seed_stage_; }
+  const KeyCandidateStage& keyStage() const { return key_stage_; }
+
+private:
+  PipelineOptions options_;
+  WalletArtifactStage wallet_stage_;
+  SeedPhraseStage seed_stage_;
+  KeyCandidateStage key_stage_;
+};
+
+}  // namespace rsn
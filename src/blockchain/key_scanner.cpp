@@ -0,0 +1,668 @@
+// RecoverySoftNetz — raw private key and extended key candidate scanner
+
+#include "blockchain/key_scanner.h"
+
+#include "blockchain/base58.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t BLOCK = 64;
+constexpr uint64_t NO_RUN = UINT64_MAX;
+constexpr uint64_t UNKNOWN_START = UINT64_MAX - 1;
+
+constexpr size_t WIF_UNCOMPRESSED_CHARS = 51;
+constexpr size_t WIF_COMPRESSED_CHARS = 52;
+constexpr size_t EXTENDED_KEY_CHARS = 111;
+constexpr size_t HEX_KEY_CHARS = 64;
+constexpr size_t DER_MAX_BYTES = 512;
+
+constexpr uint32_t TAG_DER_PRIVATE_KEY = 0;
+
+// secp256k1 group order n.
+const uint8_t SECP256K1_ORDER[32] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+  0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41,
+};
+
+const uint8_t OID_SECP256K1[] = {0x06, 0x05, 0x2b, 0x81, 0x04, 0x00, 0x0a};
+const uint8_t OID_PRIME_FIELD[] = {0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x01, 0x01};
+
+struct ExtendedVersion
+{
+  uint32_t version;
+  bool is_private;
+  bool testnet;
+};
+
+const ExtendedVersion EXTENDED_VERSIONS[] = {
+  {0x0488ade4, true, false},  {0x0488b21e, false, false},  // xprv / xpub
+  {0x04358394, true, true},   {0x043587cf, false, true},   // tprv / tpub
+  {0x049d7878, true, false},  {0x049d7cb2, false, false},  // yprv / ypub
+  {0x04b2430c, true, false},  {0x04b24746, false, false},  // zprv / zpub
+  {0x0295b005, true, false},  {0x0295b43f, false, false},  // Yprv / Ypub
+  {0x02aa7a99, true, false},  {0x02aa7ed3, false, false},  // Zprv / Zpub
+  {0x044a4e28, true, true},   {0x044a5262, false, true},   // uprv / upub
+  {0x045f18bc, true, true},   {0x045f1cf6, false, true},   // vprv / vpub
+  {0x019d9cfe, true, false},  {0x019da462, false, false},  // Ltpv / Ltub
+};
+
+// WIF version bytes: Bitcoin main/test, Litecoin, Dogecoin, Dash.
+bool wifVersion(uint8_t v, bool& testnet)
+{
+  testnet = v == 0xef;
+  return v == 0x80 || v == 0xef || v == 0xb0 || v == 0x9e || v == 0xcc;
+}
+
+bool validScalar(const uint8_t* k)
+{
+  bool zero = std::all_of(k, k + 32, [](uint8_t b) { return b == 0; });
+  return !zero && std::memcmp(k, SECP256K1_ORDER, 32) < 0;
+}
+
+struct ClassMasks
+{
+  uint64_t base58 = 0;
+  uint64_t hex = 0;
+};
+
+struct ClassTable
+{
+  uint8_t bits[256] = {};
+
+  ClassTable()
+  {
+    static const char BASE58[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    static const char HEX[] = "0123456789abcdefABCDEF";
+    for (const char* c = BASE58; *c != 0; ++c)
+    {
+      bits[static_cast<uint8_t>(*c)] |= 1;
+    }
+    for (const char* c = HEX; *c != 0; ++c)
+    {
+      bits[static_cast<uint8_t>(*c)] |= 2;
+    }
+  }
+};
+
+const ClassTable CLASSES;
+
+inline bool isBase58(uint8_t c)
+{
+  return (CLASSES.bits[c] & 1) != 0;
+}
+
+inline bool isHex(uint8_t c)
+{
+  return (CLASSES.bits[c] & 2) != 0;
+}
+
+#if defined(__AVX2__)
+inline __m256i inRange(__m256i v, char lo, char hi)
+{
+  __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+  __m256i span = _mm256_set1_epi8(static_cast<char>(hi - lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(x, span), x);
+}
+
+inline __m256i equals(__m256i v, char c)
+{
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+#endif
+
+ClassMasks classify64(const uint8_t* p)
+{
+  ClassMasks masks;
+#if defined(__AVX2__)
+  for (int half = 0; half < 2; ++half)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * half));
+    __m256i digit = inRange(v, '0', '9');
+    __m256i upper = _mm256_andnot_si256(_mm256_or_si256(equals(v, 'I'), equals(v, 'O')),
+                                        inRange(v, 'A', 'Z'));
+    __m256i lower = _mm256_andnot_si256(equals(v, 'l'), inRange(v, 'a', 'z'));
+    __m256i b58 = _mm256_or_si256(_mm256_andnot_si256(equals(v, '0'), digit),
+                                  _mm256_or_si256(upper, lower));
+    __m256i hex = _mm256_or_si256(digit, inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+                                                 'a', 'f'));
+    int shift = 32 * half;
+    masks.base58 |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(b58)))
+                    << shift;
+    masks.hex |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hex))) << shift;
+  }
+#else
+  for (size_t i = 0; i < BLOCK; ++i)
+  {
+    uint8_t bits = CLASSES.bits[p[i]];
+    masks.base58 |= static_cast<uint64_t>(bits & 1) << i;
+    masks.hex |= static_cast<uint64_t>((bits >> 1) & 1) << i;
+  }
+#endif
+  return masks;
+}
+
+inline int ctz64(uint64_t v)
+{
+  return __builtin_ctzll(v);
+}
+
+inline int clz64(uint64_t v)
+{
+  return __builtin_clzll(v);
+}
+
+// Bits where `len` (power of two) consecutive set bits begin.
+inline uint64_t runStarts(uint64_t m, unsigned len)
+{
+  for (unsigned w = 1; w < len; w <<= 1)
+  {
+    m &= m >> w;
+  }
+  return m;
+}
+
+// Tracks maximal runs of one character class across 64-byte blocks and emits
+// (start, end) device offsets. Runs shorter than 16 that sit entirely inside
+// a block are skipped with a handful of bit operations.
+class RunTracker
+{
+public:
+  template <class Emit>
+  void block(uint64_t m, uint64_t base, Emit&& emit)
+  {
+    int pos = 0;
+    if (start_ != NO_RUN)
+    {
+      if (m == ~0ull)
+      {
+        return;
+      }
+      pos = ctz64(~m);
+      emit(start_, base + static_cast<uint64_t>(pos));
+      start_ = NO_RUN;
+    }
+    uint64_t window = pos < 64 ? ~0ull << pos : 0;
+    uint64_t long_runs = runStarts(m, 16) & window;
+    while (long_runs != 0)
+    {
+      int p = ctz64(long_runs);
+      uint64_t below = ~m & ((1ull << p) - 1) & window;
+      int start = below != 0 ? 64 - clz64(below) : pos;
+      uint64_t ahead = m >> p;
+      if (ahead == (~0ull >> p))
+      {
+        start_ = base + static_cast<uint64_t>(start);  // reaches the block end
+        return;
+      }
+      int end = p + ctz64(~ahead);
+      emit(base + static_cast<uint64_t>(start), base + static_cast<uint64_t>(end));
+      long_runs &= ~0ull << end;
+      pos = end;
+      window = ~0ull << end;
+    }
+    // Short trailing run that may continue into the next block.
+    if ((m >> 63) != 0)
+    {
+      int lead = clz64(~m);
+      int start = 64 - lead;
+      if (start >= pos)
+      {
+        start_ = base + static_cast<uint64_t>(start);
+      }
+    }
+  }
+
+  void continueUnknown() { start_ = UNKNOWN_START; }
+
+private:
+  uint64_t start_ = NO_RUN;
+};
+
+bool hasKeyLabel(const uint8_t* p, size_t n)
+{
+  static const char* const LABELS[] = {"priv", "secret", "key"};
+  for (const char* label : LABELS)
+  {
+    size_t len = std::strlen(label);
+    for (size_t i = 0; i + len <= n; ++i)
+    {
+      size_t j = 0;
+      while (j < len && (p[i + j] | 0x20) == static_cast<uint8_t>(label[j]))
+      {
+        ++j;
+      }
+      if (j == len)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+uint8_t hexValue(uint8_t c)
+{
+  return c <= '9' ? static_cast<uint8_t>(c - '0') : static_cast<uint8_t>((c | 0x20) - 'a' + 10);
+}
+
+bool validateDer(const KeyCandidate& c, RecoveredKey& key)
+{
+  const SecureBytes& d = c.raw;
+  if (d.size() < 2 || d[0] != 0x30)
+  {
+    return false;
+  }
+  size_t header = 2;
+  size_t body = d[1];
+  if (d[1] == 0x81)
+  {
+    header = 3;
+    body = d.size() > 2 ? d[2] : 0;
+  }
+  else if (d[1] == 0x82)
+  {
+    header = 4;
+    body = d.size() > 3 ? loadBE16(d.data() + 2) : 0;
+  }
+  else if (d[1] & 0x80)
+  {
+    return false;
+  }
+  size_t total = header + body;
+  if (total > d.size() || body < 37)
+  {
+    return false;
+  }
+  const uint8_t* p = d.data() + header;
+  static const uint8_t VERSION_AND_OCTETS[] = {0x02, 0x01, 0x01, 0x04, 0x20};
+  if (std::memcmp(p, VERSION_AND_OCTETS, sizeof(VERSION_AND_OCTETS)) != 0 ||
+      !validScalar(p + 5))
+  {
+    return false;
+  }
+
+  ByteView rest(p + 37, body - 37);
+  bool curve = findBytes(rest, OID_SECP256K1, sizeof(OID_SECP256K1)) != SIZE_MAX ||
+               findBytes(rest, OID_PRIME_FIELD, sizeof(OID_PRIME_FIELD)) != SIZE_MAX;
+  // [1] publicKey BIT STRING: a1 LL 03 LL 00 <point>
+  bool has_point = false;
+  for (size_t i = 0; i + 5 < rest.size; ++i)
+  {
+    if (rest[i] == 0xa1 && rest[i + 2] == 0x03 && rest[i + 4] == 0x00)
+    {
+      uint8_t prefix = rest[i + 5];
+      has_point = prefix == 0x02 || prefix == 0x03 || prefix == 0x04;
+      key.compressed = prefix != 0x04;
+      break;
+    }
+  }
+
+  key.kind = KeyKind::Der;
+  key.offset = c.offset;
+  key.length = total;
+  key.key.assign(p + 5, p + 37);
+  key.confidence = curve ? (has_point ? 0.97 : 0.9) : 0.6;
+  return true;
+}
+
+}  // namespace
+
+bool validateKeyCandidate(const KeyCandidate& c, RecoveredKey& key)
+{
+  key = RecoveredKey();
+  key.offset = c.offset;
+  key.length = c.raw.size();
+  std::vector<uint8_t> payload;
+  switch (c.kind)
+  {
+  case KeyKind::Wif:
+  {
+    if (!base58CheckDecode(reinterpret_cast<const char*>(c.raw.data()), c.raw.size(), payload))
+    {
+      return false;
+    }
+    bool compressed = payload.size() == 34 && payload[33] == 0x01;
+    if ((payload.size() != 33 && !compressed) || !wifVersion(payload[0], key.testnet) ||
+        !validScalar(payload.data() + 1))
+    {
+      return false;
+    }
+    key.kind = KeyKind::Wif;
+    key.key.assign(payload.begin() + 1, payload.begin() + 33);
+    key.compressed = compressed;
+    key.confidence = 0.99;
+    return true;
+  }
+  case KeyKind::ExtendedPrivate:
+  case KeyKind::ExtendedPublic:
+  {
+    if (!base58CheckDecode(reinterpret_cast<const char*>(c.raw.data()), c.raw.size(), payload) ||
+        payload.size() != 78)
+    {
+      return false;
+    }
+    uint32_t version = loadBE32(payload.data());
+    for (const auto& v : EXTENDED_VERSIONS)
+    {
+      if (v.version != version)
+      {
+        continue;
+      }
+      const uint8_t* k = payload.data() + 45;
+      bool ok = v.is_private ? k[0] == 0x00 && validScalar(k + 1) : k[0] == 0x02 || k[0] == 0x03;
+      if (!ok)
+      {
+        return false;
+      }
+      key.kind = v.is_private ? KeyKind::ExtendedPrivate : KeyKind::ExtendedPublic;
+      key.key.assign(v.is_private ? k + 1 : k, k + 33);
+      key.testnet = v.testnet;
+      key.compressed = true;
+      key.confidence = 0.99;
+      return true;
+    }
+    return false;
+  }
+  case KeyKind::Hex:
+  {
+    if (c.raw.size() != HEX_KEY_CHARS)
+    {
+      return false;
+    }
+    uint8_t bytes[32];
+    uint32_t seen = 0;
+    for (size_t i = 0; i < 32; ++i)
+    {
+      uint8_t hi = hexValue(c.raw[2 * i]);
+      uint8_t lo = hexValue(c.raw[2 * i + 1]);
+      seen |= (1u << hi) | (1u << lo);
+      bytes[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    int distinct = __builtin_popcount(seen);
+    if (distinct < 10 || !validScalar(bytes))
+    {
+      return false;
+    }
+    key.kind = KeyKind::Hex;
+    key.key.assign(bytes, bytes + 32);
+    return true;
+  }
+  case KeyKind::Der:
+    return validateDer(c, key);
+  }
+  return false;
+}
+
+KeyCandidateStage::~KeyCandidateStage() = default;
+
+void KeyCandidateStage::registerPatterns(PatternSet& patterns)
+{
+  // Called as a run starts: the keys kept are those of one run.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    keys_.clear();
+  }
+  // ECPrivateKey: version INTEGER 1, privateKey OCTET STRING (32).
+  static const uint8_t DER_BODY[] = {0x02, 0x01, 0x01, 0x04, 0x20};
+  patterns.add(DER_BODY, sizeof(DER_BODY), TAG_DER_PRIVATE_KEY);
+}
+
+bool KeyCandidateStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  if (tag != TAG_DER_PRIVATE_KEY)
+  {
+    return false;
+  }
+  uint64_t hit = chunk.offset + pos;
+  if (hit < 2)
+  {
+    return false;
+  }
+  uint64_t head_start = hit >= 4 ? hit - 4 : 0;
+  auto head = ctx.readAt(head_start, static_cast<size_t>(hit - head_start));
+  size_t n = head.size();
+  uint64_t seq = NO_RUN;
+  if (n >= 2 && head[n - 2] == 0x30 && head[n - 1] < 0x80)
+  {
+    seq = hit - 2;
+  }
+  else if (n >= 3 && head[n - 3] == 0x30 && head[n - 2] == 0x81)
+  {
+    seq = hit - 3;
+  }
+  else if (n >= 4 && head[n - 4] == 0x30 && head[n - 3] == 0x82)
+  {
+    seq = hit - 4;
+  }
+  if (seq == NO_RUN)
+  {
+    return false;
+  }
+
+  KeyCandidate candidate;
+  candidate.kind = KeyKind::Der;
+  candidate.offset = seq;
+  size_t rel = static_cast<size_t>(seq - chunk.offset);
+  if (seq >= chunk.offset && rel + DER_MAX_BYTES <= chunk.size)
+  {
+    candidate.raw.assign(chunk.data + rel, chunk.data + rel + DER_MAX_BYTES);
+  }
+  else
+  {
+    candidate.raw = ctx.readAt(seq, DER_MAX_BYTES);
+  }
+  // The structure and scalar range are cheap to check here, which lets the
+  // pipeline judge the signature; registering stays with the workers.
+  RecoveredKey key;
+  if (!validateDer(candidate, key))
+  {
+    return false;
+  }
+  std::vector<KeyCandidate> batch;
+  batch.push_back(std::move(candidate));
+  enqueue(batch, ctx.registry(), false);
+  return true;
+}
+
+void KeyCandidateStage::onChunk(const ChunkView& chunk, CarveContext& ctx)
+{
+  RunTracker base58;
+  RunTracker hex;
+  if (chunk.offset > 0 && chunk.size > 0 && (isBase58(chunk.data[0]) || isHex(chunk.data[0])))
+  {
+    auto prev = ctx.readAt(chunk.offset - 1, 1);
+    if (!prev.empty() && isBase58(prev[0]) && isBase58(chunk.data[0]))
+    {
+      base58.continueUnknown();
+    }
+    if (!prev.empty() && isHex(prev[0]) && isHex(chunk.data[0]))
+    {
+      hex.continueUnknown();
+    }
+  }
+
+  uint64_t own_end = chunk.offset + chunk.body;
+  uint64_t data_end = chunk.offset + chunk.size;
+  bool at_media_end = data_end >= ctx.device().size();
+  std::vector<KeyCandidate> found;
+
+  auto accept = [&](uint64_t start, uint64_t end) {
+    return start < UNKNOWN_START && start < own_end && (end < data_end || at_media_end);
+  };
+  auto copyRun = [&](KeyKind kind, uint64_t start, uint64_t end) {
+    KeyCandidate c;
+    c.kind = kind;
+    c.offset = start;
+    const uint8_t* p = chunk.data + (start - chunk.offset);
+    c.raw.assign(p, p + (end - start));
+    found.push_back(std::move(c));
+  };
+  auto onBase58 = [&](uint64_t start, uint64_t end) {
+    if (!accept(start, end))
+    {
+      return;
+    }
+    size_t len = static_cast<size_t>(end - start);
+    uint8_t first = chunk.data[start - chunk.offset];
+    if ((len == WIF_UNCOMPRESSED_CHARS && (first == '5' || first == '9' || first == '6' ||
+                                           first == '7' || first == 'Q' || first == 'X')) ||
+        (len == WIF_COMPRESSED_CHARS &&
+         (first == 'K' || first == 'L' || first == 'c' || first == 'T' || first == 'X')))
+    {
+      copyRun(KeyKind::Wif, start, end);
+    }
+    else if (len == EXTENDED_KEY_CHARS)
+    {
+      // xprv/tprv/.../Ltpv end their prefix in 'v'; the version bytes decide.
+      const uint8_t* p = chunk.data + (start - chunk.offset);
+      copyRun(p[3] == 'v' ? KeyKind::ExtendedPrivate : KeyKind::ExtendedPublic, start, end);
+    }
+  };
+  auto onHex = [&](uint64_t start, uint64_t end) {
+    if (!accept(start, end) || end - start != HEX_KEY_CHARS)
+    {
+      return;
+    }
+    copyRun(KeyKind::Hex, start, end);
+    size_t rel = static_cast<size_t>(start - chunk.offset);
+    size_t back = std::min<size_t>(rel, 48);
+    if (hasKeyLabel(chunk.data + rel - back, back))
+    {
+      found.back().labelled = true;
+    }
+  };
+
+  size_t full = chunk.size / BLOCK;
+  for (size_t b = 0; b < full; ++b)
+  {
+    ClassMasks m = classify64(chunk.data + b * BLOCK);
+    uint64_t base = chunk.offset + b * BLOCK;
+    base58.block(m.base58, base, onBase58);
+    hex.block(m.hex, base, onHex);
+  }
+  size_t tail = chunk.size - full * BLOCK;
+  uint8_t pad[BLOCK] = {};
+  std::memcpy(pad, chunk.data + full * BLOCK, tail);
+  ClassMasks m = classify64(pad);
+  uint64_t valid = tail == 0 ? 0 : (~0ull >> (64 - tail));
+  uint64_t base = chunk.offset + full * BLOCK;
+  base58.block(m.base58 & valid, base, onBase58);
+  hex.block(m.hex & valid, base, onHex);
+
+  if (!found.empty())
+  {
+    enqueue(found, ctx.registry(), false);
+  }
+}
+
+void KeyCandidateStage::enqueue(std::vector<KeyCandidate>& batch, FileRegistry& registry,
+                                bool force)
+{
+  std::vector<KeyCandidate> ready;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& c : batch)
+    {
+      pending_.push_back(std::move(c));
+    }
+    batch.clear();
+    if (pending_.empty() || (!force && pending_.size() < BATCH_SIZE))
+    {
+      return;
+    }
+    ready.swap(pending_);
+  }
+  std::call_once(pool_once_, [this]() { pool_.reset(new ThreadPool(validation_threads_)); });
+  FileRegistry* reg = &registry;
+  pool_->submit([this, reg, work = std::move(ready)]() mutable {
+    validateBatch(std::move(work), reg);
+  });
+}
+
+void KeyCandidateStage::validateBatch(std::vector<KeyCandidate> batch, FileRegistry* registry)
+{
+  std::vector<RecoveredKey> valid;
+  for (const auto& c : batch)
+  {
+    RecoveredKey key;
+    if (!validateKeyCandidate(c, key))
+    {
+      continue;
+    }
+    if (c.kind == KeyKind::Hex)
+    {
+      key.confidence = c.labelled ? 0.6 : 0.25;
+    }
+
+    RecoveredFile file;
+    file.source = name();
+    file.offset = key.offset;
+    file.size = key.length;
+    file.confidence = key.confidence;
+    switch (key.kind)
+    {
+    case KeyKind::Wif:
+      file.type = "key/wif";
+      file.description = key.compressed ? "WIF private key (compressed)" : "WIF private key";
+      break;
+    case KeyKind::ExtendedPrivate:
+      file.type = "key/xprv";
+      file.description = "BIP32 extended private key";
+      break;
+    case KeyKind::ExtendedPublic:
+      file.type = "key/xpub";
+      file.description = "BIP32 extended public key";
+      break;
+    case KeyKind::Hex:
+      file.type = "key/hex";
+      file.description = c.labelled ? "256-bit hex secret (labelled)" : "256-bit hex secret";
+      break;
+    case KeyKind::Der:
+      file.type = "key/der";
+      file.description = "SEC1 EC private key (DER)";
+      break;
+    }
+    if (key.testnet)
+    {
+      file.description += ", testnet";
+    }
+    registry->add(std::move(file));
+    valid.push_back(std::move(key));
+  }
+  if (!valid.empty())
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keys_.insert(keys_.end(), valid.begin(), valid.end());
+  }
+}
+
+void KeyCandidateStage::finish(CarveContext& ctx)
+{
+  std::vector<KeyCandidate> none;
+  enqueue(none, ctx.registry(), true);
+  if (pool_)
+  {
+    pool_->wait();
+  }
+}
+
+std::vector<RecoveredKey> KeyCandidateStage::keys() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return keys_;
+}
+
+}  // namespace rsn
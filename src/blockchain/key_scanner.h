@@ -0,0 +1,93 @@
+// RecoverySoftNetz — raw private key and extended key candidate scanner
+//
+// Two cheap detectors feed one validation queue:
+//   - a SIMD character-class run detector over every chunk, reporting
+//     base58 runs of WIF (51/52) and extended-key (111) length and hex runs
+//     of exactly 64 digits;
+//   - a DER matcher on the shared pattern matcher for SEC1 ECPrivateKey
+//     structures (SEQUENCE, INTEGER 1, OCTET STRING 32), as stored in
+//     Bitcoin Core wallets.
+// Candidates are batched and validated on a worker pool (base58check
+// double-SHA256, version bytes, secp256k1 scalar range, DER lengths and curve
+// OID) so the chunk readers never wait on hashing.
+
+#pragma once
+
+#include "common/thread_pool.h"
+#include "core/carve_pipeline.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+enum class KeyKind : uint8_t
+{
+  Wif,              // base58check WIF private key
+  ExtendedPrivate,  // BIP32 xprv/tprv/yprv/zprv...
+  ExtendedPublic,   // BIP32 xpub/tpub/ypub/zpub...
+  Hex,              // 64 hex digits
+  Der,              // SEC1 ECPrivateKey DER
+};
+
+struct KeyCandidate
+{
+  KeyKind kind = KeyKind::Wif;
+  uint64_t offset = 0;
+  SecureBytes raw;        // text (base58/hex) or DER bytes as found on disk
+  bool labelled = false;  // hex run preceded by a "key"/"priv"/"secret" label
+};
+
+struct RecoveredKey
+{
+  KeyKind kind = KeyKind::Wif;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  SecureBytes key;  // 32-byte secret, or 33-byte public key for xpub
+  bool compressed = false;
+  bool testnet = false;
+  double confidence = 0.0;
+};
+
+/// Validate one candidate; pure function, safe from any thread.
+bool validateKeyCandidate(const KeyCandidate& candidate, RecoveredKey& key);
+
+class KeyCandidateStage : public CarveStage
+{
+public:
+  static constexpr size_t BATCH_SIZE = 256;
+
+  explicit KeyCandidateStage(unsigned validation_threads = 0)
+    : validation_threads_(validation_threads)
+  {
+  }
+  ~KeyCandidateStage() override;
+
+  const char* name() const override { return "keys"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  bool wantsChunks() const override { return true; }
+  void onChunk(const ChunkView& chunk, CarveContext& ctx) override;
+  size_t lookahead() const override { return 512; }
+  void finish(CarveContext& ctx) override;
+
+  /// Keys found by the last run.
+  std::vector<RecoveredKey> keys() const;
+
+private:
+  void enqueue(std::vector<KeyCandidate>& batch, FileRegistry& registry, bool force);
+  void validateBatch(std::vector<KeyCandidate> batch, FileRegistry* registry);
+
+  unsigned validation_threads_;
+  std::once_flag pool_once_;
+  std::unique_ptr<ThreadPool> pool_;
+
+  mutable std::mutex mutex_;
+  std::vector<KeyCandidate> pending_;
+  std::vector<RecoveredKey> keys_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,377 @@
+// RecoverySoftNetz — password candidate generation
+
+#include "blockchain/password_candidates.h"
+
+#include "common/crypto.h"
+#include "common/utils.h"
+
+#include <algorithm>
+
+namespace rsn
+{
+
+namespace
+{
+
+std::string charRange(char first, char last)
+{
+  std::string out;
+  for (int c = first; c <= last; ++c)
+  {
+    out.push_back(static_cast<char>(c));
+  }
+  return out;
+}
+
+const std::string& symbols()
+{
+  static const std::string SET = " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+  return SET;
+}
+
+// Rule positions: 0-9 then A-Z for 10-35.
+bool rulePosition(char c, uint8_t& n)
+{
+  if (c >= '0' && c <= '9')
+  {
+    n = static_cast<uint8_t>(c - '0');
+    return true;
+  }
+  if (c >= 'A' && c <= 'Z')
+  {
+    n = static_cast<uint8_t>(c - 'A' + 10);
+    return true;
+  }
+  return false;
+}
+
+char toggleCase(char c)
+{
+  if (c >= 'a' && c <= 'z')
+  {
+    return static_cast<char>(c - 32);
+  }
+  if (c >= 'A' && c <= 'Z')
+  {
+    return static_cast<char>(c + 32);
+  }
+  return c;
+}
+
+char lower(char c)
+{
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c;
+}
+
+char upper(char c)
+{
+  return c >= 'a' && c <= 'z' ? static_cast<char>(c - 32) : c;
+}
+
+}  // namespace
+
+std::unique_ptr<MaskSource> MaskSource::parse(const std::string& mask,
+                                              const std::vector<std::string>& custom)
+{
+  std::unique_ptr<MaskSource> source(new MaskSource());
+  source->mask_ = mask;
+  for (size_t i = 0; i < mask.size(); ++i)
+  {
+    std::string set;
+    if (mask[i] != '?')
+    {
+      set.assign(1, mask[i]);
+    }
+    else
+    {
+      if (++i == mask.size())
+      {
+        return nullptr;
+      }
+      switch (mask[i])
+      {
+      case 'l':
+        set = charRange('a', 'z');
+        break;
+      case 'u':
+        set = charRange('A', 'Z');
+        break;
+      case 'd':
+        set = charRange('0', '9');
+        break;
+      case 's':
+        set = symbols();
+        break;
+      case 'a':
+        set = charRange('a', 'z') + charRange('A', 'Z') + charRange('0', '9') + symbols();
+        break;
+      case 'h':
+        set = charRange('0', '9') + charRange('a', 'f');
+        break;
+      case 'H':
+        set = charRange('0', '9') + charRange('A', 'F');
+        break;
+      case '?':
+        set = "?";
+        break;
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      {
+        size_t slot = static_cast<size_t>(mask[i] - '1');
+        if (slot >= custom.size())
+        {
+          return nullptr;
+        }
+        set = custom[slot];
+        break;
+      }
+      default:
+        return nullptr;
+      }
+    }
+    if (set.empty() || source->size_ > UINT64_MAX / set.size())
+    {
+      return nullptr;
+    }
+    source->size_ *= set.size();
+    source->positions_.push_back(std::move(set));
+  }
+  return source;
+}
+
+void MaskSource::generate(uint64_t index, std::string& out) const
+{
+  // Mixed radix with the last position varying fastest.
+  out.resize(positions_.size());
+  for (size_t i = positions_.size(); i-- > 0;)
+  {
+    const std::string& set = positions_[i];
+    out[i] = set[index % set.size()];
+    index /= set.size();
+  }
+}
+
+std::unique_ptr<RuleSource> RuleSource::create(std::vector<std::string> words,
+                                               const std::vector<std::string>& rules)
+{
+  std::unique_ptr<RuleSource> source(new RuleSource());
+  for (const std::string& text : rules)
+  {
+    std::vector<Op> ops;
+    size_t i = 0;
+    auto arg = [&](char& c) {
+      if (i >= text.size())
+      {
+        return false;
+      }
+      c = text[i++];
+      return true;
+    };
+    auto pos = [&](uint8_t& n) { return i < text.size() && rulePosition(text[i++], n); };
+    while (i < text.size())
+    {
+      Op op{text[i++], 0, 0, 0};
+      bool ok = true;
+      switch (op.fn)
+      {
+      case ' ':
+      case ':':
+        continue;
+      case 'l':
+      case 'u':
+      case 'c':
+      case 'C':
+      case 't':
+      case 'r':
+      case 'd':
+      case 'f':
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+        break;
+      case 'T':
+      case 'D':
+      case '\'':
+      case 'z':
+      case 'Z':
+        ok = pos(op.n);
+        break;
+      case '$':
+      case '^':
+      case '@':
+        ok = arg(op.x);
+        break;
+      case 's':
+        ok = arg(op.x) && arg(op.y);
+        break;
+      case 'i':
+      case 'o':
+        ok = pos(op.n) && arg(op.x);
+        break;
+      default:
+        ok = false;
+        break;
+      }
+      if (!ok)
+      {
+        return nullptr;
+      }
+      ops.push_back(op);
+    }
+    source->rules_.push_back(std::move(ops));
+    source->rule_text_.push_back(text);
+  }
+  if (source->rules_.empty())
+  {
+    source->rules_.emplace_back();
+    source->rule_text_.emplace_back(":");
+  }
+  source->words_ = std::move(words);
+  return source;
+}
+
+uint64_t RuleSource::size() const
+{
+  return static_cast<uint64_t>(words_.size()) * rules_.size();
+}
+
+void RuleSource::generate(uint64_t index, std::string& out) const
+{
+  out = words_[index / rules_.size()];
+  for (const Op& op : rules_[index % rules_.size()])
+  {
+    size_t n = op.n;
+    switch (op.fn)
+    {
+    case 'l':
+      std::transform(out.begin(), out.end(), out.begin(), lower);
+      break;
+    case 'u':
+      std::transform(out.begin(), out.end(), out.begin(), upper);
+      break;
+    case 'c':
+    case 'C':
+      std::transform(out.begin(), out.end(), out.begin(), op.fn == 'c' ? lower : upper);
+      if (!out.empty())
+      {
+        out[0] = op.fn == 'c' ? upper(out[0]) : lower(out[0]);
+      }
+      break;
+    case 't':
+      std::transform(out.begin(), out.end(), out.begin(), toggleCase);
+      break;
+    case 'T':
+      if (n < out.size())
+      {
+        out[n] = toggleCase(out[n]);
+      }
+      break;
+    case 'r':
+      std::reverse(out.begin(), out.end());
+      break;
+    case 'd':
+      out += out;
+      break;
+    case 'f':
+      out += std::string(out.rbegin(), out.rend());
+      break;
+    case '{':
+      if (!out.empty())
+      {
+        std::rotate(out.begin(), out.begin() + 1, out.end());
+      }
+      break;
+    case '}':
+      if (!out.empty())
+      {
+        std::rotate(out.rbegin(), out.rbegin() + 1, out.rend());
+      }
+      break;
+    case '$':
+      out.push_back(op.x);
+      break;
+    case '^':
+      out.insert(out.begin(), op.x);
+      break;
+    case '[':
+      if (!out.empty())
+      {
+        out.erase(0, 1);
+      }
+      break;
+    case ']':
+      if (!out.empty())
+      {
+        out.pop_back();
+      }
+      break;
+    case 'D':
+      if (n < out.size())
+      {
+        out.erase(n, 1);
+      }
+      break;
+    case 'i':
+      if (n <= out.size())
+      {
+        out.insert(n, 1, op.x);
+      }
+      break;
+    case 'o':
+      if (n < out.size())
+      {
+        out[n] = op.x;
+      }
+      break;
+    case '\'':
+      if (n < out.size())
+      {
+        out.resize(n);
+      }
+      break;
+    case 's':
+      std::replace(out.begin(), out.end(), op.x, op.y);
+      break;
+    case '@':
+      out.erase(std::remove(out.begin(), out.end(), op.x), out.end());
+      break;
+    case 'z':
+      if (!out.empty())
+      {
+        out.insert(0, n, out.front());
+      }
+      break;
+    case 'Z':
+      if (!out.empty())
+      {
+        out.append(n, out.back());
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+std::string RuleSource::describe() const
+{
+  Sha256 hash;
+  for (const auto& list : {&words_, &rule_text_})
+  {
+    for (const std::string& s : *list)
+    {
+      hash.update(s.data(), s.size());
+      hash.update("\n", 1);
+    }
+    hash.update("\0", 1);
+  }
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  hash.finish(digest);
+  return "rules:" + std::to_string(words_.size()) + "x" + std::to_string(rules_.size()) + ":" +
+         toHex(digest, 8);
+}
+
+}  // namespace rsn
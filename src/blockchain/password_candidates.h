@@ -0,0 +1,86 @@
+// RecoverySoftNetz — password candidate generation
+//
+// Candidate spaces for wallet password recovery. Every space is random
+// access: candidate i can be produced without producing 0..i-1, so the
+// recovery engine can split the space into ranges, let idle workers steal
+// half of a busy worker's range, and checkpoint exactly what is left.
+//
+//   MaskSource   hashcat-style masks ("Summer?d?d?s", custom sets ?1-?4)
+//   RuleSource   remembered words x hashcat-style rules ("c $1 $!", "sa@")
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+class CandidateSource
+{
+public:
+  virtual ~CandidateSource() = default;
+
+  virtual uint64_t size() const = 0;
+
+  /// Write candidate `index` (< size()) to `out`.
+  virtual void generate(uint64_t index, std::string& out) const = 0;
+
+  /// Stable description of the space; part of the checkpoint fingerprint.
+  virtual std::string describe() const = 0;
+};
+
+class MaskSource : public CandidateSource
+{
+public:
+  /// Built-in sets: ?l lower, ?u upper, ?d digits, ?s printable symbols,
+  /// ?a all printable, ?h/?H lower/upper hex, ?1-?4 from `custom`, ?? a
+  /// literal '?'. Any other byte is a literal. Returns nullptr on a bad
+  /// token or when the space does not fit in 64 bits.
+  static std::unique_ptr<MaskSource> parse(const std::string& mask,
+                                           const std::vector<std::string>& custom = {});
+
+  uint64_t size() const override { return size_; }
+  void generate(uint64_t index, std::string& out) const override;
+  std::string describe() const override { return "mask:" + mask_; }
+
+private:
+  MaskSource() = default;
+
+  std::string mask_;
+  std::vector<std::string> positions_;  // candidate characters per position
+  uint64_t size_ = 1;
+};
+
+class RuleSource : public CandidateSource
+{
+public:
+  /// `rules` uses the hashcat rule syntax, one rule per entry (":" keeps the
+  /// word). Supported: : l u c C t TN r d f { } $X ^X [ ] DN iNX oNX 'N sXY
+  /// @X zN ZN, with N in 0-9A-Z. Returns nullptr on an unknown function.
+  static std::unique_ptr<RuleSource> create(std::vector<std::string> words,
+                                            const std::vector<std::string>& rules);
+
+  uint64_t size() const override;
+  void generate(uint64_t index, std::string& out) const override;
+  std::string describe() const override;
+
+private:
+  struct Op
+  {
+    char fn;
+    uint8_t n;
+    char x;
+    char y;
+  };
+
+  RuleSource() = default;
+
+  std::vector<std::string> words_;
+  std::vector<std::string> rule_text_;
+  std::vector<std::vector<Op>> rules_;
+};
+
+}  // namespace rsn
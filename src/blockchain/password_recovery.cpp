@@ -0,0 +1,645 @@
+// RecoverySoftNetz — wallet password recovery
+
+#include "blockchain/password_recovery.h"
+
+#include "common/crypto.h"
+#include "common/kdf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <thread>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr const char* CHECKPOINT_MAGIC = "rsn-password-checkpoint 1";
+
+// Value of `"key": ...` in a flat scan of a JSON document; keystore field
+// names are unique, so nesting can be ignored.
+bool jsonValue(const std::string& json, const char* key, std::string& value)
+{
+  std::string quoted = std::string("\"") + key + "\"";
+  size_t pos = json.find(quoted);
+  if (pos == std::string::npos)
+  {
+    return false;
+  }
+  pos = json.find_first_not_of(" \t\r\n", pos + quoted.size());
+  if (pos == std::string::npos || json[pos] != ':')
+  {
+    return false;
+  }
+  pos = json.find_first_not_of(" \t\r\n", pos + 1);
+  if (pos == std::string::npos)
+  {
+    return false;
+  }
+  if (json[pos] == '"')
+  {
+    size_t end = json.find('"', pos + 1);
+    if (end == std::string::npos)
+    {
+      return false;
+    }
+    value = json.substr(pos + 1, end - pos - 1);
+    return true;
+  }
+  size_t end = json.find_first_of(",}] \t\r\n", pos);
+  value = json.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+  return !value.empty();
+}
+
+bool jsonUint(const std::string& json, const char* key, uint64_t& value)
+{
+  std::string text;
+  if (!jsonValue(json, key, text) || text.find_first_not_of("0123456789") != std::string::npos ||
+      text.size() > 19)
+  {
+    return false;
+  }
+  value = std::stoull(text);
+  return true;
+}
+
+bool jsonHex(const std::string& json, const char* key, std::vector<uint8_t>& value)
+{
+  std::string text;
+  if (!jsonValue(json, key, text))
+  {
+    return false;
+  }
+  if (text.size() >= 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+  {
+    text.erase(0, 2);
+  }
+  return fromHex(text, value);
+}
+
+class BitcoinCoreVerifier : public PasswordVerifier
+{
+public:
+  explicit BitcoinCoreVerifier(const BitcoinCoreMasterKey& key) : key_(key) {}
+
+  size_t check(const std::string* candidates, size_t count) override
+  {
+    digests_.resize(count * SHA512_DIGEST_SIZE);
+    for (size_t i = 0; i < count; ++i)
+    {
+      Sha512 hash;
+      hash.update(candidates[i].data(), candidates[i].size());
+      hash.update(key_.salt, sizeof(key_.salt));
+      hash.finish(&digests_[i * SHA512_DIGEST_SIZE]);
+    }
+    sha512Rehash(digests_.data(), count, key_.iterations - 1);
+
+    // The 32-byte master key is PKCS#7 padded to 48 bytes, so the last CBC
+    // block decrypts to sixteen 0x10 bytes under the right key.
+    size_t match = SIZE_MAX;
+    for (size_t i = 0; i < count && match == SIZE_MAX; ++i)
+    {
+      Aes256 aes(&digests_[i * SHA512_DIGEST_SIZE]);
+      uint8_t block[AES_BLOCK_SIZE];
+      aes.decryptBlock(key_.encrypted_key + 32, block);
+      bool padded = true;
+      for (size_t j = 0; j < AES_BLOCK_SIZE; ++j)
+      {
+        padded &= (block[j] ^ key_.encrypted_key[16 + j]) == 0x10;
+      }
+      if (padded)
+      {
+        match = i;
+      }
+    }
+    secureZero(digests_.data(), digests_.size());
+    return match;
+  }
+
+private:
+  BitcoinCoreMasterKey key_;
+  std::vector<uint8_t> digests_;
+};
+
+class EthereumKeystoreVerifier : public PasswordVerifier
+{
+public:
+  explicit EthereumKeystoreVerifier(const EthereumKeystore& keystore)
+    : keystore_(keystore), scrypt_(keystore.n, keystore.r, keystore.p),
+      derived_(keystore.dklen), mac_input_(16 + keystore.ciphertext.size())
+  {
+    std::copy(keystore_.ciphertext.begin(), keystore_.ciphertext.end(), mac_input_.begin() + 16);
+  }
+
+  size_t check(const std::string* candidates, size_t count) override
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      const std::string& pw = candidates[i];
+      if (keystore_.scrypt)
+      {
+        scrypt_.derive(pw.data(), pw.size(), keystore_.salt.data(), keystore_.salt.size(),
+                       derived_.data(), derived_.size());
+      }
+      else
+      {
+        pbkdf2HmacSha256(pw.data(), pw.size(), keystore_.salt.data(), keystore_.salt.size(),
+                         keystore_.iterations, derived_.data(), derived_.size());
+      }
+      std::memcpy(mac_input_.data(), derived_.data() + 16, 16);
+      uint8_t mac[KECCAK256_DIGEST_SIZE];
+      keccak256(mac_input_.data(), mac_input_.size(), mac);
+      if (std::memcmp(mac, keystore_.mac, sizeof(mac)) == 0)
+      {
+        return i;
+      }
+    }
+    return SIZE_MAX;
+  }
+
+  ~EthereumKeystoreVerifier() override
+  {
+    secureZero(derived_.data(), derived_.size());
+    secureZero(mac_input_.data(), 16);
+  }
+
+private:
+  const EthereumKeystore& keystore_;
+  ScryptContext scrypt_;
+  std::vector<uint8_t> derived_;
+  std::vector<uint8_t> mac_input_;
+};
+
+// Serialized CMasterKey: 0x30 <48 bytes> 0x08 <8 bytes> method(LE32)
+// iterations(LE32) 0x00 (empty vchOtherDerivationParameters).
+constexpr size_t MKEY_RECORD_SIZE = 67;
+constexpr size_t MKEY_KEY_SIZE = 9;  // "\x04mkey", nID (LE32)
+constexpr size_t MKEY_SLACK = 16;    // Berkeley DB item header and alignment around a value
+
+bool readMasterKey(const uint8_t* p, BitcoinCoreMasterKey& key)
+{
+  if (p[0] != 0x30 || p[49] != 0x08 || p[66] != 0x00)
+  {
+    return false;
+  }
+  uint32_t method = loadLE32(p + 58);
+  uint32_t iterations = loadLE32(p + 62);
+  if (method != 0 || iterations == 0 || iterations > 100000000)
+  {
+    return false;  // other derivation methods are not supported
+  }
+  std::memcpy(key.encrypted_key, p + 1, sizeof(key.encrypted_key));
+  std::memcpy(key.salt, p + 50, sizeof(key.salt));
+  key.derivation_method = method;
+  key.iterations = iterations;
+  return true;
+}
+
+}  // namespace
+
+bool findBitcoinCoreMasterKey(ByteView wallet, BitcoinCoreMasterKey& key)
+{
+  // Each "mkey" key is followed by its value record, within an item header;
+  // Berkeley DB may also place the value just before the key on the page.
+  for (size_t at = 0;; ++at)
+  {
+    ByteView rest = wallet.sub(at);
+    size_t found = findBytes(rest, "\x04mkey", 5);
+    if (found == SIZE_MAX)
+    {
+      return false;
+    }
+    at += found;
+    size_t after = at + MKEY_KEY_SIZE;
+    for (size_t i = after; i < after + MKEY_SLACK && i + MKEY_RECORD_SIZE <= wallet.size; ++i)
+    {
+      if (readMasterKey(wallet.data + i, key))
+      {
+        return true;
+      }
+    }
+    for (size_t gap = 0; gap < MKEY_SLACK && gap + MKEY_RECORD_SIZE <= at; ++gap)
+    {
+      if (readMasterKey(wallet.data + at - gap - MKEY_RECORD_SIZE, key))
+      {
+        return true;
+      }
+    }
+  }
+}
+
+std::string BitcoinCoreTarget::describe() const
+{
+  return "bitcoin-core:" + toHex(key_.encrypted_key, sizeof(key_.encrypted_key)) + ":" +
+         toHex(key_.salt, sizeof(key_.salt)) + ":" + std::to_string(key_.iterations);
+}
+
+std::unique_ptr<PasswordVerifier> BitcoinCoreTarget::createVerifier() const
+{
+  if (key_.derivation_method != 0 || key_.iterations == 0)
+  {
+    return nullptr;
+  }
+  return std::unique_ptr<PasswordVerifier>(new BitcoinCoreVerifier(key_));
+}
+
+bool parseEthereumKeystore(const std::string& json, EthereumKeystore& keystore)
+{
+  std::string kdf;
+  std::vector<uint8_t> mac;
+  uint64_t dklen = 0;
+  if (!jsonValue(json, "kdf", kdf) || !jsonHex(json, "salt", keystore.salt) ||
+      !jsonHex(json, "ciphertext", keystore.ciphertext) || !jsonHex(json, "mac", mac) ||
+      mac.size() != sizeof(keystore.mac) || !jsonUint(json, "dklen", dklen) || dklen < 32 ||
+      dklen > 1024)
+  {
+    return false;
+  }
+  std::memcpy(keystore.mac, mac.data(), sizeof(keystore.mac));
+  keystore.dklen = static_cast<uint32_t>(dklen);
+  if (kdf == "scrypt")
+  {
+    uint64_t r = 0;
+    uint64_t p = 0;
+    keystore.scrypt = true;
+    if (!jsonUint(json, "n", keystore.n) || !jsonUint(json, "r", r) || !jsonUint(json, "p", p) ||
+        !isPowerOfTwo(keystore.n) || r == 0 || p == 0 || r * p >= (1u << 30))
+    {
+      return false;
+    }
+    keystore.r = static_cast<uint32_t>(r);
+    keystore.p = static_cast<uint32_t>(p);
+    return true;
+  }
+  if (kdf == "pbkdf2")
+  {
+    std::string prf;
+    uint64_t c = 0;
+    keystore.scrypt = false;
+    if (!jsonValue(json, "prf", prf) || prf != "hmac-sha256" || !jsonUint(json, "c", c) ||
+        c == 0 || c > UINT32_MAX)
+    {
+      return false;
+    }
+    keystore.iterations = static_cast<uint32_t>(c);
+    return true;
+  }
+  return false;
+}
+
+std::string EthereumKeystoreTarget::describe() const
+{
+  return "ethereum-keystore:" + toHex(keystore_.mac, sizeof(keystore_.mac));
+}
+
+std::unique_ptr<PasswordVerifier> EthereumKeystoreTarget::createVerifier() const
+{
+  return std::unique_ptr<PasswordVerifier>(new EthereumKeystoreVerifier(keystore_));
+}
+
+struct PasswordRecovery::Worker
+{
+  std::mutex mutex;
+  std::deque<Range> ranges;
+  Range inflight{0, 0};
+  std::atomic<uint64_t> remaining{0};
+  std::unique_ptr<PasswordVerifier> verifier;
+};
+
+PasswordRecovery::PasswordRecovery(const CandidateSource& source, const PasswordTarget& target,
+                                   PasswordRecoveryOptions options)
+  : source_(source), target_(target), options_(std::move(options))
+{
+}
+
+PasswordRecovery::~PasswordRecovery() = default;
+
+std::string PasswordRecovery::fingerprint() const
+{
+  std::string text = source_.describe() + "\n" + target_.describe();
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256(text.data(), text.size(), digest);
+  return toHex(digest, sizeof(digest));
+}
+
+bool PasswordRecovery::loadCheckpoint(std::vector<Range>& ranges, uint64_t& tested) const
+{
+  std::ifstream in(options_.checkpoint_path);
+  std::string line;
+  if (!in || !std::getline(in, line) || line != CHECKPOINT_MAGIC)
+  {
+    return false;
+  }
+  std::string word;
+  std::string print;
+  if (!(in >> word >> print) || word != "fingerprint" || print != fingerprint() ||
+      !(in >> word >> tested) || word != "tested")
+  {
+    return false;
+  }
+  Range range{0, 0};
+  while (in >> word >> range.begin >> range.end)
+  {
+    if (word != "range" || range.begin >= range.end || range.end > source_.size())
+    {
+      return false;
+    }
+    ranges.push_back(range);
+  }
+  return in.eof();
+}
+
+bool PasswordRecovery::saveCheckpoint()
+{
+  if (options_.checkpoint_path.empty())
+  {
+    return false;
+  }
+  std::vector<Range> ranges;
+  {
+    std::lock_guard<std::mutex> steal_lock(steal_mutex_);
+    for (auto& worker : workers_)
+    {
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      if (worker->inflight.begin < worker->inflight.end)
+      {
+        ranges.push_back(worker->inflight);
+      }
+      ranges.insert(ranges.end(), worker->ranges.begin(), worker->ranges.end());
+    }
+  }
+  std::sort(ranges.begin(), ranges.end(),
+            [](const Range& a, const Range& b) { return a.begin < b.begin; });
+
+  std::string tmp = options_.checkpoint_path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    out << CHECKPOINT_MAGIC << "\n"
+        << "fingerprint " << fingerprint() << "\n"
+        << "tested " << tested_before_ + tested_.load() << "\n";
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+      // Adjacent ranges (a block and the rest of its range) are merged.
+      uint64_t begin = ranges[i].begin;
+      uint64_t end = ranges[i].end;
+      while (i + 1 < ranges.size() && ranges[i + 1].begin == end)
+      {
+        end = ranges[++i].end;
+      }
+      out << "range " << begin << " " << end << "\n";
+    }
+    if (!out.flush())
+    {
+      return false;
+    }
+  }
+#ifdef _WIN32
+  std::remove(options_.checkpoint_path.c_str());
+#endif
+  return std::rename(tmp.c_str(), options_.checkpoint_path.c_str()) == 0;
+}
+
+bool PasswordRecovery::claim(Worker& self, Range& block)
+{
+  std::lock_guard<std::mutex> lock(self.mutex);
+  while (!self.ranges.empty())
+  {
+    Range& front = self.ranges.front();
+    if (front.begin >= front.end)
+    {
+      self.ranges.pop_front();
+      continue;
+    }
+    uint64_t take = std::min(block_size_, front.end - front.begin);
+    block = {front.begin, front.begin + take};
+    front.begin += take;
+    self.remaining -= take;
+    self.inflight = block;
+    return true;
+  }
+  return false;
+}
+
+bool PasswordRecovery::steal(Worker& self)
+{
+  std::lock_guard<std::mutex> steal_lock(steal_mutex_);
+  for (;;)
+  {
+    Worker* victim = nullptr;
+    uint64_t most = 0;
+    for (auto& worker : workers_)
+    {
+      uint64_t left = worker->remaining.load();
+      if (worker.get() != &self && left > most)
+      {
+        most = left;
+        victim = worker.get();
+      }
+    }
+    if (victim == nullptr)
+    {
+      return false;
+    }
+    Range stolen{0, 0};
+    {
+      std::lock_guard<std::mutex> lock(victim->mutex);
+      if (victim->ranges.empty())
+      {
+        continue;  // drained since the load; look again
+      }
+      Range& back = victim->ranges.back();
+      uint64_t length = back.end - back.begin;
+      if (length > block_size_)
+      {
+        uint64_t mid = back.begin + length / 2;
+        stolen = {mid, back.end};
+        back.end = mid;
+      }
+      else
+      {
+        stolen = back;
+        victim->ranges.pop_back();
+      }
+      victim->remaining -= stolen.end - stolen.begin;
+    }
+    std::lock_guard<std::mutex> lock(self.mutex);
+    self.ranges.push_back(stolen);
+    self.remaining += stolen.end - stolen.begin;
+    return true;
+  }
+}
+
+void PasswordRecovery::workerLoop(Worker& self)
+{
+  size_t batch = std::max<size_t>(1, target_.batchSize());
+  std::vector<std::string> candidates(batch);
+  Range block{0, 0};
+  while (!cancelled_.load(std::memory_order_relaxed) && !found_.load(std::memory_order_relaxed))
+  {
+    if (!claim(self, block))
+    {
+      if (!steal(self))
+      {
+        break;
+      }
+      continue;
+    }
+    uint64_t index = block.begin;
+    while (index < block.end)
+    {
+      if (cancelled_.load(std::memory_order_relaxed) || found_.load(std::memory_order_relaxed))
+      {
+        break;
+      }
+      size_t n = static_cast<size_t>(std::min<uint64_t>(batch, block.end - index));
+      for (size_t i = 0; i < n; ++i)
+      {
+        source_.generate(index + i, candidates[i]);
+      }
+      size_t match = self.verifier->check(candidates.data(), n);
+      tested_ += n;
+      if (match != SIZE_MAX)
+      {
+        std::lock_guard<std::mutex> lock(result_mutex_);
+        if (!result_.found)
+        {
+          result_.found = true;
+          result_.password = candidates[match];
+          result_.index = index + match;
+        }
+        found_.store(true);
+      }
+      index += n;
+    }
+    std::lock_guard<std::mutex> lock(self.mutex);
+    if (index < block.end)
+    {
+      self.ranges.push_front({index, block.end});  // interrupted: keep for the checkpoint
+      self.remaining += block.end - index;
+    }
+    self.inflight = {0, 0};
+  }
+  for (auto& candidate : candidates)
+  {
+    secureZero(&candidate[0], candidate.size());
+  }
+}
+
+PasswordRecoveryResult PasswordRecovery::run()
+{
+  auto started = std::chrono::steady_clock::now();
+  result_ = PasswordRecoveryResult();
+  cancelled_.store(false);
+  found_.store(false);
+  tested_.store(0);
+  tested_before_ = 0;
+
+  std::vector<Range> ranges;
+  if (!options_.checkpoint_path.empty() && loadCheckpoint(ranges, tested_before_))
+  {
+    result_.resumed = true;
+  }
+  else
+  {
+    ranges.assign(1, Range{0, source_.size()});
+    tested_before_ = 0;
+  }
+
+  unsigned threads = options_.threads != 0 ? options_.threads : std::thread::hardware_concurrency();
+  threads = std::max(1u, threads);
+  size_t batch = std::max<size_t>(1, target_.batchSize());
+  block_size_ = options_.block_size != 0 ? options_.block_size : 16 * batch;
+
+  workers_.clear();
+  for (unsigned t = 0; t < threads; ++t)
+  {
+    workers_.emplace_back(new Worker());
+    workers_.back()->verifier = target_.createVerifier();
+    if (!workers_.back()->verifier)
+    {
+      workers_.clear();
+      return result_;
+    }
+  }
+  // Fresh runs split the space evenly; resumed ranges are dealt round-robin.
+  // Stealing evens out the rest.
+  if (!result_.resumed && threads > 1)
+  {
+    uint64_t total = source_.size();
+    for (unsigned t = 0; t < threads; ++t)
+    {
+      Range part{total / threads * t, t + 1 == threads ? total : total / threads * (t + 1)};
+      if (part.begin < part.end)
+      {
+        workers_[t]->ranges.push_back(part);
+        workers_[t]->remaining += part.end - part.begin;
+      }
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+      Worker& worker = *workers_[i % threads];
+      worker.ranges.push_back(ranges[i]);
+      worker.remaining += ranges[i].end - ranges[i].begin;
+    }
+  }
+
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  unsigned running = threads;
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t)
+  {
+    pool.emplace_back([&, t]() {
+      workerLoop(*workers_[t]);
+      std::lock_guard<std::mutex> lock(done_mutex);
+      --running;
+      done_cv.notify_all();
+    });
+  }
+  {
+    auto interval = std::chrono::duration<double>(std::max(0.1, options_.checkpoint_seconds));
+    std::unique_lock<std::mutex> lock(done_mutex);
+    while (!done_cv.wait_for(lock, interval, [&]() { return running == 0; }))
+    {
+      lock.unlock();
+      saveCheckpoint();
+      lock.lock();
+    }
+  }
+  for (auto& th : pool)
+  {
+    th.join();
+  }
+
+  for (auto& worker : workers_)
+  {
+    result_.remaining += worker->remaining.load();
+  }
+  result_.tested = tested_.load();
+  if (!options_.checkpoint_path.empty())
+  {
+    if (result_.found || result_.remaining == 0)
+    {
+      std::remove(options_.checkpoint_path.c_str());
+    }
+    else
+    {
+      saveCheckpoint();
+    }
+  }
+  workers_.clear();
+  result_.seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  return result_;
+}
+
+}  // namespace rsn
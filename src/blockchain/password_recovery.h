@@ -0,0 +1,175 @@
+// RecoverySoftNetz — wallet password recovery
+//
+// Tests password candidates against an encrypted wallet on every core.
+// The candidate space (password_candidates.h) is index based; each worker
+// owns a queue of index ranges, takes small blocks from its front, and when
+// idle steals the back half of the busiest worker's range. Because the
+// outstanding work is always a set of ranges, it is written to a checkpoint
+// file periodically and on cancel, and a later run resumes from it.
+//
+// Targets:
+//   BitcoinCoreTarget       wallet.dat master key (iterated SHA-512 +
+//                           AES-256-CBC), verified a SIMD batch at a time
+//   EthereumKeystoreTarget  Web3 Secret Storage v3 (scrypt or PBKDF2 +
+//                           Keccak-256 MAC)
+
+#pragma once
+
+#include "blockchain/password_candidates.h"
+#include "common/utils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// Per-thread password checker; may hold scratch memory (scrypt).
+class PasswordVerifier
+{
+public:
+  virtual ~PasswordVerifier() = default;
+
+  /// Index of the matching candidate in [0, count), or SIZE_MAX.
+  virtual size_t check(const std::string* candidates, size_t count) = 0;
+};
+
+class PasswordTarget
+{
+public:
+  virtual ~PasswordTarget() = default;
+
+  /// Stable description; part of the checkpoint fingerprint.
+  virtual std::string describe() const = 0;
+
+  /// Candidates a verifier wants per check() call.
+  virtual size_t batchSize() const { return 1; }
+
+  virtual std::unique_ptr<PasswordVerifier> createVerifier() const = 0;
+};
+
+/// CMasterKey record of a Bitcoin Core wallet ("mkey").
+struct BitcoinCoreMasterKey
+{
+  uint8_t encrypted_key[48] = {};
+  uint8_t salt[8] = {};
+  uint32_t derivation_method = 0;
+  uint32_t iterations = 0;
+};
+
+/// Locate the master key record of an "mkey" entry in a wallet.dat image.
+/// Records using a derivation method other than 0 (EVP_BytesToKey/SHA-512)
+/// are passed over. False when no usable record was found.
+bool findBitcoinCoreMasterKey(ByteView wallet, BitcoinCoreMasterKey& key);
+
+class BitcoinCoreTarget : public PasswordTarget
+{
+public:
+  explicit BitcoinCoreTarget(const BitcoinCoreMasterKey& key) : key_(key) {}
+
+  std::string describe() const override;
+  size_t batchSize() const override { return 8; }
+  std::unique_ptr<PasswordVerifier> createVerifier() const override;
+
+private:
+  BitcoinCoreMasterKey key_;
+};
+
+/// Parameters of a Web3 Secret Storage (v3) keystore.
+struct EthereumKeystore
+{
+  bool scrypt = true;
+  uint64_t n = 0;           // scrypt
+  uint32_t r = 0;           // scrypt
+  uint32_t p = 0;           // scrypt
+  uint32_t iterations = 0;  // pbkdf2 (hmac-sha256)
+  uint32_t dklen = 32;
+  std::vector<uint8_t> salt;
+  std::vector<uint8_t> ciphertext;
+  uint8_t mac[32] = {};
+};
+
+/// Parse the keystore JSON; false on missing fields or an unsupported KDF/PRF.
+bool parseEthereumKeystore(const std::string& json, EthereumKeystore& keystore);
+
+class EthereumKeystoreTarget : public PasswordTarget
+{
+public:
+  explicit EthereumKeystoreTarget(EthereumKeystore keystore) : keystore_(std::move(keystore)) {}
+
+  std::string describe() const override;
+  std::unique_ptr<PasswordVerifier> createVerifier() const override;
+
+private:
+  EthereumKeystore keystore_;
+};
+
+struct PasswordRecoveryOptions
+{
+  unsigned threads = 0;          // 0 = hardware concurrency
+  uint64_t block_size = 0;       // candidates per claim; 0 = 16 target batches
+  std::string checkpoint_path;   // empty = no checkpoint
+  double checkpoint_seconds = 60.0;
+};
+
+struct PasswordRecoveryResult
+{
+  bool found = false;
+  std::string password;
+  uint64_t index = 0;
+  uint64_t tested = 0;     // candidates tested in this run
+  uint64_t remaining = 0;  // candidates left when the run stopped
+  bool resumed = false;
+  double seconds = 0.0;
+};
+
+class PasswordRecovery
+{
+public:
+  PasswordRecovery(const CandidateSource& source, const PasswordTarget& target,
+                   PasswordRecoveryOptions options = PasswordRecoveryOptions());
+  ~PasswordRecovery();
+
+  /// Blocks until the password is found, the space is exhausted or cancel()
+  /// is called. Resumes from options.checkpoint_path when it matches this
+  /// source and target; the checkpoint is removed once the search completes.
+  PasswordRecoveryResult run();
+
+  void cancel() { cancelled_.store(true); }
+  uint64_t tested() const { return tested_.load(); }
+
+private:
+  struct Range
+  {
+    uint64_t begin;
+    uint64_t end;
+  };
+  struct Worker;
+
+  std::string fingerprint() const;
+  bool loadCheckpoint(std::vector<Range>& ranges, uint64_t& tested) const;
+  bool saveCheckpoint();
+  bool claim(Worker& self, Range& block);
+  bool steal(Worker& self);
+  void workerLoop(Worker& self);
+
+  const CandidateSource& source_;
+  const PasswordTarget& target_;
+  PasswordRecoveryOptions options_;
+  uint64_t block_size_ = 1;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::mutex steal_mutex_;  // makes range hand-over atomic for checkpoints
+  std::atomic<bool> cancelled_{false};
+  std::atomic<bool> found_{false};
+  std::atomic<uint64_t> tested_{0};
+  uint64_t tested_before_ = 0;
+  std::mutex result_mutex_;
+  PasswordRecoveryResult result_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,617 @@
+// RecoverySoftNetz — streaming BIP39 seed phrase detector
+
+#include "blockchain/seed_phrase_detector.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t BLOCK = 64;
+constexpr int DENSE_RUNS = 3;
+constexpr size_t MIN_WORDS = 12;
+const size_t PHRASE_LENGTHS[] = {24, 21, 18, 15, 12};
+
+// Bit i of `letters` set when p[i] is an ASCII letter, of `zeros` when p[i] == 0.
+inline void classify64(const uint8_t* p, uint64_t& letters, uint64_t& zeros)
+{
+#if defined(__AVX2__)
+  const __m256i lower = _mm256_set1_epi8(0x20);
+  const __m256i a = _mm256_set1_epi8('a');
+  const __m256i span = _mm256_set1_epi8(25);
+  const __m256i zero = _mm256_setzero_si256();
+  letters = 0;
+  zeros = 0;
+  for (int half = 0; half < 2; ++half)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * half));
+    __m256i x = _mm256_sub_epi8(_mm256_or_si256(v, lower), a);
+    __m256i in = _mm256_cmpeq_epi8(_mm256_min_epu8(x, span), x);
+    int shift = 32 * half;
+    letters |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(in))) << shift;
+    zeros |= static_cast<uint64_t>(static_cast<uint32_t>(
+               _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero))))
+             << shift;
+  }
+#elif defined(__SSE2__)
+  const __m128i lower = _mm_set1_epi8(0x20);
+  const __m128i a = _mm_set1_epi8('a');
+  const __m128i span = _mm_set1_epi8(25);
+  const __m128i zero = _mm_setzero_si128();
+  letters = 0;
+  zeros = 0;
+  for (int q = 0; q < 4; ++q)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * q));
+    __m128i x = _mm_sub_epi8(_mm_or_si128(v, lower), a);
+    __m128i in = _mm_cmpeq_epi8(_mm_min_epu8(x, span), x);
+    int shift = 16 * q;
+    letters |= static_cast<uint64_t>(_mm_movemask_epi8(in) & 0xffff) << shift;
+    zeros |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xffff) << shift;
+  }
+#else
+  letters = 0;
+  zeros = 0;
+  for (int i = 0; i < 64; ++i)
+  {
+    uint8_t x = static_cast<uint8_t>((p[i] | 0x20) - 'a');
+    letters |= static_cast<uint64_t>(x <= 25) << i;
+    zeros |= static_cast<uint64_t>(p[i] == 0) << i;
+  }
+#endif
+}
+
+inline int popcount64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(v);
+#else
+  int n = 0;
+  for (; v != 0; v &= v - 1)
+  {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Number of 3-letter run starts in one block, as 8-bit text and as UTF-16
+// text whose letters sit at device offsets of parity 0 and 1.
+struct BlockScore
+{
+  int ascii = 0;
+  int wide[2] = {0, 0};
+
+  bool dense() const { return ascii + wide[0] + wide[1] >= DENSE_RUNS; }
+
+  void add(const BlockScore& other)
+  {
+    ascii += other.ascii;
+    wide[0] += other.wide[0];
+    wide[1] += other.wide[1];
+  }
+};
+
+// Whitespace, digits and punctuation; ideographic and no-break spaces in UTF-16.
+inline bool isSeparatorUnit(uint32_t u, bool wide)
+{
+  if (u == ' ' || u == '\t' || u == '\r' || u == '\n')
+  {
+    return true;
+  }
+  if (wide && (u == 0x3000 || u == 0xa0))
+  {
+    return true;
+  }
+  return u >= 0x21 && u < 0x7f;  // letters never get here
+}
+
+/// Code point of the UTF-8 sequence at `k`, advancing `k` to its last byte.
+/// A byte that does not start a valid sequence is returned as it is.
+uint32_t utf8Decode(const uint8_t* text, size_t size, size_t& k)
+{
+  uint8_t c = text[k];
+  size_t n = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+  if (n == 0 || k + n >= size)
+  {
+    return c;
+  }
+  uint32_t u = c & (0x3f >> n);
+  for (size_t i = 1; i <= n; ++i)
+  {
+    uint8_t next = text[k + i];
+    if ((next & 0xc0) != 0x80)
+    {
+      return c;
+    }
+    u = (u << 6) | (next & 0x3f);
+  }
+  k += n;
+  return u;
+}
+
+inline bool inAlphabet(const uint64_t* alphabet, uint32_t u)
+{
+  return u < 0x10000 && ((alphabet[u >> 6] >> (u & 63)) & 1) != 0;
+}
+
+// Letters of the lists outside ASCII that the classifier cannot see (CJK,
+// Hangul, kana): each one followed by another or by a separator counts as
+// a run start, as 8-bit (UTF-8) text and as UTF-16 text at both parities.
+void scoreAlphabet(const uint8_t* p, size_t n, unsigned parity, const uint64_t* alphabet,
+                   BlockScore& score)
+{
+  uint32_t last = 0;
+  for (size_t k = 0; k < n; ++k)
+  {
+    uint32_t u = utf8Decode(p, n, k);
+    if (inAlphabet(alphabet, last) && (inAlphabet(alphabet, u) || isSeparatorUnit(u, true)))
+    {
+      ++score.ascii;
+    }
+    last = u;
+  }
+  for (unsigned q = 0; q < 2; ++q)
+  {
+    for (size_t k = q; k + 3 < n; k += 2)
+    {
+      uint32_t u = p[k] | (static_cast<uint32_t>(p[k + 1]) << 8);
+      uint32_t next = p[k + 2] | (static_cast<uint32_t>(p[k + 3]) << 8);
+      if (u >= 0x80 && inAlphabet(alphabet, u) &&
+          (inAlphabet(alphabet, next) || isSeparatorUnit(next, true)))
+      {
+        ++score.wide[parity ^ q];
+      }
+    }
+  }
+}
+
+/// `alphabet` is null when the lists are ASCII only.
+BlockScore scoreBlock(const uint8_t* p, size_t n, unsigned parity, const uint64_t* alphabet)
+{
+  uint8_t tail[BLOCK];
+  if (n < BLOCK)
+  {
+    std::memset(tail, 0xff, BLOCK);  // neither letter nor zero
+    std::memcpy(tail, p, n);
+    p = tail;
+  }
+  uint64_t letters = 0;
+  uint64_t zeros = 0;
+  classify64(p, letters, zeros);
+  constexpr uint64_t EVEN_BITS = 0x5555555555555555ull;
+  uint64_t runs8 = letters & (letters >> 1) & (letters >> 2);
+  uint64_t units16 = letters & (zeros >> 1);
+  uint64_t runs16 = units16 & (units16 >> 2) & (units16 >> 4);
+
+  BlockScore score;
+  score.ascii = popcount64(runs8);
+  score.wide[parity] = popcount64(runs16 & EVEN_BITS);
+  score.wide[parity ^ 1] = popcount64(runs16 & ~EVEN_BITS);
+  if (alphabet != nullptr && !score.dense())
+  {
+    scoreAlphabet(p, std::min(n, BLOCK), parity, alphabet, score);
+  }
+  return score;
+}
+
+size_t utf8Encode(uint32_t u, uint8_t* out)
+{
+  if (u < 0x80)
+  {
+    out[0] = static_cast<uint8_t>(u);
+    return 1;
+  }
+  if (u < 0x800)
+  {
+    out[0] = static_cast<uint8_t>(0xc0 | (u >> 6));
+    out[1] = static_cast<uint8_t>(0x80 | (u & 0x3f));
+    return 2;
+  }
+  out[0] = static_cast<uint8_t>(0xe0 | (u >> 12));
+  out[1] = static_cast<uint8_t>(0x80 | ((u >> 6) & 0x3f));
+  out[2] = static_cast<uint8_t>(0x80 | (u & 0x3f));
+  return 3;
+}
+
+}  // namespace
+
+std::string SeedPhrase::text() const
+{
+  std::string out;
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    if (i > 0)
+    {
+      out += ' ';
+    }
+    out += wordlist->word(indices[i]);
+  }
+  return out;
+}
+
+// Tokeniser and run tracker for one encoding at one byte phase. Fed with
+// consecutive device ranges; keeps partial words and runs across feeds.
+class SeedPhraseDetector::Stream
+{
+public:
+  Stream(const std::vector<const Bip39Wordlist*>& lists, const std::vector<uint64_t>& alphabet,
+         TextEncoding encoding, unsigned phase, uint64_t own_begin, uint64_t own_end,
+         std::vector<SeedPhrase>& out)
+    : lists_(lists), alphabet_(alphabet), encoding_(encoding), phase_(phase),
+      own_begin_(own_begin), own_end_(own_end), out_(out), runs_(lists.size())
+  {
+  }
+
+  void feed(const uint8_t* data, size_t size, uint64_t base)
+  {
+    if (encoding_ == TextEncoding::Ascii)
+    {
+      for (size_t i = 0; i < size; ++i)
+      {
+        unit(data[i], base + i, 1);
+      }
+      return;
+    }
+    for (size_t i = 0; i < size; ++i)
+    {
+      uint64_t pos = base + i;
+      if (!has_pending_)
+      {
+        if ((pos & 1) != phase_)
+        {
+          continue;
+        }
+        pending_ = data[i];
+        pending_pos_ = pos;
+        has_pending_ = true;
+        continue;
+      }
+      has_pending_ = false;
+      uint32_t u = static_cast<uint32_t>(pending_) | (static_cast<uint32_t>(data[i]) << 8);
+      unit(u, pending_pos_, 2);
+    }
+  }
+
+  void flush()
+  {
+    endWord();
+    for (size_t l = 0; l < runs_.size(); ++l)
+    {
+      closeRun(l);
+    }
+  }
+
+private:
+  struct Run
+  {
+    std::vector<uint16_t> indices;
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+  };
+
+  void unit(uint32_t u, uint64_t pos, unsigned width)
+  {
+    if (encoding_ == TextEncoding::Ascii && ideographicSpace(u))
+    {
+      return;
+    }
+    uint32_t folded = u | 0x20;
+    bool ascii_letter = folded >= 'a' && folded <= 'z';
+    bool wide = encoding_ != TextEncoding::Ascii;
+    bool wide_letter = u >= 0x80 && (!wide || ((alphabet_[u >> 6] >> (u & 63)) & 1) != 0);
+    if (ascii_letter || wide_letter)
+    {
+      if (word_len_ == 0 && !word_overflow_)
+      {
+        word_start_ = pos;
+      }
+      uint8_t enc[3];
+      size_t n = 1;
+      if (ascii_letter)
+      {
+        enc[0] = static_cast<uint8_t>(folded);
+      }
+      else if (encoding_ == TextEncoding::Ascii)
+      {
+        enc[0] = static_cast<uint8_t>(u);
+      }
+      else
+      {
+        n = utf8Encode(u, enc);
+      }
+      if (word_len_ + n > BIP39_MAX_WORD_BYTES)
+      {
+        word_overflow_ = true;
+      }
+      else
+      {
+        std::copy(enc, enc + n, word_ + word_len_);
+        word_len_ += n;
+      }
+      word_end_ = pos + width;
+      return;
+    }
+    endWord();
+    if (!isSeparatorUnit(u, wide))
+    {
+      gap_broken_ = true;
+    }
+    ++gap_units_;
+  }
+
+  // UTF-8 text comes in byte by byte, so the bytes of U+3000 (E3 80 80) are
+  // taken as letters first; its last byte cuts the word back to before it
+  // and ends it, the space counting as one separator.
+  bool ideographicSpace(uint32_t byte)
+  {
+    if (space_seen_ == 2 && byte == 0x80)
+    {
+      space_seen_ = 0;
+      word_len_ = space_word_len_;
+      word_overflow_ = space_word_overflow_;
+      word_end_ = space_word_end_;
+      endWord();
+      ++gap_units_;
+      return true;
+    }
+    space_seen_ = space_seen_ == 1 && byte == 0x80 ? 2 : 0;
+    if (byte == 0xe3)
+    {
+      space_seen_ = 1;
+      space_word_len_ = word_len_;
+      space_word_overflow_ = word_overflow_;
+      space_word_end_ = word_end_;
+    }
+    return false;
+  }
+
+  void endWord()
+  {
+    if (word_len_ == 0 && !word_overflow_)
+    {
+      return;
+    }
+    bool joinable = !gap_broken_ && gap_units_ <= MAX_GAP_UNITS;
+    for (size_t l = 0; l < runs_.size(); ++l)
+    {
+      int idx = word_overflow_ ? -1 : lists_[l]->lookup(word_, word_len_);
+      Run& run = runs_[l];
+      if (idx < 0 || !joinable || run.indices.size() == MAX_RUN_WORDS)
+      {
+        closeRun(l);
+      }
+      if (idx >= 0)
+      {
+        run.indices.push_back(static_cast<uint16_t>(idx));
+        run.starts.push_back(word_start_);
+        run.ends.push_back(word_end_);
+      }
+    }
+    word_len_ = 0;
+    word_overflow_ = false;
+    gap_units_ = 0;
+    gap_broken_ = false;
+  }
+
+  void closeRun(size_t l)
+  {
+    Run& run = runs_[l];
+    size_t n = run.indices.size();
+    size_t i = 0;
+    while (n >= MIN_WORDS && i + MIN_WORDS <= n)
+    {
+      size_t found = 0;
+      for (size_t len : PHRASE_LENGTHS)
+      {
+        if (i + len <= n && bip39ChecksumValid(run.indices.data() + i, len))
+        {
+          found = len;
+          break;
+        }
+      }
+      if (found == 0)
+      {
+        ++i;
+        continue;
+      }
+      uint64_t start = run.starts[i];
+      if (start >= own_begin_ && start < own_end_)
+      {
+        SeedPhrase phrase;
+        phrase.offset = start;
+        phrase.length = run.ends[i + found - 1] - start;
+        phrase.encoding = encoding_;
+        phrase.wordlist = lists_[l];
+        phrase.indices.assign(run.indices.begin() + static_cast<std::ptrdiff_t>(i),
+                              run.indices.begin() + static_cast<std::ptrdiff_t>(i + found));
+        out_.push_back(std::move(phrase));
+      }
+      i += found;
+    }
+    run.indices.clear();
+    run.starts.clear();
+    run.ends.clear();
+  }
+
+  const std::vector<const Bip39Wordlist*>& lists_;
+  const std::vector<uint64_t>& alphabet_;
+  TextEncoding encoding_;
+  unsigned phase_;
+  uint64_t own_begin_;
+  uint64_t own_end_;
+  std::vector<SeedPhrase>& out_;
+  std::vector<Run> runs_;
+
+  uint8_t word_[BIP39_MAX_WORD_BYTES];
+  size_t word_len_ = 0;
+  bool word_overflow_ = false;
+  uint64_t word_start_ = 0;
+  uint64_t word_end_ = 0;
+  size_t gap_units_ = 0;
+  bool gap_broken_ = false;
+  uint8_t pending_ = 0;
+  uint64_t pending_pos_ = 0;
+  bool has_pending_ = false;
+  unsigned space_seen_ = 0;  // leading bytes of a UTF-8 U+3000 just taken
+  size_t space_word_len_ = 0;
+  bool space_word_overflow_ = false;
+  uint64_t space_word_end_ = 0;
+};
+
+SeedPhraseDetector::SeedPhraseDetector(std::vector<const Bip39Wordlist*> lists)
+  : lists_(std::move(lists))
+{
+  if (lists_.empty())
+  {
+    lists_.push_back(&Bip39Wordlist::english());
+  }
+  if (lists_.size() > MAX_LISTS)
+  {
+    lists_.resize(MAX_LISTS);
+  }
+  alphabet_.assign(65536 / 64, 0);
+  for (const Bip39Wordlist* list : lists_)
+  {
+    for (size_t i = 0; i < BIP39_WORD_COUNT; ++i)
+    {
+      const std::string& word = list->word(i);
+      for (size_t k = 0; k < word.size(); ++k)
+      {
+        uint32_t u = utf8Decode(reinterpret_cast<const uint8_t*>(word.data()), word.size(), k);
+        if (u >= 0x80 && u < 0x10000)
+        {
+          alphabet_[u >> 6] |= uint64_t(1) << (u & 63);
+          non_ascii_ = true;
+        }
+      }
+    }
+  }
+}
+
+bool SeedPhraseDetector::startsInText(ByteView data) const
+{
+  return !data.empty() &&
+         scoreBlock(data.data, std::min(data.size, BLOCK), 0, letters()).dense();
+}
+
+void SeedPhraseDetector::scan(ByteView context, ByteView data, uint64_t base, uint64_t own_begin,
+                              uint64_t own_end, std::vector<SeedPhrase>& out) const
+{
+  size_t blocks = (data.size + BLOCK - 1) / BLOCK;
+  unsigned parity = static_cast<unsigned>(base & 1);
+  auto score = [&](size_t b) {
+    return scoreBlock(data.data + b * BLOCK, std::min(BLOCK, data.size - b * BLOCK), parity,
+                      letters());
+  };
+
+  size_t b = 0;
+  while (b < blocks)
+  {
+    // Find the next dense block, then the end of the dense region.
+    BlockScore total;
+    while (b < blocks && !(total = score(b)).dense())
+    {
+      ++b;
+    }
+    if (b == blocks)
+    {
+      break;
+    }
+    size_t first = b++;
+    while (b < blocks)
+    {
+      BlockScore next = score(b);
+      if (!next.dense())
+      {
+        break;
+      }
+      total.add(next);
+      ++b;
+    }
+    size_t begin = (first > 0 ? first - 1 : 0) * BLOCK;
+    size_t end = std::min(data.size, (b + 1) * BLOCK);
+    if (base + begin >= own_end)
+    {
+      break;
+    }
+    bool with_context = begin == 0 && !context.empty();
+
+    auto run = [&](TextEncoding encoding, unsigned phase) {
+      Stream stream(lists_, alphabet_, encoding, phase, own_begin, own_end, out);
+      if (with_context)
+      {
+        stream.feed(context.data, context.size, base - context.size);
+      }
+      stream.feed(data.data + begin, end - begin, base + begin);
+      stream.flush();
+    };
+    if (total.ascii >= DENSE_RUNS)
+    {
+      run(TextEncoding::Ascii, 0);
+    }
+    for (unsigned phase = 0; phase < 2; ++phase)
+    {
+      if (total.wide[phase] >= DENSE_RUNS)
+      {
+        run(TextEncoding::Utf16Le, phase);
+      }
+    }
+    ++b;  // the block that ended the region is not dense
+  }
+}
+
+void SeedPhraseStage::registerPatterns(PatternSet& /*patterns*/)
+{
+  // Called as a run starts: the phrases kept are those of one run.
+  std::lock_guard<std::mutex> lock(mutex_);
+  phrases_.clear();
+}
+
+void SeedPhraseStage::onChunk(const ChunkView& chunk, CarveContext& ctx)
+{
+  SecureBytes context;
+  if (chunk.offset > 0 && detector_.startsInText(chunk.view()))
+  {
+    uint64_t back = std::min<uint64_t>(chunk.offset, SeedPhraseDetector::MAX_PHRASE_SPAN);
+    context = ctx.readAt(chunk.offset - back, static_cast<size_t>(back));
+  }
+  std::vector<SeedPhrase> found;
+  detector_.scan(ByteView(context.data(), context.size()), chunk.view(), chunk.offset,
+                 chunk.offset, chunk.offset + chunk.body, found);
+  if (found.empty())
+  {
+    return;
+  }
+  for (const auto& phrase : found)
+  {
+    RecoveredFile file;
+    file.type = "seed/bip39";
+    file.source = name();
+    file.offset = phrase.offset;
+    file.size = phrase.length;
+    file.confidence = phrase.indices.size() >= 18 ? 0.99 : 0.9;
+    file.description = std::to_string(phrase.indices.size()) + "-word BIP39 mnemonic (" +
+                       phrase.wordlist->name() +
+                       (phrase.encoding == TextEncoding::Utf16Le ? ", utf-16)" : ")");
+    ctx.registry().add(std::move(file));
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  phrases_.insert(phrases_.end(), found.begin(), found.end());
+}
+
+std::vector<SeedPhrase> SeedPhraseStage::phrases() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return phrases_;
+}
+
+}  // namespace rsn
@@ -0,0 +1,106 @@
+// RecoverySoftNetz — streaming BIP39 seed phrase detector
+//
+// Finds runs of 12/15/18/21/24 consecutive wordlist words directly in raw
+// sectors, in 8-bit text (ASCII/UTF-8) and UTF-16 at either byte phase, and
+// validates the mnemonic checksum in-line. Nothing is materialised beyond the
+// chunk being scanned.
+//
+// A vectorised classifier first marks 64-byte blocks that are dense in
+// letters; only those regions (plus one block of margin) are tokenised, so
+// binary and zero-filled sectors cost a handful of instructions per block.
+// Lists with letters outside ASCII (CJK, Hangul, kana) add a scalar pass
+// over blocks the classifier finds sparse, scoring those letters.
+// Separators may be whitespace (U+3000 included), punctuation or list
+// numbering ("1. ", "2) ").
+
+#pragma once
+
+#include "blockchain/bip39_wordlist.h"
+#include "common/utils.h"
+#include "core/carve_pipeline.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+enum class TextEncoding : uint8_t
+{
+  Ascii,    // 8-bit text, ASCII or UTF-8
+  Utf16Le,  // UTF-16 little endian (big endian ASCII text appears at the other phase)
+};
+
+struct SeedPhrase
+{
+  uint64_t offset = 0;   // device offset of the first word
+  uint64_t length = 0;   // bytes up to the end of the last word
+  TextEncoding encoding = TextEncoding::Ascii;
+  const Bip39Wordlist* wordlist = nullptr;
+  std::vector<uint16_t> indices;
+
+  /// Words joined by single spaces.
+  std::string text() const;
+};
+
+class SeedPhraseDetector
+{
+public:
+  static constexpr size_t MAX_LISTS = 8;
+  static constexpr size_t MAX_RUN_WORDS = 48;
+  static constexpr size_t MAX_GAP_UNITS = 8;
+  /// Bytes that can separate a phrase start from its end in the worst case.
+  static constexpr size_t MAX_PHRASE_SPAN =
+    MAX_RUN_WORDS * (BIP39_MAX_WORD_BYTES + MAX_GAP_UNITS) * 2;
+
+  explicit SeedPhraseDetector(std::vector<const Bip39Wordlist*> lists = {});
+
+  /// Scan `data`, located at device offset `base`, and append phrases whose
+  /// first word starts in [own_begin, own_end). `context` holds the bytes that
+  /// immediately precede `data`; it is only used to recognise runs that began
+  /// earlier and may be empty.
+  void scan(ByteView context, ByteView data, uint64_t base, uint64_t own_begin, uint64_t own_end,
+            std::vector<SeedPhrase>& out) const;
+
+  /// True when text at the very start of `data` may continue from preceding bytes.
+  bool startsInText(ByteView data) const;
+
+private:
+  class Stream;
+
+  /// The letters outside ASCII for block scoring, or null when there are none.
+  const uint64_t* letters() const { return non_ascii_ ? alphabet_.data() : nullptr; }
+
+  std::vector<const Bip39Wordlist*> lists_;
+  // Bit u set when UTF-16 unit u >= 0x80 occurs in a word of one of the lists.
+  // Any other unit ends a word, so a unit pairing bytes of two alignments (a
+  // stray byte and the next character) cannot glue onto the first word.
+  std::vector<uint64_t> alphabet_;
+  bool non_ascii_ = false;
+};
+
+/// Carve stage wrapping the detector; results go to the registry as
+/// "seed/bip39" entries and are kept for `phrases()`.
+class SeedPhraseStage : public CarveStage
+{
+public:
+  explicit SeedPhraseStage(std::vector<const Bip39Wordlist*> lists = {}) : detector_(lists) {}
+
+  const char* name() const override { return "bip39"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t, size_t, const ChunkView&, CarveContext&) override { return false; }
+  bool wantsChunks() const override { return true; }
+  void onChunk(const ChunkView& chunk, CarveContext& ctx) override;
+  size_t lookahead() const override { return SeedPhraseDetector::MAX_PHRASE_SPAN; }
+
+  /// Phrases found by the last run.
+  std::vector<SeedPhrase> phrases() const;
+
+private:
+  SeedPhraseDetector detector_;
+  mutable std::mutex mutex_;
+  std::vector<SeedPhrase> phrases_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,411 @@
+// RecoverySoftNetz — raw-device wallet artifact scanner
+
+#include "blockchain/wallet_scanner.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+// Berkeley DB metadata page (DBMETA) layout.
+constexpr size_t BDB_MAGIC_OFFSET = 12;
+constexpr uint32_t BDB_BTREE_MAGIC = 0x00053162;
+constexpr uint8_t BDB_PAGE_BTREEMETA = 9;
+constexpr uint64_t BDB_MAX_WALLET_SIZE = 1ull << 30;
+constexpr size_t BDB_MARKER_WINDOW = 1u << 20;
+
+constexpr size_t JSON_BACK_WINDOW = 2048;
+constexpr size_t JSON_FORWARD_WINDOW = 8192;
+constexpr size_t ELECTRUM_JSON_WINDOW = 1u << 20;
+constexpr size_t ELECTRUM_MIN_BASE64 = 128;
+constexpr size_t EXODUS_MAX_SIZE = 64 * 1024;
+constexpr size_t METAMASK_WINDOW = 64 * 1024;
+
+bool isTextByte(uint8_t c)
+{
+  return c == '\t' || c == '\n' || c == '\r' || (c >= 0x20 && c < 0x7f);
+}
+
+bool isBase64Byte(uint8_t c)
+{
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+         c == '+' || c == '/' || c == '=';
+}
+
+bool contains(ByteView hay, const char* lit)
+{
+  return findBytes(hay, lit, std::strlen(lit)) != SIZE_MAX;
+}
+
+// Outermost '{' that encloses `pos`, walking back over text bytes only.
+size_t findObjectStart(ByteView buf, size_t pos)
+{
+  size_t best = SIZE_MAX;
+  int depth = 0;
+  for (size_t i = pos; i-- > 0;)
+  {
+    uint8_t c = buf[i];
+    if (!isTextByte(c))
+    {
+      break;
+    }
+    if (c == '}')
+    {
+      ++depth;
+    }
+    else if (c == '{')
+    {
+      if (depth == 0)
+      {
+        best = i;
+      }
+      else
+      {
+        --depth;
+      }
+    }
+  }
+  return best;
+}
+
+// One past the '}' closing the object opened at `start`, honouring strings.
+size_t findObjectEnd(ByteView buf, size_t start)
+{
+  int depth = 0;
+  bool in_string = false;
+  for (size_t i = start; i < buf.size; ++i)
+  {
+    uint8_t c = buf[i];
+    if (!isTextByte(c))
+    {
+      return SIZE_MAX;
+    }
+    if (in_string)
+    {
+      if (c == '\\')
+      {
+        ++i;
+      }
+      else if (c == '"')
+      {
+        in_string = false;
+      }
+      continue;
+    }
+    if (c == '"')
+    {
+      in_string = true;
+    }
+    else if (c == '{')
+    {
+      ++depth;
+    }
+    else if (c == '}' && --depth == 0)
+    {
+      return i + 1;
+    }
+  }
+  return SIZE_MAX;
+}
+
+size_t base64RunLength(ByteView buf, size_t pos)
+{
+  size_t i = pos;
+  while (i < buf.size && isBase64Byte(buf[i]))
+  {
+    ++i;
+  }
+  return i - pos;
+}
+
+}  // namespace
+
+void WalletArtifactStage::registerPatterns(PatternSet& patterns)
+{
+  static const uint8_t BDB_MAGIC_LE[] = {0x62, 0x31, 0x05, 0x00};
+  patterns.add(BDB_MAGIC_LE, sizeof(BDB_MAGIC_LE), TAG_BDB_BTREE_MAGIC);
+  patterns.add(std::string("\"ciphertext\""), TAG_JSON_CIPHERTEXT);
+  patterns.add(std::string("QklFMQ"), TAG_ELECTRUM_BIE1);
+  patterns.add(std::string("\"seed_version\""), TAG_ELECTRUM_SEED_VERSION);
+  patterns.add(std::string("seco-v0-scrypt-aes"), TAG_EXODUS_SECO_VERSION);
+  patterns.add(std::string("{\"data\":\""), TAG_METAMASK_DATA);
+  patterns.add(std::string("{\\\"data\\\":\\\""), TAG_METAMASK_DATA_ESCAPED);
+}
+
+bool WalletArtifactStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk,
+                                 CarveContext& ctx)
+{
+  uint64_t offset = chunk.offset + pos;
+
+  // Cheap positional filters first: a meta page starts on a sector boundary.
+  if (tag == TAG_BDB_BTREE_MAGIC &&
+      (offset < BDB_MAGIC_OFFSET || (offset - BDB_MAGIC_OFFSET) % ctx.device().sectorSize() != 0))
+  {
+    return false;
+  }
+
+  candidates_.fetch_add(1, std::memory_order_relaxed);
+  bool ok = false;
+  switch (tag)
+  {
+  case TAG_BDB_BTREE_MAGIC:
+    ok = validateBerkeleyDb(offset - BDB_MAGIC_OFFSET, ctx);
+    break;
+  case TAG_JSON_CIPHERTEXT:
+    ok = validateKeystore(offset, ctx);
+    break;
+  case TAG_ELECTRUM_BIE1:
+    ok = validateElectrumEncrypted(offset, ctx);
+    break;
+  case TAG_ELECTRUM_SEED_VERSION:
+    ok = validateElectrumJson(offset, ctx);
+    break;
+  case TAG_EXODUS_SECO_VERSION:
+    ok = validateExodus(offset, ctx);
+    break;
+  case TAG_METAMASK_DATA:
+    ok = validateMetaMask(offset, false, ctx);
+    break;
+  case TAG_METAMASK_DATA_ESCAPED:
+    ok = validateMetaMask(offset, true, ctx);
+    break;
+  default:
+    break;
+  }
+  if (ok)
+  {
+    confirmed_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ok;
+}
+
+bool WalletArtifactStage::validateBerkeleyDb(uint64_t offset, CarveContext& ctx)
+{
+  auto meta = ctx.readAt(offset, 512);
+  if (meta.size() < 64)
+  {
+    return false;
+  }
+  const uint8_t* p = meta.data();
+  uint32_t pgno = loadLE32(p + 8);
+  uint32_t magic = loadLE32(p + 12);
+  uint32_t version = loadLE32(p + 16);
+  uint32_t pagesize = loadLE32(p + 20);
+  uint8_t page_type = p[25];
+  uint32_t last_pgno = loadLE32(p + 32);
+  if (pgno != 0 || magic != BDB_BTREE_MAGIC || version < 7 || version > 10 ||
+      page_type != BDB_PAGE_BTREEMETA || !isPowerOfTwo(pagesize) || pagesize < 512 ||
+      pagesize > 65536)
+  {
+    return false;
+  }
+  uint64_t size = (static_cast<uint64_t>(last_pgno) + 1) * pagesize;
+  if (size > BDB_MAX_WALLET_SIZE)
+  {
+    return false;
+  }
+
+  // A Bitcoin Core wallet stores length-prefixed record type keys.
+  auto body = ctx.readAt(offset, static_cast<size_t>(std::min<uint64_t>(size, BDB_MARKER_WINDOW)));
+  ByteView view(body.data(), body.size());
+  bool has_key = contains(view, "\x03key") || contains(view, "\x04ckey");
+  bool has_mkey = contains(view, "\x04mkey");
+  bool has_meta = contains(view, "\x07version") || contains(view, "\x0a" "defaultkey") ||
+                  contains(view, "\x0a" "minversion") || contains(view, "\x04name");
+  if (!has_key && !has_mkey && !has_meta)
+  {
+    return false;
+  }
+
+  RecoveredFile file;
+  file.type = "wallet/bitcoin_core";
+  file.source = name();
+  file.offset = offset;
+  file.size = size;
+  file.confidence = has_key || has_mkey ? 0.95 : 0.7;
+  file.description = has_mkey ? "Berkeley DB wallet, encrypted (mkey)" : "Berkeley DB wallet";
+  ctx.registry().add(std::move(file));
+  return true;
+}
+
+bool WalletArtifactStage::validateKeystore(uint64_t offset, CarveContext& ctx)
+{
+  uint64_t base = offset > JSON_BACK_WINDOW ? offset - JSON_BACK_WINDOW : 0;
+  auto buf = ctx.readAt(base, static_cast<size_t>(offset - base) + JSON_FORWARD_WINDOW);
+  ByteView view(buf.data(), buf.size());
+  size_t start = findObjectStart(view, static_cast<size_t>(offset - base));
+  if (start == SIZE_MAX)
+  {
+    return false;
+  }
+  size_t end = findObjectEnd(view, start);
+  if (end == SIZE_MAX)
+  {
+    return false;
+  }
+  ByteView obj = view.sub(start, end - start);
+  bool has_crypto = contains(obj, "\"crypto\"") || contains(obj, "\"Crypto\"");
+  if (!has_crypto || !contains(obj, "\"cipherparams\"") || !contains(obj, "\"kdf\"") ||
+      !contains(obj, "\"mac\""))
+  {
+    return false;
+  }
+
+  RecoveredFile file;
+  file.type = "wallet/ethereum_keystore";
+  file.source = name();
+  file.offset = base + start;
+  file.size = obj.size;
+  file.confidence = contains(obj, "\"version\"") ? 0.95 : 0.8;
+  file.description = contains(obj, "\"scrypt\"") ? "JSON keystore, scrypt"
+                                                  : "JSON keystore, pbkdf2";
+  ctx.registry().add(std::move(file));
+  return true;
+}
+
+bool WalletArtifactStage::validateElectrumEncrypted(uint64_t offset, CarveContext& ctx)
+{
+  // The whole file is one base64 run of ECIES ("BIE1") ciphertext.
+  if (offset >= 1)
+  {
+    auto prev = ctx.readAt(offset - 1, 1);
+    if (!prev.empty() && isBase64Byte(prev[0]))
+    {
+      return false;  // inside a longer base64 blob
+    }
+  }
+  auto buf = ctx.readAt(offset, ELECTRUM_JSON_WINDOW);
+  size_t run = base64RunLength(ByteView(buf.data(), buf.size()), 0);
+  if (run < ELECTRUM_MIN_BASE64)
+  {
+    return false;
+  }
+  bool aligned = offset % ctx.device().sectorSize() == 0;
+
+  RecoveredFile file;
+  file.type = "wallet/electrum";
+  file.source = name();
+  file.offset = offset;
+  file.size = run;
+  file.confidence = aligned ? 0.85 : 0.6;
+  file.description = "Electrum wallet, encrypted (BIE1)";
+  ctx.registry().add(std::move(file));
+  return true;
+}
+
+bool WalletArtifactStage::validateElectrumJson(uint64_t offset, CarveContext& ctx)
+{
+  uint64_t base = offset > JSON_BACK_WINDOW ? offset - JSON_BACK_WINDOW : 0;
+  auto buf = ctx.readAt(base, static_cast<size_t>(offset - base) + ELECTRUM_JSON_WINDOW);
+  ByteView view(buf.data(), buf.size());
+  size_t start = findObjectStart(view, static_cast<size_t>(offset - base));
+  if (start == SIZE_MAX)
+  {
+    return false;
+  }
+  size_t end = findObjectEnd(view, start);
+  if (end == SIZE_MAX)
+  {
+    return false;
+  }
+  ByteView obj = view.sub(start, end - start);
+  if (!contains(obj, "\"wallet_type\"") && !contains(obj, "\"keystore\""))
+  {
+    return false;
+  }
+
+  RecoveredFile file;
+  file.type = "wallet/electrum";
+  file.source = name();
+  file.offset = base + start;
+  file.size = obj.size;
+  file.confidence = contains(obj, "\"use_encryption\": true") ? 0.9 : 0.85;
+  file.description = "Electrum wallet, JSON";
+  ctx.registry().add(std::move(file));
+  return true;
+}
+
+bool WalletArtifactStage::validateExodus(uint64_t offset, CarveContext& ctx)
+{
+  // "SECO" magic, version and reserved words precede the version tag.
+  constexpr size_t BACK = 32;
+  uint64_t base = offset > BACK ? offset - BACK : 0;
+  auto head = ctx.readAt(base, static_cast<size_t>(offset - base) + 512);
+  ByteView view(head.data(), head.size());
+  size_t magic = findBytes(view.sub(0, static_cast<size_t>(offset - base)), "SECO", 4);
+  if (magic == SIZE_MAX || !contains(view, "aes-256-gcm"))
+  {
+    return false;
+  }
+
+  // Containers are small; extent ends at the first all-zero sector.
+  uint64_t start = base + magic;
+  auto body = ctx.readAt(start, EXODUS_MAX_SIZE);
+  size_t sector = ctx.device().sectorSize();
+  size_t size = body.size();
+  for (size_t s = sector; s + sector <= body.size(); s += sector)
+  {
+    if (std::all_of(body.begin() + static_cast<std::ptrdiff_t>(s),
+                    body.begin() + static_cast<std::ptrdiff_t>(s + sector),
+                    [](uint8_t b) { return b == 0; }))
+    {
+      size = s;
+      break;
+    }
+  }
+
+  RecoveredFile file;
+  file.type = "wallet/exodus";
+  file.source = name();
+  file.offset = start;
+  file.size = size;
+  file.confidence = 0.9;
+  file.description = "Exodus secure container (seco-v0-scrypt-aes)";
+  ctx.registry().add(std::move(file));
+  return true;
+}
+
+bool WalletArtifactStage::validateMetaMask(uint64_t offset, bool escaped, CarveContext& ctx)
+{
+  auto buf = ctx.readAt(offset, METAMASK_WINDOW);
+  ByteView view(buf.data(), buf.size());
+  const char* iv_key = escaped ? "\\\"iv\\\":\\\"" : "\"iv\":\"";
+  const char* salt_key = escaped ? "\\\"salt\\\":\\\"" : "\"salt\":\"";
+  size_t data_pos = escaped ? 12 : 9;
+  if (base64RunLength(view, data_pos) < 32)
+  {
+    return false;
+  }
+  size_t iv = findBytes(view, iv_key, std::strlen(iv_key));
+  size_t salt = findBytes(view, salt_key, std::strlen(salt_key));
+  if (iv == SIZE_MAX || salt == SIZE_MAX)
+  {
+    return false;
+  }
+  size_t tail = std::max(iv, salt);
+  size_t end = findBytes(view.sub(tail), "}", 1);
+  if (end == SIZE_MAX)
+  {
+    return false;
+  }
+  end += tail + 1;
+
+  auto before = ctx.readAt(offset > 32 ? offset - 32 : 0, offset > 32 ? 32 : offset);
+  bool under_vault_key = contains(ByteView(before.data(), before.size()), "vault");
+
+  RecoveredFile file;
+  file.type = "wallet/metamask";
+  file.source = name();
+  file.offset = offset;
+  file.size = end;
+  file.confidence = under_vault_key ? 0.95 : 0.75;
+  file.description = escaped ? "MetaMask vault (LevelDB string)" : "MetaMask vault";
+  ctx.registry().add(std::move(file));
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,56 @@
+// RecoverySoftNetz — raw-device wallet artifact scanner
+//
+// Carve stage that finds cryptocurrency wallet artifacts anywhere on the
+// device, including unallocated space, instead of matching live file names.
+// Signatures are registered with the pipeline's shared matcher; each hit is
+// confirmed by a structural validator before it reaches the registry.
+//
+//   wallet/bitcoin_core       Berkeley DB btree meta page + wallet record keys
+//   wallet/ethereum_keystore  Web3 Secret Storage (v3) JSON keystore
+//   wallet/electrum           BIE1-encrypted or plain JSON Electrum wallet
+//   wallet/exodus             Exodus secure container (SECO)
+//   wallet/metamask           MetaMask vault blob (data/iv/salt)
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+
+#include <atomic>
+
+namespace rsn
+{
+
+class WalletArtifactStage : public CarveStage
+{
+public:
+  const char* name() const override { return "wallet"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+
+  uint64_t candidates() const { return candidates_.load(); }
+  uint64_t confirmed() const { return confirmed_.load(); }
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_BDB_BTREE_MAGIC,
+    TAG_JSON_CIPHERTEXT,
+    TAG_ELECTRUM_BIE1,
+    TAG_ELECTRUM_SEED_VERSION,
+    TAG_EXODUS_SECO_VERSION,
+    TAG_METAMASK_DATA,
+    TAG_METAMASK_DATA_ESCAPED,
+  };
+
+  bool validateBerkeleyDb(uint64_t offset, CarveContext& ctx);
+  bool validateKeystore(uint64_t offset, CarveContext& ctx);
+  bool validateElectrumEncrypted(uint64_t offset, CarveContext& ctx);
+  bool validateElectrumJson(uint64_t offset, CarveContext& ctx);
+  bool validateExodus(uint64_t offset, CarveContext& ctx);
+  bool validateMetaMask(uint64_t offset, bool escaped, CarveContext& ctx);
+
+  std::atomic<uint64_t> candidates_{0};
+  std::atomic<uint64_t> confirmed_{0};
+};
+
+}  // namespace rsn
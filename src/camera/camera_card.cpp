@@ -0,0 +1,641 @@
+// RecoverySoftNetz — camera card fast path
+
+#include "camera/camera_card.h"
+
+#include "camera/camera_media.h"
+#include "common/utils.h"
+#include "filesystems/fat_volume.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <tuple>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint64_t NO_UNIT = UINT64_MAX;
+constexpr double CONFIDENCE_LISTED = 1.0;
+constexpr double CONFIDENCE_BROKEN_CHAIN = 0.5;
+constexpr double CONFIDENCE_UNDELETED = 0.9;
+constexpr double CONFIDENCE_UNDELETED_UNCHECKED = 0.5;  // contiguous, not a known media type
+constexpr double CONFIDENCE_CARVED = 0.8;
+
+struct ExtensionType
+{
+  const char* extension;
+  const char* type;
+};
+
+const ExtensionType EXTENSION_TYPES[] = {
+  {"JPG", "image/jpeg"}, {"JPEG", "image/jpeg"}, {"THM", "image/jpeg"}, {"CR2", "image/cr2"},
+  {"CR3", "image/cr3"},  {"NEF", "image/nef"},   {"ARW", "image/arw"},  {"DNG", "image/dng"},
+  {"ORF", "image/orf"},  {"RW2", "image/rw2"},   {"PEF", "image/pef"},  {"RAF", "image/raf"},
+  {"HEIC", "image/heic"}, {"HIF", "image/heic"}, {"MP4", "video/mp4"},  {"LRV", "video/mp4"},
+  {"MOV", "video/mov"},  {"MTS", "video/mts"},   {"WAV", "audio/wav"},
+};
+
+std::string upperExtension(const std::string& path)
+{
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+  {
+    return std::string();
+  }
+  std::string ext = path.substr(dot + 1);
+  for (char& c : ext)
+  {
+    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+  return ext;
+}
+
+bool rawExtension(const std::string& ext)
+{
+  return ext != "JPG" && ext != "JPEG" && ext.size() == 3 && ext[0] != 'M' && ext != "WAV" &&
+         ext != "LRV" && ext != "THM";
+}
+
+/// Camera-style name: directory, prefix, trailing number and extension.
+struct CameraName
+{
+  uint64_t unit = 0;  // first allocation unit of the file
+  std::string directory;
+  std::string prefix;
+  uint32_t number = 0;
+  size_t digits = 0;
+  std::string extension;
+};
+
+bool parseCameraName(const std::string& path, CameraName& out)
+{
+  size_t slash = path.find_last_of('/');
+  size_t dot = path.find_last_of('.');
+  size_t start = slash == std::string::npos ? 0 : slash + 1;
+  if (dot == std::string::npos || dot <= start)
+  {
+    return false;
+  }
+  size_t digits_start = dot;
+  while (digits_start > start && std::isdigit(static_cast<unsigned char>(path[digits_start - 1])))
+  {
+    --digits_start;
+  }
+  size_t digits = dot - digits_start;
+  if (digits < 3 || digits > 9)
+  {
+    return false;
+  }
+  out.directory = path.substr(0, start);
+  out.prefix = path.substr(start, digits_start - start);
+  out.number = static_cast<uint32_t>(std::stoul(path.substr(digits_start, digits)));
+  out.digits = digits;
+  out.extension = upperExtension(path);
+  return true;
+}
+
+// FAT deletion overwrites the first byte of a short name ("_MG_0002.JPG").
+// A named file in the same directory whose prefix differs only there restores it.
+std::string restoreDeletedName(const std::string& path, const std::vector<CameraName>& names)
+{
+  CameraName deleted;
+  if (!parseCameraName(path, deleted) || deleted.prefix.empty() || deleted.prefix[0] != '_')
+  {
+    return path;
+  }
+  for (const CameraName& name : names)
+  {
+    if (name.directory == deleted.directory && name.prefix.size() == deleted.prefix.size() &&
+        name.prefix.compare(1, std::string::npos, deleted.prefix, 1, std::string::npos) == 0)
+    {
+      std::string restored = path;
+      restored[deleted.directory.size()] = name.prefix[0];
+      return restored;
+    }
+  }
+  return path;
+}
+
+/// Units a file occupies, as runs of consecutive unit numbers.
+struct UnitRun
+{
+  uint64_t first;
+  uint64_t count;
+};
+using Layout = std::vector<UnitRun>;
+
+uint64_t unitCount(const Layout& layout)
+{
+  uint64_t total = 0;
+  for (const UnitRun& run : layout)
+  {
+    total += run.count;
+  }
+  return total;
+}
+
+void appendUnit(Layout& layout, uint64_t unit)
+{
+  if (!layout.empty() && layout.back().first + layout.back().count == unit)
+  {
+    ++layout.back().count;
+  }
+  else
+  {
+    layout.push_back({unit, 1});
+  }
+}
+
+void truncateLayout(Layout& layout, uint64_t units)
+{
+  for (size_t i = 0; i < layout.size(); ++i)
+  {
+    if (units <= layout[i].count)
+    {
+      layout[i].count = units;
+      layout.resize(units == 0 ? i : i + 1);
+      return;
+    }
+    units -= layout[i].count;
+  }
+}
+
+/// Allocation units of the card: volume clusters, or device sectors without a volume.
+class CardRun
+{
+public:
+  CardRun(Device& device, FileRegistry& registry, const CameraCardOptions& options,
+          CameraCardStats& stats)
+    : device_(device), registry_(registry), options_(options), stats_(stats)
+  {
+  }
+
+  void run(FatVolume* volume);
+
+private:
+  bool usable(uint64_t unit) const
+  {
+    return volume_ == nullptr ||
+           (!claimed_[unit - first_] && !volume_->isAllocated(static_cast<uint32_t>(unit)));
+  }
+  uint64_t nextUsable(uint64_t unit, uint64_t end) const
+  {
+    while (unit < end && !usable(unit))
+    {
+      ++unit;
+    }
+    return unit;
+  }
+  uint64_t offset(uint64_t unit) const
+  {
+    return volume_ != nullptr ? volume_->clusterOffset(static_cast<uint32_t>(unit))
+                              : unit * unit_size_;
+  }
+  bool extendFree(Layout& layout, uint64_t units);
+  void claim(const Layout& layout);
+
+  size_t readDevice(uint64_t at, uint8_t* out, size_t length);
+  MediaReader streamReader(Layout& layout, bool follow_free);
+  bool measure(bool follow_free, MediaInfo& info, Layout& layout);
+  std::vector<Extent> extentsOf(const Layout& layout, uint64_t size) const;
+
+  void listLive();
+  void undelete();
+  void carve();
+  void carveRange(uint64_t begin, uint64_t end);
+  void nameCarved();
+  void add(const std::string& type, const std::string& source, uint64_t size,
+           double confidence, std::string description, std::vector<Extent> extents);
+
+  struct Carved
+  {
+    uint64_t unit;
+    MediaInfo info;
+    std::vector<Extent> extents;
+  };
+
+  Device& device_;
+  FileRegistry& registry_;
+  const CameraCardOptions& options_;
+  CameraCardStats& stats_;
+  FatVolume* volume_ = nullptr;
+  uint64_t first_ = 0;   // first unit number
+  uint64_t end_ = 0;     // one past the last unit
+  uint64_t unit_size_ = 0;
+  std::vector<bool> claimed_;
+  uint64_t last_known_ = NO_UNIT;  // last unit of the furthest known file
+  std::vector<CameraName> names_;
+  std::vector<Carved> carved_;
+  std::vector<uint8_t> batch_;     // current carve read
+  uint64_t batch_offset_ = 0;
+  size_t batch_valid_ = 0;
+};
+
+// Grow `layout` to `units` units with the next usable ones, as the card's
+// allocator would have handed them out. False when the volume runs out.
+bool CardRun::extendFree(Layout& layout, uint64_t units)
+{
+  uint64_t have = unitCount(layout);
+  while (have < units)
+  {
+    uint64_t next = nextUsable(layout.back().first + layout.back().count, end_);
+    if (next >= end_)
+    {
+      return false;
+    }
+    appendUnit(layout, next);
+    ++have;
+  }
+  return true;
+}
+
+void CardRun::claim(const Layout& layout)
+{
+  for (const UnitRun& run : layout)
+  {
+    if (volume_ != nullptr)
+    {
+      std::fill(claimed_.begin() + static_cast<std::ptrdiff_t>(run.first - first_),
+                claimed_.begin() + static_cast<std::ptrdiff_t>(run.first - first_ + run.count),
+                true);
+    }
+    uint64_t last = run.first + run.count - 1;
+    last_known_ = last_known_ == NO_UNIT ? last : std::max(last_known_, last);
+  }
+}
+
+size_t CardRun::readDevice(uint64_t at, uint8_t* out, size_t length)
+{
+  // Candidates measured during the carve pass mostly lie in the current read.
+  if (at >= batch_offset_ && at + length <= batch_offset_ + batch_valid_)
+  {
+    std::memcpy(out, batch_.data() + (at - batch_offset_), length);
+    return length;
+  }
+  size_t got = device_.read(at, out, length);
+  stats_.bytes_read += got;
+  return got;
+}
+
+// Logical stream over `layout`; with `follow_free` it grows on demand.
+MediaReader CardRun::streamReader(Layout& layout, bool follow_free)
+{
+  return [this, &layout, follow_free](uint64_t at, uint8_t* out, size_t length) -> size_t
+  {
+    if (follow_free)
+    {
+      uint64_t end = std::min<uint64_t>(at + length, options_.max_file_size);
+      extendFree(layout, (end + unit_size_ - 1) / unit_size_);
+    }
+    size_t done = 0;
+    while (done < length)
+    {
+      uint64_t index = (at + done) / unit_size_;
+      size_t run = 0;
+      while (run < layout.size() && index >= layout[run].count)
+      {
+        index -= layout[run++].count;
+      }
+      if (run == layout.size())
+      {
+        break;
+      }
+      uint64_t within = (at + done) % unit_size_;
+      uint64_t available = (layout[run].count - index) * unit_size_ - within;
+      size_t piece = static_cast<size_t>(std::min<uint64_t>(length - done, available));
+      size_t got = readDevice(offset(layout[run].first + index) + within, out + done, piece);
+      done += got;
+      if (got < piece)
+      {
+        break;
+      }
+    }
+    return done;
+  };
+}
+
+// Measure the media file at the layout's first unit; the layout is trimmed to it.
+bool CardRun::measure(bool follow_free, MediaInfo& info, Layout& layout)
+{
+  if (!measureCameraMedia(streamReader(layout, follow_free), options_.max_file_size, info))
+  {
+    return false;
+  }
+  uint64_t units = (info.size + unit_size_ - 1) / unit_size_;
+  truncateLayout(layout, units);
+  return unitCount(layout) == units;
+}
+
+std::vector<Extent> CardRun::extentsOf(const Layout& layout, uint64_t size) const
+{
+  std::vector<Extent> out;
+  for (const UnitRun& run : layout)
+  {
+    uint64_t length = std::min(run.count * unit_size_, size);
+    if (length == 0)
+    {
+      break;
+    }
+    size -= length;
+    out.push_back({offset(run.first), length});
+  }
+  return out;
+}
+
+void CardRun::add(const std::string& type, const std::string& source, uint64_t size,
+                  double confidence, std::string description, std::vector<Extent> extents)
+{
+  RecoveredFile file;
+  file.type = type;
+  file.source = source;
+  file.offset = extents.empty() ? 0 : extents.front().offset;
+  file.size = size;
+  file.confidence = confidence;
+  file.description = std::move(description);
+  if (extents.size() > 1)
+  {
+    file.extents = std::move(extents);
+  }
+  registry_.add(std::move(file));
+}
+
+void CardRun::listLive()
+{
+  for (const FatEntry& entry : volume_->entries())
+  {
+    if (entry.directory || entry.deleted)
+    {
+      continue;
+    }
+    std::vector<uint32_t> clusters = volume_->clusters(entry);
+    std::string ext = upperExtension(entry.path);
+    std::string type = std::string("fs/") + volume_->kindName();
+    for (const ExtensionType& known : EXTENSION_TYPES)
+    {
+      if (ext == known.extension)
+      {
+        type = known.type;
+      }
+    }
+    bool whole = static_cast<uint64_t>(clusters.size()) * unit_size_ >= entry.size;
+    add(type, volume_->kindName(), entry.size,
+        whole ? CONFIDENCE_LISTED : CONFIDENCE_BROKEN_CHAIN, entry.path,
+        volume_->extents(clusters, entry.size));
+    ++stats_.listed;
+    Layout layout;
+    for (uint32_t cluster : clusters)
+    {
+      appendUnit(layout, cluster);
+    }
+    claim(layout);
+    CameraName name;
+    if (!clusters.empty() && parseCameraName(entry.path, name))
+    {
+      name.unit = clusters.front();
+      names_.push_back(name);
+    }
+  }
+}
+
+void CardRun::undelete()
+{
+  std::vector<const FatEntry*> deleted;
+  for (const FatEntry& entry : volume_->entries())
+  {
+    if (entry.deleted && !entry.directory && entry.size != 0)
+    {
+      deleted.push_back(&entry);
+    }
+  }
+  // In allocation order, so earlier files take the free clusters first.
+  std::sort(deleted.begin(), deleted.end(), [](const FatEntry* a, const FatEntry* b)
+            { return a->first_cluster < b->first_cluster; });
+
+  for (const FatEntry* entry : deleted)
+  {
+    uint64_t first = entry->first_cluster;
+    uint64_t count = (entry->size + unit_size_ - 1) / unit_size_;
+    if (!usable(first) || first + count > end_)
+    {
+      continue;  // overwritten or out of range
+    }
+    uint64_t free_run = 1;
+    while (free_run < count && usable(first + free_run))
+    {
+      ++free_run;
+    }
+
+    // Contiguous first, then the free-cluster layout. The directory entry,
+    // not the measured structure, is authoritative for the size.
+    MediaInfo info;
+    Layout layout = {{first, free_run}};
+    double confidence = CONFIDENCE_UNDELETED;
+    bool media = free_run == count && measure(false, info, layout) && info.size <= entry->size;
+    if (media || (free_run == count && info.media == CameraMedia::Unknown))
+    {
+      confidence = media ? CONFIDENCE_UNDELETED : CONFIDENCE_UNDELETED_UNCHECKED;
+      layout = {{first, count}};
+    }
+    else
+    {
+      layout = {{first, 1}};
+      media = measure(true, info, layout) && info.size <= entry->size;
+      if (!media || !extendFree(layout, count))
+      {
+        continue;
+      }
+    }
+    std::vector<Extent> extents = extentsOf(layout, entry->size);
+    stats_.fragmented += extents.size() > 1 ? 1 : 0;
+    std::string type = media ? info.type : std::string("fs/") + volume_->kindName();
+    std::string path = restoreDeletedName(entry->path, names_);
+    add(type, volume_->kindName(), entry->size, confidence, path + " [deleted]",
+        std::move(extents));
+    ++stats_.undeleted;
+    claim(layout);
+    CameraName name;
+    if (parseCameraName(path, name))
+    {
+      name.unit = first;
+      names_.push_back(name);
+    }
+  }
+}
+
+void CardRun::carveRange(uint64_t begin, uint64_t end)
+{
+  uint64_t per_read = std::max<uint64_t>(1, options_.read_size / unit_size_);
+  for (uint64_t unit = nextUsable(begin, end); unit < end; unit = nextUsable(unit, end))
+  {
+    // Read the usable units that follow each other, up to the read size.
+    uint64_t count = 1;
+    while (count < per_read && unit + count < end && usable(unit + count))
+    {
+      ++count;
+    }
+    batch_.resize(static_cast<size_t>(count * unit_size_));
+    batch_offset_ = offset(unit);
+    batch_valid_ = 0;
+    batch_valid_ = device_.read(batch_offset_, batch_.data(), batch_.size());
+    stats_.bytes_read += batch_valid_;
+
+    uint64_t resume = unit + count;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      uint64_t at = i * unit_size_;
+      if (at + CAMERA_MEDIA_HEAD > batch_valid_)
+      {
+        resume = unit + i + 1;  // unreadable: skip the unit
+        break;
+      }
+      if (identifyCameraMedia(batch_.data() + at) == CameraMedia::Unknown)
+      {
+        continue;
+      }
+      MediaInfo info;
+      Layout layout = {{unit + i, 1}};
+      if (!measure(true, info, layout))
+      {
+        continue;
+      }
+      std::vector<Extent> extents = extentsOf(layout, info.size);
+      stats_.fragmented += extents.size() > 1 ? 1 : 0;
+      carved_.push_back({unit + i, info, std::move(extents)});
+      ++stats_.carved;
+      claim(layout);
+      resume = layout.back().first + layout.back().count;
+      break;
+    }
+    unit = resume;
+  }
+  batch_valid_ = 0;
+}
+
+void CardRun::carve()
+{
+  uint64_t start = last_known_ == NO_UNIT ? first_ : last_known_ + 1;
+  stats_.carve_start = start < end_ ? offset(start) : offset(first_);
+  carveRange(start, end_);
+  carveRange(first_, std::min(start, end_));
+}
+
+// Carved files continue the numbering of the nearest named file before them.
+void CardRun::nameCarved()
+{
+  std::sort(carved_.begin(), carved_.end(),
+            [](const Carved& a, const Carved& b) { return a.unit < b.unit; });
+  std::sort(names_.begin(), names_.end(),
+            [](const CameraName& a, const CameraName& b) { return a.unit < b.unit; });
+  std::set<std::tuple<std::string, std::string, uint32_t, std::string>> taken;
+  for (const CameraName& name : names_)
+  {
+    taken.insert(std::make_tuple(name.directory, name.prefix, name.number, name.extension));
+  }
+  std::vector<CameraName> known = names_;
+  for (Carved& file : carved_)
+  {
+    auto after = std::upper_bound(known.begin(), known.end(), file.unit,
+                                  [](uint64_t unit, const CameraName& name)
+                                  { return unit < name.unit; });
+    std::string description = "carved";
+    if (after != known.begin())
+    {
+      const CameraName& previous = *(after - 1);
+      CameraName name = previous;
+      name.unit = file.unit;
+      name.extension = file.info.extension;
+      // RAW+JPEG shooting gives both files the same number.
+      bool pair = rawExtension(previous.extension) != rawExtension(name.extension);
+      auto key = [&]()
+      { return std::make_tuple(name.directory, name.prefix, name.number, name.extension); };
+      if (!pair || taken.count(key()) != 0)
+      {
+        ++name.number;
+      }
+      bool clash = after != known.end() && after->directory == name.directory &&
+                   after->prefix == name.prefix && after->number < name.number;
+      if (!clash && taken.insert(key()).second)
+      {
+        char digits[16];
+        std::snprintf(digits, sizeof digits, "%0*u", static_cast<int>(name.digits),
+                      name.number);
+        description = name.directory + name.prefix + digits + "." + name.extension +
+                      " (carved, predicted name)";
+        ++stats_.predicted_names;
+        known.insert(after, name);
+      }
+    }
+    if (file.extents.size() > 1)
+    {
+      description += " [fragmented]";
+    }
+    add(file.info.type, "camera_carve", file.info.size, CONFIDENCE_CARVED, description,
+        std::move(file.extents));
+  }
+}
+
+void CardRun::run(FatVolume* volume)
+{
+  volume_ = volume;
+  if (volume_ != nullptr)
+  {
+    first_ = 2;
+    end_ = 2 + static_cast<uint64_t>(volume_->clusterCount());
+    unit_size_ = volume_->clusterSize();
+    claimed_.assign(static_cast<size_t>(end_ - first_), false);
+    volume_->scanDirectories(options_.include_deleted);
+    listLive();
+    if (options_.include_deleted)
+    {
+      undelete();
+    }
+  }
+  else
+  {
+    unit_size_ = device_.sectorSize();
+    end_ = device_.size() / unit_size_;
+  }
+  if (options_.carve)
+  {
+    carve();
+    nameCarved();
+  }
+}
+
+}  // namespace
+
+bool CameraCardEngine::run(uint64_t base)
+{
+  stats_ = CameraCardStats();
+  std::unique_ptr<FatVolume> volume = FatVolume::open(device_, base);
+  if (volume == nullptr && base == 0)
+  {
+    // Cards are usually partitioned: try the MBR entries.
+    uint8_t mbr[512];
+    if (device_.read(0, mbr, sizeof mbr) != sizeof mbr)
+    {
+      return false;
+    }
+    for (size_t i = 0; volume == nullptr && mbr[510] == 0x55 && mbr[511] == 0xAA && i < 4; ++i)
+    {
+      const uint8_t* entry = mbr + 446 + 16 * i;
+      uint64_t start = loadLE32(entry + 8);
+      if (entry[4] != 0 && start != 0)
+      {
+        volume = FatVolume::open(device_, start * 512);
+      }
+    }
+  }
+  CardRun card(device_, registry_, options_, stats_);
+  card.run(volume.get());
+  return true;
+}
+
+}  // namespace rsn
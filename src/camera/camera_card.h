@@ -0,0 +1,71 @@
+// RecoverySoftNetz — camera card fast path
+//
+// SD/CF cards from cameras and drones are written by simple allocators: each
+// photo or clip takes the next free clusters after the previous one, inside a
+// DCIM tree with numbered names (IMG_0042.JPG, DSC01234.ARW, DJI_0007.MP4).
+// The engine uses that instead of a generic signature sweep:
+//   1. the FAT/exFAT tree is read and live files registered from their chains;
+//   2. deleted entries are laid out from their first cluster, contiguously if
+//      that run is still free, otherwise over the following free clusters
+//      (what the allocator would have handed out), and kept when the media
+//      structure validates over that layout;
+//   3. the clusters no entry accounts for are carved in one sequential pass,
+//      starting after the last known file and wrapping to the volume start.
+//      Only cluster heads are tested, candidate files are measured over free
+//      clusters as in step 2, and the pass skips past every file it accepts.
+// Carved files between two named files take the next number in the sequence.
+// Without a readable boot sector the whole device is carved at sector
+// granularity.
+
+#pragma once
+
+#include "core/device.h"
+#include "core/file_registry.h"
+
+#include <cstdint>
+
+namespace rsn
+{
+
+struct CameraCardOptions
+{
+  bool include_deleted = true;           // lay out and validate deleted entries
+  bool carve = true;                     // carve clusters no entry accounts for
+  uint64_t max_file_size = 64ull << 30;  // upper bound for a measured file
+  size_t read_size = 8u << 20;           // carve pass read size
+};
+
+struct CameraCardStats
+{
+  uint64_t listed = 0;           // live files from the directory tree
+  uint64_t undeleted = 0;        // deleted entries whose layout validated
+  uint64_t carved = 0;           // files found in unaccounted clusters
+  uint64_t fragmented = 0;       // undeleted or carved files laid out over several runs
+  uint64_t predicted_names = 0;  // carved files named from their neighbours
+  uint64_t carve_start = 0;      // device offset where the carve pass began
+  uint64_t bytes_read = 0;       // while laying out deleted files and carving
+};
+
+class CameraCardEngine
+{
+public:
+  CameraCardEngine(Device& device, FileRegistry& registry,
+                   CameraCardOptions options = CameraCardOptions())
+    : device_(device), registry_(registry), options_(options)
+  {
+  }
+
+  /// Recover the card. The volume is looked for at `base`, then in the first
+  /// MBR partition. False only when the device cannot be read at all.
+  bool run(uint64_t base = 0);
+
+  const CameraCardStats& stats() const { return stats_; }
+
+private:
+  Device& device_;
+  FileRegistry& registry_;
+  CameraCardOptions options_;
+  CameraCardStats stats_;
+};
+
+}  // namespace rsn
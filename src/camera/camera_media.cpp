@@ -0,0 +1,794 @@
+// RecoverySoftNetz — structural sizing of camera media files
+
+#include "camera/camera_media.h"
+
+#include "carving/bmff.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <unordered_set>
+#include <vector>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t WINDOW = 256u << 10;
+constexpr unsigned MAX_IFDS = 64;
+constexpr uint32_t MAX_IFD_ENTRIES = 1024;
+constexpr uint32_t MAX_ARRAY = 1u << 20;  // strip/tile offsets read per entry
+constexpr uint64_t MAX_FTYP = 4096;
+constexpr size_t SOI_WINDOW = 64;  // where a CR3 preview box's JPEG starts
+
+constexpr uint16_t TAG_RW2_JPEG = 46;
+constexpr uint16_t TAG_COMPRESSION = 259;
+constexpr uint16_t TAG_MAKE = 271;
+constexpr uint16_t TAG_STRIP_OFFSETS = 273;
+constexpr uint16_t TAG_STRIP_COUNTS = 279;
+constexpr uint16_t TAG_TILE_OFFSETS = 324;
+constexpr uint16_t TAG_TILE_COUNTS = 325;
+constexpr uint16_t TAG_SUB_IFDS = 330;
+constexpr uint16_t TAG_JPEG_OFFSET = 513;
+constexpr uint16_t TAG_JPEG_LENGTH = 514;
+constexpr uint16_t TAG_EXIF_IFD = 34665;
+constexpr uint16_t TAG_DNG_VERSION = 50706;
+constexpr uint16_t TAG_MP_ENTRY = 0xB002;
+
+constexpr uint16_t COMPRESSION_OLD_JPEG = 6;
+constexpr uint16_t COMPRESSION_JPEG = 7;
+
+// Canon's box inside moov (CNCV, CMT1-4, THMB) and the top-level PRVW holder.
+constexpr uint8_t CANON_UUID[16] = {0x85, 0xC0, 0xB6, 0x87, 0x82, 0x0F, 0x11, 0xE0,
+                                    0x81, 0x11, 0xF4, 0xCE, 0x46, 0x2B, 0x6A, 0x48};
+constexpr uint8_t PREVIEW_UUID[16] = {0xEA, 0xF4, 0x2B, 0x5E, 0x1C, 0x98, 0x4B, 0x88,
+                                      0xB9, 0xFB, 0xB7, 0xDC, 0x40, 0x6E, 0x4D, 0x16};
+
+/// Buffered sequential view of a MediaReader.
+class Cursor
+{
+public:
+  explicit Cursor(const MediaReader& read) : read_(read) {}
+
+  /// Bytes available at `offset` in the window (0 at end of stream).
+  size_t window(uint64_t offset, const uint8_t*& data)
+  {
+    if (offset < start_ || offset >= start_ + valid_)
+    {
+      buffer_.resize(WINDOW);
+      start_ = offset;
+      valid_ = read_(offset, buffer_.data(), WINDOW);
+      if (valid_ == 0)
+      {
+        return 0;
+      }
+    }
+    data = buffer_.data() + (offset - start_);
+    return static_cast<size_t>(start_ + valid_ - offset);
+  }
+
+  bool get(uint64_t offset, uint8_t* out, size_t length)
+  {
+    while (length != 0)
+    {
+      const uint8_t* data = nullptr;
+      size_t have = window(offset, data);
+      if (have == 0)
+      {
+        return false;
+      }
+      size_t take = std::min(have, length);
+      std::memcpy(out, data, take);
+      out += take;
+      offset += take;
+      length -= take;
+    }
+    return true;
+  }
+
+  const MediaReader& reader() const { return read_; }
+
+private:
+  const MediaReader& read_;
+  std::vector<uint8_t> buffer_;
+  uint64_t start_ = 0;
+  size_t valid_ = 0;
+};
+
+bool jpegSegmentMarker(uint8_t marker)
+{
+  return (marker >= 0xC0 && marker <= 0xCF) || (marker >= 0xDA && marker <= 0xDF) ||
+         (marker >= 0xE0 && marker <= 0xEF) || marker == 0xFE;
+}
+
+/// TIFF field access in either byte order.
+struct TiffOrder
+{
+  bool little;
+  uint16_t u16(const uint8_t* p) const { return little ? loadLE16(p) : loadBE16(p); }
+  uint32_t u32(const uint8_t* p) const { return little ? loadLE32(p) : loadBE32(p); }
+};
+
+size_t tiffTypeSize(uint16_t type)
+{
+  static const uint8_t sizes[] = {0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8, 4};
+  return type < sizeof sizes ? sizes[type] : 0;
+}
+
+// End of the extra images an MPF index lists, relative to the file start.
+uint64_t mpfEnd(Cursor& cursor, const std::vector<uint8_t>& segment, uint64_t tiff_base)
+{
+  if (segment.size() < 16 || std::memcmp(segment.data(), "MPF\0", 4) != 0)
+  {
+    return 0;
+  }
+  const uint8_t* tiff = segment.data() + 4;
+  size_t tiff_size = segment.size() - 4;
+  TiffOrder order{tiff[0] == 'I'};
+  uint32_t ifd = order.u32(tiff + 4);
+  if ((tiff[0] != 'I' && tiff[0] != 'M') || order.u16(tiff + 2) != 42 || ifd + 2 > tiff_size)
+  {
+    return 0;
+  }
+  uint64_t end = 0;
+  uint16_t count = order.u16(tiff + ifd);
+  for (uint32_t i = 0; i < count && ifd + 2 + 12 * (i + 1) <= tiff_size; ++i)
+  {
+    const uint8_t* entry = tiff + ifd + 2 + 12 * i;
+    if (order.u16(entry) != TAG_MP_ENTRY)
+    {
+      continue;
+    }
+    uint32_t length = order.u32(entry + 4);
+    uint32_t at = order.u32(entry + 8);
+    for (uint32_t pos = at; pos + 16 <= tiff_size && pos + 16 <= at + uint64_t(length); pos += 16)
+    {
+      uint32_t size = order.u32(tiff + pos + 4);
+      uint32_t offset = order.u32(tiff + pos + 8);
+      uint8_t soi[2];
+      if (offset != 0 && cursor.get(tiff_base + offset, soi, 2) && soi[0] == 0xFF &&
+          soi[1] == 0xD8)
+      {
+        end = std::max(end, tiff_base + offset + size);
+      }
+    }
+  }
+  return end;
+}
+
+bool measureJpeg(Cursor& cursor, uint64_t limit, MediaInfo& info)
+{
+  uint64_t pos = 2;
+  uint64_t extra_end = 0;
+  bool scanned = false;
+  std::vector<uint8_t> segment;
+  for (;;)
+  {
+    uint8_t m[4];
+    if (pos + 2 > limit || !cursor.get(pos, m, 2) || m[0] != 0xFF)
+    {
+      return false;
+    }
+    uint8_t marker = m[1];
+    if (marker == 0xFF)
+    {
+      ++pos;  // fill byte
+      continue;
+    }
+    if (marker == 0xD9)
+    {
+      pos += 2;
+      break;
+    }
+    if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01)
+    {
+      pos += 2;
+      continue;
+    }
+    if (!jpegSegmentMarker(marker) || !cursor.get(pos + 2, m + 2, 2) || loadBE16(m + 2) < 2)
+    {
+      return false;
+    }
+    uint64_t length = loadBE16(m + 2);
+    if (marker == 0xE2 && length >= 18)
+    {
+      segment.resize(length - 2);
+      if (cursor.get(pos + 4, segment.data(), segment.size()))
+      {
+        extra_end = std::max(extra_end, mpfEnd(cursor, segment, pos + 8));
+      }
+    }
+    pos += 2 + length;
+    if (marker != 0xDA)
+    {
+      continue;
+    }
+
+    // Entropy-coded data runs to the first marker that is not a restart.
+    scanned = true;
+    for (;;)
+    {
+      const uint8_t* data = nullptr;
+      size_t have = cursor.window(pos, data);
+      if (have == 0 || pos > limit)
+      {
+        return false;
+      }
+      const void* hit = std::memchr(data, 0xFF, have);
+      if (hit == nullptr)
+      {
+        pos += have;
+        continue;
+      }
+      pos += static_cast<const uint8_t*>(hit) - data;
+      uint8_t next[2];
+      if (!cursor.get(pos, next, 2))
+      {
+        return false;
+      }
+      if (next[1] == 0x00 || next[1] == 0xFF || (next[1] >= 0xD0 && next[1] <= 0xD7))
+      {
+        pos += next[1] == 0xFF ? 1 : 2;
+        continue;
+      }
+      break;
+    }
+  }
+  if (!scanned || std::max(pos, extra_end) > limit)
+  {
+    return false;
+  }
+  info.size = std::max(pos, extra_end);
+  info.type = "image/jpeg";
+  info.extension = "JPG";
+  return true;
+}
+
+/// Check that a JPEG a viewer can decode starts at `offset` and read its
+/// dimensions from the frame header. Its size is `declared` when the container
+/// records one, otherwise it is measured; either way it must end by `limit`.
+bool probePreview(const MediaReader& read, uint64_t offset, uint64_t declared, uint64_t limit,
+                  MediaPreview& preview)
+{
+  if (offset >= limit || declared > limit - offset)
+  {
+    return false;
+  }
+  uint64_t room = limit - offset;
+  MediaReader sub = [&](uint64_t at, uint8_t* out, size_t length) -> size_t
+  {
+    if (at >= room)
+    {
+      return 0;
+    }
+    return read(offset + at, out, static_cast<size_t>(std::min<uint64_t>(length, room - at)));
+  };
+  Cursor cursor(sub);
+  uint8_t m[4];
+  if (!cursor.get(0, m, 2) || m[0] != 0xFF || m[1] != 0xD8)
+  {
+    return false;
+  }
+  uint64_t pos = 2;
+  for (;;)
+  {
+    if (!cursor.get(pos, m, 4) || m[0] != 0xFF)
+    {
+      return false;
+    }
+    if (m[1] == 0xFF)
+    {
+      ++pos;
+      continue;
+    }
+    if (!jpegSegmentMarker(m[1]) || m[1] == 0xDA || loadBE16(m + 2) < 2)
+    {
+      return false;
+    }
+    if (m[1] >= 0xC0 && m[1] <= 0xCF && m[1] != 0xC4 && m[1] != 0xC8 && m[1] != 0xCC)
+    {
+      // Baseline, extended or progressive Huffman frames only: lossless and
+      // arithmetic-coded streams are sensor data or not widely decodable.
+      uint8_t frame[5];
+      if (m[1] > 0xC2 || !cursor.get(pos + 4, frame, sizeof frame))
+      {
+        return false;
+      }
+      preview.height = loadBE16(frame + 1);
+      preview.width = loadBE16(frame + 3);
+      break;
+    }
+    pos += 2 + loadBE16(m + 2);
+  }
+  if (preview.width == 0 || preview.height == 0)
+  {
+    return false;
+  }
+  preview.offset = offset;
+  preview.size = declared;
+  if (declared == 0)
+  {
+    MediaInfo jpeg;
+    if (!measureJpeg(cursor, room, jpeg))
+    {
+      return false;
+    }
+    preview.size = jpeg.size;
+  }
+  return true;
+}
+
+/// Preview candidates as (offset, declared size or 0).
+using PreviewCandidates = std::vector<std::pair<uint64_t, uint64_t>>;
+
+/// Probe the candidates and keep the valid previews, largest first.
+void collectPreviews(const MediaReader& read, PreviewCandidates candidates, uint64_t limit,
+                     MediaInfo& info)
+{
+  std::sort(candidates.begin(), candidates.end());
+  uint64_t last = UINT64_MAX;
+  for (const auto& candidate : candidates)
+  {
+    MediaPreview preview;
+    if (candidate.first != last &&
+        probePreview(read, candidate.first, candidate.second, limit, preview))
+    {
+      info.previews.push_back(preview);
+    }
+    last = candidate.first;
+  }
+  std::stable_sort(info.previews.begin(), info.previews.end(),
+                   [](const MediaPreview& a, const MediaPreview& b)
+                   {
+                     return uint32_t(a.width) * a.height > uint32_t(b.width) * b.height;
+                   });
+}
+
+bool measureTiff(Cursor& cursor, uint64_t limit, MediaInfo& info)
+{
+  uint8_t head[16];
+  if (!cursor.get(0, head, sizeof head))
+  {
+    return false;
+  }
+  TiffOrder order{head[0] == 'I'};
+  uint64_t end = 8;
+  bool dng = false;
+  std::string make;
+  std::deque<uint32_t> queue = {order.u32(head + 4)};
+  std::unordered_set<uint32_t> visited;
+  std::vector<uint8_t> table;
+  std::vector<uint8_t> values;
+
+  // Values of a SHORT or LONG entry, inline or out of line.
+  auto readArray = [&](const uint8_t* entry, std::vector<uint64_t>& out)
+  {
+    out.clear();
+    uint16_t type = order.u16(entry + 2);
+    uint32_t count = order.u32(entry + 4);
+    size_t size = tiffTypeSize(type);
+    if ((type != 3 && type != 4 && type != 13) || count > MAX_ARRAY)
+    {
+      return;
+    }
+    const uint8_t* p = entry + 8;
+    if (size * count > 4)
+    {
+      values.resize(size * count);
+      if (!cursor.get(order.u32(entry + 8), values.data(), values.size()))
+      {
+        return;
+      }
+      p = values.data();
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      out.push_back(size == 2 ? order.u16(p + 2 * i) : order.u32(p + 4 * i));
+    }
+  };
+
+  std::vector<uint64_t> offsets[3];
+  std::vector<uint64_t> counts[3];
+  std::vector<uint64_t> list;
+  PreviewCandidates previews;
+  unsigned parsed = 0;
+  while (!queue.empty() && visited.size() < MAX_IFDS)
+  {
+    uint32_t ifd = queue.front();
+    queue.pop_front();
+    uint8_t raw_count[2];
+    if (ifd < 8 || ifd >= limit || !visited.insert(ifd).second ||
+        !cursor.get(ifd, raw_count, 2))
+    {
+      continue;
+    }
+    uint32_t count = order.u16(raw_count);
+    table.resize(12 * static_cast<size_t>(count) + 4);
+    if (count == 0 || count > MAX_IFD_ENTRIES || !cursor.get(ifd + 2, table.data(), table.size()))
+    {
+      continue;
+    }
+    ++parsed;
+    end = std::max<uint64_t>(end, ifd + 2 + table.size());
+    for (auto& v : offsets)
+    {
+      v.clear();
+    }
+    for (auto& v : counts)
+    {
+      v.clear();
+    }
+    uint64_t compression = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const uint8_t* entry = table.data() + 12 * i;
+      uint16_t tag = order.u16(entry);
+      uint64_t bytes = tiffTypeSize(order.u16(entry + 2)) * uint64_t(order.u32(entry + 4));
+      if (bytes > 4)
+      {
+        uint64_t at = order.u32(entry + 8);
+        if (at + bytes <= limit)
+        {
+          end = std::max(end, at + bytes);
+        }
+      }
+      switch (tag)
+      {
+        case TAG_MAKE:
+        {
+          char text[16] = {};
+          size_t n = static_cast<size_t>(std::min<uint64_t>(bytes, sizeof text - 1));
+          if (bytes <= 4)
+          {
+            std::memcpy(text, entry + 8, n);
+          }
+          else
+          {
+            cursor.get(order.u32(entry + 8), reinterpret_cast<uint8_t*>(text), n);
+          }
+          make.assign(text);
+          break;
+        }
+        case TAG_COMPRESSION:
+          readArray(entry, list);
+          compression = list.empty() ? 0 : list[0];
+          break;
+        case TAG_RW2_JPEG:
+          if (bytes > 4)
+          {
+            previews.emplace_back(order.u32(entry + 8), bytes);
+          }
+          break;
+        case TAG_STRIP_OFFSETS:
+          readArray(entry, offsets[0]);
+          break;
+        case TAG_STRIP_COUNTS:
+          readArray(entry, counts[0]);
+          break;
+        case TAG_TILE_OFFSETS:
+          readArray(entry, offsets[1]);
+          break;
+        case TAG_TILE_COUNTS:
+          readArray(entry, counts[1]);
+          break;
+        case TAG_JPEG_OFFSET:
+          readArray(entry, offsets[2]);
+          break;
+        case TAG_JPEG_LENGTH:
+          readArray(entry, counts[2]);
+          break;
+        case TAG_SUB_IFDS:
+        case TAG_EXIF_IFD:
+          readArray(entry, list);
+          queue.insert(queue.end(), list.begin(), list.end());
+          break;
+        case TAG_DNG_VERSION:
+          dng = true;
+          break;
+        default:
+          break;
+      }
+    }
+    for (size_t k = 0; k < 3; ++k)
+    {
+      for (size_t i = 0; i < offsets[k].size() && i < counts[k].size(); ++i)
+      {
+        if (offsets[k][i] + counts[k][i] <= limit)
+        {
+          end = std::max(end, offsets[k][i] + counts[k][i]);
+        }
+      }
+    }
+    if (offsets[2].size() == 1 && counts[2].size() == 1)
+    {
+      previews.emplace_back(offsets[2][0], counts[2][0]);
+    }
+    if ((compression == COMPRESSION_OLD_JPEG || compression == COMPRESSION_JPEG) &&
+        offsets[0].size() == 1 && counts[0].size() == 1)
+    {
+      previews.emplace_back(offsets[0][0], counts[0][0]);
+    }
+    uint32_t next = order.u32(table.data() + 12 * count);
+    if (next != 0)
+    {
+      queue.push_back(next);
+    }
+  }
+  if (parsed == 0)
+  {
+    return false;
+  }
+  info.size = end;
+  collectPreviews(cursor.reader(), std::move(previews), end, info);
+  auto raw = [&](const char* type, const char* extension)
+  {
+    info.type = type;
+    info.extension = extension;
+  };
+  if (dng)
+  {
+    raw("image/dng", "DNG");
+  }
+  else if (head[8] == 'C' && head[9] == 'R')
+  {
+    raw("image/cr2", "CR2");
+  }
+  else if (head[2] == 'R' || make.compare(0, 7, "OLYMPUS") == 0)
+  {
+    raw("image/orf", "ORF");
+  }
+  else if (head[2] == 'U' || make.compare(0, 9, "Panasonic") == 0)
+  {
+    raw("image/rw2", "RW2");
+  }
+  else if (make.compare(0, 5, "NIKON") == 0)
+  {
+    raw("image/nef", "NEF");
+  }
+  else if (make.compare(0, 4, "SONY") == 0)
+  {
+    raw("image/arw", "ARW");
+  }
+  else if (make.compare(0, 6, "PENTAX") == 0)
+  {
+    raw("image/pef", "PEF");
+  }
+  else
+  {
+    raw("image/tiff", "TIF");
+  }
+  return true;
+}
+
+/// Check a CR3 against its box tree and collect its previews. The top-level
+/// walk already gave the size; a moov that does not describe the file (no
+/// Canon box, samples outside every mdat) rejects it.
+bool inspectCr3(Cursor& cursor, const std::vector<BmffBox>& boxes, MediaInfo& info)
+{
+  const BoxReader& read = cursor.reader();
+  const BmffBox* moov = nullptr;
+  std::vector<const BmffBox*> mdats;
+  PreviewCandidates previews;
+  uint8_t uuid[16];
+
+  // THMB and PRVW hold a JPEG after a few fields of their own.
+  auto soi = [&](uint64_t begin, uint64_t end)
+  {
+    uint8_t window[SOI_WINDOW];
+    size_t length = static_cast<size_t>(std::min<uint64_t>(SOI_WINDOW, end - begin));
+    if (!cursor.get(begin, window, length))
+    {
+      return;
+    }
+    for (size_t i = 0; i + 3 <= length; ++i)
+    {
+      if (window[i] == 0xFF && window[i + 1] == 0xD8 && window[i + 2] == 0xFF)
+      {
+        previews.emplace_back(begin + i, 0);
+        return;
+      }
+    }
+  };
+  auto isUuid = [&](const BmffBox& box, const uint8_t* expected)
+  {
+    return box.is("uuid") && box.end - box.payload >= 16 && cursor.get(box.payload, uuid, 16) &&
+           std::memcmp(uuid, expected, 16) == 0;
+  };
+
+  for (const BmffBox& box : boxes)
+  {
+    if (box.is("moov"))
+    {
+      moov = &box;
+    }
+    else if (box.is("mdat"))
+    {
+      mdats.push_back(&box);
+    }
+    else if (isUuid(box, PREVIEW_UUID))
+    {
+      soi(box.payload + 16, box.end);
+    }
+  }
+  std::vector<BmffTrack> tracks;
+  if (moov == nullptr || mdats.empty() || !parseMovie(read, moov->payload, moov->end, tracks) ||
+      tracks.empty())
+  {
+    return false;
+  }
+
+  bool canon = false;
+  forEachBox(read, moov->payload, moov->end, [&](const BmffBox& box)
+  {
+    if (!isUuid(box, CANON_UUID))
+    {
+      return true;
+    }
+    forEachBox(read, box.payload + 16, box.end, [&](const BmffBox& child)
+    {
+      uint8_t version[8];
+      if (child.is("CNCV"))
+      {
+        canon = child.end - child.payload >= 8 && cursor.get(child.payload, version, 8) &&
+                std::memcmp(version, "CanonCR3", 8) == 0;
+      }
+      else if (child.is("THMB"))
+      {
+        soi(child.payload, child.end);
+      }
+      return true;
+    });
+    return false;
+  });
+  if (!canon)
+  {
+    return false;
+  }
+  std::vector<BmffSample> samples;
+  for (uint32_t i = 0; i < tracks.size(); ++i)
+  {
+    if (!sampleLayout(tracks[i], i, samples))
+    {
+      return false;
+    }
+  }
+  for (const BmffSample& sample : samples)
+  {
+    bool inside = std::any_of(mdats.begin(), mdats.end(), [&](const BmffBox* mdat)
+    {
+      return sample.offset >= mdat->payload && sample.offset <= mdat->end &&
+             sample.size <= mdat->end - sample.offset;
+    });
+    if (!inside)
+    {
+      return false;
+    }
+  }
+  // The first track is the full-size JPEG.
+  if (!tracks[0].chunk_offsets.empty() && !tracks[0].sample_sizes.empty())
+  {
+    previews.emplace_back(tracks[0].chunk_offsets[0], tracks[0].sample_sizes[0]);
+  }
+  collectPreviews(read, std::move(previews), info.size, info);
+  return true;
+}
+
+bool measureBmff(Cursor& cursor, uint64_t limit, MediaInfo& info)
+{
+  uint8_t head[16];
+  if (!cursor.get(0, head, sizeof head))
+  {
+    return false;
+  }
+  uint64_t ftyp_size = loadBE32(head);
+  std::vector<uint8_t> ftyp(static_cast<size_t>(std::min(ftyp_size, MAX_FTYP)));
+  if (ftyp_size < 16 || ftyp_size > MAX_FTYP || !cursor.get(0, ftyp.data(), ftyp.size()))
+  {
+    return false;
+  }
+  uint64_t pos = 0;
+  bool payload = false;
+  std::vector<BmffBox> boxes;
+  for (;;)
+  {
+    uint8_t box[16];
+    if (!cursor.get(pos, box, 8))
+    {
+      break;
+    }
+    bool large = cursor.get(pos + 8, box + 8, 8);
+    uint64_t size = loadBE32(box);
+    if (!isTopLevelBox(box + 4) || (pos != 0 && std::memcmp(box + 4, "ftyp", 4) == 0))
+    {
+      break;  // not a box of this file: the previous one was the last
+    }
+    uint64_t header = 8;
+    if (size == 1)
+    {
+      size = large ? loadBE64(box + 8) : 0;
+      header = 16;
+    }
+    if (size < 8)
+    {
+      if (size == 0 && std::memcmp(box + 4, "mdat", 4) == 0)
+      {
+        return false;  // runs to the end of an unfinished recording: size unknown
+      }
+      break;
+    }
+    if (pos + size > limit)
+    {
+      return false;
+    }
+    boxes.emplace_back();
+    std::memcpy(boxes.back().type, box + 4, 4);
+    boxes.back().offset = pos;
+    boxes.back().payload = pos + header;
+    boxes.back().end = pos + size;
+    payload = payload || std::memcmp(box + 4, "moov", 4) == 0 ||
+              std::memcmp(box + 4, "mdat", 4) == 0 || std::memcmp(box + 4, "meta", 4) == 0 ||
+              std::memcmp(box + 4, "moof", 4) == 0;
+    pos += size;
+  }
+  if (!payload)
+  {
+    return false;
+  }
+  info.size = pos;
+  classifyBrand(ftyp.data(), ftyp.size(), info.type, info.extension);
+  return info.type != "image/cr3" || inspectCr3(cursor, boxes, info);
+}
+
+}  // namespace
+
+CameraMedia identifyCameraMedia(const uint8_t* head)
+{
+  if (head[0] == 0xFF && head[1] == 0xD8 && head[2] == 0xFF && jpegSegmentMarker(head[3]))
+  {
+    return CameraMedia::Jpeg;
+  }
+  bool tiff = (head[0] == 'I' && head[1] == 'I' &&
+               ((head[2] == 42 && head[3] == 0) || std::memcmp(head + 2, "RO", 2) == 0 ||
+                std::memcmp(head + 2, "RS", 2) == 0 || (head[2] == 'U' && head[3] == 0))) ||
+              (head[0] == 'M' && head[1] == 'M' && head[2] == 0 && head[3] == 42);
+  if (tiff)
+  {
+    uint32_t ifd = head[0] == 'I' ? loadLE32(head + 4) : loadBE32(head + 4);
+    return ifd >= 8 && ifd < (1u << 30) ? CameraMedia::Tiff : CameraMedia::Unknown;
+  }
+  uint32_t box = loadBE32(head);
+  if (std::memcmp(head + 4, "ftyp", 4) == 0 && box >= 16 && box <= MAX_FTYP)
+  {
+    return CameraMedia::Bmff;
+  }
+  return CameraMedia::Unknown;
+}
+
+bool measureCameraMedia(const MediaReader& read, uint64_t limit, MediaInfo& info)
+{
+  Cursor cursor(read);
+  uint8_t head[CAMERA_MEDIA_HEAD];
+  if (!cursor.get(0, head, sizeof head))
+  {
+    return false;
+  }
+  info = MediaInfo();
+  info.media = identifyCameraMedia(head);
+  switch (info.media)
+  {
+    case CameraMedia::Jpeg:
+      return measureJpeg(cursor, limit, info);
+    case CameraMedia::Tiff:
+      return measureTiff(cursor, limit, info);
+    case CameraMedia::Bmff:
+      return measureBmff(cursor, limit, info);
+    case CameraMedia::Unknown:
+      break;
+  }
+  return false;
+}
+
+}  // namespace rsn
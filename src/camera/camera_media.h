@@ -0,0 +1,73 @@
+// RecoverySoftNetz — structural sizing of camera media files
+//
+// Finds where a file that cameras and drones write ends, from its structure
+// rather than a footer:
+//   - JPEG: the marker segments are walked, so an EXIF thumbnail's EOI does
+//     not end the file early, then each entropy-coded scan up to EOI. Images
+//     listed in an MPF index (large previews stored after the primary image)
+//     are included;
+//   - TIFF-based RAW (CR2, NEF, ARW, DNG, ORF, RW2): the IFD chain, SubIFDs and
+//     the EXIF IFD are followed; the file ends at the furthest strip, tile,
+//     JPEG stream or out-of-line value referenced;
+//   - ISO-BMFF (MP4, MOV, CR3, HEIC): top-level boxes are walked until a header
+//     is not a known top-level box. A CR3 is also checked through its box tree:
+//     Canon's metadata box must be there and every sample of every track must
+//     lie inside an mdat box.
+// RAW files also report their embedded JPEG previews (the TIFF JPEG tags and
+// JPEG strips, RW2's JpgFromRaw, the CR3 THMB and PRVW boxes and full-size
+// JPEG track). Only the JPEG headers are read; the sensor data is not decoded,
+// and lossless JPEG streams (which hold sensor data) are not previews.
+// The data is read through a callback so that the same code measures a
+// contiguous run and a file laid out over a list of clusters.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+enum class CameraMedia : uint8_t
+{
+  Unknown,
+  Jpeg,
+  Tiff,
+  Bmff,
+};
+
+/// Positional read from the candidate's logical stream; short at its end.
+using MediaReader = std::function<size_t(uint64_t offset, uint8_t* out, size_t length)>;
+
+/// A JPEG embedded in a RAW file that any viewer can show.
+struct MediaPreview
+{
+  uint64_t offset = 0;  // from the start of the file
+  uint64_t size = 0;
+  uint16_t width = 0;
+  uint16_t height = 0;
+};
+
+struct MediaInfo
+{
+  CameraMedia media = CameraMedia::Unknown;
+  uint64_t size = 0;
+  std::string type;       // registry type, e.g. "image/jpeg", "video/mov", "image/cr3"
+  std::string extension;  // customary upper-case extension, e.g. "JPG"
+  std::vector<MediaPreview> previews;  // TIFF-based and CR3 files, largest first
+};
+
+/// Minimum bytes `identifyCameraMedia` looks at.
+constexpr size_t CAMERA_MEDIA_HEAD = 16;
+
+/// Classify a file head of at least CAMERA_MEDIA_HEAD bytes.
+CameraMedia identifyCameraMedia(const uint8_t* head);
+
+/// Measure the file at logical offset 0. False when its structure does not
+/// validate or it would exceed `limit` bytes.
+bool measureCameraMedia(const MediaReader& read, uint64_t limit, MediaInfo& info);
+
+}  // namespace rsn
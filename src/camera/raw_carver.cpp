@@ -0,0 +1,131 @@
+// RecoverySoftNetz — camera RAW carve stage
+
+#include "camera/raw_carver.h"
+
+#include <algorithm>
+#include <string>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr double CONFIDENCE_CR3 = 0.95;      // box tree checked against the samples
+constexpr double CONFIDENCE_PREVIEW = 0.9;   // IFD chain with a decodable preview
+constexpr double CONFIDENCE_IFD_ONLY = 0.8;
+
+std::string dimensions(const MediaPreview& preview)
+{
+  return std::to_string(preview.width) + "x" + std::to_string(preview.height);
+}
+
+}  // namespace
+
+void RawCarveStage::registerPatterns(PatternSet& patterns)
+{
+  static const uint8_t TIFF_LE[] = {'I', 'I', 42, 0};
+  static const uint8_t TIFF_BE[] = {'M', 'M', 0, 42};
+  static const uint8_t RW2[] = {'I', 'I', 'U', 0};
+  patterns.add(TIFF_LE, sizeof(TIFF_LE), TAG_TIFF);
+  patterns.add(TIFF_BE, sizeof(TIFF_BE), TAG_TIFF);
+  patterns.add(RW2, sizeof(RW2), TAG_TIFF);
+  patterns.add(std::string("IIRO"), TAG_TIFF);  // Olympus ORF
+  patterns.add(std::string("IIRS"), TAG_TIFF);
+  patterns.add(std::string("ftypcrx "), TAG_BMFF);  // CR3, four bytes into the file
+}
+
+bool RawCarveStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  uint64_t offset = chunk.offset + pos;
+  if (tag == TAG_BMFF)
+  {
+    if (offset < 4)
+    {
+      return false;
+    }
+    offset -= 4;
+  }
+  Device& device = ctx.device();
+  if (offset % device.sectorSize() != 0 || offset >= device.size())
+  {
+    return false;
+  }
+
+  candidates_.fetch_add(1, std::memory_order_relaxed);
+  uint64_t limit = std::min(options_.max_file_size, device.size() - offset);
+  MediaReader read = [&](uint64_t at, uint8_t* out, size_t length) -> size_t
+  {
+    if (at >= limit)
+    {
+      return 0;
+    }
+    size_t take = static_cast<size_t>(std::min<uint64_t>(length, limit - at));
+    return device.read(offset + at, out, take);
+  };
+  MediaInfo info;
+  if (!measureCameraMedia(read, limit, info) || info.type == "image/tiff" ||
+      (info.media != CameraMedia::Tiff && info.type != "image/cr3"))
+  {
+    return false;
+  }
+
+  RecoveredFile file;
+  file.type = info.type;
+  file.source = name();
+  file.offset = offset;
+  file.size = info.size;
+  if (info.type == "image/cr3")
+  {
+    file.confidence = CONFIDENCE_CR3;
+  }
+  else
+  {
+    file.confidence = info.previews.empty() ? CONFIDENCE_IFD_ONLY : CONFIDENCE_PREVIEW;
+  }
+  file.description = info.extension + " raw";
+  if (!info.previews.empty())
+  {
+    size_t count = info.previews.size();
+    file.description += ", " + std::to_string(count) + (count == 1 ? " preview" : " previews") +
+                        " up to " + dimensions(info.previews.front());
+  }
+  uint64_t id = ctx.registry().add(std::move(file));
+  confirmed_.fetch_add(1, std::memory_order_relaxed);
+  extractPreviews(id, offset, info, ctx);
+  return true;
+}
+
+void RawCarveStage::extractPreviews(uint64_t raw_id, uint64_t offset, const MediaInfo& info,
+                                    CarveContext& ctx)
+{
+  for (const MediaPreview& preview : info.previews)
+  {
+    if (preview.size > options_.max_preview_size)
+    {
+      continue;
+    }
+    previews_.fetch_add(1, std::memory_order_relaxed);
+    if (options_.register_previews)
+    {
+      RecoveredFile file;
+      file.type = "image/jpeg";
+      file.source = "raw_preview";
+      file.offset = offset + preview.offset;
+      file.size = preview.size;
+      file.confidence = CONFIDENCE_PREVIEW;
+      file.description = dimensions(preview) + " preview of #" + std::to_string(raw_id);
+      ctx.registry().add(std::move(file));
+    }
+    if (options_.preview_sink)
+    {
+      auto jpeg = ctx.readAt(offset + preview.offset, static_cast<size_t>(preview.size));
+      if (jpeg.size() == preview.size)
+      {
+        options_.preview_sink(raw_id, preview, std::vector<uint8_t>(jpeg.begin(), jpeg.end()));
+      }
+    }
+  }
+}
+
+}  // namespace rsn
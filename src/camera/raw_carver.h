@@ -0,0 +1,74 @@
+// RecoverySoftNetz — camera RAW carve stage
+//
+// RAW files are TIFF (CR2, NEF, ARW, DNG, ORF, RW2, PEF) or ISO-BMFF (CR3)
+// containers with no footer, so a header-to-footer carver cannot size them.
+// The stage matches their headers on the shared pattern matcher and sizes each
+// candidate from its structure (camera_media): the furthest byte the IFD chain
+// references, or the box walk checked against the CR3 sample tables.
+//
+// Files are written from a sector boundary, which rules out most of the TIFF
+// headers inside EXIF blocks and maker notes; a TIFF whose make is not a RAW
+// camera's is not reported. Embedded JPEG previews are handed to a sink (the
+// thumbnail cache) and, optionally, registered as files of their own. Their
+// headers are read but the sensor data never is.
+
+#pragma once
+
+#include "camera/camera_media.h"
+#include "core/carve_pipeline.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace rsn
+{
+
+/// Receives the bytes of a preview and the registry id of its RAW file.
+/// Called from the pipeline's worker threads.
+using PreviewSink =
+  std::function<void(uint64_t raw_id, const MediaPreview& preview, std::vector<uint8_t> jpeg)>;
+
+struct RawCarveOptions
+{
+  uint64_t max_file_size = 1ull << 30;     // bigger candidates are rejected
+  uint64_t max_preview_size = 32ull << 20;  // previews larger than this are not read
+  bool register_previews = false;          // add each preview to the registry as image/jpeg
+  PreviewSink preview_sink;                // may be empty
+};
+
+class RawCarveStage : public CarveStage
+{
+public:
+  explicit RawCarveStage(RawCarveOptions options = RawCarveOptions())
+    : options_(std::move(options))
+  {
+  }
+
+  const char* name() const override { return "raw"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+
+  uint64_t candidates() const { return candidates_.load(); }
+  uint64_t confirmed() const { return confirmed_.load(); }
+  uint64_t previews() const { return previews_.load(); }
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_TIFF,
+    TAG_BMFF,
+  };
+
+  void extractPreviews(uint64_t raw_id, uint64_t offset, const MediaInfo& info,
+                       CarveContext& ctx);
+
+  RawCarveOptions options_;
+  std::atomic<uint64_t> candidates_{0};
+  std::atomic<uint64_t> confirmed_{0};
+  std::atomic<uint64_t> previews_{0};
+};
+
+}  // namespace rsn
@@ -0,0 +1,311 @@
+// RecoverySoftNetz — ISO base media file format box tree
+
+#include "carving/bmff.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint32_t MAX_TABLE = 1u << 24;  // entries read from one sample table
+constexpr uint64_t VISUAL_ENTRY_FIELDS = 78;  // VisualSampleEntry before its child boxes
+
+bool sameType(const uint8_t* type, const char* name)
+{
+  return std::memcmp(type, name, 4) == 0;
+}
+
+bool readExact(const BoxReader& read, uint64_t offset, uint8_t* out, size_t length)
+{
+  return length == 0 || read(offset, out, length) == length;
+}
+
+/// Read a full-box table: `head` bytes (version/flags first, entry count
+/// last), then `count * width` bytes of entries.
+bool readTable(const BoxReader& read, const BmffBox& box, size_t head, size_t width,
+               uint8_t* header, std::vector<uint8_t>& table)
+{
+  if (box.end - box.payload < head || !readExact(read, box.payload, header, head))
+  {
+    return false;
+  }
+  uint32_t count = loadBE32(header + head - 4);
+  if (count > MAX_TABLE || uint64_t(count) * width > box.end - box.payload - head)
+  {
+    return false;
+  }
+  table.resize(count * width);
+  return readExact(read, box.payload + head, table.data(), table.size());
+}
+
+bool readSampleDescription(const BoxReader& read, const BmffBox& stsd, BmffTrack& track)
+{
+  uint8_t head[8];
+  BmffBox entry;
+  if (stsd.end - stsd.payload < 8 || !readExact(read, stsd.payload, head, 8))
+  {
+    return false;
+  }
+  if (loadBE32(head + 4) == 0)
+  {
+    return true;  // no description: the codec stays unknown
+  }
+  if (!readBox(read, stsd.payload + 8, stsd.end, entry))
+  {
+    return false;
+  }
+  std::memcpy(track.codec, entry.type, 4);
+  bool avc = entry.is("avc1") || entry.is("avc3");
+  bool hevc = entry.is("hvc1") || entry.is("hev1");
+  if ((!avc && !hevc) || entry.end - entry.payload < VISUAL_ENTRY_FIELDS)
+  {
+    return true;
+  }
+  // lengthSizeMinusOne sits in the low bits of avcC byte 4 and hvcC byte 21.
+  forEachBox(read, entry.payload + VISUAL_ENTRY_FIELDS, entry.end, [&](const BmffBox& child)
+  {
+    uint8_t config[22];
+    size_t at = avc ? 4 : 21;
+    if ((avc && child.is("avcC")) || (hevc && child.is("hvcC")))
+    {
+      if (child.end - child.payload > at && readExact(read, child.payload, config, at + 1))
+      {
+        track.nal_length_size = (config[at] & 3) + 1;
+      }
+      return false;
+    }
+    return true;
+  });
+  return true;
+}
+
+bool readTrack(const BoxReader& read, uint64_t begin, uint64_t end, BmffTrack& track)
+{
+  std::vector<uint8_t> table;
+  return forEachBox(read, begin, end, [&](const BmffBox& box)
+  {
+    uint8_t head[12];
+    if (box.is("mdia") || box.is("minf") || box.is("stbl"))
+    {
+      return readTrack(read, box.payload, box.end, track);
+    }
+    if (box.is("stsd"))
+    {
+      return readSampleDescription(read, box, track);
+    }
+    if (box.is("stsz"))
+    {
+      // version/flags, fixed size, count; the table only when no fixed size.
+      if (box.end - box.payload < 12 || !readExact(read, box.payload, head, 12) ||
+          loadBE32(head + 8) > MAX_TABLE)
+      {
+        return false;
+      }
+      if (loadBE32(head + 4) != 0)
+      {
+        track.sample_sizes.assign(loadBE32(head + 8), loadBE32(head + 4));
+        return true;
+      }
+      if (!readTable(read, box, 12, 4, head, table))
+      {
+        return false;
+      }
+      track.sample_sizes.resize(table.size() / 4);
+      for (size_t i = 0; i < track.sample_sizes.size(); ++i)
+      {
+        track.sample_sizes[i] = loadBE32(table.data() + 4 * i);
+      }
+      return true;
+    }
+    if (box.is("stco") || box.is("co64"))
+    {
+      size_t width = box.is("co64") ? 8 : 4;
+      if (!readTable(read, box, 8, width, head, table))
+      {
+        return false;
+      }
+      track.chunk_offsets.resize(table.size() / width);
+      for (size_t i = 0; i < track.chunk_offsets.size(); ++i)
+      {
+        const uint8_t* p = table.data() + width * i;
+        track.chunk_offsets[i] = width == 8 ? loadBE64(p) : loadBE32(p);
+      }
+      return true;
+    }
+    if (box.is("stsc"))
+    {
+      if (!readTable(read, box, 8, 12, head, table))
+      {
+        return false;
+      }
+      track.sample_to_chunk.resize(table.size() / 12);
+      for (size_t i = 0; i < track.sample_to_chunk.size(); ++i)
+      {
+        const uint8_t* p = table.data() + 12 * i;
+        track.sample_to_chunk[i] = {loadBE32(p), loadBE32(p + 4)};
+      }
+    }
+    return true;
+  });
+}
+
+}  // namespace
+
+bool BmffBox::is(const char* name) const
+{
+  return sameType(type, name);
+}
+
+bool isTopLevelBox(const uint8_t* type)
+{
+  static const char* const boxes[] = {"ftyp", "moov", "mdat", "free", "skip", "wide", "uuid",
+                                      "meta", "moof", "mfra", "pdin", "styp", "sidx", "ssix",
+                                      "prft", "udta", "pnot", "PICT", "junk"};
+  for (const char* box : boxes)
+  {
+    if (sameType(type, box))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool readBox(const BoxReader& read, uint64_t offset, uint64_t end, BmffBox& box)
+{
+  uint8_t head[16];
+  if (offset > end || end - offset < 8 || !readExact(read, offset, head, 8))
+  {
+    return false;
+  }
+  uint64_t size = loadBE32(head);
+  uint64_t header = 8;
+  if (size == 1)
+  {
+    if (end - offset < 16 || !readExact(read, offset + 8, head + 8, 8))
+    {
+      return false;
+    }
+    size = loadBE64(head + 8);
+    header = 16;
+  }
+  box.to_end = size == 0;
+  if (box.to_end)
+  {
+    size = end - offset;
+  }
+  if (size < header || size > end - offset)
+  {
+    return false;
+  }
+  std::memcpy(box.type, head + 4, 4);
+  box.offset = offset;
+  box.payload = offset + header;
+  box.end = offset + size;
+  return true;
+}
+
+bool forEachBox(const BoxReader& read, uint64_t begin, uint64_t end,
+                const std::function<bool(const BmffBox&)>& fn)
+{
+  uint64_t pos = begin;
+  while (end - pos >= 8)
+  {
+    BmffBox box;
+    if (!readBox(read, pos, end, box) || !fn(box))
+    {
+      return false;
+    }
+    pos = box.end;
+  }
+  return true;
+}
+
+void classifyBrand(const uint8_t* ftyp, size_t size, std::string& type, std::string& extension)
+{
+  auto brand = [&](const char* name)
+  {
+    for (size_t at = 8; at + 4 <= size; at += at == 8 ? 8 : 4)
+    {
+      if (sameType(ftyp + at, name))
+      {
+        return true;
+      }
+    }
+    return false;
+  };
+  if (brand("crx "))
+  {
+    type = "image/cr3";
+    extension = "CR3";
+  }
+  else if (brand("heic") || brand("heix") || brand("mif1") || brand("msf1"))
+  {
+    type = "image/heic";
+    extension = "HEIC";
+  }
+  else if (brand("qt  "))
+  {
+    type = "video/mov";
+    extension = "MOV";
+  }
+  else
+  {
+    type = "video/mp4";
+    extension = "MP4";
+  }
+}
+
+bool parseMovie(const BoxReader& read, uint64_t begin, uint64_t end,
+                std::vector<BmffTrack>& tracks)
+{
+  return forEachBox(read, begin, end, [&](const BmffBox& box)
+  {
+    if (!box.is("trak"))
+    {
+      return true;
+    }
+    tracks.emplace_back();
+    return readTrack(read, box.payload, box.end, tracks.back());
+  });
+}
+
+bool sampleLayout(const BmffTrack& track, uint32_t index, std::vector<BmffSample>& out)
+{
+  const auto& chunks = track.chunk_offsets;
+  const auto& sizes = track.sample_sizes;
+  size_t sample = 0;
+  size_t entries = track.sample_to_chunk.size();
+  for (size_t e = 0; e < std::max<size_t>(entries, 1); ++e)
+  {
+    uint64_t first = entries != 0 ? track.sample_to_chunk[e][0] : 1;
+    uint64_t next = e + 1 < entries ? track.sample_to_chunk[e + 1][0] : chunks.size() + 1;
+    uint32_t per_chunk = entries != 0 ? track.sample_to_chunk[e][1] : 1;
+    if (first == 0 || next < first)
+    {
+      return false;
+    }
+    for (uint64_t chunk = first; chunk < next && chunk <= chunks.size(); ++chunk)
+    {
+      uint64_t offset = chunks[chunk - 1];
+      for (uint32_t s = 0; s < per_chunk; ++s, ++sample)
+      {
+        if (sample >= sizes.size())
+        {
+          return false;
+        }
+        out.push_back({offset, sizes[sample], index});
+        offset += sizes[sample];
+      }
+    }
+  }
+  return sample == sizes.size();
+}
+
+}  // namespace rsn
@@ -0,0 +1,78 @@
+// RecoverySoftNetz — ISO base media file format box tree
+//
+// Shared reading of MP4, MOV, HEIC and CR3 structure: box headers (32-bit,
+// 64-bit and to-end sizes), the brand of the ftyp box, and the sample tables
+// of each track in a moov box. Sample offsets are relative to the start of
+// the file, which is what lets a carver tell where each piece of a fragmented
+// mdat has to come from.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// Positional read from the file being parsed; short at its end.
+using BoxReader = std::function<size_t(uint64_t offset, uint8_t* out, size_t length)>;
+
+struct BmffBox
+{
+  uint8_t type[4] = {};
+  uint64_t offset = 0;   // first byte of the header
+  uint64_t payload = 0;  // first byte after the header
+  uint64_t end = 0;
+  bool to_end = false;   // size 0: the box runs to the end of its parent
+
+  bool is(const char* name) const;
+};
+
+/// Box types that may appear at the top level of a file; anything else after
+/// a box means that box was the file's last.
+bool isTopLevelBox(const uint8_t* type);
+
+/// Read the box header at `offset`; the box must end by `end`. A size of 0
+/// (box runs to the end of its parent) is resolved to `end`.
+bool readBox(const BoxReader& read, uint64_t offset, uint64_t end, BmffBox& box);
+
+/// Call fn(box) for each box in [begin, end) until it returns false. False
+/// when it does, or when a box header is cut short or overruns the range.
+bool forEachBox(const BoxReader& read, uint64_t begin, uint64_t end,
+                const std::function<bool(const BmffBox&)>& fn);
+
+/// Registry type and customary extension for an ftyp box (header included),
+/// from its major brand, then its compatible brands.
+void classifyBrand(const uint8_t* ftyp, size_t size, std::string& type, std::string& extension);
+
+struct BmffTrack
+{
+  uint8_t codec[4] = {};        // first sample description, e.g. "avc1", "mp4a"
+  uint8_t nal_length_size = 0;  // AVC/HEVC sample NAL length prefix; 0 for other codecs
+  std::vector<uint32_t> sample_sizes;                    // stsz
+  std::vector<uint64_t> chunk_offsets;                   // stco or co64
+  std::vector<std::array<uint32_t, 2>> sample_to_chunk;  // stsc: first chunk, samples per chunk
+};
+
+/// Read the tracks of the moov box whose payload is [begin, end). False when
+/// the tree is malformed or a sample table is cut short.
+bool parseMovie(const BoxReader& read, uint64_t begin, uint64_t end,
+                std::vector<BmffTrack>& tracks);
+
+struct BmffSample
+{
+  uint64_t offset = 0;  // from the start of the file
+  uint32_t size = 0;
+  uint32_t track = 0;
+};
+
+/// Append the samples of `track` (its index being `index`) in chunk order.
+/// Without a sample-to-chunk table each chunk holds one sample. False when
+/// the tables disagree on the sample count.
+bool sampleLayout(const BmffTrack& track, uint32_t index, std::vector<BmffSample>& out);
+
+}  // namespace rsn
@@ -0,0 +1,450 @@
+// RecoverySoftNetz — ISO-BMFF (MP4, MOV, HEIC) carve stage
+
+#include "carving/bmff_carver.h"
+
+#include "carving/bmff.h"
+#include "carving/piece_map.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <unordered_set>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint64_t MAX_FTYP = 4096;
+constexpr unsigned MAX_NALS = 64;  // NAL units walked per sample
+
+constexpr double CONFIDENCE_VERIFIED = 0.95;     // every video sample fits
+constexpr double CONFIDENCE_REASSEMBLED = 0.85;  // ... once the pieces were found
+constexpr double CONFIDENCE_UNCHECKED = 0.6;     // no AVC/HEVC track, or a HEIC
+constexpr double CONFIDENCE_UNRESOLVED = 0.4;    // a piece was not found
+
+/// Assembles one file from its ftyp box; reused across files.
+class Assembler
+{
+public:
+  Assembler(Device& device, const BmffCarveOptions& options, BmffCarveStats& stats)
+    : device_(device), options_(options), stats_(stats), window_(device)
+  {
+    search_.block = options.block_size != 0 ? options.block_size : device.sectorSize();
+    search_.distance = options.search_distance;
+  }
+
+  /// Build the entry for the file whose ftyp box is at `start`, taking its moov
+  /// from `movies` when it is not found after the ftyp. False when the boxes
+  /// do not describe a file.
+  bool assemble(uint64_t start, const std::vector<uint64_t>& movies,
+                std::unordered_set<uint64_t>& claimed, RecoveredFile& file);
+
+private:
+  bool findMovie(const BmffBox& mdat, const std::vector<uint64_t>& movies,
+                 std::unordered_set<uint64_t>& claimed, uint64_t start);
+  bool fits(const PieceMap& map, const BmffSample& sample, uint64_t& good, uint64_t& bad,
+            bool backward);
+  bool fitRun(const PieceMap& map, size_t first, size_t count, bool backward);
+  bool relocate(PieceMap& map, size_t k, uint64_t good, uint64_t bad);
+
+  Device& device_;
+  const BmffCarveOptions& options_;
+  BmffCarveStats& stats_;
+  DeviceWindow window_;
+  PieceSearch search_;
+
+  std::vector<BmffTrack> tracks_;
+  std::vector<BmffSample> samples_;
+  std::vector<BmffSample> video_;  // samples of AVC/HEVC tracks, in file order
+  uint64_t movie_file_ = 0;        // moov found away from the media data: file offset,
+  uint64_t movie_device_ = 0;      // device offset
+  uint64_t movie_size_ = 0;        // and size (0 when the moov followed the ftyp)
+};
+
+bool Assembler::findMovie(const BmffBox& mdat, const std::vector<uint64_t>& movies,
+                          std::unordered_set<uint64_t>& claimed, uint64_t start)
+{
+  BoxReader read = [&](uint64_t at, uint8_t* out, size_t length) -> size_t
+  {
+    return device_.read(at, out, length);
+  };
+  // The nearest moov after the file first, then the ones before it.
+  std::vector<uint64_t> order;
+  auto after = std::lower_bound(movies.begin(), movies.end(), start);
+  order.insert(order.end(), after, movies.end());
+  order.insert(order.end(), std::make_reverse_iterator(after), movies.rend());
+  for (uint64_t at : order)
+  {
+    BmffBox moov;
+    tracks_.clear();
+    samples_.clear();
+    if (claimed.count(at) != 0 || !readBox(read, at, device_.size(), moov) || !moov.is("moov") ||
+        !parseMovie(read, moov.payload, moov.end, tracks_))
+    {
+      continue;
+    }
+    bool layout = true;
+    for (uint32_t i = 0; i < tracks_.size() && layout; ++i)
+    {
+      layout = sampleLayout(tracks_[i], i, samples_);
+    }
+    if (!layout || samples_.empty())
+    {
+      continue;
+    }
+    // Its samples must fill exactly this mdat: start at its payload, end inside it.
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    for (const BmffSample& sample : samples_)
+    {
+      first = std::min(first, sample.offset);
+      last = std::max(last, sample.offset + sample.size);
+    }
+    if (first == mdat.payload && last <= mdat.end)
+    {
+      claimed.insert(at);
+      movie_file_ = mdat.end;
+      movie_device_ = at;
+      movie_size_ = moov.end - moov.offset;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Walk the NAL length prefixes of `sample`, which must add up to its size.
+/// `good` advances past each header that checks out; on failure `bad` is the
+/// end of the header that did not.
+bool Assembler::fits(const PieceMap& map, const BmffSample& sample, uint64_t& good, uint64_t& bad,
+                     bool backward)
+{
+  const BmffTrack& track = tracks_[sample.track];
+  size_t prefix = track.nal_length_size;
+  bool hevc = track.codec[0] == 'h';
+  uint8_t head[5];
+  uint64_t pos = 0;
+  for (unsigned i = 0; i < MAX_NALS && pos < sample.size; ++i)
+  {
+    uint64_t at = sample.offset + pos;
+    bad = at + prefix + 1;
+    if (sample.size - pos < prefix + 1 || !window_.get(map, at, head, prefix + 1, backward))
+    {
+      return false;
+    }
+    uint64_t length = 0;
+    for (size_t b = 0; b < prefix; ++b)
+    {
+      length = (length << 8) | head[b];
+    }
+    uint8_t nal = head[prefix];
+    bool header = (nal & 0x80) == 0 && (hevc ? (nal >> 1) < 48 : (nal & 0x1F) != 0);
+    if (length == 0 || !header || length > sample.size - pos - prefix)
+    {
+      return false;
+    }
+    good = at + prefix + 1;
+    pos += prefix + length;
+  }
+  return true;
+}
+
+bool Assembler::fitRun(const PieceMap& map, size_t first, size_t count, bool backward)
+{
+  size_t last = std::min(video_.size(), first + count);
+  if (first >= last)
+  {
+    return false;
+  }
+  for (size_t j = first; j < last; ++j)
+  {
+    uint64_t good = 0;
+    uint64_t bad = 0;
+    if (!fits(map, video_[j], good, bad, backward))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Assembler::relocate(PieceMap& map, size_t k, uint64_t good, uint64_t bad)
+{
+  // The piece ends on an allocation-unit boundary after the last header that
+  // fit and before the end of the one that did not. Nothing between them is
+  // checked, so the earliest such boundary is taken.
+  uint64_t block = search_.block;
+  uint64_t file = (good + block - 1) / block * block;
+  if (file >= bad || file <= map.pieceStart(file))
+  {
+    return false;
+  }
+  unsigned confirm = std::max(1u, options_.confirm_samples);
+  return findPiece(map, file, search_, device_.size(), [&](bool backward)
+  {
+    return fitRun(map, k, confirm, backward);
+  });
+}
+
+bool Assembler::assemble(uint64_t start, const std::vector<uint64_t>& movies,
+                         std::unordered_set<uint64_t>& claimed, RecoveredFile& file)
+{
+  uint64_t limit = std::min(options_.max_file_size, device_.size() - start);
+  BoxReader read = [&](uint64_t at, uint8_t* out, size_t length) -> size_t
+  {
+    if (at >= limit)
+    {
+      return 0;
+    }
+    size_t take = static_cast<size_t>(std::min<uint64_t>(length, limit - at));
+    return device_.read(start + at, out, take);
+  };
+
+  // 1. Top-level boxes, while they validate.
+  BmffBox box;
+  std::vector<uint8_t> ftyp;
+  if (!readBox(read, 0, limit, box) || !box.is("ftyp") || box.end > MAX_FTYP)
+  {
+    return false;
+  }
+  ftyp.resize(box.end);
+  if (read(0, ftyp.data(), ftyp.size()) != ftyp.size())
+  {
+    return false;
+  }
+  std::string type;
+  std::string extension;
+  classifyBrand(ftyp.data(), ftyp.size(), type, extension);
+  if (type == "image/cr3")
+  {
+    return false;
+  }
+  std::vector<BmffBox> boxes;
+  uint64_t walked = 0;
+  while (readBox(read, walked, limit, box) && !box.to_end && isTopLevelBox(box.type) &&
+         (walked == 0 || !box.is("ftyp")))
+  {
+    boxes.push_back(box);
+    walked = box.end;
+  }
+  auto find = [&](const char* name) -> const BmffBox*
+  {
+    for (const BmffBox& b : boxes)
+    {
+      if (b.is(name))
+      {
+        return &b;
+      }
+    }
+    return nullptr;
+  };
+  const BmffBox* moov = find("moov");
+  const BmffBox* mdat = find("mdat");
+
+  file.type = type;
+  file.offset = start;
+  file.extents.clear();
+  if (moov == nullptr && find("meta") != nullptr)
+  {
+    // Image items (HEIC) are located by iloc, not sample tables: sized by the walk.
+    file.size = walked;
+    file.confidence = CONFIDENCE_UNCHECKED;
+    file.description = extension + ", image items";
+    return true;
+  }
+  if (moov == nullptr && mdat == nullptr)
+  {
+    return false;
+  }
+
+  // 2. The index: after the ftyp, or wherever a moov matching the mdat is.
+  tracks_.clear();
+  samples_.clear();
+  movie_size_ = 0;
+  if (moov != nullptr)
+  {
+    if (!parseMovie(read, moov->payload, moov->end, tracks_))
+    {
+      return false;
+    }
+    claimed.insert(start + moov->offset);
+    bool layout = true;
+    for (uint32_t i = 0; i < tracks_.size() && layout; ++i)
+    {
+      layout = sampleLayout(tracks_[i], i, samples_);
+    }
+    if (!layout)
+    {
+      return false;
+    }
+  }
+  else if (!findMovie(*mdat, movies, claimed, start))
+  {
+    return false;
+  }
+  bool detached = movie_size_ != 0;
+
+  uint64_t size = walked;
+  if (mdat != nullptr)
+  {
+    size = std::max(size, mdat->end);
+  }
+  if (detached)
+  {
+    size = std::max(size, movie_file_ + movie_size_);
+  }
+  video_.clear();
+  for (const BmffSample& sample : samples_)
+  {
+    size = std::max(size, sample.offset + sample.size);
+    uint8_t prefix = tracks_[sample.track].nal_length_size;
+    if (prefix == 1 || prefix == 2 || prefix == 4)
+    {
+      video_.push_back(sample);
+    }
+  }
+  if (size > options_.max_file_size)
+  {
+    return false;
+  }
+  std::sort(video_.begin(), video_.end(), [](const BmffSample& a, const BmffSample& b)
+  {
+    return a.offset < b.offset;
+  });
+
+  // 3. Follow the video samples, looking for the next piece where one does
+  // not fit. A sample that does not fit while the ones after it do is damaged
+  // rather than moved.
+  PieceMap map(start);
+  uint64_t good = std::max(moov != nullptr ? moov->end : 0, boxes.back().payload);
+  uint64_t unresolved = UINT64_MAX;
+  unsigned confirm = std::max(1u, options_.confirm_samples);
+  for (size_t k = 0; k < video_.size(); ++k)
+  {
+    const BmffSample& sample = video_[k];
+    uint64_t bad = 0;
+    if (fits(map, sample, good, bad, false) || fitRun(map, k + 1, confirm, false))
+    {
+      continue;
+    }
+    if (!relocate(map, k, good, bad))
+    {
+      unresolved = sample.offset;
+      break;
+    }
+    ++stats_.pieces;
+    fits(map, sample, good, bad, false);
+  }
+  size_t pieces = map.count();
+
+  // 4. The detached moov is a piece of its own.
+  if (detached)
+  {
+    map.add(movie_file_, movie_device_);
+  }
+  file.extents = map.extents(size);
+
+  file.size = size;
+  file.description = extension + ", " + std::to_string(tracks_.size()) + " tracks";
+  if (!file.extents.empty())
+  {
+    file.description += ", " + std::to_string(file.extents.size()) + " pieces";
+    ++stats_.fragmented;
+  }
+  if (detached)
+  {
+    file.description += ", index stored apart";
+    ++stats_.detached;
+  }
+  if (unresolved != UINT64_MAX)
+  {
+    file.confidence = CONFIDENCE_UNRESOLVED;
+    file.description += ", unverified from byte " + std::to_string(unresolved);
+    ++stats_.unresolved;
+  }
+  else if (video_.empty())
+  {
+    file.confidence = CONFIDENCE_UNCHECKED;
+  }
+  else
+  {
+    file.confidence = pieces > 1 ? CONFIDENCE_REASSEMBLED : CONFIDENCE_VERIFIED;
+  }
+  return true;
+}
+
+}  // namespace
+
+void BmffCarveStage::registerPatterns(PatternSet& patterns)
+{
+  patterns.add(std::string("ftyp"), TAG_FTYP);  // four bytes into the box
+  patterns.add(std::string("mvhd"), TAG_MVHD);  // first child of moov, twelve bytes in
+}
+
+bool BmffCarveStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  uint64_t offset = chunk.offset + pos;
+  if (tag == TAG_FTYP)
+  {
+    // Files start on a sector boundary; an ftyp box is small.
+    if (offset < 4 || (offset - 4) % ctx.device().sectorSize() != 0)
+    {
+      return false;
+    }
+    auto head = ctx.readAt(offset - 4, 4);
+    uint32_t size = head.size() == 4 ? loadBE32(head.data()) : 0;
+    if (size < 16 || size > MAX_FTYP)
+    {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    starts_.push_back(offset - 4);
+    return true;
+  }
+  if (offset < 12)
+  {
+    return false;
+  }
+  auto head = ctx.readAt(offset - 12, 8);
+  if (head.size() == 8 && std::memcmp(head.data() + 4, "moov", 4) == 0 &&
+      loadBE32(head.data()) >= 8)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    movies_.push_back(offset - 12);
+    return true;
+  }
+  return false;
+}
+
+void BmffCarveStage::finish(CarveContext& ctx)
+{
+  stats_ = BmffCarveStats();
+  std::sort(starts_.begin(), starts_.end());
+  std::sort(movies_.begin(), movies_.end());
+  std::unordered_set<uint64_t> claimed;
+  Assembler assembler(ctx.device(), options_, stats_);
+  for (uint64_t start : starts_)
+  {
+    RecoveredFile file;
+    if (!assembler.assemble(start, movies_, claimed, file))
+    {
+      continue;
+    }
+    file.source = name();
+    ctx.registry().add(std::move(file));
+    ++stats_.files;
+  }
+  for (uint64_t movie : movies_)
+  {
+    stats_.orphan_movies += claimed.count(movie) == 0 ? 1 : 0;
+  }
+  accepted_[TAG_FTYP] = stats_.files;
+  accepted_[TAG_MVHD] = movies_.size() - stats_.orphan_movies;
+  starts_.clear();
+  movies_.clear();
+}
+
+}  // namespace rsn
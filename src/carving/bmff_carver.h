@@ -0,0 +1,81 @@
+// RecoverySoftNetz — ISO-BMFF (MP4, MOV, HEIC) carve stage
+//
+// Phone and camera videos are too large to assume contiguous, and their moov
+// box (the index) is often written after the media data. The stage records
+// every ftyp box and every moov box during the scan and assembles files in
+// `finish`:
+//   1. top-level boxes are walked from the ftyp while their headers validate;
+//      a moov found there is the file's index, otherwise the unclaimed moov
+//      whose samples exactly fill the walked mdat is taken, wherever it lies;
+//   2. the stco/co64 tables give the file offset of every sample. Video
+//      samples (AVC and HEVC) are checked where the current mapping puts them
+//      by walking their NAL length prefixes, which must add up to the size the
+//      sample table records;
+//   3. where a sample does not fit, the file was fragmented: the next piece is
+//      looked for forward, then backward, at allocation-unit granularity, and
+//      accepted where several consecutive samples fit.
+// Only box headers, sample tables and NAL headers are read, so multi-GB files
+// cost a few reads per frame and no buffering of the media data. HEIC files,
+// which have no sample tables, are sized by the top-level walk. CR3 is left
+// to the RAW stage.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rsn
+{
+
+struct BmffCarveOptions
+{
+  uint64_t max_file_size = 64ull << 30;
+  uint32_t block_size = 0;                  // fragment granularity; 0 = device sector size
+  uint64_t search_distance = 256ull << 20;  // how far a missing piece is looked for, each way
+  unsigned confirm_samples = 3;             // video samples that must fit at a new piece
+};
+
+struct BmffCarveStats
+{
+  uint64_t files = 0;
+  uint64_t fragmented = 0;     // files assembled from more than one piece
+  uint64_t pieces = 0;         // pieces found by searching
+  uint64_t detached = 0;       // files whose moov was found away from the media data
+  uint64_t unresolved = 0;     // files registered with a part whose place was not found
+  uint64_t orphan_movies = 0;  // moov boxes no ftyp claimed
+};
+
+class BmffCarveStage : public CarveStage
+{
+public:
+  explicit BmffCarveStage(BmffCarveOptions options = BmffCarveOptions()) : options_(options) {}
+
+  const char* name() const override { return "bmff"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  void finish(CarveContext& ctx) override;
+  bool defersValidation() const override { return true; }
+  uint64_t acceptedHits(uint32_t tag) const override { return tag < 2 ? accepted_[tag] : 0; }
+
+  /// Valid once the pipeline has finished.
+  const BmffCarveStats& stats() const { return stats_; }
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_FTYP,
+    TAG_MVHD,
+  };
+
+  BmffCarveOptions options_;
+  std::mutex mutex_;
+  std::vector<uint64_t> starts_;  // ftyp box offsets
+  std::vector<uint64_t> movies_;  // moov box offsets
+  BmffCarveStats stats_;
+  uint64_t accepted_[2] = {};  // hits of each tag `finish` made use of
+};
+
+}  // namespace rsn
@@ -0,0 +1,870 @@
+// RecoverySoftNetz — OLE2 compound file (CFB) carve stage
+
+#include "carving/cfb_carver.h"
+
+#include "carving/piece_map.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint8_t SIGNATURE[] = {0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1};
+
+constexpr uint32_t MAXREGSECT = 0xFFFFFFFA;
+constexpr uint32_t DIFSECT = 0xFFFFFFFC;
+constexpr uint32_t FATSECT = 0xFFFFFFFD;
+constexpr uint32_t ENDOFCHAIN = 0xFFFFFFFE;
+constexpr uint32_t FREESECT = 0xFFFFFFFF;
+constexpr uint32_t MAXREGSID = 0xFFFFFFFA;
+constexpr uint32_t NOSTREAM = 0xFFFFFFFF;
+
+constexpr size_t HEADER_SIZE = 512;
+constexpr size_t HEADER_DIFAT = 109;   // FAT sector numbers the header holds
+constexpr size_t ENTRY_SIZE = 128;     // directory entry
+constexpr uint16_t MINI_SHIFT = 6;
+constexpr uint32_t MINI_CUTOFF = 4096;  // smaller streams live in the mini stream
+constexpr size_t WINDOW = 256u << 10;
+constexpr unsigned CONFIRM_RECORDS = 4;  // headers after a relocated one that must fit too
+
+constexpr double CONFIDENCE_VERIFIED = 0.95;     // every checked sector fits
+constexpr double CONFIDENCE_REASSEMBLED = 0.85;  // ... once the pieces were found
+constexpr double CONFIDENCE_AMBIGUOUS = 0.6;     // ... where a break falls between them is not
+constexpr double CONFIDENCE_UNRESOLVED = 0.4;    // a piece was not found
+
+enum EntryType : uint8_t
+{
+  ENTRY_UNUSED = 0,
+  ENTRY_STORAGE = 1,
+  ENTRY_STREAM = 2,
+  ENTRY_ROOT = 5,
+};
+
+/// How a stream is laid out past its first bytes.
+enum class Records : uint8_t
+{
+  None,
+  Biff,  // type and length, 16 bits each
+  Ppt,   // version and instance, type (16 bits each), length (32 bits); containers nest
+};
+
+/// Streams whose first bytes identify the application that wrote the file.
+struct KnownStream
+{
+  const char* name;
+  size_t at;
+  uint8_t magic[2];
+  Records records;
+  const char* type;
+  const char* label;
+};
+
+const KnownStream KNOWN_STREAMS[] = {
+  {"WordDocument", 0, {0xEC, 0xA5}, Records::None, "document/doc", "Word document"},  // FIB
+  {"Workbook", 0, {0x09, 0x08}, Records::Biff, "document/xls", "Excel workbook"},     // BOF
+  {"Book", 0, {0x09, 0x08}, Records::Biff, "document/xls", "Excel workbook"},         // BIFF5
+  {"PowerPoint Document", 2, {0xE8, 0x03}, Records::Ppt, "document/ppt",
+   "PowerPoint presentation"},
+  {"VisioDocument", 0, {'V', 'i'}, Records::None, "document/vsd", "Visio drawing"},
+};
+
+constexpr uint16_t BIFF_MAX_TYPE = 0x10FF;
+constexpr uint16_t BIFF_MAX_LENGTH = 8224;
+constexpr uint16_t PPT_MIN_TYPE = 0x03E8;  // document records
+constexpr uint16_t PPT_MAX_TYPE = 0x2F14;
+constexpr uint16_t ART_MIN_TYPE = 0xF000;  // drawing records
+constexpr uint16_t ART_MAX_TYPE = 0xF13F;
+
+enum class Part : uint8_t
+{
+  Fat,
+  Difat,
+  Directory,
+  MiniFat,
+  Stream,
+};
+
+/// A sector whose contents can be checked. `index` is the sector's position
+/// in the FAT, DIFAT chain, directory or mini FAT, or the stream's walk.
+struct Check
+{
+  Part part = Part::Fat;
+  uint32_t index = 0;
+  uint64_t at = 0;  // Stream: offset in the stream of the record header checked
+  bool passed = false;
+};
+
+/// A known stream, whose records are walked while pieces are placed.
+struct Walk
+{
+  const KnownStream* known = nullptr;
+  std::vector<uint32_t> chain;
+  uint64_t size = 0;
+};
+
+std::string entryName(const uint8_t* entry)
+{
+  size_t chars = loadLE16(entry + 64) / 2;
+  std::string name;
+  for (size_t i = 0; i + 1 < chars; ++i)
+  {
+    uint16_t c = loadLE16(entry + 2 * i);
+    name.push_back(c >= 0x20 && c < 0x7F ? static_cast<char>(c) : '?');
+  }
+  return name;
+}
+
+/// Sizes and checks one compound file.
+class CompoundFile
+{
+public:
+  CompoundFile(Device& device, uint64_t start, const CfbCarveOptions& options)
+    : device_(device), options_(options), window_(device, WINDOW), start_(start), map_(start)
+  {
+    search_.block = options.block_size != 0 ? options.block_size : device.sectorSize();
+    search_.distance = options.search_distance;
+  }
+
+  /// False when the header is not that of a compound file.
+  bool readHeader(const uint8_t* header);
+
+  /// Check the file and build its entry. False when no FAT sector checks out.
+  /// Checking is done twice: while the structure is discovered, which sectors
+  /// can be checked is only learnt along the way, so pieces are placed again
+  /// once every one of them is known.
+  bool assemble(RecoveredFile& file);
+
+private:
+  uint64_t fileOffset(uint32_t sector) const { return (uint64_t(sector) + 1) << shift_; }
+  bool readSector(uint32_t sector, bool backward);
+  bool readStream(const Walk& walk, uint64_t at, uint8_t* out, size_t length, bool backward);
+  bool schedule(uint32_t sector, Part part, uint32_t index, uint64_t at = 0);
+  std::vector<uint32_t> chain(uint32_t first) const;
+
+  bool fits(uint32_t sector, const Check& check, bool backward);
+  bool fatFits(uint32_t index) const;
+  bool difatFits(uint32_t index) const;
+  bool directoryFits(uint32_t index) const;
+  bool miniFatFits(uint32_t index) const;
+  bool recordFits(const Walk& walk, uint64_t at, bool backward, uint64_t& next);
+
+  void verify();
+  void accept(const Check& check);
+  bool relocate(uint32_t sector, uint64_t good, uint64_t bad);
+  bool confirm(uint64_t from, uint32_t sector, bool backward);
+  void loadFat();
+
+  Device& device_;
+  const CfbCarveOptions& options_;
+  DeviceWindow window_;
+  uint64_t start_;
+  PieceMap map_;
+  PieceSearch search_;
+
+  uint16_t version_ = 0;
+  uint16_t shift_ = 0;
+  size_t sector_size_ = 0;
+  uint32_t fat_count_ = 0;
+  uint32_t first_directory_ = 0;
+  uint32_t first_mini_fat_ = 0;
+  uint32_t mini_fat_count_ = 0;
+  uint64_t entry_bound_ = 0;  // sectors the FAT can describe
+  uint64_t mini_bound_ = 0;   // mini sectors in the mini stream
+
+  std::vector<uint32_t> fat_sectors_;             // by position in the FAT
+  std::unordered_map<uint32_t, uint32_t> roles_;  // FAT and DIFAT sectors -> their FAT entry
+  std::vector<uint32_t> fat_;
+  std::map<uint32_t, Check> checks_;  // by sector
+  std::set<uint32_t> pending_;        // sectors not checked yet
+  bool discovering_ = true;
+  std::vector<uint8_t> sector_;
+
+  std::vector<Walk> walks_;
+  std::vector<std::string> names_;  // directory entries
+  size_t streams_ = 0;
+  uint64_t ambiguous_ = 0;            // bytes between a found piece and the last check before it
+  uint64_t unresolved_ = UINT64_MAX;  // file offset from which nothing could be checked
+};
+
+bool CompoundFile::readHeader(const uint8_t* header)
+{
+  if (std::memcmp(header, SIGNATURE, sizeof(SIGNATURE)) != 0 || loadLE16(header + 28) != 0xFFFE)
+  {
+    return false;
+  }
+  version_ = loadLE16(header + 26);
+  shift_ = loadLE16(header + 30);
+  if (!((version_ == 3 && shift_ == 9) || (version_ == 4 && shift_ == 12)) ||
+      loadLE16(header + 32) != MINI_SHIFT || loadLE32(header + 56) != MINI_CUTOFF)
+  {
+    return false;
+  }
+  sector_size_ = size_t(1) << shift_;
+  fat_count_ = loadLE32(header + 44);
+  first_directory_ = loadLE32(header + 48);
+  first_mini_fat_ = loadLE32(header + 60);
+  mini_fat_count_ = loadLE32(header + 64);
+  uint32_t first_difat = loadLE32(header + 68);
+  uint32_t difat_count = loadLE32(header + 72);
+
+  uint64_t per_fat = sector_size_ / 4;
+  uint64_t per_difat = per_fat - 1;
+  entry_bound_ = uint64_t(fat_count_) * per_fat;
+  if (fat_count_ == 0 || (entry_bound_ - per_fat) << shift_ >= options_.max_file_size ||
+      first_directory_ >= entry_bound_ ||
+      (mini_fat_count_ != 0 && first_mini_fat_ >= entry_bound_))
+  {
+    return false;
+  }
+  uint64_t needed = fat_count_ > HEADER_DIFAT
+                      ? (fat_count_ - HEADER_DIFAT + per_difat - 1) / per_difat
+                      : 0;
+  if (difat_count != needed || (needed != 0 && first_difat >= entry_bound_))
+  {
+    return false;
+  }
+
+  fat_sectors_.assign(fat_count_, FREESECT);
+  for (size_t i = 0; i < HEADER_DIFAT; ++i)
+  {
+    uint32_t sector = loadLE32(header + 76 + 4 * i);
+    if (i >= fat_count_)
+    {
+      if (sector != FREESECT)
+      {
+        return false;
+      }
+      continue;
+    }
+    if (sector >= entry_bound_ || !schedule(sector, Part::Fat, static_cast<uint32_t>(i)))
+    {
+      return false;
+    }
+    fat_sectors_[i] = sector;
+    roles_[sector] = FATSECT;
+  }
+  if (needed != 0)
+  {
+    roles_[first_difat] = DIFSECT;
+    return schedule(first_difat, Part::Difat, 0);
+  }
+  return true;
+}
+
+bool CompoundFile::readSector(uint32_t sector, bool backward)
+{
+  sector_.resize(sector_size_);
+  return window_.get(map_, fileOffset(sector), sector_.data(), sector_size_, backward);
+}
+
+bool CompoundFile::readStream(const Walk& walk, uint64_t at, uint8_t* out, size_t length,
+                              bool backward)
+{
+  while (length != 0)
+  {
+    uint64_t index = at >> shift_;
+    if (index >= walk.chain.size())
+    {
+      return false;
+    }
+    size_t in = static_cast<size_t>(at & (sector_size_ - 1));
+    size_t take = std::min(length, sector_size_ - in);
+    if (!window_.get(map_, fileOffset(walk.chain[index]) + in, out, take, backward))
+    {
+      return false;
+    }
+    at += take;
+    out += take;
+    length -= take;
+  }
+  return true;
+}
+
+bool CompoundFile::schedule(uint32_t sector, Part part, uint32_t index, uint64_t at)
+{
+  Check check;
+  check.part = part;
+  check.index = index;
+  check.at = at;
+  if (!checks_.emplace(sector, check).second)
+  {
+    return false;
+  }
+  pending_.insert(sector);
+  return true;
+}
+
+std::vector<uint32_t> CompoundFile::chain(uint32_t first) const
+{
+  std::vector<uint32_t> out;
+  for (uint32_t sector = first; sector < fat_.size() && out.size() < fat_.size();
+       sector = fat_[sector])
+  {
+    out.push_back(sector);
+  }
+  return out;
+}
+
+bool CompoundFile::fits(uint32_t sector, const Check& check, bool backward)
+{
+  if (check.part == Part::Stream)
+  {
+    uint64_t next = 0;
+    return recordFits(walks_[check.index], check.at, backward, next);
+  }
+  if (!readSector(sector, backward))
+  {
+    return false;
+  }
+  switch (check.part)
+  {
+  case Part::Fat:
+    return fatFits(check.index);
+  case Part::Difat:
+    return difatFits(check.index);
+  case Part::Directory:
+    return directoryFits(check.index);
+  case Part::MiniFat:
+    return miniFatFits(check.index);
+  case Part::Stream:
+    break;
+  }
+  return false;
+}
+
+/// Every entry is a sector of the file or a marker, no sector has two
+/// predecessors or is its own successor, FAT and DIFAT sectors are marked as
+/// such, and something is allocated.
+bool CompoundFile::fatFits(uint32_t index) const
+{
+  size_t per = sector_size_ / 4;
+  uint64_t base = uint64_t(index) * per;
+  std::vector<uint32_t> successors;
+  bool allocated = false;
+  for (size_t k = 0; k < per; ++k)
+  {
+    uint32_t entry = loadLE32(sector_.data() + 4 * k);
+    auto role = roles_.find(static_cast<uint32_t>(base + k));
+    if (role != roles_.end() && entry != role->second)
+    {
+      return false;
+    }
+    if (entry <= MAXREGSECT)
+    {
+      if (entry >= entry_bound_ || entry == base + k)
+      {
+        return false;
+      }
+      successors.push_back(entry);
+    }
+    else if (entry == MAXREGSECT + 1)
+    {
+      return false;
+    }
+    allocated |= entry != FREESECT;
+  }
+  std::sort(successors.begin(), successors.end());
+  return allocated && std::adjacent_find(successors.begin(), successors.end()) == successors.end();
+}
+
+/// The FAT sector numbers this DIFAT sector must hold, then free entries, then
+/// the next DIFAT sector or the end of the chain.
+bool CompoundFile::difatFits(uint32_t index) const
+{
+  size_t per = sector_size_ / 4 - 1;
+  uint64_t before = HEADER_DIFAT + uint64_t(index) * per;
+  uint64_t held = fat_count_ > before ? std::min<uint64_t>(per, fat_count_ - before) : 0;
+  for (size_t k = 0; k < per; ++k)
+  {
+    uint32_t entry = loadLE32(sector_.data() + 4 * k);
+    if (k < held ? entry >= entry_bound_ : entry != FREESECT)
+    {
+      return false;
+    }
+  }
+  uint32_t next = loadLE32(sector_.data() + 4 * per);
+  if (fat_count_ > before + per)
+  {
+    return next < entry_bound_;
+  }
+  return next == ENDOFCHAIN || next == FREESECT;
+}
+
+/// Entries are unused, storages or streams with terminated even-length names
+/// and valid tree links; the directory's first entry is the root.
+bool CompoundFile::directoryFits(uint32_t index) const
+{
+  bool allocated = false;
+  for (size_t e = 0; e < sector_size_ / ENTRY_SIZE; ++e)
+  {
+    const uint8_t* entry = sector_.data() + e * ENTRY_SIZE;
+    uint8_t type = entry[66];
+    bool root = index == 0 && e == 0;
+    if (type == ENTRY_UNUSED && !root)
+    {
+      continue;
+    }
+    if ((type == ENTRY_ROOT) != root || (type != ENTRY_STORAGE && type != ENTRY_STREAM && !root))
+    {
+      return false;
+    }
+    uint16_t length = loadLE16(entry + 64);
+    if (length < 4 || length > 64 || length % 2 != 0 || loadLE16(entry + length - 2) != 0 ||
+        entry[67] > 1)
+    {
+      return false;
+    }
+    for (size_t link = 68; link <= 76; link += 4)
+    {
+      uint32_t id = loadLE32(entry + link);
+      if (id > MAXREGSID && id != NOSTREAM)
+      {
+        return false;
+      }
+    }
+    allocated = true;
+  }
+  return allocated;
+}
+
+/// As a FAT sector, over the mini sectors of the mini stream.
+bool CompoundFile::miniFatFits(uint32_t index) const
+{
+  size_t per = sector_size_ / 4;
+  uint64_t base = uint64_t(index) * per;
+  std::vector<uint32_t> successors;
+  for (size_t k = 0; k < per; ++k)
+  {
+    uint32_t entry = loadLE32(sector_.data() + 4 * k);
+    if (entry <= MAXREGSECT)
+    {
+      if (entry >= mini_bound_ || entry == base + k)
+      {
+        return false;
+      }
+      successors.push_back(entry);
+    }
+    else if (entry != ENDOFCHAIN && entry != FREESECT)
+    {
+      return false;
+    }
+  }
+  std::sort(successors.begin(), successors.end());
+  return std::adjacent_find(successors.begin(), successors.end()) == successors.end();
+}
+
+/// The stream's magic at its start, and a plausible record header at `at`;
+/// `next` is where the following header is (the stream's size at its end).
+bool CompoundFile::recordFits(const Walk& walk, uint64_t at, bool backward, uint64_t& next)
+{
+  const KnownStream& known = *walk.known;
+  uint8_t head[8];
+  size_t length = known.records == Records::Ppt ? 8 : 4;
+  if (at == 0 && (walk.size < known.at + sizeof(known.magic) ||
+                  !readStream(walk, known.at, head, sizeof(known.magic), backward) ||
+                  std::memcmp(head, known.magic, sizeof(known.magic)) != 0))
+  {
+    return false;
+  }
+  next = walk.size;
+  if (known.records == Records::None)
+  {
+    return true;
+  }
+  if (walk.size - at < length || !readStream(walk, at, head, length, backward))
+  {
+    return false;
+  }
+  if (known.records == Records::Biff)
+  {
+    uint16_t type = loadLE16(head);
+    uint16_t size = loadLE16(head + 2);
+    if (type == 0 && size == 0 && walk.size - at < MINI_CUTOFF)
+    {
+      return true;  // padding up to the size of a regular stream
+    }
+    if (type == 0 || type > BIFF_MAX_TYPE || size > BIFF_MAX_LENGTH ||
+        size > walk.size - at - length)
+    {
+      return false;
+    }
+    next = at + length + size;
+    return true;
+  }
+  uint16_t type = loadLE16(head + 2);
+  uint32_t size = loadLE32(head + 4);
+  bool container = (head[0] & 0x0F) == 0x0F;
+  if (!((type >= PPT_MIN_TYPE && type <= PPT_MAX_TYPE) ||
+        (type >= ART_MIN_TYPE && type <= ART_MAX_TYPE)) ||
+      size > walk.size - at - length)
+  {
+    return false;
+  }
+  next = at + length + (container ? 0 : size);
+  return true;
+}
+
+/// Check the pending sectors in file order, looking for the piece that holds
+/// each one that does not fit where the map puts it.
+void CompoundFile::verify()
+{
+  while (!pending_.empty() && unresolved_ == UINT64_MAX)
+  {
+    uint32_t sector = *pending_.begin();
+    Check& check = checks_[sector];
+    if (!fits(sector, check, false))
+    {
+      // The piece starts after the last sector that fit and within this one.
+      uint64_t good = sector_size_;
+      for (auto it = checks_.lower_bound(sector); it != checks_.begin();)
+      {
+        --it;
+        if (it->second.passed)
+        {
+          good = fileOffset(it->first) + sector_size_;
+          break;
+        }
+      }
+      if (!relocate(sector, good, fileOffset(sector) + sector_size_))
+      {
+        if (discovering_)
+        {
+          // What it points to stays unknown; placement decides whether the
+          // file is whole.
+          pending_.erase(pending_.begin());
+          continue;
+        }
+        unresolved_ = fileOffset(sector);
+        return;
+      }
+      fits(sector, check, false);
+    }
+    pending_.erase(pending_.begin());
+    check.passed = true;
+    accept(check);
+  }
+}
+
+/// Schedule what a sector that fit points to. FAT, DIFAT and directory
+/// sectors, whose contents are in `sector_`, while discovering; records of
+/// known streams while placing.
+void CompoundFile::accept(const Check& check)
+{
+  if (check.part == Part::Stream)
+  {
+    // Headers in the same sector fit with this one; the next check is the
+    // first header in another.
+    const Walk& walk = walks_[check.index];
+    uint32_t sector = walk.chain[check.at >> shift_];
+    uint64_t at = check.at;
+    uint64_t next = 0;
+    while (!discovering_ && recordFits(walk, at, false, next) && next < walk.size)
+    {
+      at = next;
+      uint32_t holder = walk.chain[std::min<uint64_t>(at >> shift_, walk.chain.size() - 1)];
+      if (holder != sector)
+      {
+        schedule(holder, Part::Stream, check.index, at);
+        return;
+      }
+    }
+    return;
+  }
+  if (!discovering_)
+  {
+    return;
+  }
+  if (check.part == Part::Difat)
+  {
+    size_t per = sector_size_ / 4 - 1;
+    uint64_t before = HEADER_DIFAT + uint64_t(check.index) * per;
+    uint64_t held = std::min<uint64_t>(per, fat_count_ - before);
+    for (size_t k = 0; k < held; ++k)
+    {
+      uint32_t sector = loadLE32(sector_.data() + 4 * k);
+      fat_sectors_[before + k] = sector;
+      roles_[sector] = FATSECT;
+      schedule(sector, Part::Fat, static_cast<uint32_t>(before + k));
+    }
+    if (fat_count_ > before + per)
+    {
+      uint32_t next = loadLE32(sector_.data() + 4 * per);
+      roles_[next] = DIFSECT;
+      schedule(next, Part::Difat, check.index + 1);
+    }
+    return;
+  }
+  if (check.part != Part::Directory)
+  {
+    return;
+  }
+  for (size_t e = 0; e < sector_size_ / ENTRY_SIZE; ++e)
+  {
+    const uint8_t* entry = sector_.data() + e * ENTRY_SIZE;
+    uint8_t type = entry[66];
+    if (type == ENTRY_UNUSED)
+    {
+      continue;
+    }
+    uint32_t start = loadLE32(entry + 116);
+    uint64_t size = loadLE64(entry + 120);
+    if (version_ == 3)
+    {
+      size &= 0xFFFFFFFF;  // version 3 writers may leave the high half uninitialised
+    }
+    if (type == ENTRY_ROOT)
+    {
+      mini_bound_ = (size + (1u << MINI_SHIFT) - 1) >> MINI_SHIFT;
+      std::vector<uint32_t> mini_fat = mini_fat_count_ != 0 ? chain(first_mini_fat_)
+                                                            : std::vector<uint32_t>();
+      for (size_t i = 0; i < mini_fat.size() && i < mini_fat_count_; ++i)
+      {
+        schedule(mini_fat[i], Part::MiniFat, static_cast<uint32_t>(i));
+      }
+      continue;
+    }
+    names_.push_back(entryName(entry));
+    if (type != ENTRY_STREAM)
+    {
+      continue;
+    }
+    ++streams_;
+    if (size < MINI_CUTOFF || start >= fat_.size())
+    {
+      continue;
+    }
+    for (const KnownStream& known : KNOWN_STREAMS)
+    {
+      if (names_.back() == known.name)
+      {
+        walks_.push_back(Walk{&known, chain(start), size});
+        schedule(start, Part::Stream, static_cast<uint32_t>(walks_.size() - 1));
+      }
+    }
+  }
+}
+
+bool CompoundFile::relocate(uint32_t sector, uint64_t good, uint64_t bad)
+{
+  // Nothing between the last sector that fit and this one is checked, so the
+  // earliest allocation-unit boundary between them is taken.
+  uint64_t block = search_.block;
+  uint64_t file = (good + block - 1) / block * block;
+  if (file >= bad || file <= map_.pieceStart(file))
+  {
+    return false;
+  }
+  ambiguous_ += (bad - 1) / block * block - file;
+  return findPiece(map_, file, search_, device_.size(), [&](bool backward)
+  {
+    return confirm(file, sector, backward);
+  });
+}
+
+/// Sectors past `from` that fit before still fit, and so do the next pending
+/// ones from `sector` on; a record header, with the headers that follow it.
+bool CompoundFile::confirm(uint64_t from, uint32_t sector, bool backward)
+{
+  for (auto it = checks_.lower_bound(static_cast<uint32_t>((from >> shift_) - 1));
+       it != checks_.end(); ++it)
+  {
+    if (it->second.passed && !fits(it->first, it->second, backward))
+    {
+      return false;
+    }
+  }
+  const Check& check = checks_[sector];
+  if (check.part == Part::Stream)
+  {
+    const Walk& walk = walks_[check.index];
+    uint64_t at = check.at;
+    uint64_t next = 0;
+    for (unsigned i = 0; i <= CONFIRM_RECORDS && at < walk.size; ++i, at = next)
+    {
+      if (!recordFits(walk, at, backward, next))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+  unsigned count = std::max(1u, options_.confirm_sectors);
+  for (auto it = pending_.lower_bound(sector); it != pending_.end() && count != 0; ++it, --count)
+  {
+    if (!fits(*it, checks_[*it], backward))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Read the FAT through the map; sectors that could not be placed read as free.
+void CompoundFile::loadFat()
+{
+  size_t per = sector_size_ / 4;
+  fat_.clear();
+  for (uint32_t sector : fat_sectors_)
+  {
+    auto check = checks_.find(sector);
+    if (check == checks_.end() || !check->second.passed || !readSector(sector, false))
+    {
+      fat_.resize(fat_.size() + per, FREESECT);
+      continue;
+    }
+    for (size_t k = 0; k < per; ++k)
+    {
+      fat_.push_back(loadLE32(sector_.data() + 4 * k));
+    }
+  }
+}
+
+bool CompoundFile::assemble(RecoveredFile& file)
+{
+  // 1. FAT and DIFAT sectors, where the header and the DIFAT chain put them.
+  verify();
+  if (std::none_of(checks_.begin(), checks_.end(), [](const std::pair<const uint32_t, Check>& c)
+  {
+    return c.second.passed;
+  }))
+  {
+    return false;
+  }
+  loadFat();
+
+  // 2. The directory, the mini FAT and the first sectors of known streams,
+  // where the FAT puts them.
+  std::vector<uint32_t> directory = chain(first_directory_);
+  for (size_t i = 0; i < directory.size(); ++i)
+  {
+    schedule(directory[i], Part::Directory, static_cast<uint32_t>(i));
+  }
+  verify();
+
+  // 3. Placement: every checkable sector again, in file order, from a single
+  // piece.
+  discovering_ = false;
+  map_ = PieceMap(start_);
+  ambiguous_ = 0;
+  for (auto& entry : checks_)
+  {
+    entry.second.passed = false;
+    pending_.insert(entry.first);
+  }
+  verify();
+
+  // 4. The file ends with the last sector the FAT allocates.
+  auto last = std::find_if(fat_.rbegin(), fat_.rend(), [](uint32_t entry)
+  {
+    return entry != FREESECT;
+  });
+  if (last == fat_.rend())
+  {
+    return false;
+  }
+  uint64_t size = fileOffset(static_cast<uint32_t>(fat_.rend() - last));
+  if (size > options_.max_file_size)
+  {
+    return false;
+  }
+
+  const char* type = "document/ole2";
+  std::string label = "compound file";
+  for (const std::string& name : names_)
+  {
+    for (const KnownStream& known : KNOWN_STREAMS)
+    {
+      if (name == known.name)
+      {
+        type = known.type;
+        label = known.label;
+      }
+    }
+    if (name.compare(0, 12, "__substg1.0_") == 0 || name == "__properties_version1.0")
+    {
+      type = "email/msg";
+      label = "Outlook message";
+    }
+    else if (name == "Catalog" && std::strcmp(type, "document/ole2") == 0)
+    {
+      type = "image/thumbs_db";
+      label = "Thumbs.db cache";
+    }
+  }
+
+  file.type = type;
+  file.offset = start_;
+  file.size = size;
+  file.extents = map_.extents(size);
+  file.description = label + ", " + std::to_string(streams_) + " streams, " +
+                     std::to_string(sector_size_) + "-byte sectors";
+  if (!file.extents.empty())
+  {
+    file.description += ", " + std::to_string(file.extents.size()) + " pieces";
+  }
+  if (unresolved_ != UINT64_MAX)
+  {
+    file.confidence = CONFIDENCE_UNRESOLVED;
+    file.description += ", unverified from byte " + std::to_string(unresolved_);
+  }
+  else if (ambiguous_ != 0)
+  {
+    file.confidence = CONFIDENCE_AMBIGUOUS;
+    file.description += ", " + std::to_string(ambiguous_) + " bytes placed unchecked";
+  }
+  else
+  {
+    file.confidence = map_.count() > 1 ? CONFIDENCE_REASSEMBLED : CONFIDENCE_VERIFIED;
+  }
+  return true;
+}
+
+}  // namespace
+
+void CfbCarveStage::registerPatterns(PatternSet& patterns)
+{
+  patterns.add(SIGNATURE, sizeof(SIGNATURE), TAG_HEADER);
+}
+
+bool CfbCarveStage::onHit(uint32_t /*tag*/, size_t pos, const ChunkView& chunk,
+                           CarveContext& ctx)
+{
+  uint64_t offset = chunk.offset + pos;
+  Device& device = ctx.device();
+  if (offset % device.sectorSize() != 0 || offset >= device.size())
+  {
+    return false;
+  }
+  candidates_.fetch_add(1, std::memory_order_relaxed);
+  auto header = ctx.readAt(offset, HEADER_SIZE);
+  CompoundFile cfb(device, offset, options_);
+  RecoveredFile file;
+  if (header.size() != HEADER_SIZE || !cfb.readHeader(header.data()) || !cfb.assemble(file))
+  {
+    return false;
+  }
+  file.source = name();
+  if (!file.extents.empty())
+  {
+    fragmented_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (file.confidence == CONFIDENCE_UNRESOLVED)
+  {
+    unresolved_.fetch_add(1, std::memory_order_relaxed);
+  }
+  ctx.registry().add(std::move(file));
+  confirmed_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,65 @@
+// RecoverySoftNetz — OLE2 compound file (CFB) carve stage
+//
+// DOC, XLS, PPT, MSG, VSD and Thumbs.db files are compound files: a small
+// file system of 512-byte (version 3) or 4096-byte (version 4) sectors with
+// its own allocation table (FAT) and no footer. The stage matches the header
+// signature and sizes each candidate from the FAT, whose sectors the header
+// and the DIFAT chain locate: the file ends with the last sector the FAT
+// allocates.
+//
+// FAT, DIFAT, directory and mini FAT sectors have structure that can be
+// checked, and so do the first sectors of Word, Excel, PowerPoint and Visio
+// streams; Excel and PowerPoint streams are chains of length-prefixed records
+// whose headers are walked too. These sectors are checked in file order where
+// the piece map puts them; one that does not check out means the file was
+// fragmented, and the piece holding it is looked for at allocation-unit
+// granularity (piece_map), accepted where it and what follows it fit. Where
+// a break falls between two checked sectors is not known; the bytes that
+// leaves unplaced are reported, and the entry's confidence lowered.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace rsn
+{
+
+struct CfbCarveOptions
+{
+  uint64_t max_file_size = 4ull << 30;
+  uint32_t block_size = 0;                 // fragment granularity; 0 = device sector size
+  uint64_t search_distance = 64ull << 20;  // how far a missing piece is looked for, each way
+  unsigned confirm_sectors = 2;            // checked sectors that must fit at a new piece
+};
+
+class CfbCarveStage : public CarveStage
+{
+public:
+  explicit CfbCarveStage(CfbCarveOptions options = CfbCarveOptions()) : options_(options) {}
+
+  const char* name() const override { return "cfb"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+
+  uint64_t candidates() const { return candidates_.load(); }
+  uint64_t confirmed() const { return confirmed_.load(); }
+  uint64_t fragmented() const { return fragmented_.load(); }  // assembled from several pieces
+  uint64_t unresolved() const { return unresolved_.load(); }  // registered with a piece missing
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_HEADER,
+  };
+
+  CfbCarveOptions options_;
+  std::atomic<uint64_t> candidates_{0};
+  std::atomic<uint64_t> confirmed_{0};
+  std::atomic<uint64_t> fragmented_{0};
+  std::atomic<uint64_t> unresolved_{0};
+};
+
+}  // namespace rsn
@@ -0,0 +1,975 @@
+// RecoverySoftNetz — page-structured database (Jet/ACE, ESE, InnoDB) carve stage
+
+#include "carving/database_carver.h"
+
+#include "carving/piece_map.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rsn
+{
+
+namespace
+{
+
+enum Format : uint8_t
+{
+  FORMAT_JET,
+  FORMAT_ESE,
+  FORMAT_ESE_HEADER,  // index key of ESE headers and their shadow copies
+  FORMAT_INNODB,
+};
+
+constexpr uint32_t JET_SIZES[] = {2048, 4096};
+constexpr uint32_t ESE_SIZES[] = {4096, 8192, 16384, 32768};
+constexpr uint32_t INNODB_SIZES[] = {4096, 8192, 16384, 32768, 65536};
+constexpr uint32_t MAX_PAGE_NUMBER = 1u << 28;  // larger page references are not believed
+
+constexpr double CONFIDENCE_VERIFIED = 0.95;     // every page found where it should be
+constexpr double CONFIDENCE_REASSEMBLED = 0.85;  // ... once the pieces were found
+constexpr double CONFIDENCE_DAMAGED = 0.6;       // pages placed whose checks fail
+constexpr double CONFIDENCE_UNRESOLVED = 0.4;    // a page was not found
+
+// Jet (MDB) and ACE (ACCDB): page 0 is the header, page 2 the definition of
+// the system catalog. Pages of version 3 files are 2K, later ones 4K.
+constexpr uint8_t JET_MAGIC[] = {0x00, 0x01, 0x00, 0x00};
+constexpr char JET_NAME[] = "Standard Jet DB";
+constexpr char ACE_NAME[] = "Standard ACE DB";
+constexpr size_t JET_VERSION = 0x14;
+constexpr uint32_t JET_CATALOG = 2;
+
+enum JetType : uint8_t
+{
+  JET_DATA = 1,
+  JET_TDEF = 2,  // table definition
+  JET_INDEX_NODE = 3,
+  JET_INDEX_LEAF = 4,
+  JET_USAGE = 5,  // page usage bitmap
+};
+
+// ESE: the header and its shadow copy take the first two pages, so database
+// page N is file page N + 1.
+constexpr uint32_t ESE_SIGNATURE = 0x89ABCDEF;
+constexpr uint32_t ESE_FORMAT_VERSION = 0x620;
+constexpr size_t ESE_DB_TIME = 16;
+constexpr size_t ESE_DB_SIGNATURE = 24;  // random value, creation time, computer name
+constexpr size_t ESE_DB_SIGNATURE_SIZE = 28;
+constexpr size_t ESE_STATE = 52;
+constexpr size_t ESE_PAGE_SIZE = 236;
+constexpr uint32_t ESE_DIRTY_SHUTDOWN = 2;
+constexpr uint32_t ESE_CLEAN_SHUTDOWN = 3;
+constexpr uint32_t ESE_LAST_STATE = 6;
+constexpr uint32_t ESE_SYSTEM_PAGES = 4;  // database root, its space trees, the catalog
+constexpr uint32_t ESE_LARGE_PAGE = 16384;  // from here the page number is stored
+constexpr size_t ESE_PAGE_TIME = 8;
+constexpr size_t ESE_PREV = 16;
+constexpr size_t ESE_NEXT = 20;
+constexpr size_t ESE_OBJECT = 24;  // father data page (FDP) object id
+constexpr size_t ESE_FREE = 28;
+constexpr size_t ESE_UNCOMMITTED = 30;
+constexpr size_t ESE_FIRST_FREE = 32;
+constexpr size_t ESE_TAGS = 34;
+constexpr size_t ESE_FLAGS = 36;
+constexpr size_t ESE_LARGE_NUMBER = 64;
+constexpr uint32_t ESE_TREE_FLAGS = 0x0E;  // leaf, parent, empty
+
+// InnoDB: a FIL header and trailer around every page; page 0 (FSP_HDR) of a
+// tablespace holds its size.
+constexpr size_t FIL_PAGE_OFFSET = 4;
+constexpr size_t FIL_PAGE_LSN = 16;
+constexpr size_t FIL_PAGE_TYPE = 24;
+constexpr size_t FIL_PAGE_FILE_FLUSH_LSN = 26;
+constexpr size_t FIL_PAGE_SPACE_ID = 34;
+constexpr size_t FIL_PAGE_DATA = 38;
+constexpr size_t FIL_TRAILER = 8;
+constexpr size_t FSP_SPACE_ID = FIL_PAGE_DATA;
+constexpr size_t FSP_SIZE = FIL_PAGE_DATA + 8;
+constexpr size_t PAGE_INDEX_ID = FIL_PAGE_DATA + 28;
+constexpr uint16_t FIL_PAGE_TYPE_FSP_HDR = 8;
+constexpr uint16_t FIL_PAGE_TYPE_LAST = 29;  // highest of the small type numbers
+constexpr uint16_t FIL_PAGE_SDI = 17853;
+constexpr uint16_t FIL_PAGE_INDEX = 17855;
+constexpr uint32_t BUF_NO_CHECKSUM_MAGIC = 0xDEADBEEF;
+
+uint64_t spaceKey(Format format, uint32_t page_size, uint32_t space)
+{
+  return (static_cast<uint64_t>(format) << 56) | (static_cast<uint64_t>(page_size) << 32) | space;
+}
+
+bool allZero(const uint8_t* data, size_t size)
+{
+  return data[0] == 0 && std::memcmp(data, data + 1, size - 1) == 0;
+}
+
+std::string plural(uint64_t n, const char* one, const char* many)
+{
+  return std::to_string(n) + (n == 1 ? one : many);
+}
+
+/// Jet page type and the pages it refers to: a data page's table definition;
+/// a table definition's continuation; an index page's table definition and
+/// previous and next pages at its level.
+struct JetLinks
+{
+  uint8_t type = 0;
+  uint32_t ref[3] = {};
+};
+
+/// Recognize a Jet page by its type and the fields that have to be in range.
+bool jetPage(const uint8_t* page, uint32_t size, JetLinks& out)
+{
+  if (page[1] != 0x01 || page[0] < JET_DATA || page[0] > JET_USAGE)
+  {
+    return false;
+  }
+  out = JetLinks();
+  out.type = page[0];
+  uint16_t free = loadLE16(page + 2);
+  switch (page[0])
+  {
+  case JET_DATA:
+  {
+    size_t rows_at = size == 2048 ? 8 : 12;
+    out.ref[0] = loadLE32(page + 4);
+    if (free > size || out.ref[0] == 0 || rows_at + 2 + 2u * loadLE16(page + rows_at) > size)
+    {
+      return false;
+    }
+    break;
+  }
+  case JET_TDEF:
+    out.ref[0] = loadLE32(page + 4);
+    if (page[2] != 'V' || page[3] != 'C')
+    {
+      return false;
+    }
+    break;
+  case JET_INDEX_NODE:
+  case JET_INDEX_LEAF:
+    out.ref[0] = loadLE32(page + 4);
+    out.ref[1] = loadLE32(page + 8);
+    out.ref[2] = loadLE32(page + 12);
+    if (free > size || out.ref[0] == 0)
+    {
+      return false;
+    }
+    break;
+  default:
+    if (free > size)
+    {
+      return false;
+    }
+    break;
+  }
+  return out.ref[0] < MAX_PAGE_NUMBER && out.ref[1] < MAX_PAGE_NUMBER &&
+         out.ref[2] < MAX_PAGE_NUMBER;
+}
+
+bool jetHeader(const uint8_t* page)
+{
+  return std::memcmp(page, JET_MAGIC, sizeof(JET_MAGIC)) == 0 &&
+         (std::memcmp(page + 4, JET_NAME, sizeof(JET_NAME)) == 0 ||
+          std::memcmp(page + 4, ACE_NAME, sizeof(ACE_NAME)) == 0);
+}
+
+bool eseHeader(const uint8_t* page, uint32_t& page_size)
+{
+  if (loadLE32(page + 4) != ESE_SIGNATURE || loadLE32(page + 8) != ESE_FORMAT_VERSION ||
+      loadLE32(page + 12) != 0)
+  {
+    return false;
+  }
+  uint32_t state = loadLE32(page + ESE_STATE);
+  page_size = loadLE32(page + ESE_PAGE_SIZE);
+  if (page_size == 0)
+  {
+    page_size = 4096;  // before the header recorded it
+  }
+  return state != 0 && state <= ESE_LAST_STATE &&
+         std::find(std::begin(ESE_SIZES), std::end(ESE_SIZES), page_size) != std::end(ESE_SIZES);
+}
+
+/// Header fields of an ESE page that have to agree with each other and the
+/// page size.
+bool eseStructure(const uint8_t* page, uint32_t size)
+{
+  uint32_t body = size - (size >= ESE_LARGE_PAGE ? 80 : 40);
+  uint32_t free = loadLE16(page + ESE_FREE);
+  uint32_t tags = 4u * loadLE16(page + ESE_TAGS);
+  uint32_t flags = loadLE32(page + ESE_FLAGS);
+  return (flags & ESE_TREE_FLAGS) != 0 && flags < 0x100000 &&
+         loadLE16(page + ESE_UNCOMMITTED) <= free && free + tags <= body &&
+         loadLE16(page + ESE_FIRST_FREE) + tags <= body &&
+         loadLE32(page + ESE_PREV) < MAX_PAGE_NUMBER && loadLE32(page + ESE_NEXT) < MAX_PAGE_NUMBER;
+}
+
+/// Page number an ESE page names. Large pages store it. Smaller ones have an
+/// XOR checksum over the page from offset 8 seeded with 0x89ABCDEF and the
+/// page number, which the number is recovered from; in the oldest format the
+/// number is stored at offset 4, which the checksum then covers too.
+uint32_t eseNumber(const uint8_t* page, uint32_t size)
+{
+  if (size >= ESE_LARGE_PAGE)
+  {
+    return loadLE32(page + ESE_LARGE_NUMBER);
+  }
+  uint32_t rest = 0;
+  for (uint32_t i = 8; i < size; i += 4)
+  {
+    rest ^= loadLE32(page + i);
+  }
+  uint32_t seed = loadLE32(page) ^ rest;
+  if ((seed ^ loadLE32(page + 4)) == ESE_SIGNATURE)
+  {
+    return loadLE32(page + 4);
+  }
+  return seed ^ ESE_SIGNATURE;
+}
+
+/// InnoDB's checksum before CRC-32C: a byte-wise hash fold.
+uint32_t innodbFold(const uint8_t* data, size_t size)
+{
+  uint32_t fold = 0;
+  for (size_t i = 0; i < size; ++i)
+  {
+    fold = ((((fold ^ data[i] ^ 1653893711u) << 8) + fold) ^ 1463735687u) + data[i];
+  }
+  return fold;
+}
+
+struct InnodbPage
+{
+  uint32_t number = 0;
+  uint32_t space = 0;
+  uint16_t type = 0;
+  bool valid = false;  // the checksum fits
+};
+
+/// Recognize an InnoDB page of `size` bytes by its LSN, which the header and
+/// trailer both hold: in the last four bytes (MySQL, MariaDB before 10.5), or
+/// in the four before them with a CRC-32C of the page last (MariaDB's
+/// full_crc32). The checksum may be CRC-32C, the fold, or none at all.
+bool innodbPage(const uint8_t* page, size_t size, InnodbPage& out)
+{
+  uint32_t lsn = loadBE32(page + FIL_PAGE_LSN + 4);
+  uint16_t type = loadBE16(page + FIL_PAGE_TYPE);
+  if ((lsn == 0 && loadBE32(page + FIL_PAGE_LSN) == 0) ||
+      (type > FIL_PAGE_TYPE_LAST && (type < FIL_PAGE_SDI || type > FIL_PAGE_INDEX)))
+  {
+    return false;
+  }
+  const uint8_t* trailer = page + size - FIL_TRAILER;
+  if (loadBE32(trailer + 4) == lsn)
+  {
+    const uint8_t* head = page + FIL_PAGE_OFFSET;
+    size_t head_size = FIL_PAGE_FILE_FLUSH_LSN - FIL_PAGE_OFFSET;
+    const uint8_t* body = page + FIL_PAGE_DATA;
+    size_t body_size = size - FIL_PAGE_DATA - FIL_TRAILER;
+    uint32_t stored = loadBE32(page);
+    out.valid = stored == BUF_NO_CHECKSUM_MAGIC ||
+                stored == (crc32c(head, head_size) ^ crc32c(body, body_size)) ||
+                stored == innodbFold(head, head_size) + innodbFold(body, body_size);
+  }
+  else if (loadBE32(trailer) == lsn)
+  {
+    out.valid = loadBE32(trailer + 4) == crc32c(page, size - 4);
+  }
+  else
+  {
+    return false;
+  }
+  out.number = loadBE32(page + FIL_PAGE_OFFSET);
+  out.space = loadBE32(page + FIL_PAGE_SPACE_ID);
+  out.type = type;
+  return true;
+}
+
+/// What a device position holds, for the page a database expects there.
+enum class Fit : uint8_t
+{
+  Page,     // the page expected
+  Damaged,  // the page expected, by its number, with a checksum that fails
+  Foreign,  // a page of the format, but not the one expected
+  Empty,    // all zero: allocated, never written
+  None,
+};
+
+enum State : uint8_t
+{
+  STATE_PAGE,
+  STATE_DAMAGED,
+  STATE_EMPTY,
+  STATE_MISSING,  // placed where the pages around it predict, unchecked
+};
+
+/// One entry of a database's page table.
+struct Slot
+{
+  uint64_t device = 0;
+  State state = STATE_PAGE;
+  JetLinks links;
+};
+
+/// Device page -> the database (by header offset) holding it.
+using Owners = std::unordered_map<uint64_t, uint64_t>;
+
+/// Assembles one database from its header, page by page.
+class Assembler
+{
+public:
+  Assembler(Device& device, const PageIndex& index, const Owners& owners,
+            const DatabaseCarveOptions& options, uint64_t start, Format format,
+            uint32_t page_size)
+    : device_(device), window_(device), index_(index), owners_(owners), options_(options),
+      start_(start), format_(format), page_size_(page_size), map_(start),
+      page_(page_size), scratch_(page_size)
+  {
+  }
+
+  /// Device pages that hold this database's pages in place, from the header
+  /// up to the first that does not.
+  std::vector<uint64_t> reserve();
+
+  bool assemble(RecoveredFile& file);
+
+  /// Record the device pages this database holds as its own.
+  void claim(Owners& owners) const;
+
+  uint64_t relocated() const { return relocated_; }
+  uint64_t count(State state) const;
+
+private:
+  bool readHeader();
+  bool ownedElsewhere(uint64_t device) const
+  {
+    auto owner = owners_.find(device);
+    return owner != owners_.end() && owner->second != start_;
+  }
+  Fit check(uint32_t number, uint64_t device, bool& witness);
+  bool linksFit(uint32_t number, const JetLinks& links, bool& witness) const;
+  bool indexKey(uint32_t number, uint64_t& space, uint32_t& indexed) const;
+  bool relocate(uint32_t number, uint64_t predicted, uint64_t& found);
+  bool continues(uint32_t number, uint64_t predicted);
+  void take(uint32_t number, uint64_t device, State state);
+  void describe(RecoveredFile& file) const;
+
+  Device& device_;
+  DeviceWindow window_;
+  const PageIndex& index_;
+  const Owners& owners_;
+  const DatabaseCarveOptions& options_;
+  uint64_t start_;
+  Format format_;
+  uint32_t page_size_;
+  PieceMap map_;
+  std::vector<uint8_t> header_;
+  std::vector<uint8_t> page_;     // the page `check` read last
+  std::vector<uint8_t> scratch_;  // pages read to confirm a relocation
+  std::vector<Slot> slots_;       // the page table, by file page number
+  std::unordered_set<uint64_t> used_;
+  std::set<uint64_t> objects_;  // InnoDB index ids, ESE object ids
+  uint32_t space_ = 0;          // InnoDB tablespace id
+  uint32_t known_pages_ = 0;    // InnoDB tablespace size
+  uint32_t referenced_ = 0;     // highest file page referenced so far
+  uint64_t max_time_ = UINT64_MAX;  // ESE: no page of a cleanly shut down database is newer
+  uint64_t relocated_ = 0;
+};
+
+bool Assembler::readHeader()
+{
+  header_.resize(page_size_);
+  if (!window_.get(start_, header_.data(), page_size_))
+  {
+    return false;
+  }
+  switch (format_)
+  {
+  case FORMAT_JET:
+    referenced_ = JET_CATALOG;
+    return true;
+  case FORMAT_ESE:
+    referenced_ = ESE_SYSTEM_PAGES + 1;
+    if (loadLE32(header_.data() + ESE_STATE) == ESE_CLEAN_SHUTDOWN)
+    {
+      max_time_ = loadLE64(header_.data() + ESE_DB_TIME);
+    }
+    return true;
+  case FORMAT_INNODB:
+  {
+    InnodbPage info;
+    if (!innodbPage(header_.data(), page_size_, info) ||
+        loadBE32(header_.data() + FSP_SPACE_ID) != info.space)
+    {
+      return false;
+    }
+    space_ = info.space;
+    known_pages_ = loadBE32(header_.data() + FSP_SIZE);
+    return known_pages_ != 0 && known_pages_ <= options_.max_file_size / page_size_;
+  }
+  default:
+    return false;
+  }
+}
+
+/// Check `links` against the pages already placed: a data page's table
+/// definition must be one, and an index page's neighbours must point back at
+/// it. A reference that checks out is a witness that the page belongs here.
+bool Assembler::linksFit(uint32_t number, const JetLinks& links, bool& witness) const
+{
+  auto placed = [&](uint32_t ref) -> const Slot*
+  {
+    return ref < slots_.size() && slots_[ref].state == STATE_PAGE ? &slots_[ref] : nullptr;
+  };
+  auto definition = [&](uint32_t ref, bool required)
+  {
+    const Slot* slot = placed(ref);
+    if (ref == number || (slot != nullptr && slot->links.type != JET_TDEF && required))
+    {
+      return false;
+    }
+    // Every database defines its catalog at the same page, so a reference to
+    // it says nothing about which database a page belongs to.
+    witness = witness || (slot != nullptr && slot->links.type == JET_TDEF && ref != JET_CATALOG);
+    return true;
+  };
+  auto neighbour = [&](uint32_t ref, int back)
+  {
+    const Slot* slot = placed(ref);
+    if (ref == number ||
+        (slot != nullptr && (slot->links.type != links.type || slot->links.ref[back] != number)))
+    {
+      return false;
+    }
+    witness = witness || slot != nullptr;
+    return true;
+  };
+  switch (links.type)
+  {
+  case JET_DATA:
+    return definition(links.ref[0], true);
+  case JET_TDEF:
+    return links.ref[0] == 0 || definition(links.ref[0], true);
+  case JET_INDEX_NODE:
+  case JET_INDEX_LEAF:
+    return definition(links.ref[0], false) && (links.ref[1] == 0 || neighbour(links.ref[1], 2)) &&
+           (links.ref[2] == 0 || neighbour(links.ref[2], 1));
+  default:
+    return true;
+  }
+}
+
+Fit Assembler::check(uint32_t number, uint64_t device, bool& witness)
+{
+  if (device > device_.size() || device_.size() - device < page_size_ ||
+      used_.count(device) != 0 || ownedElsewhere(device) ||
+      !window_.get(device, page_.data(), page_size_))
+  {
+    return Fit::None;
+  }
+  const uint8_t* page = page_.data();
+  if (allZero(page, page_size_))
+  {
+    return Fit::Empty;
+  }
+  switch (format_)
+  {
+  case FORMAT_JET:
+  {
+    JetLinks links;
+    if (!jetPage(page, page_size_, links))
+    {
+      return Fit::None;
+    }
+    return linksFit(number, links, witness) ? Fit::Page : Fit::Foreign;
+  }
+  case FORMAT_ESE:
+  {
+    uint32_t page_size = 0;
+    if (number == 1)
+    {
+      return eseHeader(page, page_size) && page_size == page_size_ &&
+                     std::memcmp(page + ESE_DB_SIGNATURE, header_.data() + ESE_DB_SIGNATURE,
+                                 ESE_DB_SIGNATURE_SIZE) == 0
+               ? Fit::Page
+               : Fit::None;
+    }
+    if (!eseStructure(page, page_size_))
+    {
+      return Fit::None;
+    }
+    return eseNumber(page, page_size_) == number - 1 && loadLE64(page + ESE_PAGE_TIME) <= max_time_
+             ? Fit::Page
+             : Fit::Foreign;
+  }
+  case FORMAT_INNODB:
+  {
+    InnodbPage info;
+    if (!innodbPage(page, page_size_, info))
+    {
+      return Fit::None;
+    }
+    if (info.number != number || info.space != space_)
+    {
+      return Fit::Foreign;
+    }
+    return info.valid ? Fit::Page : Fit::Damaged;
+  }
+  default:
+    return Fit::None;
+  }
+}
+
+/// Where the index keeps page `number`; false for formats without numbers.
+bool Assembler::indexKey(uint32_t number, uint64_t& space, uint32_t& indexed) const
+{
+  switch (format_)
+  {
+  case FORMAT_ESE:
+    if (number == 1)
+    {
+      space = spaceKey(FORMAT_ESE_HEADER, page_size_, loadLE32(header_.data() + ESE_DB_SIGNATURE));
+      indexed = 0;
+    }
+    else
+    {
+      space = spaceKey(FORMAT_ESE, page_size_, 0);
+      indexed = number - 1;
+    }
+    return true;
+  case FORMAT_INNODB:
+    space = spaceKey(FORMAT_INNODB, page_size_, space_);
+    indexed = number;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Find page `number` through the index. Numbered pages are taken nearest
+/// first; a Jet page also needs a witness among its references, and the pages
+/// after it must look like Jet pages too.
+bool Assembler::relocate(uint32_t number, uint64_t predicted, uint64_t& found)
+{
+  uint64_t space = spaceKey(FORMAT_JET, page_size_, 0);
+  uint32_t indexed = 0;
+  bool numbered = indexKey(number, space, indexed);
+  size_t limit = numbered ? 16 : options_.max_candidates;
+  for (uint64_t device : index_.find(space, indexed, predicted, options_.search_distance, limit))
+  {
+    bool witness = false;
+    if (device == predicted || check(number, device, witness) != Fit::Page ||
+        (!numbered && !witness))
+    {
+      continue;
+    }
+    bool confirmed = true;
+    for (unsigned k = 1; !numbered && k < options_.confirm_pages && confirmed; ++k)
+    {
+      uint64_t next = device + uint64_t(k) * page_size_;
+      JetLinks links;
+      confirmed = device_.size() - next < page_size_ ||
+                  (window_.get(next, scratch_.data(), page_size_) &&
+                   (allZero(scratch_.data(), page_size_) ||
+                    jetPage(scratch_.data(), page_size_, links)));
+    }
+    if (confirmed)
+    {
+      found = device;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Whether the database goes on past a page that was not found: its size is
+/// known, a page already placed refers past it, or a page follows within
+/// `max_gap` where contiguity predicts it.
+bool Assembler::continues(uint32_t number, uint64_t predicted)
+{
+  if (known_pages_ != 0 || number <= referenced_)
+  {
+    return true;
+  }
+  for (uint32_t k = 1; k <= options_.max_gap; ++k)
+  {
+    uint64_t near = predicted + uint64_t(k) * page_size_;
+    bool witness = false;
+    if (check(number + k, near, witness) == Fit::Page)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Add page `number` to the page table; a page that was checked last by
+/// `check` contributes its references and object id.
+void Assembler::take(uint32_t number, uint64_t device, State state)
+{
+  Slot slot;
+  slot.device = device;
+  slot.state = state;
+  if (state == STATE_PAGE)
+  {
+    const uint8_t* page = page_.data();
+    switch (format_)
+    {
+    case FORMAT_JET:
+      jetPage(page, page_size_, slot.links);
+      referenced_ = std::max({referenced_, slot.links.ref[0], slot.links.ref[1],
+                              slot.links.ref[2]});
+      break;
+    case FORMAT_ESE:
+      if (number > 1)
+      {
+        // Neighbours are database page numbers, one less than file pages.
+        referenced_ = std::max({referenced_, loadLE32(page + ESE_PREV) + 1,
+                                loadLE32(page + ESE_NEXT) + 1});
+        objects_.insert(loadLE32(page + ESE_OBJECT));
+      }
+      break;
+    case FORMAT_INNODB:
+      if (loadBE16(page + FIL_PAGE_TYPE) == FIL_PAGE_INDEX)
+      {
+        objects_.insert(loadBE64(page + PAGE_INDEX_ID));
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  if (state != STATE_MISSING)
+  {
+    used_.insert(device);
+  }
+  slots_.push_back(slot);
+}
+
+bool Assembler::assemble(RecoveredFile& file)
+{
+  if (!readHeader())
+  {
+    return false;
+  }
+  page_ = header_;
+  take(0, start_, STATE_PAGE);
+  uint64_t limit = std::min<uint64_t>(options_.max_file_size / page_size_, MAX_PAGE_NUMBER);
+  if (known_pages_ != 0)
+  {
+    limit = known_pages_;
+  }
+  for (uint32_t number = 1; number < limit; ++number)
+  {
+    uint64_t file_offset = uint64_t(number) * page_size_;
+    uint64_t predicted = map_.device(file_offset);
+    bool witness = false;
+    Fit fit = check(number, predicted, witness);
+    if (fit == Fit::Page || fit == Fit::Damaged)
+    {
+      take(number, predicted, fit == Fit::Page ? STATE_PAGE : STATE_DAMAGED);
+      continue;
+    }
+    // ESE pages do not say which database they belong to, so past the pages
+    // referenced so far the index is not asked for them: the next database's
+    // page with that number would be taken. Jet pages are placed by their
+    // references instead, but a zero page where one was expected is not
+    // looked for elsewhere: the page after it would be taken in its place.
+    bool expected = known_pages_ != 0 || number <= referenced_;
+    uint64_t found = 0;
+    if ((format_ == FORMAT_JET ? fit != Fit::Empty : expected) &&
+        relocate(number, predicted, found))
+    {
+      map_.add(file_offset, found);
+      ++relocated_;
+      take(number, found, STATE_PAGE);
+      continue;
+    }
+    if (predicted > device_.size() || device_.size() - predicted < page_size_ ||
+        !continues(number, predicted))
+    {
+      break;
+    }
+    // Only a checksum names a small ESE page, so one in place that fails it
+    // is taken as damaged rather than foreign.
+    State state = fit == Fit::Empty ? STATE_EMPTY : STATE_MISSING;
+    if (fit == Fit::Foreign && format_ == FORMAT_ESE && page_size_ < ESE_LARGE_PAGE)
+    {
+      state = STATE_DAMAGED;
+    }
+    take(number, predicted, state);
+  }
+  while (slots_.back().state == STATE_EMPTY)
+  {
+    slots_.pop_back();
+  }
+  describe(file);
+  return true;
+}
+
+uint64_t Assembler::count(State state) const
+{
+  return static_cast<uint64_t>(std::count_if(slots_.begin(), slots_.end(), [&](const Slot& slot)
+  {
+    return slot.state == state;
+  }));
+}
+
+void Assembler::describe(RecoveredFile& file) const
+{
+  uint64_t pages = slots_.size();
+  file.offset = start_;
+  file.size = pages * page_size_;
+  file.extents = map_.extents(file.size);
+  std::string label;
+  std::string objects;
+  switch (format_)
+  {
+  case FORMAT_JET:
+  {
+    bool ace = std::memcmp(header_.data() + 4, ACE_NAME, sizeof(ACE_NAME)) == 0;
+    file.type = ace ? "database/accdb" : "database/mdb";
+    label = ace ? "ACE database" : header_[JET_VERSION] == 0 ? "Jet 3 database" : "Jet 4 database";
+    // Table definitions that do not continue another one start a table.
+    std::set<uint32_t> continuations;
+    uint64_t definitions = 0;
+    for (const Slot& slot : slots_)
+    {
+      if (slot.state == STATE_PAGE && slot.links.type == JET_TDEF)
+      {
+        ++definitions;
+        if (slot.links.ref[0] != 0)
+        {
+          continuations.insert(slot.links.ref[0]);
+        }
+      }
+    }
+    objects = plural(definitions - std::min<uint64_t>(definitions, continuations.size()),
+                     " table", " tables");
+    break;
+  }
+  case FORMAT_ESE:
+    file.type = "database/edb";
+    label = "ESE database";
+    objects = plural(objects_.size(), " object", " objects");
+    break;
+  default:
+    file.type = space_ == 0 ? "database/ibdata" : "database/ibd";
+    label = "InnoDB tablespace " + std::to_string(space_);
+    objects = plural(objects_.size(), " index", " indexes");
+    break;
+  }
+  file.description = label + ", " + plural(pages, " page", " pages") + " of " +
+                     std::to_string(page_size_ >> 10) + "K, " + objects;
+  if (format_ == FORMAT_ESE && loadLE32(header_.data() + ESE_STATE) == ESE_DIRTY_SHUTDOWN)
+  {
+    file.description += ", dirty shutdown";
+  }
+  if (!file.extents.empty())
+  {
+    file.description += ", " + std::to_string(file.extents.size()) + " pieces";
+  }
+  uint64_t missing = count(STATE_MISSING);
+  uint64_t damaged = count(STATE_DAMAGED);
+  if (missing != 0)
+  {
+    file.confidence = CONFIDENCE_UNRESOLVED;
+    file.description += ", " + plural(missing, " page", " pages") + " not found";
+  }
+  else if (damaged != 0)
+  {
+    file.confidence = CONFIDENCE_DAMAGED;
+    file.description += ", " + plural(damaged, " page", " pages") + " damaged";
+  }
+  else
+  {
+    file.confidence = map_.count() > 1 ? CONFIDENCE_REASSEMBLED : CONFIDENCE_VERIFIED;
+  }
+}
+
+std::vector<uint64_t> Assembler::reserve()
+{
+  std::vector<uint64_t> out;
+  if (!readHeader())
+  {
+    return out;
+  }
+  out.push_back(start_);
+  uint64_t limit = known_pages_ != 0 ? known_pages_ : options_.max_file_size / page_size_;
+  for (uint32_t number = 1; number < limit; ++number)
+  {
+    uint64_t device = start_ + uint64_t(number) * page_size_;
+    bool witness = false;
+    Fit fit = check(number, device, witness);
+    if (fit != Fit::Page && fit != Fit::Damaged)
+    {
+      break;
+    }
+    out.push_back(device);
+  }
+  return out;
+}
+
+void Assembler::claim(Owners& owners) const
+{
+  for (const Slot& slot : slots_)
+  {
+    if (slot.state != STATE_MISSING)
+    {
+      owners[slot.device] = start_;
+    }
+  }
+}
+
+}  // namespace
+
+void DatabaseCarveStage::registerPatterns(PatternSet& /*patterns*/)
+{
+  // A new run: onChunk counts into the stats as pages are indexed.
+  stats_ = DatabaseCarveStats();
+}
+
+void DatabaseCarveStage::onChunk(const ChunkView& chunk, CarveContext& ctx)
+{
+  uint64_t sector = ctx.device().sectorSize();
+  PageIndex found;
+  std::vector<Header> headers;
+  for (size_t pos = static_cast<size_t>((sector - chunk.offset % sector) % sector);
+       pos < chunk.body; pos += sector)
+  {
+    const uint8_t* page = chunk.data + pos;
+    size_t available = chunk.size - pos;
+    uint64_t device = chunk.offset + pos;
+    if (available < JET_SIZES[0])
+    {
+      break;
+    }
+    JetLinks links;
+    if (jetHeader(page))
+    {
+      uint32_t size = page[JET_VERSION] == 0 ? 2048 : 4096;
+      headers.push_back({device, FORMAT_JET, size});
+    }
+    else
+    {
+      for (uint32_t size : JET_SIZES)
+      {
+        if (size <= available && jetPage(page, size, links))
+        {
+          found.add(spaceKey(FORMAT_JET, size, 0), 0, device);
+        }
+      }
+    }
+
+    uint32_t page_size = 0;
+    if (eseHeader(page, page_size))
+    {
+      headers.push_back({device, FORMAT_ESE, page_size});
+      found.add(spaceKey(FORMAT_ESE_HEADER, page_size, loadLE32(page + ESE_DB_SIGNATURE)), 0,
+                device);
+    }
+    else
+    {
+      for (uint32_t size : ESE_SIZES)
+      {
+        uint32_t number = 0;
+        if (size <= available && eseStructure(page, size) &&
+            (number = eseNumber(page, size)) != 0 && number < MAX_PAGE_NUMBER)
+        {
+          found.add(spaceKey(FORMAT_ESE, size, 0), number, device);
+        }
+      }
+    }
+
+    InnodbPage info;
+    for (uint32_t size : INNODB_SIZES)
+    {
+      if (size <= available && innodbPage(page, size, info) && info.valid)
+      {
+        found.add(spaceKey(FORMAT_INNODB, size, info.space), info.number, device);
+        if (info.number == 0 && info.type == FIL_PAGE_TYPE_FSP_HDR)
+        {
+          headers.push_back({device, FORMAT_INNODB, size});
+        }
+      }
+    }
+  }
+  if (found.size() == 0 && headers.empty())
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t recorded = found.size();
+  size_t dropped = pages_.merge(found, options_.max_pages);
+  stats_.indexed += recorded - dropped;
+  stats_.dropped += dropped;
+  headers_.insert(headers_.end(), headers.begin(), headers.end());
+}
+
+void DatabaseCarveStage::finish(CarveContext& ctx)
+{
+  pages_.seal();
+  std::sort(headers_.begin(), headers_.end(), [](const Header& a, const Header& b)
+  {
+    return a.device < b.device;
+  });
+  // Pages every database holds in place are its own before any database
+  // looks for missing pages elsewhere.
+  Owners owners;
+  for (const Header& header : headers_)
+  {
+    Assembler assembler(ctx.device(), pages_, owners, options_, header.device,
+                        static_cast<Format>(header.format), header.page_size);
+    for (uint64_t device : assembler.reserve())
+    {
+      owners.emplace(device, header.device);
+    }
+  }
+  for (const Header& header : headers_)
+  {
+    auto owner = owners.find(header.device);
+    if (owner != owners.end() && owner->second != header.device)
+    {
+      continue;  // a shadow header, or a copy inside another database
+    }
+    Assembler assembler(ctx.device(), pages_, owners, options_, header.device,
+                        static_cast<Format>(header.format), header.page_size);
+    RecoveredFile file;
+    if (!assembler.assemble(file))
+    {
+      continue;
+    }
+    file.source = name();
+    assembler.claim(owners);
+    switch (header.format)
+    {
+    case FORMAT_JET:
+      ++stats_.jet;
+      break;
+    case FORMAT_ESE:
+      ++stats_.ese;
+      break;
+    default:
+      ++stats_.innodb;
+      break;
+    }
+    if (!file.extents.empty())
+    {
+      ++stats_.fragmented;
+    }
+    stats_.relocated += assembler.relocated();
+    stats_.missing += assembler.count(STATE_MISSING);
+    stats_.damaged += assembler.count(STATE_DAMAGED);
+    ctx.registry().add(std::move(file));
+  }
+  headers_.clear();
+  pages_ = PageIndex();  // up to max_pages records; not kept past the run
+}
+
+}  // namespace rsn
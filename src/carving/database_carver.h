@@ -0,0 +1,102 @@
+// RecoverySoftNetz — page-structured database (Jet/ACE, ESE, InnoDB) carve stage
+//
+// Access databases (Jet and ACE: MDB, ACCDB), ESE databases (EDB: Exchange,
+// Active Directory, Windows Search's Windows.edb) and InnoDB tablespaces
+// (.ibd, ibdata) are arrays of fixed-size pages with no footer, and their
+// pages say where they belong:
+//   - an InnoDB page holds its tablespace id and page number, its LSN twice
+//     and a checksum (CRC-32C or the older fold); page 0 gives the size;
+//   - an ESE page's XOR checksum is seeded with its page number, or on 16K
+//     and larger pages the number is stored, so a page that checks out names
+//     its own position;
+//   - a Jet page has no number, but data pages name their table definition
+//     page and index pages their neighbours, which can be checked against
+//     the pages already placed.
+// The stage tests every sector for a page of each format and size during the
+// scan and records what it finds in a page index (page_index). In `finish`
+// each database header is assembled page by page into its own page table:
+// a page is taken where the pages before it predict it; otherwise from the
+// index, the copy nearest that position that no other database holds (the
+// pages every database holds in place are its own before any is looked for
+// elsewhere). A
+// zero page is accepted as an unused one. Pages not found at all are placed
+// where the pages around them predict and reported, and the entry's
+// confidence lowered. ESE and Jet headers give no page count: the file ends
+// after the last page found, once no page the file references and no page
+// within `max_gap` follows. Pieces are assumed to start on page boundaries.
+
+#pragma once
+
+#include "carving/page_index.h"
+#include "core/carve_pipeline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rsn
+{
+
+struct DatabaseCarveOptions
+{
+  uint64_t max_file_size = 64ull << 30;
+  uint64_t search_distance = 1ull << 30;  // how far a page is looked for, each way
+  size_t max_pages = 16u << 20;           // pages the index holds; more are not recorded
+  unsigned max_gap = 64;                  // unused or missing pages bridged past the last reference
+  unsigned max_candidates = 256;          // unnumbered (Jet) pages tried for one position
+  unsigned confirm_pages = 2;             // Jet pages that must fit at a new piece
+};
+
+struct DatabaseCarveStats
+{
+  uint64_t jet = 0;         // MDB and ACCDB files
+  uint64_t ese = 0;         // EDB files
+  uint64_t innodb = 0;      // tablespaces
+  uint64_t indexed = 0;     // pages recorded during the scan
+  uint64_t dropped = 0;     // pages not recorded past `max_pages`
+  uint64_t fragmented = 0;  // databases assembled from more than one piece
+  uint64_t relocated = 0;   // pages taken from the index
+  uint64_t missing = 0;     // pages not found
+  uint64_t damaged = 0;     // pages placed with a checksum or number that fails
+};
+
+class DatabaseCarveStage : public CarveStage
+{
+public:
+  explicit DatabaseCarveStage(DatabaseCarveOptions options = DatabaseCarveOptions())
+    : options_(options)
+  {
+  }
+
+  const char* name() const override { return "database"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t /*tag*/, size_t /*pos*/, const ChunkView& /*chunk*/,
+             CarveContext& /*ctx*/) override
+  {
+    return false;
+  }
+  bool wantsChunks() const override { return true; }
+  void onChunk(const ChunkView& chunk, CarveContext& ctx) override;
+  size_t lookahead() const override { return 64u << 10; }
+  void finish(CarveContext& ctx) override;
+
+  /// Valid once the pipeline has finished.
+  const DatabaseCarveStats& stats() const { return stats_; }
+
+private:
+  struct Header
+  {
+    uint64_t device;
+    uint8_t format;
+    uint32_t page_size;
+  };
+
+  DatabaseCarveOptions options_;
+  std::mutex mutex_;
+  std::vector<Header> headers_;
+  PageIndex pages_;
+  DatabaseCarveStats stats_;
+};
+
+}  // namespace rsn
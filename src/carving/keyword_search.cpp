@@ -0,0 +1,163 @@
+// RecoverySoftNetz — keyword search stage
+
+#include "carving/keyword_search.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace rsn
+{
+
+namespace
+{
+
+/// UTF-8 to UTF-16LE bytes. Bytes that do not decode are taken as Latin-1.
+std::vector<uint8_t> toUtf16(const std::string& text)
+{
+  std::vector<uint8_t> out;
+  auto unit = [&](uint32_t u) {
+    out.push_back(static_cast<uint8_t>(u));
+    out.push_back(static_cast<uint8_t>(u >> 8));
+  };
+  for (size_t i = 0; i < text.size();)
+  {
+    auto c = static_cast<uint8_t>(text[i]);
+    size_t n = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    uint32_t cp = n == 0 ? c : c & (0x3F >> n);
+    bool valid = n == 0 ? c < 0x80 : i + n < text.size();
+    for (size_t k = 1; valid && k <= n; ++k)
+    {
+      auto next = static_cast<uint8_t>(text[i + k]);
+      valid = (next & 0xC0) == 0x80;
+      cp = (cp << 6) | (next & 0x3F);
+    }
+    if (!valid)
+    {
+      unit(c);
+      ++i;
+      continue;
+    }
+    if (cp >= 0x10000)
+    {
+      unit(0xD800 + ((cp - 0x10000) >> 10));
+      unit(0xDC00 + ((cp - 0x10000) & 0x3FF));
+    }
+    else
+    {
+      unit(cp);
+    }
+    i += n + 1;
+  }
+  return out;
+}
+
+/// Text of `bytes` in the hit's encoding, as UTF-8: printable ASCII as it is,
+/// UTF-8 sequences or BMP characters outside surrogates decoded, anything
+/// else as '.'.
+std::string context(ByteView bytes, bool utf16)
+{
+  std::string out;
+  if (utf16)
+  {
+    for (size_t i = 0; i + 1 < bytes.size; i += 2)
+    {
+      uint32_t u = loadLE16(bytes.data + i);
+      bool printable = (u >= 0x20 && u < 0x7F) || (u >= 0xA0 && (u < 0xD800 || u >= 0xE000));
+      appendUtf8(out, printable ? u : '.');
+    }
+    return out;
+  }
+  for (size_t i = 0; i < bytes.size; ++i)
+  {
+    uint8_t c = bytes[i];
+    size_t n = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC2 ? 1 : 0;
+    bool sequence = n != 0 && n < bytes.size - i;
+    for (size_t k = 1; sequence && k <= n; ++k)
+    {
+      sequence = (bytes[i + k] & 0xC0) == 0x80;
+    }
+    if (sequence)
+    {
+      out.append(reinterpret_cast<const char*>(bytes.data + i), n + 1);
+      i += n;
+      continue;
+    }
+    out += c >= 0x20 && c < 0x7F ? static_cast<char>(c) : '.';
+  }
+  return out;
+}
+
+}  // namespace
+
+KeywordSearchStage::KeywordSearchStage(std::vector<std::string> keywords, KeywordSink sink,
+                                       KeywordOptions options)
+  : keywords_(std::move(keywords)),
+    sink_(std::move(sink)),
+    options_(options),
+    hits_(new std::atomic<uint64_t>[keywords_.size()])
+{
+  for (size_t i = 0; i < keywords_.size(); ++i)
+  {
+    hits_[i].store(0);
+    utf16_sizes_.push_back(toUtf16(keywords_[i]).size());
+  }
+}
+
+void KeywordSearchStage::registerPatterns(PatternSet& patterns)
+{
+  for (size_t i = 0; i < keywords_.size(); ++i)
+  {
+    auto tag = static_cast<uint32_t>(i * 2);
+    if (options_.ascii)
+    {
+      patterns.add(keywords_[i], tag);
+    }
+    if (options_.utf16)
+    {
+      std::vector<uint8_t> wide = toUtf16(keywords_[i]);
+      patterns.add(wide.data(), wide.size(), tag + 1);
+    }
+  }
+}
+
+size_t KeywordSearchStage::lookahead() const
+{
+  size_t longest = 0;
+  for (const std::string& keyword : keywords_)
+  {
+    longest = std::max(longest, keyword.size());
+  }
+  return 2 * (longest + options_.context);
+}
+
+bool KeywordSearchStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  KeywordHit hit;
+  hit.keyword = tag / 2;
+  hit.utf16 = (tag & 1) != 0;
+  hit.offset = chunk.offset + pos;
+  size_t unit = hit.utf16 ? 2 : 1;
+  size_t length = hit.utf16 ? utf16_sizes_[hit.keyword] : keywords_[hit.keyword].size();
+  uint64_t before = std::min<uint64_t>(hit.offset, options_.context * unit) / unit * unit;
+  uint64_t start = hit.offset - before;
+  size_t span = static_cast<size_t>(before) + length + options_.context * unit;
+  SecureBytes buffer;
+  ByteView bytes;
+  if (start >= chunk.offset && start + span <= chunk.offset + chunk.size)
+  {
+    bytes = ByteView(chunk.data + (start - chunk.offset), span);
+  }
+  else
+  {
+    buffer = ctx.readAt(start, span);
+    bytes = ByteView(buffer.data(), buffer.size());
+  }
+  hit.context = context(bytes, hit.utf16);
+  hits_[hit.keyword].fetch_add(1, std::memory_order_relaxed);
+  sink_(hit);
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,65 @@
+// RecoverySoftNetz — keyword search stage
+//
+// Memory artifacts and unallocated space are searched for words as often as
+// they are carved for files: names, addresses, passwords, document phrases.
+// The stage adds every keyword to the pipeline's shared matcher, as ASCII
+// (which is also its UTF-8) and as UTF-16LE, so the search costs nothing
+// beyond the scan the carvers already make. Matching is exact. Each hit goes
+// to a sink with the text around it, the bytes of its encoding that are not
+// printable shown as '.'.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+struct KeywordHit
+{
+  uint32_t keyword = 0;  // index into the keyword list
+  uint64_t offset = 0;   // on the device searched
+  bool utf16 = false;
+  std::string context;   // text around the hit, in UTF-8
+};
+
+/// Called from worker threads for every hit; must be thread-safe.
+using KeywordSink = std::function<void(const KeywordHit& hit)>;
+
+struct KeywordOptions
+{
+  bool ascii = true;
+  bool utf16 = true;
+  size_t context = 48;  // characters on each side of a hit
+};
+
+class KeywordSearchStage : public CarveStage
+{
+public:
+  KeywordSearchStage(std::vector<std::string> keywords, KeywordSink sink,
+                     KeywordOptions options = KeywordOptions());
+
+  const char* name() const override { return "keywords"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  size_t lookahead() const override;
+
+  /// Hits of keyword `index` so far.
+  uint64_t hits(size_t index) const { return hits_[index].load(); }
+
+private:
+  std::vector<std::string> keywords_;
+  std::vector<size_t> utf16_sizes_;  // bytes of each keyword in UTF-16LE
+  KeywordSink sink_;
+  KeywordOptions options_;
+  std::unique_ptr<std::atomic<uint64_t>[]> hits_;
+};
+
+}  // namespace rsn
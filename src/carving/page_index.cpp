@@ -0,0 +1,74 @@
+// RecoverySoftNetz — page index for page-structured carvers
+
+#include "carving/page_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace rsn
+{
+
+size_t PageIndex::merge(PageIndex& other, size_t limit)
+{
+  size_t room = records_.size() < limit ? limit - records_.size() : 0;
+  size_t take = std::min(room, other.records_.size());
+  records_.insert(records_.end(), other.records_.begin(), other.records_.begin() + take);
+  size_t dropped = other.records_.size() - take;
+  other.records_.clear();
+  return dropped;
+}
+
+void PageIndex::seal()
+{
+  std::sort(records_.begin(), records_.end(), [](const Record& a, const Record& b)
+  {
+    if (a.space != b.space)
+    {
+      return a.space < b.space;
+    }
+    return a.number != b.number ? a.number < b.number : a.device < b.device;
+  });
+}
+
+std::vector<uint64_t> PageIndex::find(uint64_t space, uint32_t number, uint64_t near,
+                                      uint64_t distance, size_t limit) const
+{
+  auto key = [](const Record& r) { return std::make_pair(r.space, r.number); };
+  auto wanted = std::make_pair(space, number);
+  auto before = [&](const Record& a, const Record& b)
+  {
+    return key(a) != key(b) ? key(a) < key(b) : a.device < b.device;
+  };
+  uint64_t low = near > distance ? near - distance : 0;
+  auto first = std::lower_bound(records_.begin(), records_.end(), Record{space, number, low},
+                                before);
+  // Walk outwards from `near`, both ways at once.
+  auto split = std::lower_bound(first, records_.end(), Record{space, number, near}, before);
+  auto backward = split;
+  auto forward = split;
+  std::vector<uint64_t> out;
+  while (out.size() < limit)
+  {
+    bool has_forward = forward != records_.end() && key(*forward) == wanted &&
+                       forward->device - near <= distance;
+    bool has_backward = backward != first;
+    if (!has_forward && !has_backward)
+    {
+      break;
+    }
+    if (has_forward &&
+        (!has_backward || forward->device - near <= near - std::prev(backward)->device))
+    {
+      out.push_back(forward->device);
+      ++forward;
+    }
+    else
+    {
+      --backward;
+      out.push_back(backward->device);
+    }
+  }
+  return out;
+}
+
+}  // namespace rsn
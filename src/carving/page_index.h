@@ -0,0 +1,54 @@
+// RecoverySoftNetz — page index for page-structured carvers
+//
+// Databases are arrays of fixed-size pages, and most page formats say which
+// page they are: a tablespace or file id and a page number, confirmed by a
+// checksum. A carver that recognizes such pages during the scan records them
+// here, and once the scan is over looks up where page N of a file is stored
+// when it is not where the file's other pages put it. Formats without page
+// numbers record every page under number 0 and check the candidates
+// themselves.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+class PageIndex
+{
+public:
+  void add(uint64_t space, uint32_t number, uint64_t device)
+  {
+    records_.push_back({space, number, device});
+  }
+
+  /// Move the records of `other` in, keeping at most `limit` in total.
+  /// Returns how many were dropped.
+  size_t merge(PageIndex& other, size_t limit);
+
+  /// Sort for lookups; call once every page has been added.
+  void seal();
+
+  size_t size() const { return records_.size(); }
+
+  /// Devices holding page `number` of `space` within `distance` of `near`,
+  /// nearest first and forward before backward at equal distance, at most
+  /// `limit` of them.
+  std::vector<uint64_t> find(uint64_t space, uint32_t number, uint64_t near, uint64_t distance,
+                             size_t limit) const;
+
+private:
+  struct Record
+  {
+    uint64_t space;
+    uint32_t number;
+    uint64_t device;
+  };
+
+  std::vector<Record> records_;
+};
+
+}  // namespace rsn
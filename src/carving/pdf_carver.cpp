@@ -0,0 +1,1772 @@
+// RecoverySoftNetz — PDF carve stage
+
+#include "carving/pdf_carver.h"
+
+#include "carving/piece_map.h"
+#include "common/inflate.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t HEAD_SIZE = 1024;         // read after "%PDF-" for the linearization dictionary
+constexpr size_t TAIL_SIZE = 1024;         // read before "%%EOF" for startxref
+constexpr size_t FIRST_READ = 64u << 10;   // first read of a section; doubled while it is short
+constexpr size_t OBJECT_HEAD = 32;         // read to check "N G obj"
+constexpr size_t LENGTH_OBJECT = 64;       // read for an indirect stream length
+constexpr size_t VERSION_SIZE = 8;         // "%PDF-1.7"
+constexpr size_t EOF_SIZE = 5;             // "%%EOF"
+constexpr size_t MAX_MATCH = 258;          // longest DEFLATE match
+constexpr uint64_t MAX_OBJECTS = 8388608;  // the format's limit on object numbers
+constexpr unsigned MAX_DEPTH = 64;         // nesting of arrays and dictionaries
+constexpr uint64_t MAX_PIN_WORK = 256ull << 20;  // bytes parsed to place one break
+
+constexpr double CONFIDENCE_VERIFIED = 0.95;     // every object parses in place
+constexpr double CONFIDENCE_REASSEMBLED = 0.85;  // ... once the pieces were found
+constexpr double CONFIDENCE_AMBIGUOUS = 0.6;     // a break is not pinned, or objects are damaged
+constexpr double CONFIDENCE_UNRESOLVED = 0.4;    // an object was not found
+
+bool isWhite(uint8_t c)
+{
+  return c == 0 || c == '\t' || c == '\n' || c == '\f' || c == '\r' || c == ' ';
+}
+
+bool isDelimiter(uint8_t c)
+{
+  return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' || c == '{' ||
+         c == '}' || c == '/' || c == '%';
+}
+
+bool isRegular(uint8_t c)
+{
+  return !isWhite(c) && !isDelimiter(c);
+}
+
+bool isDigit(uint8_t c)
+{
+  return c >= '0' && c <= '9';
+}
+
+/// A parsed object, reduced to what the carver looks at: strings, reals and
+/// keywords are skipped over and kept as OTHER.
+struct Value
+{
+  enum Kind
+  {
+    NONE,
+    INTEGER,
+    NAME,
+    REFERENCE,
+    ARRAY,
+    DICTIONARY,
+    OTHER,
+  };
+
+  Kind kind = NONE;
+  uint64_t number = 0;       // INTEGER value; REFERENCE object number
+  uint64_t generation = 0;   // REFERENCE
+  std::string name;          // NAME, without the slash
+  std::vector<Value> items;  // ARRAY elements; DICTIONARY keys and values, alternating
+
+  const Value* find(const char* key) const
+  {
+    for (size_t k = 0; k + 1 < items.size(); k += 2)
+    {
+      if (items[k].name == key)
+      {
+        return &items[k + 1];
+      }
+    }
+    return nullptr;
+  }
+
+  bool integer(const char* key, uint64_t& out) const
+  {
+    const Value* value = find(key);
+    if (value == nullptr || value->kind != INTEGER)
+    {
+      return false;
+    }
+    out = value->number;
+    return true;
+  }
+
+  /// The entry's name, or the first name of an array of them.
+  std::string firstName(const char* key) const
+  {
+    const Value* value = find(key);
+    if (value != nullptr && value->kind == ARRAY && !value->items.empty())
+    {
+      value = &value->items.front();
+    }
+    return value != nullptr && value->kind == NAME ? value->name : std::string();
+  }
+};
+
+/// Tokenizer over a buffer. `exhausted` tells a parse that failed for lack
+/// of bytes from one that failed on bad syntax.
+class Parser
+{
+public:
+  Parser(const uint8_t* data, size_t size, size_t pos = 0) : data_(data), size_(size), pos_(pos) {}
+
+  size_t pos() const { return pos_; }
+  bool exhausted() const { return exhausted_; }
+
+  /// Skip whitespace and comments.
+  void skip();
+  bool keyword(const char* word);
+  bool integer(uint64_t& out);
+  bool objectHeader(uint64_t& number, uint64_t& generation);
+  bool value(Value& out, unsigned depth = 0);
+  /// After "stream": the end-of-line, `length` bytes of data and "endstream".
+  bool stream(uint64_t length, ByteView& data);
+
+private:
+  bool more()
+  {
+    if (pos_ < size_)
+    {
+      return true;
+    }
+    exhausted_ = true;
+    return false;
+  }
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
+  bool exhausted_ = false;
+};
+
+void Parser::skip()
+{
+  while (more())
+  {
+    uint8_t c = data_[pos_];
+    if (c == '%')
+    {
+      while (pos_ < size_ && data_[pos_] != '\n' && data_[pos_] != '\r')
+      {
+        ++pos_;
+      }
+    }
+    else if (isWhite(c))
+    {
+      ++pos_;
+    }
+    else
+    {
+      return;
+    }
+  }
+}
+
+bool Parser::keyword(const char* word)
+{
+  skip();
+  size_t length = std::strlen(word);
+  for (size_t k = 0; k < length; ++k)
+  {
+    if (pos_ + k >= size_)
+    {
+      exhausted_ = true;
+      return false;
+    }
+    if (data_[pos_ + k] != static_cast<uint8_t>(word[k]))
+    {
+      return false;
+    }
+  }
+  if (pos_ + length < size_ && isRegular(data_[pos_ + length]))
+  {
+    return false;
+  }
+  pos_ += length;
+  return true;
+}
+
+bool Parser::integer(uint64_t& out)
+{
+  skip();
+  size_t p = pos_;
+  uint64_t value = 0;
+  while (p < size_ && isDigit(data_[p]))
+  {
+    if (p - pos_ == 18)
+    {
+      return false;
+    }
+    value = value * 10 + (data_[p] - '0');
+    ++p;
+  }
+  if (p == size_)
+  {
+    exhausted_ = true;
+  }
+  if (p == pos_ || (p < size_ && isRegular(data_[p])))
+  {
+    return false;
+  }
+  pos_ = p;
+  out = value;
+  return true;
+}
+
+bool Parser::objectHeader(uint64_t& number, uint64_t& generation)
+{
+  return integer(number) && integer(generation) && keyword("obj") && number < MAX_OBJECTS &&
+         generation <= 0xFFFF;
+}
+
+bool Parser::value(Value& out, unsigned depth)
+{
+  skip();
+  if (depth > MAX_DEPTH || !more())
+  {
+    return false;
+  }
+  uint8_t c = data_[pos_];
+  if (c == '/')
+  {
+    size_t begin = ++pos_;
+    while (pos_ < size_ && isRegular(data_[pos_]))
+    {
+      ++pos_;
+    }
+    out.kind = Value::NAME;
+    out.name.assign(reinterpret_cast<const char*>(data_ + begin), pos_ - begin);
+    return true;
+  }
+  if (c == '<' && pos_ + 1 < size_ && data_[pos_ + 1] == '<')
+  {
+    pos_ += 2;
+    out.kind = Value::DICTIONARY;
+    for (;;)
+    {
+      skip();
+      if (!more())
+      {
+        return false;
+      }
+      if (data_[pos_] == '>')
+      {
+        if (pos_ + 1 == size_)
+        {
+          exhausted_ = true;
+          return false;
+        }
+        if (data_[pos_ + 1] != '>')
+        {
+          return false;
+        }
+        pos_ += 2;
+        return true;
+      }
+      Value key;
+      Value item;
+      if (!value(key, depth + 1) || key.kind != Value::NAME || !value(item, depth + 1))
+      {
+        return false;
+      }
+      out.items.push_back(std::move(key));
+      out.items.push_back(std::move(item));
+    }
+  }
+  if (c == '<')
+  {
+    while (more() && data_[pos_] != '>')
+    {
+      ++pos_;
+    }
+    if (!more())
+    {
+      return false;
+    }
+    ++pos_;
+    out.kind = Value::OTHER;
+    return true;
+  }
+  if (c == '[')
+  {
+    ++pos_;
+    out.kind = Value::ARRAY;
+    for (;;)
+    {
+      skip();
+      if (!more())
+      {
+        return false;
+      }
+      if (data_[pos_] == ']')
+      {
+        ++pos_;
+        return true;
+      }
+      Value item;
+      if (!value(item, depth + 1))
+      {
+        return false;
+      }
+      out.items.push_back(std::move(item));
+    }
+  }
+  if (c == '(')
+  {
+    ++pos_;
+    unsigned nesting = 1;
+    while (more())
+    {
+      uint8_t d = data_[pos_++];
+      if (d == '\\')
+      {
+        ++pos_;
+      }
+      else if (d == '(')
+      {
+        ++nesting;
+      }
+      else if (d == ')' && --nesting == 0)
+      {
+        out.kind = Value::OTHER;
+        return true;
+      }
+    }
+    return false;
+  }
+  if (isDigit(c))
+  {
+    size_t begin = pos_;
+    uint64_t number = 0;
+    if (integer(number))
+    {
+      size_t after = pos_;
+      uint64_t generation = 0;
+      if (integer(generation) && keyword("R"))
+      {
+        out.kind = Value::REFERENCE;
+        out.number = number;
+        out.generation = generation;
+        return true;
+      }
+      pos_ = after;
+      out.kind = Value::INTEGER;
+      out.number = number;
+      return true;
+    }
+    pos_ = begin;
+  }
+  if (!isRegular(c))
+  {
+    return false;
+  }
+  // Reals, signed numbers, true, false and null.
+  while (pos_ < size_ && isRegular(data_[pos_]))
+  {
+    ++pos_;
+  }
+  out.kind = Value::OTHER;
+  return true;
+}
+
+bool Parser::stream(uint64_t length, ByteView& data)
+{
+  if (pos_ < size_ && data_[pos_] == '\r')
+  {
+    ++pos_;
+  }
+  if (!more() || data_[pos_] != '\n')
+  {
+    return false;
+  }
+  ++pos_;
+  if (length > size_ - pos_)
+  {
+    exhausted_ = true;
+    return false;
+  }
+  data = ByteView(data_ + pos_, static_cast<size_t>(length));
+  pos_ += static_cast<size_t>(length);
+  return keyword("endstream");
+}
+
+/// Undo the PNG row predictors cross-reference streams are stored with: one
+/// filter-type byte before each row of `columns` one-byte samples.
+bool unpredict(std::vector<uint8_t>& data, size_t columns)
+{
+  size_t row = columns + 1;
+  if (columns == 0 || data.size() % row != 0)
+  {
+    return false;
+  }
+  std::vector<uint8_t> out;
+  out.reserve(data.size() / row * columns);
+  std::vector<uint8_t> prior(columns, 0);
+  for (size_t r = 0; r < data.size(); r += row)
+  {
+    uint8_t type = data[r];
+    uint8_t* current = data.data() + r + 1;
+    for (size_t i = 0; i < columns; ++i)
+    {
+      int left = i != 0 ? current[i - 1] : 0;
+      int up = prior[i];
+      int corner = i != 0 ? prior[i - 1] : 0;
+      int add = 0;
+      switch (type)
+      {
+      case 0:
+        break;
+      case 1:
+        add = left;
+        break;
+      case 2:
+        add = up;
+        break;
+      case 3:
+        add = (left + up) / 2;
+        break;
+      case 4:
+      {
+        int p = left + up - corner;
+        int pa = std::abs(p - left);
+        int pb = std::abs(p - up);
+        int pc = std::abs(p - corner);
+        add = pa <= pb && pa <= pc ? left : (pb <= pc ? up : corner);
+        break;
+      }
+      default:
+        return false;
+      }
+      current[i] = static_cast<uint8_t>(current[i] + add);
+    }
+    prior.assign(current, current + columns);
+    out.insert(out.end(), current, current + columns);
+  }
+  data.swap(out);
+  return true;
+}
+
+/// Decode a cross-reference stream's data: unfiltered, or FlateDecode with
+/// or without a PNG predictor.
+bool decodeStream(const Value& dictionary, ByteView data, size_t max_output,
+                  std::vector<uint8_t>& out)
+{
+  const Value* filter = dictionary.find("Filter");
+  if (filter == nullptr)
+  {
+    out.assign(data.data, data.data + data.size);
+    return true;
+  }
+  if (dictionary.firstName("Filter") != "FlateDecode" ||
+      (filter->kind == Value::ARRAY && filter->items.size() != 1))
+  {
+    return false;
+  }
+  out.clear();
+  if (!inflateZlib(data.data, data.size, out, max_output))
+  {
+    return false;
+  }
+  const Value* parameters = dictionary.find("DecodeParms");
+  if (parameters != nullptr && parameters->kind == Value::ARRAY && parameters->items.size() == 1)
+  {
+    parameters = &parameters->items.front();
+  }
+  if (parameters == nullptr || parameters->kind != Value::DICTIONARY)
+  {
+    return true;
+  }
+  uint64_t predictor = 1;
+  uint64_t columns = 1;
+  uint64_t colors = 1;
+  uint64_t bits = 8;
+  parameters->integer("Predictor", predictor);
+  parameters->integer("Columns", columns);
+  parameters->integer("Colors", colors);
+  parameters->integer("BitsPerComponent", bits);
+  if (predictor == 1)
+  {
+    return true;
+  }
+  return predictor >= 10 && colors == 1 && bits == 8 && columns <= 64 && unpredict(out, columns);
+}
+
+/// An object in use at a file offset.
+struct Entry
+{
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  uint64_t offset = 0;
+};
+
+/// One cross-reference table or stream, with its trailer.
+struct Section
+{
+  uint64_t offset = 0;  // file offset
+  uint64_t size = 0;    // bytes it takes up, trailer included
+  bool stream = false;
+  int64_t prev = -1;    // /Prev: the section of the previous revision
+  int64_t hybrid = -1;  // /XRefStm: the stream a hybrid file keeps beside its table
+  std::vector<Entry> entries;
+  std::vector<uint64_t> compressed;  // numbers of objects kept in object streams
+};
+
+bool readTrailer(const Value& trailer, Section& out)
+{
+  uint64_t size = 0;
+  if (trailer.kind != Value::DICTIONARY || !trailer.integer("Size", size) || size > MAX_OBJECTS)
+  {
+    return false;
+  }
+  for (const Entry& entry : out.entries)
+  {
+    if (entry.number >= size)
+    {
+      return false;
+    }
+  }
+  uint64_t value = 0;
+  if (trailer.integer("Prev", value))
+  {
+    out.prev = static_cast<int64_t>(value);
+  }
+  if (trailer.integer("XRefStm", value))
+  {
+    out.hybrid = static_cast<int64_t>(value);
+  }
+  return true;
+}
+
+/// A table after its "xref" keyword: subsections of 20-byte entries, then
+/// "trailer" and its dictionary. Offsets must lie below `limit`.
+bool readTable(Parser& parser, uint64_t limit, Section& out)
+{
+  while (!parser.keyword("trailer"))
+  {
+    uint64_t first = 0;
+    uint64_t count = 0;
+    if (!parser.integer(first) || !parser.integer(count) || first + count > MAX_OBJECTS)
+    {
+      return false;
+    }
+    for (uint64_t k = 0; k < count; ++k)
+    {
+      uint64_t offset = 0;
+      uint64_t generation = 0;
+      if (!parser.integer(offset) || !parser.integer(generation) || generation > 0xFFFF)
+      {
+        return false;
+      }
+      if (parser.keyword("n"))
+      {
+        if (offset >= limit)
+        {
+          return false;
+        }
+        if (offset != 0)
+        {
+          out.entries.push_back(Entry{first + k, generation, offset});
+        }
+      }
+      else if (!parser.keyword("f"))
+      {
+        return false;
+      }
+    }
+  }
+  Value trailer;
+  return parser.value(trailer) && readTrailer(trailer, out);
+}
+
+/// A cross-reference stream object: rows of /W-sized big-endian fields for
+/// the object numbers /Index lists.
+bool readXrefStream(Parser& parser, uint64_t limit, size_t max_output, Section& out)
+{
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  Value dictionary;
+  uint64_t length = 0;
+  ByteView data;
+  if (!parser.objectHeader(number, generation) || !parser.value(dictionary) ||
+      dictionary.kind != Value::DICTIONARY || dictionary.firstName("Type") != "XRef" ||
+      !dictionary.integer("Length", length) || !parser.keyword("stream") ||
+      !parser.stream(length, data) || !parser.keyword("endobj"))
+  {
+    return false;
+  }
+  const Value* widths = dictionary.find("W");
+  if (widths == nullptr || widths->kind != Value::ARRAY || widths->items.size() != 3)
+  {
+    return false;
+  }
+  size_t width[3];
+  for (size_t f = 0; f < 3; ++f)
+  {
+    const Value& w = widths->items[f];
+    if (w.kind != Value::INTEGER || w.number > 8)
+    {
+      return false;
+    }
+    width[f] = static_cast<size_t>(w.number);
+  }
+  uint64_t size = 0;
+  if (!dictionary.integer("Size", size) || size > MAX_OBJECTS)
+  {
+    return false;
+  }
+  std::vector<uint64_t> index;
+  const Value* ranges = dictionary.find("Index");
+  if (ranges == nullptr)
+  {
+    index = {0, size};
+  }
+  else if (ranges->kind == Value::ARRAY && ranges->items.size() % 2 == 0)
+  {
+    for (const Value& item : ranges->items)
+    {
+      if (item.kind != Value::INTEGER)
+      {
+        return false;
+      }
+      index.push_back(item.number);
+    }
+  }
+  else
+  {
+    return false;
+  }
+  std::vector<uint8_t> rows;
+  if (!decodeStream(dictionary, data, max_output, rows))
+  {
+    return false;
+  }
+  size_t row = width[0] + width[1] + width[2];
+  const uint8_t* p = rows.data();
+  const uint8_t* end = rows.data() + rows.size();
+  for (size_t r = 0; r < index.size(); r += 2)
+  {
+    if (index[r] + index[r + 1] > size)
+    {
+      return false;
+    }
+    for (uint64_t k = 0; k < index[r + 1]; ++k)
+    {
+      if (static_cast<size_t>(end - p) < row)
+      {
+        return false;
+      }
+      uint64_t field[3] = {width[0] == 0 ? 1u : 0u, 0, 0};
+      for (size_t f = 0; f < 3; ++f)
+      {
+        for (size_t b = 0; b < width[f]; ++b)
+        {
+          field[f] = field[f] << 8 | *p++;
+        }
+      }
+      if (field[0] == 1)
+      {
+        if (field[1] >= limit || field[2] > 0xFFFF)
+        {
+          return false;
+        }
+        out.entries.push_back(Entry{index[r] + k, field[2], field[1]});
+      }
+      else if (field[0] == 2)
+      {
+        out.compressed.push_back(index[r] + k);
+      }
+    }
+  }
+  out.stream = true;
+  return readTrailer(dictionary, out);
+}
+
+/// The "N G obj" of `entry` at the start of [data, data + size); `length`
+/// receives the bytes it takes.
+bool headerMatches(const uint8_t* data, size_t size, const Entry& entry, size_t& length)
+{
+  Parser parser(data, size);
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  if (!parser.objectHeader(number, generation) || number != entry.number ||
+      generation != entry.generation)
+  {
+    return false;
+  }
+  length = parser.pos();
+  return true;
+}
+
+/// Bytes "N G obj" takes for `entry` when written with single spaces.
+uint64_t headerLength(const Entry& entry)
+{
+  return std::to_string(entry.number).size() + std::to_string(entry.generation).size() + 5;
+}
+
+struct Document
+{
+  PieceMap map{0};
+  uint64_t header = 0;  // device offset
+  uint64_t size = 0;
+  std::string version;
+  bool linearized = false;
+  uint64_t linearized_length = 0;
+  uint64_t anchor_file = 0;    // a section the tail of the file was found from ...
+  uint64_t anchor_device = 0;  // ... and where it is
+  std::vector<uint64_t> eofs;  // device offsets of the revisions' "%%EOF"
+  std::vector<Section> sections;
+  std::vector<Entry> objects;    // by file offset, one per offset
+  std::vector<uint64_t> ends;    // where each object's span ends: the next object or section
+  std::map<uint64_t, size_t> numbers;  // object number -> objects index, newest definition
+  size_t count = 0;                    // objects in use, object streams included
+  uint64_t ambiguous = 0;  // bytes between a found piece and the last object before it
+  uint64_t unresolved = UINT64_MAX;
+  size_t damaged = 0;  // objects failing the streaming pass
+};
+
+/// Resolves the documents of one scan; reused across headers.
+class Assembler
+{
+public:
+  Assembler(Device& device, const PdfCarveOptions& options, PdfCarveStats& stats,
+            const std::vector<uint64_t>& headers, const std::vector<uint64_t>& ends,
+            const std::set<uint64_t>& claimed, const std::map<uint64_t, uint64_t>& explained)
+    : device_(device), options_(options), stats_(stats), headers_(headers), ends_(ends),
+      claimed_(claimed), explained_(explained), window_(device)
+  {
+    search_.block = options.block_size != 0 ? options.block_size : device.sectorSize();
+    search_.distance = options.search_distance;
+  }
+
+  /// The revisions of the document whose header is at `header` that follow
+  /// it contiguously. False when there are none.
+  bool contiguous(uint64_t header, Document& doc);
+
+  /// Find the end of the document whose header is at `header`, place its
+  /// objects and check them. False when no end was found.
+  bool assemble(uint64_t header, Document& doc);
+
+private:
+  bool readHead(Document& doc);
+  bool readTail(uint64_t eof, uint64_t& startxref, uint64_t& keyword, uint64_t& end);
+  bool readSection(uint64_t device, uint64_t file, uint64_t limit, Section& out,
+                   size_t split = SIZE_MAX, uint64_t rest = 0);
+  bool locateSection(uint64_t keyword, uint64_t lower, uint64_t& device, Section& out);
+  bool readSplitSection(const Document& doc, uint64_t file, uint64_t limit, Section& out,
+                        uint64_t& split);
+  bool readChain(Document& doc, uint64_t first, uint64_t limit, std::vector<Section>& sections);
+  bool foreign(const Document& doc, uint64_t start, uint64_t eof) const;
+  void extend(Document& doc);
+  bool anchor(Document& doc);
+  void update(Document& doc);
+  void collect(Document& doc);
+  bool headerAt(uint64_t device, const Entry& entry);
+  bool objectFits(const Document& doc, size_t index, bool backward, uint64_t& end);
+  bool runFits(const Document& doc, size_t first, bool backward);
+  bool streamLength(const Document& doc, const Value& dictionary, uint64_t& length);
+  bool objectSound(const Document& doc, size_t index);
+  uint64_t pinBreak(Document& doc, size_t index, uint64_t file, uint64_t bad);
+  void place(Document& doc);
+
+  Device& device_;
+  const PdfCarveOptions& options_;
+  PdfCarveStats& stats_;
+  const std::vector<uint64_t>& headers_;  // on sector boundaries, sorted
+  const std::vector<uint64_t>& ends_;     // sorted
+  const std::set<uint64_t>& claimed_;     // "%%EOF" inside registered documents
+  const std::map<uint64_t, uint64_t>& explained_;  // header -> end of its contiguous revisions
+  DeviceWindow window_;
+  PieceSearch search_;
+  std::vector<uint8_t> buffer_;
+  std::vector<uint8_t> decoded_;
+};
+
+/// The version, and the linearization dictionary when the first object is one.
+bool Assembler::readHead(Document& doc)
+{
+  uint8_t head[HEAD_SIZE];
+  size_t got = device_.read(doc.header, head, HEAD_SIZE);
+  if (got < VERSION_SIZE || std::memcmp(head, "%PDF-", 5) != 0 || !isDigit(head[5]) ||
+      head[6] != '.' || !isDigit(head[7]))
+  {
+    return false;
+  }
+  doc.version.assign(reinterpret_cast<const char*>(head + 5), 3);
+  Parser parser(head, got, VERSION_SIZE);
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  Value dictionary;
+  if (parser.objectHeader(number, generation) && parser.value(dictionary) &&
+      dictionary.kind == Value::DICTIONARY && dictionary.find("Linearized") != nullptr)
+  {
+    doc.linearized = true;
+    dictionary.integer("L", doc.linearized_length);
+  }
+  return true;
+}
+
+/// The startxref value before the "%%EOF" at `eof`, where its keyword is, and
+/// the device offset past the marker and its end-of-line.
+bool Assembler::readTail(uint64_t eof, uint64_t& startxref, uint64_t& keyword, uint64_t& end)
+{
+  uint64_t lower = eof - std::min<uint64_t>(eof, TAIL_SIZE);
+  size_t before = static_cast<size_t>(eof - lower);
+  uint8_t tail[TAIL_SIZE + EOF_SIZE + 2];
+  size_t got = device_.read(lower, tail, before + EOF_SIZE + 2);
+  if (got < before + EOF_SIZE)
+  {
+    return false;
+  }
+  static const char KEYWORD[] = "startxref";
+  size_t length = sizeof(KEYWORD) - 1;
+  size_t at = before;
+  while (at-- > 0)
+  {
+    if (at + length <= before && std::memcmp(tail + at, KEYWORD, length) == 0)
+    {
+      break;
+    }
+  }
+  if (at == SIZE_MAX)
+  {
+    return false;
+  }
+  Parser parser(tail, before, at + length);
+  if (!parser.integer(startxref))
+  {
+    return false;
+  }
+  for (size_t p = parser.pos(); p < before; ++p)
+  {
+    if (!isWhite(tail[p]))
+    {
+      return false;
+    }
+  }
+  keyword = lower + at;
+  size_t p = before + EOF_SIZE;
+  if (p < got && tail[p] == '\r')
+  {
+    ++p;
+  }
+  if (p < got && tail[p] == '\n')
+  {
+    ++p;
+  }
+  end = lower + p;
+  return true;
+}
+
+/// Parse the section at `device`, standing for file offset `file`; the read
+/// grows while the parse runs out of bytes. With `split` set, the bytes from
+/// that many into the section on are read at `rest`.
+bool Assembler::readSection(uint64_t device, uint64_t file, uint64_t limit, Section& out,
+                            size_t split, uint64_t rest)
+{
+  for (size_t span = std::min(FIRST_READ, options_.max_section_size);; span *= 2)
+  {
+    span = std::min(span, options_.max_section_size);
+    size_t head = std::min(span, split);
+    buffer_.resize(span);
+    size_t got = device_.read(device, buffer_.data(), head);
+    if (got == head && span > head)
+    {
+      got += device_.read(rest, buffer_.data() + head, span - head);
+    }
+    buffer_.resize(got);
+    Parser parser(buffer_.data(), buffer_.size());
+    out = Section();
+    out.offset = file;
+    bool ok = parser.keyword("xref")
+                ? readTable(parser, limit, out)
+                : readXrefStream(parser, limit, options_.max_section_size, out);
+    if (ok)
+    {
+      out.size = parser.pos();
+      return true;
+    }
+    if (!parser.exhausted() || buffer_.size() < span || span == options_.max_section_size)
+    {
+      return false;
+    }
+  }
+}
+
+/// Find the section that ends at the startxref keyword at `keyword`, looking
+/// back no further than `lower`.
+bool Assembler::locateSection(uint64_t keyword, uint64_t lower, uint64_t& device, Section& out)
+{
+  std::vector<uint8_t> before;
+  uint64_t tried = keyword;  // candidates at and above this were parsed already
+  for (uint64_t span = FIRST_READ;; span *= 2)
+  {
+    span = std::min<uint64_t>({span, options_.max_section_size, keyword - lower});
+    uint64_t start = keyword - span;
+    before.resize(static_cast<size_t>(span));
+    if (device_.read(start, before.data(), before.size()) != before.size())
+    {
+      return false;
+    }
+    for (size_t p = static_cast<size_t>(tried - start); p-- > 0;)
+    {
+      size_t candidate = SIZE_MAX;
+      bool line = p == 0 || before[p - 1] == '\n' || before[p - 1] == '\r';
+      if (line && p + 5 <= before.size() && std::memcmp(&before[p], "xref", 4) == 0 &&
+          isWhite(before[p + 4]))
+      {
+        candidate = p;
+      }
+      else if (line && isDigit(before[p]))
+      {
+        Parser parser(before.data(), before.size(), p);
+        uint64_t number = 0;
+        uint64_t generation = 0;
+        if (parser.objectHeader(number, generation))
+        {
+          candidate = p;
+        }
+      }
+      if (candidate == SIZE_MAX ||
+          !readSection(start + candidate, 0, options_.max_file_size, out) ||
+          candidate + out.size > before.size())
+      {
+        continue;
+      }
+      bool reaches = true;
+      for (size_t q = candidate + static_cast<size_t>(out.size); q < before.size(); ++q)
+      {
+        reaches = reaches && isWhite(before[q]);
+      }
+      if (reaches)
+      {
+        device = start + candidate;
+        return true;
+      }
+    }
+    tried = start;
+    if (start == lower || span == options_.max_section_size)
+    {
+      return false;
+    }
+  }
+}
+
+/// The section at file offset `file` starts in the head piece and runs on
+/// into the anchor piece: try each block boundary in its first read as the
+/// break. `split` receives the file offset of the one it parses across.
+bool Assembler::readSplitSection(const Document& doc, uint64_t file, uint64_t limit,
+                                 Section& out, uint64_t& split)
+{
+  uint64_t block = search_.block;
+  uint64_t last = std::min<uint64_t>(file + FIRST_READ, doc.anchor_file);
+  for (uint64_t at = (file / block + 1) * block; at <= last; at += block)
+  {
+    if (doc.anchor_file - at <= doc.anchor_device &&
+        readSection(doc.header + file, file, limit, out, static_cast<size_t>(at - file),
+                    doc.anchor_device - (doc.anchor_file - at)))
+    {
+      split = at;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Read the sections from the one at file offset `first` along /Prev and
+/// /XRefStm, each looked for in the head piece, in the anchor piece, and
+/// across a break between the two, which is then added to the map.
+bool Assembler::readChain(Document& doc, uint64_t first, uint64_t limit,
+                          std::vector<Section>& sections)
+{
+  sections.clear();
+  std::vector<uint64_t> pending{first};
+  std::set<uint64_t> seen;
+  uint64_t split = UINT64_MAX;
+  while (!pending.empty())
+  {
+    uint64_t file = pending.back();
+    pending.pop_back();
+    if (file >= limit || sections.size() == options_.max_sections)
+    {
+      return false;
+    }
+    if (!seen.insert(file).second)
+    {
+      continue;
+    }
+    uint64_t head = doc.header + file;
+    uint64_t anchored = UINT64_MAX;
+    if (doc.anchor_device - doc.anchor_file != doc.header &&
+        (file >= doc.anchor_file || doc.anchor_file - file <= doc.anchor_device))
+    {
+      anchored = doc.anchor_device + file - doc.anchor_file;
+    }
+    bool after = file >= doc.anchor_file;
+    uint64_t places[2] = {after ? anchored : head, after ? head : anchored};
+    Section section;
+    bool found = false;
+    for (uint64_t device : places)
+    {
+      found = found || (device != UINT64_MAX && readSection(device, file, limit, section));
+    }
+    if (!found && anchored != UINT64_MAX && !after && split == UINT64_MAX)
+    {
+      found = readSplitSection(doc, file, limit, section, split);
+    }
+    if (!found)
+    {
+      return false;
+    }
+    for (int64_t next : {section.prev, section.hybrid})
+    {
+      if (next >= 0)
+      {
+        pending.push_back(static_cast<uint64_t>(next));
+      }
+    }
+    sections.push_back(std::move(section));
+  }
+  if (split != UINT64_MAX)
+  {
+    doc.map.add(split, doc.anchor_device - (doc.anchor_file - split));
+  }
+  return true;
+}
+
+/// A "%%EOF" at `eof`, with its section stored as if the file started at
+/// `start`, ends a revision of another document: `start` is another header,
+/// or `eof` lies within the contiguous revisions of one.
+bool Assembler::foreign(const Document& doc, uint64_t start, uint64_t eof) const
+{
+  auto it = explained_.upper_bound(eof);
+  if (it != explained_.begin() && std::prev(it)->first != doc.header &&
+      std::prev(it)->second > eof)
+  {
+    return true;
+  }
+  return start != doc.header && std::binary_search(headers_.begin(), headers_.end(), start);
+}
+
+/// Take each later "%%EOF" whose startxref chain checks out, with the file
+/// running on from the anchor piece, as the end of another revision. The
+/// first revision of a contiguous file is found the same way from the head.
+void Assembler::extend(Document& doc)
+{
+  auto next = std::upper_bound(headers_.begin(), headers_.end(), doc.anchor_device);
+  uint64_t bound = next == headers_.end() ? UINT64_MAX : *next;
+  uint64_t from = doc.eofs.empty() ? doc.anchor_device : doc.eofs.back();
+  std::vector<Section> sections;
+  for (auto it = std::upper_bound(ends_.begin(), ends_.end(), from);
+       it != ends_.end() && *it < bound; ++it)
+  {
+    uint64_t startxref = 0;
+    uint64_t keyword = 0;
+    uint64_t end = 0;
+    if (claimed_.count(*it) != 0 || !readTail(*it, startxref, keyword, end))
+    {
+      continue;
+    }
+    uint64_t size = doc.anchor_file + (end - doc.anchor_device);
+    if (size > options_.max_file_size)
+    {
+      break;
+    }
+    if (readChain(doc, startxref, size, sections))
+    {
+      doc.sections.swap(sections);
+      doc.eofs.push_back(*it);
+      doc.size = size;
+    }
+  }
+}
+
+/// The file is not contiguous up to any "%%EOF": find one, nearest the
+/// header first, whose section, at the file offset startxref (or the
+/// first-page trailer) gives, lists objects that fit both in the header's
+/// allocation unit and in the section's.
+bool Assembler::anchor(Document& doc)
+{
+  uint64_t block = search_.block;
+  uint64_t header = doc.header;
+  auto ahead = std::upper_bound(ends_.begin(), ends_.end(), header);
+  auto behind = ahead;
+  unsigned tried = 0;
+  while (tried < options_.max_tails)
+  {
+    bool forward = ahead != ends_.end() && *ahead - header < options_.max_file_size;
+    bool backward = behind != ends_.begin() && header - *std::prev(behind) <= search_.distance;
+    if (forward && backward)
+    {
+      forward = *ahead - header <= header - *std::prev(behind);
+    }
+    else if (!forward && !backward)
+    {
+      break;
+    }
+    uint64_t eof = forward ? *ahead++ : *--behind;
+    uint64_t startxref = 0;
+    uint64_t keyword = 0;
+    uint64_t end = 0;
+    uint64_t device = 0;
+    Section tail;
+    if (claimed_.count(eof) != 0 || !readTail(eof, startxref, keyword, end) ||
+        !locateSection(keyword, forward ? header : 0, device, tail))
+    {
+      continue;
+    }
+    ++tried;
+    std::vector<Entry> entries = tail.entries;
+    uint64_t file = startxref;
+    if (doc.linearized)
+    {
+      Section first_page;
+      if (!readSection(doc.header + startxref, startxref, options_.max_file_size, first_page) ||
+          first_page.prev < 0)
+      {
+        continue;
+      }
+      file = static_cast<uint64_t>(first_page.prev);
+      entries.insert(entries.end(), first_page.entries.begin(), first_page.entries.end());
+    }
+    uint64_t size = file + (end - device);
+    if (size > options_.max_file_size ||
+        (doc.linearized && doc.linearized_length != 0 && size != doc.linearized_length) ||
+        foreign(doc, device >= file ? device - file : UINT64_MAX, eof))
+    {
+      continue;
+    }
+    // Objects in the header's allocation unit must be after the header,
+    // those in the section's unit (or the last one before it) before it.
+    uint64_t unit = file / block * block;
+    const Entry* last = nullptr;
+    bool fits = true;
+    size_t checked = 0;
+    for (const Entry& entry : entries)
+    {
+      if (entry.offset < block)
+      {
+        fits = fits && headerAt(header + entry.offset, entry);
+        ++checked;
+      }
+      if (entry.offset < file && (last == nullptr || entry.offset > last->offset))
+      {
+        last = &entry;
+      }
+    }
+    for (const Entry& entry : entries)
+    {
+      if (entry.offset < file && (entry.offset >= unit || &entry == last))
+      {
+        fits = fits && file - entry.offset <= device &&
+               headerAt(device - (file - entry.offset), entry);
+        ++checked;
+      }
+    }
+    if (!fits || checked == 0)
+    {
+      continue;
+    }
+    doc.anchor_file = file;
+    doc.anchor_device = device;
+    doc.size = size;
+    doc.eofs.push_back(eof);
+    if (!readChain(doc, startxref, doc.size, doc.sections))
+    {
+      // Older sections are elsewhere; the ones found still place the file.
+      doc.sections.clear();
+      tail.offset = file;
+      doc.sections.push_back(std::move(tail));
+    }
+    return true;
+  }
+  return false;
+}
+
+/// The file goes on past the revisions found, in another piece: take each
+/// "%%EOF", nearest the last one first, whose section's /Prev is the newest
+/// section taken and whose objects fit in the section's allocation unit,
+/// as the end of the next revision and the new anchor. Those that follow
+/// it contiguously are taken by `extend`.
+void Assembler::update(Document& doc)
+{
+  uint64_t block = search_.block;
+  unsigned tried = 0;
+  bool taken = true;
+  while (taken && !doc.sections.empty())
+  {
+    taken = false;
+    uint64_t newest = doc.sections.front().offset;
+    uint64_t from = doc.eofs.back();
+    auto ahead = std::upper_bound(ends_.begin(), ends_.end(), from);
+    auto behind = std::lower_bound(ends_.begin(), ends_.end(), from);
+    uint64_t lowest = doc.header - std::min(doc.header, search_.distance);
+    while (!taken && tried < options_.max_tails)
+    {
+      bool forward = ahead != ends_.end() && *ahead - doc.header < options_.max_file_size;
+      bool backward = behind != ends_.begin() && *std::prev(behind) >= lowest;
+      if (forward && backward)
+      {
+        forward = *ahead - from <= from - *std::prev(behind);
+      }
+      else if (!forward && !backward)
+      {
+        break;
+      }
+      uint64_t eof = forward ? *ahead++ : *--behind;
+      if (std::find(doc.eofs.begin(), doc.eofs.end(), eof) != doc.eofs.end())
+      {
+        continue;
+      }
+      uint64_t startxref = 0;
+      uint64_t keyword = 0;
+      uint64_t end = 0;
+      uint64_t device = 0;
+      Section tail;
+      if (claimed_.count(eof) != 0 || !readTail(eof, startxref, keyword, end) ||
+          !locateSection(keyword, 0, device, tail))
+      {
+        continue;
+      }
+      ++tried;
+      uint64_t file = startxref;
+      uint64_t size = file + (end - device);
+      if (tail.prev < 0 || static_cast<uint64_t>(tail.prev) != newest || file < doc.size ||
+          size > options_.max_file_size || file > device || foreign(doc, device - file, eof))
+      {
+        continue;
+      }
+      // The revision's objects in the section's unit, or the last one before
+      // it, must be where the section puts them.
+      uint64_t unit = file / block * block;
+      const Entry* last = nullptr;
+      for (const Entry& entry : tail.entries)
+      {
+        if (entry.offset >= doc.size && entry.offset < file &&
+            (last == nullptr || entry.offset > last->offset))
+        {
+          last = &entry;
+        }
+      }
+      bool fits = last != nullptr;
+      for (const Entry& entry : tail.entries)
+      {
+        if (entry.offset >= doc.size && entry.offset < file &&
+            (entry.offset >= unit || &entry == last))
+        {
+          fits = fits && headerAt(device - (file - entry.offset), entry);
+        }
+      }
+      if (!fits)
+      {
+        continue;
+      }
+      doc.anchor_file = file;
+      doc.anchor_device = device;
+      if (device - file != doc.header)
+      {
+        doc.map.add(file, device);
+      }
+      doc.size = size;
+      doc.eofs.push_back(eof);
+      std::vector<Section> sections;
+      if (readChain(doc, startxref, size, sections))
+      {
+        doc.sections.swap(sections);
+      }
+      else
+      {
+        tail.offset = file;
+        doc.sections.insert(doc.sections.begin(), std::move(tail));
+      }
+      extend(doc);
+      taken = true;
+    }
+  }
+}
+
+/// Revisions of a placed document: "%%EOF" markers taken, or sections along
+/// the /Prev chain when more (a linearized file's first-page section is not
+/// one).
+size_t revisions(const Document& doc)
+{
+  std::map<uint64_t, const Section*> by_offset;
+  for (const Section& section : doc.sections)
+  {
+    by_offset.emplace(section.offset, &section);
+  }
+  size_t chain = 0;
+  for (const Section* at = doc.sections.empty() ? nullptr : &doc.sections.front();
+       at != nullptr && chain < doc.sections.size(); ++chain)
+  {
+    auto it = at->prev < 0 ? by_offset.end() : by_offset.find(static_cast<uint64_t>(at->prev));
+    at = it == by_offset.end() ? nullptr : it->second;
+  }
+  if (doc.linearized && chain > 0)
+  {
+    --chain;
+  }
+  return std::max(doc.eofs.size(), chain);
+}
+
+/// Objects from every section, one per file offset, with the spans they
+/// are parsed within.
+void Assembler::collect(Document& doc)
+{
+  std::map<uint64_t, Entry> by_offset;
+  std::set<uint64_t> numbers;
+  std::set<uint64_t> boundaries{doc.size};
+  for (const Section& section : doc.sections)
+  {
+    boundaries.insert(section.offset);
+    for (const Entry& entry : section.entries)
+    {
+      if (entry.offset < doc.size)
+      {
+        by_offset.emplace(entry.offset, entry);
+        boundaries.insert(entry.offset);
+      }
+      numbers.insert(entry.number);
+    }
+    numbers.insert(section.compressed.begin(), section.compressed.end());
+  }
+  doc.count = numbers.size();
+  doc.objects.clear();
+  doc.ends.clear();
+  doc.numbers.clear();
+  for (const auto& item : by_offset)
+  {
+    doc.objects.push_back(item.second);
+    doc.ends.push_back(*boundaries.upper_bound(item.first));
+  }
+  // Sections are newest first: the first definition of a number is current.
+  for (const Section& section : doc.sections)
+  {
+    for (const Entry& entry : section.entries)
+    {
+      auto it = std::lower_bound(doc.objects.begin(), doc.objects.end(), entry.offset,
+                                 [](const Entry& a, uint64_t b) { return a.offset < b; });
+      if (it != doc.objects.end() && it->offset == entry.offset)
+      {
+        doc.numbers.emplace(entry.number, static_cast<size_t>(it - doc.objects.begin()));
+      }
+    }
+  }
+}
+
+bool Assembler::headerAt(uint64_t device, const Entry& entry)
+{
+  uint8_t head[OBJECT_HEAD];
+  size_t got = device_.read(device, head, OBJECT_HEAD);
+  size_t length = 0;
+  return headerMatches(head, got, entry, length);
+}
+
+/// The object's "N G obj" is where the map puts it; `end` receives the file
+/// offset past it.
+bool Assembler::objectFits(const Document& doc, size_t index, bool backward, uint64_t& end)
+{
+  const Entry& entry = doc.objects[index];
+  uint8_t head[OBJECT_HEAD];
+  size_t length = static_cast<size_t>(std::min<uint64_t>(OBJECT_HEAD, doc.size - entry.offset));
+  size_t used = 0;
+  if (!window_.get(doc.map, entry.offset, head, length, backward) ||
+      !headerMatches(head, length, entry, used))
+  {
+    return false;
+  }
+  end = entry.offset + used;
+  return true;
+}
+
+bool Assembler::runFits(const Document& doc, size_t first, bool backward)
+{
+  size_t last = std::min(doc.objects.size(), first + std::max(1u, options_.confirm_objects));
+  for (size_t k = first; k < last; ++k)
+  {
+    uint64_t end = 0;
+    if (!objectFits(doc, k, backward, end))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// A stream's /Length, direct or through the object it refers to.
+bool Assembler::streamLength(const Document& doc, const Value& dictionary, uint64_t& length)
+{
+  const Value* value = dictionary.find("Length");
+  if (value != nullptr && value->kind == Value::INTEGER)
+  {
+    length = value->number;
+    return true;
+  }
+  if (value == nullptr || value->kind != Value::REFERENCE)
+  {
+    return false;
+  }
+  auto it = doc.numbers.find(value->number);
+  if (it == doc.numbers.end() || doc.objects[it->second].offset >= doc.unresolved)
+  {
+    return false;
+  }
+  const Entry& entry = doc.objects[it->second];
+  uint8_t text[LENGTH_OBJECT];
+  size_t size = static_cast<size_t>(std::min<uint64_t>(LENGTH_OBJECT, doc.size - entry.offset));
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  if (!window_.get(doc.map, entry.offset, text, size))
+  {
+    return false;
+  }
+  Parser parser(text, size);
+  return parser.objectHeader(number, generation) && number == entry.number &&
+         parser.integer(length) && parser.keyword("endobj");
+}
+
+/// Parse the object in full where the map puts it: its value, a stream's
+/// length and "endstream", the stream's data when it is Flate-encoded, and
+/// "endobj". Objects larger than `max_object_size` only have their header
+/// checked.
+bool Assembler::objectSound(const Document& doc, size_t index)
+{
+  const Entry& entry = doc.objects[index];
+  uint64_t span = doc.ends[index] - entry.offset;
+  if (span > options_.max_object_size)
+  {
+    uint64_t end = 0;
+    return objectFits(doc, index, false, end);
+  }
+  buffer_.resize(static_cast<size_t>(span));
+  if (!window_.get(doc.map, entry.offset, buffer_.data(), buffer_.size()))
+  {
+    return false;
+  }
+  Parser parser(buffer_.data(), buffer_.size());
+  uint64_t number = 0;
+  uint64_t generation = 0;
+  Value value;
+  if (!parser.objectHeader(number, generation) || number != entry.number ||
+      generation != entry.generation || !parser.value(value))
+  {
+    return false;
+  }
+  if (value.kind == Value::DICTIONARY && parser.keyword("stream"))
+  {
+    uint64_t length = 0;
+    ByteView data;
+    if (!streamLength(doc, value, length) || !parser.stream(length, data))
+    {
+      return false;
+    }
+    if (value.firstName("Filter") == "FlateDecode")
+    {
+      // Decoding stops at the cap; a stream that gets that far is taken as sound.
+      decoded_.clear();
+      if (!inflateZlib(data.data, data.size, decoded_, options_.max_inflate) &&
+          decoded_.size() + MAX_MATCH <= options_.max_inflate)
+      {
+        return false;
+      }
+    }
+  }
+  return parser.keyword("endobj");
+}
+
+/// A piece was found starting at the earliest block boundary after the
+/// header of object `index`, the last one that fit; the break may be at any
+/// boundary before `bad`. The object's full parse tells which: the piece is
+/// moved to the first boundary where it parses. Returns the bytes still
+/// placed unchecked.
+uint64_t Assembler::pinBreak(Document& doc, size_t index, uint64_t file, uint64_t bad)
+{
+  uint64_t block = search_.block;
+  uint64_t last = (bad - 1) / block * block;
+  if (last <= file)
+  {
+    return 0;
+  }
+  uint64_t span = doc.ends[index] - doc.objects[index].offset;
+  uint64_t candidates = (last - file) / block + 1;
+  if (span > options_.max_object_size || span * candidates > MAX_PIN_WORK)
+  {
+    return last - file;
+  }
+  uint64_t device = doc.map.device(file);
+  uint64_t first_sound = UINT64_MAX;
+  uint64_t last_sound = 0;
+  for (uint64_t at = file; at <= last; at += block)
+  {
+    doc.map.remove(at == file ? file : at - block);
+    doc.map.add(at, device + (at - file));
+    if (objectSound(doc, index))
+    {
+      first_sound = std::min(first_sound, at);
+      last_sound = at;
+    }
+  }
+  uint64_t at = first_sound != UINT64_MAX ? first_sound : file;
+  doc.map.remove(last);
+  doc.map.add(at, device + (at - file));
+  return first_sound != UINT64_MAX ? last_sound - first_sound : last - file;
+}
+
+/// Check the objects' headers in file order; a missing piece is first tried
+/// in the one holding the anchor section.
+void Assembler::place(Document& doc)
+{
+  uint64_t block = search_.block;
+  uint64_t anchor_file = doc.anchor_file;
+  uint64_t anchor_device = doc.anchor_device;
+  uint64_t good = VERSION_SIZE;
+  size_t last_good = SIZE_MAX;
+  for (size_t k = 0; k < doc.objects.size(); ++k)
+  {
+    const Entry& entry = doc.objects[k];
+    uint64_t end = 0;
+    if (objectFits(doc, k, false, end))
+    {
+      good = end;
+      last_good = k;
+      continue;
+    }
+    auto fits = [&](bool backward)
+    {
+      return runFits(doc, k, backward);
+    };
+    bool found = false;
+    uint64_t bad = entry.offset + headerLength(entry);
+    uint64_t file = (good + block - 1) / block * block;
+    if (file < bad && file > doc.map.pieceStart(file))
+    {
+      if (file < anchor_file && anchor_device >= anchor_file - file)
+      {
+        doc.map.add(file, anchor_device - (anchor_file - file));
+        found = fits(false);
+        if (!found)
+        {
+          doc.map.remove(file);
+        }
+      }
+      found = found || findPiece(doc.map, file, search_, device_.size(), fits);
+      if (found)
+      {
+        doc.ambiguous += last_good != SIZE_MAX ? pinBreak(doc, last_good, file, bad)
+                                               : (bad - 1) / block * block - file;
+      }
+    }
+    if (!found || !objectFits(doc, k, false, end))
+    {
+      doc.unresolved = entry.offset;
+      return;
+    }
+    ++stats_.pieces;
+    good = end;
+    last_good = k;
+  }
+  // The piece holding the anchor section starts after the last object header.
+  uint64_t file = (good + block - 1) / block * block;
+  if (anchor_file != 0 && file < anchor_file &&
+      doc.map.device(anchor_file - 1) + 1 != anchor_device && file > doc.map.pieceStart(file) &&
+      anchor_device >= anchor_file - file)
+  {
+    doc.map.remove(anchor_file);
+    doc.map.add(file, anchor_device - (anchor_file - file));
+    doc.ambiguous += last_good != SIZE_MAX ? pinBreak(doc, last_good, file, anchor_file)
+                                           : (anchor_file - 1) / block * block - file;
+  }
+}
+
+bool Assembler::contiguous(uint64_t header, Document& doc)
+{
+  doc = Document();
+  doc.header = header;
+  doc.map = PieceMap(header);
+  doc.anchor_device = header;
+  if (!readHead(doc))
+  {
+    return false;
+  }
+  extend(doc);
+  return !doc.eofs.empty();
+}
+
+bool Assembler::assemble(uint64_t header, Document& doc)
+{
+  if (!contiguous(header, doc))
+  {
+    if (doc.version.empty() || !anchor(doc))
+    {
+      return false;
+    }
+    if (doc.anchor_device - doc.anchor_file != header)
+    {
+      doc.map.add(doc.anchor_file, doc.anchor_device);
+    }
+    extend(doc);
+  }
+  update(doc);
+  collect(doc);
+  place(doc);
+  // The streaming pass, in file order through the placed pieces.
+  for (size_t k = 0; k < doc.objects.size() && doc.objects[k].offset < doc.unresolved; ++k)
+  {
+    doc.damaged += objectSound(doc, k) ? 0 : 1;
+  }
+  return true;
+}
+
+/// Confidence and the description suffix of a placed document.
+double describe(const Document& doc, std::vector<Extent>& extents, std::string& description)
+{
+  extents = doc.map.extents(doc.size);
+  if (!extents.empty())
+  {
+    description += ", " + std::to_string(extents.size()) + " pieces";
+  }
+  if (doc.unresolved != UINT64_MAX)
+  {
+    description += ", unverified from byte " + std::to_string(doc.unresolved);
+    return CONFIDENCE_UNRESOLVED;
+  }
+  if (doc.damaged != 0)
+  {
+    description += ", " + std::to_string(doc.damaged) +
+                   (doc.damaged == 1 ? " object damaged" : " objects damaged");
+  }
+  if (doc.ambiguous != 0)
+  {
+    description += ", " + std::to_string(doc.ambiguous) + " bytes placed unchecked";
+  }
+  if (doc.damaged != 0 || doc.ambiguous != 0)
+  {
+    return CONFIDENCE_AMBIGUOUS;
+  }
+  return extents.empty() ? CONFIDENCE_VERIFIED : CONFIDENCE_REASSEMBLED;
+}
+
+}  // namespace
+
+void PdfCarveStage::registerPatterns(PatternSet& patterns)
+{
+  patterns.add("%PDF-", TAG_HEADER);
+  patterns.add("%%EOF", TAG_EOF);
+}
+
+bool PdfCarveStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& /*ctx*/)
+{
+  uint64_t offset = chunk.offset + pos;
+  std::lock_guard<std::mutex> lock(mutex_);
+  (tag == TAG_HEADER ? headers_ : ends_).push_back(offset);
+  return true;
+}
+
+void PdfCarveStage::finish(CarveContext& ctx)
+{
+  stats_ = PdfCarveStats();
+  Device& device = ctx.device();
+  std::vector<uint64_t> headers;
+  for (uint64_t header : headers_)
+  {
+    if (header % device.sectorSize() == 0)
+    {
+      headers.push_back(header);
+    }
+    else
+    {
+      ++stats_.embedded;
+    }
+  }
+  std::sort(headers.begin(), headers.end());
+  std::sort(ends_.begin(), ends_.end());
+  std::set<uint64_t> claimed;
+  std::map<uint64_t, uint64_t> explained;
+  std::map<uint64_t, uint64_t> registered;  // device extents of registered documents
+  Assembler assembler(device, options_, stats_, headers, ends_, claimed, explained);
+  Document doc;
+  // Unfragmented documents first: a displaced revision is not looked for
+  // inside one, nor in a piece placed as if the file began at its header.
+  for (uint64_t header : headers)
+  {
+    bool inside = !explained.empty() && std::prev(explained.end())->second > header;
+    if (!inside && assembler.contiguous(header, doc))
+    {
+      explained[header] = header + doc.size;
+    }
+  }
+  for (uint64_t header : headers)
+  {
+    auto inside = registered.upper_bound(header);
+    if (inside != registered.begin() && std::prev(inside)->second > header)
+    {
+      ++stats_.embedded;
+      continue;
+    }
+    if (!assembler.assemble(header, doc))
+    {
+      ++stats_.orphans;
+      continue;
+    }
+    RecoveredFile file;
+    file.type = "document/pdf";
+    file.source = name();
+    file.offset = header;
+    file.size = doc.size;
+    file.description = "PDF " + doc.version + ", " + std::to_string(doc.count) + " objects";
+    if (doc.linearized)
+    {
+      file.description += ", linearized";
+      ++stats_.linearized;
+    }
+    size_t count = revisions(doc);
+    if (count > 1)
+    {
+      file.description += ", " + std::to_string(count) + " revisions";
+      ++stats_.updated;
+    }
+    file.confidence = describe(doc, file.extents, file.description);
+    for (const Section& section : doc.sections)
+    {
+      if (section.stream)
+      {
+        ++stats_.xref_streams;
+        break;
+      }
+    }
+    stats_.fragmented += file.extents.empty() ? 0 : 1;
+    stats_.unresolved += file.confidence == CONFIDENCE_UNRESOLVED ? 1 : 0;
+    stats_.damaged += doc.damaged != 0 ? 1 : 0;
+    std::vector<Extent> extents = file.extents;
+    if (extents.empty())
+    {
+      extents.push_back(Extent{header, doc.size});
+    }
+    for (const Extent& extent : extents)
+    {
+      registered[extent.offset] = extent.offset + extent.length;
+      for (auto it = std::lower_bound(ends_.begin(), ends_.end(), extent.offset);
+           it != ends_.end() && *it < extent.offset + extent.length; ++it)
+      {
+        claimed.insert(*it);
+      }
+    }
+    ctx.registry().add(std::move(file));
+    ++stats_.documents;
+  }
+  accepted_[TAG_HEADER] = stats_.documents;
+  accepted_[TAG_EOF] = claimed.size();
+  headers_.clear();
+  ends_.clear();
+}
+
+}  // namespace rsn
@@ -0,0 +1,96 @@
+// RecoverySoftNetz — PDF carve stage
+//
+// A PDF ends with "startxref", the offset of its last cross-reference section,
+// and "%%EOF". Incremental updates append a body, a section and another
+// "%%EOF" for every revision, and linearized files carry an extra section and
+// "%%EOF" near their start, so the first marker after a header is rarely the
+// end of the file. The stage records headers and markers during the scan and
+// resolves each header in `finish`:
+//   1. every marker after the header is tried as the end of a revision: its
+//      startxref must name a cross-reference table or stream whose /Prev and
+//      /XRefStm chain parses and only points inside the file so far. The last
+//      marker that checks out ends the file;
+//   2. the objects the sections list are checked in file order where the
+//      piece map puts them. When no marker checks out the file was
+//      fragmented: the section before a marker is located, the file offset it
+//      stands for taken from startxref (or, for a linearized file, from the
+//      first-page trailer), and missing pieces are looked for first in the
+//      piece holding it, then at allocation-unit granularity (piece_map);
+//   3. a streaming pass parses every object in full: dictionary, stream length
+//      and "endstream", a Flate stream's data, and "endobj".
+// Objects that fail step 3 are reported, and the entry's confidence lowered.
+// Headers not on a sector boundary are embedded in another file and are not
+// resolved. Documents that run contiguously to a marker are found first;
+// markers within them, or whose sections sit where another header would put
+// them, are not taken as revisions of a different document.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rsn
+{
+
+struct PdfCarveOptions
+{
+  uint64_t max_file_size = 4ull << 30;
+  uint32_t block_size = 0;                  // fragment granularity; 0 = device sector size
+  uint64_t search_distance = 256ull << 20;  // how far a missing piece is looked for, each way
+  unsigned confirm_objects = 2;             // object headers that must fit at a new piece
+  size_t max_section_size = 64u << 20;      // larger cross-reference sections are not read
+  size_t max_object_size = 64u << 20;       // larger objects only have their header checked
+  size_t max_inflate = 16u << 20;           // decoded bytes checked per Flate stream
+  size_t max_sections = 4096;               // cross-reference sections followed per revision
+  unsigned max_tails = 64;                  // sections tried as the tail of a fragmented file
+};
+
+struct PdfCarveStats
+{
+  uint64_t documents = 0;
+  uint64_t linearized = 0;
+  uint64_t updated = 0;       // documents with incremental updates
+  uint64_t xref_streams = 0;  // documents indexed by cross-reference streams
+  uint64_t fragmented = 0;    // documents assembled from more than one piece
+  uint64_t pieces = 0;        // pieces found by searching
+  uint64_t unresolved = 0;    // registered with an object not found
+  uint64_t damaged = 0;       // documents with objects failing the streaming pass
+  uint64_t orphans = 0;       // headers no end of file was found for
+  uint64_t embedded = 0;      // headers off a sector boundary, or inside a document
+};
+
+class PdfCarveStage : public CarveStage
+{
+public:
+  explicit PdfCarveStage(PdfCarveOptions options = PdfCarveOptions()) : options_(options) {}
+
+  const char* name() const override { return "pdf"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  void finish(CarveContext& ctx) override;
+  bool defersValidation() const override { return true; }
+  uint64_t acceptedHits(uint32_t tag) const override { return tag < 2 ? accepted_[tag] : 0; }
+
+  /// Valid once the pipeline has finished.
+  const PdfCarveStats& stats() const { return stats_; }
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_HEADER,
+    TAG_EOF,
+  };
+
+  PdfCarveOptions options_;
+  std::mutex mutex_;
+  std::vector<uint64_t> headers_;  // "%PDF-" offsets
+  std::vector<uint64_t> ends_;     // "%%EOF" offsets
+  PdfCarveStats stats_;
+  uint64_t accepted_[2] = {};  // hits of each tag `finish` made use of
+};
+
+}  // namespace rsn
@@ -0,0 +1,140 @@
+// RecoverySoftNetz — fragment map for structural carvers
+
+#include "carving/piece_map.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace rsn
+{
+
+uint64_t PieceMap::device(uint64_t file) const
+{
+  auto it = std::prev(pieces_.upper_bound(file));
+  return it->second + (file - it->first);
+}
+
+uint64_t PieceMap::pieceStart(uint64_t file) const
+{
+  return std::prev(pieces_.upper_bound(file))->first;
+}
+
+uint64_t PieceMap::nextStart(uint64_t file) const
+{
+  auto it = pieces_.upper_bound(file);
+  return it == pieces_.end() ? UINT64_MAX : it->first;
+}
+
+std::vector<Extent> PieceMap::extents(uint64_t size) const
+{
+  std::vector<Extent> out;
+  for (auto it = pieces_.begin(); it != pieces_.end() && it->first < size; ++it)
+  {
+    auto next = std::next(it);
+    uint64_t end = next == pieces_.end() ? size : std::min(next->first, size);
+    Extent extent{it->second, end - it->first};
+    if (!out.empty() && out.back().offset + out.back().length == extent.offset)
+    {
+      out.back().length += extent.length;
+    }
+    else
+    {
+      out.push_back(extent);
+    }
+  }
+  if (out.size() == 1)
+  {
+    out.clear();
+  }
+  return out;
+}
+
+bool DeviceWindow::get(uint64_t offset, uint8_t* out, size_t length, bool backward)
+{
+  if (length > size_)
+  {
+    return device_.read(offset, out, length) == length;
+  }
+  Buffer* hit = nullptr;
+  for (Buffer& buffer : buffers_)
+  {
+    if (offset >= buffer.start && offset + length <= buffer.start + buffer.valid)
+    {
+      hit = &buffer;
+    }
+  }
+  if (hit == nullptr)
+  {
+    hit = &buffers_[backward ? 1 : 0];
+    hit->data.resize(size_);
+    hit->start = backward && offset + length > size_ ? offset + length - size_ : offset;
+    hit->valid = device_.read(hit->start, hit->data.data(), size_);
+    if (offset + length > hit->start + hit->valid)
+    {
+      return false;
+    }
+  }
+  std::memcpy(out, hit->data.data() + (offset - hit->start), length);
+  return true;
+}
+
+bool DeviceWindow::get(const PieceMap& map, uint64_t file, uint8_t* out, size_t length,
+                       bool backward)
+{
+  while (length != 0)
+  {
+    size_t take = static_cast<size_t>(std::min<uint64_t>(length, map.nextStart(file) - file));
+    if (!get(map.device(file), out, take, backward))
+    {
+      return false;
+    }
+    file += take;
+    out += take;
+    length -= take;
+  }
+  return true;
+}
+
+bool findPiece(PieceMap& map, uint64_t file, const PieceSearch& search, uint64_t device_size,
+               const std::function<bool(bool backward)>& fits)
+{
+  uint64_t expected = map.device(file);
+  bool existed = map.pieceStart(file) == file;
+  for (uint64_t step = search.block; step <= search.distance; step += search.block)
+  {
+    bool ahead = expected + step < device_size;
+    bool behind = step <= expected;
+    if (!ahead && !behind)
+    {
+      break;
+    }
+    if (ahead)
+    {
+      map.add(file, expected + step);
+      if (fits(false))
+      {
+        return true;
+      }
+    }
+    if (behind)
+    {
+      map.add(file, expected - step);
+      if (fits(true))
+      {
+        return true;
+      }
+    }
+  }
+  if (existed)
+  {
+    map.add(file, expected);
+  }
+  else
+  {
+    map.remove(file);
+  }
+  return false;
+}
+
+}  // namespace rsn
@@ -0,0 +1,91 @@
+// RecoverySoftNetz — fragment map for structural carvers
+//
+// A carver that knows where parts of a file must be (sample tables, sector
+// allocation tables, central directories) checks those parts where the
+// current map puts them. When one does not check out, the file was
+// fragmented: the piece holding it is looked for at allocation-unit
+// granularity around the position the map predicted, and accepted where the
+// carver's own checks pass. Pieces are keyed by file offset; each runs until
+// the next one starts.
+
+#pragma once
+
+#include "core/device.h"
+#include "core/file_registry.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace rsn
+{
+
+class PieceMap
+{
+public:
+  explicit PieceMap(uint64_t start) { pieces_[0] = start; }
+
+  /// Device offset of the file byte at `file`.
+  uint64_t device(uint64_t file) const;
+
+  /// File offset where the piece holding `file` starts, and where the next
+  /// one does (UINT64_MAX for the last piece).
+  uint64_t pieceStart(uint64_t file) const;
+  uint64_t nextStart(uint64_t file) const;
+
+  void add(uint64_t file, uint64_t device) { pieces_[file] = device; }
+  void remove(uint64_t file) { pieces_.erase(file); }
+  size_t count() const { return pieces_.size(); }
+
+  /// Device extents of the first `size` bytes, adjacent pieces coalesced.
+  /// Empty when the file is contiguous.
+  std::vector<Extent> extents(uint64_t size) const;
+
+private:
+  std::map<uint64_t, uint64_t> pieces_;  // file offset -> device offset
+};
+
+/// Buffered device reads for checks that step through a device region, one
+/// window for each direction; a miss loads the window starting at the
+/// requested offset, or the backward one ending at it.
+class DeviceWindow
+{
+public:
+  explicit DeviceWindow(Device& device, size_t size = 1u << 20) : device_(device), size_(size) {}
+
+  bool get(uint64_t offset, uint8_t* out, size_t length, bool backward = false);
+
+  /// Read through `map` from file offset `file`, across piece boundaries.
+  bool get(const PieceMap& map, uint64_t file, uint8_t* out, size_t length,
+           bool backward = false);
+
+private:
+  struct Buffer
+  {
+    std::vector<uint8_t> data;
+    uint64_t start = 0;
+    size_t valid = 0;
+  };
+
+  Device& device_;
+  size_t size_;
+  Buffer buffers_[2];  // forward, backward
+};
+
+struct PieceSearch
+{
+  uint64_t block = 512;             // allocation unit; pieces start on its multiples
+  uint64_t distance = 256ull << 20;  // how far from the predicted position to look, each way
+};
+
+/// Find where the piece starting at file offset `file` is stored. Device
+/// positions a whole number of blocks away from where the map predicts are
+/// tried, nearest first and forward before backward at equal distance; `fits`
+/// checks the map with the candidate added. True with the piece left in
+/// `map`; otherwise the map is as it was.
+bool findPiece(PieceMap& map, uint64_t file, const PieceSearch& search, uint64_t device_size,
+               const std::function<bool(bool backward)>& fits);
+
+}  // namespace rsn
@@ -0,0 +1,192 @@
+// RecoverySoftNetz — carve stage for user-defined signatures
+
+#include "carving/signature_carver.h"
+
+#include <algorithm>
+#include <string>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr double CONFIDENCE_VERIFIED = 0.95;  // sized, and the footer ends the file
+constexpr double CONFIDENCE_BOUNDED = 0.85;   // sized, or ended by a footer
+constexpr double CONFIDENCE_AMBIGUOUS = 0.6;  // sized, but the footer is not at the end
+constexpr double CONFIDENCE_OPEN = 0.4;       // no end marked
+
+}  // namespace
+
+void SignatureCarveStage::registerPatterns(PatternSet& patterns)
+{
+  // Tags are the type index and a footer bit. Sized types check their
+  // footer in place, so only the others look for it.
+  for (size_t i = 0; i < db_.size(); ++i)
+  {
+    const SignatureType& type = db_.type(i);
+    auto tag = static_cast<uint32_t>(i << 1);
+    patterns.add(db_.bytes(type.anchor), type.anchor_length, tag);
+    if (type.footer_length != 0 && !type.sized)
+    {
+      patterns.add(db_.bytes(type.footer + type.footer_anchor), type.footer_anchor_length,
+                   tag | 1);
+    }
+  }
+}
+
+bool SignatureCarveStage::keep(std::vector<Mark>& marks, Mark mark)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (starts_.size() + ends_.size() >= options_.max_marks)
+  {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  marks.push_back(mark);
+  return true;
+}
+
+bool SignatureCarveStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk,
+                                CarveContext& ctx)
+{
+  uint32_t index = tag >> 1;
+  const SignatureType& type = db_.type(index);
+  uint64_t offset = chunk.offset + pos;
+  Device& device = ctx.device();
+  RuleInput input;
+  input.device = &device;
+  input.data = chunk.data;
+  input.size = chunk.size;
+  input.offset = chunk.offset;
+  uint8_t buffer[SIGNATURE_MAX_PATTERN];
+
+  if ((tag & 1) != 0)
+  {
+    if (offset < type.footer_anchor)
+    {
+      return false;
+    }
+    uint64_t footer = offset - type.footer_anchor;
+    if (!input.read(footer, buffer, type.footer_length) ||
+        !db_.matches(type.footer, type.footer_length, buffer))
+    {
+      return false;
+    }
+    return keep(ends_, {index, footer + type.footer_length + type.tail});
+  }
+
+  uint32_t align = type.align != 0 ? type.align : device.sectorSize();
+  uint64_t size = 0;
+  if (offset < type.anchor_at || (offset - type.anchor_at) % align != 0)
+  {
+    return false;
+  }
+  uint64_t start = offset - type.anchor_at;
+  if (!db_.evaluate(type, input, start, size))
+  {
+    return false;
+  }
+  if (!type.sized)
+  {
+    return keep(starts_, {index, start});
+  }
+  if (size == 0 || size < type.min_size || size > type.max_size || start >= device.size() ||
+      size > device.size() - start)
+  {
+    return false;
+  }
+
+  RecoveredFile file;
+  file.type = type.type;
+  file.source = name();
+  file.offset = start;
+  file.size = size;
+  file.confidence = CONFIDENCE_BOUNDED;
+  file.description = type.name + ", size from header";
+  if (type.footer_length != 0)
+  {
+    uint64_t trailer = uint64_t(type.footer_length) + type.tail;
+    if (size >= trailer && input.read(start + size - trailer, buffer, type.footer_length) &&
+        db_.matches(type.footer, type.footer_length, buffer))
+    {
+      file.confidence = CONFIDENCE_VERIFIED;
+      file.description += ", footer in place";
+    }
+    else
+    {
+      file.confidence = CONFIDENCE_AMBIGUOUS;
+      file.description += ", footer not at the end";
+      mismatched_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  ctx.registry().add(std::move(file));
+  sized_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void SignatureCarveStage::finish(CarveContext& ctx)
+{
+  stats_ = SignatureCarveStats();
+  stats_.sized = sized_.load();
+  stats_.mismatched = mismatched_.load();
+  stats_.dropped = dropped_.load();
+  std::sort(starts_.begin(), starts_.end());
+  std::sort(ends_.begin(), ends_.end());
+  uint64_t device_size = ctx.device().size();
+
+  for (size_t i = 0; i < starts_.size(); ++i)
+  {
+    const Mark& start = starts_[i];
+    const SignatureType& type = db_.type(start.type);
+    if (start.offset >= device_size)
+    {
+      continue;
+    }
+    uint64_t limit = std::min(type.max_size, device_size - start.offset);
+    uint64_t end = 0;
+    RecoveredFile file;
+    if (type.footer_length != 0)
+    {
+      // The first footer past the header and `min-size`.
+      uint64_t least = std::max<uint64_t>({type.min_size, type.anchor_at + type.anchor_length,
+                                           uint64_t(type.footer_length) + type.tail});
+      Mark first{start.type, start.offset + least};
+      auto it = std::lower_bound(ends_.begin(), ends_.end(), first);
+      if (it == ends_.end() || it->type != start.type || it->offset - start.offset > limit)
+      {
+        ++stats_.orphans;
+        continue;
+      }
+      end = it->offset;
+      file.confidence = CONFIDENCE_BOUNDED;
+      file.description = type.name + ", ended by footer";
+      ++stats_.terminated;
+    }
+    else
+    {
+      end = start.offset + limit;
+      if (i + 1 < starts_.size() && starts_[i + 1].type == start.type)
+      {
+        end = std::min(end, starts_[i + 1].offset);
+      }
+      if (end - start.offset < std::max<uint64_t>(type.min_size, 1))
+      {
+        continue;
+      }
+      file.confidence = CONFIDENCE_OPEN;
+      file.description = type.name + ", end not marked";
+      ++stats_.open;
+    }
+    file.type = type.type;
+    file.source = name();
+    file.offset = start.offset;
+    file.size = end - start.offset;
+    ctx.registry().add(std::move(file));
+  }
+  stats_.files = stats_.sized + stats_.terminated + stats_.open;
+  starts_.clear();
+  ends_.clear();
+}
+
+}  // namespace rsn
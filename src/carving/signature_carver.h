@@ -0,0 +1,85 @@
+// RecoverySoftNetz — carve stage for user-defined signatures
+//
+// Carves the types of a SignatureDB (signature_db). Every header hit runs its
+// type's program; a type whose program yields a size is registered there and
+// then, its footer (when it has one) checked at the end. Other types are
+// resolved in `finish`: a type with a footer ends at the first footer of the
+// type past `min-size`, within `max-size`, and is dropped when there is none;
+// a type with neither ends at the next header of the type, or at `max-size`,
+// and is registered at low confidence. Files are assumed contiguous.
+
+#pragma once
+
+#include "carving/signature_db.h"
+#include "core/carve_pipeline.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rsn
+{
+
+struct SignatureCarveOptions
+{
+  size_t max_marks = 4u << 20;  // header and footer offsets kept for `finish`
+};
+
+struct SignatureCarveStats
+{
+  uint64_t files = 0;
+  uint64_t sized = 0;       // sized by a header field
+  uint64_t terminated = 0;  // ended by a footer
+  uint64_t open = 0;        // ended by the next header, or `max-size`
+  uint64_t mismatched = 0;  // sized, with the footer not at the end
+  uint64_t orphans = 0;     // headers no footer was found for
+  uint64_t dropped = 0;     // offsets not kept past `max_marks`
+};
+
+class SignatureCarveStage : public CarveStage
+{
+public:
+  /// `db` must outlive the pipeline run.
+  explicit SignatureCarveStage(const SignatureDB& db,
+                               SignatureCarveOptions options = SignatureCarveOptions())
+    : db_(db), options_(options)
+  {
+  }
+
+  const char* name() const override { return "signatures"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  size_t lookahead() const override { return SIGNATURE_MAX_PATTERN; }
+  void finish(CarveContext& ctx) override;
+
+  /// Valid once the pipeline has finished.
+  const SignatureCarveStats& stats() const { return stats_; }
+
+private:
+  struct Mark
+  {
+    uint32_t type;
+    uint64_t offset;  // file start, or one past the end of a footer
+
+    bool operator<(const Mark& other) const
+    {
+      return type != other.type ? type < other.type : offset < other.offset;
+    }
+  };
+
+  bool keep(std::vector<Mark>& marks, Mark mark);
+
+  const SignatureDB& db_;
+  SignatureCarveOptions options_;
+  std::mutex mutex_;
+  std::vector<Mark> starts_;
+  std::vector<Mark> ends_;
+  std::atomic<uint64_t> sized_{0};
+  std::atomic<uint64_t> mismatched_{0};
+  std::atomic<uint64_t> dropped_{0};
+  SignatureCarveStats stats_;
+};
+
+}  // namespace rsn
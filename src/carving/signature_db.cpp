@@ -0,0 +1,729 @@
+// RecoverySoftNetz — user-defined carving signatures
+
+#include "carving/signature_db.h"
+
+#include "common/utils.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace rsn
+{
+
+namespace
+{
+
+const char MAGIC[] = "rsn-signatures 1";
+constexpr size_t MIN_ANCHOR = 2;  // shorter literals flood the matcher
+
+enum Op : uint8_t
+{
+  OP_LOAD,      // value = field at operand
+  OP_LOAD_AT,   // value = field at value + operand
+  OP_AND,
+  OP_MUL,
+  OP_ADD,
+  OP_TEST,      // reject unless value <kind> operand
+  OP_BYTES,     // reject unless the pattern sits at operand
+  OP_BYTES_AT,  // ... at value + operand
+  OP_SIZE,      // size = value
+};
+
+enum Field : uint8_t
+{
+  FIELD_U8,
+  FIELD_U16LE,
+  FIELD_U16BE,
+  FIELD_U32LE,
+  FIELD_U32BE,
+  FIELD_U64LE,
+  FIELD_U64BE,
+};
+
+enum Compare : uint8_t
+{
+  CMP_EQ,
+  CMP_NE,
+  CMP_LT,
+  CMP_LE,
+  CMP_GT,
+  CMP_GE,
+};
+
+const char* const FIELD_NAMES[] = {"u8", "u16le", "u16be", "u32le", "u32be", "u64le", "u64be"};
+const char* const COMPARE_NAMES[] = {"==", "!=", "<", "<=", ">", ">="};
+
+size_t fieldWidth(uint8_t kind)
+{
+  return kind == FIELD_U8 ? 1 : kind <= FIELD_U16BE ? 2 : kind <= FIELD_U32BE ? 4 : 8;
+}
+
+uint64_t loadField(uint8_t kind, const uint8_t* p)
+{
+  switch (kind)
+  {
+    case FIELD_U16LE:
+      return loadLE16(p);
+    case FIELD_U16BE:
+      return loadBE16(p);
+    case FIELD_U32LE:
+      return loadLE32(p);
+    case FIELD_U32BE:
+      return loadBE32(p);
+    case FIELD_U64LE:
+      return loadLE64(p);
+    case FIELD_U64BE:
+      return loadBE64(p);
+    default:
+      return p[0];
+  }
+}
+
+bool compare(uint8_t kind, uint64_t a, uint64_t b)
+{
+  switch (kind)
+  {
+    case CMP_EQ:
+      return a == b;
+    case CMP_NE:
+      return a != b;
+    case CMP_LT:
+      return a < b;
+    case CMP_LE:
+      return a <= b;
+    case CMP_GT:
+      return a > b;
+    default:
+      return a >= b;
+  }
+}
+
+int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/// A run of characters within a line.
+struct Token
+{
+  const char* begin = nullptr;
+  const char* end = nullptr;
+
+  bool empty() const { return begin == end; }
+  size_t size() const { return static_cast<size_t>(end - begin); }
+  bool is(const char* word) const
+  {
+    return std::strlen(word) == size() && std::memcmp(word, begin, size()) == 0;
+  }
+};
+
+/// Parse a number at the front of `s`: decimal or 0x hex, with an optional
+/// K, M or G suffix.
+bool takeNumber(Token& s, uint64_t& out)
+{
+  const char* p = s.begin;
+  unsigned base = 10;
+  if (s.end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+  {
+    base = 16;
+    p += 2;
+  }
+  const char* digits = p;
+  out = 0;
+  for (; p != s.end; ++p)
+  {
+    int digit = hexValue(*p);
+    if (digit < 0 || static_cast<unsigned>(digit) >= base)
+    {
+      break;
+    }
+    if (out > (UINT64_MAX - static_cast<uint64_t>(digit)) / base)
+    {
+      return false;
+    }
+    out = out * base + static_cast<uint64_t>(digit);
+  }
+  if (p == digits)
+  {
+    return false;
+  }
+  if (p != s.end && (*p == 'K' || *p == 'M' || *p == 'G'))
+  {
+    unsigned shift = *p == 'K' ? 10 : *p == 'M' ? 20 : 30;
+    if (out > UINT64_MAX >> shift)
+    {
+      return false;
+    }
+    out <<= shift;
+    ++p;
+  }
+  s.begin = p;
+  return true;
+}
+
+bool parseNumber(Token s, uint64_t& out)
+{
+  return takeNumber(s, out) && s.empty();
+}
+
+}  // namespace
+
+/// Parses one file into a SignatureDB, a line at a time. The definition
+/// being read is kept apart until the next `type` line closes it.
+class SignatureParser
+{
+public:
+  explicit SignatureParser(SignatureDB& db) : db_(db) {}
+
+  bool line(const char* begin, const char* end);
+  bool close();
+
+private:
+  Token next();
+  bool pattern(Token& word, uint32_t& pool, uint32_t& length);
+  bool field(Token& s, std::vector<SignatureDB::RuleOp>& ops);
+  bool offset(Token& s, std::vector<SignatureDB::RuleOp>& ops, bool& indirect, uint64_t& at);
+  bool check();
+  bool size();
+
+  SignatureDB& db_;
+  const char* cursor_ = nullptr;
+  const char* end_ = nullptr;
+
+  bool open_ = false;
+  SignatureType type_;
+  bool has_header_ = false;
+  SignatureDB::RuleOp header_{};
+  std::vector<SignatureDB::RuleOp> ops_;
+};
+
+Token SignatureParser::next()
+{
+  while (cursor_ != end_ && (*cursor_ == ' ' || *cursor_ == '\t' || *cursor_ == '\r'))
+  {
+    ++cursor_;
+  }
+  Token token{cursor_, cursor_};
+  if (cursor_ == end_ || *cursor_ == '#')
+  {
+    cursor_ = end_;
+    return token;
+  }
+  if (*cursor_ == '"')
+  {
+    const char* close = static_cast<const char*>(
+      std::memchr(cursor_ + 1, '"', static_cast<size_t>(end_ - cursor_ - 1)));
+    cursor_ = close != nullptr ? close + 1 : end_;
+  }
+  else
+  {
+    while (cursor_ != end_ && *cursor_ != ' ' && *cursor_ != '\t' && *cursor_ != '\r')
+    {
+      ++cursor_;
+    }
+  }
+  token.end = cursor_;
+  return token;
+}
+
+/// Read byte tokens, starting with `word`, into the pattern pool: quoted text,
+/// or hex pairs in which either digit may be '?'. Leaves the first token that
+/// is neither in `word`.
+bool SignatureParser::pattern(Token& word, uint32_t& pool, uint32_t& length)
+{
+  pool = static_cast<uint32_t>(db_.bytes_.size());
+  for (; !word.empty(); word = next())
+  {
+    if (*word.begin == '"')
+    {
+      if (word.size() < 2 || word.end[-1] != '"')
+      {
+        return false;
+      }
+      for (const char* p = word.begin + 1; p != word.end - 1; ++p)
+      {
+        db_.bytes_.push_back(static_cast<uint8_t>(*p));
+        db_.masks_.push_back(0xFF);
+      }
+      continue;
+    }
+    if (word.size() % 2 != 0)
+    {
+      break;
+    }
+    const char* p = word.begin;
+    for (; p != word.end; p += 2)
+    {
+      int high = hexValue(p[0]);
+      int low = hexValue(p[1]);
+      if ((high < 0 && p[0] != '?') || (low < 0 && p[1] != '?'))
+      {
+        break;
+      }
+      int value = ((high < 0 ? 0 : high) << 4) | (low < 0 ? 0 : low);
+      db_.bytes_.push_back(static_cast<uint8_t>(value));
+      db_.masks_.push_back(static_cast<uint8_t>((high < 0 ? 0 : 0xF0) | (low < 0 ? 0 : 0x0F)));
+    }
+    if (p != word.end)
+    {
+      if (p != word.begin)
+      {
+        return false;
+      }
+      break;
+    }
+  }
+  length = static_cast<uint32_t>(db_.bytes_.size() - pool);
+  return length != 0 && length <= SIGNATURE_MAX_PATTERN;
+}
+
+/// `<kind>@<offset>`: emit the loads that leave the field in the value register.
+bool SignatureParser::field(Token& s, std::vector<SignatureDB::RuleOp>& ops)
+{
+  const char* at = static_cast<const char*>(std::memchr(s.begin, '@', s.size()));
+  if (at == nullptr)
+  {
+    return false;
+  }
+  Token name{s.begin, at};
+  uint8_t kind = 0;
+  while (kind < sizeof(FIELD_NAMES) / sizeof(FIELD_NAMES[0]) && !name.is(FIELD_NAMES[kind]))
+  {
+    ++kind;
+  }
+  if (kind == sizeof(FIELD_NAMES) / sizeof(FIELD_NAMES[0]))
+  {
+    return false;
+  }
+  s.begin = at + 1;
+  bool indirect = false;
+  uint64_t where = 0;
+  if (!offset(s, ops, indirect, where))
+  {
+    return false;
+  }
+  ops.push_back({indirect ? OP_LOAD_AT : OP_LOAD, kind, 0, 0, where});
+  return true;
+}
+
+/// A number, or `[<field>]` optionally followed by `+<number>`; the field's
+/// loads are emitted and `indirect` set.
+bool SignatureParser::offset(Token& s, std::vector<SignatureDB::RuleOp>& ops, bool& indirect,
+                             uint64_t& at)
+{
+  at = 0;
+  indirect = !s.empty() && *s.begin == '[';
+  if (!indirect)
+  {
+    return takeNumber(s, at);
+  }
+  ++s.begin;
+  if (!field(s, ops) || s.empty() || *s.begin != ']')
+  {
+    return false;
+  }
+  ++s.begin;
+  if (!s.empty() && *s.begin == '+')
+  {
+    ++s.begin;
+    return takeNumber(s, at);
+  }
+  return true;
+}
+
+/// `check <field> [mask <n>] <op> <n>` or `check bytes@<offset> <pattern>`.
+bool SignatureParser::check()
+{
+  Token s = next();
+  if (s.size() > 6 && std::memcmp(s.begin, "bytes@", 6) == 0)
+  {
+    s.begin += 6;
+    bool indirect = false;
+    uint64_t at = 0;
+    std::vector<SignatureDB::RuleOp> ops;
+    Token word = next();
+    uint32_t pool = 0;
+    uint32_t length = 0;
+    if (!offset(s, ops, indirect, at) || !s.empty() || !pattern(word, pool, length) ||
+        !word.empty())
+    {
+      return false;
+    }
+    ops.push_back({indirect ? OP_BYTES_AT : OP_BYTES, 0, static_cast<uint16_t>(length), pool, at});
+    ops_.insert(ops_.end(), ops.begin(), ops.end());
+    return true;
+  }
+  if (!field(s, ops_) || !s.empty())
+  {
+    return false;
+  }
+  Token word = next();
+  uint64_t value = 0;
+  if (word.is("mask"))
+  {
+    if (!parseNumber(next(), value))
+    {
+      return false;
+    }
+    ops_.push_back({OP_AND, 0, 0, 0, value});
+    word = next();
+  }
+  uint8_t kind = 0;
+  while (kind < sizeof(COMPARE_NAMES) / sizeof(COMPARE_NAMES[0]) && !word.is(COMPARE_NAMES[kind]))
+  {
+    ++kind;
+  }
+  if (kind == sizeof(COMPARE_NAMES) / sizeof(COMPARE_NAMES[0]) || !parseNumber(next(), value))
+  {
+    return false;
+  }
+  ops_.push_back({OP_TEST, kind, 0, 0, value});
+  return next().empty();
+}
+
+/// `size <field> [scale <n>] [add <n>]`.
+bool SignatureParser::size()
+{
+  Token s = next();
+  if (type_.sized || !field(s, ops_) || !s.empty())
+  {
+    return false;
+  }
+  Token word = next();
+  uint64_t value = 0;
+  if (word.is("scale"))
+  {
+    if (!parseNumber(next(), value))
+    {
+      return false;
+    }
+    ops_.push_back({OP_MUL, 0, 0, 0, value});
+    word = next();
+  }
+  if (word.is("add"))
+  {
+    if (!parseNumber(next(), value))
+    {
+      return false;
+    }
+    ops_.push_back({OP_ADD, 0, 0, 0, value});
+    word = next();
+  }
+  ops_.push_back({OP_SIZE, 0, 0, 0, 0});
+  type_.sized = true;
+  return word.empty();
+}
+
+bool SignatureParser::line(const char* begin, const char* end)
+{
+  cursor_ = begin;
+  end_ = end;
+  Token keyword = next();
+  if (keyword.empty())
+  {
+    return true;
+  }
+  if (keyword.is("type"))
+  {
+    Token name = next();
+    Token type = next();
+    if (!close() || name.empty() || type.empty() || !next().empty())
+    {
+      return false;
+    }
+    open_ = true;
+    type_ = SignatureType();
+    type_.name.assign(name.begin, name.end);
+    type_.type.assign(type.begin, type.end);
+    has_header_ = false;
+    ops_.clear();
+    return true;
+  }
+  if (!open_)
+  {
+    return false;
+  }
+  uint64_t value = 0;
+  if (keyword.is("header") || keyword.is("footer"))
+  {
+    bool header = keyword.is("header");
+    Token word = next();
+    uint32_t pool = 0;
+    uint32_t length = 0;
+    if ((header ? has_header_ : type_.footer_length != 0) || !pattern(word, pool, length))
+    {
+      return false;
+    }
+    if (!word.empty())
+    {
+      if (!word.is(header ? "at" : "tail") || !parseNumber(next(), value))
+      {
+        return false;
+      }
+    }
+    if (header)
+    {
+      header_ = {OP_BYTES, 0, static_cast<uint16_t>(length), pool, value};
+      has_header_ = true;
+    }
+    else
+    {
+      type_.footer = pool;
+      type_.footer_length = length;
+      type_.tail = value;
+    }
+  }
+  else if (keyword.is("size"))
+  {
+    return size();
+  }
+  else if (keyword.is("check"))
+  {
+    return check();
+  }
+  else if (keyword.is("min-size") || keyword.is("max-size"))
+  {
+    if (!parseNumber(next(), value))
+    {
+      return false;
+    }
+    (keyword.is("min-size") ? type_.min_size : type_.max_size) = value;
+  }
+  else if (keyword.is("align"))
+  {
+    Token word = next();
+    if (word.is("sector"))
+    {
+      value = 0;
+    }
+    else if (!parseNumber(word, value) || value == 0 || value > UINT32_MAX)
+    {
+      return false;
+    }
+    type_.align = static_cast<uint32_t>(value);
+  }
+  else
+  {
+    return false;
+  }
+  return next().empty();
+}
+
+/// Finish the open definition: pick the literals the matcher looks for and
+/// lay the program out with the header check first.
+bool SignatureParser::close()
+{
+  if (!open_)
+  {
+    return true;
+  }
+  open_ = false;
+  if (!has_header_ || type_.max_size == 0 || type_.min_size > type_.max_size)
+  {
+    return false;
+  }
+  // The longest run of fixed bytes; the first at equal length.
+  auto anchor = [&](uint32_t pool, uint32_t length, uint32_t& at, uint32_t& run)
+  {
+    at = 0;
+    run = 0;
+    for (uint32_t i = 0; i < length;)
+    {
+      uint32_t j = i;
+      while (j < length && db_.masks_[pool + j] == 0xFF)
+      {
+        ++j;
+      }
+      if (j - i > run)
+      {
+        at = i;
+        run = j - i;
+      }
+      i = j + 1;
+    }
+    return run >= MIN_ANCHOR;
+  };
+  uint32_t at = 0;
+  if (!anchor(header_.pool, header_.length, at, type_.anchor_length) ||
+      (type_.footer_length != 0 &&
+       !anchor(type_.footer, type_.footer_length, type_.footer_anchor,
+               type_.footer_anchor_length)))
+  {
+    return false;
+  }
+  type_.anchor = header_.pool + at;
+  type_.anchor_at = header_.operand + at;
+  type_.code = static_cast<uint32_t>(db_.code_.size());
+  db_.code_.push_back(header_);
+  db_.code_.insert(db_.code_.end(), ops_.begin(), ops_.end());
+  type_.code_end = static_cast<uint32_t>(db_.code_.size());
+  db_.types_.push_back(std::move(type_));
+  return true;
+}
+
+bool RuleInput::read(uint64_t at, uint8_t* out, size_t length) const
+{
+  if (at >= offset && at - offset <= size && length <= size - (at - offset))
+  {
+    std::memcpy(out, data + (at - offset), length);
+    return true;
+  }
+  return device != nullptr && device->read(at, out, length) == length;
+}
+
+std::unique_ptr<SignatureDB> SignatureDB::parse(const char* text, size_t size, size_t* error_line)
+{
+  std::unique_ptr<SignatureDB> db(new SignatureDB());
+  SignatureParser parser(*db);
+  const char* end = text + size;
+  size_t number = 0;
+  for (const char* p = text; p != end; ++number)
+  {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+    const char* stop = eol != nullptr ? eol : end;
+    bool ok;
+    if (number == 0)
+    {
+      const char* trimmed = stop;
+      while (trimmed != p && (trimmed[-1] == '\r' || trimmed[-1] == ' '))
+      {
+        --trimmed;
+      }
+      ok = static_cast<size_t>(trimmed - p) == sizeof(MAGIC) - 1 &&
+           std::memcmp(p, MAGIC, sizeof(MAGIC) - 1) == 0;
+    }
+    else
+    {
+      ok = parser.line(p, stop);
+    }
+    if (!ok)
+    {
+      if (error_line != nullptr)
+      {
+        *error_line = number + 1;
+      }
+      return nullptr;
+    }
+    p = eol != nullptr ? eol + 1 : end;
+  }
+  if (number == 0 || !parser.close())
+  {
+    if (error_line != nullptr)
+    {
+      *error_line = number;
+    }
+    return nullptr;
+  }
+  return db;
+}
+
+std::unique_ptr<SignatureDB> SignatureDB::load(const std::string& path, size_t* error_line)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+  {
+    return nullptr;
+  }
+  std::ostringstream text;
+  text << in.rdbuf();
+  std::string content = text.str();
+  return parse(content.data(), content.size(), error_line);
+}
+
+bool SignatureDB::matches(uint32_t pool, size_t length, const uint8_t* data) const
+{
+  const uint8_t* bytes = bytes_.data() + pool;
+  const uint8_t* masks = masks_.data() + pool;
+  for (size_t i = 0; i < length; ++i)
+  {
+    if ((data[i] & masks[i]) != bytes[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SignatureDB::evaluate(const SignatureType& type, const RuleInput& input, uint64_t start,
+                           uint64_t& size) const
+{
+  uint8_t buffer[SIGNATURE_MAX_PATTERN];
+  uint64_t value = 0;
+  size = 0;
+  for (uint32_t pc = type.code; pc < type.code_end; ++pc)
+  {
+    const RuleOp& op = code_[pc];
+    switch (op.code)
+    {
+      case OP_LOAD:
+      case OP_LOAD_AT:
+      case OP_BYTES:
+      case OP_BYTES_AT:
+      {
+        // Fields are read inside the largest file the type allows.
+        uint64_t base = op.code == OP_LOAD_AT || op.code == OP_BYTES_AT ? value : 0;
+        if (op.operand >= type.max_size || base >= type.max_size - op.operand)
+        {
+          return false;
+        }
+        bool load = op.code == OP_LOAD || op.code == OP_LOAD_AT;
+        size_t length = load ? fieldWidth(op.kind) : op.length;
+        if (!input.read(start + base + op.operand, buffer, length))
+        {
+          return false;
+        }
+        if (load)
+        {
+          value = loadField(op.kind, buffer);
+        }
+        else if (!matches(op.pool, length, buffer))
+        {
+          return false;
+        }
+        break;
+      }
+      case OP_AND:
+        value &= op.operand;
+        break;
+      case OP_MUL:
+        if (op.operand != 0 && value > UINT64_MAX / op.operand)
+        {
+          return false;
+        }
+        value *= op.operand;
+        break;
+      case OP_ADD:
+        if (value > UINT64_MAX - op.operand)
+        {
+          return false;
+        }
+        value += op.operand;
+        break;
+      case OP_TEST:
+        if (!compare(op.kind, value, op.operand))
+        {
+          return false;
+        }
+        break;
+      default:
+        size = value;
+        break;
+    }
+  }
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,124 @@
+// RecoverySoftNetz — user-defined carving signatures
+//
+// Niche formats are described in a text file loaded at startup, so that
+// adding one does not need a rebuild:
+//
+//   rsn-signatures 1
+//   type pe-image executable/pe            # name, then "<family>/<format>"
+//   header "MZ" ?? ?? at 0                 # quoted text, or hex with ?? and nibble
+//                                          # ... wildcards (4?); `at` = file offset
+//   check u32le@60 < 0x1000                # ops: == != < <= > >=
+//   check bytes@[u32le@60] "PE" 00 00      # [field]+n: offset read from the file
+//   check u16le@[u32le@60]+4 mask 0xFFFF != 0
+//   max-size 256M                          # K, M and G suffixes; also min-size
+//   align sector                           # or a byte count; 1 = anywhere
+//
+//   type jpeg-thumb image/jpeg
+//   header FF D8 FF E?
+//   align 1
+//   footer FF D9 tail 0                    # the file ends `tail` bytes past it
+//
+//   type riff-wave audio/wav
+//   header "RIFF" ?? ?? ?? ?? "WAVE"
+//   size u32le@4 scale 1 add 8             # file size: field * scale + add
+//
+// A definition runs to the next `type` line and needs one header. Fields are
+// u8, u16le/be, u32le/be and u64le/be at an offset from the start of the file.
+// Each definition compiles to a short program of fixed-size instructions (the
+// header is its first check); the longest run of fixed header bytes, and of
+// footer bytes, is handed to the pipeline's matcher, and every hit runs the
+// program over the chunk in memory, reading the device only for fields
+// outside it. Evaluation allocates nothing.
+
+#pragma once
+
+#include "core/device.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// Byte patterns (header, footer, `check bytes`) are at most this long.
+constexpr size_t SIGNATURE_MAX_PATTERN = 64;
+
+struct SignatureType
+{
+  std::string name;
+  std::string type;             // RecoveredFile type
+  uint32_t anchor = 0;          // pattern pool offset of the literal the matcher looks for
+  uint32_t anchor_length = 0;
+  uint64_t anchor_at = 0;       // file offset of the anchor
+  uint32_t footer = 0;          // pattern pool offset of the footer
+  uint32_t footer_length = 0;   // 0 = no footer
+  uint32_t footer_anchor = 0;   // offset of the footer's literal within it
+  uint32_t footer_anchor_length = 0;
+  uint64_t tail = 0;            // bytes after the footer
+  uint64_t min_size = 0;
+  uint64_t max_size = 256ull << 20;
+  uint32_t align = 0;           // file start alignment; 0 = device sector size
+  bool sized = false;           // the program yields the file size
+  uint32_t code = 0;            // program: [code, code_end)
+  uint32_t code_end = 0;
+};
+
+/// The bytes a program runs over: a window of the device held in memory,
+/// with the device itself behind it.
+struct RuleInput
+{
+  Device* device = nullptr;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+  uint64_t offset = 0;  // device offset of data[0]
+
+  /// Copy [at, at + length) of the device; false when it cannot be read.
+  bool read(uint64_t at, uint8_t* out, size_t length) const;
+};
+
+class SignatureDB
+{
+public:
+  /// Parse definitions; nullptr on any syntax error, with the line number in
+  /// `error_line` when given.
+  static std::unique_ptr<SignatureDB> parse(const char* text, size_t size,
+                                            size_t* error_line = nullptr);
+  static std::unique_ptr<SignatureDB> load(const std::string& path, size_t* error_line = nullptr);
+
+  size_t size() const { return types_.size(); }
+  const SignatureType& type(size_t index) const { return types_[index]; }
+
+  /// Pattern pool bytes (wildcard positions hold zero).
+  const uint8_t* bytes(uint32_t pool) const { return bytes_.data() + pool; }
+
+  /// Whether `data` matches the pattern at `pool` under its mask.
+  bool matches(uint32_t pool, size_t length, const uint8_t* data) const;
+
+  /// Run the type's program on the file starting at `start`. Returns false
+  /// when a check fails or a field cannot be read; `size` is the size the
+  /// program computed, 0 when it computes none.
+  bool evaluate(const SignatureType& type, const RuleInput& input, uint64_t start,
+                uint64_t& size) const;
+
+private:
+  struct RuleOp
+  {
+    uint8_t code;
+    uint8_t kind;     // field kind, or comparison
+    uint16_t length;  // pattern length
+    uint32_t pool;    // pattern pool offset
+    uint64_t operand;
+  };
+
+  friend class SignatureParser;
+
+  std::vector<SignatureType> types_;
+  std::vector<RuleOp> code_;
+  std::vector<uint8_t> bytes_;
+  std::vector<uint8_t> masks_;
+};
+
+}  // namespace rsn
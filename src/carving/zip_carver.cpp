@@ -0,0 +1,860 @@
+// RecoverySoftNetz — ZIP family carve stage
+
+#include "carving/zip_carver.h"
+
+#include "carving/piece_map.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint32_t SIG_LOCAL = 0x04034B50;
+constexpr uint32_t SIG_CENTRAL = 0x02014B50;
+constexpr uint32_t SIG_END = 0x06054B50;
+constexpr uint32_t SIG_END64 = 0x06064B50;
+constexpr uint32_t SIG_LOCATOR = 0x07064B50;
+
+constexpr size_t LOCAL_SIZE = 30;
+constexpr size_t CENTRAL_SIZE = 46;
+constexpr size_t END_SIZE = 22;
+constexpr size_t END64_SIZE = 56;  // without extensible data
+constexpr size_t LOCATOR_SIZE = 20;
+
+constexpr uint16_t FLAG_DESCRIPTOR = 0x0008;  // sizes and CRC follow the data
+constexpr uint16_t EXTRA_ZIP64 = 0x0001;
+constexpr uint64_t MAX_MIMETYPE = 128;
+constexpr size_t MAX_SEGMENTS = 65536;  // segments of a split set held for assembly
+constexpr uint64_t MAX_CRC_WORK = 256ull << 20;  // bytes hashed to place one break
+constexpr size_t CRC_CHUNK = 64u << 10;
+
+constexpr double CONFIDENCE_VERIFIED = 0.95;     // every local header fits
+constexpr double CONFIDENCE_REASSEMBLED = 0.85;  // ... once the pieces were found
+constexpr double CONFIDENCE_AMBIGUOUS = 0.6;     // ... where a break falls between them is not
+constexpr double CONFIDENCE_UNRESOLVED = 0.4;    // a member, or a segment, was not found
+
+struct Member
+{
+  std::string name;
+  uint64_t offset = 0;  // of the local header, in the member's segment
+  uint64_t compressed = 0;
+  uint32_t crc = 0;
+  uint32_t disk = 0;
+  uint16_t flags = 0;
+  uint16_t method = 0;
+  bool zip64 = false;  // sizes in a ZIP64 extra field
+};
+
+/// What the end records and the central directory say.
+struct Directory
+{
+  uint32_t disk = 0;    // of the EOCD: the last segment of a set
+  uint64_t offset = 0;  // of the central directory, in the last segment
+  uint64_t device = 0;  // device offset of the central directory
+  uint64_t tail = 0;    // bytes from the central directory to the end of the archive
+  bool zip64 = false;
+  std::vector<Member> members;
+};
+
+/// Apply a ZIP64 extra field: 64-bit values for the fields saturated in the
+/// central directory entry, in the order the format lists them.
+bool readZip64(const uint8_t* extra, size_t length, uint64_t& size, uint64_t& compressed,
+               uint64_t& offset, uint32_t& disk)
+{
+  size_t pos = 0;
+  while (pos + 4 <= length)
+  {
+    uint16_t id = loadLE16(extra + pos);
+    size_t field = loadLE16(extra + pos + 2);
+    if (pos + 4 + field > length)
+    {
+      return false;
+    }
+    if (id == EXTRA_ZIP64)
+    {
+      const uint8_t* p = extra + pos + 4;
+      const uint8_t* end = p + field;
+      for (uint64_t* value : {&size, &compressed, &offset})
+      {
+        if (*value == 0xFFFFFFFF)
+        {
+          if (end - p < 8)
+          {
+            return false;
+          }
+          *value = loadLE64(p);
+          p += 8;
+        }
+      }
+      if (disk == 0xFFFF)
+      {
+        if (end - p < 4)
+        {
+          return false;
+        }
+        disk = loadLE32(p);
+      }
+      return true;
+    }
+    pos += 4 + field;
+  }
+  return true;
+}
+
+/// Read the end records at `end` and the central directory before them.
+bool readDirectory(Device& device, uint64_t end, const ZipCarveOptions& options,
+                   Directory& out)
+{
+  uint8_t record[END64_SIZE];
+  if (device.read(end, record, END_SIZE) != END_SIZE || loadLE32(record) != SIG_END)
+  {
+    return false;
+  }
+  uint64_t disk = loadLE16(record + 4);
+  uint64_t directory_disk = loadLE16(record + 6);
+  uint64_t on_disk = loadLE16(record + 8);
+  uint64_t total = loadLE16(record + 10);
+  uint64_t size = loadLE32(record + 12);
+  uint64_t offset = loadLE32(record + 16);
+  uint64_t comment = loadLE16(record + 20);
+  if (end + END_SIZE + comment > device.size())
+  {
+    return false;
+  }
+  bool saturated = disk == 0xFFFF || directory_disk == 0xFFFF || on_disk == 0xFFFF ||
+                   total == 0xFFFF || size == 0xFFFFFFFF || offset == 0xFFFFFFFF;
+
+  // The ZIP64 end record precedes its locator, which precedes the EOCD.
+  uint64_t directory_end = end;
+  out.zip64 = false;
+  if (end >= LOCATOR_SIZE + END64_SIZE)
+  {
+    uint8_t locator[LOCATOR_SIZE];
+    uint64_t at = end - LOCATOR_SIZE - END64_SIZE;
+    if (device.read(end - LOCATOR_SIZE, locator, LOCATOR_SIZE) == LOCATOR_SIZE &&
+        loadLE32(locator) == SIG_LOCATOR &&
+        device.read(at, record, END64_SIZE) == END64_SIZE && loadLE32(record) == SIG_END64 &&
+        loadLE64(record + 4) == END64_SIZE - 12)
+    {
+      disk = loadLE32(record + 16);
+      directory_disk = loadLE32(record + 20);
+      on_disk = loadLE64(record + 24);
+      total = loadLE64(record + 32);
+      size = loadLE64(record + 40);
+      offset = loadLE64(record + 48);
+      directory_end = at;
+      out.zip64 = true;
+    }
+  }
+  if ((saturated && !out.zip64) || on_disk != total || directory_disk != disk || total == 0 ||
+      size > options.max_directory_size || size > directory_end || total > size / CENTRAL_SIZE ||
+      offset + size > options.max_file_size)
+  {
+    // Only a central directory held whole by this segment is read.
+    return false;
+  }
+
+  std::vector<uint8_t> directory(static_cast<size_t>(size));
+  if (device.read(directory_end - size, directory.data(), directory.size()) != directory.size())
+  {
+    return false;
+  }
+  out.members.clear();
+  out.members.reserve(static_cast<size_t>(total));
+  size_t pos = 0;
+  for (uint64_t i = 0; i < total; ++i)
+  {
+    if (directory.size() - pos < CENTRAL_SIZE || loadLE32(&directory[pos]) != SIG_CENTRAL)
+    {
+      return false;
+    }
+    const uint8_t* entry = &directory[pos];
+    size_t name = loadLE16(entry + 28);
+    size_t extra = loadLE16(entry + 30);
+    size_t note = loadLE16(entry + 32);
+    if (directory.size() - pos - CENTRAL_SIZE < name + extra + note)
+    {
+      return false;
+    }
+    Member member;
+    member.flags = loadLE16(entry + 8);
+    member.method = loadLE16(entry + 10);
+    member.crc = loadLE32(entry + 16);
+    member.compressed = loadLE32(entry + 20);
+    uint64_t uncompressed = loadLE32(entry + 24);
+    member.disk = loadLE16(entry + 34);
+    member.offset = loadLE32(entry + 42);
+    member.zip64 = member.compressed == 0xFFFFFFFF || uncompressed == 0xFFFFFFFF;
+    member.name.assign(reinterpret_cast<const char*>(entry) + CENTRAL_SIZE, name);
+    if (!readZip64(entry + CENTRAL_SIZE + name, extra, uncompressed, member.compressed,
+                   member.offset, member.disk) ||
+        member.disk > disk || member.offset + LOCAL_SIZE + name > options.max_file_size)
+    {
+      return false;
+    }
+    out.members.push_back(std::move(member));
+    pos += CENTRAL_SIZE + name + extra + note;
+  }
+  if (pos != directory.size())
+  {
+    return false;
+  }
+  out.disk = static_cast<uint32_t>(disk);
+  out.offset = offset;
+  out.device = directory_end - size;
+  out.tail = end + END_SIZE + comment - out.device;
+  return true;
+}
+
+/// One segment of a set; a whole archive is a set of one.
+struct Segment
+{
+  uint32_t disk = 0;
+  std::vector<const Member*> members;  // starting in this segment, by local header offset
+  PieceMap map{0};
+  uint64_t size = 0;
+  uint64_t last_data = 0;  // file offset of the data of the segment's last member
+  uint64_t ambiguous = 0;  // bytes between a found piece and the last header before it
+  uint64_t unresolved = UINT64_MAX;
+  bool found = false;
+};
+
+/// Places the segments of one archive or set; reused across archives.
+class Assembler
+{
+public:
+  Assembler(Device& device, const ZipCarveOptions& options, ZipCarveStats& stats,
+            const std::vector<uint64_t>& locals)
+    : device_(device), options_(options), stats_(stats), locals_(locals), window_(device)
+  {
+    search_.block = options.block_size != 0 ? options.block_size : device.sectorSize();
+    search_.distance = options.search_distance;
+  }
+
+  /// Place the segments of the archive whose EOCD is at `end`. False when the
+  /// end records and central directory do not describe one.
+  bool assemble(uint64_t end, std::vector<Segment>& segments);
+
+  const Directory& directory() const { return directory_; }
+
+  /// Registry type and label, from the member names and the ODF mimetype.
+  void classify(const Segment& last, std::string& type, std::string& label);
+
+private:
+  bool headerFits(const PieceMap& map, const Member& member, bool backward, uint64_t& data);
+  bool runFits(const PieceMap& map, const Segment& segment, size_t first, bool backward);
+  size_t extendAnchor(Segment& segment, size_t first, uint64_t anchor_file,
+                      uint64_t anchor_device);
+  bool crcFits(const PieceMap& map, const Member& member, uint64_t data);
+  uint64_t pinBreak(PieceMap& map, const Member* member, uint64_t data, uint64_t file,
+                    uint64_t bad);
+  void place(Segment& segment, uint64_t anchor_file, uint64_t anchor_device);
+  bool locate(Segment& segment);
+  void sizeSegment(std::vector<Segment>& segments, size_t d);
+
+  Device& device_;
+  const ZipCarveOptions& options_;
+  ZipCarveStats& stats_;
+  const std::vector<uint64_t>& locals_;
+  DeviceWindow window_;
+  PieceSearch search_;
+  Directory directory_;
+  std::vector<uint8_t> scratch_;
+};
+
+/// The local header at the member's offset has its signature, method and name.
+bool Assembler::headerFits(const PieceMap& map, const Member& member, bool backward,
+                           uint64_t& data)
+{
+  uint8_t head[LOCAL_SIZE];
+  if (!window_.get(map, member.offset, head, LOCAL_SIZE, backward) ||
+      loadLE32(head) != SIG_LOCAL || loadLE16(head + 8) != member.method ||
+      loadLE16(head + 26) != member.name.size())
+  {
+    return false;
+  }
+  scratch_.resize(member.name.size());
+  if (!member.name.empty() &&
+      (!window_.get(map, member.offset + LOCAL_SIZE, scratch_.data(), scratch_.size(), backward) ||
+       std::memcmp(scratch_.data(), member.name.data(), scratch_.size()) != 0))
+  {
+    return false;
+  }
+  data = member.offset + LOCAL_SIZE + member.name.size() + loadLE16(head + 28);
+  return true;
+}
+
+/// Up to `confirm_members` local headers from `first` fit. Headers past the
+/// end of the piece holding `first` are not counted: they fit or not
+/// whatever the piece is.
+bool Assembler::runFits(const PieceMap& map, const Segment& segment, size_t first, bool backward)
+{
+  size_t last = std::min(segment.members.size(),
+                         first + std::max(1u, options_.confirm_members));
+  uint64_t limit = map.nextStart(segment.members[first]->offset);
+  for (size_t k = first; k < last; ++k)
+  {
+    const Member& member = *segment.members[k];
+    if (k > first && member.offset + LOCAL_SIZE + member.name.size() > limit)
+    {
+      break;
+    }
+    uint64_t data = 0;
+    if (!headerFits(map, member, backward, data))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Assembler::crcFits(const PieceMap& map, const Member& member, uint64_t data)
+{
+  scratch_.resize(CRC_CHUNK);
+  uint32_t crc = 0;
+  for (uint64_t done = 0; done < member.compressed;)
+  {
+    size_t take = static_cast<size_t>(std::min<uint64_t>(CRC_CHUNK, member.compressed - done));
+    if (!window_.get(map, data + done, scratch_.data(), take))
+    {
+      return false;
+    }
+    crc = crc32(scratch_.data(), take, crc);
+    done += take;
+  }
+  return crc == member.crc;
+}
+
+/// A piece was found starting at the earliest block boundary after `data`,
+/// where the data of `member` (the last one whose header fit) starts; the
+/// break may be at any boundary before `bad`. A stored member's CRC tells
+/// which: the piece is moved there. Returns the bytes still placed unchecked.
+uint64_t Assembler::pinBreak(PieceMap& map, const Member* member, uint64_t data, uint64_t file,
+                             uint64_t bad)
+{
+  uint64_t block = search_.block;
+  uint64_t last = (bad - 1) / block * block;
+  if (last <= file)
+  {
+    return 0;
+  }
+  uint64_t candidates = (last - file) / block + 1;
+  if (member == nullptr || member->method != 0 || member->compressed == 0 ||
+      data + member->compressed > bad || member->compressed * candidates > MAX_CRC_WORK)
+  {
+    return last - file;
+  }
+  uint64_t device = map.device(file);
+  uint64_t at = file;
+  for (; at <= last; at += block)
+  {
+    map.remove(at == file ? file : at - block);
+    map.add(at, device + (at - file));
+    if (crcFits(map, *member, data))
+    {
+      return 0;
+    }
+  }
+  map.remove(last);
+  map.add(file, device);
+  return last - file;
+}
+
+/// The piece holding the central directory may begin well before it. It is
+/// extended back over the local headers after `first` that fit where it puts
+/// them, to the last block boundary before the earliest of those, so that
+/// only the headers in front confirm the piece searched for `first`. Returns
+/// the index of that earliest member; the member count when there is none.
+size_t Assembler::extendAnchor(Segment& segment, size_t first, uint64_t anchor_file,
+                               uint64_t anchor_device)
+{
+  size_t count = segment.members.size();
+  if (anchor_file == 0 || anchor_device < anchor_file)
+  {
+    return count;
+  }
+  PieceMap anchored(anchor_device - anchor_file);
+  size_t held = count;
+  uint64_t data = 0;
+  while (held > first + 1 && segment.members[held - 1]->offset < anchor_file &&
+         headerFits(anchored, *segment.members[held - 1], true, data))
+  {
+    --held;
+  }
+  if (held == count)
+  {
+    return count;
+  }
+  const Member& before = *segment.members[held - 1];
+  uint64_t file = segment.members[held]->offset / search_.block * search_.block;
+  if (file < before.offset + LOCAL_SIZE + before.name.size())
+  {
+    return count;  // no boundary between the two headers
+  }
+  segment.map.remove(anchor_file);
+  segment.map.add(file, anchor_device - (anchor_file - file));
+  return held;
+}
+
+/// Check the segment's local headers in file order. `anchor_file` and
+/// `anchor_device` are where the central directory is (0 and 0 without one);
+/// a missing piece is first tried in the one holding it.
+void Assembler::place(Segment& segment, uint64_t anchor_file, uint64_t anchor_device)
+{
+  uint64_t block = search_.block;
+  uint64_t good = 0;
+  bool verified = false;
+  size_t held = segment.members.size();  // first member in the extended anchor piece
+  uint64_t held_good = 0;                // data of the member before it
+  for (size_t k = 0; k < segment.members.size(); ++k)
+  {
+    const Member& member = *segment.members[k];
+    uint64_t data = 0;
+    if (k == held)
+    {
+      held_good = good;
+    }
+    if (headerFits(segment.map, member, false, data))
+    {
+      good = data;
+      verified = true;
+      continue;
+    }
+    auto fits = [&](bool backward)
+    {
+      return runFits(segment.map, segment, k, backward);
+    };
+    bool found = false;
+    if (!verified)
+    {
+      // Nothing before this header was checked: the segment starts elsewhere.
+      if (held == segment.members.size())
+      {
+        held = extendAnchor(segment, k, anchor_file, anchor_device);
+      }
+      found = findPiece(segment.map, 0, search_, device_.size(), fits);
+    }
+    else
+    {
+      uint64_t bad = member.offset + LOCAL_SIZE + member.name.size();
+      uint64_t file = (good + block - 1) / block * block;
+      if (file < bad && file > segment.map.pieceStart(file))
+      {
+        if (file < anchor_file && anchor_device >= anchor_file - file)
+        {
+          segment.map.add(file, anchor_device - (anchor_file - file));
+          found = fits(false);
+          if (!found)
+          {
+            segment.map.remove(file);
+          }
+        }
+        if (!found && held == segment.members.size())
+        {
+          held = extendAnchor(segment, k, anchor_file, anchor_device);
+        }
+        found = found || findPiece(segment.map, file, search_, device_.size(), fits);
+        if (found)
+        {
+          segment.ambiguous += pinBreak(segment.map, segment.members[k - 1], good, file, bad);
+        }
+      }
+    }
+    if (!found || !headerFits(segment.map, member, false, data))
+    {
+      segment.unresolved = member.offset;
+      return;
+    }
+    ++stats_.pieces;
+    good = data;
+    verified = true;
+  }
+  segment.last_data = good;
+  if (anchor_file == 0 || !verified)
+  {
+    return;
+  }
+  if (held < segment.members.size())
+  {
+    // The extended piece was put at the latest boundary; as below, it starts
+    // at the earliest one after the data before it, moved by a stored CRC.
+    uint64_t boundary = segment.map.pieceStart(segment.members[held]->offset);
+    uint64_t file = (held_good + block - 1) / block * block;
+    if (file < boundary && file > segment.map.pieceStart(file))
+    {
+      segment.map.remove(boundary);
+      segment.map.add(file, anchor_device - (anchor_file - file));
+    }
+    else
+    {
+      file = boundary;
+    }
+    const Member& first = *segment.members[held];
+    uint64_t bad = first.offset + LOCAL_SIZE + first.name.size();
+    segment.ambiguous += pinBreak(segment.map, segment.members[held - 1], held_good, file, bad);
+    return;
+  }
+  // The piece holding the central directory starts after the last header.
+  uint64_t file = (good + block - 1) / block * block;
+  if (file < anchor_file && segment.map.device(anchor_file - 1) + 1 != anchor_device &&
+      file > segment.map.pieceStart(file) && anchor_device >= anchor_file - file)
+  {
+    segment.map.remove(anchor_file);
+    segment.map.add(file, anchor_device - (anchor_file - file));
+    segment.ambiguous += pinBreak(segment.map, segment.members.back(), good, file, anchor_file);
+  }
+}
+
+/// Find a segment without a central directory through the recorded local
+/// headers: it starts on a sector boundary its first member's offset before one.
+bool Assembler::locate(Segment& segment)
+{
+  if (segment.members.empty())
+  {
+    return false;
+  }
+  const Member& first = *segment.members.front();
+  uint64_t sector = device_.sectorSize();
+  for (uint64_t at : locals_)
+  {
+    if (at < first.offset || (at - first.offset) % sector != 0)
+    {
+      continue;
+    }
+    segment.map = PieceMap(at - first.offset);
+    if (runFits(segment.map, segment, 0, false))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// All segments of a split set but the last have its split size. A segment
+/// ends inside its last member when the next one starts with the rest of it.
+void Assembler::sizeSegment(std::vector<Segment>& segments, size_t d)
+{
+  Segment& segment = segments[d];
+  const Segment& next = segments[d + 1];
+  if (segment.members.empty() || next.members.empty() || !next.found ||
+      next.disk != segment.disk + 1 || segment.unresolved != UINT64_MAX)
+  {
+    return;
+  }
+  const Member& last = *segment.members.back();
+  uint64_t descriptor = (last.flags & FLAG_DESCRIPTOR) == 0 ? 0 : last.zip64 ? 24 : 16;
+  uint64_t end = segment.last_data + last.compressed + descriptor;
+  uint64_t spill = next.members.front()->offset;
+  if (end > spill)
+  {
+    segment.size = end - spill;
+  }
+}
+
+bool Assembler::assemble(uint64_t end, std::vector<Segment>& segments)
+{
+  segments.clear();
+  if (!readDirectory(device_, end, options_, directory_) ||
+      directory_.device < directory_.offset)
+  {
+    return false;
+  }
+  // Segments up to the last one a member starts in, then the last: those
+  // in between hold no member's start and could not be located anyway.
+  uint64_t highest = 0;
+  for (const Member& member : directory_.members)
+  {
+    highest = std::max<uint64_t>(highest, member.disk);
+  }
+  uint64_t count = std::min<uint64_t>(directory_.disk, highest + 1) + 1;
+  if (count > MAX_SEGMENTS)
+  {
+    return false;
+  }
+  segments.resize(static_cast<size_t>(count));
+  for (size_t d = 0; d < segments.size(); ++d)
+  {
+    segments[d].disk = static_cast<uint32_t>(d);
+  }
+  segments.back().disk = directory_.disk;
+  for (const Member& member : directory_.members)
+  {
+    segments[member.disk == directory_.disk ? segments.size() - 1 : member.disk]
+      .members.push_back(&member);
+  }
+  for (Segment& segment : segments)
+  {
+    std::sort(segment.members.begin(), segment.members.end(),
+              [](const Member* a, const Member* b) { return a->offset < b->offset; });
+  }
+
+  // 1. The last segment, from where its central directory is.
+  Segment& last = segments.back();
+  last.map = PieceMap(directory_.device - directory_.offset);
+  if (directory_.offset != 0)
+  {
+    last.map.add(directory_.offset, directory_.device);
+  }
+  place(last, directory_.offset, directory_.device);
+  last.size = directory_.offset + directory_.tail;
+  last.found = true;
+  if (last.size > options_.max_file_size)
+  {
+    return false;
+  }
+
+  // 2. The others, from their members' local headers.
+  for (size_t d = 0; d + 1 < segments.size(); ++d)
+  {
+    Segment& segment = segments[d];
+    segment.found = locate(segment);
+    if (segment.found)
+    {
+      place(segment, 0, 0);
+    }
+  }
+  uint64_t split = 0;
+  for (size_t d = segments.size() - 1; d-- > 0;)
+  {
+    sizeSegment(segments, d);
+    split = std::max(split, segments[d].size);
+  }
+  for (size_t d = 0; d + 1 < segments.size(); ++d)
+  {
+    if (segments[d].found && segments[d].size == 0)
+    {
+      segments[d].size = split;
+    }
+  }
+  return true;
+}
+
+void Assembler::classify(const Segment& last, std::string& type, std::string& label)
+{
+  type = "archive/zip";
+  label = "ZIP";
+  bool content_types = false;
+  bool manifest = false;
+  bool android = false;
+  std::string ooxml;
+  for (const Member& member : directory_.members)
+  {
+    const std::string& name = member.name;
+    content_types |= name == "[Content_Types].xml";
+    manifest |= name == "META-INF/MANIFEST.MF";
+    android |= name == "AndroidManifest.xml";
+    for (const char* part : {"word/", "xl/", "ppt/", "visio/"})
+    {
+      if (ooxml.empty() && name.compare(0, std::strlen(part), part) == 0)
+      {
+        ooxml = part;
+      }
+    }
+    if (name != "mimetype" || member.method != 0 || member.compressed > MAX_MIMETYPE ||
+        member.disk != last.disk)
+    {
+      continue;
+    }
+    // ODF and EPUB store their media type uncompressed as the first member.
+    uint64_t data = 0;
+    std::string media(static_cast<size_t>(member.compressed), '\0');
+    if (!headerFits(last.map, member, false, data) ||
+        !window_.get(last.map, data, reinterpret_cast<uint8_t*>(&media[0]), media.size()))
+    {
+      continue;
+    }
+    static const struct
+    {
+      const char* media;
+      const char* type;
+      const char* label;
+    } MEDIA[] = {
+      {"application/vnd.oasis.opendocument.text", "document/odt", "ODT"},
+      {"application/vnd.oasis.opendocument.spreadsheet", "document/ods", "ODS"},
+      {"application/vnd.oasis.opendocument.presentation", "document/odp", "ODP"},
+      {"application/vnd.oasis.opendocument.graphics", "document/odg", "ODG"},
+      {"application/epub+zip", "document/epub", "EPUB"},
+    };
+    for (const auto& known : MEDIA)
+    {
+      if (media == known.media)
+      {
+        type = known.type;
+        label = known.label;
+        return;
+      }
+    }
+  }
+  if (content_types && !ooxml.empty())
+  {
+    static const char* const OOXML[][3] = {
+      {"word/", "document/docx", "DOCX"},
+      {"xl/", "document/xlsx", "XLSX"},
+      {"ppt/", "document/pptx", "PPTX"},
+      {"visio/", "document/vsdx", "VSDX"},
+    };
+    for (const auto& known : OOXML)
+    {
+      if (ooxml == known[0])
+      {
+        type = known[1];
+        label = known[2];
+      }
+    }
+  }
+  else if (android)
+  {
+    type = "archive/apk";
+    label = "APK";
+  }
+  else if (manifest)
+  {
+    type = "archive/jar";
+    label = "JAR";
+  }
+}
+
+/// Confidence and the description suffix of a placed segment.
+double describe(const Segment& segment, std::vector<Extent>& extents, std::string& description)
+{
+  extents = segment.map.extents(segment.size);
+  if (!extents.empty())
+  {
+    description += ", " + std::to_string(extents.size()) + " pieces";
+  }
+  if (segment.unresolved != UINT64_MAX)
+  {
+    description += ", unverified from byte " + std::to_string(segment.unresolved);
+    return CONFIDENCE_UNRESOLVED;
+  }
+  if (segment.ambiguous != 0)
+  {
+    description += ", " + std::to_string(segment.ambiguous) + " bytes placed unchecked";
+    return CONFIDENCE_AMBIGUOUS;
+  }
+  return extents.empty() ? CONFIDENCE_VERIFIED : CONFIDENCE_REASSEMBLED;
+}
+
+}  // namespace
+
+void ZipCarveStage::registerPatterns(PatternSet& patterns)
+{
+  static const uint8_t END[] = {'P', 'K', 5, 6};
+  static const uint8_t LOCAL[] = {'P', 'K', 3, 4};
+  patterns.add(END, sizeof(END), TAG_EOCD);
+  patterns.add(LOCAL, sizeof(LOCAL), TAG_LOCAL);
+}
+
+bool ZipCarveStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& /*ctx*/)
+{
+  uint64_t offset = chunk.offset + pos;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tag == TAG_EOCD)
+  {
+    ends_.push_back(offset);
+  }
+  else if (locals_.size() < options_.max_local_headers)
+  {
+    locals_.push_back(offset);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+void ZipCarveStage::finish(CarveContext& ctx)
+{
+  stats_ = ZipCarveStats();
+  uint64_t members = 0;
+  std::sort(ends_.begin(), ends_.end());
+  std::sort(locals_.begin(), locals_.end());
+  Device& device = ctx.device();
+  Assembler assembler(device, options_, stats_, locals_);
+  std::vector<Segment> segments;
+  for (uint64_t end : ends_)
+  {
+    if (!assembler.assemble(end, segments))
+    {
+      continue;
+    }
+    const Segment& last = segments.back();
+    uint64_t start = last.map.device(0);
+    if (start % device.sectorSize() != 0)
+    {
+      ++stats_.embedded;
+      continue;
+    }
+    std::string type;
+    std::string label;
+    assembler.classify(last, type, label);
+
+    RecoveredFile file;
+    file.type = type;
+    file.source = name();
+    file.offset = start;
+    file.size = last.size;
+    file.description = label + ", " + std::to_string(assembler.directory().members.size()) +
+                       " members";
+    if (assembler.directory().zip64)
+    {
+      file.description += ", ZIP64";
+      ++stats_.zip64;
+    }
+    uint64_t count = uint64_t(last.disk) + 1;
+    uint64_t missing = count - segments.size();  // segments no member starts in
+    for (size_t d = 0; d + 1 < segments.size(); ++d)
+    {
+      missing += segments[d].found && segments[d].size != 0 ? 0 : 1;
+    }
+    if (count > 1)
+    {
+      file.description += ", last of " + std::to_string(count) + " segments";
+      if (missing != 0)
+      {
+        file.description += " (" + std::to_string(missing) + " not found)";
+      }
+    }
+    file.confidence = describe(last, file.extents, file.description);
+    bool unresolved = file.confidence == CONFIDENCE_UNRESOLVED || missing != 0;
+    stats_.fragmented += file.extents.empty() ? 0 : 1;
+    uint64_t id = ctx.registry().add(std::move(file));
+    ++stats_.archives;
+    members += assembler.directory().members.size();
+
+    for (size_t d = 0; d + 1 < segments.size(); ++d)
+    {
+      const Segment& segment = segments[d];
+      if (!segment.found || segment.size == 0)
+      {
+        continue;
+      }
+      RecoveredFile part;
+      part.type = "archive/zip_segment";
+      part.source = name();
+      part.offset = segment.map.device(0);
+      part.size = segment.size;
+      part.description = "segment " + std::to_string(d + 1) + " of " + std::to_string(count) +
+                         " of #" + std::to_string(id);
+      part.confidence = describe(segment, part.extents, part.description);
+      unresolved |= part.confidence == CONFIDENCE_UNRESOLVED;
+      stats_.fragmented += part.extents.empty() ? 0 : 1;
+      ctx.registry().add(std::move(part));
+      ++stats_.segments;
+    }
+    stats_.unresolved += unresolved ? 1 : 0;
+  }
+  accepted_[TAG_EOCD] = stats_.archives;
+  accepted_[TAG_LOCAL] = std::min<uint64_t>(members, locals_.size());
+  ends_.clear();
+  locals_.clear();
+}
+
+}  // namespace rsn
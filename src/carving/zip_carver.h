@@ -0,0 +1,88 @@
+// RecoverySoftNetz — ZIP family (ZIP, OOXML, ODF, JAR, APK, EPUB) carve stage
+//
+// A ZIP archive is described from its end: the end-of-central-directory
+// record (EOCD) gives the size and offset of the central directory, which
+// names every member and the offset of its local header. The stage records
+// EOCD records during the scan and resolves each backwards in `finish`:
+//   1. the central directory ends where the EOCD (or the ZIP64 end record)
+//      starts, and its offset says where the archive starts were it
+//      contiguous;
+//   2. members' local headers are checked, in file order, where the piece map
+//      puts them; one that does not check out means the archive was
+//      fragmented, and its piece is looked for in the piece holding the
+//      central directory, then at allocation-unit granularity (piece_map).
+// Compressed data is not inflated, so where a break falls between two headers
+// is known only when the member before it is stored: its CRC-32 is tried at
+// each allocation-unit boundary. Otherwise the bytes that leaves unplaced are
+// reported and the entry's confidence lowered. An archive whose start is not
+// on a sector boundary is embedded in another file and is not reported.
+//
+// Split and spanned sets (.z01, .z02, ..., .zip) keep the central directory
+// in their last segment. The other segments are found through the local
+// headers of their members, which the stage records during the scan, and
+// each segment is registered on its own.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace rsn
+{
+
+struct ZipCarveOptions
+{
+  uint64_t max_file_size = 64ull << 30;
+  uint64_t max_directory_size = 256ull << 20;  // larger central directories are not read
+  uint32_t block_size = 0;                     // fragment granularity; 0 = device sector size
+  uint64_t search_distance = 256ull << 20;     // how far a missing piece is looked for, each way
+  unsigned confirm_members = 2;                // local headers that must fit at a new piece
+  size_t max_local_headers = 4u << 20;         // local header offsets kept for split sets
+};
+
+struct ZipCarveStats
+{
+  uint64_t archives = 0;
+  uint64_t zip64 = 0;       // archives with ZIP64 end records
+  uint64_t fragmented = 0;  // archives (or segments) assembled from more than one piece
+  uint64_t pieces = 0;      // pieces found by searching
+  uint64_t unresolved = 0;  // registered with a member, or a segment, not found
+  uint64_t segments = 0;    // segments of split sets other than the last
+  uint64_t embedded = 0;    // archives not starting on a sector boundary
+};
+
+class ZipCarveStage : public CarveStage
+{
+public:
+  explicit ZipCarveStage(ZipCarveOptions options = ZipCarveOptions()) : options_(options) {}
+
+  const char* name() const override { return "zip"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  void finish(CarveContext& ctx) override;
+  bool defersValidation() const override { return true; }
+  uint64_t acceptedHits(uint32_t tag) const override { return tag < 2 ? accepted_[tag] : 0; }
+
+  /// Valid once the pipeline has finished.
+  const ZipCarveStats& stats() const { return stats_; }
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_EOCD,
+    TAG_LOCAL,
+  };
+
+  ZipCarveOptions options_;
+  std::mutex mutex_;
+  std::vector<uint64_t> ends_;    // EOCD offsets
+  std::vector<uint64_t> locals_;  // local header offsets
+  ZipCarveStats stats_;
+  uint64_t accepted_[2] = {};  // hits of each tag `finish` made use of
+};
+
+}  // namespace rsn
@@ -0,0 +1,1212 @@
+// RecoverySoftNetz — cryptographic primitives
+
+#include "common/crypto.h"
+
+#include "common/utils.h"
+
+#include <cstring>
+
+// The AES-NI and VAES paths are built on every x86-64 target with per-function
+// target attributes, so no global -maes/-mvaes is needed; Aes256Gcm picks one
+// from CPUID at run time and falls back to the portable code otherwise.
+#if defined(__x86_64__) || defined(_M_X64)
+#define RSN_AES_NI 1
+#endif
+
+#if defined(_MSC_VER)
+#define RSN_TARGET(features)
+#else
+#define RSN_TARGET(features) __attribute__((target(features)))
+#endif
+#define RSN_TARGET_AESNI RSN_TARGET("aes,pclmul,ssse3")
+#define RSN_TARGET_VAES RSN_TARGET("aes,pclmul,ssse3,avx512f,avx512bw,vaes,vpclmulqdq")
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(RSN_AES_NI)
+#include <immintrin.h>
+#endif
+#if defined(RSN_AES_NI) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rsn
+{
+
+namespace
+{
+
+const uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr32(uint32_t x, int n)
+{
+  return (x >> n) | (x << (32 - n));
+}
+
+void sha256Block(uint32_t state[8], const uint8_t* block)
+{
+  uint32_t w[64];
+  for (int i = 0; i < 16; ++i)
+  {
+    w[i] = loadBE32(block + 4 * i);
+  }
+  for (int i = 16; i < 64; ++i)
+  {
+    uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 64; ++i)
+  {
+    uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + SHA256_K[i] + w[i];
+    uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+const uint64_t SHA512_K[80] = {
+  0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+  0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+  0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+  0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+  0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+  0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+  0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+  0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+  0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+  0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+  0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+  0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+  0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+  0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+  0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+  0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+  0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+  0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+  0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+  0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+const uint64_t SHA512_IV[8] = {
+  0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+  0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+};
+
+// Lane abstraction for the SHA-512 rounds: one scalar lane, or 4/8 lanes of
+// 64-bit words in an AVX2/AVX-512 register.
+struct ScalarLanes
+{
+  using V = uint64_t;
+  static constexpr size_t WIDTH = 1;
+
+  static V load(const uint64_t* p) { return *p; }
+  static void store(uint64_t* p, V v) { *p = v; }
+  static V set1(uint64_t x) { return x; }
+  static V add(V a, V b) { return a + b; }
+  static V bxor(V a, V b) { return a ^ b; }
+  static V band(V a, V b) { return a & b; }
+  static V andnot(V a, V b) { return ~a & b; }
+  static V shr(V a, int n) { return a >> n; }
+  static V ror(V a, int n) { return (a >> n) | (a << (64 - n)); }
+};
+
+#if defined(__AVX2__)
+struct Avx2Lanes
+{
+  using V = __m256i;
+  static constexpr size_t WIDTH = 4;
+
+  static V load(const uint64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const V*>(p)); }
+  static void store(uint64_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<V*>(p), v); }
+  static V set1(uint64_t x) { return _mm256_set1_epi64x(static_cast<long long>(x)); }
+  static V add(V a, V b) { return _mm256_add_epi64(a, b); }
+  static V bxor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V band(V a, V b) { return _mm256_and_si256(a, b); }
+  static V andnot(V a, V b) { return _mm256_andnot_si256(a, b); }
+  static V shr(V a, int n) { return _mm256_srl_epi64(a, _mm_cvtsi32_si128(n)); }
+  static V ror(V a, int n)
+  {
+    return _mm256_or_si256(_mm256_srl_epi64(a, _mm_cvtsi32_si128(n)),
+                           _mm256_sll_epi64(a, _mm_cvtsi32_si128(64 - n)));
+  }
+};
+#endif
+
+#if defined(__AVX512F__)
+// Zero-masked forms where GCC's unmasked wrappers trip -Wmaybe-uninitialized;
+// with an all-ones mask they compile to the same instructions.
+struct Avx512Lanes
+{
+  using V = __m512i;
+  static constexpr size_t WIDTH = 8;
+
+  static V load(const uint64_t* p) { return _mm512_loadu_si512(p); }
+  static void store(uint64_t* p, V v) { _mm512_storeu_si512(p, v); }
+  static V set1(uint64_t x) { return _mm512_set1_epi64(static_cast<long long>(x)); }
+  static V add(V a, V b) { return _mm512_add_epi64(a, b); }
+  static V bxor(V a, V b) { return _mm512_xor_si512(a, b); }
+  static V band(V a, V b) { return _mm512_and_si512(a, b); }
+  static V andnot(V a, V b) { return _mm512_maskz_andnot_epi64(0xff, a, b); }
+  static V shr(V a, int n) { return _mm512_maskz_srl_epi64(0xff, a, _mm_cvtsi32_si128(n)); }
+  static V ror(V a, int n)
+  {
+    return _mm512_maskz_rorv_epi64(0xff, a, set1(static_cast<uint64_t>(n)));
+  }
+};
+#endif
+
+// SHA-512 of a 64-byte message whose words are h[0..7]; the padding block
+// is constant, so only the first eight schedule words vary.
+template <class L>
+void sha512RehashGroup(uint64_t (*words)[8], uint64_t rounds)
+{
+  using V = typename L::V;
+  uint64_t lanes[L::WIDTH];
+  V h[8];
+  for (int i = 0; i < 8; ++i)
+  {
+    for (size_t l = 0; l < L::WIDTH; ++l)
+    {
+      lanes[l] = words[l][i];
+    }
+    h[i] = L::load(lanes);
+  }
+  for (uint64_t r = 0; r < rounds; ++r)
+  {
+    V w[16];
+    for (int i = 0; i < 8; ++i)
+    {
+      w[i] = h[i];
+    }
+    w[8] = L::set1(0x8000000000000000ull);
+    for (int i = 9; i < 15; ++i)
+    {
+      w[i] = L::set1(0);
+    }
+    w[15] = L::set1(512);
+
+    V a = L::set1(SHA512_IV[0]), b = L::set1(SHA512_IV[1]);
+    V c = L::set1(SHA512_IV[2]), d = L::set1(SHA512_IV[3]);
+    V e = L::set1(SHA512_IV[4]), f = L::set1(SHA512_IV[5]);
+    V g = L::set1(SHA512_IV[6]), hh = L::set1(SHA512_IV[7]);
+    for (int t = 0; t < 80; ++t)
+    {
+      if (t >= 16)
+      {
+        V w15 = w[(t + 1) & 15];
+        V w2 = w[(t + 14) & 15];
+        V s0 = L::bxor(L::bxor(L::ror(w15, 1), L::ror(w15, 8)), L::shr(w15, 7));
+        V s1 = L::bxor(L::bxor(L::ror(w2, 19), L::ror(w2, 61)), L::shr(w2, 6));
+        w[t & 15] = L::add(L::add(w[t & 15], s0), L::add(w[(t + 9) & 15], s1));
+      }
+      V s1 = L::bxor(L::bxor(L::ror(e, 14), L::ror(e, 18)), L::ror(e, 41));
+      V ch = L::bxor(L::band(e, f), L::andnot(e, g));
+      V t1 = L::add(L::add(hh, s1), L::add(ch, L::add(L::set1(SHA512_K[t]), w[t & 15])));
+      V s0 = L::bxor(L::bxor(L::ror(a, 28), L::ror(a, 34)), L::ror(a, 39));
+      V maj = L::bxor(L::bxor(L::band(a, b), L::band(a, c)), L::band(b, c));
+      V t2 = L::add(s0, maj);
+      hh = g;
+      g = f;
+      f = e;
+      e = L::add(d, t1);
+      d = c;
+      c = b;
+      b = a;
+      a = L::add(t1, t2);
+    }
+    V out[8] = {a, b, c, d, e, f, g, hh};
+    for (int i = 0; i < 8; ++i)
+    {
+      h[i] = L::add(out[i], L::set1(SHA512_IV[i]));
+    }
+  }
+  for (int i = 0; i < 8; ++i)
+  {
+    L::store(lanes, h[i]);
+    for (size_t l = 0; l < L::WIDTH; ++l)
+    {
+      words[l][i] = lanes[l];
+    }
+  }
+}
+
+#if defined(__AVX512F__)
+using WideLanes = Avx512Lanes;
+#elif defined(__AVX2__)
+using WideLanes = Avx2Lanes;
+#else
+using WideLanes = ScalarLanes;
+#endif
+
+void sha512Block(uint64_t state[8], const uint8_t* block)
+{
+  uint64_t w[80];
+  for (int i = 0; i < 16; ++i)
+  {
+    w[i] = loadBE64(block + 8 * i);
+  }
+  for (int i = 16; i < 80; ++i)
+  {
+    uint64_t s0 = ScalarLanes::ror(w[i - 15], 1) ^ ScalarLanes::ror(w[i - 15], 8) ^
+                  (w[i - 15] >> 7);
+    uint64_t s1 = ScalarLanes::ror(w[i - 2], 19) ^ ScalarLanes::ror(w[i - 2], 61) ^
+                  (w[i - 2] >> 6);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint64_t a = state[0], b = state[1], c = state[2], d = state[3];
+  uint64_t e = state[4], f = state[5], g = state[6], h = state[7];
+  for (int i = 0; i < 80; ++i)
+  {
+    uint64_t s1 = ScalarLanes::ror(e, 14) ^ ScalarLanes::ror(e, 18) ^ ScalarLanes::ror(e, 41);
+    uint64_t ch = (e & f) ^ (~e & g);
+    uint64_t t1 = h + s1 + ch + SHA512_K[i] + w[i];
+    uint64_t s0 = ScalarLanes::ror(a, 28) ^ ScalarLanes::ror(a, 34) ^ ScalarLanes::ror(a, 39);
+    uint64_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint64_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+const uint64_t KECCAK_RC[24] = {
+  0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808aull, 0x8000000080008000ull,
+  0x000000000000808bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+  0x000000000000008aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000aull,
+  0x000000008000808bull, 0x800000000000008bull, 0x8000000000008089ull, 0x8000000000008003ull,
+  0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800aull, 0x800000008000000aull,
+  0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull,
+};
+
+const int KECCAK_ROTC[24] = {1,  3,  6,  10, 15, 21, 28, 36, 45, 55, 2,  14,
+                             27, 41, 56, 8,  25, 43, 62, 18, 39, 61, 20, 44};
+const int KECCAK_PILN[24] = {10, 7,  11, 17, 18, 3, 5,  16, 8,  21, 24, 4,
+                             15, 23, 19, 13, 12, 2, 20, 14, 22, 9,  6,  1};
+
+inline uint64_t rotl64(uint64_t x, int n)
+{
+  return (x << n) | (x >> (64 - n));
+}
+
+void keccakF1600(uint64_t st[25])
+{
+  uint64_t bc[5];
+  for (int round = 0; round < 24; ++round)
+  {
+    for (int i = 0; i < 5; ++i)
+    {
+      bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+      uint64_t t = bc[(i + 4) % 5] ^ rotl64(bc[(i + 1) % 5], 1);
+      for (int j = 0; j < 25; j += 5)
+      {
+        st[j + i] ^= t;
+      }
+    }
+    uint64_t t = st[1];
+    for (int i = 0; i < 24; ++i)
+    {
+      int j = KECCAK_PILN[i];
+      bc[0] = st[j];
+      st[j] = rotl64(t, KECCAK_ROTC[i]);
+      t = bc[0];
+    }
+    for (int j = 0; j < 25; j += 5)
+    {
+      for (int i = 0; i < 5; ++i)
+      {
+        bc[i] = st[j + i];
+      }
+      for (int i = 0; i < 5; ++i)
+      {
+        st[j + i] ^= ~bc[(i + 1) % 5] & bc[(i + 2) % 5];
+      }
+    }
+    st[0] ^= KECCAK_RC[round];
+  }
+}
+
+// AES S-boxes, derived once from the GF(2^8) inverse and affine map.
+struct AesTables
+{
+  uint8_t sbox[256];
+  uint8_t inv_sbox[256];
+
+  AesTables()
+  {
+    uint8_t p = 1, q = 1;
+    do
+    {
+      p = static_cast<uint8_t>(p ^ (p << 1) ^ ((p & 0x80) ? 0x1b : 0));  // p * 3
+      q ^= static_cast<uint8_t>(q << 1);                                   // q / 3
+      q ^= static_cast<uint8_t>(q << 2);
+      q ^= static_cast<uint8_t>(q << 4);
+      if (q & 0x80)
+      {
+        q ^= 0x09;
+      }
+      uint8_t x = static_cast<uint8_t>(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4));
+      sbox[p] = static_cast<uint8_t>(x ^ 0x63);
+    } while (p != 1);
+    sbox[0] = 0x63;
+    for (int i = 0; i < 256; ++i)
+    {
+      inv_sbox[sbox[i]] = static_cast<uint8_t>(i);
+    }
+  }
+
+  static uint8_t rotl8(uint8_t x, int n) { return static_cast<uint8_t>((x << n) | (x >> (8 - n))); }
+};
+
+const AesTables AES;
+
+inline uint8_t xtime(uint8_t x)
+{
+  return static_cast<uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+inline uint8_t gmul(uint8_t a, uint8_t b)
+{
+  uint8_t r = 0;
+  while (b != 0)
+  {
+    if (b & 1)
+    {
+      r ^= a;
+    }
+    a = xtime(a);
+    b >>= 1;
+  }
+  return r;
+}
+
+// GHASH multiply, one bit at a time (SP 800-38D algorithm 1); only used
+// when the CPU has no carry-less multiply.
+void ghashMulPortable(uint8_t x[AES_BLOCK_SIZE], const uint8_t h[AES_BLOCK_SIZE])
+{
+  uint64_t zh = 0, zl = 0;
+  uint64_t vh = loadBE64(h), vl = loadBE64(h + 8);
+  for (int i = 0; i < 128; ++i)
+  {
+    if ((x[i / 8] >> (7 - i % 8)) & 1)
+    {
+      zh ^= vh;
+      zl ^= vl;
+    }
+    bool carry = (vl & 1) != 0;
+    vl = (vl >> 1) | (vh << 63);
+    vh >>= 1;
+    if (carry)
+    {
+      vh ^= 0xe100000000000000ull;
+    }
+  }
+  storeBE64(x, zh);
+  storeBE64(x + 8, zl);
+}
+
+#ifdef RSN_AES_NI
+struct AesSupport
+{
+  bool aesni = false;  // AES-NI, PCLMULQDQ and SSSE3
+  bool vaes = false;   // and VAES, VPCLMULQDQ, AVX-512F/BW with OS support
+};
+
+AesSupport detectAes()
+{
+  AesSupport s;
+#ifdef _MSC_VER
+  int r[4];
+  __cpuid(r, 1);
+  s.aesni = (r[2] >> 25 & 1) != 0 && (r[2] >> 1 & 1) != 0 && (r[2] >> 9 & 1) != 0;
+  bool zmm_state = (r[2] >> 27 & 1) != 0 && (_xgetbv(0) & 0xE6) == 0xE6;
+  __cpuidex(r, 7, 0);
+  s.vaes = s.aesni && zmm_state && (r[1] >> 16 & 1) != 0 && (r[1] >> 30 & 1) != 0 &&
+           (r[2] >> 9 & 1) != 0 && (r[2] >> 10 & 1) != 0;
+#else
+  __builtin_cpu_init();
+  s.aesni = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+            __builtin_cpu_supports("ssse3");
+  s.vaes = s.aesni && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("vaes") && __builtin_cpu_supports("vpclmulqdq");
+#endif
+  return s;
+}
+
+// Read once, when the library is loaded.
+const AesSupport AES_SUPPORT = detectAes();
+
+RSN_TARGET_AESNI inline __m128i bswap128(__m128i v)
+{
+  return _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+template <size_t N>
+RSN_TARGET_AESNI inline void aesniEncrypt(__m128i (&b)[N], const __m128i rk[15])
+{
+  for (size_t i = 0; i < N; ++i)
+  {
+    b[i] = _mm_xor_si128(b[i], rk[0]);
+  }
+  for (int r = 1; r < 14; ++r)
+  {
+    for (size_t i = 0; i < N; ++i)
+    {
+      b[i] = _mm_aesenc_si128(b[i], rk[r]);
+    }
+  }
+  for (size_t i = 0; i < N; ++i)
+  {
+    b[i] = _mm_aesenclast_si128(b[i], rk[14]);
+  }
+}
+
+// Unreduced 256-bit carry-less products; several are summed before a single
+// reduction (the GHASH aggregation trick).
+struct ClmulSum
+{
+  __m128i lo = _mm_setzero_si128();
+  __m128i mid = _mm_setzero_si128();
+  __m128i hi = _mm_setzero_si128();
+
+  RSN_TARGET_AESNI void add(__m128i a, __m128i b)
+  {
+    lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+    hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+    mid = _mm_xor_si128(mid, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                           _mm_clmulepi64_si128(a, b, 0x01)));
+  }
+
+  // Shift left by one for the reflected operands, then reduce modulo
+  // x^128 + x^7 + x^2 + x + 1 (Intel carry-less multiplication guide, alg. 5).
+  RSN_TARGET_AESNI __m128i reduce() const
+  {
+    __m128i a = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    __m128i b = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    __m128i ca = _mm_srli_epi32(a, 31);
+    __m128i cb = _mm_srli_epi32(b, 31);
+    a = _mm_slli_epi32(a, 1);
+    b = _mm_slli_epi32(b, 1);
+    __m128i carry = _mm_srli_si128(ca, 12);
+    cb = _mm_slli_si128(cb, 4);
+    ca = _mm_slli_si128(ca, 4);
+    a = _mm_or_si128(a, ca);
+    b = _mm_or_si128(_mm_or_si128(b, cb), carry);
+
+    __m128i t = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(a, 31), _mm_slli_epi32(a, 30)),
+                              _mm_slli_epi32(a, 25));
+    __m128i t_hi = _mm_srli_si128(t, 4);
+    a = _mm_xor_si128(a, _mm_slli_si128(t, 12));
+    __m128i u = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(a, 1), _mm_srli_epi32(a, 2)),
+                              _mm_xor_si128(_mm_srli_epi32(a, 7), t_hi));
+    return _mm_xor_si128(b, _mm_xor_si128(a, u));
+  }
+};
+
+RSN_TARGET_AESNI inline __m128i gfmul(__m128i a, __m128i b)
+{
+  ClmulSum sum;
+  sum.add(a, b);
+  return sum.reduce();
+}
+
+// The maskz forms keep GCC 12 from flagging its own _undefined() operands.
+RSN_TARGET_VAES inline __m512i broadcastLane(__m128i v)
+{
+  return _mm512_maskz_broadcast_i32x4(0xffff, v);
+}
+
+RSN_TARGET_VAES inline __m128i lowLane(__m512i v)
+{
+  return _mm512_maskz_extracti32x4_epi32(0xf, v, 0);
+}
+
+// XOR of the four 128-bit lanes.
+RSN_TARGET_VAES inline __m128i foldLanes(__m512i v)
+{
+  v = _mm512_xor_si512(v, _mm512_maskz_shuffle_i64x2(0xff, v, v, 0x4e));
+  v = _mm512_xor_si512(v, _mm512_maskz_shuffle_i64x2(0xff, v, v, 0xb1));
+  return lowLane(v);
+}
+
+// 32 blocks per iteration in eight 4-block registers: enough independent
+// AES chains to cover VAES latency, and one GHASH reduction.
+// Returns the bytes done, with `x` and `counter` advanced past them.
+RSN_TARGET_VAES size_t vaesBlocks(const __m128i rk[15], const uint8_t (*h_powers)[AES_BLOCK_SIZE],
+                                  const uint8_t* in, uint8_t* out, size_t size, bool encrypt,
+                                  __m128i& x, __m128i& counter)
+{
+  constexpr int REGS = 8;
+  constexpr size_t WIDE = REGS * 64;
+  if (size < WIDE)
+  {
+    return 0;
+  }
+  size_t i = 0;
+  __m512i rkz[15];
+  for (int r = 0; r < 15; ++r)
+  {
+    rkz[r] = broadcastLane(rk[r]);
+  }
+  // Block k of the 32 is multiplied by H^(32-k); register j holds blocks
+  // 4j..4j+3, so its lanes are H^(32-4j) .. H^(29-4j).
+  __m512i hz[REGS];
+  for (int j = 0; j < REGS; ++j)
+  {
+    hz[j] = _mm512_loadu_si512(h_powers[4 * (REGS - 1 - j)]);
+    hz[j] = _mm512_maskz_shuffle_i64x2(0xff, hz[j], hz[j], 0x1b);
+  }
+  const __m512i swap = broadcastLane(
+    _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  const __m512i step = _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4);
+  __m512i ctr = _mm512_add_epi32(
+    broadcastLane(counter), _mm512_set_epi32(0, 0, 0, 4, 0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1));
+  for (; i + WIDE <= size; i += WIDE)
+  {
+    __m512i ks[REGS];
+    for (auto& k : ks)
+    {
+      k = _mm512_xor_si512(_mm512_shuffle_epi8(ctr, swap), rkz[0]);
+      ctr = _mm512_add_epi32(ctr, step);
+    }
+    for (int r = 1; r < 14; ++r)
+    {
+      for (auto& k : ks)
+      {
+        k = _mm512_aesenc_epi128(k, rkz[r]);
+      }
+    }
+    __m512i lo = _mm512_setzero_si512();
+    __m512i mid = _mm512_setzero_si512();
+    __m512i hi = _mm512_setzero_si512();
+    for (int j = 0; j < REGS; ++j)
+    {
+      ks[j] = _mm512_aesenclast_epi128(ks[j], rkz[14]);
+      __m512i data = _mm512_loadu_si512(in + i + 64 * j);
+      __m512i result = _mm512_xor_si512(data, ks[j]);
+      _mm512_storeu_si512(out + i + 64 * j, result);
+      __m512i c = _mm512_shuffle_epi8(encrypt ? result : data, swap);
+      if (j == 0)
+      {
+        c = _mm512_xor_si512(c, _mm512_zextsi128_si512(x));
+      }
+      lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(c, hz[j], 0x00));
+      hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(c, hz[j], 0x11));
+      mid = _mm512_ternarylogic_epi64(mid, _mm512_clmulepi64_epi128(c, hz[j], 0x10),
+                                      _mm512_clmulepi64_epi128(c, hz[j], 0x01), 0x96);
+    }
+    ClmulSum sum;
+    sum.lo = foldLanes(lo);
+    sum.mid = foldLanes(mid);
+    sum.hi = foldLanes(hi);
+    x = sum.reduce();
+  }
+  counter = _mm_sub_epi32(lowLane(ctr), _mm_set_epi32(0, 0, 0, 1));
+  return i;
+}
+
+// H^1..H^32, byte-reflected for the carry-less multiply.
+RSN_TARGET_AESNI void aesniPowers(const uint8_t h[AES_BLOCK_SIZE],
+                                  uint8_t (*powers)[AES_BLOCK_SIZE], size_t count)
+{
+  __m128i hr = bswap128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(h)));
+  __m128i power = hr;
+  for (size_t k = 0; k < count; ++k)
+  {
+    _mm_store_si128(reinterpret_cast<__m128i*>(powers[k]), power);
+    power = gfmul(power, hr);
+  }
+}
+
+RSN_TARGET_AESNI void aesniCrypt(const uint8_t (*round_keys)[AES_BLOCK_SIZE],
+                                 const uint8_t (*h_powers)[AES_BLOCK_SIZE],
+                                 const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size,
+                                 const uint8_t* in, uint8_t* out, size_t size, bool encrypt,
+                                 uint8_t tag[GCM_TAG_SIZE])
+{
+  constexpr size_t LANES = 8;
+  __m128i rk[15];
+  for (int r = 0; r < 15; ++r)
+  {
+    rk[r] = _mm_load_si128(reinterpret_cast<const __m128i*>(round_keys[r]));
+  }
+  __m128i hp[LANES];
+  for (size_t k = 0; k < LANES; ++k)
+  {
+    hp[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(h_powers[k]));
+  }
+
+  uint8_t block[AES_BLOCK_SIZE] = {};
+  std::memcpy(block, iv, GCM_IV_SIZE);
+  storeBE32(block + 12, 1);
+  __m128i j0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+  __m128i counter = bswap128(j0);  // 32-bit block counter in lane 0
+  const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+
+  __m128i x = _mm_setzero_si128();
+  const auto* a = static_cast<const uint8_t*>(aad);
+  for (size_t i = 0; i < aad_size; i += AES_BLOCK_SIZE)
+  {
+    size_t n = aad_size - i < AES_BLOCK_SIZE ? aad_size - i : AES_BLOCK_SIZE;
+    std::memset(block, 0, sizeof(block));
+    std::memcpy(block, a + i, n);
+    __m128i v = bswap128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)));
+    x = gfmul(_mm_xor_si128(x, v), hp[0]);
+  }
+
+  size_t i = 0;
+  if (AES_SUPPORT.vaes)
+  {
+    i = vaesBlocks(rk, h_powers, in, out, size, encrypt, x, counter);
+  }
+  for (; i + LANES * AES_BLOCK_SIZE <= size; i += LANES * AES_BLOCK_SIZE)
+  {
+    __m128i ks[LANES];
+    for (size_t k = 0; k < LANES; ++k)
+    {
+      counter = _mm_add_epi32(counter, one);
+      ks[k] = bswap128(counter);
+    }
+    aesniEncrypt(ks, rk);
+    ClmulSum sum;
+    for (size_t k = 0; k < LANES; ++k)
+    {
+      const auto* src = reinterpret_cast<const __m128i*>(in + i + k * AES_BLOCK_SIZE);
+      __m128i data = _mm_loadu_si128(src);
+      __m128i result = _mm_xor_si128(data, ks[k]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + k * AES_BLOCK_SIZE), result);
+      __m128i c = bswap128(encrypt ? result : data);
+      sum.add(k == 0 ? _mm_xor_si128(x, c) : c, hp[LANES - 1 - k]);
+    }
+    x = sum.reduce();
+  }
+  for (; i < size; i += AES_BLOCK_SIZE)
+  {
+    size_t n = size - i < AES_BLOCK_SIZE ? size - i : AES_BLOCK_SIZE;
+    __m128i ks[1];
+    counter = _mm_add_epi32(counter, one);
+    ks[0] = bswap128(counter);
+    aesniEncrypt(ks, rk);
+    std::memset(block, 0, sizeof(block));
+    std::memcpy(block, in + i, n);
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(block), _mm_xor_si128(data, ks[0]));
+    std::memcpy(out + i, block, n);
+    std::memset(block + n, 0, sizeof(block) - n);
+    __m128i c = encrypt ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(block)) : data;
+    x = gfmul(_mm_xor_si128(x, bswap128(c)), hp[0]);
+  }
+
+  __m128i lengths = _mm_set_epi64x(static_cast<long long>(aad_size * 8),
+                                   static_cast<long long>(size * 8));
+  x = gfmul(_mm_xor_si128(x, lengths), hp[0]);
+  __m128i ej0[1] = {j0};
+  aesniEncrypt(ej0, rk);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(tag), _mm_xor_si128(bswap128(x), ej0[0]));
+  secureZero(block, sizeof(block));
+}
+#endif
+
+}  // namespace
+
+void Sha256::reset()
+{
+  static const uint32_t IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  std::memcpy(state_, IV, sizeof(state_));
+  total_ = 0;
+  buffered_ = 0;
+}
+
+void Sha256::update(const void* data, size_t size)
+{
+  const auto* p = static_cast<const uint8_t*>(data);
+  total_ += size;
+  if (buffered_ > 0)
+  {
+    size_t take = SHA256_BLOCK_SIZE - buffered_ < size ? SHA256_BLOCK_SIZE - buffered_ : size;
+    std::memcpy(buffer_ + buffered_, p, take);
+    buffered_ += take;
+    p += take;
+    size -= take;
+    if (buffered_ < SHA256_BLOCK_SIZE)
+    {
+      return;
+    }
+    sha256Block(state_, buffer_);
+    buffered_ = 0;
+  }
+  while (size >= SHA256_BLOCK_SIZE)
+  {
+    sha256Block(state_, p);
+    p += SHA256_BLOCK_SIZE;
+    size -= SHA256_BLOCK_SIZE;
+  }
+  std::memcpy(buffer_, p, size);
+  buffered_ = size;
+}
+
+void Sha256::finish(uint8_t digest[SHA256_DIGEST_SIZE])
+{
+  uint64_t bits = total_ * 8;
+  static const uint8_t PAD[SHA256_BLOCK_SIZE] = {0x80};
+  size_t pad = buffered_ < 56 ? 56 - buffered_ : 120 - buffered_;
+  update(PAD, pad);
+  uint8_t len[8];
+  storeBE64(len, bits);
+  update(len, 8);
+  for (int i = 0; i < 8; ++i)
+  {
+    storeBE32(digest + 4 * i, state_[i]);
+  }
+  reset();
+}
+
+void sha256(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+  Sha256 ctx;
+  ctx.update(data, size);
+  ctx.finish(digest);
+}
+
+void sha256d(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+  uint8_t inner[SHA256_DIGEST_SIZE];
+  sha256(data, size, inner);
+  sha256(inner, sizeof(inner), digest);
+}
+
+void Sha512::reset()
+{
+  std::memcpy(state_, SHA512_IV, sizeof(state_));
+  total_ = 0;
+  buffered_ = 0;
+}
+
+void Sha512::update(const void* data, size_t size)
+{
+  const auto* p = static_cast<const uint8_t*>(data);
+  total_ += size;
+  if (buffered_ > 0)
+  {
+    size_t take = SHA512_BLOCK_SIZE - buffered_ < size ? SHA512_BLOCK_SIZE - buffered_ : size;
+    std::memcpy(buffer_ + buffered_, p, take);
+    buffered_ += take;
+    p += take;
+    size -= take;
+    if (buffered_ < SHA512_BLOCK_SIZE)
+    {
+      return;
+    }
+    sha512Block(state_, buffer_);
+    buffered_ = 0;
+  }
+  while (size >= SHA512_BLOCK_SIZE)
+  {
+    sha512Block(state_, p);
+    p += SHA512_BLOCK_SIZE;
+    size -= SHA512_BLOCK_SIZE;
+  }
+  std::memcpy(buffer_, p, size);
+  buffered_ = size;
+}
+
+void Sha512::finish(uint8_t digest[SHA512_DIGEST_SIZE])
+{
+  uint64_t bits = total_ * 8;
+  static const uint8_t PAD[SHA512_BLOCK_SIZE] = {0x80};
+  size_t pad = buffered_ < 112 ? 112 - buffered_ : 240 - buffered_;
+  update(PAD, pad);
+  uint8_t len[16] = {};
+  storeBE64(len + 8, bits);
+  update(len, 16);
+  for (int i = 0; i < 8; ++i)
+  {
+    storeBE64(digest + 8 * i, state_[i]);
+  }
+  reset();
+}
+
+void sha512(const void* data, size_t size, uint8_t digest[SHA512_DIGEST_SIZE])
+{
+  Sha512 ctx;
+  ctx.update(data, size);
+  ctx.finish(digest);
+}
+
+void sha512Rehash(uint8_t* digests, size_t count, uint64_t rounds)
+{
+  constexpr size_t WIDTH = WideLanes::WIDTH;
+  uint64_t words[WIDTH][8];
+  for (size_t base = 0; base < count; base += WIDTH)
+  {
+    size_t n = count - base < WIDTH ? count - base : WIDTH;
+    for (size_t l = 0; l < n; ++l)
+    {
+      for (int i = 0; i < 8; ++i)
+      {
+        words[l][i] = loadBE64(digests + (base + l) * SHA512_DIGEST_SIZE + 8 * i);
+      }
+    }
+    if (n == WIDTH)
+    {
+      sha512RehashGroup<WideLanes>(words, rounds);
+    }
+    else
+    {
+      for (size_t l = 0; l < n; ++l)
+      {
+        sha512RehashGroup<ScalarLanes>(&words[l], rounds);
+      }
+    }
+    for (size_t l = 0; l < n; ++l)
+    {
+      for (int i = 0; i < 8; ++i)
+      {
+        storeBE64(digests + (base + l) * SHA512_DIGEST_SIZE + 8 * i, words[l][i]);
+      }
+    }
+  }
+}
+
+void keccak256(const void* data, size_t size, uint8_t digest[KECCAK256_DIGEST_SIZE])
+{
+  constexpr size_t RATE = 136;
+  uint64_t st[25] = {};
+  const auto* p = static_cast<const uint8_t*>(data);
+  while (size >= RATE)
+  {
+    for (size_t i = 0; i < RATE / 8; ++i)
+    {
+      st[i] ^= loadLE64(p + 8 * i);
+    }
+    keccakF1600(st);
+    p += RATE;
+    size -= RATE;
+  }
+  uint8_t block[RATE] = {};
+  std::memcpy(block, p, size);
+  block[size] ^= 0x01;
+  block[RATE - 1] ^= 0x80;
+  for (size_t i = 0; i < RATE / 8; ++i)
+  {
+    st[i] ^= loadLE64(block + 8 * i);
+  }
+  keccakF1600(st);
+  for (size_t i = 0; i < KECCAK256_DIGEST_SIZE / 8; ++i)
+  {
+    storeLE64(digest + 8 * i, st[i]);
+  }
+}
+
+Aes256::Aes256(const uint8_t key[AES256_KEY_SIZE])
+{
+  uint8_t* w = &round_keys_[0][0];
+  std::memcpy(w, key, AES256_KEY_SIZE);
+  uint8_t rcon = 1;
+  for (size_t i = AES256_KEY_SIZE; i < sizeof(round_keys_); i += 4)
+  {
+    uint8_t t[4] = {w[i - 4], w[i - 3], w[i - 2], w[i - 1]};
+    if (i % AES256_KEY_SIZE == 0)
+    {
+      uint8_t first = t[0];
+      t[0] = static_cast<uint8_t>(AES.sbox[t[1]] ^ rcon);
+      t[1] = AES.sbox[t[2]];
+      t[2] = AES.sbox[t[3]];
+      t[3] = AES.sbox[first];
+      rcon = xtime(rcon);
+    }
+    else if (i % AES256_KEY_SIZE == 16)
+    {
+      for (auto& b : t)
+      {
+        b = AES.sbox[b];
+      }
+    }
+    for (int j = 0; j < 4; ++j)
+    {
+      w[i + j] = static_cast<uint8_t>(w[i + j - AES256_KEY_SIZE] ^ t[j]);
+    }
+  }
+}
+
+void Aes256::encryptBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) const
+{
+  uint8_t s[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    s[i] = static_cast<uint8_t>(in[i] ^ round_keys_[0][i]);
+  }
+  for (int round = 1; round <= 14; ++round)
+  {
+    uint8_t t[16];
+    for (int i = 0; i < 16; ++i)
+    {
+      t[i] = AES.sbox[s[(i + 4 * (i % 4)) % 16]];  // SubBytes + ShiftRows
+    }
+    if (round < 14)
+    {
+      for (int c = 0; c < 4; ++c)
+      {
+        uint8_t* col = t + 4 * c;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t all = static_cast<uint8_t>(a0 ^ a1 ^ a2 ^ a3);
+        col[0] = static_cast<uint8_t>(a0 ^ all ^ xtime(static_cast<uint8_t>(a0 ^ a1)));
+        col[1] = static_cast<uint8_t>(a1 ^ all ^ xtime(static_cast<uint8_t>(a1 ^ a2)));
+        col[2] = static_cast<uint8_t>(a2 ^ all ^ xtime(static_cast<uint8_t>(a2 ^ a3)));
+        col[3] = static_cast<uint8_t>(a3 ^ all ^ xtime(static_cast<uint8_t>(a3 ^ a0)));
+      }
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+      s[i] = static_cast<uint8_t>(t[i] ^ round_keys_[round][i]);
+    }
+  }
+  std::memcpy(out, s, 16);
+}
+
+void Aes256::decryptBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) const
+{
+  uint8_t s[16];
+  for (int i = 0; i < 16; ++i)
+  {
+    s[i] = static_cast<uint8_t>(in[i] ^ round_keys_[14][i]);
+  }
+  for (int round = 13; round >= 0; --round)
+  {
+    uint8_t t[16];
+    for (int i = 0; i < 16; ++i)
+    {
+      t[(i + 4 * (i % 4)) % 16] = AES.inv_sbox[s[i]];  // InvShiftRows + InvSubBytes
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+      t[i] ^= round_keys_[round][i];
+    }
+    if (round > 0)
+    {
+      for (int c = 0; c < 4; ++c)
+      {
+        uint8_t* col = t + 4 * c;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        col[0] = static_cast<uint8_t>(gmul(a0, 14) ^ gmul(a1, 11) ^ gmul(a2, 13) ^ gmul(a3, 9));
+        col[1] = static_cast<uint8_t>(gmul(a0, 9) ^ gmul(a1, 14) ^ gmul(a2, 11) ^ gmul(a3, 13));
+        col[2] = static_cast<uint8_t>(gmul(a0, 13) ^ gmul(a1, 9) ^ gmul(a2, 14) ^ gmul(a3, 11));
+        col[3] = static_cast<uint8_t>(gmul(a0, 11) ^ gmul(a1, 13) ^ gmul(a2, 9) ^ gmul(a3, 14));
+      }
+    }
+    std::memcpy(s, t, 16);
+  }
+  std::memcpy(out, s, 16);
+}
+
+Aes256::~Aes256()
+{
+  secureZero(round_keys_, sizeof(round_keys_));
+}
+
+Aes256Gcm::Aes256Gcm(const uint8_t key[AES256_KEY_SIZE]) : aes_(key)
+{
+  uint8_t h[AES_BLOCK_SIZE] = {};
+  aes_.encryptBlock(h, h);
+#ifdef RSN_AES_NI
+  if (AES_SUPPORT.aesni)
+  {
+    aesniPowers(h, h_powers_, sizeof(h_powers_) / sizeof(h_powers_[0]));
+    secureZero(h, sizeof(h));
+    return;
+  }
+#endif
+  std::memcpy(h_powers_[0], h, sizeof(h));
+  secureZero(h, sizeof(h));
+}
+
+Aes256Gcm::~Aes256Gcm()
+{
+  secureZero(h_powers_, sizeof(h_powers_));
+}
+
+void Aes256Gcm::seal(const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size,
+                     const uint8_t* in, uint8_t* out, size_t size,
+                     uint8_t tag[GCM_TAG_SIZE]) const
+{
+  crypt(iv, aad, aad_size, in, out, size, true, tag);
+}
+
+bool Aes256Gcm::open(const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size,
+                     const uint8_t* in, uint8_t* out, size_t size,
+                     const uint8_t tag[GCM_TAG_SIZE]) const
+{
+  uint8_t expected[GCM_TAG_SIZE];
+  crypt(iv, aad, aad_size, in, out, size, false, expected);
+  uint8_t diff = 0;
+  for (size_t i = 0; i < GCM_TAG_SIZE; ++i)
+  {
+    diff |= static_cast<uint8_t>(expected[i] ^ tag[i]);
+  }
+  if (diff != 0)
+  {
+    secureZero(out, size);
+    return false;
+  }
+  return true;
+}
+
+void Aes256Gcm::crypt(const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size,
+                      const uint8_t* in, uint8_t* out, size_t size, bool encrypt,
+                      uint8_t tag[GCM_TAG_SIZE]) const
+{
+#ifdef RSN_AES_NI
+  if (AES_SUPPORT.aesni)
+  {
+    aesniCrypt(aes_.round_keys_, h_powers_, iv, aad, aad_size, in, out, size, encrypt, tag);
+    return;
+  }
+#endif
+  uint8_t j0[AES_BLOCK_SIZE] = {};
+  std::memcpy(j0, iv, GCM_IV_SIZE);
+  storeBE32(j0 + 12, 1);
+  uint8_t x[AES_BLOCK_SIZE] = {};
+  uint8_t block[AES_BLOCK_SIZE];
+  auto absorb = [&](const uint8_t* data, size_t n) {
+    for (size_t k = 0; k < n; ++k)
+    {
+      x[k] ^= data[k];
+    }
+    ghashMulPortable(x, h_powers_[0]);
+  };
+
+  const auto* a = static_cast<const uint8_t*>(aad);
+  for (size_t i = 0; i < aad_size; i += AES_BLOCK_SIZE)
+  {
+    absorb(a + i, aad_size - i < AES_BLOCK_SIZE ? aad_size - i : AES_BLOCK_SIZE);
+  }
+  uint8_t counter[AES_BLOCK_SIZE];
+  std::memcpy(counter, j0, sizeof(counter));
+  for (size_t i = 0; i < size; i += AES_BLOCK_SIZE)
+  {
+    size_t n = size - i < AES_BLOCK_SIZE ? size - i : AES_BLOCK_SIZE;
+    storeBE32(counter + 12, loadBE32(counter + 12) + 1);
+    aes_.encryptBlock(counter, block);
+    if (!encrypt)
+    {
+      absorb(in + i, n);
+    }
+    for (size_t k = 0; k < n; ++k)
+    {
+      out[i + k] = static_cast<uint8_t>(in[i + k] ^ block[k]);
+    }
+    if (encrypt)
+    {
+      absorb(out + i, n);
+    }
+  }
+  uint8_t lengths[AES_BLOCK_SIZE];
+  storeBE64(lengths, static_cast<uint64_t>(aad_size) * 8);
+  storeBE64(lengths + 8, static_cast<uint64_t>(size) * 8);
+  absorb(lengths, sizeof(lengths));
+  aes_.encryptBlock(j0, block);
+  for (size_t k = 0; k < GCM_TAG_SIZE; ++k)
+  {
+    tag[k] = static_cast<uint8_t>(x[k] ^ block[k]);
+  }
+  secureZero(block, sizeof(block));
+}
+
+
+bool randomBytes(void* data, size_t size)
+{
+#ifdef _WIN32
+  return BCryptGenRandom(nullptr, static_cast<PUCHAR>(data), static_cast<ULONG>(size),
+                         BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+  int fd = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+  auto* p = static_cast<uint8_t*>(data);
+  while (size > 0)
+  {
+    ssize_t got = ::read(fd, p, size);
+    if (got <= 0)
+    {
+      ::close(fd);
+      return false;
+    }
+    p += got;
+    size -= static_cast<size_t>(got);
+  }
+  ::close(fd);
+  return true;
+#endif
+}
+
+void secureZero(void* data, size_t size)
+{
+#ifdef _WIN32
+  SecureZeroMemory(data, size);
+#elif defined(__GNUC__)
+  std::memset(data, 0, size);
+  __asm__ __volatile__("" : : "r"(data) : "memory");  // keeps the memset alive
+#else
+  volatile uint8_t* p = static_cast<volatile uint8_t*>(data);
+  while (size-- > 0)
+  {
+    *p++ = 0;
+  }
+#endif
+}
+
+}  // namespace rsn
@@ -0,0 +1,124 @@
+// RecoverySoftNetz — cryptographic primitives
+//
+// Self-contained implementations of the hashes and ciphers the recovery
+// stages need for in-line validation (mnemonic checksums, base58check, wallet
+// formats) and for wallet password recovery. Nothing here allocates; all
+// functions are safe to call concurrently.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rsn
+{
+
+constexpr size_t SHA256_DIGEST_SIZE = 32;
+constexpr size_t SHA256_BLOCK_SIZE = 64;
+constexpr size_t SHA512_DIGEST_SIZE = 64;
+constexpr size_t SHA512_BLOCK_SIZE = 128;
+constexpr size_t KECCAK256_DIGEST_SIZE = 32;
+constexpr size_t AES_BLOCK_SIZE = 16;
+constexpr size_t AES256_KEY_SIZE = 32;
+constexpr size_t GCM_IV_SIZE = 12;
+constexpr size_t GCM_TAG_SIZE = 16;
+
+class Sha256
+{
+public:
+  Sha256() { reset(); }
+
+  void reset();
+  void update(const void* data, size_t size);
+  void finish(uint8_t digest[SHA256_DIGEST_SIZE]);
+
+private:
+  uint32_t state_[8];
+  uint8_t buffer_[SHA256_BLOCK_SIZE];
+  uint64_t total_ = 0;
+  size_t buffered_ = 0;
+};
+
+/// One-shot SHA-256.
+void sha256(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/// SHA-256(SHA-256(data)), as used by base58check and Bitcoin structures.
+void sha256d(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+class Sha512
+{
+public:
+  Sha512() { reset(); }
+
+  void reset();
+  void update(const void* data, size_t size);
+  void finish(uint8_t digest[SHA512_DIGEST_SIZE]);
+
+private:
+  uint64_t state_[8];
+  uint8_t buffer_[SHA512_BLOCK_SIZE];
+  uint64_t total_ = 0;
+  size_t buffered_ = 0;
+};
+
+/// One-shot SHA-512.
+void sha512(const void* data, size_t size, uint8_t digest[SHA512_DIGEST_SIZE]);
+
+/// Replace each of `count` consecutive 64-byte digests with SHA-512 of itself,
+/// `rounds` times. Independent digests run side by side in SIMD lanes (8 with
+/// AVX-512, 4 with AVX2), which is where iterated wallet KDFs spend their time.
+void sha512Rehash(uint8_t* digests, size_t count, uint64_t rounds);
+
+/// Keccak-256 with the original padding, as used by Ethereum (not SHA3-256).
+void keccak256(const void* data, size_t size, uint8_t digest[KECCAK256_DIGEST_SIZE]);
+
+/// AES-256 block cipher with an expanded key schedule.
+class Aes256
+{
+public:
+  explicit Aes256(const uint8_t key[AES256_KEY_SIZE]);
+
+  void encryptBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) const;
+  void decryptBlock(const uint8_t in[AES_BLOCK_SIZE], uint8_t out[AES_BLOCK_SIZE]) const;
+
+  ~Aes256();
+
+private:
+  friend class Aes256Gcm;
+
+  alignas(16) uint8_t round_keys_[15][AES_BLOCK_SIZE];
+};
+
+/// AES-256-GCM (NIST SP 800-38D) with 96-bit IVs. On CPUs with AES-NI and
+/// PCLMULQDQ (checked at run time), CTR runs eight blocks in flight and GHASH
+/// folds eight blocks per reduction; VAES/VPCLMULQDQ widen that to 32 blocks.
+class Aes256Gcm
+{
+public:
+  explicit Aes256Gcm(const uint8_t key[AES256_KEY_SIZE]);
+  ~Aes256Gcm();
+
+  /// Encrypt `size` bytes from `in` to `out` (which may alias) and write the tag.
+  void seal(const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size, const uint8_t* in,
+            uint8_t* out, size_t size, uint8_t tag[GCM_TAG_SIZE]) const;
+
+  /// Decrypt and verify. On a tag mismatch `out` is wiped and false returned.
+  bool open(const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size, const uint8_t* in,
+            uint8_t* out, size_t size, const uint8_t tag[GCM_TAG_SIZE]) const;
+
+private:
+  void crypt(const uint8_t iv[GCM_IV_SIZE], const void* aad, size_t aad_size, const uint8_t* in,
+             uint8_t* out, size_t size, bool encrypt, uint8_t tag[GCM_TAG_SIZE]) const;
+
+  Aes256 aes_;
+  // H^1..H^32, byte-reflected for the carry-less multiply.
+  alignas(16) uint8_t h_powers_[32][AES_BLOCK_SIZE];
+};
+
+/// Fill `data` from the operating system CSPRNG; false if it is unavailable.
+bool randomBytes(void* data, size_t size);
+
+/// Overwrite memory in a way the optimizer cannot drop.
+void secureZero(void* data, size_t size);
+
+}  // namespace rsn
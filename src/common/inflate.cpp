@@ -0,0 +1,451 @@
+// RecoverySoftNetz — DEFLATE decoder
+
+#include "common/inflate.h"
+
+#include "common/utils.h"
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr int MAX_BITS = 15;
+constexpr int MAX_LITERALS = 288;
+constexpr int MAX_DISTANCES = 30;
+constexpr int FIXED_LITERALS = 288;
+constexpr int END_OF_BLOCK = 256;
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DISTANCE_BASE[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385,
+                                    24577};
+const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+                                       11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+/// Canonical Huffman code: how many codes of each length, and the symbols in
+/// code order.
+struct Huffman
+{
+  uint16_t count[MAX_BITS + 1] = {};
+  uint16_t symbol[MAX_LITERALS] = {};
+};
+
+/// Build `h` from per-symbol code lengths. Returns 0 for a complete code, a
+/// positive value for an incomplete one and a negative value for an
+/// over-subscribed one.
+int build(Huffman& h, const uint8_t* lengths, int n)
+{
+  for (int len = 0; len <= MAX_BITS; ++len)
+  {
+    h.count[len] = 0;
+  }
+  for (int s = 0; s < n; ++s)
+  {
+    ++h.count[lengths[s]];
+  }
+  if (h.count[0] == n)
+  {
+    return 0;
+  }
+  int left = 1;
+  for (int len = 1; len <= MAX_BITS; ++len)
+  {
+    left <<= 1;
+    left -= h.count[len];
+    if (left < 0)
+    {
+      return left;
+    }
+  }
+  uint16_t offsets[MAX_BITS + 1];
+  offsets[1] = 0;
+  for (int len = 1; len < MAX_BITS; ++len)
+  {
+    offsets[len + 1] = static_cast<uint16_t>(offsets[len] + h.count[len]);
+  }
+  for (int s = 0; s < n; ++s)
+  {
+    if (lengths[s] != 0)
+    {
+      h.symbol[offsets[lengths[s]]++] = static_cast<uint16_t>(s);
+    }
+  }
+  return left;
+}
+
+class Inflater
+{
+public:
+  Inflater(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_output)
+    : data_(data), size_(size), out_(out), base_(out.size()), max_output_(max_output)
+  {
+  }
+
+  bool run();
+  size_t consumed() const { return pos_; }
+
+private:
+  bool bits(int need, uint32_t& value);
+  int decode(const Huffman& h);
+  bool stored();
+  bool fixed();
+  bool dynamic();
+  bool codes(const Huffman& literals, const Huffman& distances);
+
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  uint32_t bit_buffer_ = 0;
+  int bit_count_ = 0;
+  std::vector<uint8_t>& out_;
+  size_t base_;  // output bytes that were there before; distances may not reach them
+  size_t max_output_;
+};
+
+bool Inflater::bits(int need, uint32_t& value)
+{
+  while (bit_count_ < need)
+  {
+    if (pos_ == size_)
+    {
+      return false;
+    }
+    bit_buffer_ |= static_cast<uint32_t>(data_[pos_++]) << bit_count_;
+    bit_count_ += 8;
+  }
+  value = bit_buffer_ & ((1u << need) - 1);
+  bit_buffer_ >>= need;
+  bit_count_ -= need;
+  return true;
+}
+
+/// Next symbol of `h`, one bit at a time; -1 on a truncated or invalid code.
+int Inflater::decode(const Huffman& h)
+{
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int len = 1; len <= MAX_BITS; ++len)
+  {
+    uint32_t bit = 0;
+    if (!bits(1, bit))
+    {
+      return -1;
+    }
+    code |= static_cast<int>(bit);
+    int count = h.count[len];
+    if (code - count < first)
+    {
+      return h.symbol[index + (code - first)];
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+bool Inflater::stored()
+{
+  bit_buffer_ = 0;
+  bit_count_ = 0;
+  if (size_ - pos_ < 4)
+  {
+    return false;
+  }
+  uint32_t length = data_[pos_] | (static_cast<uint32_t>(data_[pos_ + 1]) << 8);
+  uint32_t complement = data_[pos_ + 2] | (static_cast<uint32_t>(data_[pos_ + 3]) << 8);
+  pos_ += 4;
+  if (length != (~complement & 0xFFFF) || size_ - pos_ < length ||
+      out_.size() - base_ + length > max_output_)
+  {
+    return false;
+  }
+  out_.insert(out_.end(), data_ + pos_, data_ + pos_ + length);
+  pos_ += length;
+  return true;
+}
+
+bool Inflater::codes(const Huffman& literals, const Huffman& distances)
+{
+  for (;;)
+  {
+    int symbol = decode(literals);
+    if (symbol < 0)
+    {
+      return false;
+    }
+    if (symbol < END_OF_BLOCK)
+    {
+      if (out_.size() - base_ == max_output_)
+      {
+        return false;
+      }
+      out_.push_back(static_cast<uint8_t>(symbol));
+      continue;
+    }
+    if (symbol == END_OF_BLOCK)
+    {
+      return true;
+    }
+    symbol -= 257;
+    if (symbol >= 29)
+    {
+      return false;
+    }
+    uint32_t extra = 0;
+    if (!bits(LENGTH_EXTRA[symbol], extra))
+    {
+      return false;
+    }
+    size_t length = LENGTH_BASE[symbol] + extra;
+    int code = decode(distances);
+    if (code < 0 || code >= MAX_DISTANCES || !bits(DISTANCE_EXTRA[code], extra))
+    {
+      return false;
+    }
+    size_t distance = DISTANCE_BASE[code] + extra;
+    if (distance > out_.size() - base_ || out_.size() - base_ + length > max_output_)
+    {
+      return false;
+    }
+    size_t from = out_.size() - distance;
+    for (size_t k = 0; k < length; ++k)
+    {
+      out_.push_back(out_[from + k]);
+    }
+  }
+}
+
+bool Inflater::fixed()
+{
+  static Huffman literals;
+  static Huffman distances;
+  static const bool built = []
+  {
+    uint8_t lengths[FIXED_LITERALS];
+    int s = 0;
+    for (; s < 144; ++s)
+    {
+      lengths[s] = 8;
+    }
+    for (; s < 256; ++s)
+    {
+      lengths[s] = 9;
+    }
+    for (; s < 280; ++s)
+    {
+      lengths[s] = 7;
+    }
+    for (; s < FIXED_LITERALS; ++s)
+    {
+      lengths[s] = 8;
+    }
+    build(literals, lengths, FIXED_LITERALS);
+    for (s = 0; s < MAX_DISTANCES; ++s)
+    {
+      lengths[s] = 5;
+    }
+    build(distances, lengths, MAX_DISTANCES);
+    return true;
+  }();
+  (void)built;
+  return codes(literals, distances);
+}
+
+bool Inflater::dynamic()
+{
+  uint32_t nlen = 0;
+  uint32_t ndist = 0;
+  uint32_t ncode = 0;
+  if (!bits(5, nlen) || !bits(5, ndist) || !bits(4, ncode))
+  {
+    return false;
+  }
+  nlen += 257;
+  ndist += 1;
+  ncode += 4;
+  if (nlen > 286 || ndist > MAX_DISTANCES)
+  {
+    return false;
+  }
+  uint8_t lengths[MAX_LITERALS + MAX_DISTANCES] = {};
+  for (uint32_t k = 0; k < ncode; ++k)
+  {
+    uint32_t length = 0;
+    if (!bits(3, length))
+    {
+      return false;
+    }
+    lengths[CODE_LENGTH_ORDER[k]] = static_cast<uint8_t>(length);
+  }
+  Huffman lencode;
+  if (build(lencode, lengths, 19) != 0)
+  {
+    return false;
+  }
+  uint32_t index = 0;
+  while (index < nlen + ndist)
+  {
+    int symbol = decode(lencode);
+    if (symbol < 0)
+    {
+      return false;
+    }
+    if (symbol < 16)
+    {
+      lengths[index++] = static_cast<uint8_t>(symbol);
+      continue;
+    }
+    uint8_t length = 0;
+    uint32_t repeat = 0;
+    if (symbol == 16)
+    {
+      if (index == 0 || !bits(2, repeat))
+      {
+        return false;
+      }
+      length = lengths[index - 1];
+      repeat += 3;
+    }
+    else if (symbol == 17)
+    {
+      if (!bits(3, repeat))
+      {
+        return false;
+      }
+      repeat += 3;
+    }
+    else
+    {
+      if (!bits(7, repeat))
+      {
+        return false;
+      }
+      repeat += 11;
+    }
+    if (index + repeat > nlen + ndist)
+    {
+      return false;
+    }
+    while (repeat-- != 0)
+    {
+      lengths[index++] = length;
+    }
+  }
+  if (lengths[END_OF_BLOCK] == 0)
+  {
+    return false;
+  }
+  // Incomplete codes are only allowed when they hold a single code.
+  Huffman literals;
+  int left = build(literals, lengths, static_cast<int>(nlen));
+  if (left < 0 || (left > 0 && nlen - literals.count[0] != 1))
+  {
+    return false;
+  }
+  Huffman distances;
+  left = build(distances, lengths + nlen, static_cast<int>(ndist));
+  if (left < 0 || (left > 0 && ndist - distances.count[0] != 1))
+  {
+    return false;
+  }
+  return codes(literals, distances);
+}
+
+bool Inflater::run()
+{
+  uint32_t last = 0;
+  do
+  {
+    uint32_t type = 0;
+    if (!bits(1, last) || !bits(2, type))
+    {
+      return false;
+    }
+    bool ok = false;
+    switch (type)
+    {
+    case 0:
+      ok = stored();
+      break;
+    case 1:
+      ok = fixed();
+      break;
+    case 2:
+      ok = dynamic();
+      break;
+    default:
+      break;
+    }
+    if (!ok)
+    {
+      return false;
+    }
+  } while (last == 0);
+  return true;
+}
+
+uint32_t adler32(const uint8_t* data, size_t size)
+{
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size != 0)
+  {
+    size_t run = size < 5552 ? size : 5552;  // largest run before the sums can overflow
+    size -= run;
+    while (run-- != 0)
+    {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+}  // namespace
+
+bool inflateRaw(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_output,
+                size_t* consumed)
+{
+  Inflater inflater(data, size, out, max_output);
+  bool ok = inflater.run();
+  if (consumed != nullptr)
+  {
+    *consumed = inflater.consumed();
+  }
+  return ok;
+}
+
+bool inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_output)
+{
+  if (size < 2 || (data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 ||
+      ((static_cast<uint32_t>(data[0]) << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0)
+  {
+    return false;
+  }
+  size_t base = out.size();
+  size_t used = 0;
+  if (!inflateRaw(data + 2, size - 2, out, max_output, &used))
+  {
+    return false;
+  }
+  size_t trailer = 2 + used;
+  if (size - trailer >= 4)
+  {
+    return adler32(out.data() + base, out.size() - base) == loadBE32(data + trailer);
+  }
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,30 @@
+// RecoverySoftNetz — DEFLATE decoder
+//
+// Small, dependency-free decoder for raw DEFLATE (RFC 1951) and zlib-wrapped
+// (RFC 1950) streams, as PDF object streams, cross-reference streams and ZIP
+// members use them. It favours bounded, predictable behaviour on damaged input
+// over speed: the output is capped by the caller, and any malformed block,
+// over-subscribed code or distance reaching before the output start fails the
+// decode instead of producing garbage.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+/// Decode a raw DEFLATE stream, appending at most `max_output` bytes to `out`.
+/// False on malformed or truncated input, or when the output would exceed the
+/// cap; `out` then holds what was decoded so far. `consumed`, when given,
+/// receives the input bytes used up to the end of the final block.
+bool inflateRaw(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_output,
+                size_t* consumed = nullptr);
+
+/// Decode a zlib stream: header checked, preset dictionaries refused, and the
+/// Adler-32 trailer checked when the input holds it.
+bool inflateZlib(const uint8_t* data, size_t size, std::vector<uint8_t>& out, size_t max_output);
+
+}  // namespace rsn
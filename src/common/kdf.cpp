@@ -0,0 +1,208 @@
+// RecoverySoftNetz — password-based key derivation
+
+#include "common/kdf.h"
+
+#include "common/utils.h"
+
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+inline uint32_t rotl32(uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+void salsa20_8(uint32_t b[16])
+{
+  uint32_t x[16];
+  std::memcpy(x, b, sizeof(x));
+  for (int i = 0; i < 8; i += 2)
+  {
+    x[4] ^= rotl32(x[0] + x[12], 7);
+    x[8] ^= rotl32(x[4] + x[0], 9);
+    x[12] ^= rotl32(x[8] + x[4], 13);
+    x[0] ^= rotl32(x[12] + x[8], 18);
+    x[9] ^= rotl32(x[5] + x[1], 7);
+    x[13] ^= rotl32(x[9] + x[5], 9);
+    x[1] ^= rotl32(x[13] + x[9], 13);
+    x[5] ^= rotl32(x[1] + x[13], 18);
+    x[14] ^= rotl32(x[10] + x[6], 7);
+    x[2] ^= rotl32(x[14] + x[10], 9);
+    x[6] ^= rotl32(x[2] + x[14], 13);
+    x[10] ^= rotl32(x[6] + x[2], 18);
+    x[3] ^= rotl32(x[15] + x[11], 7);
+    x[7] ^= rotl32(x[3] + x[15], 9);
+    x[11] ^= rotl32(x[7] + x[3], 13);
+    x[15] ^= rotl32(x[11] + x[7], 18);
+    x[1] ^= rotl32(x[0] + x[3], 7);
+    x[2] ^= rotl32(x[1] + x[0], 9);
+    x[3] ^= rotl32(x[2] + x[1], 13);
+    x[0] ^= rotl32(x[3] + x[2], 18);
+    x[6] ^= rotl32(x[5] + x[4], 7);
+    x[7] ^= rotl32(x[6] + x[5], 9);
+    x[4] ^= rotl32(x[7] + x[6], 13);
+    x[5] ^= rotl32(x[4] + x[7], 18);
+    x[11] ^= rotl32(x[10] + x[9], 7);
+    x[8] ^= rotl32(x[11] + x[10], 9);
+    x[9] ^= rotl32(x[8] + x[11], 13);
+    x[10] ^= rotl32(x[9] + x[8], 18);
+    x[12] ^= rotl32(x[15] + x[14], 7);
+    x[13] ^= rotl32(x[12] + x[15], 9);
+    x[14] ^= rotl32(x[13] + x[12], 13);
+    x[15] ^= rotl32(x[14] + x[13], 18);
+  }
+  for (int i = 0; i < 16; ++i)
+  {
+    b[i] += x[i];
+  }
+}
+
+// scryptBlockMix: `in` and `out` are 2r 64-byte blocks of 32-bit words.
+void blockMix(const uint32_t* in, uint32_t* out, uint32_t r)
+{
+  uint32_t x[16];
+  std::memcpy(x, in + (2 * r - 1) * 16, sizeof(x));
+  for (uint32_t i = 0; i < 2 * r; ++i)
+  {
+    for (int j = 0; j < 16; ++j)
+    {
+      x[j] ^= in[i * 16 + j];
+    }
+    salsa20_8(x);
+    // Even blocks go to the first half, odd blocks to the second.
+    uint32_t dst = (i / 2) + (i & 1) * r;
+    std::memcpy(out + dst * 16, x, sizeof(x));
+  }
+}
+
+}  // namespace
+
+HmacSha256::HmacSha256(const void* key, size_t key_size)
+{
+  uint8_t block[SHA256_BLOCK_SIZE] = {};
+  if (key_size > SHA256_BLOCK_SIZE)
+  {
+    sha256(key, key_size, block);
+  }
+  else
+  {
+    std::memcpy(block, key, key_size);
+  }
+  uint8_t pad[SHA256_BLOCK_SIZE];
+  for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i)
+  {
+    pad[i] = static_cast<uint8_t>(block[i] ^ 0x36);
+  }
+  inner_.update(pad, sizeof(pad));
+  for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i)
+  {
+    pad[i] = static_cast<uint8_t>(block[i] ^ 0x5c);
+  }
+  outer_.update(pad, sizeof(pad));
+  secureZero(block, sizeof(block));
+  secureZero(pad, sizeof(pad));
+}
+
+void HmacSha256::finish(uint8_t mac[SHA256_DIGEST_SIZE])
+{
+  uint8_t inner[SHA256_DIGEST_SIZE];
+  inner_.finish(inner);
+  outer_.update(inner, sizeof(inner));
+  outer_.finish(mac);
+}
+
+void pbkdf2HmacSha256(const void* password, size_t password_size, const void* salt,
+                      size_t salt_size, uint32_t iterations, uint8_t* out, size_t out_size)
+{
+  // The keyed pads are the same for every HMAC; absorb them once.
+  const HmacSha256 keyed(password, password_size);
+  for (uint32_t block = 1; out_size > 0; ++block)
+  {
+    uint8_t index[4];
+    storeBE32(index, block);
+    HmacSha256 mac = keyed;
+    mac.update(salt, salt_size);
+    mac.update(index, sizeof(index));
+    uint8_t u[SHA256_DIGEST_SIZE];
+    uint8_t t[SHA256_DIGEST_SIZE];
+    mac.finish(u);
+    std::memcpy(t, u, sizeof(t));
+    for (uint32_t i = 1; i < iterations; ++i)
+    {
+      HmacSha256 next = keyed;
+      next.update(u, sizeof(u));
+      next.finish(u);
+      for (size_t j = 0; j < sizeof(t); ++j)
+      {
+        t[j] ^= u[j];
+      }
+    }
+    size_t take = out_size < sizeof(t) ? out_size : sizeof(t);
+    std::memcpy(out, t, take);
+    out += take;
+    out_size -= take;
+  }
+}
+
+ScryptContext::ScryptContext(uint64_t n, uint32_t r, uint32_t p) : n_(n), r_(r), p_(p)
+{
+}
+
+bool ScryptContext::derive(const void* password, size_t password_size, const void* salt,
+                           size_t salt_size, uint8_t* out, size_t out_size)
+{
+  if (!isPowerOfTwo(n_) || n_ < 2 || r_ == 0 || p_ == 0)
+  {
+    return false;
+  }
+  size_t block_size = 128 * static_cast<size_t>(r_);
+  std::vector<uint8_t> b(block_size * p_);
+  pbkdf2HmacSha256(password, password_size, salt, salt_size, 1, b.data(), b.size());
+  for (uint32_t i = 0; i < p_; ++i)
+  {
+    romix(b.data() + i * block_size);
+  }
+  pbkdf2HmacSha256(password, password_size, b.data(), b.size(), 1, out, out_size);
+  secureZero(b.data(), b.size());
+  return true;
+}
+
+void ScryptContext::romix(uint8_t* block)
+{
+  size_t words = 32 * static_cast<size_t>(r_);
+  v_.resize(words * n_);
+  x_.resize(words);
+  y_.resize(words);
+  for (size_t i = 0; i < words; ++i)
+  {
+    x_[i] = loadLE32(block + 4 * i);
+  }
+  for (uint64_t i = 0; i < n_; ++i)
+  {
+    std::memcpy(&v_[i * words], x_.data(), words * 4);
+    blockMix(x_.data(), y_.data(), r_);
+    x_.swap(y_);
+  }
+  for (uint64_t i = 0; i < n_; ++i)
+  {
+    uint64_t j = x_[words - 16] & (n_ - 1);  // Integerify: first word of the last block
+    const uint32_t* vj = &v_[j * words];
+    for (size_t k = 0; k < words; ++k)
+    {
+      x_[k] ^= vj[k];
+    }
+    blockMix(x_.data(), y_.data(), r_);
+    x_.swap(y_);
+  }
+  for (size_t i = 0; i < words; ++i)
+  {
+    storeLE32(block + 4 * i, x_[i]);
+  }
+}
+
+}  // namespace rsn
@@ -0,0 +1,60 @@
+// RecoverySoftNetz — password-based key derivation
+//
+// HMAC-SHA256, PBKDF2-HMAC-SHA256 and scrypt (RFC 7914), the KDFs used by
+// Web3 Secret Storage keystores and several wallet formats. Unlike the hashes
+// in crypto.h, scrypt needs N * r * 128 bytes of scratch; ScryptContext keeps
+// it between calls so a password worker allocates once.
+
+#pragma once
+
+#include "common/crypto.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+class HmacSha256
+{
+public:
+  HmacSha256(const void* key, size_t key_size);
+
+  void update(const void* data, size_t size) { inner_.update(data, size); }
+  void finish(uint8_t mac[SHA256_DIGEST_SIZE]);
+
+private:
+  Sha256 inner_;
+  Sha256 outer_;
+};
+
+/// PBKDF2 with HMAC-SHA256 as the PRF.
+void pbkdf2HmacSha256(const void* password, size_t password_size, const void* salt,
+                      size_t salt_size, uint32_t iterations, uint8_t* out, size_t out_size);
+
+class ScryptContext
+{
+public:
+  /// Returns false from derive() when N is not a power of two or r/p are zero.
+  ScryptContext(uint64_t n, uint32_t r, uint32_t p);
+
+  bool derive(const void* password, size_t password_size, const void* salt, size_t salt_size,
+              uint8_t* out, size_t out_size);
+
+  uint64_t n() const { return n_; }
+  uint32_t r() const { return r_; }
+  uint32_t p() const { return p_; }
+
+private:
+  void romix(uint8_t* block);
+
+  uint64_t n_;
+  uint32_t r_;
+  uint32_t p_;
+  std::vector<uint32_t> v_;
+  std::vector<uint32_t> x_;
+  std::vector<uint32_t> y_;
+};
+
+}  // namespace rsn
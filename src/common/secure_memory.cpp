@@ -0,0 +1,298 @@
+// RecoverySoftNetz — locked, non-dumpable memory for privacy mode
+
+#include "common/secure_memory.h"
+
+#include "common/crypto.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t POOL_ALIGN = 16;
+constexpr size_t POOL_ARENA_SIZE = 256 * 1024;
+
+size_t roundUp(size_t size)
+{
+  return (std::max<size_t>(size, 1) + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+}
+
+size_t pageSize()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  long page = ::sysconf(_SC_PAGESIZE);
+  return page > 0 ? static_cast<size_t>(page) : 4096;
+#endif
+}
+
+}  // namespace
+
+std::unique_ptr<LockedRegion> LockedRegion::allocate(size_t size)
+{
+  if (size == 0)
+  {
+    return nullptr;
+  }
+  size_t page = pageSize();
+  size_t mapped = (size + page - 1) / page * page;
+#ifdef _WIN32
+  void* p = VirtualAlloc(nullptr, mapped, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+  if (p == nullptr)
+  {
+    return nullptr;
+  }
+  if (!VirtualLock(p, mapped))
+  {
+    VirtualFree(p, 0, MEM_RELEASE);
+    return nullptr;
+  }
+#else
+  void* p = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+  {
+    return nullptr;
+  }
+  if (::mlock(p, mapped) != 0)
+  {
+    ::munmap(p, mapped);
+    return nullptr;
+  }
+#ifdef MADV_DONTDUMP
+  ::madvise(p, mapped, MADV_DONTDUMP);
+#endif
+#endif
+  return std::unique_ptr<LockedRegion>(new LockedRegion(static_cast<uint8_t*>(p), size, mapped));
+}
+
+LockedRegion::~LockedRegion()
+{
+  secureZero(data_, mapped_);
+#ifdef _WIN32
+  VirtualUnlock(data_, mapped_);
+  VirtualFree(data_, 0, MEM_RELEASE);
+#else
+  ::munlock(data_, mapped_);
+  ::munmap(data_, mapped_);
+#endif
+}
+
+BufferPool::Lease::Lease(Lease&& other) noexcept : pool_(other.pool_), data_(other.data_)
+{
+  other.pool_ = nullptr;
+  other.data_ = nullptr;
+}
+
+BufferPool::Lease& BufferPool::Lease::operator=(Lease&& other) noexcept
+{
+  if (this != &other)
+  {
+    if (data_ != nullptr)
+    {
+      pool_->release(data_);
+    }
+    pool_ = other.pool_;
+    data_ = other.data_;
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
+
+BufferPool::Lease::~Lease()
+{
+  if (data_ != nullptr)
+  {
+    pool_->release(data_);
+  }
+}
+
+std::unique_ptr<BufferPool> BufferPool::create(size_t buffer_size, size_t count, bool secure)
+{
+  if (buffer_size == 0 || count == 0)
+  {
+    return nullptr;
+  }
+  std::unique_ptr<BufferPool> pool(new BufferPool(buffer_size));
+  uint8_t* base = nullptr;
+  if (secure)
+  {
+    pool->region_ = LockedRegion::allocate(buffer_size * count);
+    if (!pool->region_)
+    {
+      return nullptr;
+    }
+    base = pool->region_->data();
+  }
+  else
+  {
+    pool->heap_.reset(new uint8_t[buffer_size * count]);
+    base = pool->heap_.get();
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    pool->free_.push_back(base + i * buffer_size);
+  }
+  return pool;
+}
+
+BufferPool::Lease BufferPool::acquire()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  available_.wait(lock, [this] { return !free_.empty(); });
+  uint8_t* data = free_.back();
+  free_.pop_back();
+  return Lease(this, data);
+}
+
+void BufferPool::release(uint8_t* data)
+{
+  if (region_)
+  {
+    secureZero(data, buffer_size_);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(data);
+  }
+  available_.notify_one();
+}
+
+struct LockedPool::Arena
+{
+  std::unique_ptr<LockedRegion> region;  // null when the arena could not be locked
+  std::unique_ptr<uint8_t[]> heap;
+  uint8_t* base = nullptr;
+  size_t size = 0;
+  std::map<size_t, size_t> free;  // offset -> length, coalesced
+
+  bool owns(const uint8_t* p) const { return p >= base && p < base + size; }
+  bool empty() const { return free.size() == 1 && free.begin()->second == size; }
+};
+
+LockedPool& LockedPool::instance()
+{
+  // Never destroyed: containers with static storage may still free into it
+  // while the process exits.
+  static LockedPool* pool = new LockedPool();
+  return *pool;
+}
+
+LockedPool::LockedPool() = default;
+LockedPool::~LockedPool() = default;
+
+void* LockedPool::allocate(size_t size)
+{
+  size = roundUp(size);
+  std::lock_guard<std::mutex> lock(mutex_);
+  used_ += size;
+  for (auto& arena : arenas_)
+  {
+    for (auto it = arena->free.begin(); it != arena->free.end(); ++it)
+    {
+      if (it->second < size)
+      {
+        continue;
+      }
+      size_t offset = it->first;
+      size_t rest = it->second - size;
+      arena->free.erase(it);
+      if (rest != 0)
+      {
+        arena->free.emplace(offset + size, rest);
+      }
+      return arena->base + offset;
+    }
+  }
+
+  std::unique_ptr<Arena> arena(new Arena());
+  arena->size = std::max(size, POOL_ARENA_SIZE);
+  arena->region = LockedRegion::allocate(arena->size);
+  if (arena->region)
+  {
+    arena->base = arena->region->data();
+  }
+  else
+  {
+    fully_locked_ = false;
+    arena->heap.reset(new uint8_t[arena->size]);
+    arena->base = arena->heap.get();
+  }
+  if (arena->size > size)
+  {
+    arena->free.emplace(size, arena->size - size);
+  }
+  arenas_.push_back(std::move(arena));
+  return arenas_.back()->base;
+}
+
+void LockedPool::free(void* data, size_t size)
+{
+  if (data == nullptr)
+  {
+    return;
+  }
+  size = roundUp(size);
+  secureZero(data, size);
+  uint8_t* p = static_cast<uint8_t*>(data);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto owner = std::find_if(arenas_.begin(), arenas_.end(),
+                            [p](const std::unique_ptr<Arena>& arena) { return arena->owns(p); });
+  if (owner == arenas_.end())
+  {
+    return;
+  }
+  used_ -= size;
+  Arena& arena = **owner;
+  size_t offset = static_cast<size_t>(p - arena.base);
+  size_t length = size;
+  auto next = arena.free.lower_bound(offset);
+  if (next != arena.free.end() && next->first == offset + length)
+  {
+    length += next->second;
+    next = arena.free.erase(next);
+  }
+  auto prev = next == arena.free.begin() ? arena.free.end() : std::prev(next);
+  if (prev != arena.free.end() && prev->first + prev->second == offset)
+  {
+    prev->second += length;
+  }
+  else
+  {
+    arena.free.emplace(offset, length);
+  }
+  // Keep the first arena for reuse; hand later ones back once they drain.
+  if (owner != arenas_.begin() && arena.empty())
+  {
+    arenas_.erase(owner);
+  }
+}
+
+bool LockedPool::fullyLocked() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return fully_locked_;
+}
+
+size_t LockedPool::used() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_;
+}
+
+}  // namespace rsn
@@ -0,0 +1,164 @@
+// RecoverySoftNetz — locked, non-dumpable memory for privacy mode
+//
+// Privacy mode promises that recovered bytes never leave RAM. Every buffer the
+// engine reuses therefore comes from page-aligned regions that are locked
+// against swapping, excluded from core dumps, and wiped with stores the
+// optimizer cannot drop before they are released.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rsn
+{
+
+/// Page-aligned anonymous mapping, locked in RAM (mlock / VirtualLock) and
+/// marked MADV_DONTDUMP where the platform supports it. Wiped and unlocked on
+/// destruction.
+class LockedRegion
+{
+public:
+  /// nullptr when the mapping or the lock fails (typically RLIMIT_MEMLOCK);
+  /// callers in privacy mode must treat that as fatal rather than fall back.
+  static std::unique_ptr<LockedRegion> allocate(size_t size);
+  ~LockedRegion();
+
+  LockedRegion(const LockedRegion&) = delete;
+  LockedRegion& operator=(const LockedRegion&) = delete;
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  LockedRegion(uint8_t* data, size_t size, size_t mapped)
+    : data_(data), size_(size), mapped_(mapped)
+  {
+  }
+
+  uint8_t* data_;
+  size_t size_;
+  size_t mapped_;
+};
+
+/// Fixed number of equally sized buffers shared by worker threads. In secure
+/// mode they live in one LockedRegion and are wiped every time they are
+/// handed back; otherwise they are plain heap memory and released as is.
+class BufferPool
+{
+public:
+  /// Exclusive use of one buffer; returns it to the pool when destroyed.
+  class Lease
+  {
+  public:
+    Lease() = default;
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other) noexcept;
+    ~Lease();
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return pool_ != nullptr ? pool_->buffer_size_ : 0; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+  private:
+    friend class BufferPool;
+    Lease(BufferPool* pool, uint8_t* data) : pool_(pool), data_(data) {}
+
+    BufferPool* pool_ = nullptr;
+    uint8_t* data_ = nullptr;
+  };
+
+  /// nullptr when `secure` is set and the memory cannot be locked.
+  static std::unique_ptr<BufferPool> create(size_t buffer_size, size_t count, bool secure);
+
+  /// Blocks until a buffer is free.
+  Lease acquire();
+
+  bool secure() const { return region_ != nullptr; }
+  size_t bufferSize() const { return buffer_size_; }
+
+private:
+  BufferPool(size_t buffer_size) : buffer_size_(buffer_size) {}
+
+  void release(uint8_t* data);
+
+  size_t buffer_size_;
+  std::unique_ptr<LockedRegion> region_;
+  std::unique_ptr<uint8_t[]> heap_;
+  std::mutex mutex_;
+  std::condition_variable available_;
+  std::vector<uint8_t*> free_;
+};
+
+/// Process-wide heap for small secrets and the byte copies stages take off
+/// the device. Blocks are carved first-fit from LockedRegion arenas and wiped
+/// when freed. Once the lock limit is reached, new arenas are ordinary heap
+/// memory that is still wiped on release; `fullyLocked()` then turns false.
+class LockedPool
+{
+public:
+  static LockedPool& instance();
+
+  /// Never nullptr; sizes are rounded up to 16 bytes.
+  void* allocate(size_t size);
+  /// Wipe and return a block; `size` is the size it was allocated with.
+  void free(void* data, size_t size);
+
+  /// False once any arena had to be left unlocked.
+  bool fullyLocked() const;
+  /// Bytes currently handed out, for tests and diagnostics.
+  size_t used() const;
+
+  LockedPool(const LockedPool&) = delete;
+  LockedPool& operator=(const LockedPool&) = delete;
+
+private:
+  struct Arena;
+
+  LockedPool();
+  ~LockedPool();
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Arena>> arenas_;
+  size_t used_ = 0;
+  bool fully_locked_ = true;
+};
+
+/// std::allocator replacement over LockedPool: containers using it keep their
+/// bytes out of swap and wipe every buffer they free, including the ones a
+/// growing vector leaves behind when it reallocates.
+template <typename T>
+struct SecureAllocator
+{
+  using value_type = T;
+
+  SecureAllocator() = default;
+  template <typename U>
+  SecureAllocator(const SecureAllocator<U>&) noexcept
+  {
+  }
+
+  T* allocate(size_t n) { return static_cast<T*>(LockedPool::instance().allocate(n * sizeof(T))); }
+  void deallocate(T* p, size_t n) noexcept { LockedPool::instance().free(p, n * sizeof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const SecureAllocator<T>&, const SecureAllocator<U>&)
+{
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const SecureAllocator<T>&, const SecureAllocator<U>&)
+{
+  return false;
+}
+
+/// Byte buffer for key material and other plaintext copied out of the device.
+using SecureBytes = std::vector<uint8_t, SecureAllocator<uint8_t>>;
+
+}  // namespace rsn
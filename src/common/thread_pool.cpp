@@ -0,0 +1,80 @@
+// RecoverySoftNetz — fixed-size worker pool
+
+#include "common/thread_pool.h"
+
+namespace rsn
+{
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+  if (threads == 0)
+  {
+    threads = std::thread::hardware_concurrency();
+  }
+  if (threads == 0)
+  {
+    threads = 1;
+  }
+  for (unsigned i = 0; i < threads; ++i)
+  {
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (auto& worker : workers_)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(task));
+  }
+  work_ready_.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return queue_.empty() && active_ == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+  for (;;)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty())
+      {
+        return;  // stopping and drained
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+      ++active_;
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --active_;
+      if (queue_.empty() && active_ == 0)
+      {
+        idle_.notify_all();
+      }
+    }
+  }
+}
+
+}  // namespace rsn
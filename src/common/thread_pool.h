@@ -0,0 +1,51 @@
+// RecoverySoftNetz — fixed-size worker pool
+//
+// FIFO task queue served by a fixed set of threads. Used for work that is
+// discovered while the carve pipeline streams (candidate validation, hive or
+// log parsing) and must not stall the chunk readers.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rsn
+{
+
+class ThreadPool
+{
+public:
+  /// Start `threads` workers (0 = hardware concurrency).
+  explicit ThreadPool(unsigned threads = 0);
+
+  /// Drains the queue, then joins the workers.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void submit(std::function<void()> task);
+
+  /// Block until every submitted task has finished.
+  void wait();
+
+  unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable idle_;
+  size_t active_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace rsn
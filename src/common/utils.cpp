@@ -0,0 +1,170 @@
+// RecoverySoftNetz — shared low-level helpers
+
+#include "common/utils.h"
+
+#include <array>
+
+namespace rsn
+{
+
+size_t findBytes(ByteView hay, const void* needle, size_t needle_len)
+{
+  if (needle_len == 0)
+  {
+    return 0;
+  }
+  if (needle_len > hay.size)
+  {
+    return SIZE_MAX;
+  }
+  const auto* n = static_cast<const uint8_t*>(needle);
+  const uint8_t* p = hay.data;
+  const uint8_t* last = hay.data + (hay.size - needle_len);
+  while (p <= last)
+  {
+    const void* hit = std::memchr(p, n[0], static_cast<size_t>(last - p) + 1);
+    if (hit == nullptr)
+    {
+      break;
+    }
+    p = static_cast<const uint8_t*>(hit);
+    if (std::memcmp(p, n, needle_len) == 0)
+    {
+      return static_cast<size_t>(p - hay.data);
+    }
+    ++p;
+  }
+  return SIZE_MAX;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+  static const auto TABLE = []
+  {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+      {
+        c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    return table;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+  {
+    crc = TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc)
+{
+  static const auto TABLE = []
+  {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+      {
+        c = (c & 1) != 0 ? 0x82F63B78 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    return table;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+  {
+    crc = TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+std::string toHex(const uint8_t* data, size_t size)
+{
+  static const char DIGITS[] = "0123456789abcdef";
+  std::string out;
+  out.resize(size * 2);
+  for (size_t i = 0; i < size; ++i)
+  {
+    out[2 * i] = DIGITS[data[i] >> 4];
+    out[2 * i + 1] = DIGITS[data[i] & 0x0f];
+  }
+  return out;
+}
+
+bool fromHex(const std::string& text, std::vector<uint8_t>& out)
+{
+  if (text.size() % 2 != 0)
+  {
+    return false;
+  }
+  out.resize(text.size() / 2);
+  for (size_t i = 0; i < text.size(); ++i)
+  {
+    auto c = static_cast<uint8_t>(text[i]);
+    if (!isHexDigit(c))
+    {
+      return false;
+    }
+    uint8_t v = c <= '9' ? static_cast<uint8_t>(c - '0')
+                         : static_cast<uint8_t>((c | 0x20) - 'a' + 10);
+    out[i / 2] = static_cast<uint8_t>((out[i / 2] << 4) | v);
+  }
+  return true;
+}
+
+void appendUtf8(std::string& out, uint32_t cp)
+{
+  if (cp > 0x10FFFF)
+  {
+    cp = 0xFFFD;
+  }
+  if (cp < 0x80)
+  {
+    out += static_cast<char>(cp);
+  }
+  else if (cp < 0x800)
+  {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+void appendUtf16BE(std::string& out, const uint8_t* p, size_t size)
+{
+  for (size_t i = 0; i + 1 < size; i += 2)
+  {
+    uint32_t cp = loadBE16(p + i);
+    if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < size)
+    {
+      uint32_t low = loadBE16(p + i + 2);
+      if (low >= 0xDC00 && low < 0xE000)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        i += 2;
+      }
+    }
+    appendUtf8(out, cp >= 0xD800 && cp < 0xE000 ? 0xFFFD : cp);
+  }
+}
+
+}  // namespace rsn
@@ -0,0 +1,137 @@
+// RecoverySoftNetz — shared low-level helpers
+//
+// Byte-order loaders and small span helpers used by every parser and carver.
+// All loaders are unaligned-safe and never touch memory outside [p, p + N).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+inline uint16_t loadLE16(const uint8_t* p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t loadLE32(const uint8_t* p)
+{
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline uint64_t loadLE64(const uint8_t* p)
+{
+  return static_cast<uint64_t>(loadLE32(p)) | (static_cast<uint64_t>(loadLE32(p + 4)) << 32);
+}
+
+inline uint16_t loadBE16(const uint8_t* p)
+{
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline uint32_t loadBE32(const uint8_t* p)
+{
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline uint64_t loadBE64(const uint8_t* p)
+{
+  return (static_cast<uint64_t>(loadBE32(p)) << 32) | static_cast<uint64_t>(loadBE32(p + 4));
+}
+
+inline void storeLE32(uint8_t* p, uint32_t v)
+{
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+inline void storeLE64(uint8_t* p, uint64_t v)
+{
+  storeLE32(p, static_cast<uint32_t>(v));
+  storeLE32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+inline void storeBE32(uint8_t* p, uint32_t v)
+{
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+inline void storeBE64(uint8_t* p, uint64_t v)
+{
+  storeBE32(p, static_cast<uint32_t>(v >> 32));
+  storeBE32(p + 4, static_cast<uint32_t>(v));
+}
+
+/// Non-owning view over a contiguous byte range.
+struct ByteView
+{
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  ByteView() = default;
+  ByteView(const uint8_t* d, size_t n) : data(d), size(n) {}
+
+  bool empty() const { return size == 0; }
+  const uint8_t& operator[](size_t i) const { return data[i]; }
+
+  // Sub-range clamped to the view; never reads out of bounds.
+  ByteView sub(size_t pos, size_t len = SIZE_MAX) const
+  {
+    if (pos >= size)
+    {
+      return ByteView(data + size, 0);
+    }
+    return ByteView(data + pos, len < size - pos ? len : size - pos);
+  }
+
+  bool startsWith(const char* lit, size_t n) const
+  {
+    return size >= n && std::memcmp(data, lit, n) == 0;
+  }
+};
+
+/// Locate `needle` in `hay`; returns SIZE_MAX when absent.
+size_t findBytes(ByteView hay, const void* needle, size_t needle_len);
+
+/// CRC-32 as ZIP, PNG and gzip use it, continuing from `crc` (0 to start).
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/// CRC-32C (Castagnoli) as InnoDB and iSCSI use it, continuing from `crc`.
+uint32_t crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+
+/// Lower-case hex encoding of a byte range.
+std::string toHex(const uint8_t* data, size_t size);
+
+/// Decode an even-length hex string; false on any non-hex digit.
+bool fromHex(const std::string& text, std::vector<uint8_t>& out);
+
+/// Append code point `cp` as UTF-8; values past U+10FFFF become U+FFFD.
+void appendUtf8(std::string& out, uint32_t cp);
+
+/// Append `size` bytes of UTF-16BE as UTF-8. Surrogate pairs are combined into
+/// one code point; an unpaired surrogate becomes U+FFFD.
+void appendUtf16BE(std::string& out, const uint8_t* p, size_t size);
+
+inline bool isHexDigit(uint8_t c)
+{
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+inline bool isPowerOfTwo(uint64_t v)
+{
+  return v != 0 && (v & (v - 1)) == 0;
+}
+
+}  // namespace rsn
@@ -0,0 +1,370 @@
+// RecoverySoftNetz — Xpress (LZ77 and LZ77+Huffman) decoder
+
+#include "common/xpress.h"
+
+#include "common/utils.h"
+
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr int SYMBOLS = 512;
+constexpr int MAX_BITS = 15;
+constexpr int FAST_BITS = 10;
+constexpr size_t TABLE_SIZE = SYMBOLS / 2;
+constexpr size_t HUFFMAN_BLOCK = 65536;  // output bytes per code-length table
+
+/// Copy a match of `length` bytes from `distance` back. Overlapping matches
+/// repeat the bytes they have just written, so they go byte by byte.
+inline void copyMatch(uint8_t* out, size_t distance, size_t length)
+{
+  const uint8_t* from = out - distance;
+  if (distance >= 8)
+  {
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+      std::memcpy(out + i, from + i, 8);
+    }
+    for (; i < length; ++i)
+    {
+      out[i] = from[i];
+    }
+    return;
+  }
+  for (size_t i = 0; i < length; ++i)
+  {
+    out[i] = from[i];
+  }
+}
+
+/// Canonical code of one LZ77+Huffman block: codes of up to FAST_BITS bits
+/// are looked up directly, longer ones through the first code of each length.
+class HuffmanCode
+{
+public:
+  bool build(const uint8_t* table)
+  {
+    uint16_t count[MAX_BITS + 1] = {};
+    uint8_t lengths[SYMBOLS];
+    for (int s = 0; s < SYMBOLS; ++s)
+    {
+      lengths[s] = static_cast<uint8_t>(s % 2 == 0 ? table[s / 2] & 0x0F : table[s / 2] >> 4);
+      ++count[lengths[s]];
+    }
+    if (count[0] == SYMBOLS)
+    {
+      return false;
+    }
+    int left = 1;
+    for (int len = 1; len <= MAX_BITS; ++len)
+    {
+      left = left * 2 - count[len];
+      if (left < 0)
+      {
+        return false;
+      }
+    }
+    std::memset(fast_, 0, sizeof(fast_));
+    uint32_t code = 0;
+    uint16_t index = 0;
+    for (int len = 1; len <= MAX_BITS; ++len)
+    {
+      first_code_[len] = code;
+      first_index_[len] = index;
+      count_[len] = count[len];
+      for (int s = 0; s < SYMBOLS; ++s)
+      {
+        if (lengths[s] != len)
+        {
+          continue;
+        }
+        sorted_[index++] = static_cast<uint16_t>(s);
+        if (len <= FAST_BITS)
+        {
+          uint32_t from = code << (FAST_BITS - len);
+          uint32_t n = 1u << (FAST_BITS - len);
+          for (uint32_t i = 0; i < n; ++i)
+          {
+            fast_[from + i] = static_cast<uint16_t>((s << 4) | len);
+          }
+        }
+        ++code;
+      }
+      code <<= 1;
+    }
+    return true;
+  }
+
+  /// Symbol << 4 | code length for the code at the top of `bits`; 0 when
+  /// no code matches.
+  uint32_t decode(uint32_t bits) const
+  {
+    uint16_t entry = fast_[bits >> (32 - FAST_BITS)];
+    if (entry != 0)
+    {
+      return entry;
+    }
+    for (int len = FAST_BITS + 1; len <= MAX_BITS; ++len)
+    {
+      uint32_t code = bits >> (32 - len);
+      if (code - first_code_[len] < count_[len])
+      {
+        return (uint32_t(sorted_[first_index_[len] + code - first_code_[len]]) << 4) | len;
+      }
+    }
+    return 0;
+  }
+
+private:
+  uint16_t fast_[1u << FAST_BITS];
+  uint32_t first_code_[MAX_BITS + 1] = {};
+  uint16_t first_index_[MAX_BITS + 1] = {};
+  uint16_t count_[MAX_BITS + 1] = {};
+  uint16_t sorted_[SYMBOLS] = {};
+};
+
+}  // namespace
+
+bool xpressDecompress(const uint8_t* data, size_t size, uint8_t* output, size_t output_size,
+                      size_t* consumed)
+{
+  size_t in = 0;
+  size_t out = 0;
+  uint32_t flags = 0;
+  int flag_count = 0;
+  size_t half_byte = 0;  // input byte whose high nibble holds the next length
+  bool ok = true;
+  while (out < output_size)
+  {
+    if (flag_count == 0)
+    {
+      if (size - in < 4)
+      {
+        ok = false;
+        break;
+      }
+      flags = loadLE32(data + in);
+      in += 4;
+      flag_count = 32;
+    }
+    --flag_count;
+    if ((flags & (1u << flag_count)) == 0)
+    {
+      if (in == size)
+      {
+        ok = false;
+        break;
+      }
+      output[out++] = data[in++];
+      continue;
+    }
+    if (size - in < 2)
+    {
+      ok = false;
+      break;
+    }
+    uint32_t match = loadLE16(data + in);
+    in += 2;
+    size_t length = match % 8;
+    size_t distance = match / 8 + 1;
+    if (length == 7)
+    {
+      if (half_byte == 0)
+      {
+        if (in == size)
+        {
+          ok = false;
+          break;
+        }
+        length = data[in] % 16;
+        half_byte = ++in;
+      }
+      else
+      {
+        length = data[half_byte - 1] / 16;
+        half_byte = 0;
+      }
+      if (length == 15)
+      {
+        if (in == size)
+        {
+          ok = false;
+          break;
+        }
+        length = data[in++];
+        if (length == 255)
+        {
+          if (size - in < 2)
+          {
+            ok = false;
+            break;
+          }
+          length = loadLE16(data + in);
+          in += 2;
+          if (length == 0)
+          {
+            if (size - in < 4)
+            {
+              ok = false;
+              break;
+            }
+            length = loadLE32(data + in);
+            in += 4;
+          }
+          if (length < 15 + 7)
+          {
+            ok = false;
+            break;
+          }
+          length -= 15 + 7;
+        }
+        length += 15;
+      }
+      length += 7;
+    }
+    length += 3;
+    if (distance > out || length > output_size - out)
+    {
+      // A match may run past the end of the output only at its very end.
+      if (distance > out)
+      {
+        ok = false;
+        break;
+      }
+      length = output_size - out;
+    }
+    copyMatch(output + out, distance, length);
+    out += length;
+  }
+  if (consumed != nullptr)
+  {
+    *consumed = in;
+  }
+  return ok;
+}
+
+bool xpressHuffmanDecompress(const uint8_t* data, size_t size, uint8_t* output,
+                             size_t output_size, size_t* consumed)
+{
+  HuffmanCode code;
+  size_t in = 0;
+  size_t out = 0;
+  // Reads past the end of the input supply zero bits; the compressor pads the
+  // last word, so only a decode that then goes on is truncated.
+  auto word = [&]() -> uint32_t {
+    uint32_t w = in + 2 <= size ? loadLE16(data + in) : 0;
+    in += 2;
+    return w;
+  };
+  bool ok = true;
+  while (ok && out < output_size)
+  {
+    if (in > size || size - in < TABLE_SIZE || !code.build(data + in))
+    {
+      ok = false;
+      break;
+    }
+    in += TABLE_SIZE;
+    uint32_t bits = word() << 16;
+    bits |= word();
+    int extra = 16;
+    size_t block_end = output_size - out > HUFFMAN_BLOCK ? out + HUFFMAN_BLOCK : output_size;
+    while (out < block_end)
+    {
+      uint32_t entry = code.decode(bits);
+      if (entry == 0 || in > size + 4)
+      {
+        ok = false;
+        break;
+      }
+      int length_bits = entry & 0x0F;
+      uint32_t symbol = entry >> 4;
+      bits <<= length_bits;
+      extra -= length_bits;
+      if (extra < 0)
+      {
+        bits |= word() << -extra;
+        extra += 16;
+      }
+      if (symbol < 256)
+      {
+        output[out++] = static_cast<uint8_t>(symbol);
+        continue;
+      }
+      symbol -= 256;
+      size_t length = symbol & 0x0F;
+      int offset_bits = static_cast<int>(symbol >> 4);
+      if (length == 15)
+      {
+        if (in >= size)
+        {
+          ok = false;
+          break;
+        }
+        length = data[in++];
+        if (length == 255)
+        {
+          if (in + 2 > size)
+          {
+            ok = false;
+            break;
+          }
+          length = loadLE16(data + in);
+          in += 2;
+          if (length == 0)
+          {
+            if (in + 4 > size)
+            {
+              ok = false;
+              break;
+            }
+            length = loadLE32(data + in);
+            in += 4;
+          }
+          if (length < 15)
+          {
+            ok = false;
+            break;
+          }
+          length -= 15;
+        }
+        length += 15;
+      }
+      length += 3;
+      size_t distance = ((bits >> 1) >> (31 - offset_bits)) + (size_t(1) << offset_bits);
+      bits <<= offset_bits;
+      extra -= offset_bits;
+      if (extra < 0)
+      {
+        bits |= word() << -extra;
+        extra += 16;
+      }
+      if (distance > out)
+      {
+        ok = false;
+        break;
+      }
+      length = length < output_size - out ? length : output_size - out;
+      copyMatch(output + out, distance, length);
+      out += length;
+    }
+  }
+  if (consumed != nullptr)
+  {
+    *consumed = in < size ? in : size;
+  }
+  return ok;
+}
+
+bool xpressHuffmanTable(const uint8_t* table)
+{
+  HuffmanCode code;
+  return code.build(table);
+}
+
+}  // namespace rsn
@@ -0,0 +1,35 @@
+// RecoverySoftNetz — Xpress (LZ77 and LZ77+Huffman) decoder
+//
+// The two Xpress formats of [MS-XCA], as Windows uses them for hibernation
+// files, the memory compression store and WIM/WOF resources: plain LZ77 with
+// 32-bit flag words, and LZ77+Huffman, where every 64 KiB of output starts
+// with a table of 512 four-bit code lengths. Neither format records its
+// output size, so the caller gives it, and the decoders fill exactly that
+// many bytes into a fixed buffer: no allocation, and the hot loops copy
+// matches eight bytes at a time where they do not overlap. Malformed input
+// (an over-subscribed code, a match reaching before the output start, input
+// running out) fails the decode.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rsn
+{
+
+/// Decode plain LZ77 Xpress data into `output` until `output_size` bytes are
+/// written. False on malformed or truncated input. `consumed`, when given,
+/// receives the input bytes used.
+bool xpressDecompress(const uint8_t* data, size_t size, uint8_t* output, size_t output_size,
+                      size_t* consumed = nullptr);
+
+/// Decode LZ77+Huffman Xpress data, likewise.
+bool xpressHuffmanDecompress(const uint8_t* data, size_t size, uint8_t* output,
+                             size_t output_size, size_t* consumed = nullptr);
+
+/// Whether the 256 bytes at `table` form a code-length table an LZ77+Huffman
+/// block can start with: not empty and not over-subscribed.
+bool xpressHuffmanTable(const uint8_t* table);
+
+}  // namespace rsn
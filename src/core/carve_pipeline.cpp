@@ -0,0 +1,293 @@
+// RecoverySoftNetz — streaming carve pipeline
+
+#include "core/carve_pipeline.h"
+
+#include "common/secure_memory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint64_t JUDGE_INTERVAL = 1024;  // validated hits between two looks at a signature
+
+}  // namespace
+
+SecureBytes CarveContext::readAt(uint64_t offset, size_t length)
+{
+  SecureBytes out(length);
+  out.resize(device_.read(offset, out.data(), length));
+  return out;
+}
+
+void PatternSet::add(const void* bytes, size_t length, uint32_t tag)
+{
+  if (length == 0)
+  {
+    return;
+  }
+  uint32_t id = matcher_.addPattern(bytes, length);
+  if (routes_.size() <= id)
+  {
+    routes_.resize(id + 1);
+    labels_.resize(id + 1);
+  }
+  routes_[id] = {stage_, tag};
+  labels_[id] = toHex(static_cast<const uint8_t*>(bytes), length);
+}
+
+bool CarvePipeline::compile()
+{
+  std::lock_guard<std::mutex> lock(judge_mutex_);
+  matcher_ = MultiPatternMatcher();
+  routes_.clear();
+  labels_.clear();
+  chunk_stages_.clear();
+  deferred_.clear();
+  size_t lookahead = 0;
+  for (size_t i = 0; i < stages_.size(); ++i)
+  {
+    PatternSet set(matcher_, routes_, labels_, i);
+    stages_[i]->registerPatterns(set);
+    if (stages_[i]->wantsChunks())
+    {
+      chunk_stages_.push_back(stages_[i]);
+    }
+    deferred_.push_back(stages_[i]->defersValidation());
+    lookahead = std::max(lookahead, stages_[i]->lookahead());
+  }
+  if (matcher_.patternCount() > 0)
+  {
+    matcher_.compile();
+  }
+  signatures_ = std::make_unique<Signature[]>(matcher_.patternCount());
+  size_t pattern_tail = matcher_.maxPatternLength() > 0 ? matcher_.maxPatternLength() - 1 : 0;
+  overlap_ = std::max(lookahead, pattern_tail);
+  return matcher_.compiled() || !chunk_stages_.empty();
+}
+
+void CarvePipeline::scanChunk(const ChunkView& chunk, CarveContext& ctx, uint64_t& hits,
+                              uint64_t& skipped)
+{
+  if (matcher_.compiled())
+  {
+    matcher_.scan(chunk.data, chunk.size, [&](uint32_t id, size_t pos) {
+      if (pos >= chunk.body)
+      {
+        return;  // owned by the next chunk
+      }
+      ++hits;
+      Signature& signature = signatures_[id];
+      uint64_t seen = signature.hits.fetch_add(1, std::memory_order_relaxed);
+      SignatureState state = signature.state.load(std::memory_order_relaxed);
+      unsigned sample = std::max(1u, options_.adaptive_sample);
+      if (state == SignatureState::Disabled ||
+          (state == SignatureState::Throttled && seen % sample != 0))
+      {
+        ++skipped;
+        return;
+      }
+      const auto& route = routes_[id];
+      auto started = std::chrono::steady_clock::now();
+      bool accepted = stages_[route.first]->onHit(route.second, pos, chunk, ctx);
+      auto spent = std::chrono::steady_clock::now() - started;
+      signature.nanoseconds.fetch_add(
+        static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count()),
+        std::memory_order_relaxed);
+      bool deferred = deferred_[route.first];
+      if (accepted && !deferred)
+      {
+        signature.accepted.fetch_add(1, std::memory_order_relaxed);
+      }
+      uint64_t validated = signature.validated.fetch_add(1, std::memory_order_relaxed) + 1;
+      if (options_.adaptive && !deferred && validated % JUDGE_INTERVAL == 0)
+      {
+        judge(id);
+      }
+    });
+  }
+  for (CarveStage* stage : chunk_stages_)
+  {
+    stage->onChunk(chunk, ctx);
+  }
+}
+
+bool CarvePipeline::run(Device& device, FileRegistry& registry)
+{
+  auto started = std::chrono::steady_clock::now();
+  stats_ = PipelineStats();
+  cancelled_.store(false);
+  if (stages_.empty() || (options_.memory_only && registry.spillsPlaintext()) || !compile())
+  {
+    return false;
+  }
+
+  uint64_t end = std::min(options_.end, device.size());
+  uint64_t start = options_.start;
+  if (start >= end)
+  {
+    return false;
+  }
+  size_t chunk_size = std::max<size_t>(options_.chunk_size, 64 * 1024);
+  uint64_t chunk_count = (end - start + chunk_size - 1) / chunk_size;
+
+  unsigned threads = options_.threads != 0 ? options_.threads : std::thread::hardware_concurrency();
+  threads = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(threads, chunk_count)));
+
+  // One buffer per worker, held for the whole run; in privacy mode they are
+  // locked and wiped as the leases end.
+  auto buffers = BufferPool::create(chunk_size + overlap_, threads, options_.memory_only);
+  if (!buffers)
+  {
+    return false;
+  }
+
+  CarveContext ctx(device, registry);
+  std::atomic<uint64_t> next_chunk{0};
+  std::atomic<uint64_t> total_hits{0};
+  std::atomic<uint64_t> total_skipped{0};
+  std::atomic<uint64_t> total_bytes{0};
+
+  auto worker = [&]() {
+    BufferPool::Lease buffer = buffers->acquire();
+    uint64_t hits = 0;
+    uint64_t skipped = 0;
+    uint64_t bytes = 0;
+    for (;;)
+    {
+      uint64_t index = next_chunk.fetch_add(1);
+      if (index >= chunk_count || cancelled_.load(std::memory_order_relaxed))
+      {
+        break;
+      }
+      ChunkView chunk;
+      chunk.offset = start + index * chunk_size;
+      size_t want = static_cast<size_t>(std::min<uint64_t>(buffer.size(), end - chunk.offset));
+      chunk.data = buffer.data();
+      chunk.size = device.read(chunk.offset, buffer.data(), want);
+      chunk.body = std::min(chunk.size, chunk_size);
+      if (chunk.size == 0)
+      {
+        continue;
+      }
+      scanChunk(chunk, ctx, hits, skipped);
+      bytes += chunk.body;
+    }
+    total_hits += hits;
+    total_skipped += skipped;
+    total_bytes += bytes;
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+  {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& th : pool)
+  {
+    th.join();
+  }
+
+  for (CarveStage* stage : stages_)
+  {
+    stage->finish(ctx);
+  }
+  for (uint32_t id = 0; id < matcher_.patternCount(); ++id)
+  {
+    const auto& route = routes_[id];
+    if (deferred_[route.first])
+    {
+      signatures_[id].accepted.store(stages_[route.first]->acceptedHits(route.second));
+    }
+  }
+
+  stats_.bytes_scanned = total_bytes.load();
+  stats_.hits = total_hits.load();
+  stats_.skipped = total_skipped.load();
+  stats_.chunks = chunk_count;
+  stats_.seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  return true;
+}
+
+/// Look at a signature's yield since its state last changed. An active one
+/// that has cost `adaptive_min_cost` at a yield under `adaptive_min_yield` is
+/// throttled; a throttled one is disabled when its sample accepts nothing, and
+/// made active again when the sample's yield recovers.
+void CarvePipeline::judge(uint32_t id)
+{
+  Signature& signature = signatures_[id];
+  {
+    std::lock_guard<std::mutex> lock(judge_mutex_);
+    uint64_t validated = signature.validated.load(std::memory_order_relaxed);
+    uint64_t accepted = signature.accepted.load(std::memory_order_relaxed);
+    uint64_t nanoseconds = signature.nanoseconds.load(std::memory_order_relaxed);
+    uint64_t window = validated - signature.base_validated;
+    uint64_t yield = accepted - signature.base_accepted;
+    if (window < options_.adaptive_min_hits)
+    {
+      return;
+    }
+    bool poor = static_cast<double>(yield) <
+                options_.adaptive_min_yield * static_cast<double>(window);
+    SignatureState state = signature.state.load(std::memory_order_relaxed);
+    SignatureState next = state;
+    if (state == SignatureState::Active && poor &&
+        nanoseconds - signature.base_nanoseconds >= options_.adaptive_min_cost)
+    {
+      next = SignatureState::Throttled;
+    }
+    else if (state == SignatureState::Throttled)
+    {
+      next = yield == 0 ? SignatureState::Disabled
+             : poor     ? SignatureState::Throttled
+                        : SignatureState::Active;
+    }
+    if (next == state)
+    {
+      return;
+    }
+    signature.state.store(next, std::memory_order_relaxed);
+    signature.base_validated = validated;
+    signature.base_accepted = accepted;
+    signature.base_nanoseconds = nanoseconds;
+  }
+  if (options_.on_signature)
+  {
+    options_.on_signature(snapshot(id));
+  }
+}
+
+SignatureStats CarvePipeline::snapshot(uint32_t id) const
+{
+  const Signature& signature = signatures_[id];
+  SignatureStats out;
+  out.stage = stages_[routes_[id].first]->name();
+  out.pattern = labels_[id];
+  out.tag = routes_[id].second;
+  out.hits = signature.hits.load(std::memory_order_relaxed);
+  out.validated = signature.validated.load(std::memory_order_relaxed);
+  out.accepted = signature.accepted.load(std::memory_order_relaxed);
+  out.nanoseconds = signature.nanoseconds.load(std::memory_order_relaxed);
+  out.state = signature.state.load(std::memory_order_relaxed);
+  return out;
+}
+
+std::vector<SignatureStats> CarvePipeline::signatureStats() const
+{
+  std::lock_guard<std::mutex> lock(judge_mutex_);
+  std::vector<SignatureStats> out;
+  for (uint32_t id = 0; signatures_ && id < matcher_.patternCount(); ++id)
+  {
+    out.push_back(snapshot(id));
+  }
+  return out;
+}
+
+}  // namespace rsn
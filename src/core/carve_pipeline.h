@@ -0,0 +1,249 @@
+// RecoverySoftNetz — streaming carve pipeline
+//
+// Reads the device once, in fixed-size chunks, and feeds every chunk to all
+// registered stages. Stage signatures are compiled into one shared
+// MultiPatternMatcher so the per-byte cost does not grow with the number of
+// stages or signatures; stages only see the hits that belong to them and
+// confirm candidates with their own structural validators.
+//
+// Chunks carry a read-ahead tail so that a pattern straddling a chunk boundary
+// is still seen in full. A hit is owned by the chunk in which it starts, so
+// every hit is reported exactly once.
+//
+// Every signature keeps live counters: hits, how many of those its stage
+// accepted, and the time the stage spent on them. A weak signature (two bytes
+// of a common header) can bury the scan in candidates that all fail
+// validation; once one has cost enough time at a pathologically low yield it
+// is throttled to validating a sample of its hits, and disabled when the
+// sample yields nothing. Every change is reported through `on_signature` and
+// the final counters through `signatureStats`. Stages that only validate in
+// `finish` are not judged; their yield is filled in once they are done.
+
+#pragma once
+
+#include "common/secure_memory.h"
+#include "common/utils.h"
+#include "core/device.h"
+#include "core/file_registry.h"
+#include "core/pattern_matcher.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+struct ChunkView
+{
+  uint64_t offset = 0;          // device offset of data[0]
+  const uint8_t* data = nullptr;
+  size_t size = 0;              // valid bytes, including the read-ahead tail
+  size_t body = 0;              // bytes owned by this chunk (hits starting before it)
+
+  ByteView view() const { return ByteView(data, size); }
+};
+
+/// Services available to stages while the pipeline runs.
+class CarveContext
+{
+public:
+  CarveContext(Device& device, FileRegistry& registry) : device_(device), registry_(registry) {}
+
+  Device& device() { return device_; }
+  FileRegistry& registry() { return registry_; }
+
+  /// Read up to `length` bytes at `offset`; the result is shorter at end of media.
+  /// The copy lives in the locked pool and is wiped when released.
+  SecureBytes readAt(uint64_t offset, size_t length);
+
+private:
+  Device& device_;
+  FileRegistry& registry_;
+};
+
+/// Collects the literal signatures of one stage at pipeline compile time.
+class PatternSet
+{
+public:
+  void add(const void* bytes, size_t length, uint32_t tag);
+  void add(const std::string& literal, uint32_t tag) { add(literal.data(), literal.size(), tag); }
+
+private:
+  friend class CarvePipeline;
+  PatternSet(MultiPatternMatcher& matcher, std::vector<std::pair<size_t, uint32_t>>& routes,
+             std::vector<std::string>& labels, size_t stage)
+    : matcher_(matcher), routes_(routes), labels_(labels), stage_(stage)
+  {
+  }
+
+  MultiPatternMatcher& matcher_;
+  std::vector<std::pair<size_t, uint32_t>>& routes_;
+  std::vector<std::string>& labels_;
+  size_t stage_;
+};
+
+class CarveStage
+{
+public:
+  virtual ~CarveStage() = default;
+
+  virtual const char* name() const = 0;
+
+  /// Declare the literal signatures this stage wants to be told about.
+  virtual void registerPatterns(PatternSet& patterns) = 0;
+
+  /// Called from worker threads for every owned hit of one of this stage's
+  /// patterns; `pos` is the start of the match within `chunk`. Returns true
+  /// when the hit checked out: a file was registered, or the hit passed a
+  /// structural check and was kept for `finish`. The pipeline judges each
+  /// signature's yield by it.
+  virtual bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) = 0;
+
+  /// Stages that only collect offsets in `onHit` and decide in `finish`
+  /// return true. Their signatures are never throttled, since their yield is
+  /// not known while the scan runs; after `finish` the accepted counter of
+  /// each is set from `acceptedHits`.
+  virtual bool defersValidation() const { return false; }
+
+  /// Hits of `tag` that `finish` made use of, for stages deferring validation.
+  virtual uint64_t acceptedHits(uint32_t tag) const
+  {
+    (void)tag;
+    return 0;
+  }
+
+  /// Stages that scan raw bytes themselves (tokenizers, run detectors) return true
+  /// and receive every chunk through `onChunk`.
+  virtual bool wantsChunks() const { return false; }
+  virtual void onChunk(const ChunkView& chunk, CarveContext& ctx)
+  {
+    (void)chunk;
+    (void)ctx;
+  }
+
+  /// Bytes of read-ahead this stage needs past the chunk body.
+  virtual size_t lookahead() const { return 0; }
+
+  /// Called once on the calling thread after the last chunk.
+  virtual void finish(CarveContext& ctx) { (void)ctx; }
+};
+
+enum class SignatureState : uint8_t
+{
+  Active,     // every hit is validated
+  Throttled,  // one hit in `adaptive_sample` is validated
+  Disabled,   // hits are dropped
+};
+
+struct SignatureStats
+{
+  std::string stage;
+  std::string pattern;  // signature bytes, hex
+  uint32_t tag = 0;
+  uint64_t hits = 0;         // owned hits
+  uint64_t validated = 0;    // hits passed to the stage
+  uint64_t accepted = 0;     // validated hits that checked out
+  uint64_t nanoseconds = 0;  // spent in the stage validating
+  SignatureState state = SignatureState::Active;
+
+  double yield() const
+  {
+    return validated != 0 ? static_cast<double>(accepted) / static_cast<double>(validated) : 0.0;
+  }
+};
+
+/// Told about a signature when its state changes; called from a worker thread.
+using SignatureCallback = std::function<void(const SignatureStats& signature)>;
+
+struct PipelineOptions
+{
+  size_t chunk_size = 8u << 20;  // bytes per chunk body
+  unsigned threads = 0;          // 0 = hardware concurrency
+  uint64_t start = 0;            // first device byte to scan
+  uint64_t end = UINT64_MAX;     // one past the last byte (clamped to device size)
+  // Privacy mode: the chunk buffers, which hold every byte scanned, are locked,
+  // non-dumpable and wiped, and `run` refuses a registry that spills in
+  // plaintext. `CarveContext::readAt` copies come from the locked pool in
+  // every mode; the stages' own windows and piece maps and the registry's
+  // resident entries are ordinary heap memory, not locked or wiped.
+  bool memory_only = false;
+
+  bool adaptive = true;                     // throttle and disable low-yield signatures
+  uint64_t adaptive_min_hits = 20000;       // validated hits before a signature is judged
+  double adaptive_min_yield = 1e-4;         // accepted per validated hit; below it, a signature
+  uint64_t adaptive_min_cost = 1000000000;  // ... that has cost this many ns is throttled
+  unsigned adaptive_sample = 16;            // a throttled signature validates 1 hit in this many
+  SignatureCallback on_signature;           // may be empty
+};
+
+struct PipelineStats
+{
+  uint64_t bytes_scanned = 0;
+  uint64_t hits = 0;
+  uint64_t skipped = 0;  // hits of throttled or disabled signatures not validated
+  uint64_t chunks = 0;
+  double seconds = 0.0;
+};
+
+class CarvePipeline
+{
+public:
+  explicit CarvePipeline(PipelineOptions options = PipelineOptions()) : options_(options) {}
+
+  /// Register a stage (not owned; must outlive `run`). Ignored after `run` started.
+  void addStage(CarveStage& stage) { stages_.push_back(&stage); }
+
+  /// Scan the device. Returns false when there is nothing to scan, or when
+  /// `memory_only` is set and the chunk buffers cannot be locked in RAM or
+  /// `registry` would spill in plaintext.
+  bool run(Device& device, FileRegistry& registry);
+
+  /// Request early termination; safe from any thread.
+  void cancel() { cancelled_.store(true); }
+
+  const PipelineStats& stats() const { return stats_; }
+
+  /// Counters of every signature, by pattern id; live while `run` is going.
+  std::vector<SignatureStats> signatureStats() const;
+
+private:
+  struct Signature
+  {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> validated{0};
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> nanoseconds{0};
+    std::atomic<SignatureState> state{SignatureState::Active};
+    // Counters when the state last changed; guarded by `judge_mutex_`.
+    uint64_t base_validated = 0;
+    uint64_t base_accepted = 0;
+    uint64_t base_nanoseconds = 0;
+  };
+
+  bool compile();
+  void scanChunk(const ChunkView& chunk, CarveContext& ctx, uint64_t& hits, uint64_t& skipped);
+  void judge(uint32_t id);
+  SignatureStats snapshot(uint32_t id) const;
+
+  PipelineOptions options_;
+  std::vector<CarveStage*> stages_;
+  std::vector<CarveStage*> chunk_stages_;
+  std::vector<bool> deferred_;  // stage index -> validates in `finish`
+  MultiPatternMatcher matcher_;
+  std::vector<std::pair<size_t, uint32_t>> routes_;  // pattern id -> (stage, tag)
+  std::vector<std::string> labels_;                  // pattern id -> signature bytes, hex
+  std::unique_ptr<Signature[]> signatures_;          // pattern id -> counters
+  // Serializes state changes, and `compile` against `signatureStats` readers.
+  mutable std::mutex judge_mutex_;
+  size_t overlap_ = 0;
+  std::atomic<bool> cancelled_{false};
+  PipelineStats stats_;
+};
+
+}  // namespace rsn
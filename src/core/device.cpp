@@ -0,0 +1,154 @@
+// RecoverySoftNetz — block device abstraction
+
+#include "core/device.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+namespace rsn
+{
+
+#ifdef _WIN32
+
+ImageFileDevice::~ImageFileDevice()
+{
+  if (handle_ != nullptr)
+  {
+    CloseHandle(static_cast<HANDLE>(handle_));
+  }
+}
+
+std::unique_ptr<ImageFileDevice> ImageFileDevice::open(const std::string& path,
+                                                       uint32_t sector_size)
+{
+  HANDLE h = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                         nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (h == INVALID_HANDLE_VALUE)
+  {
+    return nullptr;
+  }
+  LARGE_INTEGER len;
+  if (!GetFileSizeEx(h, &len))
+  {
+    CloseHandle(h);
+    return nullptr;
+  }
+  std::unique_ptr<ImageFileDevice> dev(new ImageFileDevice());
+  dev->path_ = path;
+  dev->handle_ = h;
+  dev->size_ = static_cast<uint64_t>(len.QuadPart);
+  dev->sector_size_ = sector_size;
+  return dev;
+}
+
+size_t ImageFileDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  size_t done = 0;
+  auto* out = static_cast<uint8_t*>(buffer);
+  while (done < length)
+  {
+    OVERLAPPED ov = {};
+    uint64_t pos = offset + done;
+    ov.Offset = static_cast<DWORD>(pos);
+    ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+    DWORD want = static_cast<DWORD>(std::min<size_t>(length - done, 1u << 30));
+    DWORD got = 0;
+    if (!ReadFile(static_cast<HANDLE>(handle_), out + done, want, &got, &ov) || got == 0)
+    {
+      break;
+    }
+    done += got;
+  }
+  return done;
+}
+
+#else
+
+ImageFileDevice::~ImageFileDevice()
+{
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+  }
+}
+
+std::unique_ptr<ImageFileDevice> ImageFileDevice::open(const std::string& path,
+                                                       uint32_t sector_size)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return nullptr;
+  }
+  uint64_t size = static_cast<uint64_t>(st.st_size);
+#if defined(__linux__)
+  if (S_ISBLK(st.st_mode))
+  {
+    uint64_t blk_size = 0;
+    if (::ioctl(fd, BLKGETSIZE64, &blk_size) == 0)
+    {
+      size = blk_size;
+    }
+  }
+#endif
+  std::unique_ptr<ImageFileDevice> dev(new ImageFileDevice());
+  dev->path_ = path;
+  dev->fd_ = fd;
+  dev->size_ = size;
+  dev->sector_size_ = sector_size;
+  return dev;
+}
+
+size_t ImageFileDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  size_t done = 0;
+  auto* out = static_cast<uint8_t*>(buffer);
+  while (done < length)
+  {
+    ssize_t got = ::pread(fd_, out + done, length - done, static_cast<off_t>(offset + done));
+    if (got < 0 && errno == EINTR)
+    {
+      continue;  // interrupted by a signal before any byte arrived
+    }
+    if (got <= 0)
+    {
+      break;
+    }
+    done += static_cast<size_t>(got);
+  }
+  return done;
+}
+
+#endif
+
+size_t MemoryDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  if (offset >= size_)
+  {
+    return 0;
+  }
+  size_t n = length < size_ - offset ? length : static_cast<size_t>(size_ - offset);
+  std::memcpy(buffer, data_ + offset, n);
+  return n;
+}
+
+}  // namespace rsn
@@ -0,0 +1,86 @@
+// RecoverySoftNetz — block device abstraction
+//
+// Every recovery stage reads source media through `Device`. Implementations
+// must allow concurrent `read` calls from multiple threads (positional reads,
+// no shared cursor) because the carve pipeline scans chunks in parallel.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace rsn
+{
+
+class Device
+{
+public:
+  virtual ~Device() = default;
+
+  /// Human-readable identifier (path, model, image name).
+  virtual std::string name() const = 0;
+
+  /// Total addressable size in bytes.
+  virtual uint64_t size() const = 0;
+
+  /// Logical sector size in bytes.
+  virtual uint32_t sectorSize() const { return 512; }
+
+  /// Positional read. Returns the number of bytes copied into `buffer`;
+  /// a short count means end of media or an unreadable region.
+  virtual size_t read(uint64_t offset, void* buffer, size_t length) = 0;
+
+  uint64_t getSectorCount() const { return size() / sectorSize(); }
+};
+
+/// Raw image file or block device node opened read-only.
+class ImageFileDevice : public Device
+{
+public:
+  ~ImageFileDevice() override;
+
+  /// Open `path`; returns nullptr when it cannot be opened or sized.
+  static std::unique_ptr<ImageFileDevice> open(const std::string& path,
+                                               uint32_t sector_size = 512);
+
+  std::string name() const override { return path_; }
+  uint64_t size() const override { return size_; }
+  uint32_t sectorSize() const override { return sector_size_; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+private:
+  ImageFileDevice() = default;
+
+  std::string path_;
+  uint64_t size_ = 0;
+  uint32_t sector_size_ = 512;
+#ifdef _WIN32
+  void* handle_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+/// Device backed by a caller-owned memory range (decoded images, tests).
+class MemoryDevice : public Device
+{
+public:
+  MemoryDevice(std::string name, const uint8_t* data, size_t size)
+    : name_(std::move(name)), data_(data), size_(size)
+  {
+  }
+
+  std::string name() const override { return name_; }
+  uint64_t size() const override { return size_; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+private:
+  std::string name_;
+  const uint8_t* data_;
+  size_t size_;
+};
+
+}  // namespace rsn
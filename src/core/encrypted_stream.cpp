@@ -0,0 +1,256 @@
+// RecoverySoftNetz — encrypted output container
+
+#include "core/encrypted_stream.h"
+
+#include "common/kdf.h"
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'R', 'S', 'N', 'E', 'N', 'C', '0', '1'};
+const char KEY_LABEL[] = "RecoverySoftNetz file key v1";
+constexpr size_t FILE_ID_OFFSET = 16;
+constexpr size_t FILE_ID_SIZE = 16;
+constexpr size_t MAX_CHUNK = 64 * 1024 * 1024;
+
+void deriveFileKey(const uint8_t master_key[AES256_KEY_SIZE], const uint8_t* file_id,
+                   uint8_t file_key[AES256_KEY_SIZE])
+{
+  HmacSha256 mac(master_key, AES256_KEY_SIZE);
+  mac.update(KEY_LABEL, sizeof(KEY_LABEL) - 1);
+  mac.update(file_id, FILE_ID_SIZE);
+  mac.finish(file_key);
+}
+
+void chunkNonce(uint64_t index, bool last, uint8_t nonce[GCM_IV_SIZE])
+{
+  storeBE64(nonce, index);
+  storeBE32(nonce + 8, last ? 1 : 0);
+}
+
+}  // namespace
+
+std::unique_ptr<EncryptedStreamWriter> EncryptedStreamWriter::create(
+  const uint8_t master_key[AES256_KEY_SIZE], ByteSink sink, size_t chunk_size)
+{
+  if (chunk_size == 0 || chunk_size > MAX_CHUNK || !sink)
+  {
+    return nullptr;
+  }
+  uint8_t file_id[FILE_ID_SIZE];
+  if (!randomBytes(file_id, sizeof(file_id)))
+  {
+    return nullptr;
+  }
+  uint8_t file_key[AES256_KEY_SIZE];
+  deriveFileKey(master_key, file_id, file_key);
+  std::unique_ptr<EncryptedStreamWriter> writer(
+    new EncryptedStreamWriter(file_key, std::move(sink), chunk_size));
+  secureZero(file_key, sizeof(file_key));
+
+  uint8_t* h = writer->header_;
+  std::memset(h, 0, ENCRYPTED_HEADER_SIZE);
+  std::memcpy(h, MAGIC, sizeof(MAGIC));
+  storeLE32(h + 8, static_cast<uint32_t>(chunk_size));
+  std::memcpy(h + FILE_ID_OFFSET, file_id, FILE_ID_SIZE);
+  if (!writer->sink_(h, ENCRYPTED_HEADER_SIZE))
+  {
+    return nullptr;
+  }
+  return writer;
+}
+
+EncryptedStreamWriter::EncryptedStreamWriter(const uint8_t file_key[AES256_KEY_SIZE],
+                                             ByteSink sink, size_t chunk_size)
+  : gcm_(file_key), sink_(std::move(sink)), buffer_(chunk_size + GCM_TAG_SIZE)
+{
+}
+
+EncryptedStreamWriter::~EncryptedStreamWriter()
+{
+  secureZero(buffer_.data(), buffer_.size());
+}
+
+bool EncryptedStreamWriter::write(const void* data, size_t size)
+{
+  if (finished_ || failed_)
+  {
+    return false;
+  }
+  const auto* p = static_cast<const uint8_t*>(data);
+  size_t chunk = buffer_.size() - GCM_TAG_SIZE;
+  while (size > 0)
+  {
+    // A full buffer is only sealed once more data arrives, so the last chunk
+    // is always known when finish() runs.
+    if (buffered_ == chunk && !flush(false))
+    {
+      return false;
+    }
+    if (buffered_ == 0 && size > chunk)
+    {
+      // Whole non-final chunk straight from the caller, skipping the copy.
+      if (!seal(p, chunk, false))
+      {
+        return false;
+      }
+      plaintext_size_ += chunk;
+      p += chunk;
+      size -= chunk;
+      continue;
+    }
+    size_t take = std::min(size, chunk - buffered_);
+    std::memcpy(buffer_.data() + buffered_, p, take);
+    buffered_ += take;
+    plaintext_size_ += take;
+    p += take;
+    size -= take;
+  }
+  return true;
+}
+
+bool EncryptedStreamWriter::finish()
+{
+  if (finished_ || failed_)
+  {
+    return false;
+  }
+  finished_ = true;
+  return flush(true);
+}
+
+bool EncryptedStreamWriter::flush(bool last)
+{
+  size_t size = buffered_;
+  buffered_ = 0;
+  return seal(buffer_.data(), size, last);
+}
+
+bool EncryptedStreamWriter::seal(const uint8_t* data, size_t size, bool last)
+{
+  uint8_t nonce[GCM_IV_SIZE];
+  chunkNonce(chunk_index_++, last, nonce);
+  gcm_.seal(nonce, header_, sizeof(header_), data, buffer_.data(), size, buffer_.data() + size);
+  failed_ = !sink_(buffer_.data(), size + GCM_TAG_SIZE);
+  return !failed_;
+}
+
+std::unique_ptr<EncryptedDevice> EncryptedDevice::open(Device& container,
+                                                       const uint8_t master_key[AES256_KEY_SIZE])
+{
+  uint8_t header[ENCRYPTED_HEADER_SIZE];
+  if (container.size() < ENCRYPTED_HEADER_SIZE + GCM_TAG_SIZE ||
+      container.read(0, header, sizeof(header)) != sizeof(header) ||
+      std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0)
+  {
+    return nullptr;
+  }
+  size_t chunk_size = loadLE32(header + 8);
+  if (chunk_size == 0 || chunk_size > MAX_CHUNK)
+  {
+    return nullptr;
+  }
+  uint64_t body = container.size() - ENCRYPTED_HEADER_SIZE;
+  uint64_t stride = chunk_size + GCM_TAG_SIZE;
+  uint64_t count = (body + stride - 1) / stride;
+  uint64_t tail = body - (count - 1) * stride;
+  if (tail < GCM_TAG_SIZE)
+  {
+    return nullptr;  // torn final chunk
+  }
+
+  uint8_t file_key[AES256_KEY_SIZE];
+  deriveFileKey(master_key, header + FILE_ID_OFFSET, file_key);
+  std::unique_ptr<EncryptedDevice> device(new EncryptedDevice(container, file_key));
+  secureZero(file_key, sizeof(file_key));
+  std::memcpy(device->header_, header, sizeof(header));
+  device->chunk_size_ = chunk_size;
+  device->chunk_count_ = count;
+  device->size_ = (count - 1) * chunk_size + (tail - GCM_TAG_SIZE);
+  return device;
+}
+
+EncryptedDevice::EncryptedDevice(Device& container, const uint8_t file_key[AES256_KEY_SIZE])
+  : container_(container), gcm_(file_key)
+{
+}
+
+bool EncryptedDevice::decryptChunk(uint64_t index, uint8_t* out, size_t& plain_size)
+{
+  uint64_t stride = chunk_size_ + GCM_TAG_SIZE;
+  uint64_t offset = ENCRYPTED_HEADER_SIZE + index * stride;
+  bool last = index + 1 == chunk_count_;
+  size_t sealed = last ? static_cast<size_t>(container_.size() - offset)
+                       : static_cast<size_t>(stride);
+  std::vector<uint8_t> ciphertext(sealed);
+  if (container_.read(offset, ciphertext.data(), sealed) != sealed)
+  {
+    return false;
+  }
+  plain_size = sealed - GCM_TAG_SIZE;
+  uint8_t nonce[GCM_IV_SIZE];
+  chunkNonce(index, last, nonce);
+  return gcm_.open(nonce, header_, sizeof(header_), ciphertext.data(), out, plain_size,
+                   ciphertext.data() + plain_size);
+}
+
+size_t EncryptedDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  if (offset >= size_)
+  {
+    return 0;
+  }
+  length = static_cast<size_t>(std::min<uint64_t>(length, size_ - offset));
+  auto* dst = static_cast<uint8_t*>(buffer);
+  std::vector<uint8_t> plain(chunk_size_);
+  size_t done = 0;
+  while (done < length)
+  {
+    uint64_t pos = offset + done;
+    uint64_t index = pos / chunk_size_;
+    size_t within = static_cast<size_t>(pos % chunk_size_);
+    size_t plain_size = 0;
+    size_t take = std::min(length - done, chunk_size_ - within);
+    if (within == 0 && take == chunk_size_)
+    {
+      // Whole chunk: decrypt straight into the caller's buffer.
+      if (!decryptChunk(index, dst + done, plain_size))
+      {
+        break;
+      }
+    }
+    else
+    {
+      if (!decryptChunk(index, plain.data(), plain_size))
+      {
+        break;
+      }
+      std::memcpy(dst + done, plain.data() + within, take);
+    }
+    done += take;
+  }
+  secureZero(plain.data(), plain.size());
+  return done;
+}
+
+bool EncryptedDevice::verify()
+{
+  std::vector<uint8_t> plain(chunk_size_);
+  bool ok = true;
+  for (uint64_t i = 0; i < chunk_count_ && ok; ++i)
+  {
+    size_t plain_size = 0;
+    ok = decryptChunk(i, plain.data(), plain_size);
+  }
+  secureZero(plain.data(), plain.size());
+  return ok;
+}
+
+}  // namespace rsn
@@ -0,0 +1,99 @@
+// RecoverySoftNetz — encrypted output container
+//
+// Recovered files can be written through an AES-256-GCM stream instead of in
+// the clear. The plaintext is cut into fixed-size chunks, and each chunk is
+// sealed on its own:
+//
+//   header  "RSNENC01" | chunk size (LE32) | reserved (LE32) | file id (16)
+//   chunk i ciphertext (chunk size bytes; the last one may be shorter) | tag (16)
+//
+// Each file gets a random 128-bit id. The per-file key is
+// HMAC-SHA256(master key, label | file id), so chunk nonces (the chunk index
+// plus a last-chunk flag) never repeat under one key. The header is the AAD
+// of every chunk. Any chunk can be decrypted without its neighbours, which
+// lets EncryptedDevice serve positional reads. Truncation and reordering fail
+// authentication.
+
+#pragma once
+
+#include "common/crypto.h"
+#include "core/device.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace rsn
+{
+
+constexpr size_t ENCRYPTED_HEADER_SIZE = 32;
+constexpr size_t ENCRYPTED_DEFAULT_CHUNK = 64 * 1024;
+
+/// Receives container bytes in order; returns false to abort the stream.
+using ByteSink = std::function<bool(const uint8_t* data, size_t size)>;
+
+class EncryptedStreamWriter
+{
+public:
+  /// Start a new container: draws a file id and emits the header. Returns
+  /// nullptr if the CSPRNG or the sink fails, or `chunk_size` is zero.
+  static std::unique_ptr<EncryptedStreamWriter> create(const uint8_t master_key[AES256_KEY_SIZE],
+                                                       ByteSink sink,
+                                                       size_t chunk_size = ENCRYPTED_DEFAULT_CHUNK);
+  ~EncryptedStreamWriter();
+
+  bool write(const void* data, size_t size);
+
+  /// Seal the final chunk. The container is incomplete until this succeeds.
+  bool finish();
+
+  uint64_t plaintextSize() const { return plaintext_size_; }
+
+private:
+  EncryptedStreamWriter(const uint8_t file_key[AES256_KEY_SIZE], ByteSink sink,
+                        size_t chunk_size);
+
+  bool flush(bool last);
+  bool seal(const uint8_t* data, size_t size, bool last);
+
+  Aes256Gcm gcm_;
+  ByteSink sink_;
+  uint8_t header_[ENCRYPTED_HEADER_SIZE];
+  std::vector<uint8_t> buffer_;  // chunk plaintext, sealed in place, then the tag
+  size_t buffered_ = 0;
+  uint64_t chunk_index_ = 0;
+  uint64_t plaintext_size_ = 0;
+  bool finished_ = false;
+  bool failed_ = false;
+};
+
+/// Read-only plaintext view of a container stored on another device.
+/// Chunks that fail authentication read as short (unreadable) regions.
+class EncryptedDevice : public Device
+{
+public:
+  /// nullptr when `container` lacks a valid header or has a torn last chunk.
+  static std::unique_ptr<EncryptedDevice> open(Device& container,
+                                               const uint8_t master_key[AES256_KEY_SIZE]);
+
+  std::string name() const override { return container_.name() + " (decrypted)"; }
+  uint64_t size() const override { return size_; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+  /// Authenticate every chunk; false at the first bad one.
+  bool verify();
+
+private:
+  EncryptedDevice(Device& container, const uint8_t file_key[AES256_KEY_SIZE]);
+
+  bool decryptChunk(uint64_t index, uint8_t* out, size_t& plain_size);
+
+  Device& container_;
+  Aes256Gcm gcm_;
+  uint8_t header_[ENCRYPTED_HEADER_SIZE];
+  size_t chunk_size_ = 0;
+  uint64_t chunk_count_ = 0;
+  uint64_t size_ = 0;
+};
+
+}  // namespace rsn
@@ -0,0 +1,251 @@
+// RecoverySoftNetz — recovered files registry
+
+#include "core/file_registry.h"
+
+#include "common/crypto.h"
+#include "common/secure_memory.h"
+#include "common/utils.h"
+#include "core/spill_file.h"
+
+namespace rsn
+{
+
+namespace
+{
+
+void putU64(SecureBytes& out, uint64_t v)
+{
+  size_t at = out.size();
+  out.resize(at + 8);
+  storeLE64(out.data() + at, v);
+}
+
+void putString(SecureBytes& out, const std::string& s)
+{
+  putU64(out, s.size());
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+void serialize(const RecoveredFile& f, SecureBytes& out)
+{
+  uint64_t confidence;
+  static_assert(sizeof(confidence) == sizeof(f.confidence), "double is not 64-bit");
+  std::memcpy(&confidence, &f.confidence, sizeof(confidence));
+  putU64(out, f.id);
+  putString(out, f.type);
+  putString(out, f.source);
+  putU64(out, f.offset);
+  putU64(out, f.size);
+  putU64(out, confidence);
+  putString(out, f.description);
+  putU64(out, f.extents.size());
+  for (const Extent& e : f.extents)
+  {
+    putU64(out, e.offset);
+    putU64(out, e.length);
+  }
+}
+
+// Bounds-checked reader over one spilled batch.
+class BatchReader
+{
+public:
+  explicit BatchReader(const SecureBytes& data) : data_(data) {}
+
+  bool done() const { return pos_ == data_.size(); }
+
+  bool u64(uint64_t& v)
+  {
+    if (data_.size() - pos_ < 8)
+    {
+      return false;
+    }
+    v = loadLE64(data_.data() + pos_);
+    pos_ += 8;
+    return true;
+  }
+
+  bool string(std::string& s)
+  {
+    uint64_t n = 0;
+    if (!u64(n) || n > data_.size() - pos_)
+    {
+      return false;
+    }
+    s.assign(reinterpret_cast<const char*>(data_.data() + pos_), static_cast<size_t>(n));
+    pos_ += static_cast<size_t>(n);
+    return true;
+  }
+
+  bool file(RecoveredFile& f)
+  {
+    uint64_t confidence = 0;
+    uint64_t extents = 0;
+    if (!u64(f.id) || !string(f.type) || !string(f.source) || !u64(f.offset) ||
+        !u64(f.size) || !u64(confidence) || !string(f.description) || !u64(extents) ||
+        extents > (data_.size() - pos_) / 16)
+    {
+      return false;
+    }
+    std::memcpy(&f.confidence, &confidence, sizeof(confidence));
+    f.extents.resize(static_cast<size_t>(extents));
+    for (Extent& e : f.extents)
+    {
+      u64(e.offset);
+      u64(e.length);
+    }
+    return true;
+  }
+
+private:
+  const SecureBytes& data_;
+  size_t pos_ = 0;
+};
+
+void wipeString(std::string& s)
+{
+  if (!s.empty())
+  {
+    secureZero(&s[0], s.size());
+  }
+}
+
+}  // namespace
+
+FileRegistry::FileRegistry() = default;
+
+FileRegistry::FileRegistry(RegistryOptions options) : options_(std::move(options)) {}
+
+FileRegistry::~FileRegistry() = default;
+
+uint64_t FileRegistry::add(RecoveredFile file)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  file.id = next_id_++;
+  uint64_t id = file.id;
+  files_.push_back(std::move(file));
+  if (options_.resident_limit != 0 && files_.size() >= options_.resident_limit)
+  {
+    spillLocked();
+  }
+  return id;
+}
+
+void FileRegistry::spillLocked()
+{
+  if (spill_failed_)
+  {
+    return;
+  }
+  if (!spill_)
+  {
+    spill_ = SpillFile::create(options_.spill_directory, options_.encrypt_spill);
+    if (!spill_)
+    {
+      spill_failed_ = true;
+      return;
+    }
+  }
+  SecureBytes batch;
+  for (const auto& f : files_)
+  {
+    serialize(f, batch);
+  }
+  // The batch and every buffer it outgrew are wiped as they are freed.
+  bool ok = spill_->append(batch.data(), batch.size()) != SIZE_MAX;
+  if (!ok)
+  {
+    // The entries stay resident, so they keep their strings.
+    spill_failed_ = true;
+    return;
+  }
+  if (options_.encrypt_spill)
+  {
+    for (auto& f : files_)
+    {
+      wipeString(f.type);
+      wipeString(f.source);
+      wipeString(f.description);
+    }
+  }
+  spilled_ += files_.size();
+  files_.clear();
+}
+
+void FileRegistry::visitLocked(const std::function<void(const RecoveredFile&)>& fn) const
+{
+  if (spill_)
+  {
+    SecureBytes batch;
+    RecoveredFile f;
+    for (size_t i = 0; i < spill_->recordCount(); ++i)
+    {
+      if (!spill_->read(i, batch))
+      {
+        continue;  // unreadable batch: its entries are lost, the rest still load
+      }
+      BatchReader reader(batch);
+      while (!reader.done() && reader.file(f))
+      {
+        fn(f);
+      }
+      if (options_.encrypt_spill)
+      {
+        secureZero(batch.data(), batch.size());
+      }
+    }
+    wipeString(f.type);
+    wipeString(f.source);
+    wipeString(f.description);
+  }
+  for (const auto& f : files_)
+  {
+    fn(f);
+  }
+}
+
+size_t FileRegistry::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<size_t>(spilled_) + files_.size();
+}
+
+uint64_t FileRegistry::spilledCount() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return spilled_;
+}
+
+std::vector<RecoveredFile> FileRegistry::snapshot() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!spill_)
+  {
+    return files_;
+  }
+  std::vector<RecoveredFile> out;
+  out.reserve(static_cast<size_t>(spilled_) + files_.size());
+  visitLocked([&](const RecoveredFile& f) { out.push_back(f); });
+  return out;
+}
+
+std::vector<RecoveredFile> FileRegistry::byTypePrefix(const std::string& prefix) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<RecoveredFile> out;
+  visitLocked([&](const RecoveredFile& f) {
+    if (f.type.compare(0, prefix.size(), prefix) == 0)
+    {
+      out.push_back(f);
+    }
+  });
+  return out;
+}
+
+void FileRegistry::forEach(const std::function<void(const RecoveredFile&)>& fn) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  visitLocked(fn);
+}
+
+}  // namespace rsn
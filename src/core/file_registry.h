@@ -0,0 +1,90 @@
+// RecoverySoftNetz — recovered files registry
+//
+// Central, thread-safe record of everything the engine found: carved files,
+// wallet artifacts, key candidates, metadata entries. Stages running on the
+// carve pipeline's worker threads append here concurrently.
+//
+// Long scans of damaged media can produce millions of entries. With a resident
+// limit set, full batches are serialized to an anonymous spill file and read
+// back on demand; in privacy mode that file is encrypted under an ephemeral key.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// Byte range on the source device.
+struct Extent
+{
+  uint64_t offset = 0;
+  uint64_t length = 0;
+};
+
+struct RecoveredFile
+{
+  uint64_t id = 0;           // assigned by the registry
+  std::string type;          // "<family>/<format>", e.g. "wallet/bitcoin_core"
+  std::string source;        // stage or parser that produced the entry
+  uint64_t offset = 0;       // first byte on the device
+  uint64_t size = 0;         // logical size in bytes
+  double confidence = 0.0;   // 0..1 validation score
+  std::string description;   // short human-readable detail
+  std::vector<Extent> extents;  // empty when contiguous at [offset, offset + size)
+};
+
+struct RegistryOptions
+{
+  size_t resident_limit = 0;    // entries held in RAM before spilling; 0 = never spill
+  std::string spill_directory;  // where the spill file is created; system temp when empty
+  bool encrypt_spill = false;   // privacy mode: seal spilled batches with an ephemeral key
+};
+
+class SpillFile;
+
+class FileRegistry
+{
+public:
+  FileRegistry();
+  explicit FileRegistry(RegistryOptions options);
+  ~FileRegistry();
+
+  /// Append an entry and return its id.
+  uint64_t add(RecoveredFile file);
+
+  size_t size() const;
+
+  /// Copy of all entries, in insertion order.
+  std::vector<RecoveredFile> snapshot() const;
+
+  /// Entries whose type starts with `prefix`.
+  std::vector<RecoveredFile> byTypePrefix(const std::string& prefix) const;
+
+  void forEach(const std::function<void(const RecoveredFile&)>& fn) const;
+
+  /// Entries currently held in the spill file.
+  uint64_t spilledCount() const;
+
+  /// True when entries may be written to disk unencrypted.
+  bool spillsPlaintext() const { return options_.resident_limit != 0 && !options_.encrypt_spill; }
+
+private:
+  void spillLocked();
+  void visitLocked(const std::function<void(const RecoveredFile&)>& fn) const;
+
+  RegistryOptions options_;
+  mutable std::mutex mutex_;
+  std::vector<RecoveredFile> files_;
+  uint64_t next_id_ = 1;
+  std::unique_ptr<SpillFile> spill_;
+  uint64_t spilled_ = 0;
+  bool spill_failed_ = false;  // keep everything resident after an I/O error
+};
+
+}  // namespace rsn
@@ -0,0 +1,117 @@
+// RecoverySoftNetz — shared multi-pattern matcher
+
+#include "core/pattern_matcher.h"
+
+#include <cstring>
+#include <deque>
+
+namespace rsn
+{
+
+namespace
+{
+constexpr uint32_t NO_STATE = UINT32_MAX;
+}
+
+uint32_t MultiPatternMatcher::addPattern(const void* bytes, size_t length)
+{
+  const auto* p = static_cast<const uint8_t*>(bytes);
+  patterns_.emplace_back(p, p + length);
+  lengths_.push_back(static_cast<uint32_t>(length));
+  if (length > max_length_)
+  {
+    max_length_ = length;
+  }
+  compiled_ = false;
+  return static_cast<uint32_t>(lengths_.size() - 1);
+}
+
+bool MultiPatternMatcher::compile()
+{
+  if (patterns_.empty())
+  {
+    return false;
+  }
+
+  // Trie construction; delta_ holds only goto edges at this point.
+  delta_.assign(256, NO_STATE);
+  std::vector<std::vector<uint32_t>> own_outputs(1);
+  state_count_ = 1;
+  std::memset(starts_, 0, sizeof(starts_));
+
+  for (uint32_t id = 0; id < patterns_.size(); ++id)
+  {
+    const auto& pat = patterns_[id];
+    if (pat.empty())
+    {
+      continue;
+    }
+    starts_[pat[0]] = true;
+    uint32_t state = 0;
+    for (uint8_t c : pat)
+    {
+      uint32_t& next = delta_[(static_cast<size_t>(state) << 8) | c];
+      if (next == NO_STATE)
+      {
+        next = static_cast<uint32_t>(state_count_++);
+        delta_.resize(state_count_ * 256, NO_STATE);
+        own_outputs.emplace_back();
+      }
+      // delta_ may have been reallocated; re-read through the index.
+      state = delta_[(static_cast<size_t>(state) << 8) | c];
+    }
+    own_outputs[state].push_back(id);
+  }
+
+  // Breadth-first failure links, folding them into a complete DFA.
+  std::vector<uint32_t> fail(state_count_, 0);
+  std::deque<uint32_t> queue;
+  for (int c = 0; c < 256; ++c)
+  {
+    uint32_t& next = delta_[static_cast<size_t>(c)];
+    if (next == NO_STATE)
+    {
+      next = 0;
+    }
+    else
+    {
+      fail[next] = 0;
+      queue.push_back(next);
+    }
+  }
+  while (!queue.empty())
+  {
+    uint32_t s = queue.front();
+    queue.pop_front();
+    const auto& inherited = own_outputs[fail[s]];
+    own_outputs[s].insert(own_outputs[s].end(), inherited.begin(), inherited.end());
+    for (int c = 0; c < 256; ++c)
+    {
+      size_t idx = (static_cast<size_t>(s) << 8) | static_cast<size_t>(c);
+      uint32_t fallback = delta_[(static_cast<size_t>(fail[s]) << 8) | static_cast<size_t>(c)];
+      if (delta_[idx] == NO_STATE)
+      {
+        delta_[idx] = fallback;
+      }
+      else
+      {
+        fail[delta_[idx]] = fallback;
+        queue.push_back(delta_[idx]);
+      }
+    }
+  }
+
+  out_begin_.assign(state_count_ + 1, 0);
+  outputs_.clear();
+  for (size_t s = 0; s < state_count_; ++s)
+  {
+    out_begin_[s] = static_cast<uint32_t>(outputs_.size());
+    outputs_.insert(outputs_.end(), own_outputs[s].begin(), own_outputs[s].end());
+  }
+  out_begin_[state_count_] = static_cast<uint32_t>(outputs_.size());
+
+  compiled_ = true;
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,79 @@
+// RecoverySoftNetz — shared multi-pattern matcher
+//
+// Aho-Corasick automaton compiled into a dense byte DFA so that a single pass
+// over each chunk reports every signature of every carve stage. Scanning is
+// branch-light (one table lookup per byte) and skips runs of bytes that cannot
+// start any pattern while the automaton sits in the root state.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+class MultiPatternMatcher
+{
+public:
+  /// Register a literal byte pattern. Returns its id (dense, from 0).
+  /// Must be called before `compile()`.
+  uint32_t addPattern(const void* bytes, size_t length);
+
+  /// Build the DFA. Returns false when no pattern was added.
+  bool compile();
+
+  bool compiled() const { return compiled_; }
+  size_t patternCount() const { return lengths_.size(); }
+  size_t patternLength(uint32_t id) const { return lengths_[id]; }
+  size_t maxPatternLength() const { return max_length_; }
+  size_t stateCount() const { return state_count_; }
+
+  /// Report every occurrence in [data, data + size) as fn(pattern_id, start).
+  /// Occurrences are reported in order of their end position.
+  template <class Fn>
+  void scan(const uint8_t* data, size_t size, Fn&& fn) const
+  {
+    const uint32_t* delta = delta_.data();
+    uint32_t state = 0;
+    size_t i = 0;
+    while (i < size)
+    {
+      if (state == 0)
+      {
+        while (i < size && !starts_[data[i]])
+        {
+          ++i;
+        }
+        if (i == size)
+        {
+          break;
+        }
+      }
+      state = delta[(static_cast<size_t>(state) << 8) | data[i]];
+      uint32_t first = out_begin_[state];
+      uint32_t last = out_begin_[state + 1];
+      for (uint32_t k = first; k < last; ++k)
+      {
+        uint32_t id = outputs_[k];
+        fn(id, i + 1 - lengths_[id]);
+      }
+      ++i;
+    }
+  }
+
+private:
+  std::vector<std::vector<uint8_t>> patterns_;
+  std::vector<uint32_t> lengths_;
+  size_t max_length_ = 0;
+
+  size_t state_count_ = 0;
+  std::vector<uint32_t> delta_;      // state_count_ * 256 transitions
+  std::vector<uint32_t> out_begin_;  // state_count_ + 1 offsets into outputs_
+  std::vector<uint32_t> outputs_;    // pattern ids, suffix outputs merged
+  bool starts_[256] = {};
+  bool compiled_ = false;
+};
+
+}  // namespace rsn
@@ -0,0 +1,241 @@
+// RecoverySoftNetz — anonymous scratch file for spilled engine state
+
+#include "core/spill_file.h"
+
+#include "common/crypto.h"
+#include "common/utils.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rsn
+{
+
+namespace
+{
+
+void recordNonce(size_t index, uint8_t nonce[GCM_IV_SIZE])
+{
+  storeBE64(nonce, index);
+  storeBE32(nonce + 8, 0);
+}
+
+}  // namespace
+
+std::unique_ptr<SpillFile> SpillFile::create(const std::string& directory, bool encrypted)
+{
+  std::unique_ptr<SpillFile> file(new SpillFile());
+  if (encrypted)
+  {
+    file->key_memory_ = LockedRegion::allocate(sizeof(Aes256Gcm));
+    if (!file->key_memory_)
+    {
+      return nullptr;
+    }
+    // Only the expanded schedule outlives this call, in locked memory.
+    uint8_t key[AES256_KEY_SIZE];
+    if (!randomBytes(key, sizeof(key)))
+    {
+      return nullptr;
+    }
+    file->gcm_ = new (file->key_memory_->data()) Aes256Gcm(key);
+    secureZero(key, sizeof(key));
+  }
+
+#ifdef _WIN32
+  char dir[MAX_PATH + 1];
+  if (!directory.empty())
+  {
+    lstrcpynA(dir, directory.c_str(), sizeof(dir));
+  }
+  else if (GetTempPathA(sizeof(dir), dir) == 0)
+  {
+    return nullptr;
+  }
+  char path[MAX_PATH + 1];
+  if (GetTempFileNameA(dir, "rsn", 0, path) == 0)
+  {
+    return nullptr;
+  }
+  HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                         FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+  if (h == INVALID_HANDLE_VALUE)
+  {
+    DeleteFileA(path);
+    return nullptr;
+  }
+  file->handle_ = h;
+#else
+  std::string dir = directory;
+  if (dir.empty())
+  {
+    const char* tmp = std::getenv("TMPDIR");
+    dir = tmp != nullptr && *tmp != '\0' ? tmp : "/tmp";
+  }
+  std::string path = dir + "/rsn-spill-XXXXXX";
+  int fd = ::mkstemp(&path[0]);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+  ::unlink(path.c_str());
+  file->fd_ = fd;
+#endif
+  return file;
+}
+
+SpillFile::~SpillFile()
+{
+#ifdef _WIN32
+  if (handle_ != nullptr)
+  {
+    CloseHandle(static_cast<HANDLE>(handle_));
+  }
+#else
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+  }
+#endif
+  if (gcm_ != nullptr)
+  {
+    gcm_->~Aes256Gcm();
+  }
+}
+
+size_t SpillFile::append(const uint8_t* data, size_t size)
+{
+  size_t index = records_.size();
+  uint64_t stored = size;
+  bool ok;
+  if (gcm_ != nullptr)
+  {
+    std::vector<uint8_t> sealed(size + GCM_TAG_SIZE);
+    uint8_t nonce[GCM_IV_SIZE];
+    recordNonce(index, nonce);
+    gcm_->seal(nonce, nullptr, 0, data, sealed.data(), size, sealed.data() + size);
+    stored = sealed.size();
+    ok = writeAt(end_, sealed.data(), sealed.size());
+  }
+  else
+  {
+    ok = writeAt(end_, data, size);
+  }
+  if (!ok)
+  {
+    return SIZE_MAX;
+  }
+  records_.push_back({end_, stored});
+  end_ += stored;
+  return index;
+}
+
+bool SpillFile::read(size_t index, SecureBytes& out) const
+{
+  if (index >= records_.size())
+  {
+    return false;
+  }
+  const Record& record = records_[index];
+  size_t stored = static_cast<size_t>(record.size);
+  if (gcm_ == nullptr)
+  {
+    out.resize(stored);
+    return readAt(record.offset, out.data(), stored);
+  }
+  std::vector<uint8_t> sealed(stored);
+  if (!readAt(record.offset, sealed.data(), stored))
+  {
+    return false;
+  }
+  size_t size = stored - GCM_TAG_SIZE;
+  out.resize(size);
+  uint8_t nonce[GCM_IV_SIZE];
+  recordNonce(index, nonce);
+  return gcm_->open(nonce, nullptr, 0, sealed.data(), out.data(), size, sealed.data() + size);
+}
+
+#ifdef _WIN32
+
+bool SpillFile::writeAt(uint64_t offset, const uint8_t* data, size_t size)
+{
+  size_t done = 0;
+  while (done < size)
+  {
+    OVERLAPPED ov = {};
+    uint64_t pos = offset + done;
+    ov.Offset = static_cast<DWORD>(pos);
+    ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+    DWORD want = static_cast<DWORD>(size - done < (1u << 30) ? size - done : (1u << 30));
+    DWORD put = 0;
+    if (!WriteFile(static_cast<HANDLE>(handle_), data + done, want, &put, &ov) || put == 0)
+    {
+      return false;
+    }
+    done += put;
+  }
+  return true;
+}
+
+bool SpillFile::readAt(uint64_t offset, uint8_t* data, size_t size) const
+{
+  size_t done = 0;
+  while (done < size)
+  {
+    OVERLAPPED ov = {};
+    uint64_t pos = offset + done;
+    ov.Offset = static_cast<DWORD>(pos);
+    ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+    DWORD want = static_cast<DWORD>(size - done < (1u << 30) ? size - done : (1u << 30));
+    DWORD got = 0;
+    if (!ReadFile(static_cast<HANDLE>(handle_), data + done, want, &got, &ov) || got == 0)
+    {
+      return false;
+    }
+    done += got;
+  }
+  return true;
+}
+
+#else
+
+bool SpillFile::writeAt(uint64_t offset, const uint8_t* data, size_t size)
+{
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t put = ::pwrite(fd_, data + done, size - done, static_cast<off_t>(offset + done));
+    if (put <= 0)
+    {
+      return false;
+    }
+    done += static_cast<size_t>(put);
+  }
+  return true;
+}
+
+bool SpillFile::readAt(uint64_t offset, uint8_t* data, size_t size) const
+{
+  size_t done = 0;
+  while (done < size)
+  {
+    ssize_t got = ::pread(fd_, data + done, size - done, static_cast<off_t>(offset + done));
+    if (got <= 0)
+    {
+      return false;
+    }
+    done += static_cast<size_t>(got);
+  }
+  return true;
+}
+
+#endif
+
+}  // namespace rsn
@@ -0,0 +1,68 @@
+// RecoverySoftNetz — anonymous scratch file for spilled engine state
+//
+// Append-only file of length-indexed records, used when in-memory structures
+// (the file registry) outgrow their budget. The file has no name once created
+// (unlinked on POSIX, delete-on-close on Windows). In encrypted mode every
+// record is sealed with AES-256-GCM under a random key that lives only in
+// locked memory, so the bytes on disk are unreadable once the process exits.
+
+#pragma once
+
+#include "common/secure_memory.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+class Aes256Gcm;
+
+class SpillFile
+{
+public:
+  /// Create the scratch file in `directory` (the system temp directory when
+  /// empty). Returns nullptr if the file, the key or its locked memory cannot
+  /// be created.
+  static std::unique_ptr<SpillFile> create(const std::string& directory, bool encrypted);
+  ~SpillFile();
+
+  SpillFile(const SpillFile&) = delete;
+  SpillFile& operator=(const SpillFile&) = delete;
+
+  /// Append one record and return its index, or SIZE_MAX on a write failure.
+  size_t append(const uint8_t* data, size_t size);
+
+  /// Read record `index` back; false on I/O or authentication failure.
+  bool read(size_t index, SecureBytes& out) const;
+
+  size_t recordCount() const { return records_.size(); }
+  bool encrypted() const { return gcm_ != nullptr; }
+
+private:
+  struct Record
+  {
+    uint64_t offset;
+    uint64_t size;  // stored bytes, including the tag when encrypted
+  };
+
+  SpillFile() = default;
+
+  bool writeAt(uint64_t offset, const uint8_t* data, size_t size);
+  bool readAt(uint64_t offset, uint8_t* data, size_t size) const;
+
+  std::unique_ptr<LockedRegion> key_memory_;
+  Aes256Gcm* gcm_ = nullptr;  // placement-constructed in key_memory_
+  std::vector<Record> records_;
+  uint64_t end_ = 0;
+#ifdef _WIN32
+  void* handle_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+}  // namespace rsn
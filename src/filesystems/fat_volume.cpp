@@ -0,0 +1,620 @@
+// RecoverySoftNetz — FAT12/16/32 and exFAT volume reader
+
+#include "filesystems/fat_volume.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t DIR_ENTRY = 32;
+constexpr uint8_t ATTR_VOLUME = 0x08;
+constexpr uint8_t ATTR_DIRECTORY = 0x10;
+constexpr uint8_t ATTR_LFN = 0x0F;
+constexpr uint8_t FAT_DELETED = 0xE5;
+
+constexpr uint8_t EXFAT_IN_USE = 0x80;
+constexpr uint8_t EXFAT_BITMAP = 0x81;
+constexpr uint8_t EXFAT_FILE = 0x05;      // with or without the in-use bit
+constexpr uint8_t EXFAT_STREAM = 0x40;
+constexpr uint8_t EXFAT_NAME = 0x41;
+constexpr uint8_t EXFAT_NO_FAT_CHAIN = 0x02;
+
+constexpr uint64_t MAX_DIRECTORY_BYTES = 64u << 20;
+constexpr size_t TABLE_PIECE = 64u << 10;  // allocation table read granularity
+
+/// One name character as UTF-8; control characters and path separators
+/// become '_'.
+void appendNameChar(std::string& out, uint32_t cp)
+{
+  if (cp < 0x20 || cp == '/' || cp == '\\')
+  {
+    out += '_';
+  }
+  else
+  {
+    appendUtf8(out, cp >= 0xD800 && cp < 0xE000 ? 0xFFFD : cp);
+  }
+}
+
+/// UTF-16LE code units to UTF-8; stops at a NUL or 0xFFFF padding unit.
+void appendUtf16(std::string& out, const std::vector<uint16_t>& units)
+{
+  for (size_t i = 0; i < units.size(); ++i)
+  {
+    uint32_t cp = units[i];
+    if (cp == 0 || cp == 0xFFFF)
+    {
+      break;
+    }
+    if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < units.size() && units[i + 1] >= 0xDC00 &&
+        units[i + 1] < 0xE000)
+    {
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (units[++i] - 0xDC00);
+    }
+    appendNameChar(out, cp);
+  }
+}
+
+uint8_t shortNameChecksum(const uint8_t* name)
+{
+  uint8_t sum = 0;
+  for (size_t i = 0; i < 11; ++i)
+  {
+    sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + name[i]);
+  }
+  return sum;
+}
+
+std::string shortName(const uint8_t* e, uint8_t first)
+{
+  std::string base(reinterpret_cast<const char*>(e), 8);
+  std::string ext(reinterpret_cast<const char*>(e + 8), 3);
+  base[0] = static_cast<char>(first == 0x05 ? FAT_DELETED : first);
+  base.erase(base.find_last_not_of(' ') + 1);
+  ext.erase(ext.find_last_not_of(' ') + 1);
+  auto lower = [](std::string& s)
+  {
+    std::transform(s.begin(), s.end(), s.begin(), [](char c)
+                   { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; });
+  };
+  if ((e[12] & 0x08) != 0)
+  {
+    lower(base);
+  }
+  if ((e[12] & 0x10) != 0)
+  {
+    lower(ext);
+  }
+  std::string name;
+  for (char c : ext.empty() ? base : base + "." + ext)
+  {
+    appendNameChar(name, static_cast<uint8_t>(c));
+  }
+  return name;
+}
+
+}  // namespace
+
+std::unique_ptr<FatVolume> FatVolume::open(Device& device, uint64_t base)
+{
+  uint8_t boot[512];
+  if (device.read(base, boot, sizeof boot) != sizeof boot)
+  {
+    return nullptr;
+  }
+  std::unique_ptr<FatVolume> volume(new FatVolume(device, base));
+  bool exfat = std::memcmp(boot + 3, "EXFAT   ", 8) == 0;
+  if (exfat ? !volume->parseExfat(boot) : !volume->parseFat(boot))
+  {
+    return nullptr;
+  }
+  return volume;
+}
+
+const char* FatVolume::kindName() const
+{
+  switch (kind_)
+  {
+    case FatKind::Fat12:
+      return "fat12";
+    case FatKind::Fat16:
+      return "fat16";
+    case FatKind::Fat32:
+      return "fat32";
+    case FatKind::Exfat:
+      return "exfat";
+  }
+  return "fat";
+}
+
+bool FatVolume::parseFat(const uint8_t* boot)
+{
+  uint32_t bps = loadLE16(boot + 11);
+  uint32_t spc = boot[13];
+  uint32_t reserved = loadLE16(boot + 14);
+  uint32_t fats = boot[16];
+  uint32_t root_entries = loadLE16(boot + 17);
+  uint64_t total = loadLE16(boot + 19) != 0 ? loadLE16(boot + 19) : loadLE32(boot + 32);
+  uint64_t fat_size = loadLE16(boot + 22) != 0 ? loadLE16(boot + 22) : loadLE32(boot + 36);
+  if ((boot[0] != 0xeb && boot[0] != 0xe9) || bps < 512 || bps > 4096 || !isPowerOfTwo(bps) ||
+      !isPowerOfTwo(spc) || reserved == 0 || fats == 0 || fats > 2 || fat_size == 0 ||
+      boot[510] != 0x55 || boot[511] != 0xaa)
+  {
+    return false;
+  }
+  uint64_t root_sectors = (static_cast<uint64_t>(root_entries) * DIR_ENTRY + bps - 1) / bps;
+  uint64_t first_data = reserved + fats * fat_size + root_sectors;
+  if (total <= first_data)
+  {
+    return false;
+  }
+  uint64_t clusters = (total - first_data) / spc;
+  kind_ = clusters < 4085 ? FatKind::Fat12 : clusters < 65525 ? FatKind::Fat16 : FatKind::Fat32;
+  if ((kind_ == FatKind::Fat32) != (root_entries == 0))
+  {
+    return false;
+  }
+  sector_size_ = bps;
+  cluster_size_ = spc * bps;
+  data_offset_ = first_data * bps;
+  root_offset_ = (reserved + fats * fat_size) * bps;
+  root_length_ = static_cast<uint64_t>(root_entries) * DIR_ENTRY;
+  root_cluster_ = kind_ == FatKind::Fat32 ? loadLE32(boot + 44) : 0;
+
+  // Entries beyond the table's capacity cannot be addressed.
+  uint64_t bits = kind_ == FatKind::Fat12 ? 12 : kind_ == FatKind::Fat16 ? 16 : 32;
+  uint64_t table_length = fat_size * bps;
+  cluster_count_ = static_cast<uint32_t>(std::min(clusters, table_length * 8 / bits - 2));
+  uint64_t needed = ((static_cast<uint64_t>(cluster_count_) + 2) * bits + 7) / 8;
+  return loadTable(static_cast<uint64_t>(reserved) * bps, std::min(needed, table_length),
+                   fats > 1 ? (reserved + fat_size) * bps : UINT64_MAX);
+}
+
+bool FatVolume::parseExfat(const uint8_t* boot)
+{
+  if (boot[108] < 9 || boot[108] > 12 || boot[109] > 25 - boot[108] || boot[110] == 0 ||
+      boot[110] > 2)
+  {
+    return false;
+  }
+  kind_ = FatKind::Exfat;
+  sector_size_ = 1u << boot[108];
+  cluster_size_ = sector_size_ << boot[109];
+  uint64_t fat_offset = static_cast<uint64_t>(loadLE32(boot + 80)) * sector_size_;
+  uint64_t fat_length = static_cast<uint64_t>(loadLE32(boot + 84)) * sector_size_;
+  data_offset_ = static_cast<uint64_t>(loadLE32(boot + 88)) * sector_size_;
+  root_cluster_ = loadLE32(boot + 96);
+  uint64_t clusters = loadLE32(boot + 92);
+  if (fat_length < 8 || clusters == 0)
+  {
+    return false;
+  }
+  cluster_count_ = static_cast<uint32_t>(std::min(clusters, fat_length / 4 - 2));
+  uint64_t needed = (static_cast<uint64_t>(cluster_count_) + 2) * 4;
+  if (!loadTable(fat_offset, needed, boot[110] == 2 ? fat_offset + fat_length : UINT64_MAX) ||
+      !validCluster(root_cluster_))
+  {
+    return false;
+  }
+
+  // The allocation bitmap is described by an entry in the root directory.
+  std::vector<uint8_t> root;
+  readClusters(chain(root_cluster_, MAX_DIRECTORY_BYTES / cluster_size_), root);
+  for (size_t pos = 0; pos + DIR_ENTRY <= root.size(); pos += DIR_ENTRY)
+  {
+    if (root[pos] == EXFAT_BITMAP && (root[pos + 1] & 1) == 0)
+    {
+      uint64_t length = loadLE64(root.data() + pos + 24);
+      uint64_t count = (length + cluster_size_ - 1) / cluster_size_;
+      if (length < (cluster_count_ + 7) / 8 || count > cluster_count_)
+      {
+        break;
+      }
+      std::vector<uint32_t> clusters_list = chain(loadLE32(root.data() + pos + 20), count);
+      readClusters(clusters_list, bitmap_);
+      if (bitmap_.size() < (cluster_count_ + 7) / 8)
+      {
+        bitmap_.clear();  // unusable: fall back to the FAT
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+bool FatVolume::loadTable(uint64_t offset, uint64_t length, uint64_t backup_offset)
+{
+  table_.assign(static_cast<size_t>(length), 0);
+  bool any = false;
+  for (uint64_t done = 0; done < length; done += TABLE_PIECE)
+  {
+    size_t piece = static_cast<size_t>(std::min<uint64_t>(TABLE_PIECE, length - done));
+    uint8_t* out = table_.data() + done;
+    size_t got = device_.read(base_ + offset + done, out, piece);
+    while (got < piece)
+    {
+      // Fill the failed sector from the backup table, then resume on the primary.
+      size_t sector = std::min<size_t>(sector_size_, piece - got);
+      if (backup_offset != UINT64_MAX &&
+          device_.read(base_ + backup_offset + done + got, out + got, sector) == sector)
+      {
+        ++fat_repairs_;
+      }
+      got += sector;
+      if (got < piece)
+      {
+        got += device_.read(base_ + offset + done + got, out + got, piece - got);
+      }
+    }
+    any = true;
+  }
+  return any;
+}
+
+uint32_t FatVolume::next(uint32_t cluster) const
+{
+  switch (kind_)
+  {
+    case FatKind::Fat12:
+    {
+      size_t pos = cluster + cluster / 2;
+      if (pos + 2 > table_.size())
+      {
+        return 0;
+      }
+      uint16_t v = loadLE16(table_.data() + pos);
+      uint32_t value = (cluster & 1) != 0 ? v >> 4 : v & 0xFFF;
+      return value >= 0xFF7 ? UINT32_MAX : value;
+    }
+    case FatKind::Fat16:
+    {
+      size_t pos = static_cast<size_t>(cluster) * 2;
+      if (pos + 2 > table_.size())
+      {
+        return 0;
+      }
+      uint32_t value = loadLE16(table_.data() + pos);
+      return value >= 0xFFF7 ? UINT32_MAX : value;
+    }
+    case FatKind::Fat32:
+    case FatKind::Exfat:
+    {
+      size_t pos = static_cast<size_t>(cluster) * 4;
+      if (pos + 4 > table_.size())
+      {
+        return 0;
+      }
+      uint32_t value = loadLE32(table_.data() + pos);
+      if (kind_ == FatKind::Fat32)
+      {
+        value &= 0x0FFFFFFF;
+        return value >= 0x0FFFFFF7 ? UINT32_MAX : value;
+      }
+      return value >= 0xFFFFFFF7 ? UINT32_MAX : value;
+    }
+  }
+  return 0;
+}
+
+bool FatVolume::isAllocated(uint32_t cluster) const
+{
+  if (!validCluster(cluster))
+  {
+    return false;
+  }
+  if (!bitmap_.empty())
+  {
+    uint32_t bit = cluster - 2;
+    return (bitmap_[bit / 8] >> (bit % 8) & 1) != 0;
+  }
+  return next(cluster) != 0;
+}
+
+std::vector<uint32_t> FatVolume::chain(uint32_t first, uint64_t max_clusters) const
+{
+  std::vector<uint32_t> out;
+  max_clusters = std::min<uint64_t>(max_clusters, cluster_count_);
+  for (uint32_t cluster = first; validCluster(cluster) && out.size() < max_clusters;)
+  {
+    out.push_back(cluster);
+    cluster = next(cluster);
+  }
+  return out;
+}
+
+std::vector<uint32_t> FatVolume::clusters(const FatEntry& entry) const
+{
+  std::vector<uint32_t> out;
+  if (!validCluster(entry.first_cluster))
+  {
+    return out;
+  }
+  uint64_t count = entry.size != 0 ? (entry.size + cluster_size_ - 1) / cluster_size_
+                                   : MAX_DIRECTORY_BYTES / cluster_size_;
+  if (entry.contiguous)
+  {
+    for (uint64_t i = 0; i < count && validCluster(entry.first_cluster + static_cast<uint32_t>(i));
+         ++i)
+    {
+      out.push_back(entry.first_cluster + static_cast<uint32_t>(i));
+    }
+    return out;
+  }
+  if (entry.deleted)
+  {
+    out.push_back(entry.first_cluster);
+    return out;
+  }
+  return chain(entry.first_cluster, count);
+}
+
+std::vector<Extent> FatVolume::extents(const std::vector<uint32_t>& clusters,
+                                       uint64_t size) const
+{
+  std::vector<Extent> out;
+  for (uint32_t cluster : clusters)
+  {
+    if (size == 0)
+    {
+      break;
+    }
+    uint64_t offset = clusterOffset(cluster);
+    uint64_t length = std::min<uint64_t>(cluster_size_, size);
+    size -= length;
+    if (!out.empty() && out.back().offset + out.back().length == offset)
+    {
+      out.back().length += length;
+    }
+    else
+    {
+      out.push_back({offset, length});
+    }
+  }
+  return out;
+}
+
+bool FatVolume::readClusters(const std::vector<uint32_t>& clusters, std::vector<uint8_t>& out)
+{
+  out.assign(clusters.size() * static_cast<size_t>(cluster_size_), 0);
+  bool complete = true;
+  size_t pos = 0;
+  for (const Extent& extent : extents(clusters, out.size()))
+  {
+    size_t length = static_cast<size_t>(extent.length);
+    complete = device_.read(extent.offset, out.data() + pos, length) == length && complete;
+    pos += length;
+  }
+  return complete;
+}
+
+void FatVolume::walkFat(const std::vector<uint8_t>& data, const std::string& prefix,
+                        bool include_deleted, std::vector<FatEntry>& out) const
+{
+  std::vector<const uint8_t*> slots;  // long-name slots preceding the short entry
+  for (size_t pos = 0; pos + DIR_ENTRY <= data.size(); pos += DIR_ENTRY)
+  {
+    const uint8_t* e = data.data() + pos;
+    if (e[0] == 0)
+    {
+      break;  // end of directory
+    }
+    if (e[11] == ATTR_LFN)
+    {
+      slots.push_back(e);
+      continue;
+    }
+    bool deleted = e[0] == FAT_DELETED;
+    bool usable = e[0] != '.' && (e[11] & ATTR_VOLUME) == 0 && (include_deleted || !deleted);
+    for (size_t i = 1; usable && i < 11; ++i)
+    {
+      usable = e[i] >= 0x20 && e[i] != 0x7F;
+    }
+    if (!usable)
+    {
+      slots.clear();
+      continue;
+    }
+
+    // A deleted entry lost its first byte; the slot checksum identifies it.
+    uint8_t first = e[0];
+    bool have_long = false;
+    if (!slots.empty())
+    {
+      uint8_t name[11];
+      std::memcpy(name, e, sizeof name);
+      auto matches = [&]()
+      {
+        uint8_t sum = shortNameChecksum(name);
+        return std::all_of(slots.begin(), slots.end(),
+                           [sum](const uint8_t* slot) { return slot[13] == sum; });
+      };
+      if (!deleted)
+      {
+        have_long = matches();
+      }
+      for (unsigned candidate = 0x20; deleted && !have_long && candidate < 0x100; ++candidate)
+      {
+        name[0] = static_cast<uint8_t>(candidate);
+        have_long = candidate != FAT_DELETED && matches();
+        first = name[0];
+      }
+    }
+    if (deleted && !have_long)
+    {
+      first = '_';
+    }
+
+    FatEntry entry;
+    if (have_long)
+    {
+      // Slots are stored last part first.
+      std::vector<uint16_t> units;
+      for (auto it = slots.rbegin(); it != slots.rend(); ++it)
+      {
+        for (size_t offset : {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30})
+        {
+          units.push_back(loadLE16(*it + offset));
+        }
+      }
+      appendUtf16(entry.path, units);
+    }
+    if (entry.path.empty())
+    {
+      entry.path = shortName(e, first);
+    }
+    entry.path.insert(0, prefix);
+    uint32_t high = kind_ == FatKind::Fat32 ? loadLE16(e + 20) : 0;
+    entry.first_cluster = (high << 16) | loadLE16(e + 26);
+    entry.directory = (e[11] & ATTR_DIRECTORY) != 0;
+    entry.size = entry.directory ? 0 : loadLE32(e + 28);
+    entry.deleted = deleted;
+    slots.clear();
+    if (deleted && (!validCluster(entry.first_cluster) || (!entry.directory && entry.size == 0)))
+    {
+      continue;  // nothing left to recover
+    }
+    out.push_back(std::move(entry));
+  }
+}
+
+void FatVolume::walkExfat(const std::vector<uint8_t>& data, const std::string& prefix,
+                          bool include_deleted, std::vector<FatEntry>& out)
+{
+  for (size_t pos = 0; pos + DIR_ENTRY <= data.size();)
+  {
+    const uint8_t* e = data.data() + pos;
+    if (e[0] == 0)
+    {
+      break;  // end of directory
+    }
+    uint8_t in_use = e[0] & EXFAT_IN_USE;
+    size_t secondary = e[1];
+    size_t set_size = (secondary + 1) * DIR_ENTRY;
+    const uint8_t* stream = e + DIR_ENTRY;
+    if ((e[0] & 0x7F) != EXFAT_FILE || secondary < 2 || secondary > 18 ||
+        pos + set_size > data.size() || stream[0] != (EXFAT_STREAM | in_use))
+    {
+      pos += DIR_ENTRY;
+      continue;
+    }
+    pos += set_size;
+    bool deleted = in_use == 0;
+    if (deleted && !include_deleted)
+    {
+      continue;
+    }
+    size_t name_length = stream[3];
+    std::vector<uint16_t> units;
+    for (size_t s = 2; s <= secondary && units.size() < name_length; ++s)
+    {
+      const uint8_t* part = e + s * DIR_ENTRY;
+      if (part[0] != (EXFAT_NAME | in_use))
+      {
+        break;
+      }
+      for (size_t i = 0; i < 15 && units.size() < name_length; ++i)
+      {
+        units.push_back(loadLE16(part + 2 + 2 * i));
+      }
+    }
+    FatEntry entry;
+    appendUtf16(entry.path, units);
+    if (entry.path.empty() || entry.path == "." || entry.path == "..")
+    {
+      entry.path.insert(0, "_");
+    }
+    entry.path.insert(0, prefix);
+    entry.directory = (loadLE16(e + 4) & ATTR_DIRECTORY) != 0;
+    entry.contiguous = (stream[1] & EXFAT_NO_FAT_CHAIN) != 0;
+    entry.first_cluster = loadLE32(stream + 20);
+    entry.size = loadLE64(stream + 24);
+    entry.deleted = deleted;
+    if (entry.size != 0 && !validCluster(entry.first_cluster))
+    {
+      entry.first_cluster = 0;
+      if (deleted)
+      {
+        continue;
+      }
+    }
+    out.push_back(std::move(entry));
+  }
+}
+
+void FatVolume::scanDirectories(bool include_deleted, unsigned max_depth)
+{
+  struct Directory
+  {
+    std::vector<uint32_t> clusters;
+    std::string prefix;
+    unsigned depth;
+  };
+
+  entries_.clear();
+  damaged_directories_ = 0;
+  std::unordered_set<uint32_t> visited;
+  std::deque<Directory> queue;
+  auto enqueue = [&](size_t from, unsigned depth)
+  {
+    for (size_t i = from; i < entries_.size() && depth + 1 < max_depth; ++i)
+    {
+      const FatEntry& entry = entries_[i];
+      // A deleted directory whose first cluster was reused is gone.
+      if (!entry.directory || (entry.deleted && isAllocated(entry.first_cluster)) ||
+          !visited.insert(entry.first_cluster).second)
+      {
+        continue;
+      }
+      FatEntry layout = entry;
+      layout.size = std::min(entry.size, MAX_DIRECTORY_BYTES);
+      queue.push_back({clusters(layout), entry.path + "/", depth + 1});
+    }
+  };
+
+  std::vector<uint8_t> data;
+  if (kind_ == FatKind::Fat12 || kind_ == FatKind::Fat16)
+  {
+    data.assign(static_cast<size_t>(root_length_), 0);
+    if (device_.read(base_ + root_offset_, data.data(), data.size()) != data.size())
+    {
+      ++damaged_directories_;
+    }
+    walkFat(data, std::string(), include_deleted, entries_);
+    enqueue(0, 0);
+  }
+  else
+  {
+    queue.push_back({chain(root_cluster_, MAX_DIRECTORY_BYTES / cluster_size_), "", 0});
+    visited.insert(root_cluster_);
+  }
+
+  while (!queue.empty())
+  {
+    Directory dir = std::move(queue.front());
+    queue.pop_front();
+    if (!readClusters(dir.clusters, data))
+    {
+      ++damaged_directories_;
+    }
+    size_t from = entries_.size();
+    if (kind_ == FatKind::Exfat)
+    {
+      walkExfat(data, dir.prefix, include_deleted, entries_);
+    }
+    else
+    {
+      walkFat(data, dir.prefix, include_deleted, entries_);
+    }
+    enqueue(from, dir.depth);
+  }
+}
+
+}  // namespace rsn
@@ -0,0 +1,122 @@
+// RecoverySoftNetz — FAT12/16/32 and exFAT volume reader
+//
+// Loads the allocation table (sectors the first copy cannot supply are taken
+// from the second) and, for exFAT, the allocation bitmap, then walks the
+// directory tree. Deleted entries are kept:
+//   - FAT frees the cluster chain but leaves the first cluster, the size and
+//     the long-name slots. The long name is recovered when the slot checksum
+//     matches the short entry under some replacement of its erased first byte;
+//   - exFAT clears the in-use bit of each entry of the set and the bitmap bits,
+//     but the stream extension keeps the first cluster, the size and the
+//     NoFatChain flag.
+// A deleted entry's clusters are not known beyond the first one unless the
+// entry was contiguous; laying it out is left to the caller.
+
+#pragma once
+
+#include "core/device.h"
+#include "core/file_registry.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+enum class FatKind : uint8_t
+{
+  Fat12,
+  Fat16,
+  Fat32,
+  Exfat,
+};
+
+struct FatEntry
+{
+  std::string path;            // '/'-separated, relative to the root
+  uint64_t size = 0;           // bytes; 0 for directories on FAT
+  uint32_t first_cluster = 0;  // 0 when no cluster is allocated
+  bool directory = false;
+  bool deleted = false;
+  bool contiguous = false;     // exFAT NoFatChain: the clusters follow each other
+};
+
+class FatVolume
+{
+public:
+  /// Parse the boot sector at `base` and load the allocation state. Returns
+  /// nullptr when no FAT or exFAT boot sector is found there.
+  static std::unique_ptr<FatVolume> open(Device& device, uint64_t base = 0);
+
+  FatKind kind() const { return kind_; }
+  const char* kindName() const;
+  uint64_t base() const { return base_; }
+  uint32_t clusterSize() const { return cluster_size_; }
+
+  /// Data clusters are numbered from 2 to `clusterCount() + 1`.
+  uint32_t clusterCount() const { return cluster_count_; }
+  bool validCluster(uint32_t cluster) const
+  {
+    return cluster >= 2 && cluster - 2 < cluster_count_;
+  }
+  uint64_t clusterOffset(uint32_t cluster) const
+  {
+    return base_ + data_offset_ + static_cast<uint64_t>(cluster - 2) * cluster_size_;
+  }
+
+  /// In use according to the FAT (or the exFAT allocation bitmap).
+  bool isAllocated(uint32_t cluster) const;
+
+  /// Walk the directory tree from the root, replacing any earlier result.
+  void scanDirectories(bool include_deleted = true, unsigned max_depth = 32);
+  const std::vector<FatEntry>& entries() const { return entries_; }
+
+  /// Directories whose clusters could not all be read.
+  uint64_t damagedDirectories() const { return damaged_directories_; }
+
+  /// Allocation-table sectors that were read from the backup copy.
+  uint64_t fatRepairs() const { return fat_repairs_; }
+
+  /// Clusters of `entry` as recorded: the contiguous run for exFAT NoFatChain
+  /// entries, otherwise the FAT chain. Any other deleted entry yields only its
+  /// first cluster, since its chain was freed.
+  std::vector<uint32_t> clusters(const FatEntry& entry) const;
+
+  /// Device extents covering the first `size` bytes of `clusters`, adjacent
+  /// clusters coalesced.
+  std::vector<Extent> extents(const std::vector<uint32_t>& clusters, uint64_t size) const;
+
+private:
+  FatVolume(Device& device, uint64_t base) : device_(device), base_(base) {}
+
+  bool parseFat(const uint8_t* boot);
+  bool parseExfat(const uint8_t* boot);
+  bool loadTable(uint64_t offset, uint64_t length, uint64_t backup_offset);
+  uint32_t next(uint32_t cluster) const;
+  std::vector<uint32_t> chain(uint32_t first, uint64_t max_clusters) const;
+  bool readClusters(const std::vector<uint32_t>& clusters, std::vector<uint8_t>& out);
+  void walkFat(const std::vector<uint8_t>& data, const std::string& prefix,
+               bool include_deleted, std::vector<FatEntry>& out) const;
+  void walkExfat(const std::vector<uint8_t>& data, const std::string& prefix,
+                 bool include_deleted, std::vector<FatEntry>& out);
+
+  Device& device_;
+  uint64_t base_;
+  FatKind kind_ = FatKind::Fat32;
+  uint32_t sector_size_ = 512;
+  uint32_t cluster_size_ = 0;
+  uint32_t cluster_count_ = 0;
+  uint64_t data_offset_ = 0;    // first data cluster, relative to base_
+  uint64_t root_offset_ = 0;    // FAT12/16 fixed root directory, relative to base_
+  uint64_t root_length_ = 0;
+  uint32_t root_cluster_ = 0;   // FAT32 and exFAT
+  std::vector<uint8_t> table_;  // raw allocation table
+  std::vector<uint8_t> bitmap_; // exFAT allocation bitmap, one bit per cluster
+  std::vector<FatEntry> entries_;
+  uint64_t damaged_directories_ = 0;
+  uint64_t fat_repairs_ = 0;
+};
+
+}  // namespace rsn
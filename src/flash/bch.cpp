@@ -0,0 +1,341 @@
+// RecoverySoftNetz — binary BCH codec for NAND ECC
+
+#include "flash/bch.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+
+namespace rsn
+{
+
+namespace
+{
+
+// Default primitive polynomials for m = 5..15 (lib/bch's table).
+constexpr uint32_t PRIMITIVE[] = {0x25,  0x43,  0x83,   0x11d,  0x211, 0x409,
+                                  0x805, 0x1053, 0x201b, 0x402b, 0x8003};
+
+constexpr size_t SLICES = 4;
+constexpr size_t MAX_WORDS = (15 * BchCodec::MAX_STRENGTH + 63) / 64;
+
+}  // namespace
+
+std::unique_ptr<BchCodec> BchCodec::create(unsigned m, unsigned t, size_t data_bytes,
+                                           uint32_t polynomial)
+{
+  std::unique_ptr<BchCodec> codec(new BchCodec());
+  if (!codec->build(m, t, data_bytes, polynomial))
+  {
+    return nullptr;
+  }
+  return codec;
+}
+
+bool BchCodec::build(unsigned m, unsigned t, size_t data_bytes, uint32_t polynomial)
+{
+  if (m < 5 || m > 15 || t == 0 || t > MAX_STRENGTH || data_bytes == 0)
+  {
+    return false;
+  }
+  uint32_t poly = polynomial != 0 ? polynomial : PRIMITIVE[m - 5];
+  if (poly >> m != 1)
+  {
+    return false;
+  }
+  m_ = m;
+  t_ = t;
+  n_ = (1u << m) - 1;
+  data_bytes_ = data_bytes;
+
+  // GF(2^m) tables; alpha must run through every nonzero element.
+  pow_.assign(2 * static_cast<size_t>(n_), 0);
+  log_.assign(static_cast<size_t>(n_) + 1, 0);
+  uint32_t x = 1;
+  for (uint32_t i = 0; i < n_; ++i)
+  {
+    if (i > 0 && x == 1)
+    {
+      return false;
+    }
+    pow_[i] = x;
+    pow_[i + n_] = x;
+    log_[x] = i;
+    x <<= 1;
+    if ((x >> m) != 0)
+    {
+      x ^= poly;
+    }
+  }
+
+  // The generator has every alpha^i, i in 1..2t, and its conjugates as roots.
+  std::vector<bool> root(n_, false);
+  for (uint32_t i = 1; i <= 2 * t; ++i)
+  {
+    uint32_t r = i;
+    while (!root[r])
+    {
+      root[r] = true;
+      r = static_cast<uint32_t>((2ull * r) % n_);
+    }
+  }
+  std::vector<uint32_t> g{1};
+  for (uint32_t r = 1; r < n_; ++r)
+  {
+    if (!root[r])
+    {
+      continue;
+    }
+    g.push_back(0);
+    for (size_t k = g.size() - 1; k > 0; --k)
+    {
+      g[k] = g[k - 1] ^ multiply(g[k], pow_[r]);
+    }
+    g[0] = multiply(g[0], pow_[r]);
+  }
+  ecc_bits_ = g.size() - 1;
+  if (data_bytes * 8 + ecc_bits_ > n_)
+  {
+    return false;
+  }
+
+  // Remainder tables over a left-aligned register: row v of slice k is
+  // v * x^(8k + ecc_bits) mod g, so four bytes fold in with four lookups.
+  words_ = (ecc_bits_ + 63) / 64;
+  std::vector<uint64_t> low(words_, 0);
+  for (size_t j = 0; j < ecc_bits_; ++j)
+  {
+    if (g[j] != 0)
+    {
+      size_t p = ecc_bits_ - 1 - j;
+      low[p / 64] |= 1ull << (63 - p % 64);
+    }
+  }
+  table_.assign(SLICES * 256 * words_, 0);
+  for (unsigned v = 0; v < 256; ++v)
+  {
+    uint64_t* reg = &table_[v * words_];
+    for (int bit = 7; bit >= 0; --bit)
+    {
+      bool feedback = (((v >> bit) & 1) != 0) != ((reg[0] >> 63) != 0);
+      for (size_t w = 0; w < words_; ++w)
+      {
+        reg[w] = (reg[w] << 1) | (w + 1 < words_ ? reg[w + 1] >> 63 : 0);
+      }
+      if (feedback)
+      {
+        for (size_t w = 0; w < words_; ++w)
+        {
+          reg[w] ^= low[w];
+        }
+      }
+    }
+  }
+  for (size_t k = 1; k < SLICES; ++k)
+  {
+    for (unsigned v = 0; v < 256; ++v)
+    {
+      const uint64_t* from = &table_[((k - 1) * 256 + v) * words_];
+      uint64_t* to = &table_[(k * 256 + v) * words_];
+      const uint64_t* row = &table_[(from[0] >> 56) * words_];
+      for (size_t w = 0; w < words_; ++w)
+      {
+        to[w] = ((from[w] << 8) | (w + 1 < words_ ? from[w + 1] >> 56 : 0)) ^ row[w];
+      }
+    }
+  }
+  return true;
+}
+
+uint32_t BchCodec::multiply(uint32_t a, uint32_t b) const
+{
+  return a == 0 || b == 0 ? 0 : pow_[log_[a] + log_[b]];
+}
+
+void BchCodec::remainder(const uint8_t* data, uint64_t* reg) const
+{
+  for (size_t w = 0; w < words_; ++w)
+  {
+    reg[w] = 0;
+  }
+  size_t i = 0;
+  if (ecc_bits_ >= 32)
+  {
+    const size_t stride = 256 * words_;
+    for (; i + 4 <= data_bytes_; i += 4)
+    {
+      uint32_t top = static_cast<uint32_t>(reg[0] >> 32) ^ loadBE32(data + i);
+      const uint64_t* r3 = &table_[3 * stride + (top >> 24) * words_];
+      const uint64_t* r2 = &table_[2 * stride + ((top >> 16) & 0xFF) * words_];
+      const uint64_t* r1 = &table_[stride + ((top >> 8) & 0xFF) * words_];
+      const uint64_t* r0 = &table_[(top & 0xFF) * words_];
+      for (size_t w = 0; w < words_; ++w)
+      {
+        uint64_t shifted = (reg[w] << 32) | (w + 1 < words_ ? reg[w + 1] >> 32 : 0);
+        reg[w] = shifted ^ r3[w] ^ r2[w] ^ r1[w] ^ r0[w];
+      }
+    }
+  }
+  for (; i < data_bytes_; ++i)
+  {
+    const uint64_t* row = &table_[((reg[0] >> 56) ^ data[i]) * words_];
+    for (size_t w = 0; w < words_; ++w)
+    {
+      reg[w] = ((reg[w] << 8) | (w + 1 < words_ ? reg[w + 1] >> 56 : 0)) ^ row[w];
+    }
+  }
+}
+
+void BchCodec::encode(const uint8_t* data, uint8_t* ecc) const
+{
+  uint64_t reg[MAX_WORDS];
+  remainder(data, reg);
+  for (size_t i = 0; i < eccBytes(); ++i)
+  {
+    ecc[i] = static_cast<uint8_t>(reg[i / 8] >> (56 - 8 * (i % 8)));
+  }
+}
+
+int BchCodec::decode(uint8_t* data, uint8_t* ecc) const
+{
+  uint64_t reg[MAX_WORDS];
+  remainder(data, reg);
+  size_t ecc_bytes = eccBytes();
+  uint64_t any = 0;
+  for (size_t i = 0; i < ecc_bytes; ++i)
+  {
+    uint8_t byte = ecc[i];
+    if (i + 1 == ecc_bytes && ecc_bits_ % 8 != 0)
+    {
+      byte &= static_cast<uint8_t>(0xFF << (8 - ecc_bits_ % 8));  // padding bits
+    }
+    reg[i / 8] ^= static_cast<uint64_t>(byte) << (56 - 8 * (i % 8));
+  }
+  for (size_t w = 0; w < words_; ++w)
+  {
+    any |= reg[w];
+  }
+  if (any == 0)
+  {
+    return 0;
+  }
+
+  // Syndromes of the parity difference: S_i = r(alpha^i), S_2i = S_i^2.
+  uint32_t s[2 * MAX_STRENGTH + 1] = {};
+  for (size_t p = 0; p < ecc_bits_; ++p)
+  {
+    if (((reg[p / 64] >> (63 - p % 64)) & 1) == 0)
+    {
+      continue;
+    }
+    uint64_t degree = ecc_bits_ - 1 - p;
+    for (unsigned i = 1; i < 2 * t_; i += 2)
+    {
+      s[i] ^= pow_[(i * degree) % n_];
+    }
+  }
+  for (unsigned i = 2; i <= 2 * t_; i += 2)
+  {
+    s[i] = multiply(s[i / 2], s[i / 2]);
+  }
+
+  // Berlekamp-Massey: the error locator c(x), of degree `errors`.
+  uint32_t c[2 * MAX_STRENGTH + 2] = {1};
+  uint32_t b[2 * MAX_STRENGTH + 2] = {1};
+  uint32_t previous[2 * MAX_STRENGTH + 2];
+  unsigned errors = 0;
+  unsigned shift = 1;
+  uint32_t last = 1;
+  for (unsigned k = 0; k < 2 * t_; ++k)
+  {
+    uint32_t d = s[k + 1];
+    for (unsigned i = 1; i <= errors; ++i)
+    {
+      d ^= multiply(c[i], s[k + 1 - i]);
+    }
+    if (d == 0)
+    {
+      ++shift;
+      continue;
+    }
+    uint32_t scale = pow_[log_[d] + n_ - log_[last]];
+    bool grow = 2 * errors <= k;
+    if (grow)
+    {
+      std::copy(c, c + 2 * t_ + 1, previous);
+    }
+    for (unsigned i = 0; i + shift <= 2 * t_; ++i)
+    {
+      c[i + shift] ^= multiply(scale, b[i]);
+    }
+    if (grow)
+    {
+      errors = k + 1 - errors;
+      std::copy(previous, previous + 2 * t_ + 1, b);
+      last = d;
+      shift = 1;
+    }
+    else
+    {
+      ++shift;
+    }
+  }
+  if (errors > t_)
+  {
+    return -1;
+  }
+
+  // Chien search over the codeword's bit degrees: c(alpha^-d) = 0 marks an
+  // error at degree d. Term k steps by alpha^-k.
+  uint32_t term[MAX_STRENGTH + 1];
+  for (unsigned k = 1; k <= errors; ++k)
+  {
+    term[k] = c[k] != 0 ? log_[c[k]] : n_;  // n_ marks a zero coefficient
+  }
+  size_t data_bits = data_bytes_ * 8;
+  size_t length = data_bits + ecc_bits_;
+  size_t roots[MAX_STRENGTH];
+  unsigned found = 0;
+  for (size_t d = 0; d < length && found < errors; ++d)
+  {
+    uint32_t value = 1;
+    for (unsigned k = 1; k <= errors; ++k)
+    {
+      if (term[k] == n_)
+      {
+        continue;
+      }
+      value ^= pow_[term[k]];
+      term[k] += n_ - k;
+      if (term[k] >= n_)
+      {
+        term[k] -= n_;
+      }
+    }
+    if (value == 0)
+    {
+      roots[found++] = d;
+    }
+  }
+  if (found != errors)
+  {
+    return -1;  // roots outside the (shortened) codeword: too many errors
+  }
+  for (unsigned i = 0; i < found; ++i)
+  {
+    size_t d = roots[i];
+    if (d >= ecc_bits_)
+    {
+      size_t bit = data_bits - 1 - (d - ecc_bits_);
+      data[bit / 8] ^= static_cast<uint8_t>(0x80 >> (bit % 8));
+    }
+    else
+    {
+      size_t bit = ecc_bits_ - 1 - d;
+      ecc[bit / 8] ^= static_cast<uint8_t>(0x80 >> (bit % 8));
+    }
+  }
+  return static_cast<int>(errors);
+}
+
+}  // namespace rsn
@@ -0,0 +1,67 @@
+// RecoverySoftNetz — binary BCH codec for NAND ECC
+//
+// NAND controllers protect each ECC step (512 or 1024 data bytes) with a
+// binary BCH code over GF(2^m) that corrects up to `t` bit errors; the parity
+// is m * t bits, stored in the spare area. The codec follows the convention of
+// the Linux kernel's lib/bch: data bits enter most significant bit first, the
+// parity is the remainder of data(x) * x^(m*t) modulo the generator, stored
+// most significant bit first, and the default primitive polynomials are the
+// same.
+//
+// Decoding first recomputes the parity and compares it: a word-wide register
+// advanced four bytes at a time through four 256-entry tables (slicing), so a
+// clean step costs one independent lookup per byte. Only when the parity
+// differs are syndromes taken from the difference (m * t bits, not the whole
+// step), the error locator found with Berlekamp-Massey and its roots by a
+// Chien search.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rsn
+{
+
+class BchCodec
+{
+public:
+  static constexpr unsigned MAX_STRENGTH = 64;
+
+  /// Build the code for `data_bytes` per step. Returns nullptr when m is
+  /// outside 5..15, t outside 1..MAX_STRENGTH, the codeword does not fit in
+  /// 2^m - 1 bits, or `polynomial` (0 = default) is not primitive.
+  static std::unique_ptr<BchCodec> create(unsigned m, unsigned t, size_t data_bytes,
+                                          uint32_t polynomial = 0);
+
+  size_t dataBytes() const { return data_bytes_; }
+  size_t eccBytes() const { return (ecc_bits_ + 7) / 8; }
+  unsigned strength() const { return t_; }
+
+  void encode(const uint8_t* data, uint8_t* ecc) const;
+
+  /// Correct a step and its parity in place. Returns the number of bits
+  /// corrected, or -1 when there are more errors than the code corrects.
+  int decode(uint8_t* data, uint8_t* ecc) const;
+
+private:
+  BchCodec() = default;
+
+  bool build(unsigned m, unsigned t, size_t data_bytes, uint32_t polynomial);
+  void remainder(const uint8_t* data, uint64_t* reg) const;
+  uint32_t multiply(uint32_t a, uint32_t b) const;
+
+  unsigned m_ = 0;
+  unsigned t_ = 0;
+  uint32_t n_ = 0;          // 2^m - 1
+  size_t data_bytes_ = 0;
+  size_t ecc_bits_ = 0;
+  size_t words_ = 0;        // register width in 64-bit words, parity left-aligned
+  std::vector<uint32_t> pow_;  // alpha^i for i in [0, 2n)
+  std::vector<uint32_t> log_;
+  std::vector<uint64_t> table_;  // remainder slices, 256 rows of `words_` each
+};
+
+}  // namespace rsn
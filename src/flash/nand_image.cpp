@@ -0,0 +1,475 @@
+// RecoverySoftNetz — NAND chip-off dump device
+
+#include "flash/nand_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint64_t NONE = UINT64_MAX;
+
+inline int popcount64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(v);
+#else
+  int n = 0;
+  for (; v != 0; v &= v - 1)
+  {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+/// Zero bits in [data, data + size), counting stops past `limit`.
+unsigned zeroBits(const uint8_t* data, size_t size, unsigned limit)
+{
+  unsigned zeros = 0;
+  size_t i = 0;
+  for (; i + 8 <= size && zeros <= limit; i += 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    zeros += static_cast<unsigned>(popcount64(~word));
+  }
+  for (; i < size && zeros <= limit; ++i)
+  {
+    zeros += static_cast<unsigned>(popcount64(static_cast<uint8_t>(~data[i])));
+  }
+  return zeros;
+}
+
+/// The value most entries hold; NONE when there are none.
+uint64_t mostCommon(std::vector<uint64_t>& values)
+{
+  std::sort(values.begin(), values.end());
+  uint64_t best = NONE;
+  size_t best_run = 0;
+  for (size_t i = 0; i < values.size();)
+  {
+    size_t j = i;
+    while (j < values.size() && values[j] == values[i])
+    {
+      ++j;
+    }
+    if (j - i > best_run)
+    {
+      best = values[i];
+      best_run = j - i;
+    }
+    i = j;
+  }
+  return best;
+}
+
+/// A written physical page, as a candidate copy of a logical page.
+struct Copy
+{
+  uint64_t logical;
+  bool failed;
+  uint64_t version;
+  uint32_t physical;
+};
+
+}  // namespace
+
+std::unique_ptr<NandImageDevice> NandImageDevice::open(Device& image, const NandLayout& layout,
+                                                       NandOptions options)
+{
+  std::unique_ptr<NandImageDevice> device(new NandImageDevice(image));
+  device->key_ = options.key != nullptr && !options.key->empty() ? options.key : nullptr;
+  if (!device->configure(layout))
+  {
+    return nullptr;
+  }
+  uint64_t blocks = device->physical_pages_ / layout.pages_per_block;
+  unsigned threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+  threads = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(threads, blocks)));
+  device->scan(threads);
+  if (!device->buildMap(options))
+  {
+    return nullptr;
+  }
+  return device;
+}
+
+bool NandImageDevice::configure(const NandLayout& layout)
+{
+  layout_ = layout;
+  const NandLayout& l = layout_;
+  if (l.page_size == 0 || l.pages_per_block == 0 || (l.interleaved && l.ecc_step == 0))
+  {
+    return false;
+  }
+  raw_size_ = static_cast<size_t>(l.page_size) + l.spare_size;
+  if (key_ != nullptr && key_->page_size != raw_size_)
+  {
+    return false;
+  }
+  if (l.ecc_step != 0)
+  {
+    if (l.page_size % l.ecc_step != 0)
+    {
+      return false;
+    }
+    codec_ = BchCodec::create(l.ecc_m, l.ecc_strength, l.ecc_step, l.ecc_polynomial);
+    if (!codec_)
+    {
+      return false;
+    }
+    steps_ = l.page_size / l.ecc_step;
+    uint64_t ecc = codec_->eccBytes();
+    if (l.interleaved)
+    {
+      step_spare_ = l.spare_size / steps_;
+      if (l.spare_size % steps_ != 0 || l.ecc_offset + ecc > step_spare_)
+      {
+        return false;
+      }
+    }
+    else if (l.ecc_offset + ecc * steps_ > l.spare_size)
+    {
+      return false;
+    }
+  }
+  for (const NandField* f : {&l.block, &l.version, &l.page})
+  {
+    if (f->width > 8 || (f->width != 0 && uint64_t(f->offset) + f->width > l.spare_size))
+    {
+      return false;
+    }
+  }
+  physical_pages_ = image_.size() / raw_size_ / l.pages_per_block * l.pages_per_block;
+  return physical_pages_ != 0 && physical_pages_ < UINT32_MAX;
+}
+
+void NandImageDevice::descramble(uint8_t* raw, uint64_t physical) const
+{
+  if (key_ != nullptr)
+  {
+    key_->apply(physical * raw_size_, raw, raw_size_);
+  }
+}
+
+uint8_t* NandImageDevice::stepData(uint8_t* raw, uint32_t step) const
+{
+  return raw + static_cast<size_t>(step) * (layout_.ecc_step + step_spare_);
+}
+
+size_t NandImageDevice::spareOffset(uint32_t index) const
+{
+  if (!layout_.interleaved)
+  {
+    return layout_.page_size + static_cast<size_t>(index);
+  }
+  return static_cast<size_t>(index / step_spare_) * (layout_.ecc_step + step_spare_) +
+         layout_.ecc_step + index % step_spare_;
+}
+
+NandPageState NandImageDevice::correct(uint8_t* raw, uint64_t& bits) const
+{
+  if (!codec_)
+  {
+    return zeroBits(raw, layout_.page_size, 0) == 0 ? NandPageState::Erased
+                                                    : NandPageState::Clean;
+  }
+  unsigned t = codec_->strength();
+  size_t ecc_bytes = codec_->eccBytes();
+  bool written = false;
+  bool corrected = false;
+  bool failed = false;
+  for (uint32_t s = 0; s < steps_; ++s)
+  {
+    uint8_t* data = stepData(raw, s);
+    uint32_t at = layout_.ecc_offset +
+                  (layout_.interleaved ? s * step_spare_ : s * static_cast<uint32_t>(ecc_bytes));
+    uint8_t* ecc = raw + spareOffset(at);
+    // An erased step is all ones and not a codeword; a few bits may have
+    // flipped since.
+    unsigned zeros = zeroBits(data, layout_.ecc_step, t);
+    if (zeros <= t && zeros + zeroBits(ecc, ecc_bytes, t - zeros) <= t)
+    {
+      if (zeros != 0)
+      {
+        std::memset(data, 0xFF, layout_.ecc_step);
+      }
+      continue;
+    }
+    written = true;
+    int fixed = codec_->decode(data, ecc);
+    if (fixed < 0)
+    {
+      failed = true;
+    }
+    else if (fixed > 0)
+    {
+      corrected = true;
+      bits += static_cast<uint64_t>(fixed);
+    }
+  }
+  return !written  ? NandPageState::Erased
+         : failed  ? NandPageState::Failed
+         : corrected ? NandPageState::Corrected
+                     : NandPageState::Clean;
+}
+
+uint64_t NandImageDevice::field(const uint8_t* raw, const NandField& spec) const
+{
+  if (spec.width == 0)
+  {
+    return NONE;
+  }
+  uint64_t value = 0;
+  bool erased = true;
+  for (uint32_t i = 0; i < spec.width; ++i)
+  {
+    uint32_t index = spec.big_endian ? spec.offset + i : spec.offset + spec.width - 1 - i;
+    uint8_t byte = raw[spareOffset(index)];
+    erased = erased && byte == 0xFF;
+    value = (value << 8) | byte;
+  }
+  return erased ? NONE : value;
+}
+
+void NandImageDevice::scan(unsigned threads)
+{
+  uint32_t per_block = layout_.pages_per_block;
+  uint64_t blocks = physical_pages_ / per_block;
+  states_.assign(physical_pages_, static_cast<uint8_t>(NandPageState::Erased));
+  numbers_.assign(blocks, NONE);
+  versions_.assign(blocks, 0);
+  if (layout_.page.width != 0)
+  {
+    logical_.assign(physical_pages_, UINT32_MAX);
+  }
+  stats_ = NandStats();
+  stats_.blocks = blocks;
+
+  std::atomic<uint64_t> next_block{0};
+  std::mutex stats_mutex;
+  auto worker = [&]() {
+    std::vector<uint8_t> raw(raw_size_ * per_block);
+    std::vector<uint64_t> numbers;
+    std::vector<uint64_t> versions;
+    NandStats local;
+    for (;;)
+    {
+      uint64_t block = next_block.fetch_add(1);
+      if (block >= blocks)
+      {
+        break;
+      }
+      size_t got = image_.read(block * per_block * raw_size_, raw.data(), raw.size());
+      std::fill(raw.begin() + static_cast<std::ptrdiff_t>(got), raw.end(), 0xFF);
+      numbers.clear();
+      versions.clear();
+      bool written = false;
+      for (uint32_t p = 0; p < per_block; ++p)
+      {
+        uint8_t* page = &raw[p * raw_size_];
+        uint64_t physical = block * per_block + p;
+        uint64_t bits = 0;
+        NandPageState state = correct(page, bits);
+        states_[physical] = static_cast<uint8_t>(state);
+        if (state == NandPageState::Erased)
+        {
+          continue;
+        }
+        descramble(page, physical);
+        written = true;
+        ++local.pages;
+        local.corrected_pages += state == NandPageState::Corrected ? 1 : 0;
+        local.corrected_bits += bits;
+        local.failed_pages += state == NandPageState::Failed ? 1 : 0;
+        uint64_t number = field(page, layout_.block);
+        uint64_t version = field(page, layout_.version);
+        if (number != NONE)
+        {
+          numbers.push_back(number);
+        }
+        if (version != NONE)
+        {
+          versions.push_back(version);
+        }
+        uint64_t index = field(page, layout_.page);
+        if (!logical_.empty() && index < per_block)
+        {
+          logical_[physical] = static_cast<uint32_t>(index);
+        }
+      }
+      local.erased_blocks += written ? 0 : 1;
+      numbers_[block] = mostCommon(numbers);
+      uint64_t version = mostCommon(versions);
+      versions_[block] = version != NONE ? version : 0;
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    stats_.erased_blocks += local.erased_blocks;
+    stats_.pages += local.pages;
+    stats_.corrected_pages += local.corrected_pages;
+    stats_.corrected_bits += local.corrected_bits;
+    stats_.failed_pages += local.failed_pages;
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+  {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& th : pool)
+  {
+    th.join();
+  }
+}
+
+bool NandImageDevice::buildMap(const NandOptions& options)
+{
+  uint32_t per_block = layout_.pages_per_block;
+  uint64_t blocks = physical_pages_ / per_block;
+  if (!options.ftl)
+  {
+    map_.resize(physical_pages_);
+    for (uint64_t p = 0; p < physical_pages_; ++p)
+    {
+      map_[p] = static_cast<uint32_t>(p);
+    }
+    stats_.mapped = physical_pages_;
+    size_ = physical_pages_ * layout_.page_size;
+    return true;
+  }
+
+  // Every written page of a numbered block is a candidate copy of its
+  // logical page.
+  uint64_t limit = options.logical_blocks != 0 ? options.logical_blocks : blocks;
+  uint64_t highest = 0;
+  std::vector<Copy> copies;
+  for (uint64_t block = 0; block < blocks; ++block)
+  {
+    uint64_t number = numbers_[block];
+    uint64_t first = block * per_block;
+    bool written = std::any_of(states_.begin() + static_cast<std::ptrdiff_t>(first),
+                               states_.begin() + static_cast<std::ptrdiff_t>(first + per_block),
+                               [](uint8_t s) { return s != uint8_t(NandPageState::Erased); });
+    if (!written)
+    {
+      continue;
+    }
+    if (number >= limit)
+    {
+      ++stats_.unassigned_blocks;
+      continue;
+    }
+    highest = std::max(highest, number);
+    for (uint32_t p = 0; p < per_block; ++p)
+    {
+      uint64_t physical = first + p;
+      auto state = static_cast<NandPageState>(states_[physical]);
+      uint32_t index = logical_.empty() ? p : logical_[physical];
+      if (state == NandPageState::Erased || index == UINT32_MAX)
+      {
+        continue;
+      }
+      copies.push_back({number * per_block + index, state == NandPageState::Failed,
+                        versions_[block], static_cast<uint32_t>(physical)});
+    }
+  }
+  if (copies.empty())
+  {
+    return false;
+  }
+
+  // Best copy first: correctable, newest version, latest physical page.
+  std::sort(copies.begin(), copies.end(), [](const Copy& a, const Copy& b)
+  {
+    if (a.logical != b.logical)
+    {
+      return a.logical < b.logical;
+    }
+    if (a.failed != b.failed)
+    {
+      return !a.failed;
+    }
+    return a.version != b.version ? a.version > b.version : a.physical > b.physical;
+  });
+  uint64_t logical_blocks = options.logical_blocks != 0 ? options.logical_blocks : highest + 1;
+  map_.assign(logical_blocks * per_block, UINT32_MAX);
+  for (size_t i = 0; i < copies.size(); ++i)
+  {
+    const Copy& copy = copies[i];
+    if (i > 0 && copies[i - 1].logical == copy.logical)
+    {
+      ++stats_.stale;
+      continue;
+    }
+    map_[copy.logical] = copy.physical;
+    ++stats_.mapped;
+    stats_.damaged += copy.failed ? 1 : 0;
+  }
+  stats_.missing = map_.size() - stats_.mapped;
+  size_ = map_.size() * layout_.page_size;
+  return true;
+}
+
+uint64_t NandImageDevice::physicalPage(uint64_t page) const
+{
+  return page < map_.size() && map_[page] != UINT32_MAX ? map_[page] : NONE;
+}
+
+size_t NandImageDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  if (offset >= size_)
+  {
+    return 0;
+  }
+  length = static_cast<size_t>(std::min<uint64_t>(length, size_ - offset));
+  auto* out = static_cast<uint8_t*>(buffer);
+  uint32_t page_size = layout_.page_size;
+  uint32_t step = layout_.interleaved ? layout_.ecc_step : page_size;
+  // Reads run concurrently, so each thread keeps one page buffer across calls.
+  thread_local std::vector<uint8_t> raw;
+  raw.resize(raw_size_);
+  size_t done = 0;
+  while (done < length)
+  {
+    uint64_t page = (offset + done) / page_size;
+    auto within = static_cast<uint32_t>((offset + done) % page_size);
+    size_t take = std::min<size_t>(page_size - within, length - done);
+    uint32_t physical = map_[page];
+    if (physical == UINT32_MAX)
+    {
+      std::memset(out + done, 0, take);
+      done += take;
+      continue;
+    }
+    if (image_.read(uint64_t(physical) * raw_size_, raw.data(), raw_size_) != raw_size_)
+    {
+      return done;
+    }
+    uint64_t bits = 0;
+    if (correct(raw.data(), bits) != NandPageState::Erased)
+    {
+      descramble(raw.data(), physical);
+    }
+    // Data bytes, skipping the spare bytes between interleaved steps.
+    for (size_t copied = 0; copied < take;)
+    {
+      uint32_t at = within + static_cast<uint32_t>(copied);
+      size_t run = std::min<size_t>(step - at % step, take - copied);
+      std::memcpy(out + done + copied, stepData(raw.data(), at / step) + at % step, run);
+      copied += run;
+    }
+    done += take;
+  }
+  return done;
+}
+
+}  // namespace rsn
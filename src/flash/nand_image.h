@@ -0,0 +1,150 @@
+// RecoverySoftNetz — NAND chip-off dump device
+//
+// A chip-off read of a USB stick or memory card is the raw flash array: every
+// page with its spare (OOB) bytes, in physical order, with bit errors the
+// controller would have corrected and the logical order its flash translation
+// layer kept. The device rebuilds the logical image the host saw:
+//   1. the layout is described by NandLayout: page, spare and block sizes, the
+//      ECC steps, whether each step's spare bytes follow it (interleaved) or
+//      all spare bytes follow the page, where the BCH parity sits and which
+//      spare fields hold the logical block number, a version counter and,
+//      for log-structured blocks, the logical page;
+//   2. `open` scans the dump in parallel, a block per task: each step is
+//      taken as erased when it has no more zero bits than the code corrects,
+//      and otherwise corrected with BchCodec. A block's number and version
+//      are the values most of its written pages carry;
+//   3. every logical page is served by its best copy: one that corrects
+//      before one that does not, then the highest version, then the latest
+//      physical page. A newer block that was only partly written before power
+//      was lost therefore still takes its missing pages from the block it
+//      replaced.
+// ECC is assumed to cover the data bytes of each step only. Logical pages no
+// block holds read as zeros. Scrambled data is descrambled after correction
+// with NandOptions::key, before the spare fields are read (see xor_key.h).
+
+#pragma once
+
+#include "core/device.h"
+#include "flash/bch.h"
+#include "flash/xor_key.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// An integer in the spare bytes of a page.
+struct NandField
+{
+  uint32_t offset = 0;  // within the page's spare bytes, in page order
+  uint8_t width = 0;    // bytes, 1..8; 0 = not stored
+  bool big_endian = false;
+};
+
+struct NandLayout
+{
+  uint32_t page_size = 2048;     // data bytes per page
+  uint32_t spare_size = 64;      // spare bytes per page
+  uint32_t pages_per_block = 64;
+  bool interleaved = false;      // each ECC step is followed by its share of the spare bytes
+  uint32_t ecc_step = 512;       // data bytes per ECC step; 0 = no ECC
+  unsigned ecc_m = 13;           // BCH over GF(2^m)
+  unsigned ecc_strength = 4;     // bit errors corrected per step
+  uint32_t ecc_polynomial = 0;   // 0 = default for m
+  uint32_t ecc_offset = 0;       // parity position in the spare bytes (in the step's share
+                                 // when interleaved; consecutive steps otherwise)
+  NandField block;               // logical block number
+  NandField version;             // write counter; higher is newer
+  NandField page;                // logical page within the block; unset = physical order
+};
+
+struct NandOptions
+{
+  bool ftl = true;              // false: serve the physical pages in order
+  uint32_t logical_blocks = 0;  // 0 = the highest block number seen, plus one
+  unsigned threads = 0;         // scan threads; 0 = hardware concurrency
+  const XorKey* key = nullptr;  // XORed over each written page after ECC correction; its
+                                // page size must be the raw page size
+};
+
+enum class NandPageState : uint8_t
+{
+  Erased,
+  Clean,
+  Corrected,
+  Failed,  // a step has more errors than the code corrects
+};
+
+struct NandStats
+{
+  uint64_t blocks = 0;             // physical blocks
+  uint64_t erased_blocks = 0;
+  uint64_t unassigned_blocks = 0;  // written, without a valid block number
+  uint64_t pages = 0;              // physical pages written
+  uint64_t corrected_pages = 0;
+  uint64_t corrected_bits = 0;
+  uint64_t failed_pages = 0;
+  uint64_t mapped = 0;             // logical pages with a copy
+  uint64_t stale = 0;              // copies passed over for a better one
+  uint64_t damaged = 0;            // logical pages served from a failed copy
+  uint64_t missing = 0;            // logical pages without a copy
+};
+
+class NandImageDevice : public Device
+{
+public:
+  /// Scan `image` and build the logical map. Returns nullptr when the layout
+  /// is inconsistent or does not fit the image, or when the FTL is rebuilt
+  /// and no block carries a number.
+  static std::unique_ptr<NandImageDevice> open(Device& image, const NandLayout& layout,
+                                               NandOptions options = NandOptions());
+
+  std::string name() const override { return image_.name() + " (nand)"; }
+  uint64_t size() const override { return size_; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+  const NandStats& stats() const { return stats_; }
+
+  /// Physical page serving logical page `page`; UINT64_MAX when none does.
+  uint64_t physicalPage(uint64_t page) const;
+
+  NandPageState pageState(uint64_t physical) const
+  {
+    return static_cast<NandPageState>(states_[physical]);
+  }
+
+private:
+  explicit NandImageDevice(Device& image) : image_(image) {}
+
+  bool configure(const NandLayout& layout);
+  void scan(unsigned threads);
+  bool buildMap(const NandOptions& options);
+
+  /// Correct a raw page in place; `bits` counts the bits corrected.
+  NandPageState correct(uint8_t* raw, uint64_t& bits) const;
+  void descramble(uint8_t* raw, uint64_t physical) const;
+  uint64_t field(const uint8_t* raw, const NandField& spec) const;
+  uint8_t* stepData(uint8_t* raw, uint32_t step) const;
+  size_t spareOffset(uint32_t index) const;
+
+  Device& image_;
+  NandLayout layout_;
+  std::unique_ptr<BchCodec> codec_;
+  const XorKey* key_ = nullptr;
+  uint32_t steps_ = 0;
+  uint32_t step_spare_ = 0;  // spare bytes after each step, when interleaved
+  size_t raw_size_ = 0;
+  uint64_t physical_pages_ = 0;
+  uint64_t size_ = 0;
+
+  std::vector<uint8_t> states_;     // NandPageState per physical page
+  std::vector<uint32_t> logical_;   // logical page within the block, per physical page
+  std::vector<uint64_t> numbers_;   // block number per physical block; UINT64_MAX = none
+  std::vector<uint64_t> versions_;  // version per physical block
+  std::vector<uint32_t> map_;       // physical page per logical page; UINT32_MAX = none
+  NandStats stats_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,439 @@
+// RecoverySoftNetz — XOR scrambling key recovery and descrambling
+
+#include "flash/xor_key.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t SECTOR = 512;
+constexpr unsigned MAX_CANDIDATES = 4;  // tied periods whose keys are compared on boot sectors
+constexpr double CHANCE = 1.0 / 256;    // equal bytes by chance
+
+inline int popcount64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(v);
+#else
+  int n = 0;
+  for (; v != 0; v &= v - 1)
+  {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+/// data ^= key over `size` bytes.
+void xorInto(uint8_t* data, const uint8_t* key, size_t size)
+{
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_xor_si256(d, k));
+  }
+#elif defined(__SSE2__)
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(d, k));
+  }
+#endif
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t d;
+    uint64_t k;
+    std::memcpy(&d, data + i, 8);
+    std::memcpy(&k, key + i, 8);
+    d ^= k;
+    std::memcpy(data + i, &d, 8);
+  }
+  for (; i < size; ++i)
+  {
+    data[i] ^= key[i];
+  }
+}
+
+/// A FAT or exFAT boot sector, or an MBR, once `key` is XORed in.
+bool bootSector(const uint8_t* sector, const uint8_t* key)
+{
+  auto at = [&](size_t i) { return static_cast<uint8_t>(sector[i] ^ key[i]); };
+  if (at(510) != 0x55 || at(511) != 0xAA)
+  {
+    return false;
+  }
+  if ((at(0) == 0xEB && at(2) == 0x90) || at(0) == 0xE9)
+  {
+    return true;
+  }
+  for (size_t entry = 446; entry < 510; entry += 16)
+  {
+    if (at(entry) != 0x00 && at(entry) != 0x80)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Pages read for the statistics: runs of consecutive pages.
+struct Sample
+{
+  uint32_t page_size = 0;
+  std::vector<uint8_t> data;
+  std::vector<uint64_t> index;  // dump page number of each page
+  std::vector<bool> erased;
+  std::vector<std::pair<size_t, size_t>> runs;  // [first, last) sample pages
+  uint64_t written = 0;
+
+  const uint8_t* page(size_t i) const { return &data[i * page_size]; }
+};
+
+void readSample(Device& dump, uint32_t page_size, uint64_t run_pages, uint64_t budget,
+                Sample& sample)
+{
+  sample.page_size = page_size;
+  uint64_t total = dump.size() / page_size;
+  uint64_t runs = std::max<uint64_t>(1, budget / page_size / run_pages);
+  runs = std::min(runs, std::max<uint64_t>(1, total / run_pages));
+  uint64_t spacing = total / runs;
+  for (uint64_t r = 0; r < runs; ++r)
+  {
+    uint64_t first = r * spacing;
+    uint64_t count = std::min(run_pages, total - first);
+    size_t base = sample.index.size();
+    sample.data.resize((base + count) * page_size);
+    size_t got = dump.read(first * page_size, &sample.data[base * page_size],
+                           count * page_size);
+    count = got / page_size;
+    sample.data.resize((base + count) * page_size);
+    for (uint64_t p = 0; p < count; ++p)
+    {
+      bool erased = isErasedPage(sample.page(base + p), page_size);
+      sample.index.push_back(first + p);
+      sample.erased.push_back(erased);
+      sample.written += erased ? 0 : 1;
+    }
+    sample.runs.push_back({base, base + count});
+  }
+}
+
+/// The key for `period` pages: per position, the value seen most often.
+/// `matched` counts the sampled bytes equal to their key byte.
+void estimateKey(const Sample& sample, uint32_t period, XorKey& key, uint64_t& matched,
+                 uint64_t& counted)
+{
+  uint32_t page_size = sample.page_size;
+  size_t positions = static_cast<size_t>(period) * page_size;
+  std::vector<uint8_t> value[2] = {std::vector<uint8_t>(positions, 0),
+                                   std::vector<uint8_t>(positions, 0)};
+  std::vector<uint32_t> count[2] = {std::vector<uint32_t>(positions, 0),
+                                    std::vector<uint32_t>(positions, 0)};
+  // Frequent items with two counters per position.
+  for (size_t i = 0; i < sample.index.size(); ++i)
+  {
+    if (sample.erased[i])
+    {
+      continue;
+    }
+    const uint8_t* page = sample.page(i);
+    size_t base = static_cast<size_t>(sample.index[i] % period) * page_size;
+    for (uint32_t j = 0; j < page_size; ++j)
+    {
+      size_t q = base + j;
+      uint8_t v = page[j];
+      if (count[0][q] != 0 && value[0][q] == v)
+      {
+        ++count[0][q];
+      }
+      else if (count[1][q] != 0 && value[1][q] == v)
+      {
+        ++count[1][q];
+      }
+      else if (count[0][q] == 0)
+      {
+        value[0][q] = v;
+        count[0][q] = 1;
+      }
+      else if (count[1][q] == 0)
+      {
+        value[1][q] = v;
+        count[1][q] = 1;
+      }
+      else
+      {
+        --count[0][q];
+        --count[1][q];
+      }
+    }
+  }
+  // Exact counts of both candidates.
+  std::fill(count[0].begin(), count[0].end(), 0);
+  std::fill(count[1].begin(), count[1].end(), 0);
+  counted = 0;
+  for (size_t i = 0; i < sample.index.size(); ++i)
+  {
+    if (sample.erased[i])
+    {
+      continue;
+    }
+    const uint8_t* page = sample.page(i);
+    size_t base = static_cast<size_t>(sample.index[i] % period) * page_size;
+    for (uint32_t j = 0; j < page_size; ++j)
+    {
+      size_t q = base + j;
+      count[0][q] += page[j] == value[0][q] ? 1 : 0;
+      count[1][q] += page[j] == value[1][q] && value[1][q] != value[0][q] ? 1 : 0;
+    }
+    counted += page_size;
+  }
+  key.page_size = page_size;
+  key.bytes.resize(positions);
+  matched = 0;
+  for (size_t q = 0; q < positions; ++q)
+  {
+    bool second = count[1][q] > count[0][q];
+    key.bytes[q] = value[second][q];
+    matched += count[second][q];
+  }
+}
+
+uint64_t countBootSectors(const Sample& sample, const XorKey& key)
+{
+  uint64_t found = 0;
+  uint32_t page_size = sample.page_size;
+  for (size_t i = 0; i < sample.index.size(); ++i)
+  {
+    if (sample.erased[i])
+    {
+      continue;
+    }
+    const uint8_t* slice = &key.bytes[(sample.index[i] % key.pages()) * page_size];
+    for (size_t at = 0; at + SECTOR <= page_size; at += SECTOR)
+    {
+      found += bootSector(sample.page(i) + at, slice + at) ? 1 : 0;
+    }
+  }
+  return found;
+}
+
+}  // namespace
+
+void XorKey::apply(uint64_t offset, uint8_t* data, size_t length) const
+{
+  if (bytes.empty())
+  {
+    return;
+  }
+  size_t at = static_cast<size_t>(offset % bytes.size());
+  while (length > 0)
+  {
+    size_t run = std::min(length, bytes.size() - at);
+    xorInto(data, bytes.data() + at, run);
+    data += run;
+    length -= run;
+    at = 0;
+  }
+}
+
+bool isErasedPage(const uint8_t* page, size_t size)
+{
+  // A bit in 512 may have flipped since the erase; scrambled data has half
+  // its bits clear.
+  size_t limit = size / 64;
+  size_t zeros = 0;
+  size_t i = 0;
+  for (; i + 8 <= size && zeros <= limit; i += 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, page + i, 8);
+    zeros += static_cast<size_t>(popcount64(~word));
+  }
+  for (; i < size && zeros <= limit; ++i)
+  {
+    zeros += static_cast<size_t>(popcount64(static_cast<uint8_t>(~page[i])));
+  }
+  return zeros <= limit;
+}
+
+bool detectXorKey(Device& dump, uint32_t page_size, XorKey& key, XorKeyReport* report,
+                  XorKeyOptions options)
+{
+  key = XorKey();
+  XorKeyReport result;
+  uint64_t total = page_size != 0 ? dump.size() / page_size : 0;
+  uint32_t max_period =
+    static_cast<uint32_t>(std::min<uint64_t>(std::max(options.max_period, 1u), total / 2));
+  if (max_period == 0 || options.probes == 0)
+  {
+    return false;
+  }
+  Sample sample;
+  readSample(dump, page_size, 2ull * max_period, options.sample_bytes, sample);
+  result.pages_sampled = sample.written;
+
+  // Autocorrelation at each period over a spread of probe bytes per page.
+  unsigned probes = std::min<unsigned>(options.probes, page_size);
+  std::vector<uint32_t> probe(probes);
+  for (unsigned k = 0; k < probes; ++k)
+  {
+    probe[k] = static_cast<uint32_t>(uint64_t(k) * page_size / probes);
+  }
+  uint64_t zeros = 0;
+  uint64_t probed = 0;
+  for (size_t i = 0; i < sample.index.size(); ++i)
+  {
+    for (unsigned k = 0; k < probes && !sample.erased[i]; ++k)
+    {
+      zeros += sample.page(i)[probe[k]] == 0 ? 1 : 0;
+      ++probed;
+    }
+  }
+  std::vector<double> score(max_period + 1, 0.0);
+  double best = 0.0;
+  for (uint32_t period = 1; period <= max_period; ++period)
+  {
+    uint64_t equal = 0;
+    uint64_t compared = 0;
+    for (const auto& run : sample.runs)
+    {
+      for (size_t i = run.first; i + period < run.second; ++i)
+      {
+        if (sample.erased[i] || sample.erased[i + period])
+        {
+          continue;
+        }
+        const uint8_t* a = sample.page(i);
+        const uint8_t* b = sample.page(i + period);
+        for (uint32_t at : probe)
+        {
+          equal += a[at] == b[at] ? 1 : 0;
+        }
+        compared += probes;
+      }
+    }
+    score[period] = compared != 0 ? static_cast<double>(equal) / static_cast<double>(compared)
+                                   : 0.0;
+    best = std::max(best, score[period]);
+  }
+  if (best == 0.0)
+  {
+    return false;
+  }
+  // Plain zeros match themselves at every period; scrambled ones do not.
+  double zero_share = probed != 0 ? static_cast<double>(zeros) / static_cast<double>(probed) : 0;
+  if (best < 4 * CHANCE || zero_share >= best / 2)
+  {
+    if (report != nullptr)
+    {
+      *report = result;
+    }
+    return true;
+  }
+
+  // The shortest periods scoring near the best (multiples of the true period
+  // score as well); the keys they give are compared on boot sectors.
+  uint64_t best_boot = 0;
+  unsigned tried = 0;
+  for (uint32_t period = 1; period <= max_period && tried < MAX_CANDIDATES; ++period)
+  {
+    if (score[period] < options.tolerance * best)
+    {
+      continue;
+    }
+    ++tried;
+    XorKey candidate;
+    uint64_t matched = 0;
+    uint64_t counted = 0;
+    estimateKey(sample, period, candidate, matched, counted);
+    uint64_t boot = countBootSectors(sample, candidate);
+    if (key.empty() || boot > best_boot)
+    {
+      key = std::move(candidate);
+      best_boot = boot;
+      result.period = period;
+      result.score = score[period];
+      result.agreement = counted != 0 ? static_cast<double>(matched) / static_cast<double>(counted)
+                                      : 0.0;
+    }
+  }
+  result.scrambled = true;
+  result.boot_sectors = best_boot;
+  if (report != nullptr)
+  {
+    *report = result;
+  }
+  return true;
+}
+
+size_t XorDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  uint32_t page = key_.page_size;
+  if (key_.empty())
+  {
+    return image_.read(offset, buffer, length);
+  }
+  // Whole pages are descrambled in place; erased ones are left as read.
+  auto descramble = [&](uint64_t start, uint8_t* data, size_t size)
+  {
+    for (size_t at = 0; at < size; at += page)
+    {
+      size_t run = std::min<size_t>(page, size - at);
+      if (!isErasedPage(data + at, run))
+      {
+        key_.apply(start + at, data + at, run);
+      }
+    }
+  };
+  auto* out = static_cast<uint8_t*>(buffer);
+  std::vector<uint8_t> scratch;
+  size_t done = 0;
+  while (done < length)
+  {
+    uint64_t at = offset + done;
+    size_t within = static_cast<size_t>(at % page);
+    size_t whole = within == 0 ? (length - done) / page * page : 0;
+    if (whole != 0)
+    {
+      size_t got = image_.read(at, out + done, whole);
+      descramble(at, out + done, got);
+      done += got;
+      if (got < whole)
+      {
+        break;
+      }
+      continue;
+    }
+    // A partial page at either end goes through a page buffer.
+    scratch.resize(page);
+    size_t got = image_.read(at - within, scratch.data(), page);
+    if (got <= within)
+    {
+      break;
+    }
+    descramble(at - within, scratch.data(), got);
+    size_t take = std::min(length - done, got - within);
+    std::memcpy(out + done, scratch.data() + within, take);
+    done += take;
+    if (got < page)
+    {
+      break;
+    }
+  }
+  return done;
+}
+
+}  // namespace rsn
@@ -0,0 +1,90 @@
+// RecoverySoftNetz — XOR scrambling key recovery and descrambling
+//
+// Most flash controllers XOR each page with a pseudo-random sequence before
+// it is programmed, so that long runs of equal bits do not wear the cells
+// unevenly. The sequence repeats every few pages, so the dump is a periodic
+// key XORed over plaintext. Plaintext is mostly zeros in free space, FAT
+// tables and padding, which leaves the key itself in those pages:
+//   1. the period is found by autocorrelation: bytes one period apart are
+//      equal far more often than chance when both are zero plaintext. Pages
+//      that read erased (all ones, never scrambled) are left out;
+//   2. each key byte is the value most often seen at its position modulo the
+//      period (a two-candidate frequent-items pass, then an exact count);
+//   3. FAT, exFAT and MBR boot sectors are known plaintext: among periods that
+//      score alike, the one whose key reveals the most of them is taken, and
+//      the count is reported as a check on the key.
+// XorDevice serves a dump descrambled, a page at a time with wide-vector XOR
+// and erased pages passed through; NandOptions::key descrambles after ECC
+// correction instead, for controllers that encode the scrambled data.
+
+#pragma once
+
+#include "core/device.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+struct XorKey
+{
+  uint32_t page_size = 0;      // raw bytes per page, spare included
+  std::vector<uint8_t> bytes;  // a whole number of pages; page p uses slice p % pages()
+
+  bool empty() const { return bytes.empty(); }
+  uint32_t pages() const
+  {
+    return page_size != 0 ? static_cast<uint32_t>(bytes.size() / page_size) : 0;
+  }
+
+  /// XOR the key into `data`, which holds `length` dump bytes from `offset`.
+  void apply(uint64_t offset, uint8_t* data, size_t length) const;
+};
+
+struct XorKeyOptions
+{
+  uint32_t max_period = 256;          // pages
+  uint64_t sample_bytes = 64ull << 20;  // dump bytes read for the statistics
+  unsigned probes = 64;               // bytes per page compared for the period
+  double tolerance = 0.9;             // periods within this share of the best score tie
+};
+
+struct XorKeyReport
+{
+  bool scrambled = false;
+  uint32_t period = 0;          // pages
+  double score = 0.0;           // share of probed byte pairs equal one period apart
+  double agreement = 0.0;       // share of sampled bytes equal to their key byte
+  uint64_t pages_sampled = 0;   // written pages the statistics came from
+  uint64_t boot_sectors = 0;    // FAT, exFAT and MBR sectors the key reveals
+};
+
+/// Recover the scrambling key of a dump of `page_size`-byte raw pages.
+/// Returns false when the dump has too few written pages to tell; `key` is
+/// left empty when the dump does not look scrambled.
+bool detectXorKey(Device& dump, uint32_t page_size, XorKey& key, XorKeyReport* report = nullptr,
+                  XorKeyOptions options = XorKeyOptions());
+
+/// A dump served descrambled. Erased pages read as they are.
+class XorDevice : public Device
+{
+public:
+  /// `image` and `key` must outlive the device.
+  XorDevice(Device& image, const XorKey& key) : image_(image), key_(key) {}
+
+  std::string name() const override { return image_.name() + " (descrambled)"; }
+  uint64_t size() const override { return image_.size(); }
+  uint32_t sectorSize() const override { return image_.sectorSize(); }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+private:
+  Device& image_;
+  const XorKey& key_;
+};
+
+/// Whether a raw page reads erased: all ones but for a few flipped bits.
+bool isErasedPage(const uint8_t* page, size_t size);
+
+}  // namespace rsn
@@ -0,0 +1,230 @@
+// RecoverySoftNetz — inline disk failure model
+
+#include "health/failure_model.h"
+
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace rsn
+{
+
+namespace
+{
+
+const char DELTA_SUFFIX[] = ".delta";
+
+bool parseInput(const std::string& name, int32_t& input)
+{
+  HealthFeature feature;
+  size_t suffix = sizeof(DELTA_SUFFIX) - 1;
+  if (name.size() > suffix && name.compare(name.size() - suffix, suffix, DELTA_SUFFIX) == 0)
+  {
+    if (!healthFeatureFromName(name.substr(0, name.size() - suffix), feature))
+    {
+      return false;
+    }
+    input = static_cast<int32_t>(HEALTH_FEATURE_COUNT + static_cast<size_t>(feature));
+    return true;
+  }
+  if (!healthFeatureFromName(name, feature))
+  {
+    return false;
+  }
+  input = static_cast<int32_t>(feature);
+  return true;
+}
+
+struct TreeNode
+{
+  int32_t input = -1;
+  float value = 0.0f;
+  uint32_t yes = 0;
+  uint32_t no = 0;
+};
+
+// Node 0 is the root and never a child; every other node is the child of
+// exactly one split and every child exists. No cycle is then reachable from
+// the root, so evaluation always ends on a leaf.
+bool validTree(const std::map<uint32_t, TreeNode>& tree)
+{
+  if (tree.find(0) == tree.end())
+  {
+    return false;
+  }
+  std::map<uint32_t, int> parents;
+  for (const auto& entry : tree)
+  {
+    if (entry.second.input < 0)
+    {
+      continue;
+    }
+    for (uint32_t child : {entry.second.yes, entry.second.no})
+    {
+      if (child == 0 || tree.find(child) == tree.end() || ++parents[child] > 1)
+      {
+        return false;
+      }
+    }
+  }
+  return parents.size() + 1 == tree.size();
+}
+
+}  // namespace
+
+void healthModelInputs(const HealthSample& current, const HealthSample& oldest,
+                       float inputs[HEALTH_MODEL_INPUTS])
+{
+  for (size_t i = 0; i < HEALTH_FEATURE_COUNT; ++i)
+  {
+    inputs[i] = static_cast<float>(current.values[i]);
+    inputs[HEALTH_FEATURE_COUNT + i] =
+      static_cast<float>(current.values[i]) - static_cast<float>(oldest.values[i]);
+  }
+}
+
+std::unique_ptr<FailureModel> FailureModel::parse(const std::string& text)
+{
+  std::istringstream in(text);
+  std::string line;
+  if (!std::getline(in, line) || line != "rsn-health-model 1" || !std::getline(in, line))
+  {
+    return nullptr;
+  }
+  bool trees = line == "gbdt";
+  if (!trees && line != "logistic")
+  {
+    return nullptr;
+  }
+
+  std::unique_ptr<FailureModel> model(new FailureModel());
+  std::vector<std::map<uint32_t, TreeNode>> forest;
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string op;
+    if (!(fields >> op) || op[0] == '#')
+    {
+      continue;
+    }
+    std::string name;
+    int32_t input = -1;
+    if (!trees && op == "bias")
+    {
+      if (!(fields >> model->bias_))
+      {
+        return nullptr;
+      }
+    }
+    else if (!trees && op == "weight")
+    {
+      float w = 0.0f;
+      if (!(fields >> name >> w) || !parseInput(name, input))
+      {
+        return nullptr;
+      }
+      model->weights_[input] = w;
+    }
+    else if (trees && op == "base")
+    {
+      if (!(fields >> model->bias_))
+      {
+        return nullptr;
+      }
+    }
+    else if (trees && op == "tree")
+    {
+      forest.emplace_back();
+    }
+    else if (trees && (op == "split" || op == "leaf") && !forest.empty())
+    {
+      uint32_t id = 0;
+      TreeNode node;
+      bool ok = op == "split"
+                  ? static_cast<bool>(fields >> id >> name >> node.value >> node.yes >> node.no) &&
+                      parseInput(name, node.input)
+                  : static_cast<bool>(fields >> id >> node.value);
+      if (!ok || !forest.back().emplace(id, node).second)
+      {
+        return nullptr;
+      }
+    }
+    else
+    {
+      return nullptr;
+    }
+  }
+
+  // Flatten each tree with its root (node 0) first and children remapped to
+  // global indices.
+  for (const auto& tree : forest)
+  {
+    if (!validTree(tree))
+    {
+      return nullptr;
+    }
+    auto base = static_cast<uint32_t>(model->nodes_.size());
+    std::map<uint32_t, uint32_t> index;
+    for (const auto& entry : tree)
+    {
+      index.emplace(entry.first, base + static_cast<uint32_t>(index.size()));
+    }
+    for (const auto& entry : tree)
+    {
+      const TreeNode& n = entry.second;
+      Node node{n.input, n.value, 0, 0};
+      if (n.input >= 0)
+      {
+        node.yes = index[n.yes];
+        node.no = index[n.no];
+      }
+      model->nodes_.push_back(node);
+    }
+    model->roots_.push_back(index[0]);
+  }
+  if (trees && model->roots_.empty())
+  {
+    return nullptr;
+  }
+  return model;
+}
+
+std::unique_ptr<FailureModel> FailureModel::load(const std::string& path)
+{
+  std::ifstream in(path);
+  if (!in)
+  {
+    return nullptr;
+  }
+  std::ostringstream text;
+  text << in.rdbuf();
+  return parse(text.str());
+}
+
+double FailureModel::predict(const float inputs[HEALTH_MODEL_INPUTS]) const
+{
+  double margin = bias_;
+  if (roots_.empty())
+  {
+    for (size_t i = 0; i < HEALTH_MODEL_INPUTS; ++i)
+    {
+      margin += static_cast<double>(weights_[i]) * inputs[i];
+    }
+  }
+  else
+  {
+    for (uint32_t root : roots_)
+    {
+      const Node* node = &nodes_[root];
+      while (node->input >= 0)
+      {
+        node = &nodes_[inputs[node->input] < node->value ? node->yes : node->no];
+      }
+      margin += node->value;
+    }
+  }
+  return 1.0 / (1.0 + std::exp(-margin));
+}
+
+}  // namespace rsn
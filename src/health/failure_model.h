@@ -0,0 +1,70 @@
+// RecoverySoftNetz — inline disk failure model
+//
+// Evaluates a model trained offline (logistic regression or gradient-boosted
+// trees) on the HealthSample features, so a host can score hundreds of disks
+// per polling round without an ML runtime. Models are exported as text:
+//
+//   rsn-health-model 1
+//   logistic                        | gbdt
+//   bias <b>                        | base <margin>
+//   weight <input> <w>              | tree
+//   ...                             | split <node> <input> <threshold> <yes> <no>
+//                                   | leaf <node> <value>
+//                                   | tree ...
+//
+// An <input> is a feature name ("pending") or its growth over the stored
+// history ("pending.delta"). Splits follow the XGBoost convention: the
+// <yes> child is taken when input < threshold. Node ids are local to a tree.
+// Both kinds return sigmoid(margin) as the failure probability.
+
+#pragma once
+
+#include "health/smart_log.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// Model inputs: current values, then deltas, in HealthFeature order.
+constexpr size_t HEALTH_MODEL_INPUTS = 2 * HEALTH_FEATURE_COUNT;
+
+/// Build the model input vector from the newest sample and the oldest one in
+/// the history window (pass `current` twice when there is no history).
+void healthModelInputs(const HealthSample& current, const HealthSample& oldest,
+                       float inputs[HEALTH_MODEL_INPUTS]);
+
+class FailureModel
+{
+public:
+  /// Parse an exported model; nullptr on any syntax or structure error.
+  static std::unique_ptr<FailureModel> parse(const std::string& text);
+  static std::unique_ptr<FailureModel> load(const std::string& path);
+
+  /// Failure probability in [0, 1].
+  double predict(const float inputs[HEALTH_MODEL_INPUTS]) const;
+
+  bool isTreeEnsemble() const { return !roots_.empty(); }
+  size_t treeCount() const { return roots_.size(); }
+
+private:
+  // Flattened tree node; `input` < 0 marks a leaf whose value is `value`.
+  struct Node
+  {
+    int32_t input;
+    float value;  // split threshold, or leaf value
+    uint32_t yes;
+    uint32_t no;
+  };
+
+  FailureModel() = default;
+
+  double bias_ = 0.0;
+  float weights_[HEALTH_MODEL_INPUTS] = {};
+  std::vector<uint32_t> roots_;
+  std::vector<Node> nodes_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,94 @@
+// RecoverySoftNetz — fleet disk health monitor
+
+#include "health/health_monitor.h"
+
+namespace rsn
+{
+
+namespace
+{
+
+// Serial numbers and WWNs are mostly alphanumeric; anything else would be
+// unsafe in a file name.
+std::string ringFileName(const std::string& disk_id)
+{
+  std::string name;
+  for (char c : disk_id)
+  {
+    bool safe = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                c == '-' || c == '_' || c == '.';
+    name += safe ? c : '_';
+  }
+  return name + ".hring";
+}
+
+}  // namespace
+
+HealthMonitor::HealthMonitor(std::string directory, std::unique_ptr<FailureModel> model,
+                             HealthMonitorOptions options)
+  : directory_(std::move(directory)), model_(std::move(model)), options_(options)
+{
+}
+
+HealthRing* HealthMonitor::ringFor(const std::string& disk_id)
+{
+  auto it = rings_.find(disk_id);
+  if (it != rings_.end())
+  {
+    return it->second.get();
+  }
+  std::string path = directory_.empty() ? ringFileName(disk_id)
+                                        : directory_ + "/" + ringFileName(disk_id);
+  auto ring = HealthRing::open(path, disk_id, options_.ring_capacity);
+  if (!ring)
+  {
+    return nullptr;
+  }
+  HealthRing* raw = ring.get();
+  rings_.emplace(disk_id, std::move(ring));
+  return raw;
+}
+
+bool HealthMonitor::ingest(const std::string& disk_id, const HealthSample& sample,
+                           HealthAssessment& assessment)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  HealthRing* ring = ringFor(disk_id);
+  if (ring == nullptr || !ring->append(sample))
+  {
+    return false;
+  }
+  HealthSample oldest = sample;
+  if (ring->size() > 1 && !ring->read(0, oldest))
+  {
+    oldest = sample;
+  }
+  assessment = assess(sample, oldest, ring->size());
+  return true;
+}
+
+HealthAssessment HealthMonitor::assess(const HealthSample& sample, const HealthSample& oldest,
+                                       size_t history) const
+{
+  HealthAssessment a;
+  a.history = history;
+  a.window_seconds = sample.timestamp > oldest.timestamp ? sample.timestamp - oldest.timestamp : 0;
+  a.drive_failing =
+    sample[HealthFeature::CriticalWarning] != 0 || sample[HealthFeature::FailingAttributes] != 0;
+  if (model_)
+  {
+    float inputs[HEALTH_MODEL_INPUTS];
+    healthModelInputs(sample, oldest, inputs);
+    a.risk = model_->predict(inputs);
+  }
+  a.alert = a.drive_failing || a.risk >= options_.alert_threshold;
+  return a;
+}
+
+size_t HealthMonitor::diskCount() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rings_.size();
+}
+
+}  // namespace rsn
@@ -0,0 +1,67 @@
+// RecoverySoftNetz — fleet disk health monitor
+//
+// Native replacement for the DiskHealthMonitor design: ingest a SMART or NVMe
+// sample per disk, append it to that disk's ring file, and score it with the
+// failure model against the oldest sample still in the ring. Per sample the
+// cost is one slot write, one slot read and a model evaluation (a few hundred
+// nanoseconds for a 100-tree ensemble), so hundreds of disks per host are
+// polled without measurable CPU.
+
+#pragma once
+
+#include "health/failure_model.h"
+#include "health/health_ring.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace rsn
+{
+
+struct HealthMonitorOptions
+{
+  uint32_t ring_capacity = 720;  // samples kept per disk (30 days at one per hour)
+  double alert_threshold = 0.7;  // risk at or above which `alert` is set
+};
+
+struct HealthAssessment
+{
+  double risk = 0.0;            // model failure probability; 0 without a model
+  bool alert = false;           // risk over threshold, or the drive reports failure itself
+  bool drive_failing = false;   // NVMe critical warning or ATA attribute below threshold
+  uint64_t window_seconds = 0;  // span between the oldest stored sample and this one
+  size_t history = 0;           // samples in the ring, including this one
+};
+
+class HealthMonitor
+{
+public:
+  /// Ring files are kept in `directory` as <disk id>.hring. `model` may be
+  /// null, in which case only the drive's own failure flags raise alerts.
+  HealthMonitor(std::string directory, std::unique_ptr<FailureModel> model,
+                HealthMonitorOptions options = HealthMonitorOptions());
+
+  /// Record and score one sample. False when the ring file cannot be opened
+  /// or written; `disk_id` must be at most HealthRing::MAX_DISK_ID bytes.
+  bool ingest(const std::string& disk_id, const HealthSample& sample,
+              HealthAssessment& assessment);
+
+  /// Score a sample against the stored history without recording it.
+  HealthAssessment assess(const HealthSample& sample, const HealthSample& oldest,
+                          size_t history) const;
+
+  size_t diskCount() const;
+
+private:
+  HealthRing* ringFor(const std::string& disk_id);
+
+  std::string directory_;
+  std::unique_ptr<FailureModel> model_;
+  HealthMonitorOptions options_;
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<HealthRing>> rings_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,125 @@
+// RecoverySoftNetz — fixed-size health history ring file
+
+#include "health/health_ring.h"
+
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'R', 'S', 'N', 'H', 'R', 'N', 'G', '1'};
+constexpr size_t COUNT_OFFSET = 16;
+constexpr size_t DISK_ID_OFFSET = 24;
+
+}  // namespace
+
+std::unique_ptr<HealthRing> HealthRing::open(const std::string& path, const std::string& disk_id,
+                                             uint32_t capacity)
+{
+  if (disk_id.empty() || disk_id.size() > MAX_DISK_ID || capacity == 0)
+  {
+    return nullptr;
+  }
+  std::unique_ptr<HealthRing> ring(new HealthRing());
+  ring->disk_id_ = disk_id;
+  uint8_t header[HEADER_SIZE] = {};
+  ring->file_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+  if (ring->file_.is_open())
+  {
+    if (!ring->file_.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0 || loadLE32(header + 8) != RECORD_SIZE ||
+        loadLE32(header + 12) == 0)
+    {
+      return nullptr;
+    }
+    const uint8_t* id = header + DISK_ID_OFFSET;
+    const void* nul = std::memchr(id, 0, MAX_DISK_ID);
+    size_t id_size = nul != nullptr ? static_cast<size_t>(static_cast<const uint8_t*>(nul) - id)
+                                    : MAX_DISK_ID;
+    std::string stored(reinterpret_cast<const char*>(id), id_size);
+    if (stored != disk_id)
+    {
+      return nullptr;
+    }
+    ring->capacity_ = loadLE32(header + 12);
+    ring->appended_ = loadLE64(header + COUNT_OFFSET);
+    return ring;
+  }
+
+  ring->file_.clear();
+  ring->file_.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!ring->file_.is_open())
+  {
+    return nullptr;
+  }
+  std::memcpy(header, MAGIC, sizeof(MAGIC));
+  storeLE32(header + 8, RECORD_SIZE);
+  storeLE32(header + 12, capacity);
+  std::memcpy(header + DISK_ID_OFFSET, disk_id.data(), disk_id.size());
+  if (!ring->file_.write(reinterpret_cast<const char*>(header), sizeof(header)).flush())
+  {
+    return nullptr;
+  }
+  ring->capacity_ = capacity;
+  return ring;
+}
+
+size_t HealthRing::size() const
+{
+  return static_cast<size_t>(appended_ < capacity_ ? appended_ : capacity_);
+}
+
+bool HealthRing::append(const HealthSample& sample)
+{
+  uint8_t record[RECORD_SIZE];
+  storeLE64(record, sample.timestamp);
+  for (size_t i = 0; i < HEALTH_FEATURE_COUNT; ++i)
+  {
+    storeLE32(record + 8 + 4 * i, sample.values[i]);
+  }
+  uint64_t slot = appended_ % capacity_;
+  file_.seekp(static_cast<std::streamoff>(HEADER_SIZE + slot * RECORD_SIZE));
+  if (!file_.write(reinterpret_cast<const char*>(record), sizeof(record)))
+  {
+    file_.clear();
+    return false;
+  }
+  uint8_t count[8];
+  storeLE64(count, appended_ + 1);
+  file_.seekp(COUNT_OFFSET);
+  if (!file_.write(reinterpret_cast<const char*>(count), sizeof(count)).flush())
+  {
+    file_.clear();
+    return false;
+  }
+  ++appended_;
+  return true;
+}
+
+bool HealthRing::read(size_t index, HealthSample& sample)
+{
+  if (index >= size())
+  {
+    return false;
+  }
+  uint64_t first = appended_ - size();
+  uint64_t slot = (first + index) % capacity_;
+  uint8_t record[RECORD_SIZE];
+  file_.seekg(static_cast<std::streamoff>(HEADER_SIZE + slot * RECORD_SIZE));
+  if (!file_.read(reinterpret_cast<char*>(record), sizeof(record)))
+  {
+    file_.clear();
+    return false;
+  }
+  sample.timestamp = loadLE64(record);
+  for (size_t i = 0; i < HEALTH_FEATURE_COUNT; ++i)
+  {
+    sample.values[i] = loadLE32(record + 8 + 4 * i);
+  }
+  return true;
+}
+
+}  // namespace rsn
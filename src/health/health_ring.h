@@ -0,0 +1,58 @@
+// RecoverySoftNetz — fixed-size health history ring file
+//
+// One file per disk holding the last `capacity` HealthSamples in fixed-size
+// slots, so the history never grows and an append is a single slot write plus
+// an 8-byte sequence update:
+//
+//   header (64)  "RSNHRNG1" | record size (LE32) | capacity (LE32) |
+//                appended count (LE64) | disk id (40, NUL padded)
+//   slot i       timestamp (LE64) | HEALTH_FEATURE_COUNT x LE32
+//
+// Sample n lives in slot n % capacity. The record is written before the
+// count, so a crash loses at most the sample being appended.
+
+#pragma once
+
+#include "health/smart_log.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace rsn
+{
+
+class HealthRing
+{
+public:
+  static constexpr size_t HEADER_SIZE = 64;
+  static constexpr size_t RECORD_SIZE = 8 + 4 * HEALTH_FEATURE_COUNT;
+  static constexpr size_t MAX_DISK_ID = 40;
+
+  /// Open `path`, creating it with `capacity` slots when missing. An existing
+  /// file keeps its own capacity. nullptr when the file cannot be created, is
+  /// not a ring file, or belongs to a different disk id.
+  static std::unique_ptr<HealthRing> open(const std::string& path, const std::string& disk_id,
+                                          uint32_t capacity);
+
+  bool append(const HealthSample& sample);
+
+  /// Samples currently held (at most capacity).
+  size_t size() const;
+  uint32_t capacity() const { return capacity_; }
+  const std::string& diskId() const { return disk_id_; }
+
+  /// Sample `index`, 0 = oldest held.
+  bool read(size_t index, HealthSample& sample);
+  bool latest(HealthSample& sample) { return size() > 0 && read(size() - 1, sample); }
+
+private:
+  HealthRing() = default;
+
+  std::fstream file_;
+  std::string disk_id_;
+  uint32_t capacity_ = 0;
+  uint64_t appended_ = 0;
+};
+
+}  // namespace rsn
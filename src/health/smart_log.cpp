@@ -0,0 +1,233 @@
+// RecoverySoftNetz — SMART and NVMe health log parsing
+
+#include "health/smart_log.h"
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t ATA_ATTRIBUTE_SLOTS = 30;
+constexpr size_t ATA_ATTRIBUTE_SIZE = 12;
+
+const char* const FEATURE_NAMES[HEALTH_FEATURE_COUNT] = {
+  "power_on_hours",
+  "temperature",
+  "reallocated",
+  "pending",
+  "offline_uncorrectable",
+  "reported_uncorrectable",
+  "command_timeouts",
+  "crc_errors",
+  "spin_retries",
+  "media_errors",
+  "error_log_entries",
+  "percent_used",
+  "available_spare",
+  "critical_warning",
+  "unsafe_shutdowns",
+  "failing_attributes",
+};
+
+// Vendors pack extra fields into the upper raw bytes of several counters;
+// only the masked low part is comparable across models.
+struct AtaMapping
+{
+  uint8_t id;
+  HealthFeature feature;
+  uint64_t mask;
+};
+
+const AtaMapping ATA_FEATURES[] = {
+  {5, HealthFeature::Reallocated, 0xffffffff},
+  {9, HealthFeature::PowerOnHours, 0xffffffff},
+  {10, HealthFeature::SpinRetries, 0xffffffff},
+  {187, HealthFeature::ReportedUncorrectable, 0xffffffff},
+  {188, HealthFeature::CommandTimeouts, 0xffff},
+  {192, HealthFeature::UnsafeShutdowns, 0xffffffff},
+  {194, HealthFeature::Temperature, 0xff},
+  {197, HealthFeature::Pending, 0xffffffff},
+  {198, HealthFeature::OfflineUncorrectable, 0xffffffff},
+  {199, HealthFeature::CrcErrors, 0xffffffff},
+};
+
+constexpr uint8_t ATA_AIRFLOW_TEMPERATURE = 190;
+
+uint32_t saturate32(uint64_t v)
+{
+  return v > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(v);
+}
+
+// NVMe 128-bit little-endian counter, saturated to 64 bits.
+uint64_t loadLE128Saturated(const uint8_t* p)
+{
+  return loadLE64(p + 8) != 0 ? UINT64_MAX : loadLE64(p);
+}
+
+uint64_t loadLE48(const uint8_t* p)
+{
+  return static_cast<uint64_t>(loadLE32(p)) | (static_cast<uint64_t>(loadLE16(p + 4)) << 32);
+}
+
+}  // namespace
+
+const AtaSmartAttribute* AtaSmartLog::find(uint8_t id) const
+{
+  for (const auto& a : attributes)
+  {
+    if (a.id == id)
+    {
+      return &a;
+    }
+  }
+  return nullptr;
+}
+
+bool parseAtaSmart(ByteView page, AtaSmartLog& log)
+{
+  if (page.size < ATA_SMART_PAGE_SIZE)
+  {
+    return false;
+  }
+  uint8_t sum = 0;
+  for (size_t i = 0; i < ATA_SMART_PAGE_SIZE; ++i)
+  {
+    sum = static_cast<uint8_t>(sum + page[i]);
+  }
+  if (sum != 0)
+  {
+    return false;
+  }
+  log.revision = loadLE16(page.data);
+  log.attributes.clear();
+  for (size_t i = 0; i < ATA_ATTRIBUTE_SLOTS; ++i)
+  {
+    const uint8_t* e = page.data + 2 + i * ATA_ATTRIBUTE_SIZE;
+    if (e[0] == 0)
+    {
+      continue;  // unused slot
+    }
+    AtaSmartAttribute a;
+    a.id = e[0];
+    a.flags = loadLE16(e + 1);
+    a.current = e[3];
+    a.worst = e[4];
+    a.raw = loadLE48(e + 5);
+    log.attributes.push_back(a);
+  }
+  return true;
+}
+
+bool parseAtaSmartThresholds(ByteView page, AtaSmartLog& log)
+{
+  if (page.size < ATA_SMART_PAGE_SIZE)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < ATA_ATTRIBUTE_SLOTS; ++i)
+  {
+    const uint8_t* e = page.data + 2 + i * ATA_ATTRIBUTE_SIZE;
+    if (e[0] == 0)
+    {
+      continue;
+    }
+    for (auto& a : log.attributes)
+    {
+      if (a.id == e[0])
+      {
+        a.threshold = e[1];
+      }
+    }
+  }
+  return true;
+}
+
+bool parseNvmeSmart(ByteView page, NvmeSmartLog& log)
+{
+  if (page.size < NVME_SMART_PAGE_SIZE)
+  {
+    return false;
+  }
+  const uint8_t* p = page.data;
+  log.critical_warning = p[0];
+  log.temperature_kelvin = loadLE16(p + 1);
+  log.available_spare = p[3];
+  log.spare_threshold = p[4];
+  log.percent_used = p[5];
+  log.data_units_read = loadLE128Saturated(p + 32);
+  log.data_units_written = loadLE128Saturated(p + 48);
+  log.host_reads = loadLE128Saturated(p + 64);
+  log.host_writes = loadLE128Saturated(p + 80);
+  log.busy_minutes = loadLE128Saturated(p + 96);
+  log.power_cycles = loadLE128Saturated(p + 112);
+  log.power_on_hours = loadLE128Saturated(p + 128);
+  log.unsafe_shutdowns = loadLE128Saturated(p + 144);
+  log.media_errors = loadLE128Saturated(p + 160);
+  log.error_log_entries = loadLE128Saturated(p + 176);
+  log.warning_temp_minutes = loadLE32(p + 192);
+  log.critical_temp_minutes = loadLE32(p + 196);
+  return true;
+}
+
+HealthSample healthSampleFromAta(const AtaSmartLog& log, uint64_t timestamp)
+{
+  HealthSample s;
+  s.timestamp = timestamp;
+  for (const auto& m : ATA_FEATURES)
+  {
+    if (const AtaSmartAttribute* a = log.find(m.id))
+    {
+      s[m.feature] = static_cast<uint32_t>(a->raw & m.mask);
+    }
+  }
+  const AtaSmartAttribute* airflow = log.find(ATA_AIRFLOW_TEMPERATURE);
+  if (s[HealthFeature::Temperature] == 0 && airflow != nullptr)
+  {
+    s[HealthFeature::Temperature] = static_cast<uint32_t>(airflow->raw & 0xff);
+  }
+  uint32_t failing = 0;
+  for (const auto& a : log.attributes)
+  {
+    failing += a.failing() ? 1 : 0;
+  }
+  s[HealthFeature::FailingAttributes] = failing;
+  return s;
+}
+
+HealthSample healthSampleFromNvme(const NvmeSmartLog& log, uint64_t timestamp)
+{
+  HealthSample s;
+  s.timestamp = timestamp;
+  s[HealthFeature::PowerOnHours] = saturate32(log.power_on_hours);
+  s[HealthFeature::Temperature] =
+    log.temperature_kelvin > 273 ? static_cast<uint32_t>(log.temperature_kelvin - 273) : 0;
+  s[HealthFeature::MediaErrors] = saturate32(log.media_errors);
+  s[HealthFeature::ErrorLogEntries] = saturate32(log.error_log_entries);
+  s[HealthFeature::PercentUsed] = log.percent_used;
+  s[HealthFeature::AvailableSpare] = log.available_spare;
+  s[HealthFeature::CriticalWarning] = log.critical_warning;
+  s[HealthFeature::UnsafeShutdowns] = saturate32(log.unsafe_shutdowns);
+  return s;
+}
+
+const char* healthFeatureName(HealthFeature feature)
+{
+  size_t i = static_cast<size_t>(feature);
+  return i < HEALTH_FEATURE_COUNT ? FEATURE_NAMES[i] : "unknown";
+}
+
+bool healthFeatureFromName(const std::string& name, HealthFeature& feature)
+{
+  for (size_t i = 0; i < HEALTH_FEATURE_COUNT; ++i)
+  {
+    if (name == FEATURE_NAMES[i])
+    {
+      feature = static_cast<HealthFeature>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace rsn
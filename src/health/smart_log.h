@@ -0,0 +1,117 @@
+// RecoverySoftNetz — SMART and NVMe health log parsing
+//
+// Decodes the raw pages drives return to health queries, as captured by the
+// acquisition tools or saved by smartctl/nvme-cli:
+//   - ATA SMART READ DATA (512 bytes: 30 attribute slots, checksummed) and
+//     the matching READ THRESHOLDS page;
+//   - NVMe SMART / Health Information log page (log identifier 02h).
+// Both reduce to a HealthSample, a fixed vector of vendor-neutral counters
+// that the ring history stores and the failure model reads.
+
+#pragma once
+
+#include "common/utils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+constexpr size_t ATA_SMART_PAGE_SIZE = 512;
+constexpr size_t NVME_SMART_PAGE_SIZE = 512;
+
+struct AtaSmartAttribute
+{
+  uint8_t id = 0;
+  uint16_t flags = 0;
+  uint8_t current = 0;    // normalized value
+  uint8_t worst = 0;
+  uint8_t threshold = 0;  // from the thresholds page; 0 when unknown
+  uint64_t raw = 0;       // 48-bit vendor raw value
+
+  bool prefailure() const { return (flags & 1) != 0; }
+  bool failing() const { return threshold != 0 && current != 0 && current <= threshold; }
+};
+
+struct AtaSmartLog
+{
+  uint16_t revision = 0;
+  std::vector<AtaSmartAttribute> attributes;
+
+  const AtaSmartAttribute* find(uint8_t id) const;
+};
+
+struct NvmeSmartLog
+{
+  uint8_t critical_warning = 0;
+  uint16_t temperature_kelvin = 0;
+  uint8_t available_spare = 0;  // percent
+  uint8_t spare_threshold = 0;
+  uint8_t percent_used = 0;
+  // 128-bit counters on the wire; saturated to 64 bits.
+  uint64_t data_units_read = 0;
+  uint64_t data_units_written = 0;
+  uint64_t host_reads = 0;
+  uint64_t host_writes = 0;
+  uint64_t busy_minutes = 0;
+  uint64_t power_cycles = 0;
+  uint64_t power_on_hours = 0;
+  uint64_t unsafe_shutdowns = 0;
+  uint64_t media_errors = 0;
+  uint64_t error_log_entries = 0;
+  uint32_t warning_temp_minutes = 0;
+  uint32_t critical_temp_minutes = 0;
+};
+
+/// Parse a SMART READ DATA page; false on a short page or bad checksum.
+bool parseAtaSmart(ByteView page, AtaSmartLog& log);
+
+/// Merge a SMART READ THRESHOLDS page into `log` by attribute id.
+bool parseAtaSmartThresholds(ByteView page, AtaSmartLog& log);
+
+/// Parse an NVMe SMART / Health log page; false on a short page.
+bool parseNvmeSmart(ByteView page, NvmeSmartLog& log);
+
+enum class HealthFeature : uint8_t
+{
+  PowerOnHours,
+  Temperature,            // degrees Celsius
+  Reallocated,            // ATA 5
+  Pending,                // ATA 197
+  OfflineUncorrectable,   // ATA 198
+  ReportedUncorrectable,  // ATA 187
+  CommandTimeouts,        // ATA 188
+  CrcErrors,              // ATA 199
+  SpinRetries,            // ATA 10
+  MediaErrors,            // NVMe media and data integrity errors
+  ErrorLogEntries,        // NVMe
+  PercentUsed,            // NVMe endurance estimate
+  AvailableSpare,         // NVMe, percent
+  CriticalWarning,        // NVMe critical warning bits
+  UnsafeShutdowns,        // NVMe; ATA 192
+  FailingAttributes,      // ATA attributes at or below threshold
+  Count
+};
+
+constexpr size_t HEALTH_FEATURE_COUNT = static_cast<size_t>(HealthFeature::Count);
+
+/// One observation of one disk. Counters saturate at UINT32_MAX.
+struct HealthSample
+{
+  uint64_t timestamp = 0;  // seconds since the Unix epoch
+  uint32_t values[HEALTH_FEATURE_COUNT] = {};
+
+  uint32_t& operator[](HealthFeature f) { return values[static_cast<size_t>(f)]; }
+  uint32_t operator[](HealthFeature f) const { return values[static_cast<size_t>(f)]; }
+};
+
+HealthSample healthSampleFromAta(const AtaSmartLog& log, uint64_t timestamp);
+HealthSample healthSampleFromNvme(const NvmeSmartLog& log, uint64_t timestamp);
+
+/// Stable snake_case name used by exported models ("reallocated", ...).
+const char* healthFeatureName(HealthFeature feature);
+bool healthFeatureFromName(const std::string& name, HealthFeature& feature);
+
+}  // namespace rsn
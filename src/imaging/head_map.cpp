@@ -0,0 +1,254 @@
+// RecoverySoftNetz — bad-head pattern inference
+
+#include "imaging/head_map.h"
+
+#include <algorithm>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t RECENT_BAD = 256;     // failed bins considered per estimate
+constexpr size_t RUN_NEIGHBOURS = 3;   // candidate periods per error run
+constexpr size_t MIN_SUPPORT = 6;      // observed bins one period away
+constexpr double MIN_SCORE = 0.75;     // ... of which failed
+constexpr double MIN_CONFIDENCE = 0.8; // failed share of observed bins in the band
+constexpr uint64_t MIN_PERIODS = 3;    // periods the failures must span
+constexpr uint64_t MAX_PERIOD_BINS = 1u << 16;
+
+}  // namespace
+
+bool HeadPattern::predictsBad(uint64_t offset) const
+{
+  return valid() && (offset + period - phase) % period < width;
+}
+
+uint64_t HeadPattern::nextGood(uint64_t offset) const
+{
+  if (!predictsBad(offset))
+  {
+    return offset;
+  }
+  return offset + (width - (offset + period - phase) % period);
+}
+
+uint64_t HeadPattern::nextBad(uint64_t offset) const
+{
+  if (!valid())
+  {
+    return UINT64_MAX;
+  }
+  uint64_t into = (offset + period - phase) % period;
+  return into < width ? offset : offset + (period - into);
+}
+
+HeadMapEstimator::HeadMapEstimator(uint64_t device_size, uint64_t bin_size)
+  : bin_size_(bin_size != 0 ? bin_size : 1), bins_((device_size + bin_size_ - 1) / bin_size_)
+{
+}
+
+uint8_t HeadMapEstimator::state(int64_t bin) const
+{
+  return bin >= 0 && static_cast<uint64_t>(bin) < bins_.size() ? bins_[bin] : UNKNOWN;
+}
+
+void HeadMapEstimator::markGood(uint64_t offset, uint64_t length)
+{
+  // Only bins read in full count as good; a partly read bin may still hold
+  // the edge of a bad band.
+  uint64_t first = (offset + bin_size_ - 1) / bin_size_;
+  uint64_t last = (offset + length) / bin_size_;
+  for (uint64_t b = first; b < last && b < bins_.size(); ++b)
+  {
+    if (bins_[b] == UNKNOWN)
+    {
+      bins_[b] = GOOD;
+    }
+  }
+}
+
+void HeadMapEstimator::markBad(uint64_t offset)
+{
+  uint64_t b = offset / bin_size_;
+  if (b < bins_.size() && bins_[b] != BAD)
+  {
+    bins_[b] = BAD;
+    bad_bins_.push_back(b);
+    ++new_errors_;
+  }
+}
+
+// Of the observed bins one period before or after a failed bin, the share
+// that failed as well.
+double HeadMapEstimator::periodScore(uint64_t period, size_t& support) const
+{
+  size_t first = bad_bins_.size() > RECENT_BAD ? bad_bins_.size() - RECENT_BAD : 0;
+  size_t observed = 0;
+  size_t failed = 0;
+  for (size_t i = first; i < bad_bins_.size(); ++i)
+  {
+    for (int64_t step : {-static_cast<int64_t>(period), static_cast<int64_t>(period)})
+    {
+      uint8_t s = state(static_cast<int64_t>(bad_bins_[i]) + step);
+      observed += s != UNKNOWN ? 1 : 0;
+      failed += s == BAD ? 1 : 0;
+    }
+  }
+  support = observed;
+  return observed != 0 ? static_cast<double>(failed) / static_cast<double>(observed) : 0.0;
+}
+
+// Fold the observed bins of [first, last) modulo `period`. The window stays
+// near the recent failures because the period changes between recording
+// zones. The bad band is the arc left after removing the largest stretch of
+// phases where nothing failed; it must hold almost only failures, and the
+// stretch must contain good reads.
+bool HeadMapEstimator::fold(uint64_t period, uint64_t first, uint64_t last,
+                            HeadPattern& pattern) const
+{
+  std::vector<uint32_t> bad(period, 0);
+  std::vector<uint32_t> good(period, 0);
+  uint64_t lowest = UINT64_MAX;
+  uint64_t highest = 0;
+  for (uint64_t b = first; b < last && b < bins_.size(); ++b)
+  {
+    if (bins_[b] == BAD)
+    {
+      ++bad[b % period];
+      lowest = std::min(lowest, b);
+      highest = std::max(highest, b);
+    }
+    else if (bins_[b] == GOOD)
+    {
+      ++good[b % period];
+    }
+  }
+  if (lowest == UINT64_MAX || highest - lowest < (MIN_PERIODS - 1) * period)
+  {
+    return false;
+  }
+
+  // Longest circular run of phases with no failure.
+  uint64_t best_len = 0;
+  uint64_t best_end = 0;  // one past the run, modulo period
+  uint64_t len = 0;
+  for (uint64_t i = 0; i < 2 * period; ++i)
+  {
+    len = bad[i % period] == 0 ? len + 1 : 0;
+    if (len > best_len && len <= period)
+    {
+      best_len = len;
+      best_end = (i + 1) % period;
+    }
+  }
+  if (best_len == 0 || best_len == period)
+  {
+    return false;
+  }
+  // Phases in the gap that were never read (skipped past after an error)
+  // most likely belong to the band: widen it up to the nearest good read.
+  uint64_t start = best_end;
+  uint64_t width = period - best_len;
+  auto unread = [&](uint64_t phase) { return bad[phase] == 0 && good[phase] == 0; };
+  while (width + 2 < period && unread((start + period - 1) % period))
+  {
+    start = (start + period - 1) % period;
+    ++width;
+  }
+  while (width + 2 < period && unread((start + width) % period))
+  {
+    ++width;
+  }
+  best_end = start;
+  uint64_t in_band_bad = 0;
+  uint64_t in_band_good = 0;
+  uint64_t gap_good = 0;
+  for (uint64_t k = 0; k < period; ++k)
+  {
+    uint64_t phase = (best_end + k) % period;
+    if (k < width)
+    {
+      in_band_bad += bad[phase];
+      in_band_good += good[phase];
+    }
+    else
+    {
+      gap_good += good[phase];
+    }
+  }
+  double confidence =
+    static_cast<double>(in_band_bad) / static_cast<double>(in_band_bad + in_band_good);
+  if (confidence < MIN_CONFIDENCE || gap_good < 2)
+  {
+    return false;
+  }
+  pattern.period = period * bin_size_;
+  pattern.phase = best_end * bin_size_;
+  pattern.width = width * bin_size_;
+  pattern.confidence = confidence;
+  return true;
+}
+
+HeadPattern HeadMapEstimator::estimate()
+{
+  new_errors_ = 0;
+  size_t first = bad_bins_.size() > RECENT_BAD ? bad_bins_.size() - RECENT_BAD : 0;
+  std::vector<uint64_t> recent(bad_bins_.begin() + static_cast<std::ptrdiff_t>(first),
+                               bad_bins_.end());
+  std::sort(recent.begin(), recent.end());
+
+  // Candidate periods: distances between the starts of nearby error runs.
+  std::vector<uint64_t> starts;
+  for (size_t i = 0; i < recent.size(); ++i)
+  {
+    if (i == 0 || recent[i] != recent[i - 1] + 1)
+    {
+      starts.push_back(recent[i]);
+    }
+  }
+  std::vector<uint64_t> candidates;
+  for (size_t i = 0; i < starts.size(); ++i)
+  {
+    for (size_t k = 1; k <= RUN_NEIGHBOURS && i + k < starts.size(); ++k)
+    {
+      uint64_t d = starts[i + k] - starts[i];
+      if (d >= 2 && d <= MAX_PERIOD_BINS)
+      {
+        candidates.push_back(d);
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+  // Multiples of the true period score as well; keep the smallest period
+  // whose score is close to the best.
+  double best_score = 0.0;
+  std::vector<std::pair<uint64_t, double>> scored;
+  for (uint64_t period : candidates)
+  {
+    size_t support = 0;
+    double score = periodScore(period, support);
+    if (support >= MIN_SUPPORT && score >= MIN_SCORE)
+    {
+      scored.emplace_back(period, score);
+      best_score = std::max(best_score, score);
+    }
+  }
+  for (const auto& c : scored)
+  {
+    HeadPattern pattern;
+    uint64_t margin = 2 * c.first;
+    uint64_t first_bin = recent.front() > margin ? recent.front() - margin : 0;
+    if (c.second >= best_score - 0.05 &&
+        fold(c.first, first_bin, recent.back() + margin + 1, pattern))
+    {
+      return pattern;
+    }
+  }
+  return HeadPattern();
+}
+
+}  // namespace rsn
@@ -0,0 +1,70 @@
+// RecoverySoftNetz — bad-head pattern inference
+//
+// Hard drives lay LBAs out in serpentine bands: each head serves a band of
+// consecutive sectors in turn, so when one head fails its errors repeat with
+// a fixed period across the LBA space (period = heads x band size, constant
+// within a recording zone). HeadMapEstimator keeps a coarse map of good and
+// failed bins as the imager reads, looks for a period at which failures line
+// up, and folds the failures at that period to find the bad band. Once the
+// pattern is confident, the imager steps over predicted bad bands instead of
+// hammering a dead head.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rsn
+{
+
+/// Predicted bad zones: offsets x with (x - phase) mod period < width.
+struct HeadPattern
+{
+  uint64_t period = 0;  // bytes; 0 = no pattern
+  uint64_t phase = 0;
+  uint64_t width = 0;
+  double confidence = 0.0;  // share of observed bins in the band that failed
+
+  bool valid() const { return period != 0; }
+  bool predictsBad(uint64_t offset) const;
+
+  /// First offset at or after `offset` outside a predicted band.
+  uint64_t nextGood(uint64_t offset) const;
+
+  /// First offset at or after `offset` inside a predicted band.
+  uint64_t nextBad(uint64_t offset) const;
+};
+
+class HeadMapEstimator
+{
+public:
+  /// `bin_size` is the map resolution; it should be well below the band size
+  /// (a few MiB on current drives).
+  HeadMapEstimator(uint64_t device_size, uint64_t bin_size = 256u << 10);
+
+  void markGood(uint64_t offset, uint64_t length);
+  void markBad(uint64_t offset);
+
+  /// Bins that failed since the last estimate.
+  size_t newErrors() const { return new_errors_; }
+
+  /// Search for a periodic pattern in the recent failures.
+  HeadPattern estimate();
+
+private:
+  static constexpr uint8_t UNKNOWN = 0;
+  static constexpr uint8_t GOOD = 1;
+  static constexpr uint8_t BAD = 2;
+
+  uint8_t state(int64_t bin) const;
+  double periodScore(uint64_t period, size_t& support) const;
+  bool fold(uint64_t period, uint64_t first, uint64_t last, HeadPattern& pattern) const;
+
+  uint64_t bin_size_;
+  std::vector<uint8_t> bins_;
+  std::vector<uint64_t> bad_bins_;  // in order of discovery
+  size_t new_errors_ = 0;
+};
+
+}  // namespace rsn
@@ -0,0 +1,324 @@
+// RecoverySoftNetz — adaptive imager for failing drives
+
+#include "imaging/health_imager.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr unsigned GROW_AFTER = 16;   // clean reads before the read size doubles
+constexpr double ERROR_WEIGHT = 0.05;  // EWMA weight of the newest read
+constexpr size_t REESTIMATE_AFTER = 8;  // new failed bins between head-map estimates
+constexpr uint64_t BACK_PROBE_MAX = 64u << 10;  // largest backward read into a band
+
+}  // namespace
+
+ImagerOptions ImagerOptions::forHealth(const HealthAssessment& health)
+{
+  ImagerOptions options;
+  if (health.alert || health.drive_failing)
+  {
+    options.max_read = 256u << 10;
+    options.trim_error_rate = 0.01;
+    options.retry_passes = 1;
+  }
+  return options;
+}
+
+HealthAwareImager::HealthAwareImager(Device& device, ImageSink sink, ImagerOptions options)
+  : device_(device), sink_(std::move(sink)), options_(options)
+{
+  if (options_.min_read == 0)
+  {
+    options_.min_read = device_.sectorSize();
+  }
+  options_.max_read = std::max(options_.max_read / options_.min_read, size_t{1}) *
+                      options_.min_read;
+  options_.min_skip = std::max<uint64_t>(options_.min_skip, options_.min_read);
+  options_.max_skip = std::max(options_.max_skip, options_.min_skip);
+}
+
+void HealthAwareImager::noteRead(bool ok)
+{
+  ++stats_.reads;
+  error_rate_ = (1.0 - ERROR_WEIGHT) * error_rate_ + (ok ? 0.0 : ERROR_WEIGHT);
+  if (!ok)
+  {
+    ++stats_.read_errors;
+    streak_ = 0;
+    read_size_ = std::max(read_size_ / 4 / options_.min_read * options_.min_read,
+                          options_.min_read);
+    return;
+  }
+  if (++streak_ >= GROW_AFTER)
+  {
+    streak_ = 0;
+    read_size_ = std::min(read_size_ * 2, options_.max_read);
+    skip_ = options_.min_skip;
+  }
+}
+
+bool HealthAwareImager::copy(const Span& span, bool skip_on_error, bool predict)
+{
+  uint64_t pos = span.begin;
+  while (pos < span.end)
+  {
+    if (cancelled_.load(std::memory_order_relaxed))
+    {
+      return false;
+    }
+    uint64_t limit = span.end;
+    if (predict && pattern_.valid())
+    {
+      if (pattern_.predictsBad(pos))
+      {
+        uint64_t next = std::min(pattern_.nextGood(pos), span.end);
+        predicted_.push_back({pos, next, span.tier});
+        pos = next;
+        continue;
+      }
+      limit = std::min(limit, pattern_.nextBad(pos));
+    }
+    size_t want = static_cast<size_t>(std::min<uint64_t>(read_size_, limit - pos));
+    size_t got = device_.read(pos, buffer_.data(), want);
+    if (got < want)
+    {
+      got = got / options_.min_read * options_.min_read;  // trust whole sectors only
+    }
+    if (got > 0)
+    {
+      if (!sink_(pos, buffer_.data(), got))
+      {
+        return false;
+      }
+      stats_.copied[static_cast<size_t>(span.tier)] += got;
+      if (head_map_)
+      {
+        head_map_->markGood(pos, got);
+      }
+      pos += got;
+    }
+    noteRead(got == want);
+    if (got == want)
+    {
+      continue;
+    }
+    // A short read stops at the first unreadable sector.
+    uint64_t bad_end = std::min<uint64_t>(pos + options_.min_read, span.end);
+    failed_.push_back({pos, bad_end, span.tier});
+    if (head_map_)
+    {
+      head_map_->markBad(pos);
+      if (head_map_->newErrors() >= REESTIMATE_AFTER)
+      {
+        HeadPattern pattern = head_map_->estimate();
+        if (pattern.valid())
+        {
+          pattern_ = pattern;
+        }
+      }
+    }
+    pos = bad_end;
+    if (skip_on_error && pos < span.end)
+    {
+      uint64_t next = std::min(pos + skip_, span.end);
+      skipped_.push_back({pos, next, span.tier});
+      pos = next;
+      skip_ = std::min(skip_ * 2, options_.max_skip);
+    }
+  }
+  return true;
+}
+
+bool HealthAwareImager::trim(ImagingTier tier)
+{
+  std::vector<Span> keep;
+  std::vector<Span> todo;
+  for (const Span& s : skipped_)
+  {
+    (s.tier == tier ? todo : keep).push_back(s);
+  }
+  skipped_ = std::move(keep);
+  size_t saved = read_size_;
+  read_size_ = options_.min_read;
+  bool ok = true;
+  for (const Span& s : todo)
+  {
+    if (!copy(s, false, true))
+    {
+      ok = false;
+      break;
+    }
+  }
+  read_size_ = saved;
+  return ok;
+}
+
+// Predicted bands are only touched at the end, from both edges inwards and
+// up to the first error on each side (the band edges are known to a map bin
+// at best). What lies between is given up without the retries that would
+// only wear a dead head further. A wrong prediction reads through entirely.
+bool HealthAwareImager::probePredicted()
+{
+  std::vector<Span> bands;
+  bands.swap(predicted_);
+  std::stable_sort(bands.begin(), bands.end(),
+                   [](const Span& a, const Span& b) { return a.tier < b.tier; });
+  uint64_t sector = options_.min_read;
+  for (const Span& s : bands)
+  {
+    uint64_t front = s.begin;
+    while (front < s.end)
+    {
+      if (cancelled_.load(std::memory_order_relaxed))
+      {
+        return false;
+      }
+      size_t want = static_cast<size_t>(std::min<uint64_t>(read_size_, s.end - front));
+      size_t got = device_.read(front, buffer_.data(), want);
+      got = got < want ? got / sector * sector : got;
+      noteRead(got == want);
+      if (got > 0 && !sink_(front, buffer_.data(), got))
+      {
+        return false;
+      }
+      stats_.copied[static_cast<size_t>(s.tier)] += got;
+      front += got;
+      if (got < want)
+      {
+        break;
+      }
+    }
+    // Backwards in growing steps; a failed step is redone one sector at a
+    // time so at most one extra error is spent finding the edge.
+    uint64_t back = s.end;
+    uint64_t step = sector;
+    while (back >= front + sector + step)
+    {
+      size_t want = static_cast<size_t>(step);
+      bool ok = device_.read(back - step, buffer_.data(), want) == want;
+      noteRead(ok);
+      if (!ok)
+      {
+        if (step == sector)
+        {
+          break;
+        }
+        step = sector;
+        continue;
+      }
+      if (!sink_(back - step, buffer_.data(), want))
+      {
+        return false;
+      }
+      stats_.copied[static_cast<size_t>(s.tier)] += step;
+      back -= step;
+      step = std::min<uint64_t>(step * 2, std::min<uint64_t>(BACK_PROBE_MAX, read_size_));
+    }
+    if (front < back)
+    {
+      abandoned_.push_back({front, back, s.tier});
+      stats_.predicted_bad += back - front;
+    }
+  }
+  return true;
+}
+
+bool HealthAwareImager::run(const std::vector<ImagingRegion>& plan)
+{
+  auto started = std::chrono::steady_clock::now();
+  cancelled_.store(false);
+  stats_ = ImagerStats();
+  skipped_.clear();
+  failed_.clear();
+  predicted_.clear();
+  abandoned_.clear();
+  bad_.clear();
+  pattern_ = HeadPattern();
+  head_map_.reset();
+  if (options_.head_map)
+  {
+    head_map_.reset(new HeadMapEstimator(device_.size(), options_.head_map_bin));
+  }
+  buffer_.resize(options_.max_read);
+  read_size_ = options_.max_read;
+  skip_ = options_.min_skip;
+  streak_ = 0;
+  error_rate_ = 0.0;
+
+  bool ok = true;
+  const ImagingTier tiers[] = {ImagingTier::Metadata, ImagingTier::UserData,
+                               ImagingTier::Remainder};
+  for (ImagingTier tier : tiers)
+  {
+    for (const ImagingRegion& r : plan)
+    {
+      if (ok && r.tier == tier)
+      {
+        ok = copy({r.offset, r.offset + r.length, tier}, true, true);
+      }
+    }
+    if (ok && error_rate_ <= options_.trim_error_rate)
+    {
+      ok = trim(tier);
+    }
+  }
+  for (ImagingTier tier : tiers)
+  {
+    ok = ok && trim(tier);
+  }
+  ok = ok && probePredicted();
+
+  // Retry failed sectors one at a time, most valuable tier first.
+  std::stable_sort(failed_.begin(), failed_.end(),
+                   [](const Span& a, const Span& b) { return a.tier < b.tier; });
+  read_size_ = options_.min_read;
+  for (unsigned pass = 0; ok && pass < options_.retry_passes && !failed_.empty(); ++pass)
+  {
+    std::vector<Span> retry;
+    retry.swap(failed_);
+    for (size_t i = 0; i < retry.size(); ++i)
+    {
+      const Span& s = retry[i];
+      size_t before = failed_.size();
+      uint64_t copied = stats_.copied[static_cast<size_t>(s.tier)];
+      if (!(ok = copy(s, false, false)))
+      {
+        failed_.insert(failed_.end(), retry.begin() + static_cast<std::ptrdiff_t>(i),
+                       retry.end());
+        break;
+      }
+      if (failed_.size() == before)
+      {
+        stats_.recovered_by_retry += stats_.copied[static_cast<size_t>(s.tier)] - copied;
+      }
+    }
+  }
+
+  std::vector<Span> lost = failed_;
+  lost.insert(lost.end(), abandoned_.begin(), abandoned_.end());
+  std::sort(lost.begin(), lost.end(),
+            [](const Span& a, const Span& b) { return a.begin < b.begin; });
+  for (const Span& s : lost)
+  {
+    stats_.unreadable += s.end - s.begin;
+    if (!bad_.empty() && bad_.back().offset + bad_.back().length == s.begin)
+    {
+      bad_.back().length += s.end - s.begin;
+    }
+    else
+    {
+      bad_.push_back({s.begin, s.end - s.begin});
+    }
+  }
+  stats_.seconds =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  return ok;
+}
+
+}  // namespace rsn
@@ -0,0 +1,113 @@
+// RecoverySoftNetz — adaptive imager for failing drives
+//
+// Copies an ImagingPlan tier by tier, ddrescue style:
+//   - copy pass: large reads; on an error the bad sector is recorded and the
+//     imager jumps ahead (doubling the jump while errors continue), leaving
+//     the skipped span for later;
+//   - trim pass: the skipped spans of a tier are read at sector granularity,
+//     right after the tier when the drive behaves, or after every tier when
+//     the observed error rate says the drive is degrading;
+//   - retry passes over the individual failed sectors, last of all.
+// The read size shrinks after errors and grows back after clean streaks, so
+// a healthy region is copied at full speed and a bad one costs few timeouts.
+// When the failures line up periodically (one dead head), the imager steps
+// over every predicted bad band and only probes each once at the very end.
+
+#pragma once
+
+#include "core/device.h"
+#include "core/file_registry.h"
+#include "health/health_monitor.h"
+#include "imaging/head_map.h"
+#include "imaging/imaging_plan.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace rsn
+{
+
+/// Receives every range read successfully; returns false to abort imaging.
+using ImageSink = std::function<bool(uint64_t offset, const uint8_t* data, size_t size)>;
+
+struct ImagerOptions
+{
+  size_t max_read = 1u << 20;     // largest single read
+  size_t min_read = 0;            // sector granularity; 0 = device sector size
+  uint64_t min_skip = 64u << 10;  // first jump past a read error
+  uint64_t max_skip = 64u << 20;  // jumps double up to this
+  unsigned retry_passes = 2;      // passes over failed sectors at the very end
+  double trim_error_rate = 0.05;  // above this error rate, trimming waits for all tiers
+  bool head_map = true;           // infer and skip periodic bad-head bands
+  uint64_t head_map_bin = 256u << 10;
+
+  /// Settings for the monitor's verdict: a flagged drive gets smaller reads,
+  /// earlier deferral of trimming and a single retry pass.
+  static ImagerOptions forHealth(const HealthAssessment& health);
+};
+
+struct ImagerStats
+{
+  uint64_t copied[3] = {};  // bytes per ImagingTier
+  uint64_t unreadable = 0;  // bytes still failed after the retry passes
+  uint64_t reads = 0;
+  uint64_t read_errors = 0;
+  uint64_t recovered_by_retry = 0;
+  uint64_t predicted_bad = 0;  // bytes in predicted bands whose probe failed
+  double seconds = 0.0;
+};
+
+class HealthAwareImager
+{
+public:
+  HealthAwareImager(Device& device, ImageSink sink, ImagerOptions options = ImagerOptions());
+
+  /// Image the schedule. False if the sink aborted or `cancel` was called.
+  bool run(const std::vector<ImagingRegion>& plan);
+
+  /// Request early termination; safe from any thread.
+  void cancel() { cancelled_.store(true); }
+
+  const ImagerStats& stats() const { return stats_; }
+
+  /// Ranges that stayed unreadable, merged and in device order.
+  const std::vector<Extent>& badExtents() const { return bad_; }
+
+  /// Bad-head pattern in effect at the end of the run (invalid if none).
+  const HeadPattern& headPattern() const { return pattern_; }
+
+private:
+  struct Span
+  {
+    uint64_t begin;
+    uint64_t end;
+    ImagingTier tier;
+  };
+
+  bool copy(const Span& span, bool skip_on_error, bool predict);
+  bool trim(ImagingTier tier);
+  bool probePredicted();
+  void noteRead(bool ok);
+
+  Device& device_;
+  ImageSink sink_;
+  ImagerOptions options_;
+  std::vector<uint8_t> buffer_;
+  size_t read_size_ = 0;
+  uint64_t skip_ = 0;
+  unsigned streak_ = 0;
+  double error_rate_ = 0.0;  // exponentially weighted failed-read ratio
+  std::vector<Span> skipped_;
+  std::vector<Span> failed_;
+  std::vector<Span> predicted_;  // bands stepped over on the head pattern
+  std::vector<Span> abandoned_;  // predicted bands whose probe failed
+  std::vector<Extent> bad_;
+  std::unique_ptr<HeadMapEstimator> head_map_;
+  HeadPattern pattern_;
+  std::atomic<bool> cancelled_{false};
+  ImagerStats stats_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,169 @@
+// RecoverySoftNetz — health-aware imaging order
+
+#include "imaging/imaging_plan.h"
+
+#include <algorithm>
+#include <map>
+
+namespace rsn
+{
+
+namespace
+{
+
+// Disjoint [begin, end) ranges already scheduled, keyed by begin.
+class CoveredSet
+{
+public:
+  /// Report the parts of [begin, end) not yet covered, then cover all of it.
+  template <typename Emit>
+  void claim(uint64_t begin, uint64_t end, Emit emit)
+  {
+    auto it = ranges_.upper_bound(begin);
+    if (it != ranges_.begin() && std::prev(it)->second > begin)
+    {
+      --it;
+    }
+    uint64_t pos = begin;
+    while (pos < end)
+    {
+      if (it == ranges_.end() || it->first >= end)
+      {
+        emit(pos, end);
+        break;
+      }
+      if (it->first > pos)
+      {
+        emit(pos, it->first);
+      }
+      pos = std::max(pos, it->second);
+      ++it;
+    }
+    insert(begin, end);
+  }
+
+private:
+  void insert(uint64_t begin, uint64_t end)
+  {
+    auto it = ranges_.upper_bound(begin);
+    if (it != ranges_.begin() && std::prev(it)->second >= begin)
+    {
+      --it;
+      begin = it->first;
+      end = std::max(end, it->second);
+      it = ranges_.erase(it);
+    }
+    while (it != ranges_.end() && it->first <= end)
+    {
+      end = std::max(end, it->second);
+      it = ranges_.erase(it);
+    }
+    ranges_.emplace(begin, end);
+  }
+
+  std::map<uint64_t, uint64_t> ranges_;
+};
+
+}  // namespace
+
+ImagingPlan::ImagingPlan(uint64_t device_size, uint32_t sector_size)
+  : device_size_(device_size), sector_size_(sector_size != 0 ? sector_size : 512)
+{
+}
+
+void ImagingPlan::add(uint64_t offset, uint64_t length, ImagingTier tier, int priority,
+                      std::string label)
+{
+  if (length == 0 || offset >= device_size_)
+  {
+    return;
+  }
+  ImagingRegion r;
+  r.offset = offset;
+  r.length = std::min(length, device_size_ - offset);
+  r.tier = tier;
+  r.priority = priority;
+  r.label = std::move(label);
+  requests_.push_back(std::move(r));
+}
+
+void ImagingPlan::addMetadata(const MetadataLocation& location)
+{
+  for (const auto& m : location.regions)
+  {
+    add(m.offset, m.length, ImagingTier::Metadata, m.priority, m.label);
+  }
+}
+
+void ImagingPlan::addRecoveredFiles(const FileRegistry& registry)
+{
+  registry.forEach([this](const RecoveredFile& f) {
+    int priority = static_cast<int>(f.confidence * 100.0);
+    if (f.extents.empty())
+    {
+      add(f.offset, f.size, ImagingTier::UserData, priority, f.type);
+      return;
+    }
+    for (const Extent& e : f.extents)
+    {
+      add(e.offset, e.length, ImagingTier::UserData, priority, f.type);
+    }
+  });
+}
+
+std::vector<ImagingRegion> ImagingPlan::build() const
+{
+  std::vector<const ImagingRegion*> order;
+  order.reserve(requests_.size());
+  for (const auto& r : requests_)
+  {
+    order.push_back(&r);
+  }
+  std::stable_sort(order.begin(), order.end(), [](const ImagingRegion* a, const ImagingRegion* b) {
+    if (a->tier != b->tier)
+    {
+      return a->tier < b->tier;
+    }
+    if (a->priority != b->priority)
+    {
+      return a->priority > b->priority;
+    }
+    return a->offset < b->offset;
+  });
+
+  std::vector<ImagingRegion> plan;
+  CoveredSet covered;
+  auto emit = [&](const ImagingRegion& from, uint64_t begin, uint64_t end) {
+    // Merge with the previous piece when it continues the same request class.
+    if (!plan.empty())
+    {
+      ImagingRegion& last = plan.back();
+      if (last.offset + last.length == begin && last.tier == from.tier &&
+          last.priority == from.priority && last.label == from.label)
+      {
+        last.length += end - begin;
+        return;
+      }
+    }
+    ImagingRegion r = from;
+    r.offset = begin;
+    r.length = end - begin;
+    plan.push_back(std::move(r));
+  };
+
+  uint64_t sector = sector_size_;
+  for (const ImagingRegion* r : order)
+  {
+    uint64_t begin = r->offset / sector * sector;
+    uint64_t end = std::min(device_size_, (r->offset + r->length + sector - 1) / sector * sector);
+    covered.claim(begin, end, [&](uint64_t b, uint64_t e) { emit(*r, b, e); });
+  }
+
+  ImagingRegion rest;
+  rest.tier = ImagingTier::Remainder;
+  rest.label = "unallocated";
+  covered.claim(0, device_size_, [&](uint64_t b, uint64_t e) { emit(rest, b, e); });
+  return plan;
+}
+
+}  // namespace rsn
@@ -0,0 +1,64 @@
+// RecoverySoftNetz — health-aware imaging order
+//
+// On a drive that may die mid-copy, the order of reads decides what survives.
+// ImagingPlan ranks every byte of the device into three tiers and emits a
+// read schedule in which each byte appears once:
+//   1. file-system metadata (partition tables, boot sectors, MFT, FAT, inode
+//      tables), without which nothing else can be interpreted;
+//   2. allocated user data, most valuable first;
+//   3. everything else (free space, unknown areas) in ascending order.
+
+#pragma once
+
+#include "core/file_registry.h"
+#include "imaging/metadata_locator.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+enum class ImagingTier : uint8_t
+{
+  Metadata,
+  UserData,
+  Remainder,
+};
+
+struct ImagingRegion
+{
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  ImagingTier tier = ImagingTier::Remainder;
+  int priority = 0;  // within a tier, higher first
+  std::string label;
+};
+
+class ImagingPlan
+{
+public:
+  /// Regions are aligned outwards to `sector_size` when the plan is built.
+  explicit ImagingPlan(uint64_t device_size, uint32_t sector_size = 512);
+
+  void add(uint64_t offset, uint64_t length, ImagingTier tier, int priority, std::string label);
+
+  /// Add the regions found by locateMetadata as tier 1.
+  void addMetadata(const MetadataLocation& location);
+
+  /// Add registry entries as tier 2, ranked by confidence.
+  void addRecoveredFiles(const FileRegistry& registry);
+
+  /// Non-overlapping schedule covering the whole device: tier order, then
+  /// priority, then offset. Where requests overlap, the earlier-scheduled one
+  /// keeps the bytes.
+  std::vector<ImagingRegion> build() const;
+
+private:
+  uint64_t device_size_;
+  uint32_t sector_size_;
+  std::vector<ImagingRegion> requests_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,506 @@
+// RecoverySoftNetz — file-system metadata locator for imaging
+
+#include "imaging/metadata_locator.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr int PRIORITY_PARTITION_TABLE = 100;
+constexpr int PRIORITY_BOOT = 90;
+constexpr int PRIORITY_MIRROR = 85;
+constexpr int PRIORITY_TABLES = 80;
+constexpr int PRIORITY_ROOT = 75;
+constexpr int PRIORITY_INODES = 60;
+constexpr int PRIORITY_UNKNOWN = 50;
+
+constexpr uint64_t UNKNOWN_VOLUME_HEAD = 1u << 20;
+constexpr uint64_t MFT_FALLBACK_BUDGET = 64u << 20;
+constexpr size_t MAX_GPT_ENTRY_BYTES = 1u << 20;
+constexpr size_t MAX_EXT_GDT_BYTES = 64u << 20;
+constexpr int MAX_EBR_CHAIN = 256;
+constexpr uint32_t NTFS_FIXUP_STRIDE = 512;  // update sequence stride, whatever the sector size
+
+bool readExact(Device& device, uint64_t offset, void* buffer, size_t length)
+{
+  return device.read(offset, buffer, length) == length;
+}
+
+class Locator
+{
+public:
+  explicit Locator(Device& device) : device_(device), sector_(device.sectorSize()) {}
+
+  MetadataLocation run();
+
+private:
+  void add(uint64_t offset, uint64_t length, int priority, const char* label);
+  bool parseGpt(const uint8_t* mbr);
+  void parseMbr(const uint8_t* mbr);
+  void parseExtended(uint64_t ext_base, uint64_t ext_end);
+  void probeVolume(uint64_t base, uint64_t length);
+  bool probeNtfs(const uint8_t* boot, uint64_t base, uint64_t length);
+  bool probeFat(const uint8_t* boot, uint64_t base, uint64_t length);
+  bool probeExfat(const uint8_t* boot, uint64_t base, uint64_t length);
+  bool probeExt(const uint8_t* head, uint64_t base, uint64_t length);
+  bool mftExtents(uint64_t base, uint64_t mft, uint64_t cluster, uint32_t record_size);
+
+  Device& device_;
+  uint64_t sector_;
+  MetadataLocation out_;
+};
+
+void Locator::add(uint64_t offset, uint64_t length, int priority, const char* label)
+{
+  uint64_t size = device_.size();
+  if (offset >= size || length == 0)
+  {
+    return;
+  }
+  MetadataRegion r;
+  r.offset = offset;
+  r.length = std::min(length, size - offset);
+  r.priority = priority;
+  r.label = label;
+  out_.regions.push_back(std::move(r));
+}
+
+MetadataLocation Locator::run()
+{
+  std::vector<uint8_t> mbr(sector_);
+  if (sector_ < 512 || !readExact(device_, 0, mbr.data(), mbr.size()))
+  {
+    return out_;
+  }
+  bool boot_signature = mbr[510] == 0x55 && mbr[511] == 0xaa;
+  bool superfloppy = std::memcmp(mbr.data() + 3, "NTFS    ", 8) == 0 ||
+                     std::memcmp(mbr.data() + 3, "EXFAT   ", 8) == 0 ||
+                     std::memcmp(mbr.data() + 54, "FAT", 3) == 0 ||
+                     std::memcmp(mbr.data() + 82, "FAT", 3) == 0;
+  if (boot_signature && !superfloppy)
+  {
+    add(0, sector_, PRIORITY_PARTITION_TABLE, "mbr");
+    if (!parseGpt(mbr.data()))
+    {
+      parseMbr(mbr.data());
+    }
+  }
+  if (out_.volumes.empty())
+  {
+    probeVolume(0, device_.size());
+  }
+  return out_;
+}
+
+bool Locator::parseGpt(const uint8_t* mbr)
+{
+  bool protective = false;
+  for (int i = 0; i < 4; ++i)
+  {
+    protective |= mbr[446 + 16 * i + 4] == 0xee;
+  }
+  std::vector<uint8_t> header(sector_);
+  if (!protective || !readExact(device_, sector_, header.data(), header.size()) ||
+      std::memcmp(header.data(), "EFI PART", 8) != 0)
+  {
+    return false;
+  }
+  uint64_t alternate = loadLE64(header.data() + 32);
+  uint64_t entries_lba = loadLE64(header.data() + 72);
+  uint32_t count = loadLE32(header.data() + 80);
+  uint32_t entry_size = loadLE32(header.data() + 84);
+  uint64_t table_bytes = static_cast<uint64_t>(count) * entry_size;
+  if (entry_size < 128 || table_bytes > MAX_GPT_ENTRY_BYTES)
+  {
+    return false;
+  }
+  uint64_t table_sectors = (table_bytes + sector_ - 1) / sector_;
+  add(0, (entries_lba + table_sectors) * sector_, PRIORITY_PARTITION_TABLE, "gpt");
+  if (alternate > table_sectors)
+  {
+    add((alternate - table_sectors) * sector_, (table_sectors + 1) * sector_, PRIORITY_MIRROR,
+        "gpt backup");
+  }
+
+  std::vector<uint8_t> table(static_cast<size_t>(table_bytes));
+  if (!readExact(device_, entries_lba * sector_, table.data(), table.size()))
+  {
+    return true;  // header found; entries unreadable
+  }
+  static const uint8_t UNUSED[16] = {};
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const uint8_t* e = table.data() + static_cast<size_t>(i) * entry_size;
+    uint64_t first = loadLE64(e + 32);
+    uint64_t last = loadLE64(e + 40);
+    if (std::memcmp(e, UNUSED, sizeof(UNUSED)) == 0 || last < first)
+    {
+      continue;
+    }
+    probeVolume(first * sector_, (last - first + 1) * sector_);
+  }
+  return true;
+}
+
+void Locator::parseMbr(const uint8_t* mbr)
+{
+  for (int i = 0; i < 4; ++i)
+  {
+    const uint8_t* e = mbr + 446 + 16 * i;
+    uint8_t type = e[4];
+    uint64_t start = static_cast<uint64_t>(loadLE32(e + 8)) * sector_;
+    uint64_t length = static_cast<uint64_t>(loadLE32(e + 12)) * sector_;
+    if (type == 0 || length == 0 || (e[0] != 0x00 && e[0] != 0x80) ||
+        start >= device_.size())
+    {
+      continue;
+    }
+    if (type == 0x05 || type == 0x0f || type == 0x85)
+    {
+      parseExtended(start, start + length);
+    }
+    else
+    {
+      probeVolume(start, length);
+    }
+  }
+}
+
+// Logical partitions: each EBR describes one volume (relative to itself) and
+// links to the next EBR (relative to the extended partition start).
+void Locator::parseExtended(uint64_t ext_base, uint64_t ext_end)
+{
+  std::vector<uint8_t> ebr(sector_);
+  uint64_t current = ext_base;
+  for (int n = 0; n < MAX_EBR_CHAIN && current < ext_end; ++n)
+  {
+    if (!readExact(device_, current, ebr.data(), ebr.size()) || ebr[510] != 0x55 ||
+        ebr[511] != 0xaa)
+    {
+      return;
+    }
+    add(current, sector_, PRIORITY_PARTITION_TABLE, "ebr");
+    const uint8_t* logical = ebr.data() + 446;
+    const uint8_t* link = logical + 16;
+    uint64_t length = static_cast<uint64_t>(loadLE32(logical + 12)) * sector_;
+    if (logical[4] != 0 && length != 0)
+    {
+      probeVolume(current + static_cast<uint64_t>(loadLE32(logical + 8)) * sector_, length);
+    }
+    uint64_t next = static_cast<uint64_t>(loadLE32(link + 8)) * sector_;
+    if (link[4] == 0 || next == 0 || ext_base + next <= current)
+    {
+      return;
+    }
+    current = ext_base + next;
+  }
+}
+
+void Locator::probeVolume(uint64_t base, uint64_t length)
+{
+  if (base >= device_.size())
+  {
+    return;
+  }
+  length = std::min(length, device_.size() - base);
+  uint8_t head[4096] = {};
+  size_t got = device_.read(base, head, sizeof(head));
+  VolumeInfo volume;
+  volume.offset = base;
+  volume.length = length;
+  out_.volumes.push_back(volume);
+  if (got >= 512 && (probeNtfs(head, base, length) || probeExfat(head, base, length) ||
+                     probeFat(head, base, length)))
+  {
+    return;
+  }
+  if (got >= 2048 && probeExt(head, base, length))
+  {
+    return;
+  }
+  out_.volumes.back().type = "unknown";
+  add(base, std::min(length, UNKNOWN_VOLUME_HEAD), PRIORITY_UNKNOWN, "volume start");
+}
+
+bool Locator::probeNtfs(const uint8_t* boot, uint64_t base, uint64_t length)
+{
+  if (std::memcmp(boot + 3, "NTFS    ", 8) != 0)
+  {
+    return false;
+  }
+  uint32_t bps = loadLE16(boot + 11);
+  uint8_t spc = boot[13];
+  uint64_t cluster = spc > 0x80 ? (1ull << (256 - spc)) * bps : static_cast<uint64_t>(spc) * bps;
+  if (!isPowerOfTwo(bps) || bps < 256 || cluster == 0)
+  {
+    return false;
+  }
+  // A negative value is minus log2 of the record size, a positive one clusters.
+  auto per_record = static_cast<int8_t>(boot[64]);
+  uint64_t record_size = 0;
+  if (per_record >= -31 && per_record <= -9)
+  {
+    record_size = 1ull << -per_record;
+  }
+  else if (per_record >= 1)
+  {
+    record_size = static_cast<uint64_t>(per_record) * cluster;
+  }
+  uint64_t total_sectors = loadLE64(boot + 40);
+  uint64_t mft = loadLE64(boot + 48) * cluster;
+  uint64_t mirror = loadLE64(boot + 56) * cluster;
+  out_.volumes.back().type = "ntfs";
+
+  add(base, 16 * bps, PRIORITY_BOOT, "ntfs boot");
+  add(base + total_sectors * bps, bps, PRIORITY_MIRROR, "ntfs backup boot");
+  if (!isPowerOfTwo(record_size) || record_size < 256 || record_size > 65536)
+  {
+    return true;
+  }
+  add(base + mirror, 4 * record_size, PRIORITY_MIRROR, "ntfs $MFTMirr");
+  if (record_size < 1024 || mft >= length ||
+      !mftExtents(base, mft, cluster, static_cast<uint32_t>(record_size)))
+  {
+    add(base + mft, std::min(MFT_FALLBACK_BUDGET, length - std::min(mft, length)),
+        PRIORITY_TABLES, "ntfs $MFT");
+  }
+  return true;
+}
+
+// Decode the unnamed $DATA runlist of $MFT record 0 so a fragmented MFT is
+// imaged in full.
+bool Locator::mftExtents(uint64_t base, uint64_t mft, uint64_t cluster, uint32_t record_size)
+{
+  std::vector<uint8_t> rec(record_size);
+  if (!readExact(device_, base + mft, rec.data(), rec.size()) ||
+      std::memcmp(rec.data(), "FILE", 4) != 0)
+  {
+    return false;
+  }
+  // Update sequence fixups: the last two bytes of every 512-byte stride hold
+  // the USN, also on volumes with 4K sectors.
+  uint16_t usa = loadLE16(rec.data() + 4);
+  uint16_t usa_count = loadLE16(rec.data() + 6);
+  if (usa_count == 0 || usa + 2u * usa_count > record_size ||
+      (usa_count - 1u) * NTFS_FIXUP_STRIDE > record_size)
+  {
+    return false;
+  }
+  for (uint16_t i = 1; i < usa_count; ++i)
+  {
+    uint8_t* tail = rec.data() + i * NTFS_FIXUP_STRIDE - 2;
+    if (std::memcmp(tail, rec.data() + usa, 2) != 0)
+    {
+      return false;
+    }
+    std::memcpy(tail, rec.data() + usa + 2 * i, 2);
+  }
+
+  size_t pos = loadLE16(rec.data() + 20);
+  while (pos + 16 <= record_size)
+  {
+    const uint8_t* attr = rec.data() + pos;
+    uint32_t type = loadLE32(attr);
+    uint32_t attr_size = loadLE32(attr + 4);
+    if (type == 0xffffffff || attr_size < 16 || pos + attr_size > record_size)
+    {
+      return false;
+    }
+    if (type == 0x80 && attr[8] != 0 && attr[9] == 0 && attr_size >= 0x40)
+    {
+      size_t run = pos + loadLE16(attr + 32);
+      size_t end = pos + attr_size;
+      int64_t lcn = 0;
+      bool any = false;
+      while (run < end && rec[run] != 0)
+      {
+        uint8_t len_size = rec[run] & 0x0f;
+        uint8_t off_size = rec[run] >> 4;
+        if (len_size == 0 || len_size > 8 || off_size > 8 || run + 1 + len_size + off_size > end)
+        {
+          return false;
+        }
+        uint64_t count = 0;
+        for (uint8_t b = 0; b < len_size; ++b)
+        {
+          count |= static_cast<uint64_t>(rec[run + 1 + b]) << (8 * b);
+        }
+        if (off_size != 0)  // zero offset size is a sparse run
+        {
+          uint64_t delta = 0;
+          for (uint8_t b = 0; b < off_size; ++b)
+          {
+            delta |= static_cast<uint64_t>(rec[run + 1 + len_size + b]) << (8 * b);
+          }
+          if (off_size < 8 && (delta >> (8 * off_size - 1)) & 1)
+          {
+            delta |= ~0ull << (8 * off_size);  // sign-extend
+          }
+          lcn += static_cast<int64_t>(delta);
+          if (lcn < 0)
+          {
+            return false;
+          }
+          add(base + static_cast<uint64_t>(lcn) * cluster, count * cluster, PRIORITY_TABLES,
+              "ntfs $MFT");
+          any = true;
+        }
+        run += 1 + len_size + off_size;
+      }
+      return any;
+    }
+    pos += attr_size;
+  }
+  return false;
+}
+
+bool Locator::probeFat(const uint8_t* boot, uint64_t base, uint64_t length)
+{
+  uint32_t bps = loadLE16(boot + 11);
+  uint32_t spc = boot[13];
+  uint32_t reserved = loadLE16(boot + 14);
+  uint32_t fats = boot[16];
+  uint32_t root_entries = loadLE16(boot + 17);
+  uint32_t fat_size = loadLE16(boot + 22);
+  if ((boot[0] != 0xeb && boot[0] != 0xe9) || bps < 512 || bps > 4096 || !isPowerOfTwo(bps) ||
+      !isPowerOfTwo(spc) || reserved == 0 || fats == 0 || fats > 2 || boot[510] != 0x55 ||
+      boot[511] != 0xaa)
+  {
+    return false;
+  }
+  bool fat32 = fat_size == 0;
+  if (fat32)
+  {
+    fat_size = loadLE32(boot + 36);
+  }
+  uint64_t tables = static_cast<uint64_t>(fats) * fat_size * bps;
+  uint64_t root_bytes = (static_cast<uint64_t>(root_entries) * 32 + bps - 1) / bps * bps;
+  if (fat_size == 0 || reserved * bps + tables > length)
+  {
+    return false;
+  }
+  out_.volumes.back().type = fat32 ? "fat32" : "fat";
+  add(base, static_cast<uint64_t>(reserved) * bps, PRIORITY_BOOT, "fat boot");
+  add(base + reserved * bps, tables + root_bytes, PRIORITY_TABLES, "fat tables");
+  if (fat32)
+  {
+    uint64_t data = static_cast<uint64_t>(reserved) * bps + tables;
+    uint64_t cluster = static_cast<uint64_t>(spc) * bps;
+    uint32_t root = loadLE32(boot + 44);
+    if (root >= 2)
+    {
+      add(base + data + (root - 2) * cluster, cluster, PRIORITY_ROOT, "fat root directory");
+    }
+  }
+  return true;
+}
+
+bool Locator::probeExfat(const uint8_t* boot, uint64_t base, uint64_t length)
+{
+  if (std::memcmp(boot + 3, "EXFAT   ", 8) != 0 || boot[108] < 9 || boot[108] > 12 ||
+      boot[109] > 25)
+  {
+    return false;
+  }
+  uint64_t bps = 1ull << boot[108];
+  uint64_t cluster = bps << boot[109];
+  uint64_t fat_offset = loadLE32(boot + 80) * bps;
+  uint64_t fat_length = loadLE32(boot + 84) * bps;
+  uint64_t heap = loadLE32(boot + 88) * bps;
+  uint32_t root = loadLE32(boot + 96);
+  if (fat_offset + fat_length > length)
+  {
+    return false;
+  }
+  out_.volumes.back().type = "exfat";
+  add(base, 24 * bps, PRIORITY_BOOT, "exfat boot");  // main and backup boot regions
+  add(base + fat_offset, fat_length, PRIORITY_TABLES, "exfat fat");
+  if (root >= 2)
+  {
+    add(base + heap + (root - 2) * cluster, cluster, PRIORITY_ROOT, "exfat root directory");
+  }
+  return true;
+}
+
+bool Locator::probeExt(const uint8_t* head, uint64_t base, uint64_t length)
+{
+  const uint8_t* sb = head + 1024;
+  if (loadLE16(sb + 56) != 0xef53 || loadLE32(sb + 24) > 6)
+  {
+    return false;
+  }
+  uint64_t block = 1024ull << loadLE32(sb + 24);
+  uint32_t incompat = loadLE32(sb + 96);
+  bool is64 = (incompat & 0x80) != 0;
+  uint64_t blocks = loadLE32(sb + 4) | (is64 ? static_cast<uint64_t>(loadLE32(sb + 0x150)) << 32
+                                             : 0);
+  uint32_t first_data = loadLE32(sb + 20);
+  uint32_t per_group = loadLE32(sb + 32);
+  uint32_t inodes_per_group = loadLE32(sb + 40);
+  uint32_t inode_size = loadLE32(sb + 76) >= 1 ? loadLE16(sb + 88) : 128;
+  uint32_t desc_size = is64 ? loadLE16(sb + 254) : 32;
+  if (per_group == 0 || blocks <= first_data || desc_size < 32 || inode_size < 128)
+  {
+    return false;
+  }
+  uint64_t groups = (blocks - first_data + per_group - 1) / per_group;
+  uint64_t gdt_offset = (static_cast<uint64_t>(first_data) + 1) * block;
+  uint64_t gdt_bytes = groups * desc_size;
+  if (gdt_offset + gdt_bytes > length || gdt_bytes > MAX_EXT_GDT_BYTES)
+  {
+    return false;
+  }
+  const char* type = (incompat & (0x40 | 0x80 | 0x200)) != 0 ? "ext4"
+                     : (loadLE32(sb + 92) & 0x4) != 0      ? "ext3"
+                                                            : "ext2";
+  out_.volumes.back().type = type;
+  add(base, gdt_offset + gdt_bytes, PRIORITY_BOOT, "ext superblock and group descriptors");
+
+  std::vector<uint8_t> gdt(static_cast<size_t>(gdt_bytes));
+  if (!readExact(device_, base + gdt_offset, gdt.data(), gdt.size()))
+  {
+    return true;
+  }
+  // Inode tables, coalesced: with flex_bg they are laid out back to back.
+  uint64_t table_bytes = static_cast<uint64_t>(inodes_per_group) * inode_size;
+  uint64_t run_start = 0;
+  uint64_t run_end = 0;
+  for (uint64_t g = 0; g < groups; ++g)
+  {
+    const uint8_t* d = gdt.data() + g * desc_size;
+    uint64_t table = loadLE32(d + 8);
+    if (desc_size >= 64)
+    {
+      table |= static_cast<uint64_t>(loadLE32(d + 0x28)) << 32;
+    }
+    uint64_t start = table * block;
+    if (table == 0 || start + table_bytes > length)
+    {
+      continue;
+    }
+    if (start != run_end)
+    {
+      add(base + run_start, run_end - run_start, PRIORITY_INODES, "ext inode tables");
+      run_start = start;
+    }
+    run_end = start + table_bytes;
+  }
+  add(base + run_start, run_end - run_start, PRIORITY_INODES, "ext inode tables");
+  return true;
+}
+
+}  // namespace
+
+MetadataLocation locateMetadata(Device& device)
+{
+  return Locator(device).run();
+}
+
+}  // namespace rsn
@@ -0,0 +1,46 @@
+// RecoverySoftNetz — file-system metadata locator for imaging
+//
+// Finds the byte ranges whose loss hurts recovery most: partition tables and
+// the core structures of each volume (NTFS boot sector and $MFT extents,
+// FAT/exFAT reserved area and allocation tables, ext2/3/4 superblock, group
+// descriptors and inode tables). Only the structures needed to find them are
+// read (boot sectors, $MFT record 0, ext group descriptors), so the scan is
+// cheap enough to run on a failing drive before imaging starts.
+
+#pragma once
+
+#include "core/device.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+struct MetadataRegion
+{
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  int priority = 0;   // higher is read first
+  std::string label;  // e.g. "gpt", "ntfs $MFT", "ext4 inode tables"
+};
+
+struct VolumeInfo
+{
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  std::string type;  // "ntfs", "fat32", "exfat", "ext4", ... or "unknown"
+};
+
+struct MetadataLocation
+{
+  std::vector<VolumeInfo> volumes;
+  std::vector<MetadataRegion> regions;
+};
+
+/// Parse MBR (with extended partitions) or GPT, falling back to a single
+/// volume spanning the device, and locate each volume's metadata.
+MetadataLocation locateMetadata(Device& device);
+
+}  // namespace rsn
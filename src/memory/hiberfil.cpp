@@ -0,0 +1,290 @@
+// RecoverySoftNetz — Windows hibernation file (hiberfil.sys) device
+
+#include "memory/hiberfil.h"
+
+#include "common/utils.h"
+#include "common/xpress.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint8_t XPRESS_SIGNATURE[] = {0x81, 0x81, 'x', 'p', 'r', 'e', 's', 's'};
+constexpr size_t XPRESS_HEADER = 32;
+constexpr size_t SET_HEADER = 4;
+constexpr size_t HUFFMAN_TABLE = 256;
+constexpr size_t WINDOW = 4u << 20;
+constexpr const char* SIGNATURES[] = {"hibr", "wake", "rstr"};
+
+/// Buffered view of the file for the indexing pass, which reads forward
+/// except for the few bytes of a header.
+class Window
+{
+public:
+  explicit Window(Device& file) : file_(file), end_(file.size()), buffer_(WINDOW) {}
+
+  /// `length` bytes at `offset`; nullptr past the end of the file.
+  const uint8_t* at(uint64_t offset, size_t length)
+  {
+    if (offset > end_ || length > end_ - offset)
+    {
+      return nullptr;
+    }
+    if (offset < start_ || offset + length > start_ + got_)
+    {
+      start_ = offset;
+      got_ = file_.read(offset, buffer_.data(), buffer_.size());
+      if (length > got_)
+      {
+        return nullptr;
+      }
+    }
+    return buffer_.data() + (offset - start_);
+  }
+
+private:
+  Device& file_;
+  uint64_t end_;
+  uint64_t start_ = 0;
+  size_t got_ = 0;
+  std::vector<uint8_t> buffer_;
+};
+
+}  // namespace
+
+std::unique_ptr<HiberfilDevice> HiberfilDevice::open(Device& file, HiberOptions options)
+{
+  std::unique_ptr<HiberfilDevice> d(new HiberfilDevice(file));
+  d->index(options);
+  if (d->blocks_.empty())
+  {
+    return nullptr;
+  }
+  return d;
+}
+
+std::string HiberfilDevice::headerSignature(Device& file)
+{
+  uint8_t head[4];
+  if (file.read(0, head, sizeof(head)) != sizeof(head))
+  {
+    return std::string();
+  }
+  std::string signature;
+  for (uint8_t c : head)
+  {
+    signature += static_cast<char>(std::tolower(c));
+  }
+  for (const char* known : SIGNATURES)
+  {
+    if (signature == known)
+    {
+      return signature;
+    }
+  }
+  return std::string();
+}
+
+void HiberfilDevice::index(const HiberOptions& options)
+{
+  stats_ = HiberStats();
+  stats_.signature = headerSignature(file_);
+  blocks_.clear();
+
+  uint64_t end = file_.size();
+  Window window(file_);
+  std::vector<uint8_t> in;
+  std::vector<uint8_t> out;
+
+  // A Windows XP to 7 block at `pos`.
+  auto xpressBlock = [&](uint64_t& pos) {
+    const uint8_t* p = window.at(pos, XPRESS_HEADER);
+    if (p == nullptr || std::memcmp(p, XPRESS_SIGNATURE, sizeof(XPRESS_SIGNATURE)) != 0)
+    {
+      return false;
+    }
+    uint32_t word = loadLE32(p + 8);
+    uint32_t pages = (word & 0xFF) + 1;
+    uint32_t size = (word >> 10) + 1;
+    uint64_t data = pos + XPRESS_HEADER;
+    if (size > pages * PAGE_SIZE || size > end - data)
+    {
+      return false;
+    }
+    Method method = size == pages * PAGE_SIZE ? STORED : XPRESS;
+    blocks_.push_back({data, size, pages, method});
+    ++stats_.xpress_blocks;
+    stats_.stored += method == STORED ? 1 : 0;
+    pos = std::min(end, data + ((uint64_t(size) + 7) & ~uint64_t(7)));
+    return true;
+  };
+
+  // A chain of Windows 8+ compression sets from `pos`.
+  auto setChain = [&](uint64_t& pos) {
+    std::vector<Block> found;
+    uint64_t x = pos;
+    for (const uint8_t* p; (p = window.at(x, SET_HEADER)) != nullptr;)
+    {
+      uint32_t word = loadLE32(p);
+      uint32_t pages = (word & 0x0F) + 1;
+      uint32_t size = word >> 10;
+      if (size == 0 || size > pages * PAGE_SIZE || size > end - x - SET_HEADER)
+      {
+        break;
+      }
+      Method method = size == pages * PAGE_SIZE ? STORED : XPRESS_HUFFMAN;
+      if (method == XPRESS_HUFFMAN)
+      {
+        const uint8_t* table = window.at(x + SET_HEADER, HUFFMAN_TABLE);
+        if (size < HUFFMAN_TABLE || table == nullptr || !xpressHuffmanTable(table))
+        {
+          break;
+        }
+      }
+      found.push_back({x + SET_HEADER, size, pages, method});
+      x += SET_HEADER + size;
+    }
+    if (found.empty() || found.size() < options.confirm_sets)
+    {
+      return false;
+    }
+    for (const Block& block : found)
+    {
+      if (block.method != STORED)
+      {
+        out.resize(size_t(block.pages) * PAGE_SIZE);
+        if (!decode(block, in, out.data()))
+        {
+          return false;
+        }
+        break;
+      }
+    }
+    for (const Block& block : found)
+    {
+      stats_.stored += block.method == STORED ? 1 : 0;
+    }
+    blocks_.insert(blocks_.end(), found.begin(), found.end());
+    stats_.sets += found.size();
+    ++stats_.chains;
+    pos = x;
+    return true;
+  };
+
+  uint64_t pos = 0;
+  while (pos < end)
+  {
+    if (xpressBlock(pos) || (pos % PAGE_SIZE == 0 && setChain(pos)))
+    {
+      continue;
+    }
+    // On to the next page, or to an Xpress block header before it.
+    uint64_t next = std::min(end, (pos / PAGE_SIZE + 1) * PAGE_SIZE);
+    uint64_t reach = std::min<uint64_t>(next + sizeof(XPRESS_SIGNATURE) - 1, end);
+    auto span = static_cast<size_t>(reach - (pos + 1));
+    const uint8_t* p = window.at(pos + 1, span);
+    size_t found = p == nullptr ? SIZE_MAX
+                                : findBytes(ByteView(p, span), XPRESS_SIGNATURE,
+                                            sizeof(XPRESS_SIGNATURE));
+    pos = found != SIZE_MAX && pos + 1 + found < next ? pos + 1 + found : next;
+  }
+
+  pages_.assign(1, 0);
+  for (const Block& block : blocks_)
+  {
+    pages_.push_back(pages_.back() + block.pages);
+  }
+  stats_.pages = pages_.back();
+}
+
+bool HiberfilDevice::decode(const Block& block, std::vector<uint8_t>& in, uint8_t* out) const
+{
+  size_t size = size_t(block.pages) * PAGE_SIZE;
+  in.resize(block.size);
+  if (file_.read(block.offset, in.data(), in.size()) != in.size())
+  {
+    return false;
+  }
+  switch (block.method)
+  {
+  case STORED:
+    std::memcpy(out, in.data(), size);
+    return true;
+  case XPRESS:
+    return xpressDecompress(in.data(), in.size(), out, size);
+  case XPRESS_HUFFMAN:
+    return xpressHuffmanDecompress(in.data(), in.size(), out, size);
+  }
+  return false;
+}
+
+size_t HiberfilDevice::blockAt(uint64_t page) const
+{
+  return static_cast<size_t>(std::upper_bound(pages_.begin(), pages_.end(), page) -
+                             pages_.begin()) - 1;
+}
+
+uint64_t HiberfilDevice::sourceOffset(uint64_t offset) const
+{
+  uint64_t page = offset / PAGE_SIZE;
+  if (page >= pages_.back())
+  {
+    return UINT64_MAX;
+  }
+  size_t i = blockAt(page);
+  const Block& block = blocks_[i];
+  return block.method == STORED ? block.offset + (offset - pages_[i] * PAGE_SIZE) : block.offset;
+}
+
+size_t HiberfilDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  uint64_t total = size();
+  if (offset >= total)
+  {
+    return 0;
+  }
+  length = static_cast<size_t>(std::min<uint64_t>(length, total - offset));
+  auto* out = static_cast<uint8_t*>(buffer);
+  std::vector<uint8_t> in;
+  std::vector<uint8_t> pages;
+  size_t done = 0;
+  while (done < length)
+  {
+    uint64_t at = offset + done;
+    size_t i = blockAt(at / PAGE_SIZE);
+    const Block& block = blocks_[i];
+    auto within = static_cast<size_t>(at - pages_[i] * PAGE_SIZE);
+    size_t take = std::min(size_t(block.pages) * PAGE_SIZE - within, length - done);
+    if (block.method == STORED)
+    {
+      size_t got = file_.read(block.offset + within, out + done, take);
+      if (got != take)
+      {
+        return done + got;
+      }
+    }
+    else
+    {
+      pages.resize(size_t(block.pages) * PAGE_SIZE);
+      if (decode(block, in, pages.data()))
+      {
+        std::memcpy(out + done, pages.data() + within, take);
+      }
+      else
+      {
+        std::memset(out + done, 0, take);
+        damaged_.fetch_add(block.pages, std::memory_order_relaxed);
+      }
+    }
+    done += take;
+  }
+  return done;
+}
+
+}  // namespace rsn
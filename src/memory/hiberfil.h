@@ -0,0 +1,107 @@
+// RecoverySoftNetz — Windows hibernation file (hiberfil.sys) device
+//
+// hiberfil.sys holds the physical memory of a hibernated system, compressed:
+// process memory, file cache pages and documents that were open, often long
+// after the files themselves were deleted. A carver needs the contents of the
+// pages rather than their physical addresses, so the device serves the pages
+// in the order the file holds them and leaves the memory map aside. The
+// compressed runs are found by their own framing, which still works once the
+// header page has been wiped after resume:
+//   - Windows XP to 7 write Xpress blocks of up to 256 pages, each behind a
+//     32-byte header starting "\x81\x81xpress" whose next 32-bit word holds
+//     the page count - 1 in its low byte and the compressed size - 1 from
+//     bit 10;
+//   - Windows 8 and later write compression sets of up to 16 pages: a 32-bit
+//     header with the page count - 1 in its low four bits and the compressed
+//     size from bit 10, then LZ77+Huffman data, or the pages as they are
+//     when the size is theirs. Sets follow each other, so a set is only
+//     believed as part of a chain of `confirm_sets` whose headers and Huffman
+//     tables hold, the first of which decompresses.
+// `open` indexes the blocks in one pass over the file; `read` decompresses
+// the blocks a read touches (see xpress.h), so the carve pipeline's workers
+// decompress in parallel. Pages that fail to decompress read as zeros.
+
+#pragma once
+
+#include "core/device.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+struct HiberOptions
+{
+  unsigned confirm_sets = 2;  // Windows 8+ sets in a chain before it is believed
+};
+
+struct HiberStats
+{
+  std::string signature;  // "hibr", "wake", "rstr", ... from the header; empty when wiped
+  uint64_t xpress_blocks = 0;  // Windows XP to 7 blocks
+  uint64_t sets = 0;           // Windows 8+ compression sets
+  uint64_t stored = 0;         // blocks or sets held uncompressed
+  uint64_t chains = 0;         // runs of consecutive sets
+  uint64_t pages = 0;
+};
+
+class HiberfilDevice : public Device
+{
+public:
+  static constexpr uint32_t PAGE_SIZE = 4096;
+
+  /// Index the compressed blocks of `file`. Returns nullptr when none is
+  /// found.
+  static std::unique_ptr<HiberfilDevice> open(Device& file, HiberOptions options = HiberOptions());
+
+  /// The header signature `file` starts with, in lower case ("hibr", "wake",
+  /// "rstr"); empty when there is none.
+  static std::string headerSignature(Device& file);
+
+  std::string name() const override { return file_.name() + " (hibernation)"; }
+  uint64_t size() const override { return pages_.empty() ? 0 : pages_.back() * PAGE_SIZE; }
+  uint32_t sectorSize() const override { return PAGE_SIZE; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+  const HiberStats& stats() const { return stats_; }
+
+  /// Pages that failed to decompress in the reads so far.
+  uint64_t damaged() const { return damaged_.load(); }
+
+  /// Offset in the file of the compressed data serving `offset`; UINT64_MAX
+  /// past the end.
+  uint64_t sourceOffset(uint64_t offset) const;
+
+private:
+  enum Method : uint8_t
+  {
+    STORED,
+    XPRESS,
+    XPRESS_HUFFMAN,
+  };
+
+  struct Block
+  {
+    uint64_t offset;  // of the compressed data in the file
+    uint32_t size;
+    uint32_t pages;
+    Method method;
+  };
+
+  explicit HiberfilDevice(Device& file) : file_(file) {}
+
+  void index(const HiberOptions& options);
+  bool decode(const Block& block, std::vector<uint8_t>& in, uint8_t* out) const;
+  size_t blockAt(uint64_t page) const;
+
+  Device& file_;
+  std::vector<Block> blocks_;
+  std::vector<uint64_t> pages_;  // first page of each block, then the total
+  HiberStats stats_;
+  std::atomic<uint64_t> damaged_{0};
+};
+
+}  // namespace rsn
@@ -0,0 +1,157 @@
+// RecoverySoftNetz — memory artifacts: hibernation files, pagefiles, swap
+
+#include "memory/memory_artifact.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint32_t PAGE_SIZES[] = {4096, 8192, 16384, 65536};
+constexpr size_t SIGNATURE_SIZE = 10;  // at the end of the header page
+constexpr size_t VERSION = 1024;       // after the boot block
+constexpr size_t LAST_PAGE = 1028;
+constexpr size_t BAD_PAGE_COUNT = 1032;
+constexpr size_t UUID = 1036;
+constexpr size_t LABEL = 1052;
+constexpr size_t BAD_PAGES = 1536;
+
+// The kernel's hibernation image replaces the swap signature until resume.
+constexpr const char* HIBERNATION_SIGNATURES[] = {"S1SUSPEND", "S2SUSPEND", "ULSUSPEND",
+                                                  "LINHIB0001"};
+
+}  // namespace
+
+bool readSwapHeader(Device& device, SwapInfo& info)
+{
+  std::vector<uint8_t> page;
+  for (uint32_t page_size : PAGE_SIZES)
+  {
+    if (device.size() < 2ull * page_size)
+    {
+      break;
+    }
+    page.resize(page_size);
+    if (device.read(0, page.data(), page_size) != page_size)
+    {
+      return false;
+    }
+    const char* signature = reinterpret_cast<const char*>(page.data() + page_size - SIGNATURE_SIZE);
+    bool hibernation = false;
+    for (const char* known : HIBERNATION_SIGNATURES)
+    {
+      hibernation = hibernation || std::strncmp(signature, known, std::strlen(known)) == 0;
+    }
+    bool old = std::memcmp(signature, "SWAP-SPACE", SIGNATURE_SIZE) == 0;
+    if (!old && !hibernation && std::memcmp(signature, "SWAPSPACE2", SIGNATURE_SIZE) != 0)
+    {
+      continue;
+    }
+    info = SwapInfo();
+    info.page_size = page_size;
+    info.hibernation = hibernation;
+    uint64_t pages = device.size() / page_size;
+    if (old)
+    {
+      // The first format has a bitmap of usable pages instead of a header.
+      info.last_page = static_cast<uint32_t>(std::min<uint64_t>(pages - 1, UINT32_MAX));
+      return true;
+    }
+    info.big_endian = loadLE32(page.data() + VERSION) != 1 && loadBE32(page.data() + VERSION) == 1;
+    auto load = [&](size_t at) {
+      return info.big_endian ? loadBE32(page.data() + at) : loadLE32(page.data() + at);
+    };
+    info.version = load(VERSION);
+    info.last_page = static_cast<uint32_t>(std::min<uint64_t>(load(LAST_PAGE), pages - 1));
+    uint32_t bad = std::min<uint32_t>(load(BAD_PAGE_COUNT),
+                                      (page_size - BAD_PAGES - SIGNATURE_SIZE) / 4);
+    for (uint32_t i = 0; i < bad; ++i)
+    {
+      info.bad_pages.push_back(load(BAD_PAGES + 4 * i));
+    }
+    std::sort(info.bad_pages.begin(), info.bad_pages.end());
+    const uint8_t* uuid = page.data() + UUID;
+    if (std::any_of(uuid, uuid + 16, [](uint8_t b) { return b != 0; }))
+    {
+      std::string hex = toHex(uuid, 16);
+      info.uuid = hex.substr(0, 8) + "-" + hex.substr(8, 4) + "-" + hex.substr(12, 4) + "-" +
+                  hex.substr(16, 4) + "-" + hex.substr(20);
+    }
+    const char* label = reinterpret_cast<const char*>(page.data() + LABEL);
+    info.label.assign(label, std::find(label, label + 16, '\0'));
+    return true;
+  }
+  return false;
+}
+
+std::unique_ptr<SwapDevice> SwapDevice::open(Device& device)
+{
+  std::unique_ptr<SwapDevice> d(new SwapDevice(device));
+  if (!readSwapHeader(device, d->info_))
+  {
+    return nullptr;
+  }
+  d->size_ = uint64_t(d->info_.last_page) * d->info_.page_size;
+  return d;
+}
+
+size_t SwapDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  if (offset >= size_)
+  {
+    return 0;
+  }
+  length = static_cast<size_t>(std::min<uint64_t>(length, size_ - offset));
+  uint32_t page_size = info_.page_size;
+  size_t got = device_.read(offset + page_size, buffer, length);
+  // Usable page N is served at (N - 1) * page_size.
+  auto* out = static_cast<uint8_t*>(buffer);
+  auto bad = std::lower_bound(info_.bad_pages.begin(), info_.bad_pages.end(),
+                              offset / page_size + 1);
+  for (; bad != info_.bad_pages.end() && uint64_t(*bad - 1) * page_size < offset + got; ++bad)
+  {
+    uint64_t from = std::max<uint64_t>(uint64_t(*bad - 1) * page_size, offset);
+    uint64_t to = std::min<uint64_t>(uint64_t(*bad) * page_size, offset + got);
+    std::memset(out + (from - offset), 0, static_cast<size_t>(to - from));
+  }
+  return got;
+}
+
+MemoryArtifact openMemoryArtifact(Device& source, HiberOptions options)
+{
+  MemoryArtifact artifact;
+  artifact.device = &source;
+  if (auto swap = SwapDevice::open(source))
+  {
+    artifact.kind = MemoryArtifactKind::Swap;
+    artifact.owned = std::move(swap);
+    artifact.device = artifact.owned.get();
+    return artifact;
+  }
+  bool candidate = !HiberfilDevice::headerSignature(source).empty();
+  if (!candidate)
+  {
+    std::vector<uint8_t> first(HiberfilDevice::PAGE_SIZE);
+    size_t got = source.read(0, first.data(), first.size());
+    candidate = got == first.size() &&
+                std::all_of(first.begin(), first.end(), [](uint8_t b) { return b == 0; });
+  }
+  if (candidate)
+  {
+    if (auto hiberfil = HiberfilDevice::open(source, options))
+    {
+      artifact.kind = MemoryArtifactKind::Hibernation;
+      artifact.owned = std::move(hiberfil);
+      artifact.device = artifact.owned.get();
+    }
+  }
+  return artifact;
+}
+
+}  // namespace rsn
@@ -0,0 +1,86 @@
+// RecoverySoftNetz — memory artifacts: hibernation files, pagefiles, swap
+//
+// Pages of memory that reach the disk outlive the files they came from:
+// hiberfil.sys (see hiberfil.h), pagefile.sys and swapfile.sys, and Linux
+// swap partitions and files. All of them are carved and keyword-searched
+// like any other device once presented as the pages they hold:
+//   - a hibernation file through HiberfilDevice, decompressed;
+//   - a Linux swap area through SwapDevice, which skips the header page and
+//     the pages marked bad. A hibernation image written to swap by the kernel
+//     is compressed in a format of its own and is served as it is;
+//   - a pagefile as it is: it has no header and holds raw pages.
+// `openMemoryArtifact` tells which one a device holds and returns the device
+// to run the carve pipeline over.
+
+#pragma once
+
+#include "core/device.h"
+#include "memory/hiberfil.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+struct SwapInfo
+{
+  uint32_t page_size = 0;
+  uint32_t version = 0;
+  uint32_t last_page = 0;      // last usable page
+  std::vector<uint32_t> bad_pages;
+  std::string label;
+  std::string uuid;            // 8-4-4-4-12 hex
+  bool big_endian = false;
+  bool hibernation = false;    // holds a kernel hibernation image
+};
+
+/// Read the header of the Linux swap area at the start of `device`. False
+/// when there is none.
+bool readSwapHeader(Device& device, SwapInfo& info);
+
+/// The usable pages of a Linux swap area: page 1 to `last_page`, pages
+/// marked bad reading as zeros.
+class SwapDevice : public Device
+{
+public:
+  /// Returns nullptr when `device` holds no swap header.
+  static std::unique_ptr<SwapDevice> open(Device& device);
+
+  std::string name() const override { return device_.name() + " (swap)"; }
+  uint64_t size() const override { return size_; }
+  uint32_t sectorSize() const override { return info_.page_size; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+  const SwapInfo& info() const { return info_; }
+
+private:
+  explicit SwapDevice(Device& device) : device_(device) {}
+
+  Device& device_;
+  SwapInfo info_;
+  uint64_t size_ = 0;
+};
+
+enum class MemoryArtifactKind : uint8_t
+{
+  Hibernation,
+  Swap,
+  Pagefile,  // or any other run of raw pages
+};
+
+struct MemoryArtifact
+{
+  MemoryArtifactKind kind = MemoryArtifactKind::Pagefile;
+  Device* device = nullptr;        // what to carve: `owned`, or the source itself
+  std::unique_ptr<Device> owned;
+};
+
+/// Present `source` for carving. A swap header makes it a swap area; a
+/// hibernation header, or a first page wiped to zeros, has the file indexed
+/// for compressed blocks, and it is taken as a hibernation file when any is
+/// found. Anything else is a pagefile.
+MemoryArtifact openMemoryArtifact(Device& source, HiberOptions options = HiberOptions());
+
+}  // namespace rsn
@@ -0,0 +1,100 @@
+// RecoverySoftNetz — sector access and file index for optical disc images
+
+#include "optical/disc_reader.h"
+
+#include <cstring>
+
+namespace rsn
+{
+
+bool DiscReader::readSector(uint64_t sector, uint8_t* out)
+{
+  if (sector >= sectorCount() || bad_.count(sector) != 0)
+  {
+    return false;
+  }
+  if (device_.read(sector * sector_size_, out, sector_size_) != sector_size_)
+  {
+    bad_.insert(sector);
+    return false;
+  }
+  return true;
+}
+
+bool DiscReader::read(uint64_t first, size_t count, uint8_t* out)
+{
+  size_t good = 0;
+  bool clean = first + count <= sectorCount();
+  for (size_t i = 0; clean && i < count; ++i)
+  {
+    clean = bad_.count(first + i) == 0;
+  }
+  if (clean)
+  {
+    size_t want = count * sector_size_;
+    size_t got = device_.read(first * sector_size_, out, want);
+    if (got == want)
+    {
+      return true;
+    }
+    // The device stopped at the first sector it could not read.
+    good = got / sector_size_;
+    bad_.insert(first + good);
+  }
+  bool complete = true;
+  for (size_t i = good; i < count; ++i)
+  {
+    uint8_t* sector = out + i * sector_size_;
+    if (!readSector(first + i, sector))
+    {
+      std::memset(sector, 0, sector_size_);
+      complete = false;
+    }
+  }
+  return complete;
+}
+
+bool DiscReader::readBytes(uint64_t offset, size_t length, std::vector<uint8_t>& out)
+{
+  uint64_t first = offset / sector_size_;
+  uint64_t last = (offset + length + sector_size_ - 1) / sector_size_;
+  std::vector<uint8_t> raw(static_cast<size_t>(last - first) * sector_size_);
+  bool complete = read(first, static_cast<size_t>(last - first), raw.data());
+  size_t skip = static_cast<size_t>(offset - first * sector_size_);
+  out.assign(raw.begin() + static_cast<std::ptrdiff_t>(skip),
+             raw.begin() + static_cast<std::ptrdiff_t>(skip + length));
+  return complete;
+}
+
+void registerDiscIndex(const DiscIndex& index, const char* family, FileRegistry& registry)
+{
+  for (const DiscFile& entry : index.files)
+  {
+    if (entry.directory)
+    {
+      continue;
+    }
+    RecoveredFile file;
+    file.type = std::string("optical/") + family;
+    file.source = family;
+    file.offset = entry.extents.empty() ? 0 : entry.extents.front().offset;
+    file.size = entry.size;
+    file.confidence = entry.damaged ? 0.5 : entry.deleted ? 0.6 : 1.0;
+    file.description = entry.path;
+    if (index.sessions.size() > 1)
+    {
+      file.description += " (session " + std::to_string(entry.session + 1) + ")";
+    }
+    if (entry.deleted)
+    {
+      file.description += " [deleted]";
+    }
+    if (entry.extents.size() > 1)
+    {
+      file.extents = entry.extents;
+    }
+    registry.add(std::move(file));
+  }
+}
+
+}  // namespace rsn
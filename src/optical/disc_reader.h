@@ -0,0 +1,77 @@
+// RecoverySoftNetz — sector access and file index for optical disc images
+//
+// Scratched discs leave holes in their images: runs of sectors that the
+// drive (or the image's map) reports as unreadable. Parsers read through
+// DiscReader, which remembers every sector that failed and never asks the
+// device for it again. A directory walk that crosses a scratch pays one
+// failed read per bad sector, then carries on with whatever else is reachable.
+// Multi-sector reads that come back short are retried sector by sector, so a
+// hole costs only the sectors inside it.
+
+#pragma once
+
+#include "core/device.h"
+#include "core/file_registry.h"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace rsn
+{
+
+constexpr uint32_t DISC_SECTOR_SIZE = 2048;
+
+struct DiscFile
+{
+  std::string path;             // '/' separated, relative to the volume root
+  uint64_t size = 0;
+  std::vector<Extent> extents;  // device byte ranges, in file order
+  uint32_t session = 0;         // 0 = first session / oldest generation
+  bool directory = false;
+  bool deleted = false;         // UDF identifier marked deleted, still allocated
+  bool damaged = false;         // some of its metadata sat in unreadable sectors
+};
+
+struct DiscIndex
+{
+  std::vector<DiscFile> files;
+  std::vector<uint64_t> sessions;  // first sector of every session or VAT generation found
+  uint64_t unreadable_sectors = 0;
+};
+
+class DiscReader
+{
+public:
+  explicit DiscReader(Device& device, uint32_t sector_size = DISC_SECTOR_SIZE)
+    : device_(device), sector_size_(sector_size)
+  {
+  }
+
+  Device& device() { return device_; }
+  uint32_t sectorSize() const { return sector_size_; }
+  uint64_t sectorCount() const { return device_.size() / sector_size_; }
+
+  /// Read one sector; false when it is (or was already found) unreadable.
+  bool readSector(uint64_t sector, uint8_t* out);
+
+  /// Read `count` sectors. Unreadable sectors are zero-filled; returns true
+  /// only when every sector was read.
+  bool read(uint64_t first, size_t count, uint8_t* out);
+
+  /// Byte-addressed form of `read`: `out` receives `length` bytes at `offset`.
+  bool readBytes(uint64_t offset, size_t length, std::vector<uint8_t>& out);
+
+  bool isUnreadable(uint64_t sector) const { return bad_.count(sector) != 0; }
+  uint64_t unreadable() const { return bad_.size(); }
+
+private:
+  Device& device_;
+  uint32_t sector_size_;
+  std::unordered_set<uint64_t> bad_;
+};
+
+/// Record every file of `index` in the registry as "optical/<family>".
+void registerDiscIndex(const DiscIndex& index, const char* family, FileRegistry& registry);
+
+}  // namespace rsn
@@ -0,0 +1,475 @@
+// RecoverySoftNetz — ISO9660 / Joliet / Rock Ridge parser
+
+#include "optical/iso9660.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <unordered_set>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint64_t DESCRIPTOR_START = 16;
+constexpr unsigned MAX_DESCRIPTORS = 64;
+constexpr uint8_t DESCRIPTOR_PRIMARY = 1;
+constexpr uint8_t DESCRIPTOR_SUPPLEMENTARY = 2;
+constexpr uint8_t DESCRIPTOR_TERMINATOR = 255;
+constexpr size_t ROOT_RECORD = 156;
+constexpr size_t RECORD_HEADER = 33;
+constexpr uint8_t FLAG_DIRECTORY = 0x02;
+constexpr uint8_t FLAG_MULTI_EXTENT = 0x80;
+constexpr uint8_t NM_CURRENT_OR_PARENT = 0x06;
+constexpr uint64_t MAX_DIRECTORY_BYTES = 16u << 20;
+constexpr unsigned MAX_DEPTH = 64;
+constexpr unsigned MAX_CONTINUATIONS = 16;
+constexpr size_t SEARCH_BATCH = 64;
+
+bool isDescriptor(const uint8_t* sector)
+{
+  return std::memcmp(sector + 1, "CD001", 5) == 0 && sector[6] == 1;
+}
+
+struct Tree
+{
+  uint32_t block_size = 0;
+  uint64_t volume_blocks = 0;
+  uint64_t root_lba = 0;
+  uint64_t root_size = 0;
+  bool joliet = false;
+};
+
+struct SessionDescriptors
+{
+  bool has_primary = false;
+  bool has_joliet = false;
+  Tree primary;
+  Tree joliet;
+};
+
+bool parseTree(const uint8_t* sector, bool joliet, Tree& tree)
+{
+  tree.block_size = loadLE16(sector + 128);
+  tree.volume_blocks = loadLE32(sector + 80);
+  tree.root_lba = loadLE32(sector + ROOT_RECORD + 2);
+  tree.root_size = loadLE32(sector + ROOT_RECORD + 10);
+  tree.joliet = joliet;
+  return isPowerOfTwo(tree.block_size) && tree.block_size >= 512 &&
+         tree.block_size <= DISC_SECTOR_SIZE && tree.root_size != 0;
+}
+
+// The descriptor set ends at a terminator; unreadable sectors inside it are
+// stepped over so one scratch does not hide a Joliet tree behind it.
+bool readDescriptors(DiscReader& reader, uint64_t start, SessionDescriptors& out)
+{
+  std::vector<uint8_t> sector(reader.sectorSize());
+  for (unsigned i = 0; i < MAX_DESCRIPTORS; ++i)
+  {
+    if (!reader.readSector(start + DESCRIPTOR_START + i, sector.data()))
+    {
+      continue;
+    }
+    if (!isDescriptor(sector.data()) || sector[0] == DESCRIPTOR_TERMINATOR)
+    {
+      break;
+    }
+    if (sector[0] == DESCRIPTOR_PRIMARY && !out.has_primary)
+    {
+      out.has_primary = parseTree(sector.data(), false, out.primary);
+    }
+    else if (sector[0] == DESCRIPTOR_SUPPLEMENTARY && !out.has_joliet)
+    {
+      const uint8_t* escape = sector.data() + 88;
+      bool ucs2 = escape[0] == '%' && escape[1] == '/' &&
+                  (escape[2] == '@' || escape[2] == 'C' || escape[2] == 'E');
+      out.has_joliet = ucs2 && parseTree(sector.data(), true, out.joliet);
+    }
+  }
+  return out.has_primary || out.has_joliet;
+}
+
+std::string stripVersion(std::string name)
+{
+  size_t semi = name.find(';');
+  if (semi != std::string::npos)
+  {
+    name.resize(semi);
+  }
+  if (!name.empty() && name.back() == '.')
+  {
+    name.pop_back();
+  }
+  return name;
+}
+
+std::string safeName(std::string name)
+{
+  for (char& c : name)
+  {
+    if (c == '/' || c == '\0')
+    {
+      c = '_';
+    }
+  }
+  if (name.empty() || name == "." || name == "..")
+  {
+    name.insert(0, "_");
+  }
+  return name;
+}
+
+// Rock Ridge is announced by an SUSP "SP" entry in the root's "." record;
+// `skip` receives the bytes to skip at the start of every system use area.
+bool detectRockRidge(DiscReader& reader, const Tree& tree, size_t& skip)
+{
+  std::vector<uint8_t> head;
+  if (!reader.readBytes(tree.root_lba * tree.block_size, 256, head))
+  {
+    return false;
+  }
+  const size_t su = RECORD_HEADER + 1;  // "." has a one-byte identifier, no padding
+  if (head[0] >= su + 7 && head[su] == 'S' && head[su + 1] == 'P' && head[su + 4] == 0xBE &&
+      head[su + 5] == 0xEF)
+  {
+    skip = head[su + 6];
+    return true;
+  }
+  return false;
+}
+
+struct RockRidge
+{
+  std::string name;
+  bool has_name = false;
+  bool relocated = false;           // RE: reached through a CL elsewhere
+  uint64_t child = UINT64_MAX;      // CL: the real location of a moved directory
+};
+
+class IsoWalker
+{
+public:
+  /// `rock_ridge` enables SUSP parsing with `rr_skip` bytes skipped per area.
+  IsoWalker(DiscReader& reader, const Tree& tree, bool rock_ridge, size_t rr_skip,
+            uint32_t session, std::vector<DiscFile>& out)
+    : reader_(reader),
+      tree_(tree),
+      rock_ridge_(rock_ridge),
+      rr_skip_(rr_skip),
+      session_(session),
+      out_(out)
+  {
+  }
+
+  void run();
+
+private:
+  struct Directory
+  {
+    uint64_t lba;
+    uint64_t size;
+    std::string path;  // with trailing '/', empty for the root
+    unsigned depth;
+    size_t entry;      // index in out_, SIZE_MAX for the root
+  };
+
+  uint64_t byteOffset(uint64_t lba) const { return lba * tree_.block_size; }
+  void walk(const Directory& dir, std::deque<Directory>& queue);
+  void systemUse(const uint8_t* p, size_t length, RockRidge& rr, unsigned depth);
+  std::string plainName(const uint8_t* id, size_t length) const;
+
+  DiscReader& reader_;
+  Tree tree_;
+  bool rock_ridge_;
+  size_t rr_skip_;
+  uint32_t session_;
+  std::vector<DiscFile>& out_;
+  std::unordered_set<uint64_t> visited_;
+};
+
+void IsoWalker::systemUse(const uint8_t* p, size_t length, RockRidge& rr, unsigned depth)
+{
+  uint64_t ce_block = 0;
+  uint64_t ce_offset = 0;
+  uint64_t ce_length = 0;
+  size_t pos = 0;
+  while (pos + 4 <= length)
+  {
+    const uint8_t* e = p + pos;
+    size_t size = e[2];
+    if (size < 4 || pos + size > length)
+    {
+      break;
+    }
+    if (e[0] == 'N' && e[1] == 'M' && size >= 5 && (e[4] & NM_CURRENT_OR_PARENT) == 0)
+    {
+      rr.name.append(reinterpret_cast<const char*>(e + 5), size - 5);
+      rr.has_name = true;
+    }
+    else if (e[0] == 'C' && e[1] == 'L' && size >= 12)
+    {
+      rr.child = loadLE32(e + 4);
+    }
+    else if (e[0] == 'R' && e[1] == 'E')
+    {
+      rr.relocated = true;
+    }
+    else if (e[0] == 'C' && e[1] == 'E' && size >= 28)
+    {
+      ce_block = loadLE32(e + 4);
+      ce_offset = loadLE32(e + 12);
+      ce_length = loadLE32(e + 20);
+    }
+    else if (e[0] == 'S' && e[1] == 'T')
+    {
+      break;
+    }
+    pos += size;
+  }
+  std::vector<uint8_t> more;
+  if (ce_length != 0 && ce_length <= tree_.block_size && depth < MAX_CONTINUATIONS &&
+      reader_.readBytes(byteOffset(ce_block) + ce_offset, ce_length, more))
+  {
+    systemUse(more.data(), more.size(), rr, depth + 1);
+  }
+}
+
+std::string IsoWalker::plainName(const uint8_t* id, size_t length) const
+{
+  if (!tree_.joliet)
+  {
+    return stripVersion(std::string(reinterpret_cast<const char*>(id), length));
+  }
+  std::string name;
+  appendUtf16BE(name, id, length);
+  return stripVersion(name);
+}
+
+void IsoWalker::walk(const Directory& dir, std::deque<Directory>& queue)
+{
+  std::vector<uint8_t> data;
+  if (!reader_.readBytes(byteOffset(dir.lba), dir.size, data) && dir.entry != SIZE_MAX)
+  {
+    out_[dir.entry].damaged = true;
+  }
+
+  DiscFile pending;
+  bool has_pending = false;
+  auto flush = [&]()
+  {
+    if (has_pending)
+    {
+      out_.push_back(std::move(pending));
+      pending = DiscFile();
+      has_pending = false;
+    }
+  };
+
+  // Records never straddle a logical block; a zero length byte ends the block.
+  for (size_t block = 0; block < data.size(); block += tree_.block_size)
+  {
+    size_t end = std::min(data.size(), block + tree_.block_size);
+    size_t pos = block;
+    while (pos < end && data[pos] != 0)
+    {
+      const uint8_t* rec = data.data() + pos;
+      size_t length = rec[0];
+      if (length < RECORD_HEADER + 1 || pos + length > end)
+      {
+        break;
+      }
+      pos += length;
+      size_t id_length = rec[32];
+      if (RECORD_HEADER + id_length > length ||
+          (id_length == 1 && (rec[RECORD_HEADER] == 0 || rec[RECORD_HEADER] == 1)))
+      {
+        continue;
+      }
+      RockRidge rr;
+      size_t su = RECORD_HEADER + id_length + ((id_length & 1) == 0 ? 1 : 0) + rr_skip_;
+      if (rock_ridge_ && su < length)
+      {
+        systemUse(rec + su, length - su, rr, 0);
+      }
+      if (rr.relocated)
+      {
+        continue;
+      }
+      std::string path =
+        dir.path + safeName(rr.has_name ? rr.name : plainName(rec + RECORD_HEADER, id_length));
+      uint64_t lba = loadLE32(rec + 2) + rec[1];
+      uint64_t size = loadLE32(rec + 10);
+      uint8_t flags = rec[25];
+
+      if ((flags & FLAG_DIRECTORY) != 0 || rr.child != UINT64_MAX)
+      {
+        flush();
+        if (rr.child != UINT64_MAX)
+        {
+          // A relocated directory's size is in its own "." record.
+          std::vector<uint8_t> dot;
+          lba = rr.child;
+          bool ok = reader_.readBytes(byteOffset(lba), RECORD_HEADER, dot);
+          size = ok ? loadLE32(dot.data() + 10) : 0;
+        }
+        DiscFile entry;
+        entry.path = path;
+        entry.size = size;
+        entry.directory = true;
+        entry.session = session_;
+        entry.extents.push_back({byteOffset(lba), size});
+        out_.push_back(std::move(entry));
+        if (size != 0 && size <= MAX_DIRECTORY_BYTES && dir.depth + 1 < MAX_DEPTH &&
+            visited_.insert(lba).second)
+        {
+          queue.push_back({lba, size, path + "/", dir.depth + 1, out_.size() - 1});
+        }
+        continue;
+      }
+
+      // Files over 4 GiB are split into records flagged multi-extent; the
+      // last one carries the flag clear.
+      if (!has_pending || pending.path != path)
+      {
+        flush();
+        pending.path = path;
+        pending.session = session_;
+        has_pending = true;
+      }
+      pending.size += size;
+      if (size != 0)
+      {
+        pending.extents.push_back({byteOffset(lba), size});
+      }
+      if ((flags & FLAG_MULTI_EXTENT) == 0)
+      {
+        flush();
+      }
+    }
+  }
+  flush();
+}
+
+void IsoWalker::run()
+{
+  std::deque<Directory> queue;
+  visited_.insert(tree_.root_lba);
+  if (tree_.root_size <= MAX_DIRECTORY_BYTES)
+  {
+    queue.push_back({tree_.root_lba, tree_.root_size, std::string(), 0, SIZE_MAX});
+  }
+  while (!queue.empty())
+  {
+    Directory dir = std::move(queue.front());
+    queue.pop_front();
+    walk(dir, queue);
+  }
+}
+
+// Next session: the first primary descriptor past the end of this one's
+// volume space, within the search window.
+bool nextSession(DiscReader& reader, uint64_t from, uint64_t window, uint64_t& start)
+{
+  uint64_t limit = std::min(reader.sectorCount(), from + window);
+  size_t sector = reader.sectorSize();
+  std::vector<uint8_t> batch(SEARCH_BATCH * sector);
+  for (uint64_t s = from; s < limit; s += SEARCH_BATCH)
+  {
+    size_t n = static_cast<size_t>(std::min<uint64_t>(SEARCH_BATCH, limit - s));
+    reader.read(s, n, batch.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+      const uint8_t* p = batch.data() + i * sector;
+      if (p[0] == DESCRIPTOR_PRIMARY && isDescriptor(p) && s + i >= DESCRIPTOR_START)
+      {
+        start = s + i - DESCRIPTOR_START;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+std::vector<uint64_t> findSessions(DiscReader& reader, uint64_t window)
+{
+  std::vector<uint64_t> starts;
+  uint64_t start = 0;
+  SessionDescriptors set;
+  while (readDescriptors(reader, start, set) && set.has_primary)
+  {
+    starts.push_back(start);
+    uint64_t end = set.primary.volume_blocks * set.primary.block_size / reader.sectorSize();
+    uint64_t from = std::max(end, start + DESCRIPTOR_START + 1);
+    uint64_t next = 0;
+    if (!nextSession(reader, from, window, next) || next <= start)
+    {
+      break;
+    }
+    start = next;
+    set = SessionDescriptors();
+  }
+  return starts;
+}
+
+std::string dedupKey(const DiscFile& file)
+{
+  if (file.directory || file.extents.empty())
+  {
+    return (file.directory ? "d:" : "f:") + file.path;
+  }
+  return std::to_string(file.extents.front().offset) + ":" + std::to_string(file.size);
+}
+
+}  // namespace
+
+bool probeIso9660(DiscReader& reader)
+{
+  std::vector<uint8_t> sector(reader.sectorSize());
+  return reader.readSector(DESCRIPTOR_START, sector.data()) && isDescriptor(sector.data()) &&
+         sector[0] == DESCRIPTOR_PRIMARY;
+}
+
+bool indexIso9660(DiscReader& reader, DiscIndex& index, const IsoOptions& options)
+{
+  std::vector<uint64_t> starts = options.session_starts;
+  if (starts.empty())
+  {
+    starts = findSessions(reader, options.session_search);
+  }
+
+  std::unordered_set<std::string> seen;
+  bool any = false;
+  for (size_t i = starts.size(); i-- > 0;)
+  {
+    SessionDescriptors set;
+    if (!readDescriptors(reader, starts[i], set))
+    {
+      continue;
+    }
+    // Rock Ridge lives in the primary tree; without it Joliet has the better names.
+    size_t rr_skip = 0;
+    bool rock_ridge = options.rock_ridge && set.has_primary &&
+                      detectRockRidge(reader, set.primary, rr_skip);
+    bool use_joliet = set.has_joliet && (!set.has_primary || (options.joliet && !rock_ridge));
+    const Tree& tree = use_joliet ? set.joliet : set.primary;
+    std::vector<DiscFile> files;
+    IsoWalker(reader, tree, rock_ridge, rr_skip, static_cast<uint32_t>(i), files).run();
+    for (DiscFile& file : files)
+    {
+      if (seen.insert(dedupKey(file)).second)
+      {
+        index.files.push_back(std::move(file));
+      }
+    }
+    any = true;
+  }
+  index.sessions.insert(index.sessions.end(), starts.begin(), starts.end());
+  index.unreadable_sectors = reader.unreadable();
+  return any;
+}
+
+}  // namespace rsn
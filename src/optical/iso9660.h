@@ -0,0 +1,39 @@
+// RecoverySoftNetz — ISO9660 / Joliet / Rock Ridge parser
+//
+// Walks the directory tree of every session on the disc. Each session has
+// its own volume descriptor set at session start + 16. A later session
+// usually re-references the files of earlier ones, but files that were
+// replaced or hidden remain reachable only through the older descriptors.
+// Sessions are indexed newest first and duplicates (same extent and size)
+// are dropped, so the index holds the current tree plus whatever only older
+// sessions still point at.
+//
+// Without a TOC, sessions are found by looking for the next primary volume
+// descriptor past the end of the previous session's volume space. Names come
+// from Rock Ridge NM entries when present, then from the Joliet tree, then
+// from the plain ISO9660 identifiers.
+
+#pragma once
+
+#include "optical/disc_reader.h"
+
+#include <vector>
+
+namespace rsn
+{
+
+struct IsoOptions
+{
+  std::vector<uint64_t> session_starts;  // first sector of each session (from a TOC/cue)
+  uint64_t session_search = 32768;       // sectors scanned past a session for the next one
+  bool rock_ridge = true;                // use Rock Ridge names when present
+  bool joliet = true;                    // use the Joliet tree when there is no Rock Ridge
+};
+
+/// Index every session found. False when no primary volume descriptor is readable.
+bool indexIso9660(DiscReader& reader, DiscIndex& index, const IsoOptions& options = IsoOptions());
+
+/// True when the disc carries an ISO9660 primary volume descriptor at sector 16.
+bool probeIso9660(DiscReader& reader);
+
+}  // namespace rsn
@@ -0,0 +1,915 @@
+// RecoverySoftNetz — UDF 1.02–2.60 parser
+
+#include "optical/udf.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <unordered_set>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint16_t TAG_ANCHOR = 2;
+constexpr uint16_t TAG_PARTITION = 5;
+constexpr uint16_t TAG_LOGICAL_VOLUME = 6;
+constexpr uint16_t TAG_TERMINATOR = 8;
+constexpr uint16_t TAG_FILE_SET = 256;
+constexpr uint16_t TAG_FILE_ID = 257;
+constexpr uint16_t TAG_ALLOCATION_EXTENT = 258;
+constexpr uint16_t TAG_FILE_ENTRY = 261;
+constexpr uint16_t TAG_EXTENDED_FILE_ENTRY = 266;
+
+constexpr uint8_t FILE_TYPE_DIRECTORY = 4;
+constexpr uint8_t FILE_TYPE_VAT = 248;
+
+constexpr uint8_t FID_DIRECTORY = 0x02;
+constexpr uint8_t FID_DELETED = 0x04;
+constexpr uint8_t FID_PARENT = 0x08;
+constexpr size_t FID_HEADER = 38;
+
+constexpr uint32_t AD_RECORDED = 0;
+constexpr uint32_t AD_NEXT = 3;
+constexpr uint32_t AD_LENGTH_MASK = 0x3FFFFFFF;
+constexpr uint32_t VAT_UNUSED = 0xFFFFFFFF;
+constexpr size_t VAT150_TRAILER = 36;  // regid + previous VAT ICB at the end of a 1.50 VAT
+
+constexpr unsigned MAX_SEQUENCE = 64;
+constexpr unsigned MAX_AD_HOPS = 256;
+constexpr unsigned MAX_DEPTH = 64;
+constexpr uint64_t MAX_DIRECTORY_BYTES = 64u << 20;
+constexpr uint64_t MAX_VAT_BYTES = 64u << 20;
+constexpr uint64_t VAT_SCAN = 256;  // sectors searched back from the end for the VAT ICB
+
+uint16_t crcItu(const uint8_t* p, size_t size)
+{
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; ++i)
+  {
+    crc = static_cast<uint16_t>(crc ^ (p[i] << 8));
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = static_cast<uint16_t>((crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Descriptor tag: identifier, checksum over the other tag bytes, and the
+// CRC over the descriptor body when it fits in `size`.
+bool validTag(const uint8_t* p, size_t size, uint16_t id)
+{
+  if (size < 16 || loadLE16(p) != id)
+  {
+    return false;
+  }
+  uint8_t sum = 0;
+  for (size_t i = 0; i < 16; ++i)
+  {
+    sum = static_cast<uint8_t>(sum + (i == 4 ? 0 : p[i]));
+  }
+  size_t crc_length = loadLE16(p + 10);
+  return sum == p[4] && (16 + crc_length > size || crcItu(p + 16, crc_length) == loadLE16(p + 8));
+}
+
+// OSTA CS0: compression id 8 (or 254) is one byte per character, 16 (or 255)
+// is big-endian UCS-2.
+std::string decodeIdentifier(const uint8_t* p, size_t length)
+{
+  std::string name;
+  if (length == 0)
+  {
+    return name;
+  }
+  bool wide = p[0] == 16 || p[0] == 255;
+  if (wide)
+  {
+    appendUtf16BE(name, p + 1, length - 1);
+  }
+  else
+  {
+    for (size_t i = 1; i < length; ++i)
+    {
+      appendUtf8(name, p[i]);
+    }
+  }
+  for (char& c : name)
+  {
+    if (c == '/' || c == '\0')
+    {
+      c = '_';
+    }
+  }
+  if (name.empty() || name == "." || name == "..")
+  {
+    name.insert(0, "_");
+  }
+  return name;
+}
+
+enum class MapKind : uint8_t
+{
+  Physical,
+  Sparable,
+  Virtual,
+  Metadata,
+  Unmapped,  // unrecognised type 2 map, kept so later maps keep their numbers
+};
+
+/// File offset -> device byte range, for the metadata file.
+struct MappedExtent
+{
+  uint64_t file_offset;
+  uint64_t device_offset;
+  uint64_t length;
+};
+
+struct PartitionMap
+{
+  MapKind kind = MapKind::Physical;
+  uint16_t number = 0;          // partition descriptor number
+  uint64_t start = UINT64_MAX;  // first sector of the partition
+  uint64_t length = 0;          // sectors
+  size_t physical = SIZE_MAX;   // map index of the underlying physical partition
+  uint32_t packet = 0;                     // sparable: blocks per packet
+  std::vector<uint32_t> sparing_tables;    // sparable: table locations (sectors)
+  uint32_t sparing_size = 0;
+  std::map<uint32_t, uint32_t> sparing;    // sparable: packet -> relocated sector
+  std::vector<uint32_t> vat;               // virtual: virtual block -> physical block
+  uint32_t metadata_file = 0;              // metadata: FE locations in the physical partition
+  uint32_t metadata_mirror = 0;
+  std::vector<MappedExtent> metadata;
+};
+
+struct Entry
+{
+  uint8_t file_type = 0;
+  uint64_t size = 0;
+  std::vector<Extent> extents;  // device byte ranges, in file order
+  std::vector<uint8_t> embedded;
+  bool is_embedded = false;
+  bool complete = true;         // every allocation descriptor could be mapped
+};
+
+struct Location
+{
+  uint16_t partition;
+  uint32_t block;
+};
+
+class UdfVolume
+{
+public:
+  UdfVolume(DiscReader& reader, const UdfOptions& options, DiscIndex& index)
+    : reader_(reader), options_(options), index_(index)
+  {
+  }
+
+  bool load();
+  void run();
+
+private:
+  bool findAnchor(uint64_t& main, uint32_t& main_length, uint64_t& reserve,
+                  uint32_t& reserve_length);
+  bool readSequence(uint64_t sector, uint32_t length);
+  bool buildMaps();
+  void loadSparing(PartitionMap& map);
+  bool loadMetadata(PartitionMap& map);
+  uint64_t toDevice(uint16_t partition, uint32_t block) const;
+  bool readBlock(Location at, std::vector<uint8_t>& out);
+  bool readEntry(Location at, Entry& entry);
+  void addExtent(Entry& entry, uint16_t partition, uint32_t block, uint64_t length);
+  bool readData(const Entry& entry, uint64_t limit, std::vector<uint8_t>& out);
+  bool findVat(uint64_t& sector);
+  bool loadVat(size_t map, uint64_t sector, uint32_t& previous);
+  bool rootDirectory(Location& root);
+  void walk(uint32_t session, std::vector<DiscFile>& out);
+
+  DiscReader& reader_;
+  const UdfOptions& options_;
+  DiscIndex& index_;
+  uint32_t block_size_ = DISC_SECTOR_SIZE;
+  std::map<uint16_t, std::pair<uint64_t, uint64_t>> partitions_;  // number -> (start, length)
+  std::vector<uint8_t> map_table_;
+  uint32_t map_count_ = 0;
+  Location file_set_ = {0, 0};
+  bool have_volume_ = false;
+  std::vector<PartitionMap> maps_;
+};
+
+bool UdfVolume::findAnchor(uint64_t& main, uint32_t& main_length, uint64_t& reserve,
+                           uint32_t& reserve_length)
+{
+  uint64_t count = reader_.sectorCount();
+  const uint64_t candidates[] = {256, count > 256 ? count - 256 : UINT64_MAX,
+                                 count > 0 ? count - 1 : UINT64_MAX, 512};
+  std::vector<uint8_t> sector(reader_.sectorSize());
+  for (uint64_t at : candidates)
+  {
+    if (at == UINT64_MAX || !reader_.readSector(at, sector.data()) ||
+        !validTag(sector.data(), sector.size(), TAG_ANCHOR) || loadLE32(sector.data() + 12) != at)
+    {
+      continue;
+    }
+    main_length = loadLE32(sector.data() + 16);
+    main = loadLE32(sector.data() + 20);
+    reserve_length = loadLE32(sector.data() + 24);
+    reserve = loadLE32(sector.data() + 28);
+    return true;
+  }
+  return false;
+}
+
+bool UdfVolume::readSequence(uint64_t sector, uint32_t length)
+{
+  std::vector<uint8_t> buffer(reader_.sectorSize());
+  uint64_t count = std::min<uint64_t>(length / reader_.sectorSize(), MAX_SEQUENCE);
+  for (uint64_t i = 0; i < count; ++i)
+  {
+    if (!reader_.readSector(sector + i, buffer.data()))
+    {
+      continue;
+    }
+    const uint8_t* d = buffer.data();
+    uint16_t id = loadLE16(d);
+    if (!validTag(d, buffer.size(), id))
+    {
+      continue;
+    }
+    if (id == TAG_TERMINATOR)
+    {
+      break;
+    }
+    if (id == TAG_PARTITION)
+    {
+      partitions_[loadLE16(d + 22)] = {loadLE32(d + 188), loadLE32(d + 192)};
+    }
+    else if (id == TAG_LOGICAL_VOLUME && !have_volume_)
+    {
+      uint32_t block_size = loadLE32(d + 212);
+      uint32_t table_length = loadLE32(d + 264);
+      if (!isPowerOfTwo(block_size) || block_size < reader_.sectorSize() ||
+          440 + static_cast<size_t>(table_length) > buffer.size())
+      {
+        continue;
+      }
+      block_size_ = block_size;
+      file_set_ = {loadLE16(d + 248 + 8), loadLE32(d + 248 + 4)};
+      map_count_ = loadLE32(d + 268);
+      map_table_.assign(d + 440, d + 440 + table_length);
+      have_volume_ = true;
+    }
+  }
+  return have_volume_ && !partitions_.empty();
+}
+
+bool UdfVolume::buildMaps()
+{
+  size_t pos = 0;
+  for (uint32_t i = 0; i < map_count_ && pos + 2 <= map_table_.size(); ++i)
+  {
+    const uint8_t* p = map_table_.data() + pos;
+    size_t length = p[1];
+    if (length < 6 || pos + length > map_table_.size())
+    {
+      break;
+    }
+    pos += length;
+    PartitionMap map;
+    if (p[0] == 1)
+    {
+      map.number = loadLE16(p + 4);
+    }
+    else if (p[0] == 2 && length >= 64)
+    {
+      map.number = loadLE16(p + 38);
+      const char* ident = reinterpret_cast<const char*>(p + 5);
+      if (std::strncmp(ident, "*UDF Virtual Partition", 22) == 0)
+      {
+        map.kind = MapKind::Virtual;
+      }
+      else if (std::strncmp(ident, "*UDF Sparable Partition", 23) == 0)
+      {
+        map.kind = MapKind::Sparable;
+        map.packet = loadLE16(p + 40);
+        map.sparing_size = loadLE32(p + 44);
+        for (unsigned t = 0; t < p[42] && t < 4; ++t)
+        {
+          map.sparing_tables.push_back(loadLE32(p + 48 + 4 * t));
+        }
+      }
+      else if (std::strncmp(ident, "*UDF Metadata Partition", 23) == 0)
+      {
+        map.kind = MapKind::Metadata;
+        map.metadata_file = loadLE32(p + 40);
+        map.metadata_mirror = loadLE32(p + 44);
+      }
+      else
+      {
+        map.kind = MapKind::Unmapped;
+      }
+    }
+    else
+    {
+      map.kind = MapKind::Unmapped;
+    }
+    auto part = partitions_.find(map.number);
+    if (part != partitions_.end())
+    {
+      map.start = part->second.first;
+      map.length = part->second.second;
+    }
+    maps_.push_back(std::move(map));
+  }
+
+  // Virtual and metadata partitions sit on the physical (or sparable) map of
+  // the same partition.
+  for (PartitionMap& map : maps_)
+  {
+    for (size_t j = 0; j < maps_.size(); ++j)
+    {
+      bool physical = maps_[j].kind == MapKind::Physical || maps_[j].kind == MapKind::Sparable;
+      if (physical && maps_[j].number == map.number)
+      {
+        map.physical = j;
+        break;
+      }
+    }
+  }
+  for (PartitionMap& map : maps_)
+  {
+    if (map.kind == MapKind::Sparable)
+    {
+      loadSparing(map);
+    }
+  }
+  for (PartitionMap& map : maps_)
+  {
+    if (map.kind == MapKind::Metadata)
+    {
+      loadMetadata(map);
+    }
+  }
+  return !maps_.empty();
+}
+
+void UdfVolume::loadSparing(PartitionMap& map)
+{
+  if (map.packet == 0 || map.sparing_size < 56 || map.sparing_size > (1u << 20))
+  {
+    return;
+  }
+  std::vector<uint8_t> table;
+  for (uint32_t location : map.sparing_tables)
+  {
+    uint64_t offset = static_cast<uint64_t>(location) * reader_.sectorSize();
+    if (!reader_.readBytes(offset, map.sparing_size, table) ||
+        !validTag(table.data(), table.size(), 0) ||
+        std::memcmp(table.data() + 17, "*UDF Sparing Table", 18) != 0)
+    {
+      continue;
+    }
+    size_t entries = loadLE16(table.data() + 48);
+    for (size_t i = 0; i < entries && 56 + 8 * i + 8 <= table.size(); ++i)
+    {
+      uint32_t original = loadLE32(table.data() + 56 + 8 * i);
+      if (original < 0xFFFFFFF0u)
+      {
+        map.sparing[original] = loadLE32(table.data() + 56 + 8 * i + 4);
+      }
+    }
+    return;
+  }
+}
+
+bool UdfVolume::loadMetadata(PartitionMap& map)
+{
+  if (map.physical == SIZE_MAX)
+  {
+    return false;
+  }
+  uint16_t physical = static_cast<uint16_t>(map.physical);
+  for (uint32_t location : {map.metadata_file, map.metadata_mirror})
+  {
+    Entry entry;
+    if (!readEntry({physical, location}, entry) || !entry.complete || entry.is_embedded)
+    {
+      continue;
+    }
+    uint64_t file_offset = 0;
+    for (const Extent& extent : entry.extents)
+    {
+      map.metadata.push_back({file_offset, extent.offset, extent.length});
+      file_offset += extent.length;
+    }
+    return true;
+  }
+  return false;
+}
+
+uint64_t UdfVolume::toDevice(uint16_t partition, uint32_t block) const
+{
+  if (partition >= maps_.size())
+  {
+    return UINT64_MAX;
+  }
+  const PartitionMap& map = maps_[partition];
+  uint64_t sector = reader_.sectorSize();
+  switch (map.kind)
+  {
+    case MapKind::Physical:
+    case MapKind::Sparable:
+    {
+      if (map.start == UINT64_MAX)
+      {
+        return UINT64_MAX;
+      }
+      if (map.kind == MapKind::Sparable && map.packet != 0)
+      {
+        uint32_t packet = block / map.packet * map.packet;
+        auto it = map.sparing.find(packet);
+        if (it != map.sparing.end())
+        {
+          return static_cast<uint64_t>(it->second) * sector +
+                 static_cast<uint64_t>(block - packet) * block_size_;
+        }
+      }
+      return map.start * sector + static_cast<uint64_t>(block) * block_size_;
+    }
+    case MapKind::Virtual:
+    {
+      if (block >= map.vat.size() || map.vat[block] == VAT_UNUSED || map.physical == SIZE_MAX)
+      {
+        return UINT64_MAX;
+      }
+      return toDevice(static_cast<uint16_t>(map.physical), map.vat[block]);
+    }
+    case MapKind::Metadata:
+    {
+      uint64_t offset = static_cast<uint64_t>(block) * block_size_;
+      for (const MappedExtent& extent : map.metadata)
+      {
+        if (offset >= extent.file_offset && offset < extent.file_offset + extent.length)
+        {
+          return extent.device_offset + (offset - extent.file_offset);
+        }
+      }
+      return UINT64_MAX;
+    }
+    case MapKind::Unmapped:
+      return UINT64_MAX;
+  }
+  return UINT64_MAX;
+}
+
+bool UdfVolume::readBlock(Location at, std::vector<uint8_t>& out)
+{
+  uint64_t offset = toDevice(at.partition, at.block);
+  return offset != UINT64_MAX && reader_.readBytes(offset, block_size_, out);
+}
+
+// Recorded extents are translated block by block, since sparing, VAT and
+// metadata mappings are not contiguous; adjacent blocks are coalesced.
+void UdfVolume::addExtent(Entry& entry, uint16_t partition, uint32_t block, uint64_t length)
+{
+  for (uint64_t done = 0; done < length; ++block)
+  {
+    uint64_t piece = std::min<uint64_t>(block_size_, length - done);
+    uint64_t offset = toDevice(partition, block);
+    done += piece;
+    if (offset == UINT64_MAX)
+    {
+      entry.complete = false;
+      continue;
+    }
+    if (!entry.extents.empty() &&
+        entry.extents.back().offset + entry.extents.back().length == offset)
+    {
+      entry.extents.back().length += piece;
+    }
+    else
+    {
+      entry.extents.push_back({offset, piece});
+    }
+  }
+}
+
+bool UdfVolume::readEntry(Location at, Entry& entry)
+{
+  std::vector<uint8_t> block;
+  if (!readBlock(at, block))
+  {
+    return false;
+  }
+  const uint8_t* d = block.data();
+  bool extended = validTag(d, block.size(), TAG_EXTENDED_FILE_ENTRY);
+  if (!extended && !validTag(d, block.size(), TAG_FILE_ENTRY))
+  {
+    return false;
+  }
+  entry = Entry();
+  entry.file_type = d[27];
+  entry.size = loadLE64(d + 56);
+  size_t base = extended ? 216 : 176;
+  uint64_t ea_length = loadLE32(d + (extended ? 208 : 168));
+  uint64_t ad_length = loadLE32(d + (extended ? 212 : 172));
+  if (base + ea_length + ad_length > block.size())
+  {
+    return false;
+  }
+  const uint8_t* ads = d + base + ea_length;
+  unsigned ad_type = loadLE16(d + 34) & 7;
+  if (ad_type == 3)
+  {
+    // Data embedded in the entry: its extent points inside the entry's block.
+    uint64_t length = std::min<uint64_t>(ad_length, entry.size);
+    entry.is_embedded = true;
+    entry.embedded.assign(ads, ads + length);
+    entry.extents.push_back({toDevice(at.partition, at.block) + base + ea_length, length});
+    entry.complete = length == entry.size;
+    return true;
+  }
+  size_t ad_size = ad_type == 0 ? 8 : ad_type == 1 ? 16 : ad_type == 2 ? 20 : 0;
+  if (ad_size == 0)
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> continuation;
+  uint64_t remaining = entry.size;
+  size_t pos = 0;
+  for (unsigned hops = 0; remaining != 0;)
+  {
+    if (pos + ad_size > ad_length)
+    {
+      break;
+    }
+    const uint8_t* ad = ads + pos;
+    pos += ad_size;
+    uint32_t raw = loadLE32(ad);
+    uint32_t length = raw & AD_LENGTH_MASK;
+    uint32_t type = raw >> 30;
+    uint32_t block_number = loadLE32(ad + (ad_type == 2 ? 12 : 4));
+    uint16_t partition = ad_type == 0 ? at.partition : loadLE16(ad + (ad_type == 2 ? 16 : 8));
+    if (length == 0)
+    {
+      break;
+    }
+    if (type == AD_NEXT)
+    {
+      // The list continues in an allocation extent descriptor.
+      if (++hops > MAX_AD_HOPS || !readBlock({partition, block_number}, continuation) ||
+          !validTag(continuation.data(), continuation.size(), TAG_ALLOCATION_EXTENT))
+      {
+        entry.complete = false;
+        break;
+      }
+      uint64_t next_length = loadLE32(continuation.data() + 20);
+      if (24 + next_length > continuation.size())
+      {
+        entry.complete = false;
+        break;
+      }
+      ads = continuation.data() + 24;
+      ad_length = next_length;
+      pos = 0;
+      continue;
+    }
+    uint64_t used = std::min<uint64_t>(length, remaining);
+    if (type == AD_RECORDED)
+    {
+      addExtent(entry, partition, block_number, used);
+    }
+    remaining -= used;
+  }
+  if (remaining != 0)
+  {
+    entry.complete = false;
+  }
+  return true;
+}
+
+bool UdfVolume::readData(const Entry& entry, uint64_t limit, std::vector<uint8_t>& out)
+{
+  if (entry.is_embedded)
+  {
+    out = entry.embedded;
+    return true;
+  }
+  out.clear();
+  bool complete = entry.complete;
+  std::vector<uint8_t> piece;
+  for (const Extent& extent : entry.extents)
+  {
+    if (out.size() + extent.length > limit)
+    {
+      return false;
+    }
+    complete = reader_.readBytes(extent.offset, extent.length, piece) && complete;
+    out.insert(out.end(), piece.begin(), piece.end());
+  }
+  return complete;
+}
+
+// The VAT ICB is the last sector written in the session.
+bool UdfVolume::findVat(uint64_t& sector)
+{
+  uint64_t count = reader_.sectorCount();
+  std::vector<uint8_t> buffer(reader_.sectorSize());
+  for (uint64_t i = 1; i <= VAT_SCAN && i <= count; ++i)
+  {
+    uint64_t at = count - i;
+    if (!reader_.readSector(at, buffer.data()))
+    {
+      continue;
+    }
+    const uint8_t* d = buffer.data();
+    bool entry = validTag(d, buffer.size(), TAG_FILE_ENTRY) ||
+                 validTag(d, buffer.size(), TAG_EXTENDED_FILE_ENTRY);
+    if (entry && (d[27] == FILE_TYPE_VAT || d[27] == 0))
+    {
+      sector = at;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool UdfVolume::loadVat(size_t map, uint64_t sector, uint32_t& previous)
+{
+  PartitionMap& virt = maps_[map];
+  previous = VAT_UNUSED;
+  if (virt.physical == SIZE_MAX || maps_[virt.physical].start == UINT64_MAX ||
+      sector < maps_[virt.physical].start)
+  {
+    return false;
+  }
+  uint64_t block = (sector - maps_[virt.physical].start) * reader_.sectorSize() / block_size_;
+  Entry entry;
+  std::vector<uint8_t> data;
+  if (!readEntry({static_cast<uint16_t>(virt.physical), static_cast<uint32_t>(block)}, entry) ||
+      !readData(entry, MAX_VAT_BYTES, data))
+  {
+    return false;
+  }
+  size_t first = 0;
+  size_t end = data.size();
+  if (entry.file_type == FILE_TYPE_VAT)
+  {
+    // UDF 2.x: header length, implementation use length, ..., previous VAT at 132.
+    if (data.size() < 152 || loadLE16(data.data()) > data.size())
+    {
+      return false;
+    }
+    first = loadLE16(data.data());
+    previous = loadLE32(data.data() + 132);
+  }
+  else
+  {
+    // UDF 1.50: entries, then "*UDF Virtual Alloc Tbl" and the previous VAT ICB.
+    if (data.size() < VAT150_TRAILER ||
+        std::memcmp(data.data() + data.size() - VAT150_TRAILER + 1, "*UDF Virtual Alloc Tbl", 22) !=
+          0)
+    {
+      return false;
+    }
+    end = data.size() - VAT150_TRAILER;
+    previous = loadLE32(data.data() + data.size() - 4);
+  }
+  virt.vat.clear();
+  for (size_t pos = first; pos + 4 <= end; pos += 4)
+  {
+    virt.vat.push_back(loadLE32(data.data() + pos));
+  }
+  return true;
+}
+
+bool UdfVolume::rootDirectory(Location& root)
+{
+  std::vector<uint8_t> block;
+  if (!readBlock(file_set_, block) || !validTag(block.data(), block.size(), TAG_FILE_SET))
+  {
+    return false;
+  }
+  root = {loadLE16(block.data() + 400 + 8), loadLE32(block.data() + 400 + 4)};
+  return true;
+}
+
+void UdfVolume::walk(uint32_t session, std::vector<DiscFile>& out)
+{
+  struct Directory
+  {
+    Location at;
+    std::string path;
+    unsigned depth;
+    size_t entry;  // index in `out`, SIZE_MAX for the root
+  };
+
+  Location root;
+  if (!rootDirectory(root))
+  {
+    return;
+  }
+  std::unordered_set<uint64_t> visited;
+  std::deque<Directory> queue;
+  queue.push_back({root, std::string(), 0, SIZE_MAX});
+  visited.insert((static_cast<uint64_t>(root.partition) << 32) | root.block);
+
+  std::vector<uint8_t> data;
+  while (!queue.empty())
+  {
+    Directory dir = std::move(queue.front());
+    queue.pop_front();
+    Entry entry;
+    bool ok = readEntry(dir.at, entry) && readData(entry, MAX_DIRECTORY_BYTES, data);
+    if (!ok && dir.entry != SIZE_MAX)
+    {
+      out[dir.entry].damaged = true;
+    }
+    if (!ok && data.empty())
+    {
+      continue;
+    }
+
+    // Identifiers are 4-byte aligned; a bad tag is skipped one word at a time.
+    for (size_t pos = 0; pos + FID_HEADER <= data.size();)
+    {
+      const uint8_t* fid = data.data() + pos;
+      if (!validTag(fid, data.size() - pos, TAG_FILE_ID))
+      {
+        pos += 4;
+        continue;
+      }
+      uint8_t flags = fid[18];
+      size_t name_length = fid[19];
+      size_t iu_length = loadLE16(fid + 36);
+      size_t total = (FID_HEADER + iu_length + name_length + 3) & ~static_cast<size_t>(3);
+      if (pos + total > data.size())
+      {
+        break;
+      }
+      pos += total;
+      bool deleted = (flags & FID_DELETED) != 0;
+      if ((flags & FID_PARENT) != 0 || (deleted && !options_.include_deleted))
+      {
+        continue;
+      }
+      Location child = {loadLE16(fid + 20 + 8), loadLE32(fid + 20 + 4)};
+      DiscFile file;
+      file.path = dir.path + decodeIdentifier(fid + FID_HEADER + iu_length, name_length);
+      file.session = session;
+      file.deleted = deleted;
+      file.directory = (flags & FID_DIRECTORY) != 0;
+      Entry child_entry;
+      if (!readEntry(child, child_entry))
+      {
+        if (!deleted)
+        {
+          file.damaged = true;
+          out.push_back(std::move(file));
+        }
+        continue;
+      }
+      file.directory = file.directory || child_entry.file_type == FILE_TYPE_DIRECTORY;
+      file.size = child_entry.size;
+      file.extents = std::move(child_entry.extents);
+      file.damaged = !child_entry.complete;
+      out.push_back(std::move(file));
+      uint64_t key = (static_cast<uint64_t>(child.partition) << 32) | child.block;
+      if (out.back().directory && !deleted && dir.depth + 1 < MAX_DEPTH &&
+          visited.insert(key).second)
+      {
+        queue.push_back({child, out.back().path + "/", dir.depth + 1, out.size() - 1});
+      }
+    }
+  }
+}
+
+bool UdfVolume::load()
+{
+  uint64_t main = 0;
+  uint64_t reserve = 0;
+  uint32_t main_length = 0;
+  uint32_t reserve_length = 0;
+  if (!findAnchor(main, main_length, reserve, reserve_length))
+  {
+    return false;
+  }
+  if (!readSequence(main, main_length) && !readSequence(reserve, reserve_length))
+  {
+    return false;
+  }
+  return buildMaps();
+}
+
+std::string dedupKey(const DiscFile& file)
+{
+  if (file.directory || file.extents.empty())
+  {
+    return (file.directory ? "d:" : "f:") + file.path;
+  }
+  return std::to_string(file.extents.front().offset) + ":" + std::to_string(file.size);
+}
+
+void UdfVolume::run()
+{
+  size_t virtual_map = SIZE_MAX;
+  for (size_t i = 0; i < maps_.size(); ++i)
+  {
+    if (maps_[i].kind == MapKind::Virtual)
+    {
+      virtual_map = i;
+    }
+  }
+
+  // Write-once media: one tree per VAT generation, newest first.
+  std::vector<uint64_t> generations;
+  uint64_t sector = 0;
+  if (virtual_map != SIZE_MAX && findVat(sector))
+  {
+    const PartitionMap& physical = maps_[maps_[virtual_map].physical];
+    for (unsigned g = 0; g < options_.max_vat_generations; ++g)
+    {
+      generations.push_back(sector);
+      uint32_t previous = VAT_UNUSED;
+      if (!loadVat(virtual_map, sector, previous) || previous == VAT_UNUSED)
+      {
+        break;
+      }
+      uint64_t next = physical.start + static_cast<uint64_t>(previous) * block_size_ /
+                                         reader_.sectorSize();
+      if (next >= sector)
+      {
+        break;  // generations only go backwards
+      }
+      sector = next;
+    }
+  }
+
+  std::unordered_set<std::string> seen;
+  auto merge = [&](std::vector<DiscFile>& files)
+  {
+    for (DiscFile& file : files)
+    {
+      if (seen.insert(dedupKey(file)).second)
+      {
+        index_.files.push_back(std::move(file));
+      }
+    }
+  };
+  if (generations.empty())
+  {
+    std::vector<DiscFile> files;
+    walk(0, files);
+    merge(files);
+    index_.sessions.push_back(0);
+  }
+  for (size_t g = 0; g < generations.size(); ++g)
+  {
+    uint32_t previous = VAT_UNUSED;
+    std::vector<DiscFile> files;
+    if (loadVat(virtual_map, generations[g], previous))
+    {
+      walk(static_cast<uint32_t>(generations.size() - 1 - g), files);
+      merge(files);
+    }
+  }
+  index_.sessions.insert(index_.sessions.end(), generations.rbegin(), generations.rend());
+  index_.unreadable_sectors = reader_.unreadable();
+}
+
+}  // namespace
+
+bool probeUdf(DiscReader& reader)
+{
+  uint64_t count = reader.sectorCount();
+  std::vector<uint8_t> sector(reader.sectorSize());
+  for (uint64_t at : {uint64_t(256), count > 256 ? count - 256 : 0, count > 0 ? count - 1 : 0})
+  {
+    if (at != 0 && reader.readSector(at, sector.data()) &&
+        validTag(sector.data(), sector.size(), TAG_ANCHOR) && loadLE32(sector.data() + 12) == at)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool indexUdf(DiscReader& reader, DiscIndex& index, const UdfOptions& options)
+{
+  UdfVolume volume(reader, options, index);
+  if (!volume.load())
+  {
+    return false;
+  }
+  volume.run();
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,38 @@
+// RecoverySoftNetz — UDF 1.02–2.60 parser
+//
+// Follows the anchor (sector 256, N-256 or N-1) to the volume descriptor
+// sequence, reserve copy included, and builds the partition maps:
+//   - type 1 physical partitions;
+//   - sparable partitions (relocated packets remapped through the sparing
+//     table);
+//   - virtual partitions on write-once media. Blocks are mapped through the
+//     VAT found at the end of the last session. Every VAT names its
+//     predecessor, so each earlier session's tree is indexed as well;
+//   - metadata partitions (UDF 2.50+), mapped through the metadata file's
+//     allocation descriptors, falling back to the mirror file when the main
+//     one is unreadable.
+// Directory streams are read whole and scanned for file identifiers. A
+// damaged identifier is skipped by resynchronising on the next valid tag.
+// Identifiers flagged deleted are kept in the index when their file entry
+// still parses.
+
+#pragma once
+
+#include "optical/disc_reader.h"
+
+namespace rsn
+{
+
+struct UdfOptions
+{
+  bool include_deleted = true;  // index deleted identifiers whose entry is intact
+  unsigned max_vat_generations = 64;
+};
+
+/// Index the volume. False when no anchor or logical volume can be read.
+bool indexUdf(DiscReader& reader, DiscIndex& index, const UdfOptions& options = UdfOptions());
+
+/// True when a valid anchor volume descriptor pointer is found.
+bool probeUdf(DiscReader& reader);
+
+}  // namespace rsn
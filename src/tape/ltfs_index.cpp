@@ -0,0 +1,615 @@
+// RecoverySoftNetz — LTFS label and index parser
+
+#include "tape/ltfs_index.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t VOL1_SIZE = 80;
+constexpr size_t VOL1_IMPLEMENTATION = 24;
+constexpr size_t MAX_LABEL_BYTES = 1u << 20;
+constexpr uint64_t MAX_INDEX_BYTES = 1ull << 30;
+constexpr size_t INDEX_SNIFF = 512;
+
+/// Minimal pull parser for the subset of XML that LTFS writes: elements,
+/// attributes, text, entity and character references, CDATA, comments and
+/// processing instructions. No DTDs, no namespaces.
+class XmlReader
+{
+public:
+  enum class Kind
+  {
+    Open,
+    Close,
+    Text,
+  };
+
+  XmlReader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+  /// Next event; false at the end of input or on malformed markup.
+  bool next(Kind& kind, std::string& name, std::string& value)
+  {
+    if (pending_close_)
+    {
+      pending_close_ = false;
+      kind = Kind::Close;
+      name = last_open_;
+      return true;
+    }
+    while (p_ < end_)
+    {
+      if (*p_ != '<')
+      {
+        const char* start = p_;
+        while (p_ < end_ && *p_ != '<')
+        {
+          ++p_;
+        }
+        if (!decode(start, p_, value))
+        {
+          return false;
+        }
+        kind = Kind::Text;
+        return true;
+      }
+      if (startsWith("<?"))
+      {
+        if (!skipPast("?>"))
+        {
+          return false;
+        }
+      }
+      else if (startsWith("<!--"))
+      {
+        if (!skipPast("-->"))
+        {
+          return false;
+        }
+      }
+      else if (startsWith("<![CDATA["))
+      {
+        const char* start = p_ + 9;
+        if (!skipPast("]]>"))
+        {
+          return false;
+        }
+        value.assign(start, p_ - 3);
+        kind = Kind::Text;
+        return true;
+      }
+      else if (startsWith("<!"))
+      {
+        if (!skipPast(">"))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        return tag(kind, name, value);
+      }
+    }
+    return false;
+  }
+
+private:
+  bool startsWith(const char* lit) const
+  {
+    size_t n = std::strlen(lit);
+    return static_cast<size_t>(end_ - p_) >= n && std::memcmp(p_, lit, n) == 0;
+  }
+
+  bool skipPast(const char* lit)
+  {
+    size_t n = std::strlen(lit);
+    for (const char* q = p_; q + n <= end_; ++q)
+    {
+      if (std::memcmp(q, lit, n) == 0)
+      {
+        p_ = q + n;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // `value` receives the raw attribute text of an opening tag.
+  bool tag(Kind& kind, std::string& name, std::string& value)
+  {
+    ++p_;
+    bool closing = p_ < end_ && *p_ == '/';
+    if (closing)
+    {
+      ++p_;
+    }
+    const char* start = p_;
+    while (p_ < end_ && *p_ != '>' && *p_ != '/' && !isSpace(*p_))
+    {
+      ++p_;
+    }
+    name.assign(start, p_);
+    const char* attrs = p_;
+    char quote = 0;
+    while (p_ < end_ && (quote != 0 || *p_ != '>'))
+    {
+      if (quote == 0 && (*p_ == '"' || *p_ == '\''))
+      {
+        quote = *p_;
+      }
+      else if (*p_ == quote)
+      {
+        quote = 0;
+      }
+      ++p_;
+    }
+    if (p_ == end_ || name.empty())
+    {
+      return false;
+    }
+    bool self_closing = !closing && p_ > attrs && p_[-1] == '/';
+    value.assign(attrs, self_closing ? p_ - 1 : p_);
+    ++p_;
+    kind = closing ? Kind::Close : Kind::Open;
+    if (self_closing)
+    {
+      pending_close_ = true;
+      last_open_ = name;
+    }
+    return true;
+  }
+
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+  static bool decode(const char* p, const char* end, std::string& out)
+  {
+    static const struct
+    {
+      const char* name;
+      char value;
+    } ENTITIES[] = {{"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}};
+
+    out.clear();
+    while (p < end)
+    {
+      if (*p != '&')
+      {
+        out += *p++;
+        continue;
+      }
+      const char* semi = static_cast<const char*>(std::memchr(p, ';', end - p));
+      if (semi == nullptr || semi - p > 10)
+      {
+        return false;
+      }
+      std::string ref(p + 1, semi);
+      p = semi + 1;
+      if (!ref.empty() && ref[0] == '#')
+      {
+        bool hex = ref.size() > 1 && (ref[1] == 'x' || ref[1] == 'X');
+        char* stop = nullptr;
+        unsigned long cp = std::strtoul(ref.c_str() + (hex ? 2 : 1), &stop, hex ? 16 : 10);
+        if (stop == nullptr || *stop != '\0' || cp == 0 || cp > 0x10FFFF)
+        {
+          return false;
+        }
+        appendUtf8(out, static_cast<uint32_t>(cp));
+        continue;
+      }
+      bool known = false;
+      for (const auto& entity : ENTITIES)
+      {
+        if (ref == entity.name)
+        {
+          out += entity.value;
+          known = true;
+          break;
+        }
+      }
+      if (!known)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const char* p_;
+  const char* end_;
+  bool pending_close_ = false;
+  std::string last_open_;
+};
+
+bool parseUnsigned(const std::string& text, uint64_t& out)
+{
+  size_t i = 0;
+  size_t n = text.size();
+  while (i < n && (text[i] == ' ' || text[i] == '\n' || text[i] == '\r' || text[i] == '\t'))
+  {
+    ++i;
+  }
+  while (n > i && (text[n - 1] == ' ' || text[n - 1] == '\n' || text[n - 1] == '\r' ||
+                   text[n - 1] == '\t'))
+  {
+    --n;
+  }
+  if (i == n)
+  {
+    return false;
+  }
+  uint64_t value = 0;
+  for (; i < n; ++i)
+  {
+    if (text[i] < '0' || text[i] > '9' || value > (UINT64_MAX - 9) / 10)
+    {
+      return false;
+    }
+    value = value * 10 + static_cast<uint64_t>(text[i] - '0');
+  }
+  out = value;
+  return true;
+}
+
+char parsePartition(const std::string& text)
+{
+  for (char c : text)
+  {
+    if (c >= 'a' && c <= 'z')
+    {
+      return c;
+    }
+  }
+  return 0;
+}
+
+int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// LTFS 2.4 percent-encodes names that XML 1.0 cannot carry.
+std::string percentDecode(const std::string& text)
+{
+  std::string out;
+  for (size_t i = 0; i < text.size(); ++i)
+  {
+    int hi = i + 2 < text.size() ? hexValue(text[i + 1]) : -1;
+    int lo = hi >= 0 ? hexValue(text[i + 2]) : -1;
+    if (text[i] == '%' && lo >= 0)
+    {
+      out += static_cast<char>(hi * 16 + lo);
+      i += 2;
+    }
+    else
+    {
+      out += text[i];
+    }
+  }
+  return out;
+}
+
+// One path component; names from a damaged index must not escape the root.
+std::string safeComponent(std::string name)
+{
+  for (char& c : name)
+  {
+    if (c == '/' || c == '\\' || c == '\0')
+    {
+      c = '_';
+    }
+  }
+  if (name.empty() || name == "." || name == "..")
+  {
+    name.insert(0, "_");
+  }
+  return name;
+}
+
+bool readTapeFile(TapeImageDevice& tape, const TapeFile& file, size_t limit,
+                  std::vector<uint8_t>& out)
+{
+  if (file.length > limit)
+  {
+    return false;
+  }
+  out.resize(static_cast<size_t>(file.length));
+  return tape.read(file.offset, out.data(), out.size()) == out.size();
+}
+
+}  // namespace
+
+bool parseLtfsLabel(const char* xml, size_t size, LtfsLabel& label)
+{
+  XmlReader reader(xml, size);
+  XmlReader::Kind kind;
+  std::string name;
+  std::string value;
+  std::string text;
+  std::vector<std::string> stack;
+  label = LtfsLabel();
+  while (reader.next(kind, name, value))
+  {
+    if (kind == XmlReader::Kind::Open)
+    {
+      if (stack.empty() && name != "ltfslabel")
+      {
+        return false;
+      }
+      stack.push_back(name);
+      text.clear();
+      continue;
+    }
+    if (kind == XmlReader::Kind::Text)
+    {
+      text += value;
+      continue;
+    }
+    if (stack.empty() || stack.back() != name)
+    {
+      return false;
+    }
+    const std::string parent = stack.size() >= 2 ? stack[stack.size() - 2] : std::string();
+    uint64_t number = 0;
+    if (parent == "ltfslabel" && name == "volumeuuid")
+    {
+      label.volume_uuid = text;
+    }
+    else if (parent == "ltfslabel" && name == "blocksize" && parseUnsigned(text, number) &&
+             number <= UINT32_MAX)
+    {
+      label.block_size = static_cast<uint32_t>(number);
+    }
+    else if (parent == "location" && name == "partition")
+    {
+      label.partition = parsePartition(text);
+    }
+    else if (parent == "partitions" && name == "index")
+    {
+      label.index_partition = parsePartition(text);
+    }
+    else if (parent == "partitions" && name == "data")
+    {
+      label.data_partition = parsePartition(text);
+    }
+    stack.pop_back();
+    text.clear();
+    if (stack.empty())
+    {
+      return label.block_size != 0 && label.data_partition != 0;
+    }
+  }
+  return false;
+}
+
+bool parseLtfsIndex(const char* xml, size_t size, LtfsIndex& index)
+{
+  XmlReader reader(xml, size);
+  XmlReader::Kind kind;
+  std::string name;
+  std::string value;
+  std::string text;
+  std::vector<std::string> stack;
+  std::vector<std::string> dirs;  // directory names, root first
+  LtfsFile file;
+  LtfsExtent extent;
+  bool percent_encoded = false;
+  index = LtfsIndex();
+
+  while (reader.next(kind, name, value))
+  {
+    if (kind == XmlReader::Kind::Open)
+    {
+      if (stack.empty() && name != "ltfsindex")
+      {
+        return false;
+      }
+      if (name == "directory")
+      {
+        dirs.emplace_back();
+      }
+      else if (name == "file")
+      {
+        file = LtfsFile();
+      }
+      else if (name == "extent")
+      {
+        extent = LtfsExtent();
+      }
+      else if (name == "name")
+      {
+        percent_encoded = value.find("percentencoded=\"true\"") != std::string::npos ||
+                          value.find("percentencoded='true'") != std::string::npos;
+      }
+      stack.push_back(name);
+      text.clear();
+      continue;
+    }
+    if (kind == XmlReader::Kind::Text)
+    {
+      text += value;
+      continue;
+    }
+    if (stack.empty() || stack.back() != name)
+    {
+      return false;
+    }
+    const std::string parent = stack.size() >= 2 ? stack[stack.size() - 2] : std::string();
+    uint64_t number = 0;
+    if (name == "name")
+    {
+      std::string decoded = percent_encoded ? percentDecode(text) : text;
+      if (parent == "directory" && !dirs.empty())
+      {
+        dirs.back() = decoded;
+      }
+      else if (parent == "file")
+      {
+        file.path = safeComponent(decoded);
+      }
+    }
+    else if (parent == "file")
+    {
+      if (name == "length" && parseUnsigned(text, number))
+      {
+        file.length = number;
+      }
+      else if (name == "fileuid" && parseUnsigned(text, number))
+      {
+        file.uid = number;
+      }
+      else if (name == "symlink")
+      {
+        file.symlink = text;
+      }
+    }
+    else if (parent == "extent")
+    {
+      bool ok = true;
+      if (name == "partition")
+      {
+        extent.partition = parsePartition(text);
+      }
+      else if (name == "startblock")
+      {
+        ok = parseUnsigned(text, extent.start_block);
+      }
+      else if (name == "byteoffset")
+      {
+        ok = parseUnsigned(text, extent.byte_offset);
+      }
+      else if (name == "bytecount")
+      {
+        ok = parseUnsigned(text, extent.byte_count);
+      }
+      else if (name == "fileoffset")
+      {
+        ok = parseUnsigned(text, extent.file_offset);
+      }
+      if (!ok)
+      {
+        return false;
+      }
+    }
+    else if (name == "extent")
+    {
+      if (extent.partition != 0 && extent.byte_count != 0)
+      {
+        file.extents.push_back(extent);
+      }
+    }
+    else if (name == "file")
+    {
+      std::string path;
+      for (size_t i = 1; i < dirs.size(); ++i)
+      {
+        path += safeComponent(dirs[i]);
+        path += '/';
+      }
+      file.path = path + (file.path.empty() ? safeComponent(std::string()) : file.path);
+      index.files.push_back(std::move(file));
+      file = LtfsFile();
+    }
+    else if (name == "directory")
+    {
+      if (!dirs.empty())
+      {
+        dirs.pop_back();
+      }
+    }
+    else if (parent == "ltfsindex")
+    {
+      if (name == "volumeuuid")
+      {
+        index.volume_uuid = text;
+      }
+      else if (name == "generationnumber" && !parseUnsigned(text, index.generation))
+      {
+        return false;
+      }
+    }
+    else if (parent == "location" && stack.size() == 3)
+    {
+      if (name == "partition")
+      {
+        index.partition = parsePartition(text);
+      }
+      else if (name == "startblock" && !parseUnsigned(text, index.start_block))
+      {
+        return false;
+      }
+    }
+    stack.pop_back();
+    text.clear();
+    if (stack.empty())
+    {
+      return index.generation != 0;
+    }
+  }
+  return false;  // truncated document
+}
+
+bool readLtfsLabel(TapeImageDevice& partition, LtfsLabel& label)
+{
+  const std::vector<TapeFile>& files = partition.files();
+  if (files.size() < 2)
+  {
+    return false;
+  }
+  uint8_t vol1[VOL1_SIZE];
+  if (files[0].length < VOL1_SIZE ||
+      partition.read(files[0].offset, vol1, sizeof(vol1)) != sizeof(vol1) ||
+      std::memcmp(vol1, "VOL1", 4) != 0 || std::memcmp(vol1 + VOL1_IMPLEMENTATION, "LTFS", 4) != 0)
+  {
+    return false;
+  }
+  std::vector<uint8_t> xml;
+  return readTapeFile(partition, files[1], MAX_LABEL_BYTES, xml) &&
+         parseLtfsLabel(reinterpret_cast<const char*>(xml.data()), xml.size(), label);
+}
+
+bool findLatestLtfsIndex(TapeImageDevice& partition, LtfsIndex& index)
+{
+  const std::vector<TapeFile>& files = partition.files();
+  static const char MARKER[] = "<ltfsindex";
+  std::vector<uint8_t> xml;
+  for (size_t i = files.size(); i-- > 0;)
+  {
+    uint8_t head[INDEX_SNIFF];
+    size_t got = partition.read(files[i].offset, head,
+                                static_cast<size_t>(std::min<uint64_t>(sizeof(head),
+                                                                       files[i].length)));
+    ByteView view(head, got);
+    if (!view.startsWith("<?xml", 5) || findBytes(view, MARKER, sizeof(MARKER) - 1) == SIZE_MAX)
+    {
+      continue;
+    }
+    if (readTapeFile(partition, files[i], MAX_INDEX_BYTES, xml) &&
+        parseLtfsIndex(reinterpret_cast<const char*>(xml.data()), xml.size(), index))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace rsn
@@ -0,0 +1,72 @@
+// RecoverySoftNetz — LTFS label and index parser
+//
+// An LTFS volume spans two tape partitions, a small index partition and a
+// data partition. Each starts with an ANSI VOL1 label and an XML LTFS label
+// in tape files 0 and 1. Every index generation is an XML document written
+// as a tape file of its own, so the newest readable one sits at the end of a
+// partition. It lists each file's extents as (partition, start block, byte
+// offset, byte count, file offset). Block numbers count filemarks, the way
+// the drive reports positions, so they map straight onto
+// TapeImageDevice::blockOffset.
+
+#pragma once
+
+#include "tape/tape_image.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+struct LtfsLabel
+{
+  std::string volume_uuid;
+  uint32_t block_size = 0;
+  char partition = 0;        // partition this label was read from
+  char index_partition = 0;
+  char data_partition = 0;
+};
+
+struct LtfsExtent
+{
+  char partition = 0;
+  uint64_t start_block = 0;
+  uint64_t byte_offset = 0;  // into the start block
+  uint64_t byte_count = 0;
+  uint64_t file_offset = 0;
+};
+
+struct LtfsFile
+{
+  std::string path;          // relative to the volume root, '/' separated
+  uint64_t length = 0;
+  uint64_t uid = 0;
+  std::string symlink;       // target when the entry is a symbolic link
+  std::vector<LtfsExtent> extents;
+};
+
+struct LtfsIndex
+{
+  std::string volume_uuid;
+  uint64_t generation = 0;
+  char partition = 0;        // where this index generation was written
+  uint64_t start_block = 0;
+  std::vector<LtfsFile> files;
+};
+
+/// Parse an <ltfslabel> document.
+bool parseLtfsLabel(const char* xml, size_t size, LtfsLabel& label);
+
+/// Parse an <ltfsindex> document. Directories are flattened into paths.
+bool parseLtfsIndex(const char* xml, size_t size, LtfsIndex& index);
+
+/// Read the VOL1 and LTFS labels at the start of one partition image.
+bool readLtfsLabel(TapeImageDevice& partition, LtfsLabel& label);
+
+/// Newest index generation stored on one partition image, searching tape
+/// files from the end. False when no index document parses.
+bool findLatestLtfsIndex(TapeImageDevice& partition, LtfsIndex& index);
+
+}  // namespace rsn
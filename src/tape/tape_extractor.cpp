@@ -0,0 +1,231 @@
+// RecoverySoftNetz — single-pass extraction from tape images
+
+#include "tape/tape_extractor.h"
+
+#include "tape/tar_stream.h"
+
+#include <algorithm>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t READ_SIZE = 1u << 20;
+
+struct ExtentPiece
+{
+  size_t slot;          // index into the partition list
+  uint64_t offset;      // tape stream offset
+  uint64_t length;
+  uint64_t block;       // start block, for damage accounting
+  size_t file;
+  uint64_t file_offset;
+};
+
+}  // namespace
+
+void TapeExtractor::countDamaged(const TapeImageDevice& tape, uint64_t block, uint64_t offset,
+                                 uint64_t length)
+{
+  const std::vector<TapeObject>& objects = tape.objects();
+  for (uint64_t i = block; i < objects.size() && objects[i].stream_offset < offset + length; ++i)
+  {
+    if (objects[i].damaged)
+    {
+      ++stats_.damaged_blocks;
+    }
+  }
+}
+
+void TapeExtractor::record(const char* type, const char* source, const std::string& path,
+                           uint64_t size, std::vector<Extent> extents, bool complete)
+{
+  ++stats_.files;
+  if (registry_ == nullptr)
+  {
+    return;
+  }
+  RecoveredFile file;
+  file.type = type;
+  file.source = source;
+  file.offset = extents.empty() ? 0 : extents.front().offset;
+  file.size = size;
+  file.confidence = complete ? 1.0 : 0.5;
+  file.description = path;
+  if (extents.size() > 1 || (extents.size() == 1 && extents.front().length != size))
+  {
+    file.extents = std::move(extents);
+  }
+  registry_->add(std::move(file));
+}
+
+bool TapeExtractor::extractLtfs(const std::vector<TapePartition>& partitions)
+{
+  LtfsIndex best;
+  bool found = false;
+  for (const TapePartition& partition : partitions)
+  {
+    LtfsIndex index;
+    if (partition.device != nullptr && findLatestLtfsIndex(*partition.device, index) &&
+        (!found || index.generation > best.generation))
+    {
+      best = std::move(index);
+      found = true;
+    }
+  }
+  return found && extractLtfs(best, partitions);
+}
+
+bool TapeExtractor::extractLtfs(const LtfsIndex& index,
+                                const std::vector<TapePartition>& partitions)
+{
+  std::vector<ExtentPiece> pieces;
+  std::vector<std::vector<Extent>> extents(index.files.size());
+  std::vector<char> complete(index.files.size(), 1);
+  for (size_t i = 0; i < index.files.size(); ++i)
+  {
+    const LtfsFile& file = index.files[i];
+    if (!file.symlink.empty())
+    {
+      continue;
+    }
+    for (const LtfsExtent& extent : file.extents)
+    {
+      auto it = std::find_if(partitions.begin(), partitions.end(),
+                             [&](const TapePartition& p)
+                             { return p.id == extent.partition && p.device != nullptr; });
+      uint64_t base = it != partitions.end() ? it->device->blockOffset(extent.start_block)
+                                             : UINT64_MAX;
+      uint64_t size = it != partitions.end() ? it->device->size() : 0;
+      if (base == UINT64_MAX || base + extent.byte_offset >= size)
+      {
+        stats_.missing_bytes += extent.byte_count;
+        complete[i] = 0;
+        continue;
+      }
+      uint64_t start = base + extent.byte_offset;
+      uint64_t length = std::min(extent.byte_count, size - start);
+      if (length != extent.byte_count)
+      {
+        stats_.missing_bytes += extent.byte_count - length;
+        complete[i] = 0;
+      }
+      size_t slot = static_cast<size_t>(it - partitions.begin());
+      pieces.push_back({slot, start, length, extent.start_block, i, extent.file_offset});
+      extents[i].push_back({start, length});
+    }
+    if (file.extents.empty() && !sink_(file.path, 0, nullptr, 0))
+    {
+      return false;
+    }
+  }
+
+  // One ascending sweep per partition.
+  std::sort(pieces.begin(), pieces.end(),
+            [](const ExtentPiece& a, const ExtentPiece& b)
+            { return a.slot != b.slot ? a.slot < b.slot : a.offset < b.offset; });
+  buffer_.resize(READ_SIZE);
+  for (const ExtentPiece& piece : pieces)
+  {
+    TapeImageDevice& tape = *partitions[piece.slot].device;
+    const std::string& path = index.files[piece.file].path;
+    countDamaged(tape, piece.block, piece.offset, piece.length);
+    uint64_t done = 0;
+    while (done < piece.length)
+    {
+      size_t want = static_cast<size_t>(std::min<uint64_t>(READ_SIZE, piece.length - done));
+      size_t got = tape.read(piece.offset + done, buffer_.data(), want);
+      if (got != 0 && !sink_(path, piece.file_offset + done, buffer_.data(), got))
+      {
+        return false;
+      }
+      stats_.bytes += got;
+      done += got;
+      if (got != want)
+      {
+        stats_.missing_bytes += piece.length - done;
+        complete[piece.file] = 0;
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < index.files.size(); ++i)
+  {
+    const LtfsFile& file = index.files[i];
+    if (file.symlink.empty())
+    {
+      record("tape/ltfs", "ltfs", file.path, file.length, std::move(extents[i]),
+             complete[i] != 0);
+    }
+    else
+    {
+      record("tape/ltfs_symlink", "ltfs", file.path + " -> " + file.symlink, 0, {}, true);
+    }
+  }
+  return true;
+}
+
+bool TapeExtractor::extractTar(TapeImageDevice& tape)
+{
+  buffer_.resize(READ_SIZE);
+  for (const TapeFile& file : tape.files())
+  {
+    uint8_t head[TAR_RECORD_SIZE];
+    if (file.length < TAR_RECORD_SIZE ||
+        tape.read(file.offset, head, sizeof(head)) != sizeof(head) || !isTarHeader(head))
+    {
+      continue;
+    }
+    countDamaged(tape, file.first_block, file.offset, file.length);
+
+    bool ok = true;
+    TarStreamReader reader(
+      file.offset,
+      [&](const TarEntry& entry, uint64_t offset, const uint8_t* data, size_t size)
+      {
+        stats_.bytes += size;
+        return sink_(entry.path, offset, data, size);
+      },
+      [&](const TarEntry& entry, bool complete)
+      {
+        if (!entry.isRegular())
+        {
+          return;
+        }
+        if (entry.size == 0)
+        {
+          ok = sink_(entry.path, 0, nullptr, 0) && ok;
+        }
+        record("archive/tar", "tape", entry.path, entry.size, {{entry.data_offset, entry.size}},
+               complete);
+      });
+    uint64_t pos = 0;
+    while (pos < file.length && ok)
+    {
+      size_t want = static_cast<size_t>(std::min<uint64_t>(READ_SIZE, file.length - pos));
+      size_t got = tape.read(file.offset + pos, buffer_.data(), want);
+      if (!reader.feed(buffer_.data(), got))
+      {
+        return false;
+      }
+      pos += got;
+      if (got != want)
+      {
+        stats_.missing_bytes += file.length - pos;
+        break;
+      }
+    }
+    reader.finish();
+    stats_.resync_bytes += reader.resyncBytes();
+    if (!ok)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace rsn
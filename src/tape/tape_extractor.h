@@ -0,0 +1,81 @@
+// RecoverySoftNetz — single-pass extraction from tape images
+//
+// Pulls files off tape images in one ascending sweep of each stream, so a
+// real drive (or a dump on slow storage) is never asked to seek backwards:
+//   - LTFS: the newest index is located first, on the index partition or at
+//     the end of the data partition. Every extent is then sorted by
+//     partition and block and copied in that order, each piece landing at
+//     its file offset;
+//   - tar: every tape file whose first record is a valid tar header is
+//     streamed through TarStreamReader.
+// Extracted files are recorded in the registry as well. Their offsets and
+// extents are positions in the tape stream (TapeImageDevice offsets).
+
+#pragma once
+
+#include "core/file_registry.h"
+#include "tape/ltfs_index.h"
+#include "tape/tape_image.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+/// Receives extracted file data. LTFS places extents by block, not by file
+/// offset, so the pieces of one file can arrive out of order. An empty file
+/// is announced with a single zero-length call. Returns false to abort.
+using TapeFileSink = std::function<bool(const std::string& path, uint64_t file_offset,
+                                        const uint8_t* data, size_t size)>;
+
+struct TapePartition
+{
+  char id = 0;                        // LTFS partition letter ('a', 'b')
+  TapeImageDevice* device = nullptr;  // not owned
+};
+
+struct TapeExtractStats
+{
+  uint64_t files = 0;
+  uint64_t bytes = 0;
+  uint64_t missing_bytes = 0;   // extent bytes beyond the captured stream, or unreadable
+  uint64_t damaged_blocks = 0;  // blocks read that the capture flagged as damaged
+  uint64_t resync_bytes = 0;    // tar records skipped while resynchronising
+};
+
+class TapeExtractor
+{
+public:
+  explicit TapeExtractor(TapeFileSink sink, FileRegistry* registry = nullptr)
+    : sink_(std::move(sink)), registry_(registry)
+  {
+  }
+
+  /// Find the newest index across `partitions` and extract it. False when no
+  /// index is found or the sink aborts.
+  bool extractLtfs(const std::vector<TapePartition>& partitions);
+
+  /// Extract the files of `index`; extents on partitions not supplied are
+  /// counted as missing.
+  bool extractLtfs(const LtfsIndex& index, const std::vector<TapePartition>& partitions);
+
+  /// Stream every tar archive that starts a tape file. False when the sink aborts.
+  bool extractTar(TapeImageDevice& tape);
+
+  const TapeExtractStats& stats() const { return stats_; }
+
+private:
+  void countDamaged(const TapeImageDevice& tape, uint64_t block, uint64_t offset,
+                    uint64_t length);
+  void record(const char* type, const char* source, const std::string& path, uint64_t size,
+              std::vector<Extent> extents, bool complete);
+
+  TapeFileSink sink_;
+  FileRegistry* registry_;
+  std::vector<uint8_t> buffer_;
+  TapeExtractStats stats_;
+};
+
+}  // namespace rsn
@@ -0,0 +1,303 @@
+// RecoverySoftNetz — tape image device
+
+#include "tape/tape_image.h"
+
+#include "common/utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr uint32_t SIMH_EOM = 0xFFFFFFFFu;
+constexpr uint32_t SIMH_GAP = 0xFFFFFFFEu;       // erase gap, one word
+constexpr uint32_t SIMH_HALF_GAP = 0xFFFEFFFFu;  // erase gap, half a word
+constexpr uint32_t SIMH_LENGTH_MASK = 0x0FFFFFFFu;
+constexpr uint32_t SIMH_CLASS_GOOD = 0x0;
+constexpr uint32_t SIMH_CLASS_BAD = 0x8;
+
+constexpr uint8_t AWS_NEW_RECORD = 0x80;
+constexpr uint8_t AWS_TAPEMARK = 0x40;
+constexpr uint8_t AWS_END_RECORD = 0x20;
+constexpr size_t AWS_HEADER_SIZE = 6;
+
+constexpr size_t FRAMING_WINDOW = 1u << 20;
+
+// SIMH classes 7 and F are markers with no payload or trailing length.
+bool simhHasPayload(uint32_t cls)
+{
+  return cls != 0x7 && cls != 0xF;
+}
+
+/// Small reads of the framing words, served from one cached window.
+class FramingReader
+{
+public:
+  explicit FramingReader(Device& device) : device_(device), window_(FRAMING_WINDOW) {}
+
+  bool load(uint64_t offset, void* out, size_t length)
+  {
+    if (offset < base_ || offset + length > base_ + valid_)
+    {
+      base_ = offset;
+      valid_ = device_.read(offset, window_.data(), window_.size());
+      if (length > valid_)
+      {
+        return false;
+      }
+    }
+    std::memcpy(out, window_.data() + (offset - base_), length);
+    return true;
+  }
+
+private:
+  Device& device_;
+  std::vector<uint8_t> window_;
+  uint64_t base_ = 0;
+  size_t valid_ = 0;
+};
+
+}  // namespace
+
+std::unique_ptr<TapeImageDevice> TapeImageDevice::open(Device& image, TapeFormat format)
+{
+  std::unique_ptr<TapeImageDevice> device(new TapeImageDevice(image));
+  if (format == TapeFormat::Simh || format == TapeFormat::Aws)
+  {
+    device->format_ = format;
+    bool ok = format == TapeFormat::Simh ? device->indexSimh() : device->indexAws();
+    return ok ? std::move(device) : nullptr;
+  }
+
+  // Both layouts are cheap to reject: the first malformed header ends the
+  // attempt. Prefer a clean parse, then whichever indexed more objects.
+  std::unique_ptr<TapeImageDevice> aws(new TapeImageDevice(image));
+  bool simh_ok = device->indexSimh();
+  bool aws_ok = aws->indexAws();
+  if (simh_ok && aws_ok)
+  {
+    if (device->truncated_ != aws->truncated_)
+    {
+      aws_ok = device->truncated_;
+      simh_ok = !aws_ok;
+    }
+    else
+    {
+      simh_ok = device->objects_.size() >= aws->objects_.size();
+      aws_ok = !simh_ok;
+    }
+  }
+  if (simh_ok)
+  {
+    device->format_ = TapeFormat::Simh;
+    return device;
+  }
+  if (aws_ok)
+  {
+    aws->format_ = TapeFormat::Aws;
+    return aws;
+  }
+  return nullptr;
+}
+
+void TapeImageDevice::addPiece(uint64_t image_offset, uint32_t length)
+{
+  if (length == 0)
+  {
+    return;
+  }
+  pieces_.push_back({size_, image_offset, length});
+  size_ += length;
+}
+
+void TapeImageDevice::addBlock(uint32_t length, bool damaged)
+{
+  TapeObject object;
+  object.stream_offset = size_ - length;
+  object.length = length;
+  object.damaged = damaged;
+  if (open_file_.block_count == 0)
+  {
+    open_file_.first_block = objects_.size();
+    open_file_.offset = object.stream_offset;
+  }
+  ++open_file_.block_count;
+  open_file_.length += length;
+  objects_.push_back(object);
+}
+
+void TapeImageDevice::addFilemark()
+{
+  TapeObject mark;
+  mark.stream_offset = size_;
+  mark.filemark = true;
+  objects_.push_back(mark);
+  closeFile();
+}
+
+void TapeImageDevice::closeFile()
+{
+  if (open_file_.block_count != 0)
+  {
+    files_.push_back(open_file_);
+  }
+  open_file_ = TapeFile();
+}
+
+bool TapeImageDevice::indexSimh()
+{
+  FramingReader reader(image_);
+  uint64_t end = image_.size();
+  uint64_t pos = 0;
+  while (pos < end)
+  {
+    uint8_t word[4];
+    if (!reader.load(pos, word, sizeof(word)))
+    {
+      truncated_ = true;
+      break;
+    }
+    uint32_t value = loadLE32(word);
+    if (value == SIMH_EOM)
+    {
+      break;
+    }
+    if (value == SIMH_HALF_GAP)
+    {
+      pos += 2;
+      continue;
+    }
+    pos += 4;
+    if (value == SIMH_GAP)
+    {
+      continue;
+    }
+    if (value == 0)
+    {
+      addFilemark();
+      continue;
+    }
+    uint32_t cls = value >> 28;
+    if (!simhHasPayload(cls))
+    {
+      continue;
+    }
+    uint32_t length = value & SIMH_LENGTH_MASK;
+    uint64_t padded = length + (length & 1u);
+    uint8_t trailer[4];
+    if (pos + padded + 4 > end || !reader.load(pos + padded, trailer, sizeof(trailer)) ||
+        loadLE32(trailer) != value)
+    {
+      truncated_ = true;
+      break;
+    }
+    if (cls == SIMH_CLASS_GOOD || cls == SIMH_CLASS_BAD)
+    {
+      addPiece(pos, length);
+      addBlock(length, cls == SIMH_CLASS_BAD);
+    }
+    pos += padded + 4;
+  }
+  closeFile();
+  return !objects_.empty();
+}
+
+bool TapeImageDevice::indexAws()
+{
+  FramingReader reader(image_);
+  uint64_t end = image_.size();
+  uint64_t pos = 0;
+  uint32_t previous = 0;
+  uint32_t block = 0;
+  bool in_block = false;
+  while (pos < end)
+  {
+    uint8_t header[AWS_HEADER_SIZE];
+    if (!reader.load(pos, header, sizeof(header)))
+    {
+      truncated_ = true;
+      break;
+    }
+    uint32_t length = loadLE16(header);
+    uint8_t flags = header[4];
+    bool known = (flags & ~(AWS_NEW_RECORD | AWS_TAPEMARK | AWS_END_RECORD)) == 0;
+    if (loadLE16(header + 2) != previous || !known || header[5] != 0 ||
+        pos + AWS_HEADER_SIZE + length > end)
+    {
+      truncated_ = true;
+      break;
+    }
+    if (in_block && (flags & (AWS_NEW_RECORD | AWS_TAPEMARK)) != 0)
+    {
+      addBlock(block, true);  // the previous block never saw its end flag
+      in_block = false;
+    }
+    if ((flags & AWS_TAPEMARK) != 0)
+    {
+      addFilemark();
+    }
+    else if (length != 0 || (flags & AWS_NEW_RECORD) != 0)
+    {
+      if (!in_block)
+      {
+        block = 0;
+        in_block = true;
+      }
+      addPiece(pos + AWS_HEADER_SIZE, length);
+      block += length;
+      if ((flags & AWS_END_RECORD) != 0)
+      {
+        addBlock(block, false);
+        in_block = false;
+      }
+    }
+    previous = length;
+    pos += AWS_HEADER_SIZE + length;
+  }
+  if (in_block)
+  {
+    addBlock(block, true);
+  }
+  closeFile();
+  return !objects_.empty();
+}
+
+uint64_t TapeImageDevice::blockOffset(uint64_t block) const
+{
+  return block < objects_.size() ? objects_[block].stream_offset : UINT64_MAX;
+}
+
+size_t TapeImageDevice::read(uint64_t offset, void* buffer, size_t length)
+{
+  if (offset >= size_ || length == 0)
+  {
+    return 0;
+  }
+  auto it = std::upper_bound(pieces_.begin(), pieces_.end(), offset,
+                             [](uint64_t value, const Piece& piece)
+                             { return value < piece.stream_offset; });
+  size_t index = static_cast<size_t>(it - pieces_.begin()) - 1;
+
+  auto* out = static_cast<uint8_t*>(buffer);
+  size_t done = 0;
+  while (done < length && index < pieces_.size())
+  {
+    const Piece& piece = pieces_[index];
+    uint64_t skip = offset + done - piece.stream_offset;
+    size_t want = static_cast<size_t>(std::min<uint64_t>(piece.length - skip, length - done));
+    size_t got = image_.read(piece.image_offset + skip, out + done, want);
+    done += got;
+    if (got != want)
+    {
+      break;
+    }
+    ++index;
+  }
+  return done;
+}
+
+}  // namespace rsn
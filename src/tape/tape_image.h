@@ -0,0 +1,101 @@
+// RecoverySoftNetz — tape image device
+//
+// Tape dumps keep the drive's framing: variable-length blocks separated by
+// filemarks. Two container layouts are understood:
+//   - SIMH .tap: LE32 length | data (padded to even) | LE32 length per block;
+//     a zero word is a filemark and 0xFFFFFFFF the end of medium. The top
+//     nibble of the length is the record class (8 = captured with an error);
+//   - AWSTAPE: 6-byte headers (LE16 segment length, LE16 previous length,
+//     flags) whose segments are joined into blocks, with a tapemark flag.
+// The device serves the concatenated block payloads, filemarks removed, as
+// one positional stream. The object table is kept so that LTFS block numbers,
+// which count filemarks as tape positions, map back to stream offsets.
+
+#pragma once
+
+#include "core/device.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+
+enum class TapeFormat : uint8_t
+{
+  Auto,
+  Simh,
+  Aws,
+};
+
+/// One logical tape object: a data block or a filemark.
+struct TapeObject
+{
+  uint64_t stream_offset = 0;  // payload start in the device stream (next payload for a mark)
+  uint32_t length = 0;         // payload bytes; 0 for a filemark
+  bool filemark = false;
+  bool damaged = false;        // the capture tool flagged a read error
+};
+
+/// Blocks between two filemarks.
+struct TapeFile
+{
+  uint64_t first_block = 0;  // object index of the first block
+  uint64_t block_count = 0;
+  uint64_t offset = 0;       // stream range
+  uint64_t length = 0;
+};
+
+class TapeImageDevice : public Device
+{
+public:
+  /// Index the framing of `image`. Returns nullptr when the format cannot be
+  /// recognised or not a single object parses; a torn tail is tolerated and
+  /// reported through `truncated()`.
+  static std::unique_ptr<TapeImageDevice> open(Device& image,
+                                               TapeFormat format = TapeFormat::Auto);
+
+  std::string name() const override { return image_.name() + " (tape)"; }
+  uint64_t size() const override { return size_; }
+  size_t read(uint64_t offset, void* buffer, size_t length) override;
+
+  TapeFormat format() const { return format_; }
+  const std::vector<TapeObject>& objects() const { return objects_; }
+  const std::vector<TapeFile>& files() const { return files_; }
+
+  /// Stream offset of logical object `block`; UINT64_MAX past the last one.
+  uint64_t blockOffset(uint64_t block) const;
+
+  /// Framing stopped on a malformed or incomplete record, not an end marker.
+  bool truncated() const { return truncated_; }
+
+private:
+  /// Contiguous run of payload bytes in the container.
+  struct Piece
+  {
+    uint64_t stream_offset;
+    uint64_t image_offset;
+    uint32_t length;
+  };
+
+  explicit TapeImageDevice(Device& image) : image_(image) {}
+
+  bool indexSimh();
+  bool indexAws();
+  void addPiece(uint64_t image_offset, uint32_t length);
+  void addBlock(uint32_t length, bool damaged);
+  void addFilemark();
+  void closeFile();
+
+  Device& image_;
+  TapeFormat format_ = TapeFormat::Auto;
+  std::vector<Piece> pieces_;
+  std::vector<TapeObject> objects_;
+  std::vector<TapeFile> files_;
+  TapeFile open_file_;
+  uint64_t size_ = 0;
+  bool truncated_ = false;
+};
+
+}  // namespace rsn
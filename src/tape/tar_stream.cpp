@@ -0,0 +1,363 @@
+// RecoverySoftNetz — streaming tar reader
+
+#include "tape/tar_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t NAME_OFFSET = 0;
+constexpr size_t NAME_SIZE = 100;
+constexpr size_t MODE_OFFSET = 100;
+constexpr size_t SIZE_OFFSET = 124;
+constexpr size_t MTIME_OFFSET = 136;
+constexpr size_t CHECKSUM_OFFSET = 148;
+constexpr size_t TYPE_OFFSET = 156;
+constexpr size_t LINK_OFFSET = 157;
+constexpr size_t MAGIC_OFFSET = 257;
+constexpr size_t PREFIX_OFFSET = 345;
+constexpr size_t PREFIX_SIZE = 155;
+
+constexpr size_t MAX_EXTENDED = 1u << 20;  // long names and pax records kept per member
+
+uint64_t paddingFor(uint64_t size)
+{
+  return (TAR_RECORD_SIZE - size % TAR_RECORD_SIZE) % TAR_RECORD_SIZE;
+}
+
+std::string field(const uint8_t* p, size_t size)
+{
+  const void* nul = std::memchr(p, 0, size);
+  size_t length = nul != nullptr ? static_cast<size_t>(static_cast<const uint8_t*>(nul) - p) : size;
+  return std::string(reinterpret_cast<const char*>(p), length);
+}
+
+// Octal, space or NUL terminated; GNU base-256 when the top bit is set.
+bool parseNumber(const uint8_t* p, size_t size, uint64_t& out)
+{
+  out = 0;
+  if ((p[0] & 0x80) != 0)
+  {
+    if (p[0] != 0x80)
+    {
+      return false;  // negative, or wider than 64 bits
+    }
+    for (size_t i = 1; i < size; ++i)
+    {
+      if (out >> 56 != 0)
+      {
+        return false;
+      }
+      out = (out << 8) | p[i];
+    }
+    return true;
+  }
+  size_t i = 0;
+  while (i < size && p[i] == ' ')
+  {
+    ++i;
+  }
+  for (; i < size && p[i] != 0 && p[i] != ' '; ++i)
+  {
+    if (p[i] < '0' || p[i] > '7' || out >> 61 != 0)
+    {
+      return false;
+    }
+    out = (out << 3) | static_cast<uint64_t>(p[i] - '0');
+  }
+  return true;
+}
+
+// Relative path without "." components; ".." is neutralised so that a
+// damaged or hostile archive cannot write outside the output directory.
+std::string safePath(const std::string& name)
+{
+  std::string out;
+  size_t pos = 0;
+  while (pos <= name.size())
+  {
+    size_t slash = std::min(name.find('/', pos), name.size());
+    std::string part = name.substr(pos, slash - pos);
+    pos = slash + 1;
+    if (part.empty() || part == ".")
+    {
+      continue;
+    }
+    if (part == "..")
+    {
+      part = "_..";
+    }
+    if (!out.empty())
+    {
+      out += '/';
+    }
+    out += part;
+  }
+  return out.empty() ? std::string("_") : out;
+}
+
+}  // namespace
+
+bool isTarHeader(const uint8_t* record)
+{
+  uint64_t stored = 0;
+  if (record[NAME_OFFSET] == 0 || !parseNumber(record + CHECKSUM_OFFSET, 8, stored))
+  {
+    return false;
+  }
+  // The checksum field itself counts as spaces. Some old writers summed
+  // signed chars, so either interpretation is accepted.
+  uint64_t unsigned_sum = 8 * ' ';
+  int64_t signed_sum = 8 * ' ';
+  for (size_t i = 0; i < TAR_RECORD_SIZE; ++i)
+  {
+    if (i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + 8)
+    {
+      continue;
+    }
+    unsigned_sum += record[i];
+    signed_sum += static_cast<int8_t>(record[i]);
+  }
+  return stored == unsigned_sum || static_cast<int64_t>(stored) == signed_sum;
+}
+
+TarStreamReader::TarStreamReader(uint64_t base_offset, TarDataSink data, TarEntryCallback done)
+  : data_(std::move(data)), done_(std::move(done)), offset_(base_offset)
+{
+}
+
+bool TarStreamReader::feed(const uint8_t* data, size_t size)
+{
+  while (size > 0 && !aborted_)
+  {
+    size_t n = 0;
+    if (mode_ == Mode::Header)
+    {
+      n = std::min(TAR_RECORD_SIZE - record_fill_, size);
+      std::memcpy(record_ + record_fill_, data, n);
+      record_fill_ += n;
+      offset_ += n;
+      if (record_fill_ == TAR_RECORD_SIZE)
+      {
+        record_fill_ = 0;
+        header();
+      }
+    }
+    else
+    {
+      n = static_cast<size_t>(std::min<uint64_t>(remaining_, size));
+      if (mode_ == Mode::Data && !data_(entry_, entry_.size - remaining_, data, n))
+      {
+        aborted_ = true;
+        return false;
+      }
+      if (mode_ == Mode::Extended && extended_.size() < MAX_EXTENDED)
+      {
+        extended_.append(reinterpret_cast<const char*>(data),
+                         std::min(n, MAX_EXTENDED - extended_.size()));
+      }
+      remaining_ -= n;
+      offset_ += n;
+      if (remaining_ == 0)
+      {
+        if (mode_ == Mode::Data)
+        {
+          endMember(true);
+        }
+        else if (mode_ == Mode::Extended)
+        {
+          applyExtended();
+        }
+        remaining_ = mode_ == Mode::Skip ? 0 : padding_;
+        mode_ = remaining_ != 0 ? Mode::Skip : Mode::Header;
+      }
+    }
+    data += n;
+    size -= n;
+  }
+  return !aborted_;
+}
+
+void TarStreamReader::finish()
+{
+  if (in_member_)
+  {
+    endMember(false);
+  }
+}
+
+void TarStreamReader::endMember(bool complete)
+{
+  in_member_ = false;
+  if (done_)
+  {
+    done_(entry_, complete);
+  }
+}
+
+void TarStreamReader::header()
+{
+  uint64_t at = offset_ - TAR_RECORD_SIZE;
+  bool zero = std::all_of(record_, record_ + TAR_RECORD_SIZE, [](uint8_t b) { return b == 0; });
+  uint64_t size = 0;
+  if (zero)
+  {
+    saw_end_ = saw_end_ || (!resyncing_ && ++zero_records_ >= 2);
+    return;
+  }
+  zero_records_ = 0;
+  if (!isTarHeader(record_) || !parseNumber(record_ + SIZE_OFFSET, 12, size))
+  {
+    if (!resyncing_)
+    {
+      // Overrides collected for the damaged member must not leak onto the next.
+      resyncing_ = true;
+      long_name_.clear();
+      long_link_.clear();
+      has_pax_size_ = false;
+      pending_header_ = UINT64_MAX;
+    }
+    resync_bytes_ += TAR_RECORD_SIZE;
+    return;
+  }
+  resyncing_ = false;
+  if (pending_header_ == UINT64_MAX)
+  {
+    pending_header_ = at;
+  }
+
+  char type = static_cast<char>(record_[TYPE_OFFSET]);
+  if (type == 'L' || type == 'K' || type == 'x')
+  {
+    extended_type_ = type;
+    extended_.clear();
+    remaining_ = size;
+    padding_ = paddingFor(size);
+    mode_ = Mode::Extended;
+    if (size == 0)
+    {
+      applyExtended();
+      mode_ = Mode::Header;
+    }
+    return;
+  }
+  if (type == 'g')
+  {
+    remaining_ = size + paddingFor(size);
+    mode_ = remaining_ != 0 ? Mode::Skip : Mode::Header;
+    return;
+  }
+
+  TarEntry entry;
+  std::string name = field(record_ + NAME_OFFSET, NAME_SIZE);
+  std::string prefix = field(record_ + PREFIX_OFFSET, PREFIX_SIZE);
+  if (std::memcmp(record_ + MAGIC_OFFSET, "ustar", 5) == 0 && !prefix.empty())
+  {
+    name = prefix + "/" + name;
+  }
+  entry.path = safePath(long_name_.empty() ? name : long_name_);
+  entry.link = long_link_.empty() ? field(record_ + LINK_OFFSET, NAME_SIZE) : long_link_;
+  entry.type = type == '\0' ? '0' : type;
+  entry.size = has_pax_size_ ? pax_size_ : size;
+  uint64_t number = 0;
+  entry.mode = parseNumber(record_ + MODE_OFFSET, 8, number) ? static_cast<uint32_t>(number) : 0;
+  entry.mtime = parseNumber(record_ + MTIME_OFFSET, 12, number) ? number : 0;
+  entry.header_offset = pending_header_;
+  entry.data_offset = offset_;
+
+  long_name_.clear();
+  long_link_.clear();
+  has_pax_size_ = false;
+  pending_header_ = UINT64_MAX;
+  entry_ = std::move(entry);
+  in_member_ = true;
+  ++members_;
+
+  if (entry_.isRegular() && entry_.size != 0)
+  {
+    remaining_ = entry_.size;
+    padding_ = paddingFor(entry_.size);
+    mode_ = Mode::Data;
+    return;
+  }
+  // Directories, links and devices carry no data; sparse and unknown member
+  // types are listed but their data is stepped over.
+  endMember(true);
+  remaining_ = entry_.size + paddingFor(entry_.size);
+  mode_ = remaining_ != 0 ? Mode::Skip : Mode::Header;
+}
+
+void TarStreamReader::applyExtended()
+{
+  if (extended_.size() >= MAX_EXTENDED)
+  {
+    return;  // oversized: the member keeps its header name
+  }
+  if (extended_type_ == 'L' || extended_type_ == 'K')
+  {
+    std::string value = extended_.substr(0, extended_.find('\0'));
+    (extended_type_ == 'L' ? long_name_ : long_link_) = value;
+    return;
+  }
+  // pax: "<length> <key>=<value>\n" records.
+  size_t pos = 0;
+  while (pos < extended_.size())
+  {
+    size_t space = extended_.find(' ', pos);
+    if (space == std::string::npos)
+    {
+      break;
+    }
+    uint64_t length = 0;
+    for (size_t i = pos; i < space; ++i)
+    {
+      char c = extended_[i];
+      if (c < '0' || c > '9' || length > extended_.size())
+      {
+        return;
+      }
+      length = length * 10 + static_cast<uint64_t>(c - '0');
+    }
+    if (length <= space - pos + 1 || pos + length > extended_.size() ||
+        extended_[pos + length - 1] != '\n')
+    {
+      return;
+    }
+    std::string record = extended_.substr(space + 1, pos + length - space - 2);
+    pos += length;
+    size_t eq = record.find('=');
+    if (eq == std::string::npos)
+    {
+      continue;
+    }
+    std::string key = record.substr(0, eq);
+    std::string value = record.substr(eq + 1);
+    if (key == "path")
+    {
+      long_name_ = value;
+    }
+    else if (key == "linkpath")
+    {
+      long_link_ = value;
+    }
+    else if (key == "size")
+    {
+      uint64_t parsed = 0;
+      bool ok = !value.empty();
+      for (char c : value)
+      {
+        ok = ok && c >= '0' && c <= '9' && parsed <= (UINT64_MAX - 9) / 10;
+        parsed = ok ? parsed * 10 + static_cast<uint64_t>(c - '0') : 0;
+      }
+      pax_size_ = parsed;
+      has_pax_size_ = ok;
+    }
+  }
+}
+
+}  // namespace rsn
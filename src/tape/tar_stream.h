@@ -0,0 +1,106 @@
+// RecoverySoftNetz — streaming tar reader
+//
+// Push parser for v7, ustar, GNU and pax archives. Bytes are fed in as they
+// come off the medium and member data goes straight to a sink, so an archive
+// of any size is extracted in one sequential pass with a few KiB of state.
+// A header is accepted only if its checksum is valid. After a damaged header
+// the reader resynchronises on the next 512-byte record that holds a valid
+// one, so a bad tape block costs only the members it touches.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace rsn
+{
+
+constexpr size_t TAR_RECORD_SIZE = 512;
+
+struct TarEntry
+{
+  std::string path;         // sanitised: relative, no "." or ".." components
+  std::string link;         // link target for hard and symbolic links
+  char type = '0';          // typeflag; '\0' is normalised to '0'
+  uint64_t size = 0;        // member data bytes
+  uint32_t mode = 0;
+  uint64_t mtime = 0;
+  uint64_t header_offset = 0;  // stream offset of the member's first header record
+  uint64_t data_offset = 0;    // stream offset of the first data byte
+
+  bool isRegular() const { return type == '0' || type == '7'; }
+  bool isDirectory() const { return type == '5'; }
+};
+
+/// True when `record` (TAR_RECORD_SIZE bytes) is a header with a valid checksum.
+bool isTarHeader(const uint8_t* record);
+
+/// Receives regular-file data in order; returns false to abort extraction.
+using TarDataSink =
+  std::function<bool(const TarEntry& entry, uint64_t entry_offset, const uint8_t* data,
+                     size_t size)>;
+
+/// Called once per member after its data; `complete` is false when the stream
+/// ended inside it.
+using TarEntryCallback = std::function<void(const TarEntry& entry, bool complete)>;
+
+class TarStreamReader
+{
+public:
+  /// `base_offset` is the stream offset of the first byte that will be fed.
+  TarStreamReader(uint64_t base_offset, TarDataSink data, TarEntryCallback done);
+
+  /// Consume the next bytes of the stream. False once the sink aborted.
+  bool feed(const uint8_t* data, size_t size);
+
+  /// End of stream: reports a member that was cut short.
+  void finish();
+
+  uint64_t members() const { return members_; }
+  uint64_t resyncBytes() const { return resync_bytes_; }  // records skipped as damaged
+  bool sawEnd() const { return saw_end_; }                // two zero records seen
+
+private:
+  enum class Mode : uint8_t
+  {
+    Header,
+    Data,      // regular-file data to the sink
+    Extended,  // GNU long name/link or pax records, collected
+    Skip,      // padding and data of members that are not extracted
+  };
+
+  void header();
+  void applyExtended();
+  void endMember(bool complete);
+
+  TarDataSink data_;
+  TarEntryCallback done_;
+  uint64_t offset_;
+  uint8_t record_[TAR_RECORD_SIZE];
+  size_t record_fill_ = 0;
+
+  Mode mode_ = Mode::Header;
+  uint64_t remaining_ = 0;  // bytes left in the current member's data
+  uint64_t padding_ = 0;    // bytes to skip after it
+  bool in_member_ = false;
+  TarEntry entry_;
+
+  char extended_type_ = 0;
+  std::string extended_;     // collected long name / link / pax records
+  std::string long_name_;
+  std::string long_link_;
+  uint64_t pax_size_ = 0;
+  bool has_pax_size_ = false;
+  uint64_t pending_header_ = UINT64_MAX;  // first header record of a pending member
+
+  unsigned zero_records_ = 0;
+  bool resyncing_ = false;
+  bool aborted_ = false;
+  bool saw_end_ = false;
+  uint64_t members_ = 0;
+  uint64_t resync_bytes_ = 0;
+};
+
+}  // namespace rsn
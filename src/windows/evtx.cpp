@@ -0,0 +1,1115 @@
+// RecoverySoftNetz — Windows EVTX event log parser
+
+#include "windows/evtx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t FILE_HEADER = 4096;
+constexpr size_t CHUNK = 65536;
+constexpr size_t CHUNK_HEADER = 512;
+constexpr size_t RECORD_HEADER = 24;
+constexpr uint32_t RECORD_MAGIC = 0x00002A2A;
+constexpr size_t TEMPLATE_HEADER = 24;  // next offset, GUID, data size
+constexpr size_t INSTANCE = 10;         // template instance token
+constexpr size_t MAX_ELEMENTS = 64;     // element nesting in a template
+constexpr unsigned MAX_NESTING = 4;     // binary XML inside substitution values
+
+enum Token : uint8_t
+{
+  END_OF_FRAGMENT = 0x00,
+  OPEN_START = 0x01,
+  CLOSE_START = 0x02,
+  CLOSE_EMPTY = 0x03,
+  END_ELEMENT = 0x04,
+  VALUE = 0x05,
+  ATTRIBUTE = 0x06,
+  CDATA = 0x07,
+  CHAR_REF = 0x08,
+  ENTITY_REF = 0x09,
+  PI_TARGET = 0x0A,
+  PI_DATA = 0x0B,
+  TEMPLATE_INSTANCE = 0x0C,
+  SUBSTITUTION = 0x0D,
+  OPTIONAL_SUBSTITUTION = 0x0E,
+  FRAGMENT_HEADER = 0x0F,
+  MORE = 0x40,  // flag: attributes follow, or more data
+};
+
+enum ValueType : uint8_t
+{
+  TYPE_NULL = 0x00,
+  TYPE_STRING = 0x01,
+  TYPE_ANSI = 0x02,
+  TYPE_INT8 = 0x03,
+  TYPE_UINT8 = 0x04,
+  TYPE_INT16 = 0x05,
+  TYPE_UINT16 = 0x06,
+  TYPE_INT32 = 0x07,
+  TYPE_UINT32 = 0x08,
+  TYPE_INT64 = 0x09,
+  TYPE_UINT64 = 0x0A,
+  TYPE_REAL32 = 0x0B,
+  TYPE_REAL64 = 0x0C,
+  TYPE_BOOL = 0x0D,
+  TYPE_BINARY = 0x0E,
+  TYPE_GUID = 0x0F,
+  TYPE_SIZE = 0x10,
+  TYPE_FILETIME = 0x11,
+  TYPE_SYSTEMTIME = 0x12,
+  TYPE_SID = 0x13,
+  TYPE_HEX32 = 0x14,
+  TYPE_HEX64 = 0x15,
+  TYPE_BINXML = 0x21,
+  TYPE_ARRAY = 0x80,
+};
+
+/// `units` UTF-16LE code units to UTF-8, stopping at a NUL. Returns the units
+/// read, the NUL included.
+size_t appendUtf16(std::string& out, const uint8_t* p, size_t units)
+{
+  size_t i = 0;
+  while (i < units)
+  {
+    uint32_t cp = loadLE16(p + 2 * i++);
+    if (cp == 0)
+    {
+      break;
+    }
+    if (cp >= 0xD800 && cp < 0xDC00 && i < units)
+    {
+      uint32_t low = loadLE16(p + 2 * i);
+      if (low >= 0xDC00 && low < 0xE000)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        ++i;
+      }
+    }
+    appendUtf8(out, cp);
+  }
+  return i;
+}
+
+void appendFormat(std::string& out, const char* format, ...)
+{
+  char text[64];
+  va_list args;
+  va_start(args, format);
+  int n = std::vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (n > 0)
+  {
+    out.append(text, std::min<size_t>(static_cast<size_t>(n), sizeof(text) - 1));
+  }
+}
+
+/// Days since 1970-01-01 to a civil date.
+void civilDate(int64_t days, int64_t& year, unsigned& month, unsigned& day)
+{
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  auto doe = static_cast<unsigned>(days - era * 146097);
+  unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  unsigned mp = (5 * doy + 2) / 153;
+  day = doy - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+void appendFiletime(std::string& out, uint64_t filetime)
+{
+  int64_t seconds = static_cast<int64_t>(filetime / 10000000) - 11644473600ll;
+  int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+  int64_t rest = seconds - days * 86400;
+  int64_t year;
+  unsigned month;
+  unsigned day;
+  civilDate(days, year, month, day);
+  appendFormat(out, "%04lld-%02u-%02uT%02u:%02u:%02u.%07uZ", static_cast<long long>(year), month,
+               day, static_cast<unsigned>(rest / 3600), static_cast<unsigned>(rest / 60 % 60),
+               static_cast<unsigned>(rest % 60), static_cast<unsigned>(filetime % 10000000));
+}
+
+void appendGuid(std::string& out, const uint8_t* p)
+{
+  appendFormat(out, "{%08X-%04X-%04X-", loadLE32(p), loadLE16(p + 4), loadLE16(p + 6));
+  for (int i = 8; i < 16; ++i)
+  {
+    appendFormat(out, i == 10 ? "-%02X" : "%02X", p[i]);
+  }
+  out += '}';
+}
+
+/// A SID; returns false when `v` is too short for its sub-authority count.
+bool appendSid(std::string& out, ByteView v)
+{
+  if (v.size < 8 || v.size < 8 + size_t(v[1]) * 4)
+  {
+    return false;
+  }
+  uint64_t authority = 0;
+  for (int i = 2; i < 8; ++i)
+  {
+    authority = (authority << 8) | v[i];
+  }
+  appendFormat(out, "S-%u-%llu", v[0], static_cast<unsigned long long>(authority));
+  for (size_t i = 0; i < v[1]; ++i)
+  {
+    appendFormat(out, "-%u", loadLE32(v.data + 8 + i * 4));
+  }
+  return true;
+}
+
+size_t fixedSize(uint8_t type)
+{
+  switch (type)
+  {
+  case TYPE_INT8:
+  case TYPE_UINT8:
+    return 1;
+  case TYPE_INT16:
+  case TYPE_UINT16:
+    return 2;
+  case TYPE_INT32:
+  case TYPE_UINT32:
+  case TYPE_REAL32:
+  case TYPE_BOOL:
+  case TYPE_HEX32:
+    return 4;
+  case TYPE_INT64:
+  case TYPE_UINT64:
+  case TYPE_REAL64:
+  case TYPE_FILETIME:
+  case TYPE_HEX64:
+    return 8;
+  case TYPE_GUID:
+  case TYPE_SYSTEMTIME:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+uint64_t unsignedValue(ByteView v)
+{
+  switch (v.size)
+  {
+  case 1:
+    return v[0];
+  case 2:
+    return loadLE16(v.data);
+  case 4:
+    return loadLE32(v.data);
+  case 8:
+    return loadLE64(v.data);
+  default:
+    return 0;
+  }
+}
+
+/// One value of a fixed-size type.
+void appendScalar(std::string& out, uint8_t type, ByteView v)
+{
+  uint64_t u = unsignedValue(v);
+  switch (type)
+  {
+  case TYPE_INT8:
+    appendFormat(out, "%d", static_cast<int8_t>(u));
+    break;
+  case TYPE_INT16:
+    appendFormat(out, "%d", static_cast<int16_t>(u));
+    break;
+  case TYPE_INT32:
+    appendFormat(out, "%d", static_cast<int32_t>(u));
+    break;
+  case TYPE_INT64:
+    appendFormat(out, "%lld", static_cast<long long>(u));
+    break;
+  case TYPE_REAL32:
+  {
+    float f;
+    std::memcpy(&f, v.data, 4);
+    appendFormat(out, "%g", static_cast<double>(f));
+    break;
+  }
+  case TYPE_REAL64:
+  {
+    double d;
+    std::memcpy(&d, v.data, 8);
+    appendFormat(out, "%g", d);
+    break;
+  }
+  case TYPE_BOOL:
+    out += u != 0 ? "true" : "false";
+    break;
+  case TYPE_GUID:
+    appendGuid(out, v.data);
+    break;
+  case TYPE_FILETIME:
+    appendFiletime(out, u);
+    break;
+  case TYPE_SYSTEMTIME:
+    appendFormat(out, "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ", loadLE16(v.data),
+                 loadLE16(v.data + 2), loadLE16(v.data + 6), loadLE16(v.data + 8),
+                 loadLE16(v.data + 10), loadLE16(v.data + 12), loadLE16(v.data + 14));
+    break;
+  case TYPE_HEX32:
+    appendFormat(out, "0x%08x", static_cast<unsigned>(u));
+    break;
+  case TYPE_HEX64:
+    appendFormat(out, "0x%016llx", static_cast<unsigned long long>(u));
+    break;
+  default:
+    appendFormat(out, "%llu", static_cast<unsigned long long>(u));
+    break;
+  }
+}
+
+/// A substitution value as text; arrays are joined with ", ".
+void render(uint8_t type, ByteView v, std::string& out)
+{
+  out.clear();
+  uint8_t base = type & ~TYPE_ARRAY;
+  bool array = (type & TYPE_ARRAY) != 0;
+  if (base == TYPE_STRING)
+  {
+    for (size_t at = 0; at + 1 < v.size;)
+    {
+      out += at != 0 && array ? ", " : "";
+      at += 2 * appendUtf16(out, v.data + at, (v.size - at) / 2);
+      if (!array)
+      {
+        break;
+      }
+    }
+    return;
+  }
+  if (base == TYPE_ANSI)
+  {
+    for (size_t i = 0; i < v.size; ++i)
+    {
+      out += v[i] == 0 ? (array && i + 1 < v.size ? ", " : "") : std::string(1, char(v[i]));
+      if (v[i] == 0 && !array)
+      {
+        break;
+      }
+    }
+    return;
+  }
+  if (base == TYPE_SID && !array && appendSid(out, v))
+  {
+    return;
+  }
+  if (base == TYPE_SIZE && (v.size == 4 || v.size == 8) && !array)
+  {
+    appendFormat(out, "0x%llx", static_cast<unsigned long long>(unsignedValue(v)));
+    return;
+  }
+  size_t size = fixedSize(base);
+  if (size == 0 || v.size % size != 0)
+  {
+    out = toHex(v.data, v.size);
+    return;
+  }
+  for (size_t at = 0; at < v.size; at += size)
+  {
+    out += at != 0 ? ", " : "";
+    appendScalar(out, base, v.sub(at, size));
+  }
+}
+
+/// A name structure of the chunk: next offset, hash, length and UTF-16
+/// characters with a NUL. Returns its size, or 0 when it does not fit.
+size_t readName(ByteView chunk, size_t offset, std::string& out)
+{
+  out.clear();
+  if (offset > chunk.size || chunk.size - offset < 8)
+  {
+    return 0;
+  }
+  size_t units = loadLE16(chunk.data + offset + 6);
+  if ((chunk.size - offset - 8) / 2 < units + 1)
+  {
+    return 0;
+  }
+  appendUtf16(out, chunk.data + offset + 8, units);
+  return 8 + 2 * (units + 1);
+}
+
+enum class Field : uint8_t
+{
+  Provider,
+  EventId,
+  Level,
+  Task,
+  Opcode,
+  Keywords,
+  TimeCreated,
+  ProcessId,
+  ThreadId,
+  Channel,
+  Computer,
+  UserId,
+  Data,
+};
+
+struct SystemField
+{
+  const char* element;
+  const char* attribute;  // nullptr: the element's text
+  Field field;
+};
+
+constexpr SystemField SYSTEM_FIELDS[] = {
+  {"Provider", "Name", Field::Provider},
+  {"EventID", nullptr, Field::EventId},
+  {"Level", nullptr, Field::Level},
+  {"Task", nullptr, Field::Task},
+  {"Opcode", nullptr, Field::Opcode},
+  {"Keywords", nullptr, Field::Keywords},
+  {"TimeCreated", "SystemTime", Field::TimeCreated},
+  {"Execution", "ProcessID", Field::ProcessId},
+  {"Execution", "ThreadID", Field::ThreadId},
+  {"Channel", nullptr, Field::Channel},
+  {"Computer", nullptr, Field::Computer},
+  {"Security", "UserID", Field::UserId},
+};
+
+}  // namespace
+
+struct EvtxPlan
+{
+  struct Binding
+  {
+    Field field = Field::Data;
+    bool literal = false;
+    uint16_t index = 0;       // substitution
+    int32_t name_index = -1;  // substitution naming a Data item, when not literal
+    std::string name;         // Data item name
+    std::string text;         // literal value
+  };
+
+  std::vector<Binding> bindings;
+};
+
+namespace
+{
+
+/// Compiles a template definition's binary XML into an EvtxPlan.
+class Compiler
+{
+public:
+  Compiler(ByteView chunk, bool nested, EvtxPlan& plan)
+    : chunk_(chunk), nested_(nested), plan_(plan)
+  {
+  }
+
+  bool run(size_t start, size_t end)
+  {
+    pos_ = start;
+    end_ = std::min(end, chunk_.size);
+    if (pos_ < end_ && chunk_[pos_] == FRAGMENT_HEADER)
+    {
+      pos_ += 4;
+    }
+    return pos_ < end_ && (chunk_[pos_] & ~MORE) == OPEN_START && element() && pos_ < end_ &&
+           chunk_[pos_] == END_OF_FRAGMENT;
+  }
+
+private:
+  struct Frame
+  {
+    std::string name;
+    std::string data_name;    // the Name attribute of a Data element
+    int32_t name_index = -1;  // ... when it is a substitution
+  };
+
+  bool need(size_t n) const { return pos_ <= end_ && end_ - pos_ >= n; }
+
+  bool name(std::string& out)
+  {
+    if (!need(4))
+    {
+      return false;
+    }
+    size_t offset = loadLE32(chunk_.data + pos_);
+    pos_ += 4;
+    size_t size = readName(chunk_, offset, out);
+    if (size == 0)
+    {
+      return false;
+    }
+    if (offset == pos_)
+    {
+      pos_ += size;  // defined inline
+    }
+    return need(0);
+  }
+
+  bool element()
+  {
+    if (stack_.size() >= MAX_ELEMENTS || !need(7))
+    {
+      return false;
+    }
+    bool attributes = (chunk_[pos_] & MORE) != 0;
+    pos_ += 7;  // token, dependency id, data size
+    stack_.emplace_back();
+    if (!name(stack_.back().name) || (attributes && !need(4)))
+    {
+      return false;
+    }
+    pos_ += attributes ? 4 : 0;
+    while (need(1) && (chunk_[pos_] & ~MORE) == ATTRIBUTE)
+    {
+      ++pos_;
+      std::string attribute;
+      if (!name(attribute))
+      {
+        return false;
+      }
+      while (need(1) && isContent(chunk_[pos_]))
+      {
+        if (!content(&attribute))
+        {
+          return false;
+        }
+      }
+    }
+    if (!need(1))
+    {
+      return false;
+    }
+    uint8_t token = chunk_[pos_++];
+    if (token == CLOSE_EMPTY)
+    {
+      stack_.pop_back();
+      return true;
+    }
+    if (token != CLOSE_START)
+    {
+      return false;
+    }
+    while (need(1))
+    {
+      token = chunk_[pos_];
+      if (token == END_ELEMENT)
+      {
+        ++pos_;
+        stack_.pop_back();
+        return true;
+      }
+      bool ok = (token & ~MORE) == OPEN_START ? element() : isContent(token) && content(nullptr);
+      if (!ok)
+      {
+        return false;
+      }
+    }
+    return false;
+  }
+
+  static bool isContent(uint8_t token)
+  {
+    switch (token & ~MORE)
+    {
+    case VALUE:
+    case CDATA:
+    case CHAR_REF:
+    case ENTITY_REF:
+    case PI_TARGET:
+    case PI_DATA:
+    case SUBSTITUTION:
+    case OPTIONAL_SUBSTITUTION:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  bool text(std::string& out)
+  {
+    if (!need(2))
+    {
+      return false;
+    }
+    size_t units = loadLE16(chunk_.data + pos_);
+    pos_ += 2;
+    if (!need(2 * units))
+    {
+      return false;
+    }
+    out.clear();
+    appendUtf16(out, chunk_.data + pos_, units);
+    pos_ += 2 * units;
+    return true;
+  }
+
+  bool content(const std::string* attribute)
+  {
+    std::string value;
+    switch (chunk_[pos_++] & ~MORE)
+    {
+    case VALUE:
+      // Template text is always a string.
+      if (!need(1) || chunk_[pos_++] != TYPE_STRING || !text(value))
+      {
+        return false;
+      }
+      bind(attribute, true, 0, std::move(value));
+      return true;
+    case CDATA:
+      if (!text(value))
+      {
+        return false;
+      }
+      bind(attribute, true, 0, std::move(value));
+      return true;
+    case SUBSTITUTION:
+    case OPTIONAL_SUBSTITUTION:
+      if (!need(3))
+      {
+        return false;
+      }
+      bind(attribute, false, loadLE16(chunk_.data + pos_), std::string());
+      pos_ += 3;
+      return true;
+    case CHAR_REF:
+      pos_ += 2;
+      return need(0);
+    case ENTITY_REF:
+    case PI_TARGET:
+      return name(value);
+    case PI_DATA:
+      return text(value);
+    default:
+      return false;
+    }
+  }
+
+  void bind(const std::string* attribute, bool literal, uint16_t index, std::string text)
+  {
+    Frame& frame = stack_.back();
+    if (attribute != nullptr && *attribute == "Name" && frame.name == "Data")
+    {
+      if (literal)
+      {
+        frame.data_name = std::move(text);
+      }
+      else
+      {
+        frame.name_index = index;
+      }
+      return;
+    }
+    EvtxPlan::Binding binding;
+    binding.literal = literal;
+    binding.index = index;
+    binding.text = std::move(text);
+    if (!classify(attribute, binding))
+    {
+      return;
+    }
+    plan_.bindings.push_back(std::move(binding));
+  }
+
+  bool classify(const std::string* attribute, EvtxPlan::Binding& binding) const
+  {
+    const Frame& frame = stack_.back();
+    bool data = nested_;
+    if (!nested_ && stack_.size() >= 2 && stack_[0].name == "Event")
+    {
+      const std::string& section = stack_[1].name;
+      if (section == "System" && stack_.size() == 3)
+      {
+        for (const SystemField& f : SYSTEM_FIELDS)
+        {
+          if (frame.name == f.element &&
+              (attribute == nullptr ? f.attribute == nullptr
+                                    : f.attribute != nullptr && *attribute == f.attribute))
+          {
+            binding.field = f.field;
+            return true;
+          }
+        }
+        return false;
+      }
+      data = section == "EventData" || section == "UserData";
+    }
+    if (!data)
+    {
+      return false;
+    }
+    binding.field = Field::Data;
+    if (attribute != nullptr)
+    {
+      binding.name = *attribute;
+    }
+    else if (!frame.data_name.empty() || frame.name_index >= 0)
+    {
+      binding.name = frame.data_name;
+      binding.name_index = frame.name_index;
+    }
+    else if (stack_.size() > 2 || nested_)
+    {
+      binding.name = frame.name;
+    }
+    return true;
+  }
+
+  ByteView chunk_;
+  bool nested_;
+  EvtxPlan& plan_;
+  size_t pos_ = 0;
+  size_t end_ = 0;
+  std::vector<Frame> stack_;
+};
+
+}  // namespace
+
+/// Decodes the records of one chunk (or the part of it that is known).
+class EvtxDecoder
+{
+public:
+  EvtxDecoder(ByteView chunk, uint64_t offset, EvtxTemplateCache& cache)
+    : chunk_(chunk), offset_(offset), cache_(cache), values_(MAX_NESTING + 1)
+  {
+  }
+
+  bool record(size_t at, EvtxEvent& event)
+  {
+    ByteView r = chunk_.sub(at);
+    if (r.size < RECORD_HEADER + 4 || loadLE32(r.data) != RECORD_MAGIC)
+    {
+      return false;
+    }
+    uint32_t size = loadLE32(r.data + 4);
+    if (size < RECORD_HEADER + 4 + INSTANCE + 4 || size > r.size ||
+        loadLE32(r.data + size - 4) != size)
+    {
+      return false;
+    }
+    reset(event);
+    event.offset = offset_ + at;
+    event.record_id = loadLE64(r.data + 8);
+    event.written = loadLE64(r.data + 16);
+    int result = instance(at + RECORD_HEADER, at + size - 4, false, 0, event);
+    event.resolved = result > 0;
+    return result >= 0;
+  }
+
+private:
+  struct Value
+  {
+    uint8_t type;
+    ByteView bytes;
+  };
+
+  static void reset(EvtxEvent& event)
+  {
+    event.time_created = 0;
+    event.event_id = 0;
+    event.level = event.opcode = 0;
+    event.task = 0;
+    event.keywords = 0;
+    event.process_id = event.thread_id = 0;
+    event.provider.clear();
+    event.channel.clear();
+    event.computer.clear();
+    event.user.clear();
+    event.data.clear();
+    event.stale = false;
+  }
+
+  /// A fragment holding a template instance and its values, in [at, end).
+  /// Returns 1 when the template was applied, 0 when it was not found (the
+  /// values are then listed by index), -1 when the fragment does not parse.
+  int instance(size_t at, size_t end, bool nested, unsigned depth, EvtxEvent& event)
+  {
+    const uint8_t* p = chunk_.data;
+    if (end > chunk_.size || at > end || end - at < 4 + INSTANCE + 4 ||
+        p[at] != FRAGMENT_HEADER || p[at + 4] != TEMPLATE_INSTANCE)
+    {
+      return -1;
+    }
+    size_t x = at + 4 + INSTANCE;
+    uint32_t definition = loadLE32(p + at + 4 + 6);
+    if (definition == x)
+    {
+      // Defined here, on first use in the chunk.
+      if (end - x < TEMPLATE_HEADER || loadLE32(p + x + 20) > end - x - TEMPLATE_HEADER)
+      {
+        return -1;
+      }
+      x += TEMPLATE_HEADER + loadLE32(p + x + 20);
+    }
+    if (end - x < 4)
+    {
+      return -1;
+    }
+    size_t count = loadLE32(p + x);
+    x += 4;
+    if (count > (end - x) / 4)
+    {
+      return -1;
+    }
+    std::vector<Value>& values = values_[depth];
+    values.clear();
+    size_t data = x + count * 4;
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t size = loadLE16(p + x + i * 4);
+      if (size > end - data)
+      {
+        return -1;
+      }
+      values.push_back({p[x + i * 4 + 2], ByteView(p + data, size)});
+      data += size;
+    }
+    const EvtxPlan* found = plan(definition, nested);
+    if (found == nullptr)
+    {
+      for (size_t i = 0; i < values.size(); ++i)
+      {
+        event.data.emplace_back();
+        event.data.back().name = "#" + std::to_string(i);
+        render(values[i].type, values[i].bytes, event.data.back().value);
+      }
+      return 0;
+    }
+    apply(*found, depth, event);
+    return 1;
+  }
+
+  void apply(const EvtxPlan& plan, unsigned depth, EvtxEvent& event)
+  {
+    for (const EvtxPlan::Binding& b : plan.bindings)
+    {
+      uint8_t type = TYPE_STRING;
+      ByteView v;
+      if (!b.literal)
+      {
+        const std::vector<Value>& values = values_[depth];
+        if (b.index >= values.size() || values[b.index].type == TYPE_NULL)
+        {
+          continue;
+        }
+        type = values[b.index].type;
+        v = values[b.index].bytes;
+      }
+      uint64_t number = b.literal ? std::strtoull(b.text.c_str(), nullptr, 0) : unsignedValue(v);
+      switch (b.field)
+      {
+      case Field::EventId:
+        event.event_id = static_cast<uint32_t>(number);
+        break;
+      case Field::Level:
+        event.level = static_cast<uint8_t>(number);
+        break;
+      case Field::Task:
+        event.task = static_cast<uint16_t>(number);
+        break;
+      case Field::Opcode:
+        event.opcode = static_cast<uint8_t>(number);
+        break;
+      case Field::Keywords:
+        event.keywords = number;
+        break;
+      case Field::ProcessId:
+        event.process_id = static_cast<uint32_t>(number);
+        break;
+      case Field::ThreadId:
+        event.thread_id = static_cast<uint32_t>(number);
+        break;
+      case Field::TimeCreated:
+        event.time_created = type == TYPE_FILETIME ? number : 0;
+        break;
+      case Field::Provider:
+        text(b, type, v, event.provider);
+        break;
+      case Field::Channel:
+        text(b, type, v, event.channel);
+        break;
+      case Field::Computer:
+        text(b, type, v, event.computer);
+        break;
+      case Field::UserId:
+        text(b, type, v, event.user);
+        break;
+      case Field::Data:
+        if (type == TYPE_BINXML && depth < MAX_NESTING)
+        {
+          size_t at = static_cast<size_t>(v.data - chunk_.data);
+          if (instance(at, at + v.size, true, depth + 1, event) >= 0)
+          {
+            break;
+          }
+        }
+        event.data.emplace_back();
+        event.data.back().name = b.name;
+        if (b.name_index >= 0 && size_t(b.name_index) < values_[depth].size())
+        {
+          const Value& name = values_[depth][b.name_index];
+          render(name.type, name.bytes, event.data.back().name);
+        }
+        text(b, type, v, event.data.back().value);
+        break;
+      }
+    }
+  }
+
+  static void text(const EvtxPlan::Binding& b, uint8_t type, ByteView v, std::string& out)
+  {
+    if (b.literal)
+    {
+      out = b.text;
+    }
+    else
+    {
+      render(type, v, out);
+    }
+  }
+
+  /// The plan for the definition at `definition`, through the chunk's own map
+  /// first, then the shared cache; compiled on first sight.
+  const EvtxPlan* plan(uint32_t definition, bool nested)
+  {
+    uint64_t local = (uint64_t(definition) << 1) | (nested ? 1 : 0);
+    for (const auto& entry : local_)
+    {
+      if (entry.first == local)
+      {
+        return entry.second;
+      }
+    }
+    uint64_t place = ((offset_ + definition) << 1) | (nested ? 1 : 0);
+    const EvtxPlan* found = nullptr;
+    bool known = false;
+    {
+      std::shared_lock<std::shared_mutex> lock(cache_.mutex_);
+      auto it = cache_.places_.find(place);
+      if (it != cache_.places_.end())
+      {
+        found = it->second;
+        known = true;
+      }
+    }
+    if (!known)
+    {
+      found = compile(definition, nested, place);
+    }
+    local_.push_back({local, found});
+    return found;
+  }
+
+  const EvtxPlan* compile(uint32_t definition, bool nested, uint64_t place)
+  {
+    std::unique_ptr<EvtxPlan> compiled;
+    uint64_t key = 0;
+    if (evtxTemplateAt(chunk_, definition))
+    {
+      uint32_t size = loadLE32(chunk_.data + definition + 20);
+      key = (uint64_t(crc32(chunk_.data + definition + 4, 20 + size)) << 32) | (size << 1) |
+            (nested ? 1 : 0);
+      compiled.reset(new EvtxPlan());
+      Compiler compiler(chunk_, nested, *compiled);
+      size_t start = definition + TEMPLATE_HEADER;
+      if (!compiler.run(start, start + size))
+      {
+        compiled.reset();
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(cache_.mutex_);
+    const EvtxPlan* found = nullptr;
+    if (compiled)
+    {
+      auto& slot = cache_.plans_[key];
+      if (!slot)
+      {
+        slot = std::move(compiled);
+      }
+      found = slot.get();
+    }
+    cache_.places_.emplace(place, found);
+    return found;
+  }
+
+  ByteView chunk_;
+  uint64_t offset_;
+  EvtxTemplateCache& cache_;
+  std::vector<std::vector<Value>> values_;  // per nesting level
+  std::vector<std::pair<uint64_t, const EvtxPlan*>> local_;
+};
+
+void EvtxStats::add(const EvtxStats& other)
+{
+  chunks += other.chunks;
+  bad_checksums += other.bad_checksums;
+  records += other.records;
+  stale += other.stale;
+  unresolved += other.unresolved;
+  damaged += other.damaged;
+}
+
+EvtxTemplateCache::EvtxTemplateCache() = default;
+
+EvtxTemplateCache::~EvtxTemplateCache() = default;
+
+size_t EvtxTemplateCache::templates() const
+{
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  return plans_.size();
+}
+
+bool evtxTemplateAt(ByteView chunk, uint32_t definition)
+{
+  if (definition < CHUNK_HEADER || definition >= chunk.size ||
+      chunk.size - definition < TEMPLATE_HEADER + 5)
+  {
+    return false;
+  }
+  const uint8_t* p = chunk.data + definition;
+  uint32_t size = loadLE32(p + 20);
+  return size >= 5 && size <= chunk.size - definition - TEMPLATE_HEADER &&
+         std::memcmp(p + TEMPLATE_HEADER, "\x0f\x01\x01\x00", 4) == 0 &&
+         p[TEMPLATE_HEADER + size - 1] == END_OF_FRAGMENT;
+}
+
+bool evtxChunkHeader(ByteView chunk)
+{
+  if (chunk.size < CHUNK_HEADER || !chunk.startsWith("ElfChnk\0", 8))
+  {
+    return false;
+  }
+  uint32_t checksum = crc32(chunk.data + 128, CHUNK_HEADER - 128, crc32(chunk.data, 120));
+  return checksum == loadLE32(chunk.data + 124);
+}
+
+bool decodeEvtxRecord(ByteView chunk, uint64_t offset, size_t at, EvtxTemplateCache& cache,
+                      EvtxEvent& event)
+{
+  EvtxDecoder decoder(chunk, offset, cache);
+  return decoder.record(at, event);
+}
+
+size_t decodeEvtxChunk(ByteView chunk, uint64_t offset, EvtxTemplateCache& cache,
+                       const EvtxSink& sink, EvtxStats* stats)
+{
+  if (chunk.size < CHUNK_HEADER || !chunk.startsWith("ElfChnk\0", 8))
+  {
+    return 0;
+  }
+  EvtxStats local;
+  local.chunks = 1;
+  local.bad_checksums = evtxChunkHeader(chunk) ? 0 : 1;
+  size_t free = loadLE32(chunk.data + 48);
+  if (free < CHUNK_HEADER || free > chunk.size)
+  {
+    free = chunk.size;
+  }
+  static const uint8_t MAGIC[4] = {0x2A, 0x2A, 0x00, 0x00};
+  EvtxDecoder decoder(chunk, offset, cache);
+  EvtxEvent event;
+  size_t at = CHUNK_HEADER;
+  while (chunk.size - at >= RECORD_HEADER)
+  {
+    if (loadLE32(chunk.data + at) == RECORD_MAGIC)
+    {
+      if (decoder.record(at, event))
+      {
+        event.stale = at >= free;
+        ++local.records;
+        local.stale += event.stale ? 1 : 0;
+        local.unresolved += event.resolved ? 0 : 1;
+        sink(event);
+        at += loadLE32(chunk.data + at + 4);
+        continue;
+      }
+      ++local.damaged;
+    }
+    size_t next = findBytes(chunk.sub(at + 1), MAGIC, sizeof(MAGIC));
+    if (next == SIZE_MAX)
+    {
+      break;
+    }
+    at += 1 + next;
+  }
+  if (stats != nullptr)
+  {
+    stats->add(local);
+  }
+  return static_cast<size_t>(local.records);
+}
+
+bool readEvtx(Device& device, const EvtxSink& sink, EvtxStats* stats, EvtxOptions options,
+              uint64_t offset, uint64_t size)
+{
+  uint64_t end = device.size();
+  if (size != 0)
+  {
+    end = std::min(end, offset + size);
+  }
+  uint8_t header[8];
+  if (offset >= end || end - offset < FILE_HEADER + CHUNK_HEADER ||
+      device.read(offset, header, sizeof(header)) != sizeof(header) ||
+      std::memcmp(header, "ElfFile\0", 8) != 0)
+  {
+    return false;
+  }
+  uint64_t first = offset + FILE_HEADER;
+  uint64_t chunks = (end - first + CHUNK - CHUNK_HEADER) / CHUNK;
+  unsigned threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+  threads = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(threads, chunks)));
+
+  EvtxTemplateCache cache;
+  std::atomic<uint64_t> next{0};
+  std::mutex stats_mutex;
+  EvtxStats total;
+  auto worker = [&]() {
+    std::vector<uint8_t> buffer(CHUNK);
+    EvtxStats local;
+    for (;;)
+    {
+      uint64_t index = next.fetch_add(1);
+      if (index >= chunks)
+      {
+        break;
+      }
+      uint64_t at = first + index * CHUNK;
+      size_t got = device.read(at, buffer.data(),
+                               static_cast<size_t>(std::min<uint64_t>(CHUNK, end - at)));
+      decodeEvtxChunk(ByteView(buffer.data(), got), at, cache, sink, &local);
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    total.add(local);
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+  {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : pool)
+  {
+    t.join();
+  }
+  if (stats != nullptr)
+  {
+    stats->add(total);
+  }
+  return true;
+}
+
+}  // namespace rsn
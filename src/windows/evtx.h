@@ -0,0 +1,139 @@
+// RecoverySoftNetz — Windows EVTX event log parser
+//
+// An EVTX file is a 4 KiB file header followed by 64 KiB chunks, each with a
+// 512-byte header (checksummed with CRC-32) and event records. A record holds
+// binary XML: a template instance, which names a template definition by its
+// offset in the chunk, and the array of typed substitution values that fill
+// it. A template is defined inline in the first record of the chunk that uses
+// it; later records only refer to it.
+//
+// Rendering every record to XML would cost far more than the fields a
+// timeline needs, so each template is compiled once into a plan: which
+// substitution (or literal) feeds EventID, Level, TimeCreated, Provider,
+// Channel, Computer and the other System fields, and which feeds each named
+// EventData or UserData item. A record is then decoded by reading its
+// substitution array and following the plan. Plans are shared by every chunk
+// through EvtxTemplateCache, keyed by the definition's content; each chunk
+// keeps its own offset-to-plan map, so the shared cache is consulted once per
+// template per chunk. Substitutions that are themselves binary XML (UserData,
+// classic EventData) are decoded through their own plans.
+//
+// Chunks decode independently: `readEvtx` streams a file through a pool of
+// workers, a chunk at a time. Damaged records are skipped by resynchronising
+// on the next record signature, and records past a chunk's free-space offset
+// (left from before the chunk was reused) are decoded too.
+
+#pragma once
+
+#include "common/utils.h"
+#include "core/device.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rsn
+{
+
+struct EvtxField
+{
+  std::string name;
+  std::string value;
+};
+
+struct EvtxEvent
+{
+  uint64_t offset = 0;        // of the record, on the device or in the file
+  uint64_t record_id = 0;
+  uint64_t written = 0;       // FILETIME from the record header
+  uint64_t time_created = 0;  // FILETIME from System/TimeCreated; 0 when absent
+  uint32_t event_id = 0;
+  uint8_t level = 0;
+  uint8_t opcode = 0;
+  uint16_t task = 0;
+  uint64_t keywords = 0;
+  uint32_t process_id = 0;
+  uint32_t thread_id = 0;
+  std::string provider;
+  std::string channel;
+  std::string computer;
+  std::string user;              // SID, S-1-5-...
+  std::vector<EvtxField> data;   // EventData and UserData items
+  bool resolved = false;         // the template was found; otherwise `data` holds the
+                                 // substitution values by index ("#0", "#1", ...)
+  bool stale = false;            // past the chunk's free-space offset
+};
+
+/// Called for every decoded record; must be thread-safe when chunks are
+/// decoded in parallel.
+using EvtxSink = std::function<void(const EvtxEvent& event)>;
+
+struct EvtxStats
+{
+  uint64_t chunks = 0;
+  uint64_t bad_checksums = 0;  // chunks whose header checksum fails
+  uint64_t records = 0;
+  uint64_t stale = 0;          // records past a chunk's free-space offset
+  uint64_t unresolved = 0;     // records whose template was not found
+  uint64_t damaged = 0;        // record signatures that did not parse
+
+  void add(const EvtxStats& other);
+};
+
+struct EvtxPlan;
+
+/// Compiled templates, shared by every chunk and thread of a scan.
+class EvtxTemplateCache
+{
+public:
+  EvtxTemplateCache();
+  ~EvtxTemplateCache();
+
+  size_t templates() const;
+
+private:
+  friend class EvtxDecoder;
+
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<uint64_t, std::unique_ptr<EvtxPlan>> plans_;  // by definition content
+  std::unordered_map<uint64_t, const EvtxPlan*> places_;  // by position; nullptr = no template
+};
+
+/// Whether `chunk` starts with a chunk header whose checksum holds.
+bool evtxChunkHeader(ByteView chunk);
+
+/// Decode the records of a chunk. `chunk` starts at the chunk header and may
+/// be shorter than 64 KiB when the chunk is partial; `offset` is where it
+/// lies. Returns the records delivered, or 0 when there is no chunk header.
+size_t decodeEvtxChunk(ByteView chunk, uint64_t offset, EvtxTemplateCache& cache,
+                       const EvtxSink& sink, EvtxStats* stats = nullptr);
+
+/// Decode the record at `at` of `chunk`, a view from where the record's chunk
+/// starts (at `offset`) up to at least the end of the record. Templates are
+/// looked up at their offsets in `chunk`; a record whose template is not
+/// there is decoded unresolved. False when the record does not parse.
+bool decodeEvtxRecord(ByteView chunk, uint64_t offset, size_t at, EvtxTemplateCache& cache,
+                      EvtxEvent& event);
+
+/// Whether a template definition starts at `definition` of `chunk`: its
+/// header, a fragment header and an end-of-fragment token where the size
+/// puts it.
+bool evtxTemplateAt(ByteView chunk, uint32_t definition);
+
+struct EvtxOptions
+{
+  unsigned threads = 0;  // 0 = hardware concurrency
+};
+
+/// Decode every chunk of the EVTX file at `offset` of `device` (`size` = 0:
+/// to the end of the device), the last one even when partial. Chunks past
+/// the count in the file header are decoded as well. False when there is no
+/// file header.
+bool readEvtx(Device& device, const EvtxSink& sink, EvtxStats* stats = nullptr,
+              EvtxOptions options = EvtxOptions(), uint64_t offset = 0, uint64_t size = 0);
+
+}  // namespace rsn
@@ -0,0 +1,172 @@
+// RecoverySoftNetz — EVTX chunk and record carve stage
+
+#include "windows/evtx_carver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t CHUNK = 65536;
+constexpr size_t CHUNK_HEADER = 512;
+constexpr size_t RECORD_HEADER = 24;
+constexpr size_t MIN_RECORD = RECORD_HEADER + 4 + 10 + 4 + 4;  // fragment, instance, count, size
+constexpr size_t DEFINITION = RECORD_HEADER + 4 + 6;  // template instance's definition offset
+constexpr size_t INLINE_DEFINITION = RECORD_HEADER + 4 + 10;
+constexpr uint64_t NO_BASE = UINT64_MAX;
+
+const uint8_t CHUNK_SIGNATURE[] = {'E', 'l', 'f', 'C', 'h', 'n', 'k', 0};
+const uint8_t RECORD_SIGNATURE[] = {0x2A, 0x2A, 0x00, 0x00};
+
+}  // namespace
+
+void EvtxCarveStage::registerPatterns(PatternSet& patterns)
+{
+  patterns.add(CHUNK_SIGNATURE, sizeof(CHUNK_SIGNATURE), TAG_CHUNK);
+  patterns.add(RECORD_SIGNATURE, sizeof(RECORD_SIGNATURE), TAG_RECORD);
+}
+
+bool EvtxCarveStage::onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  return tag == TAG_CHUNK ? chunkHit(pos, chunk, ctx) : recordHit(pos, chunk, ctx);
+}
+
+bool EvtxCarveStage::chunkHit(size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  uint64_t offset = chunk.offset + pos;
+  ByteView view = chunk.view().sub(pos, CHUNK);
+  SecureBytes buffer;
+  if (view.size < CHUNK)
+  {
+    buffer = ctx.readAt(offset, CHUNK);
+    view = ByteView(buffer.data(), buffer.size());
+  }
+  if (!evtxChunkHeader(view))
+  {
+    return false;  // its records are carved one by one
+  }
+  EvtxStats stats;
+  decodeEvtxChunk(view, offset, cache_, sink_, &stats);
+  chunks_.fetch_add(1, std::memory_order_relaxed);
+  records_.fetch_add(stats.records, std::memory_order_relaxed);
+  unresolved_.fetch_add(stats.unresolved, std::memory_order_relaxed);
+  return true;
+}
+
+bool EvtxCarveStage::recordHit(size_t pos, const ChunkView& chunk, CarveContext& ctx)
+{
+  uint64_t offset = chunk.offset + pos;
+  if (chunk.size - pos < RECORD_HEADER || offset < CHUNK_HEADER)
+  {
+    return false;
+  }
+  uint32_t size = loadLE32(chunk.data + pos + 4);
+  if (size < MIN_RECORD || size > CHUNK - CHUNK_HEADER)
+  {
+    return false;
+  }
+
+  // Every position the record's chunk can start at, up to the record's end.
+  uint64_t align = std::max<uint32_t>(options_.chunk_alignment, 1);
+  uint64_t last = (offset - CHUNK_HEADER) / align * align;
+  uint64_t lowest = offset + size > CHUNK ? offset + size - CHUNK : 0;
+  uint64_t first = (lowest + align - 1) / align * align;
+  if (first > last)
+  {
+    first = offset;  // no aligned position: the record alone
+  }
+  uint64_t end = offset + size;
+  SecureBytes buffer;
+  ByteView window;
+  if (first >= chunk.offset && end <= chunk.offset + chunk.size)
+  {
+    window = ByteView(chunk.data + (first - chunk.offset), static_cast<size_t>(end - first));
+  }
+  else
+  {
+    buffer = ctx.readAt(first, static_cast<size_t>(end - first));
+    if (buffer.size() != end - first)
+    {
+      return false;
+    }
+    window = ByteView(buffer.data(), buffer.size());
+  }
+  ByteView record = window.sub(static_cast<size_t>(offset - first));
+  if (loadLE32(record.data + size - 4) != size ||
+      std::memcmp(record.data + RECORD_HEADER, "\x0f\x01\x01\x00\x0c", 5) != 0)
+  {
+    return false;
+  }
+
+  // A chunk header that checks out is decoded with its chunk; one that does
+  // not still gives the base.
+  uint64_t base = NO_BASE;
+  for (uint64_t b = last; first <= last && b >= first; b -= align)
+  {
+    ByteView candidate = window.sub(static_cast<size_t>(b - first));
+    if (candidate.startsWith("ElfChnk\0", 8))
+    {
+      if (evtxChunkHeader(candidate))
+      {
+        return true;
+      }
+      base = base == NO_BASE ? b : base;
+    }
+    if (b < align)
+    {
+      break;
+    }
+  }
+  uint32_t definition = loadLE32(record.data + DEFINITION);
+  if (base == NO_BASE && offset + INLINE_DEFINITION >= definition)
+  {
+    uint64_t b = offset + INLINE_DEFINITION - definition;
+    if (b >= first && b + CHUNK_HEADER <= offset &&
+        evtxTemplateAt(window.sub(static_cast<size_t>(b - first)), definition))
+    {
+      base = b;
+    }
+  }
+  for (uint64_t b = last; base == NO_BASE && first <= last && b >= first; b -= align)
+  {
+    if (b + definition < offset && evtxTemplateAt(window.sub(static_cast<size_t>(b - first)),
+                                                  definition))
+    {
+      base = b;
+    }
+    if (b < align)
+    {
+      break;
+    }
+  }
+
+  EvtxEvent event;
+  bool decoded;
+  if (base != NO_BASE)
+  {
+    decoded = decodeEvtxRecord(window.sub(static_cast<size_t>(base - first)), base,
+                               static_cast<size_t>(offset - base), cache_, event);
+  }
+  else
+  {
+    // Nothing to look the template up in; a cache of its own keeps the
+    // misses out of the shared one.
+    EvtxTemplateCache none;
+    decoded = decodeEvtxRecord(record, offset, 0, none, event);
+  }
+  if (!decoded)
+  {
+    return false;
+  }
+  carved_.fetch_add(1, std::memory_order_relaxed);
+  unresolved_.fetch_add(event.resolved ? 0 : 1, std::memory_order_relaxed);
+  sink_(event);
+  return true;
+}
+
+}  // namespace rsn
@@ -0,0 +1,73 @@
+// RecoverySoftNetz — EVTX chunk and record carve stage
+//
+// Event logs are rarely whole on a damaged or reformatted volume, but their
+// 64 KiB chunks are self-contained, and so, nearly, are their records. The
+// stage matches chunk headers and record signatures:
+//   - a chunk header whose checksum holds is decoded as a whole (evtx.h),
+//     partial or not, and the record signatures inside it are left to it;
+//   - any other record is decoded on its own. Its template is defined at an
+//     offset from its chunk's start, which is lost, so the start is
+//     inferred: from a chunk header that is there but fails its checksum, from
+//     the record's own offset when the template is defined inline, or as the
+//     nearest chunk-aligned position the template definition is found from.
+//     A record whose template is not found is delivered unresolved, with its
+//     substitution values by index.
+// Records go to the sink as the scan finds them; no file is registered.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+#include "windows/evtx.h"
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace rsn
+{
+
+struct EvtxCarveOptions
+{
+  uint32_t chunk_alignment = 512;  // where a carved record's chunk may start
+};
+
+class EvtxCarveStage : public CarveStage
+{
+public:
+  /// `sink` is called from worker threads.
+  explicit EvtxCarveStage(EvtxSink sink, EvtxCarveOptions options = EvtxCarveOptions())
+    : sink_(std::move(sink)), options_(options)
+  {
+  }
+
+  const char* name() const override { return "evtx"; }
+  void registerPatterns(PatternSet& patterns) override;
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override;
+  size_t lookahead() const override { return 64u << 10; }
+
+  uint64_t chunks() const { return chunks_.load(); }          // decoded whole
+  uint64_t records() const { return records_.load(); }        // from those chunks
+  uint64_t carved() const { return carved_.load(); }          // decoded on their own
+  uint64_t unresolved() const { return unresolved_.load(); }  // ... without their template
+  uint64_t templates() const { return cache_.templates(); }
+
+private:
+  enum Tag : uint32_t
+  {
+    TAG_CHUNK,
+    TAG_RECORD,
+  };
+
+  bool chunkHit(size_t pos, const ChunkView& chunk, CarveContext& ctx);
+  bool recordHit(size_t pos, const ChunkView& chunk, CarveContext& ctx);
+
+  EvtxSink sink_;
+  EvtxCarveOptions options_;
+  EvtxTemplateCache cache_;
+  std::atomic<uint64_t> chunks_{0};
+  std::atomic<uint64_t> records_{0};
+  std::atomic<uint64_t> carved_{0};
+  std::atomic<uint64_t> unresolved_{0};
+};
+
+}  // namespace rsn
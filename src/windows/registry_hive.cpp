@@ -0,0 +1,938 @@
+// RecoverySoftNetz — Windows registry hive parser
+
+#include "windows/registry_hive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
+namespace rsn
+{
+
+namespace
+{
+
+constexpr size_t BASE_BLOCK = 4096;
+constexpr uint32_t PAGE = 4096;
+constexpr uint32_t BIN_HEADER = 32;
+constexpr uint32_t MAX_BINS = 0x7FFFF000;  // cell offsets are 31-bit
+constexpr uint32_t NONE = UINT32_MAX;
+
+constexpr size_t KEY_NODE = 76;   // fixed part of an nk record
+constexpr size_t KEY_VALUE = 20;  // fixed part of a vk record
+constexpr uint16_t KEY_HIVE_ENTRY = 0x0004;
+constexpr uint16_t KEY_COMP_NAME = 0x0020;
+constexpr uint16_t VALUE_COMP_NAME = 0x0001;
+constexpr uint32_t DATA_INLINE = 0x80000000u;
+constexpr uint32_t BIG_SEGMENT = 16344;  // data bytes per db segment
+constexpr unsigned MAX_LIST_LEVELS = 4;  // ri lists of ri lists
+
+constexpr size_t LOG_BASE_BLOCK = 512;
+constexpr size_t LOG_ENTRY = 40;  // HvLE header
+constexpr uint32_t LOG_SECTOR = 512;
+constexpr uint32_t LOG_NEW_FORMAT = 6;
+constexpr uint64_t MARVIN_SEED = 0x82EF4D887A4E55C5ull;
+constexpr uint64_t MAX_HIVE = 1ull << 31;
+
+/// One name character as UTF-8; control characters and the path separator
+/// become '_'.
+void appendNameChar(std::string& out, uint32_t cp)
+{
+  if (cp < 0x20 || cp == '\\')
+  {
+    out += '_';
+  }
+  else
+  {
+    appendUtf8(out, cp);
+  }
+}
+
+/// A key or value name: Latin-1 when compressed, UTF-16LE otherwise. Stops at
+/// a NUL.
+std::string decodeName(const uint8_t* p, size_t size, bool compressed)
+{
+  std::string out;
+  if (compressed)
+  {
+    for (size_t i = 0; i < size && p[i] != 0; ++i)
+    {
+      appendNameChar(out, p[i]);
+    }
+    return out;
+  }
+  for (size_t i = 0; i + 1 < size; i += 2)
+  {
+    uint32_t cp = loadLE16(p + i);
+    if (cp == 0)
+    {
+      break;
+    }
+    if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < size)
+    {
+      uint32_t low = loadLE16(p + i + 2);
+      if (low >= 0xDC00 && low < 0xE000)
+      {
+        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        i += 2;
+      }
+    }
+    appendNameChar(out, cp);
+  }
+  return out;
+}
+
+uint32_t baseBlockChecksum(const uint8_t* block)
+{
+  uint32_t sum = 0;
+  for (size_t i = 0; i < 508; i += 4)
+  {
+    sum ^= loadLE32(block + i);
+  }
+  return sum == 0xFFFFFFFFu ? 0xFFFFFFFEu : sum == 0 ? 1 : sum;
+}
+
+inline uint32_t rotl32(uint32_t v, unsigned n)
+{
+  return (v << n) | (v >> (32 - n));
+}
+
+/// Marvin32 as the new log format hashes its entries.
+uint64_t marvin32(const uint8_t* p, size_t size)
+{
+  uint32_t lo = static_cast<uint32_t>(MARVIN_SEED);
+  uint32_t hi = static_cast<uint32_t>(MARVIN_SEED >> 32);
+  auto mix = [&]() {
+    hi ^= lo;
+    lo = rotl32(lo, 20) + hi;
+    hi = rotl32(hi, 9) ^ lo;
+    lo = rotl32(lo, 27) + hi;
+    hi = rotl32(hi, 19);
+  };
+  for (; size >= 4; size -= 4, p += 4)
+  {
+    lo += loadLE32(p);
+    mix();
+  }
+  uint32_t tail = 0x80;
+  if (size == 1)
+  {
+    tail = 0x8000u | p[0];
+  }
+  else if (size == 2)
+  {
+    tail = 0x800000u | loadLE16(p);
+  }
+  else if (size == 3)
+  {
+    tail = 0x80000000u | (static_cast<uint32_t>(p[2]) << 16) | loadLE16(p);
+  }
+  lo += tail;
+  mix();
+  mix();
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+/// Visit the cells of the bin at `bin`: (offset, allocated, length). False
+/// when a cell header is broken; the rest of the bin is then skipped.
+template <typename F>
+bool walkCells(const uint8_t* bins, uint32_t bin, uint32_t size, F&& visit)
+{
+  uint32_t end = bin + size;
+  for (uint32_t at = bin + BIN_HEADER; at < end;)
+  {
+    auto raw = static_cast<int32_t>(loadLE32(bins + at));
+    uint32_t length = raw < 0 ? static_cast<uint32_t>(-static_cast<int64_t>(raw))
+                              : static_cast<uint32_t>(raw);
+    if (length < 8 || length % 8 != 0 || length > end - at)
+    {
+      return false;
+    }
+    visit(at, raw < 0, length);
+    at += length;
+  }
+  return true;
+}
+
+/// The record of the cell at `offset` within a run of hive bytes starting at
+/// `base`, free or not; empty when it does not fit.
+ByteView regionCell(const uint8_t* region, size_t length, uint32_t base, uint32_t offset)
+{
+  if (offset < base || offset % 8 != 0 || offset - base > length || length - (offset - base) < 8)
+  {
+    return ByteView();
+  }
+  const uint8_t* p = region + (offset - base);
+  auto raw = static_cast<int32_t>(loadLE32(p));
+  uint64_t size = raw < 0 ? static_cast<uint64_t>(-static_cast<int64_t>(raw))
+                          : static_cast<uint64_t>(raw);
+  if (size < 8 || size > length - (offset - base))
+  {
+    return ByteView();
+  }
+  return ByteView(p + 4, static_cast<size_t>(size - 4));
+}
+
+bool parseKey(ByteView record, RegistryKey& key)
+{
+  if (record.size < KEY_NODE || !record.startsWith("nk", 2))
+  {
+    return false;
+  }
+  size_t name_size = loadLE16(record.data + 72);
+  if (name_size == 0 || name_size > record.size - KEY_NODE)
+  {
+    return false;
+  }
+  uint16_t flags = loadLE16(record.data + 2);
+  key.name = decodeName(record.data + KEY_NODE, name_size, (flags & KEY_COMP_NAME) != 0);
+  key.last_written = loadLE64(record.data + 4);
+  key.parent = loadLE32(record.data + 16);
+  key.subkeys = loadLE32(record.data + 20);
+  key.values = loadLE32(record.data + 36);
+  return true;
+}
+
+bool parseValue(ByteView record, RegistryValue& value)
+{
+  if (record.size < KEY_VALUE || !record.startsWith("vk", 2))
+  {
+    return false;
+  }
+  size_t name_size = loadLE16(record.data + 2);
+  if (name_size > record.size - KEY_VALUE)
+  {
+    return false;
+  }
+  uint16_t flags = loadLE16(record.data + 16);
+  value.name = decodeName(record.data + KEY_VALUE, name_size, (flags & VALUE_COMP_NAME) != 0);
+  value.type = loadLE32(record.data + 12);
+  uint32_t size = loadLE32(record.data + 4);
+  value.size = size & ~DATA_INLINE;
+  if ((size & DATA_INLINE) != 0)
+  {
+    value.size = std::min<uint32_t>(value.size, 4);
+    value.data = record.sub(8, value.size);
+  }
+  return true;
+}
+
+/// Point `value` at its data cell (or mark it big), once parsed.
+void attachData(ByteView target, uint32_t minor, RegistryValue& value)
+{
+  if (!value.data.empty() || value.size == 0)
+  {
+    return;
+  }
+  if (minor >= 4 && value.size > BIG_SEGMENT && target.startsWith("db", 2))
+  {
+    value.big = true;
+  }
+  else if (target.size >= value.size)
+  {
+    value.data = target.sub(0, value.size);
+  }
+}
+
+struct LogPage
+{
+  uint32_t offset = 0;  // from the first hive bin
+  const uint8_t* data = nullptr;
+  uint32_t size = 0;
+};
+
+struct LogEntry
+{
+  uint32_t sequence = 0;
+  uint32_t bins_size = 0;
+  std::vector<LogPage> pages;
+};
+
+/// The entries of a transaction log that verify, in file order. The earlier
+/// format holds one: a dirty vector over 512-byte sectors of the hive bins.
+std::vector<LogEntry> readLog(const uint8_t* log, size_t size)
+{
+  std::vector<LogEntry> entries;
+  if (size < LOG_BASE_BLOCK || std::memcmp(log, "regf", 4) != 0)
+  {
+    return entries;
+  }
+  if (loadLE32(log + 28) == LOG_NEW_FORMAT)
+  {
+    for (size_t at = LOG_BASE_BLOCK; size - at >= LOG_ENTRY;)
+    {
+      const uint8_t* e = log + at;
+      uint32_t length = loadLE32(e + 4);
+      uint32_t count = loadLE32(e + 20);
+      if (std::memcmp(e, "HvLE", 4) != 0 || length < LOG_ENTRY || length % LOG_SECTOR != 0 ||
+          length > size - at || count > (length - LOG_ENTRY) / 8 ||
+          marvin32(e, 32) != loadLE64(e + 32) ||
+          marvin32(e + LOG_ENTRY, length - LOG_ENTRY) != loadLE64(e + 24))
+      {
+        break;
+      }
+      LogEntry entry;
+      entry.sequence = loadLE32(e + 12);
+      entry.bins_size = loadLE32(e + 16);
+      size_t data = LOG_ENTRY + size_t(count) * 8;
+      bool valid = true;
+      for (uint32_t i = 0; i < count && valid; ++i)
+      {
+        LogPage page;
+        page.offset = loadLE32(e + LOG_ENTRY + i * 8);
+        page.size = loadLE32(e + LOG_ENTRY + i * 8 + 4);
+        page.data = e + data;
+        valid = page.size != 0 && page.size % PAGE == 0 && page.offset % PAGE == 0 &&
+                page.size <= length - data && page.offset <= entry.bins_size &&
+                page.size <= entry.bins_size - page.offset;
+        data += page.size;
+        entry.pages.push_back(page);
+      }
+      if (!valid)
+      {
+        break;
+      }
+      entries.push_back(std::move(entry));
+      at += length;
+    }
+    return entries;
+  }
+  if (size < LOG_BASE_BLOCK + 4 || baseBlockChecksum(log) != loadLE32(log + 508) ||
+      std::memcmp(log + LOG_BASE_BLOCK, "DIRT", 4) != 0)
+  {
+    return entries;
+  }
+  LogEntry entry;
+  entry.sequence = loadLE32(log + 4);
+  entry.bins_size = loadLE32(log + 40);
+  size_t sectors = entry.bins_size / LOG_SECTOR;
+  size_t bitmap = LOG_BASE_BLOCK + 4;
+  if ((sectors + 7) / 8 > size - bitmap)
+  {
+    return entries;
+  }
+  size_t data = (bitmap + (sectors + 7) / 8 + LOG_SECTOR - 1) / LOG_SECTOR * LOG_SECTOR;
+  auto dirty = [&](size_t s) { return (log[bitmap + s / 8] >> (s % 8)) & 1; };
+  for (size_t s = 0; s < sectors;)
+  {
+    if (!dirty(s))
+    {
+      ++s;
+      continue;
+    }
+    size_t run = 1;
+    while (s + run < sectors && dirty(s + run))
+    {
+      ++run;
+    }
+    if (data > size || run * LOG_SECTOR > size - data)
+    {
+      return entries;
+    }
+    LogPage page;
+    page.offset = static_cast<uint32_t>(s * LOG_SECTOR);
+    page.size = static_cast<uint32_t>(run * LOG_SECTOR);
+    page.data = log + data;
+    entry.pages.push_back(page);
+    data += run * LOG_SECTOR;
+    s += run;
+  }
+  entries.push_back(std::move(entry));
+  return entries;
+}
+
+bool readFile(const std::string& path, std::vector<uint8_t>& out)
+{
+  auto device = ImageFileDevice::open(path);
+  if (!device || device->size() > MAX_HIVE)
+  {
+    return false;
+  }
+  out.resize(static_cast<size_t>(device->size()));
+  out.resize(device->read(0, out.data(), out.size()));
+  return !out.empty();
+}
+
+}  // namespace
+
+std::unique_ptr<RegistryHive> RegistryHive::open(const uint8_t* data, size_t size)
+{
+  std::unique_ptr<RegistryHive> hive(new RegistryHive());
+  if (!hive->parse(data, size))
+  {
+    return nullptr;
+  }
+  return hive;
+}
+
+std::unique_ptr<RegistryHive> RegistryHive::load(Device& device, uint64_t offset, uint64_t size)
+{
+  if (offset >= device.size())
+  {
+    return nullptr;
+  }
+  uint64_t available = std::min(device.size() - offset, MAX_HIVE);
+  if (size == 0)
+  {
+    size = available;
+    uint8_t block[BASE_BLOCK];
+    if (device.read(offset, block, sizeof(block)) == sizeof(block) &&
+        std::memcmp(block, "regf", 4) == 0 && loadLE32(block + 40) % PAGE == 0 &&
+        loadLE32(block + 40) != 0)
+    {
+      size = std::min<uint64_t>(available, BASE_BLOCK + uint64_t(loadLE32(block + 40)));
+    }
+  }
+  std::unique_ptr<RegistryHive> hive(new RegistryHive());
+  hive->owned_.resize(static_cast<size_t>(std::min(size, available)));
+  hive->owned_.resize(device.read(offset, hive->owned_.data(), hive->owned_.size()));
+  if (!hive->parse(hive->owned_.data(), hive->owned_.size()))
+  {
+    return nullptr;
+  }
+  return hive;
+}
+
+bool RegistryHive::parse(const uint8_t* data, size_t size)
+{
+  data_ = data;
+  size_ = size;
+  uint64_t available = 0;
+  if (size >= BASE_BLOCK && std::memcmp(data, "regf", 4) == 0)
+  {
+    stats_.base_block = true;
+    stats_.checksum_ok = baseBlockChecksum(data) == loadLE32(data + 508);
+    primary_ = loadLE32(data + 4);
+    secondary_ = loadLE32(data + 8);
+    stats_.dirty = primary_ != secondary_;
+    minor_ = loadLE32(data + 24);
+    root_ = loadLE32(data + 36);
+    file_name_ = decodeName(data + 48, 64, false);
+    bins_ = BASE_BLOCK;
+    available = (size - BASE_BLOCK) / PAGE * PAGE;
+    uint32_t declared = loadLE32(data + 40);
+    if (declared != 0 && declared % PAGE == 0 && declared <= available)
+    {
+      available = declared;
+    }
+  }
+  else if (size >= PAGE && std::memcmp(data, "hbin", 4) == 0 && loadLE32(data + 4) == 0)
+  {
+    bins_ = 0;
+    available = size / PAGE * PAGE;
+  }
+  else
+  {
+    return false;
+  }
+  bins_size_ = static_cast<uint32_t>(std::min<uint64_t>(available, MAX_BINS));
+  findBins();
+  if (!stats_.base_block && !bin_list_.empty())
+  {
+    // A carved hive ends with its last bin.
+    bins_size_ = bin_list_.back().first + bin_list_.back().second;
+  }
+  RegistryKey root;
+  if (!parseKey(cell(root_), root))
+  {
+    root_ = findRoot();
+  }
+  return !bin_list_.empty();
+}
+
+void RegistryHive::findBins()
+{
+  bin_list_.clear();
+  stats_.bins = 0;
+  stats_.damaged_bins = 0;
+  const uint8_t* bins = data_ + bins_;
+  for (uint32_t at = 0; bins_size_ - at >= PAGE;)
+  {
+    const uint8_t* p = bins + at;
+    uint32_t size = loadLE32(p + 8);
+    if (std::memcmp(p, "hbin", 4) != 0 || size < PAGE || size % PAGE != 0 ||
+        size > bins_size_ - at)
+    {
+      ++stats_.damaged_bins;
+      at += PAGE;
+      continue;
+    }
+    bin_list_.push_back({at, size});
+    ++stats_.bins;
+    if (!walkCells(bins, at, size, [](uint32_t, bool, uint32_t) {}))
+    {
+      ++stats_.damaged_bins;
+    }
+    at += size;
+  }
+}
+
+uint32_t RegistryHive::findRoot() const
+{
+  const uint8_t* bins = data_ + bins_;
+  uint32_t root = NONE;
+  for (const auto& bin : bin_list_)
+  {
+    walkCells(bins, bin.first, bin.second, [&](uint32_t at, bool allocated, uint32_t length) {
+      if (root == NONE && allocated && length >= 4 + KEY_NODE &&
+          std::memcmp(bins + at + 4, "nk", 2) == 0 &&
+          (loadLE16(bins + at + 6) & KEY_HIVE_ENTRY) != 0)
+      {
+        root = at;
+      }
+    });
+    if (root != NONE)
+    {
+      break;
+    }
+  }
+  return root;
+}
+
+ByteView RegistryHive::cell(uint32_t offset, bool allow_free) const
+{
+  ByteView record = regionCell(data_ + bins_, bins_size_, 0, offset);
+  if (!record.empty() && !allow_free && static_cast<int32_t>(loadLE32(record.data - 4)) >= 0)
+  {
+    return ByteView();
+  }
+  return record;
+}
+
+bool RegistryHive::liveRecord(uint32_t offset, ByteView record) const
+{
+  ByteView live = cell(offset);
+  return live.size == record.size && std::memcmp(live.data, record.data, record.size) == 0;
+}
+
+void RegistryHive::subkeys(uint32_t list, unsigned level, std::vector<uint32_t>& out) const
+{
+  ByteView node = cell(list);
+  if (node.size < 4)
+  {
+    return;
+  }
+  bool index = node.startsWith("ri", 2);
+  size_t stride = node.startsWith("lf", 2) || node.startsWith("lh", 2) ? 8 : 4;
+  if (!index && stride == 4 && !node.startsWith("li", 2))
+  {
+    return;
+  }
+  size_t count = std::min<size_t>(loadLE16(node.data + 2), (node.size - 4) / stride);
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint32_t offset = loadLE32(node.data + 4 + i * stride);
+    if (!index)
+    {
+      out.push_back(offset);
+    }
+    else if (level < MAX_LIST_LEVELS)
+    {
+      subkeys(offset, level + 1, out);
+    }
+  }
+}
+
+bool RegistryHive::report(uint32_t offset, ByteView record)
+{
+  return seen_.insert((uint64_t(offset) << 32) | crc32(record.data, record.size)).second;
+}
+
+void RegistryHive::scan(const RegistryScanOptions& options)
+{
+  keys_.clear();
+  values_.clear();
+  seen_.clear();
+  walk(options);
+  if (options.deleted)
+  {
+    scanFree();
+  }
+  resolvePaths(0);
+}
+
+void RegistryHive::walk(const RegistryScanOptions& options)
+{
+  struct Pending
+  {
+    uint32_t cell;
+    uint32_t parent;  // index into keys_
+    unsigned depth;
+  };
+  std::vector<bool> visited(bins_size_ / 8, false);
+  std::vector<Pending> stack;
+  std::vector<uint32_t> children;
+  if (root_ != NONE)
+  {
+    stack.push_back({root_, NONE, 0});
+  }
+  while (!stack.empty())
+  {
+    Pending next = stack.back();
+    stack.pop_back();
+    ByteView node = cell(next.cell);
+    RegistryKey key;
+    if (!parseKey(node, key) || visited[next.cell / 8])
+    {
+      continue;
+    }
+    visited[next.cell / 8] = true;
+    key.cell = next.cell;
+    if (next.parent != NONE)
+    {
+      const std::string& parent = keys_[next.parent].path;
+      key.path = parent.empty() ? key.name : parent + '\\' + key.name;
+    }
+    auto index = static_cast<uint32_t>(keys_.size());
+    keys_.push_back(std::move(key));
+    addValues(index, node, RegistrySource::Live);
+    if (next.depth >= options.max_depth)
+    {
+      continue;
+    }
+    children.clear();
+    subkeys(loadLE32(node.data + 28), 0, children);
+    for (auto it = children.rbegin(); it != children.rend(); ++it)
+    {
+      stack.push_back({*it, index, next.depth + 1});
+    }
+  }
+}
+
+void RegistryHive::addValues(uint32_t key, ByteView node, RegistrySource source)
+{
+  bool live = source == RegistrySource::Live;
+  ByteView list = cell(loadLE32(node.data + 40), !live);
+  size_t count = std::min<size_t>(loadLE32(node.data + 36), list.size / 4);
+  // A live list may keep a deleted value past its count, in the cell's slack.
+  size_t slots = live ? list.size / 4 : count;
+  for (size_t i = 0; i < slots; ++i)
+  {
+    uint32_t offset = loadLE32(list.data + i * 4);
+    bool freed = !live || i >= count;
+    ByteView record = cell(offset, freed);
+    RegistryValue value;
+    if (freed && !cell(offset).empty())
+    {
+      continue;  // reused since
+    }
+    if (!parseValue(record, value) || (freed && !report(offset, record)))
+    {
+      continue;
+    }
+    attachData(cell(loadLE32(record.data + 8), freed), minor_, value);
+    value.key = key;
+    value.cell = offset;
+    value.source = freed ? RegistrySource::FreeCell : RegistrySource::Live;
+    values_.push_back(std::move(value));
+  }
+}
+
+void RegistryHive::scanFree()
+{
+  // Keys first, so that values reached through a deleted key's list are
+  // attached to it before the search reports the rest on their own.
+  const uint8_t* bins = data_ + bins_;
+  for (bool keys : {true, false})
+  {
+    for (const auto& bin : bin_list_)
+    {
+      walkCells(bins, bin.first, bin.second, [&](uint32_t at, bool allocated, uint32_t length) {
+        if (!allocated)
+        {
+          searchRegion(bins + at, length, at, RegistrySource::FreeCell, keys);
+        }
+      });
+    }
+  }
+}
+
+void RegistryHive::searchRegion(const uint8_t* region, size_t length, uint32_t offset,
+                                RegistrySource source, bool keys)
+{
+  const char* signature = keys ? "nk" : "vk";
+  for (size_t p = 0; p + 4 + KEY_VALUE <= length; p += 8)
+  {
+    if (std::memcmp(region + p + 4, signature, 2) != 0)
+    {
+      continue;
+    }
+    auto at = static_cast<uint32_t>(offset + p);
+    ByteView record = regionCell(region, length, offset, at);
+    if (record.empty() || (source == RegistrySource::Log && liveRecord(at, record)))
+    {
+      continue;
+    }
+    if (keys)
+    {
+      RegistryKey key;
+      if (!parseKey(record, key) || !report(at, record))
+      {
+        continue;
+      }
+      key.cell = at;
+      key.source = source;
+      auto index = static_cast<uint32_t>(keys_.size());
+      keys_.push_back(std::move(key));
+      if (source == RegistrySource::FreeCell)
+      {
+        addValues(index, record, source);
+      }
+      continue;
+    }
+    RegistryValue value;
+    if (!parseValue(record, value) || !report(at, record))
+    {
+      continue;
+    }
+    // A log page's data is only known when it is on the same page image.
+    uint32_t data = loadLE32(record.data + 8);
+    attachData(source == RegistrySource::Log ? regionCell(region, length, offset, data)
+                                             : cell(data, true),
+               minor_, value);
+    value.cell = at;
+    value.source = source;
+    values_.push_back(std::move(value));
+  }
+}
+
+void RegistryHive::resolvePaths(size_t first)
+{
+  // Live keys come first, so a cell a deleted key shared with a live one
+  // resolves to the live key.
+  std::unordered_map<uint32_t, size_t> by_cell;
+  for (size_t i = 0; i < keys_.size(); ++i)
+  {
+    by_cell.emplace(keys_[i].cell, i);
+  }
+  std::vector<size_t> chain;
+  for (size_t i = first; i < keys_.size(); ++i)
+  {
+    RegistryKey& key = keys_[i];
+    if (key.source == RegistrySource::Live)
+    {
+      continue;
+    }
+    chain.clear();
+    key.orphan = true;
+    std::string prefix;
+    uint32_t parent = key.parent;
+    for (unsigned depth = 0; depth < 512; ++depth)
+    {
+      auto it = by_cell.find(parent);
+      if (it == by_cell.end() || it->second == i ||
+          std::find(chain.begin(), chain.end(), it->second) != chain.end())
+      {
+        break;
+      }
+      const RegistryKey& up = keys_[it->second];
+      if (up.source == RegistrySource::Live)
+      {
+        prefix = up.path;
+        key.orphan = false;
+        break;
+      }
+      chain.push_back(it->second);
+      parent = up.parent;
+    }
+    key.path = prefix;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+      key.path += key.path.empty() ? keys_[*it].name : '\\' + keys_[*it].name;
+    }
+    key.path += key.path.empty() ? key.name : '\\' + key.name;
+  }
+  stats_.keys = stats_.values = 0;
+  stats_.deleted_keys = stats_.deleted_values = 0;
+  stats_.log_keys = stats_.log_values = 0;
+  for (const RegistryKey& key : keys_)
+  {
+    ++(key.source == RegistrySource::Live       ? stats_.keys
+       : key.source == RegistrySource::FreeCell ? stats_.deleted_keys
+                                                 : stats_.log_keys);
+  }
+  for (const RegistryValue& value : values_)
+  {
+    ++(value.source == RegistrySource::Live       ? stats_.values
+       : value.source == RegistrySource::FreeCell ? stats_.deleted_values
+                                                   : stats_.log_values);
+  }
+}
+
+size_t RegistryHive::replayLog(const uint8_t* log, size_t size)
+{
+  std::vector<LogEntry> entries = readLog(log, size);
+  stats_.log_entries += entries.size();
+  size_t written = 0;
+  uint32_t next = 0;
+  for (const LogEntry& entry : entries)
+  {
+    // Entries the hive already holds are passed over; the rest must follow
+    // each other.
+    if (entry.sequence < secondary_ || (written != 0 && entry.sequence != next))
+    {
+      if (written != 0)
+      {
+        break;
+      }
+      continue;
+    }
+    if (owned_.empty() || data_ != owned_.data())
+    {
+      owned_.assign(data_, data_ + size_);
+    }
+    uint32_t bins_size = std::max(bins_size_, std::min(entry.bins_size, MAX_BINS));
+    owned_.resize(std::max(owned_.size(), bins_ + size_t(bins_size)), 0);
+    bins_size_ = bins_size;
+    for (const LogPage& page : entry.pages)
+    {
+      if (page.offset <= bins_size_ && page.size <= bins_size_ - page.offset)
+      {
+        std::memcpy(owned_.data() + bins_ + page.offset, page.data, page.size);
+        ++written;
+      }
+    }
+    data_ = owned_.data();
+    size_ = owned_.size();
+    next = entry.sequence + 1;
+  }
+  if (written != 0)
+  {
+    primary_ = secondary_ = next;
+    stats_.dirty = false;
+    stats_.log_pages += written;
+    findBins();
+    RegistryKey root;
+    if (!parseKey(cell(root_), root))
+    {
+      root_ = findRoot();
+    }
+  }
+  return written;
+}
+
+void RegistryHive::scanLog(const uint8_t* log, size_t size)
+{
+  std::vector<LogEntry> entries = readLog(log, size);
+  size_t first = keys_.size();
+  for (bool keys : {true, false})
+  {
+    for (const LogEntry& entry : entries)
+    {
+      for (const LogPage& page : entry.pages)
+      {
+        searchRegion(page.data, page.size, page.offset, RegistrySource::Log, keys);
+      }
+    }
+  }
+  resolvePaths(first);
+}
+
+bool RegistryHive::readValue(const RegistryValue& value, std::vector<uint8_t>& out) const
+{
+  out.clear();
+  if (!value.big)
+  {
+    out.assign(value.data.data, value.data.data + value.data.size);
+    return value.data.size == value.size;
+  }
+  if (value.source == RegistrySource::Log)
+  {
+    return false;
+  }
+  bool freed = value.source != RegistrySource::Live;
+  ByteView record = cell(value.cell, freed);
+  ByteView index = record.size >= KEY_VALUE ? cell(loadLE32(record.data + 8), freed) : ByteView();
+  if (index.size < 8 || !index.startsWith("db", 2))
+  {
+    return false;
+  }
+  ByteView list = cell(loadLE32(index.data + 4), freed);
+  size_t segments = std::min<size_t>(loadLE16(index.data + 2), list.size / 4);
+  size_t remaining = value.size;
+  for (size_t i = 0; i < segments && remaining != 0; ++i)
+  {
+    ByteView segment = cell(loadLE32(list.data + i * 4), freed);
+    size_t want = std::min<size_t>(remaining, BIG_SEGMENT);
+    size_t take = std::min(want, segment.size);
+    out.insert(out.end(), segment.data, segment.data + take);
+    remaining -= take;
+    if (take < want)
+    {
+      return false;
+    }
+  }
+  return remaining == 0;
+}
+
+size_t scanHiveFiles(const std::vector<std::string>& paths, const HiveSink& sink,
+                     const RegistryScanOptions& options, unsigned threads)
+{
+  if (threads == 0)
+  {
+    threads = std::thread::hardware_concurrency();
+  }
+  threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, paths.size())));
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> parsed{0};
+  auto worker = [&]() {
+    std::vector<uint8_t> data;
+    std::vector<std::vector<uint8_t>> logs;
+    for (;;)
+    {
+      size_t index = next.fetch_add(1);
+      if (index >= paths.size())
+      {
+        break;
+      }
+      std::unique_ptr<RegistryHive> hive;
+      if (readFile(paths[index], data))
+      {
+        hive = RegistryHive::open(data.data(), data.size());
+      }
+      if (!hive)
+      {
+        continue;
+      }
+      logs.clear();
+      for (const char* suffix : {".LOG1", ".LOG2", ".LOG"})
+      {
+        logs.emplace_back();
+        if (!readFile(paths[index] + suffix, logs.back()) || logs.back().size() < 8)
+        {
+          logs.pop_back();
+        }
+      }
+      // Oldest log first, so its entries precede the other's.
+      std::sort(logs.begin(), logs.end(),
+                [](const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+                  return loadLE32(a.data() + 4) < loadLE32(b.data() + 4);
+                });
+      for (const auto& log : logs)
+      {
+        hive->replayLog(log.data(), log.size());
+      }
+      hive->scan(options);
+      for (const auto& log : logs)
+      {
+        hive->scanLog(log.data(), log.size());
+      }
+      sink(index, *hive);
+      parsed.fetch_add(1);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t)
+  {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : pool)
+  {
+    t.join();
+  }
+  return parsed.load();
+}
+
+}  // namespace rsn
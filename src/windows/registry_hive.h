@@ -0,0 +1,185 @@
+// RecoverySoftNetz — Windows registry hive parser
+//
+// A hive (SYSTEM, SOFTWARE, NTUSER.DAT, ...) is a 4 KiB base block followed
+// by hive bins ("hbin"), each a run of 4 KiB pages holding cells. A cell is
+// a signed size (negative = allocated) and a record: key nodes (nk), values
+// (vk), subkey lists (li/lf/lh/ri), value lists and big-data indexes (db).
+// Cell offsets count from the first bin.
+//
+// The hive is parsed in place: cells are addressed in the caller's buffer (a
+// mapped file or a carved range), and value data is returned as views into
+// it. A hive is only copied when a transaction log is replayed over it.
+//   - the live tree is walked from the root key, found through the base
+//     block or, for a carved hive whose base block is lost, as the key node
+//     flagged as the hive entry;
+//   - freed cells keep their records, and freed neighbours are merged without
+//     clearing their headers, so every free cell is searched at cell
+//     alignment for key and value records. Deleted keys take their path from
+//     the parent chain, which often survives, and their values from their
+//     value list;
+//   - transaction logs (.LOG1/.LOG2 in the Windows 8.1 format, .LOG/.LOG1 in
+//     the earlier dirty-vector one) hold page images. `replayLog` writes the
+//     entries the hive has not yet absorbed over it, and `scanLog` searches
+//     every page image for records that the hive no longer holds.
+// `scanHiveFiles` processes many hives at once, one hive per worker.
+
+#pragma once
+
+#include "common/utils.h"
+#include "core/device.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace rsn
+{
+
+enum class RegistrySource : uint8_t
+{
+  Live,      // reachable from the root key
+  FreeCell,  // found in an unallocated cell
+  Log,       // found in a transaction log page the hive no longer matches
+};
+
+struct RegistryKey
+{
+  std::string path;           // '\'-separated, relative to the root key
+  std::string name;
+  uint32_t cell = 0;          // offset from the first hive bin
+  uint32_t parent = 0;        // parent key cell
+  uint64_t last_written = 0;  // FILETIME
+  uint32_t subkeys = 0;       // counts as recorded in the key node
+  uint32_t values = 0;
+  RegistrySource source = RegistrySource::Live;
+  bool orphan = false;        // the parent chain does not reach the root
+};
+
+struct RegistryValue
+{
+  static constexpr uint32_t NO_KEY = UINT32_MAX;
+
+  uint32_t key = NO_KEY;  // index into RegistryHive::keys()
+  std::string name;       // empty for the key's default value
+  uint32_t type = 0;      // REG_SZ = 1, REG_BINARY = 3, REG_DWORD = 4, ...
+  uint32_t cell = 0;
+  uint32_t size = 0;      // data bytes as recorded
+  ByteView data;          // the data where it is held in one piece; empty otherwise
+  bool big = false;       // split over a big-data (db) segment list; see readValue
+  RegistrySource source = RegistrySource::Live;
+};
+
+struct RegistryScanOptions
+{
+  bool deleted = true;       // search free cells
+  unsigned max_depth = 512;  // key nesting below the root
+};
+
+struct HiveStats
+{
+  bool base_block = false;    // the base block was found
+  bool checksum_ok = false;   // and its checksum matches
+  bool dirty = false;         // sequence numbers differ: the last write did not complete
+  uint64_t bins = 0;
+  uint64_t damaged_bins = 0;  // pages without a valid bin header, or bins with broken cells
+  uint64_t log_pages = 0;     // pages written over the hive by replayLog
+  uint64_t log_entries = 0;   // log entries (or dirty vectors) that verified
+  uint64_t keys = 0;          // live
+  uint64_t values = 0;
+  uint64_t deleted_keys = 0;  // from free cells
+  uint64_t deleted_values = 0;
+  uint64_t log_keys = 0;      // from transaction logs
+  uint64_t log_values = 0;
+};
+
+class RegistryHive
+{
+public:
+  /// Parse the hive in `data`, which must outlive the object. `data` may start
+  /// at the base block or, for a carved hive, at a hive bin. Returns nullptr
+  /// when neither is there.
+  static std::unique_ptr<RegistryHive> open(const uint8_t* data, size_t size);
+
+  /// Read the hive at `offset` of `device` (`size` = 0: to the end, or to the
+  /// length the base block gives) into a buffer the object owns.
+  static std::unique_ptr<RegistryHive> load(Device& device, uint64_t offset = 0,
+                                            uint64_t size = 0);
+
+  /// Write the log entries newer than the hive over it, in sequence, stopping
+  /// at the first that fails its hashes. The hive is copied into memory first
+  /// when it is borrowed. Call before `scan`; returns the pages written.
+  size_t replayLog(const uint8_t* log, size_t size);
+
+  /// Walk the tree and, with `options.deleted`, the free cells, replacing any
+  /// earlier result.
+  void scan(const RegistryScanOptions& options = RegistryScanOptions());
+
+  /// Add the keys and values of `log`'s page images that the hive does not
+  /// hold at the same offset. Their data views point into `log`.
+  void scanLog(const uint8_t* log, size_t size);
+
+  const std::vector<RegistryKey>& keys() const { return keys_; }
+  const std::vector<RegistryValue>& values() const { return values_; }
+  const HiveStats& stats() const { return stats_; }
+
+  /// The data of `value`, assembled from its segments when it is big. False
+  /// when a segment is missing; `out` then holds what was found.
+  bool readValue(const RegistryValue& value, std::vector<uint8_t>& out) const;
+
+  /// Hive bin bytes, as recorded in the base block or found.
+  uint32_t binsSize() const { return bins_size_; }
+
+  /// The file name stored in the base block (its last 31 characters).
+  const std::string& fileName() const { return file_name_; }
+
+private:
+  RegistryHive() = default;
+
+  bool parse(const uint8_t* data, size_t size);
+  void findBins();
+  uint32_t findRoot() const;
+  ByteView cell(uint32_t offset, bool allow_free = false) const;
+  bool liveRecord(uint32_t offset, ByteView record) const;
+  void subkeys(uint32_t list, unsigned level, std::vector<uint32_t>& out) const;
+  bool report(uint32_t offset, ByteView record);
+
+  void walk(const RegistryScanOptions& options);
+  void addValues(uint32_t key, ByteView node, RegistrySource source);
+  void scanFree();
+  void searchRegion(const uint8_t* region, size_t length, uint32_t offset,
+                    RegistrySource source, bool keys);
+  void resolvePaths(size_t first);
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<uint8_t> owned_;
+  size_t bins_ = 0;           // first hive bin in the buffer
+  uint32_t bins_size_ = 0;
+  uint32_t root_ = UINT32_MAX;
+  uint32_t primary_ = 0;      // base block sequence numbers
+  uint32_t secondary_ = 0;
+  uint32_t minor_ = 5;
+  std::string file_name_;
+  std::vector<std::pair<uint32_t, uint32_t>> bin_list_;  // (offset, size) of each valid bin
+
+  std::vector<RegistryKey> keys_;
+  std::vector<RegistryValue> values_;
+  std::unordered_set<uint64_t> seen_;  // cell << 32 | CRC-32 of recovered records
+  HiveStats stats_;
+};
+
+/// Called for each hive that parsed, from the worker that parsed it.
+using HiveSink = std::function<void(size_t index, const RegistryHive& hive)>;
+
+/// Load each hive in `paths` with the logs beside it (<path>.LOG1, .LOG2 and
+/// .LOG), replay and scan them, and pass each to `sink`. One hive per worker,
+/// `threads` workers (0 = hardware concurrency); `sink` must be thread-safe.
+/// Returns the number of hives that parsed.
+size_t scanHiveFiles(const std::vector<std::string>& paths, const HiveSink& sink,
+                     const RegistryScanOptions& options = RegistryScanOptions(),
+                     unsigned threads = 0);
+
+}  // namespace rsn
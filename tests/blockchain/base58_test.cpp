@@ -0,0 +1,63 @@
+#include "blockchain/base58.h"
+
+#include "common/utils.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+bool decode(const char* text, std::vector<uint8_t>& out)
+{
+  return base58Decode(text, std::strlen(text), out);
+}
+
+bool checkDecode(const char* text, std::vector<uint8_t>& out)
+{
+  return base58CheckDecode(text, std::strlen(text), out);
+}
+
+TEST(Base58, Decode_Text_Bytes)
+{
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(decode("StV1DL6CwTryKyV", out));
+  EXPECT_EQ(std::string(out.begin(), out.end()), "hello world");
+}
+
+TEST(Base58, Decode_LeadingOnes_ZeroBytes)
+{
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(decode("1112", out));
+  EXPECT_EQ(out, (std::vector<uint8_t>{0, 0, 0, 1}));
+}
+
+TEST(Base58, Decode_ExcludedCharacter_Rejected)
+{
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(decode("StV1DL6CwTryKy0", out));
+  EXPECT_FALSE(decode("abcIl", out));
+}
+
+TEST(Base58, CheckDecode_Address_VersionAndHash)
+{
+  std::vector<uint8_t> payload;
+  ASSERT_TRUE(checkDecode("1PMycacnJaSqwwJqjawXBErnLsZ7RkXUAs", payload));
+  ASSERT_EQ(payload.size(), 21u);
+  EXPECT_EQ(payload[0], 0x00);
+  EXPECT_EQ(toHex(payload.data() + 1, 20), "f54a5851e9372b87810a8e60cdd2e7cfd80b6e31");
+}
+
+TEST(Base58, CheckDecode_ChangedCharacter_Rejected)
+{
+  std::vector<uint8_t> payload;
+  EXPECT_FALSE(checkDecode("1PMycacnJaSqwwJqjawXBErnLsZ7RkXUAt", payload));
+}
+
+}  // namespace
+}  // namespace rsn
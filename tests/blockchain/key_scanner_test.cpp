@@ -0,0 +1,199 @@
+#include "blockchain/key_scanner.h"
+
+#include "common/crypto.h"
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+const char WIF[] = "5HueCGU8rMjxEXxiPuD5BDku4MkFqeZyd4dZ1jvhTVqvbTLvyTJ";
+const char SECRET[] = "0c28fca386c7a227600b2fe50b7cae11ec86d3bf1fbe471be89827e19d72aa1d";
+
+SecureBytes secret()
+{
+  std::vector<uint8_t> out;
+  fromHex(SECRET, out);
+  return SecureBytes(out.begin(), out.end());
+}
+
+/// Base58check, for building extended keys.
+std::string base58Check(std::vector<uint8_t> payload)
+{
+  static const char ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256d(payload.data(), payload.size(), digest);
+  payload.insert(payload.end(), digest, digest + 4);
+  std::string out;
+  std::vector<uint8_t> number = payload;
+  while (std::any_of(number.begin(), number.end(), [](uint8_t b) { return b != 0; }))
+  {
+    uint32_t rest = 0;
+    for (uint8_t& byte : number)
+    {
+      uint32_t value = rest << 8 | byte;
+      byte = static_cast<uint8_t>(value / 58);
+      rest = value % 58;
+    }
+    out += ALPHABET[rest];
+  }
+  for (size_t k = 0; k < payload.size() && payload[k] == 0; ++k)
+  {
+    out += '1';
+  }
+  std::reverse(out.begin(), out.end());
+  return out;
+}
+
+std::string extendedPrivate(uint32_t version)
+{
+  std::vector<uint8_t> payload(78, 0);
+  storeBE32(payload.data(), version);
+  for (size_t k = 0; k < 32; ++k)
+  {
+    payload[13 + k] = static_cast<uint8_t>(k * 7 + 1);
+  }
+  SecureBytes key = secret();
+  std::copy(key.begin(), key.end(), payload.begin() + 46);
+  return base58Check(payload);
+}
+
+/// SEC1 ECPrivateKey with the secp256k1 OID and an uncompressed public key.
+std::string der()
+{
+  std::string out("\x30\x74\x02\x01\x01\x04\x20", 7);
+  SecureBytes key = secret();
+  out.append(key.begin(), key.end());
+  out += std::string("\xa0\x07\x06\x05\x2b\x81\x04\x00\x0a", 9);
+  out += std::string("\xa1\x44\x03\x42\x00\x04", 6);
+  out += std::string(64, '\x5a');
+  return out;
+}
+
+KeyCandidate candidate(KeyKind kind, const std::string& raw)
+{
+  KeyCandidate c;
+  c.kind = kind;
+  c.raw.assign(raw.begin(), raw.end());
+  return c;
+}
+
+std::vector<RecoveredKey> sorted(std::vector<RecoveredKey> keys)
+{
+  std::sort(keys.begin(), keys.end(),
+            [](const RecoveredKey& a, const RecoveredKey& b) { return a.offset < b.offset; });
+  return keys;
+}
+
+TEST(ValidateKeyCandidate, Wif_Uncompressed_Secret)
+{
+  RecoveredKey key;
+  ASSERT_TRUE(validateKeyCandidate(candidate(KeyKind::Wif, WIF), key));
+  EXPECT_EQ(key.key, secret());
+  EXPECT_FALSE(key.compressed);
+  EXPECT_FALSE(key.testnet);
+  EXPECT_EQ(key.confidence, 0.99);
+}
+
+TEST(ValidateKeyCandidate, Wif_ChangedCharacter_Rejected)
+{
+  std::string text = WIF;
+  text[10] = text[10] == 'a' ? 'b' : 'a';
+  RecoveredKey key;
+  EXPECT_FALSE(validateKeyCandidate(candidate(KeyKind::Wif, text), key));
+}
+
+TEST(ValidateKeyCandidate, ExtendedKeys_VersionsAndKinds)
+{
+  RecoveredKey key;
+  ASSERT_TRUE(
+    validateKeyCandidate(candidate(KeyKind::ExtendedPrivate, extendedPrivate(0x0488ade4)), key));
+  EXPECT_EQ(key.kind, KeyKind::ExtendedPrivate);
+  EXPECT_EQ(key.key, secret());
+  ASSERT_TRUE(
+    validateKeyCandidate(candidate(KeyKind::ExtendedPrivate, extendedPrivate(0x04358394)), key));
+  EXPECT_TRUE(key.testnet);
+  EXPECT_FALSE(
+    validateKeyCandidate(candidate(KeyKind::ExtendedPrivate, extendedPrivate(0x01020304)), key));
+}
+
+TEST(ValidateKeyCandidate, Hex_ScalarRangeAndVariety)
+{
+  RecoveredKey key;
+  EXPECT_TRUE(validateKeyCandidate(candidate(KeyKind::Hex, SECRET), key));
+  EXPECT_FALSE(validateKeyCandidate(candidate(KeyKind::Hex, std::string(64, '0')), key));
+  EXPECT_FALSE(validateKeyCandidate(candidate(KeyKind::Hex, std::string(64, 'f')), key));
+  EXPECT_FALSE(validateKeyCandidate(candidate(KeyKind::Hex, std::string(32, '1') + "23"), key));
+}
+
+TEST(ValidateKeyCandidate, Der_CurveAndPoint_HighConfidence)
+{
+  RecoveredKey key;
+  ASSERT_TRUE(validateKeyCandidate(candidate(KeyKind::Der, der()), key));
+  EXPECT_EQ(key.key, secret());
+  EXPECT_EQ(key.length, der().size());
+  EXPECT_FALSE(key.compressed);
+  EXPECT_EQ(key.confidence, 0.97);
+  EXPECT_FALSE(validateKeyCandidate(candidate(KeyKind::Der, der().substr(0, 40)), key));
+}
+
+TEST(KeyCandidateStage, MixedImage_AllKindsFound)
+{
+  std::vector<uint8_t> image = test::noise(2u << 20, 21);
+  test::put(image, 100000, std::string("\nwif=") + WIF + "\n");
+  test::put(image, 300000, "\n" + extendedPrivate(0x0488ade4) + "\n");
+  test::put(image, 500000, std::string("\nprivkey: ") + SECRET + "\n");
+  test::put(image, 900000, der());
+  KeyCandidateStage stage(2);
+  std::vector<RecoveredFile> files = test::carve(stage, image);
+  std::vector<RecoveredKey> keys = sorted(stage.keys());
+  ASSERT_EQ(keys.size(), 4u);
+  ASSERT_EQ(files.size(), 4u);
+  EXPECT_EQ(keys[0].kind, KeyKind::Wif);
+  EXPECT_EQ(keys[0].offset, 100005u);
+  EXPECT_EQ(keys[1].kind, KeyKind::ExtendedPrivate);
+  EXPECT_EQ(keys[1].offset, 300001u);
+  EXPECT_EQ(keys[2].kind, KeyKind::Hex);
+  EXPECT_EQ(keys[2].confidence, 0.6);
+  EXPECT_EQ(keys[3].kind, KeyKind::Der);
+  EXPECT_EQ(keys[3].offset, 900000u);
+  for (const RecoveredKey& key : keys)
+  {
+    EXPECT_EQ(key.key, secret());
+  }
+}
+
+TEST(KeyCandidateStage, SecondRun_KeysOfThatRunOnly)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 23);
+  test::put(image, 200000, std::string("\nwif=") + WIF + "\n");
+  KeyCandidateStage stage(1);
+  test::carve(stage, image);
+  ASSERT_EQ(stage.keys().size(), 1u);
+  std::vector<RecoveredFile> files = test::carve(stage, image);
+  EXPECT_EQ(files.size(), 1u);
+  ASSERT_EQ(stage.keys().size(), 1u);
+  EXPECT_EQ(stage.keys()[0].offset, 200005u);
+}
+
+TEST(KeyCandidateStage, KeyAcrossChunkBoundary_FoundOnce)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 22);
+  test::put(image, (256u << 10) - 20, std::string(" ") + WIF + " ");
+  KeyCandidateStage stage(1);
+  std::vector<RecoveredFile> files = test::carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "key/wif");
+  EXPECT_EQ(files[0].offset, (256u << 10) - 19);
+}
+
+}  // namespace
+}  // namespace rsn
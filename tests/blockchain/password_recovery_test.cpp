@@ -0,0 +1,240 @@
+#include "blockchain/password_recovery.h"
+
+#include "common/crypto.h"
+#include "common/kdf.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+const uint8_t SALT[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+/// A master key record encrypted with `password` the way Bitcoin Core does:
+/// EVP_BytesToKey over SHA-512, then AES-256-CBC over the padded 32-byte key.
+BitcoinCoreMasterKey masterKey(const std::string& password, uint32_t iterations)
+{
+  BitcoinCoreMasterKey key;
+  std::memcpy(key.salt, SALT, sizeof(SALT));
+  key.iterations = iterations;
+  uint8_t digest[SHA512_DIGEST_SIZE];
+  Sha512 hash;
+  hash.update(password.data(), password.size());
+  hash.update(SALT, sizeof(SALT));
+  hash.finish(digest);
+  sha512Rehash(digest, 1, iterations - 1);
+  uint8_t plain[48];
+  for (size_t k = 0; k < 32; ++k)
+  {
+    plain[k] = static_cast<uint8_t>(0xA0 + k);
+  }
+  std::memset(plain + 32, 0x10, 16);
+  Aes256 aes(digest);
+  const uint8_t* chain = digest + 32;
+  for (size_t block = 0; block < 3; ++block)
+  {
+    uint8_t in[AES_BLOCK_SIZE];
+    for (size_t k = 0; k < AES_BLOCK_SIZE; ++k)
+    {
+      in[k] = plain[16 * block + k] ^ chain[k];
+    }
+    aes.encryptBlock(in, key.encrypted_key + 16 * block);
+    chain = key.encrypted_key + 16 * block;
+  }
+  return key;
+}
+
+/// The serialized "mkey" key and CMasterKey value as they sit in a wallet.
+std::string record(const BitcoinCoreMasterKey& key, uint32_t method)
+{
+  std::string out("\x04mkey\x01\x00\x00\x00", 9);
+  out += '\x30';
+  out.append(reinterpret_cast<const char*>(key.encrypted_key), 48);
+  out += '\x08';
+  out.append(reinterpret_cast<const char*>(key.salt), 8);
+  for (uint32_t value : {method, key.iterations})
+  {
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+      out += static_cast<char>((value >> shift) & 0xFF);
+    }
+  }
+  out += '\0';
+  return out;
+}
+
+std::vector<uint8_t> wallet(const std::string& value)
+{
+  std::vector<uint8_t> image(16384, 0);
+  test::put(image, 8000, value);
+  return image;
+}
+
+TEST(FindBitcoinCoreMasterKey, Record_FieldsRead)
+{
+  BitcoinCoreMasterKey written = masterKey("pa42", 500);
+  std::vector<uint8_t> image = wallet(record(written, 0));
+  BitcoinCoreMasterKey key;
+  ASSERT_TRUE(findBitcoinCoreMasterKey(ByteView(image.data(), image.size()), key));
+  EXPECT_EQ(std::memcmp(key.encrypted_key, written.encrypted_key, 48), 0);
+  EXPECT_EQ(std::memcmp(key.salt, SALT, 8), 0);
+  EXPECT_EQ(key.iterations, 500u);
+  EXPECT_EQ(key.derivation_method, 0u);
+}
+
+TEST(FindBitcoinCoreMasterKey, UnsupportedMethodFirst_Skipped)
+{
+  BitcoinCoreMasterKey other = masterKey("other", 300);
+  BitcoinCoreMasterKey written = masterKey("pa42", 500);
+  std::vector<uint8_t> image = wallet(record(written, 0));
+  test::put(image, 2000, record(other, 1));
+  BitcoinCoreMasterKey key;
+  ASSERT_TRUE(findBitcoinCoreMasterKey(ByteView(image.data(), image.size()), key));
+  EXPECT_EQ(key.iterations, 500u);
+  EXPECT_EQ(key.derivation_method, 0u);
+}
+
+TEST(FindBitcoinCoreMasterKey, LookalikeAwayFromKey_Ignored)
+{
+  BitcoinCoreMasterKey written = masterKey("pa42", 500);
+  std::vector<uint8_t> image = wallet(record(written, 0));
+  test::put(image, 100, record(masterKey("decoy", 7), 0).substr(9));
+  BitcoinCoreMasterKey key;
+  ASSERT_TRUE(findBitcoinCoreMasterKey(ByteView(image.data(), image.size()), key));
+  EXPECT_EQ(key.iterations, 500u);
+}
+
+TEST(FindBitcoinCoreMasterKey, ValueBeforeKey_Found)
+{
+  std::string entry = record(masterKey("pa42", 500), 0);
+  std::vector<uint8_t> image = wallet(entry.substr(9) + std::string(5, '\0') + entry.substr(0, 9));
+  BitcoinCoreMasterKey key;
+  ASSERT_TRUE(findBitcoinCoreMasterKey(ByteView(image.data(), image.size()), key));
+  EXPECT_EQ(key.iterations, 500u);
+}
+
+TEST(FindBitcoinCoreMasterKey, OnlyUnsupportedMethod_NotFound)
+{
+  std::vector<uint8_t> image = wallet(record(masterKey("pa42", 500), 1));
+  BitcoinCoreMasterKey key;
+  EXPECT_FALSE(findBitcoinCoreMasterKey(ByteView(image.data(), image.size()), key));
+}
+
+TEST(FindBitcoinCoreMasterKey, NoKeyName_NotFound)
+{
+  std::string value = record(masterKey("pa42", 500), 0);
+  value[1] = 'x';
+  std::vector<uint8_t> image = wallet(value);
+  BitcoinCoreMasterKey key;
+  EXPECT_FALSE(findBitcoinCoreMasterKey(ByteView(image.data(), image.size()), key));
+}
+
+TEST(PasswordRecovery, BitcoinCoreMask_PasswordFound)
+{
+  std::unique_ptr<MaskSource> source = MaskSource::parse("pa?d?d");
+  ASSERT_NE(source, nullptr);
+  BitcoinCoreTarget target(masterKey("pa42", 200));
+  PasswordRecoveryOptions options;
+  options.threads = 2;
+  PasswordRecovery recovery(*source, target, options);
+  PasswordRecoveryResult result = recovery.run();
+  ASSERT_TRUE(result.found);
+  EXPECT_EQ(result.password, "pa42");
+  EXPECT_EQ(result.index, 42u);
+}
+
+TEST(PasswordRecovery, SpaceExhausted_NotFound)
+{
+  std::unique_ptr<MaskSource> source = MaskSource::parse("?d?d");
+  BitcoinCoreTarget target(masterKey("pa42", 50));
+  PasswordRecoveryOptions options;
+  options.threads = 2;
+  PasswordRecovery recovery(*source, target, options);
+  PasswordRecoveryResult result = recovery.run();
+  EXPECT_FALSE(result.found);
+  EXPECT_EQ(result.tested, 100u);
+  EXPECT_EQ(result.remaining, 0u);
+}
+
+TEST(PasswordRecovery, Checkpoint_ResumedAndRemoved)
+{
+  std::string path = ::testing::TempDir() + "rsn_password_checkpoint";
+  std::unique_ptr<MaskSource> source = MaskSource::parse("?d?d?d");
+  BitcoinCoreTarget target(masterKey("995", 20));
+  std::string text = source->describe() + "\n" + target.describe();
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256(text.data(), text.size(), digest);
+  {
+    std::ofstream out(path, std::ios::trunc);
+    out << "rsn-password-checkpoint 1\nfingerprint " << toHex(digest, sizeof(digest))
+        << "\ntested 990\nrange 990 1000\n";
+  }
+  PasswordRecoveryOptions options;
+  options.threads = 1;
+  options.checkpoint_path = path;
+  PasswordRecovery recovery(*source, target, options);
+  PasswordRecoveryResult result = recovery.run();
+  EXPECT_TRUE(result.resumed);
+  ASSERT_TRUE(result.found);
+  EXPECT_EQ(result.password, "995");
+  EXPECT_LE(result.tested, 10u);
+  EXPECT_FALSE(std::ifstream(path).good());
+}
+
+TEST(ParseEthereumKeystore, Pbkdf2_FieldsRead)
+{
+  const std::string json =
+    R"({"crypto":{"cipher":"aes-128-ctr","ciphertext":"00112233",)"
+    R"("kdf":"pbkdf2","kdfparams":{"c":4,"dklen":32,"prf":"hmac-sha256","salt":"a1b2"},)"
+    R"("mac":"0000000000000000000000000000000000000000000000000000000000000001"}})";
+  EthereumKeystore keystore;
+  ASSERT_TRUE(parseEthereumKeystore(json, keystore));
+  EXPECT_FALSE(keystore.scrypt);
+  EXPECT_EQ(keystore.iterations, 4u);
+  EXPECT_EQ(keystore.salt, (std::vector<uint8_t>{0xa1, 0xb2}));
+  EXPECT_EQ(keystore.ciphertext.size(), 4u);
+  EXPECT_EQ(keystore.mac[31], 1);
+}
+
+TEST(ParseEthereumKeystore, ScryptOddN_Rejected)
+{
+  const std::string json =
+    R"({"crypto":{"ciphertext":"00","kdf":"scrypt",)"
+    R"("kdfparams":{"n":1000,"r":8,"p":1,"dklen":32,"salt":"00"},)"
+    R"("mac":"0000000000000000000000000000000000000000000000000000000000000000"}})";
+  EthereumKeystore keystore;
+  EXPECT_FALSE(parseEthereumKeystore(json, keystore));
+}
+
+TEST(PasswordRecovery, EthereumPbkdf2_PasswordFound)
+{
+  EthereumKeystore keystore;
+  keystore.scrypt = false;
+  keystore.iterations = 3;
+  keystore.salt = {9, 8, 7, 6};
+  keystore.ciphertext = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint8_t derived[32];
+  pbkdf2HmacSha256("ab", 2, keystore.salt.data(), keystore.salt.size(), 3, derived, 32);
+  std::vector<uint8_t> mac_input(derived + 16, derived + 32);
+  mac_input.insert(mac_input.end(), keystore.ciphertext.begin(), keystore.ciphertext.end());
+  keccak256(mac_input.data(), mac_input.size(), keystore.mac);
+  std::unique_ptr<MaskSource> source = MaskSource::parse("?l?l");
+  EthereumKeystoreTarget target(keystore);
+  PasswordRecoveryOptions options;
+  options.threads = 2;
+  PasswordRecovery recovery(*source, target, options);
+  PasswordRecoveryResult result = recovery.run();
+  ASSERT_TRUE(result.found);
+  EXPECT_EQ(result.password, "ab");
+}
+
+}  // namespace
+}  // namespace rsn
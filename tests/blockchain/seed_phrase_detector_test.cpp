@@ -0,0 +1,216 @@
+#include "blockchain/seed_phrase_detector.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+std::string repeat(const std::string& word, size_t count, const std::string& last)
+{
+  std::string out;
+  for (size_t k = 0; k + 1 < count; ++k)
+  {
+    out += word + " ";
+  }
+  return out + last;
+}
+
+const std::string TWELVE = repeat("abandon", 12, "about");
+const std::string TWENTY_FOUR = repeat("abandon", 24, "art");
+
+std::string utf16le(const std::string& text)
+{
+  std::string out;
+  for (char c : text)
+  {
+    out += c;
+    out += '\0';
+  }
+  return out;
+}
+
+std::vector<uint16_t> indices(const std::string& text)
+{
+  std::vector<uint16_t> out;
+  size_t begin = 0;
+  while (begin < text.size())
+  {
+    size_t end = std::min(text.find(' ', begin), text.size());
+    std::string word = text.substr(begin, end - begin);
+    out.push_back(static_cast<uint16_t>(Bip39Wordlist::english().lookup(
+      reinterpret_cast<const uint8_t*>(word.data()), word.size())));
+    begin = end + 1;
+  }
+  return out;
+}
+
+TEST(Bip39Wordlist, Lookup_KnownWords_Indices)
+{
+  const Bip39Wordlist& list = Bip39Wordlist::english();
+  EXPECT_EQ(list.lookup(reinterpret_cast<const uint8_t*>("abandon"), 7), 0);
+  EXPECT_EQ(list.lookup(reinterpret_cast<const uint8_t*>("zoo"), 3), 2047);
+  EXPECT_EQ(list.lookup(reinterpret_cast<const uint8_t*>("abandonx"), 8), -1);
+  EXPECT_EQ(list.word(3), "about");
+}
+
+TEST(Bip39Wordlist, Checksum_TestVectors_Valid)
+{
+  std::vector<uint16_t> twelve = indices(TWELVE);
+  std::vector<uint16_t> twenty_four = indices(TWENTY_FOUR);
+  EXPECT_TRUE(bip39ChecksumValid(twelve.data(), twelve.size()));
+  EXPECT_TRUE(bip39ChecksumValid(twenty_four.data(), twenty_four.size()));
+  twelve.back() = 0;
+  EXPECT_FALSE(bip39ChecksumValid(twelve.data(), twelve.size()));
+  EXPECT_FALSE(bip39ChecksumValid(twelve.data(), 11));
+}
+
+TEST(Bip39Wordlist, FromWords_Duplicate_Rejected)
+{
+  std::vector<std::string> words(BIP39_ENGLISH, BIP39_ENGLISH + BIP39_WORD_COUNT);
+  EXPECT_NE(Bip39Wordlist::fromWords("copy", words), nullptr);
+  words[5] = words[6];
+  EXPECT_EQ(Bip39Wordlist::fromWords("copy", words), nullptr);
+  words.pop_back();
+  EXPECT_EQ(Bip39Wordlist::fromWords("copy", words), nullptr);
+}
+
+TEST(SeedPhraseStage, AsciiPhrases_FoundInBinary)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 11);
+  test::put(image, 100000, "\n" + TWELVE + "\n");
+  test::put(image, 600000, "seed: " + TWENTY_FOUR + ".");
+  SeedPhraseStage stage;
+  std::vector<RecoveredFile> files = test::carve(stage, image);
+  std::vector<SeedPhrase> phrases = stage.phrases();
+  ASSERT_EQ(phrases.size(), 2u);
+  ASSERT_EQ(files.size(), 2u);
+  std::sort(phrases.begin(), phrases.end(),
+            [](const SeedPhrase& a, const SeedPhrase& b) { return a.offset < b.offset; });
+  EXPECT_EQ(phrases[0].offset, 100001u);
+  EXPECT_EQ(phrases[0].length, TWELVE.size());
+  EXPECT_EQ(phrases[0].text(), TWELVE);
+  EXPECT_EQ(phrases[1].offset, 600006u);
+  EXPECT_EQ(phrases[1].text(), TWENTY_FOUR);
+  for (const RecoveredFile& file : files)
+  {
+    EXPECT_EQ(file.type, "seed/bip39");
+  }
+}
+
+TEST(SeedPhraseStage, NumberedList_Found)
+{
+  std::string list;
+  std::vector<uint16_t> words = indices(TWELVE);
+  for (size_t k = 0; k < words.size(); ++k)
+  {
+    list += std::to_string(k + 1) + ". " + Bip39Wordlist::english().word(words[k]) + "\n";
+  }
+  std::vector<uint8_t> image(1u << 20, 0);
+  test::put(image, 4096, list);
+  SeedPhraseStage stage;
+  test::carve(stage, image);
+  ASSERT_EQ(stage.phrases().size(), 1u);
+  EXPECT_EQ(stage.phrases()[0].text(), TWELVE);
+}
+
+TEST(SeedPhraseStage, Utf16_BothPhases_Found)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 12);
+  test::put(image, 200000, utf16le(" " + TWELVE + " "));
+  test::put(image, 700001, utf16le(" " + TWELVE + " "));
+  SeedPhraseStage stage;
+  std::vector<RecoveredFile> files = test::carve(stage, image);
+  std::vector<SeedPhrase> phrases = stage.phrases();
+  ASSERT_EQ(phrases.size(), 2u);
+  for (const SeedPhrase& phrase : phrases)
+  {
+    EXPECT_EQ(phrase.encoding, TextEncoding::Utf16Le);
+    EXPECT_EQ(phrase.text(), TWELVE);
+    EXPECT_EQ(phrase.length, 2 * TWELVE.size());
+  }
+}
+
+TEST(SeedPhraseStage, AcrossChunkBoundary_FoundOnce)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 13);
+  test::put(image, (256u << 10) - 40, " " + TWENTY_FOUR + " ");
+  SeedPhraseStage stage;
+  std::vector<RecoveredFile> files = test::carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].offset, (256u << 10) - 39);
+  EXPECT_EQ(files[0].confidence, 0.99);
+}
+
+/// A wordlist of 2048 CJK ideographs, U+4E00 on; word 0 repeated eleven
+/// times and word 3 is a valid phrase, as with "abandon ... about".
+std::unique_ptr<Bip39Wordlist> ideographs()
+{
+  std::vector<std::string> words;
+  for (uint32_t u = 0x4E00; u < 0x4E00 + BIP39_WORD_COUNT; ++u)
+  {
+    words.push_back({static_cast<char>(0xE0 | (u >> 12)),
+                     static_cast<char>(0x80 | ((u >> 6) & 0x3F)),
+                     static_cast<char>(0x80 | (u & 0x3F))});
+  }
+  return Bip39Wordlist::fromWords("ideographs", words);
+}
+
+TEST(SeedPhraseStage, IdeographicPhrases_Utf8AndUtf16_Found)
+{
+  std::unique_ptr<Bip39Wordlist> list = ideographs();
+  ASSERT_NE(list, nullptr);
+  const std::string space = "\xE3\x80\x80";  // U+3000
+  std::string utf8 = repeat(list->word(0), 12, list->word(3));
+  std::string ideographic = utf8;
+  for (size_t at = ideographic.find(' '); at != std::string::npos; at = ideographic.find(' ', at))
+  {
+    ideographic.replace(at, 1, space);
+  }
+  std::string utf16;
+  for (size_t k = 0; k < 12; ++k)
+  {
+    uint32_t u = k < 11 ? 0x4E00 : 0x4E03;
+    utf16 += std::string{static_cast<char>(u & 0xFF), static_cast<char>(u >> 8)};
+    utf16 += k < 11 ? std::string("\x00\x30", 2) : std::string();
+  }
+  std::vector<uint8_t> image = test::noise(1u << 20, 12);
+  test::put(image, 0x1000, "\n" + utf8 + "\n");
+  test::put(image, 0x3000, "\n" + ideographic + "\n");
+  test::put(image, 0x5000, std::string(" \0", 2) + utf16 + std::string(" \0", 2));
+  SeedPhraseStage stage({list.get()});
+  test::carve(stage, image);
+  std::vector<SeedPhrase> phrases = stage.phrases();
+  std::sort(phrases.begin(), phrases.end(), [](const SeedPhrase& a, const SeedPhrase& b)
+  {
+    return a.offset < b.offset;
+  });
+  ASSERT_EQ(phrases.size(), 3u);
+  EXPECT_EQ(phrases[0].offset, 0x1001u);
+  EXPECT_EQ(phrases[0].length, utf8.size());
+  EXPECT_EQ(phrases[1].offset, 0x3001u);
+  EXPECT_EQ(phrases[1].length, ideographic.size());
+  EXPECT_EQ(phrases[2].offset, 0x5002u);
+  EXPECT_EQ(phrases[2].length, utf16.size());
+  EXPECT_EQ(phrases[2].encoding, TextEncoding::Utf16Le);
+  EXPECT_EQ(phrases[2].text(), utf8);
+}
+
+TEST(SeedPhraseStage, BadChecksum_Ignored)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 14);
+  test::put(image, 100000, " " + repeat("abandon", 12, "abandon") + " ");
+  SeedPhraseStage stage;
+  EXPECT_TRUE(test::carve(stage, image).empty());
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,223 @@
+#include "carving/bmff_carver.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+using test::carve;
+using test::extract;
+
+std::string be32(uint32_t value)
+{
+  std::string out(4, '\0');
+  for (int k = 0; k < 4; ++k)
+  {
+    out[k] = static_cast<char>((value >> (24 - 8 * k)) & 0xFF);
+  }
+  return out;
+}
+
+std::string be64(uint64_t value)
+{
+  return be32(static_cast<uint32_t>(value >> 32)) + be32(static_cast<uint32_t>(value));
+}
+
+std::string box(const char* type, const std::string& payload)
+{
+  return be32(static_cast<uint32_t>(8 + payload.size())) + type + payload;
+}
+
+std::string fullBox(const char* type, const std::string& payload)
+{
+  return box(type, std::string(4, '\0') + payload);
+}
+
+/// A movie of `frames` AVC samples (one to three NAL units each, four-byte
+/// length prefixes) interleaved with audio samples, one sample per chunk.
+class MovieWriter
+{
+public:
+  MovieWriter(size_t frames, uint32_t seed) : random_(seed)
+  {
+    for (size_t k = 0; k < frames; ++k)
+    {
+      std::string video;
+      size_t nals = 1 + random_() % 3;
+      for (size_t n = 0; n < nals; ++n)
+      {
+        size_t length = 200 + random_() % 3000;
+        video += be32(static_cast<uint32_t>(length + 1));
+        video += static_cast<char>(n == 0 ? 0x65 : 0x01);
+        video += bytes(length);
+      }
+      video_.push_back(video);
+      audio_.push_back(bytes(200 + random_() % 400));
+    }
+  }
+
+  /// ftyp, moov, mdat.
+  std::string fastStart(const char* brand = "isom")
+  {
+    std::string ftyp = this->ftyp(brand);
+    size_t moov_size = moov(0).size();
+    return ftyp + moov(ftyp.size() + moov_size + 8) + mdat();
+  }
+
+  /// ftyp, mdat, moov.
+  std::string indexLast(const char* brand = "isom")
+  {
+    std::string ftyp = this->ftyp(brand);
+    return ftyp + mdat() + moov(ftyp.size() + 8);
+  }
+
+private:
+  std::string bytes(size_t size)
+  {
+    std::string out(size, '\0');
+    for (char& c : out)
+    {
+      c = static_cast<char>(random_());
+    }
+    return out;
+  }
+
+  static std::string ftyp(const char* brand)
+  {
+    return box("ftyp", std::string(brand) + be32(0x200) + brand + "mp41");
+  }
+
+  std::string mdat() const
+  {
+    std::string payload;
+    for (size_t k = 0; k < video_.size(); ++k)
+    {
+      payload += video_[k] + audio_[k];
+    }
+    return box("mdat", payload);
+  }
+
+  static std::string track(const std::string& entry, const std::vector<std::string>& samples,
+                           const std::vector<uint64_t>& offsets)
+  {
+    std::string sizes = be32(0) + be32(static_cast<uint32_t>(samples.size()));
+    for (const std::string& sample : samples)
+    {
+      sizes += be32(static_cast<uint32_t>(sample.size()));
+    }
+    std::string chunks = be32(static_cast<uint32_t>(offsets.size()));
+    for (uint64_t offset : offsets)
+    {
+      chunks += be64(offset);
+    }
+    std::string stbl = fullBox("stsd", be32(1) + entry) + box("stts", std::string(8, '\0')) +
+                       fullBox("stsc", be32(1) + be32(1) + be32(1) + be32(1)) +
+                       fullBox("stsz", sizes) + fullBox("co64", chunks);
+    std::string minf = box("minf", box("stbl", stbl));
+    std::string mdia = box("mdia", box("mdhd", std::string(24, '\0')) +
+                                     box("hdlr", std::string(25, '\0')) + minf);
+    return box("trak", box("tkhd", std::string(84, '\0')) + mdia);
+  }
+
+  std::string moov(uint64_t base) const
+  {
+    std::vector<uint64_t> video_offsets;
+    std::vector<uint64_t> audio_offsets;
+    for (size_t k = 0; k < video_.size(); ++k)
+    {
+      video_offsets.push_back(base);
+      base += video_[k].size();
+      audio_offsets.push_back(base);
+      base += audio_[k].size();
+    }
+    std::string avcc = box("avcC", std::string("\x01\x64\x00\x28\xff\xe1", 6) +
+                                     std::string(10, '\0'));
+    std::string avc1 = box("avc1", std::string(78, '\0') + avcc);
+    std::string mp4a = box("mp4a", std::string(28, '\0'));
+    return box("moov", fullBox("mvhd", std::string(96, '\0')) +
+                         track(avc1, video_, video_offsets) +
+                         track(mp4a, audio_, audio_offsets));
+  }
+
+  std::mt19937 random_;
+  std::vector<std::string> video_;
+  std::vector<std::string> audio_;
+};
+
+TEST(BmffCarveStage, FastStart_Verified)
+{
+  std::string movie = MovieWriter(40, 1).fastStart();
+  std::vector<uint8_t> image = test::noise(4u << 20, 3);
+  test::put(image, 1u << 20, movie);
+  BmffCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "video/mp4");
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(files[0].description, "MP4, 2 tracks");
+  EXPECT_EQ(extract(image, files[0]), movie);
+}
+
+TEST(BmffCarveStage, IndexLast_ThreePieces_Reassembled)
+{
+  std::string movie = MovieWriter(60, 2).indexLast("qt  ");
+  size_t block = 4096;
+  size_t units = (movie.size() + block - 1) / block;
+  size_t first = units / 3 * block;
+  size_t second = 2 * units / 3 * block;
+  std::vector<uint8_t> image = test::noise(8u << 20, 3);
+  test::put(image, 1u << 20, movie.substr(0, first));
+  test::put(image, (1u << 20) + first + 5 * block, movie.substr(first, second - first));
+  test::put(image, (1u << 20) + second + 8 * block, movie.substr(second));
+  BmffCarveOptions options;
+  options.block_size = 4096;
+  BmffCarveStage stage(options);
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "video/mov");
+  EXPECT_EQ(files[0].confidence, 0.85);
+  EXPECT_EQ(files[0].description, "MOV, 2 tracks, 3 pieces, index stored apart");
+  EXPECT_EQ(extract(image, files[0]), movie);
+  EXPECT_EQ(stage.stats().fragmented, 1u);
+}
+
+TEST(BmffCarveStage, SecondRun_StartsOver)
+{
+  std::string movie = MovieWriter(20, 4).fastStart();
+  std::vector<uint8_t> image = test::noise(2u << 20, 3);
+  test::put(image, 1u << 20, movie);
+  BmffCarveStage stage;
+  ASSERT_EQ(carve(stage, image).size(), 1u);
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(stage.stats().files, 1u);
+  EXPECT_EQ(stage.stats().orphan_movies, 0u);
+}
+
+TEST(BmffCarveStage, HeicImageItems_SizedByWalk)
+{
+  std::string heic = box("ftyp", std::string("heic") + be32(0) + "mif1heic") +
+                     box("meta", std::string(4, '\0') + box("hdlr", std::string(25, '\0')) +
+                                   box("iloc", std::string(20, '\0'))) +
+                     box("mdat", test::letters(30000, 5));
+  std::vector<uint8_t> image = test::noise(2u << 20, 3);
+  test::put(image, 1u << 20, heic);
+  BmffCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "image/heic");
+  EXPECT_EQ(files[0].confidence, 0.6);
+  EXPECT_EQ(files[0].size, heic.size());
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,203 @@
+#include "carving/database_carver.h"
+
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+using test::carve;
+using test::extract;
+
+constexpr size_t INNODB_PAGE = 16384;
+constexpr size_t ESE_PAGE = 8192;
+
+/// Pages of an InnoDB tablespace: an FSP header page, then index pages, each
+/// with its number, LSN and CRC-32C checksum. Pages in `zero` are unused.
+std::vector<std::string> innodb(uint32_t space, uint32_t count, uint32_t seed,
+                                const std::set<uint32_t>& zero = {})
+{
+  std::vector<std::string> pages;
+  std::vector<uint8_t> noise = test::noise(INNODB_PAGE * count, seed);
+  for (uint32_t number = 0; number < count; ++number)
+  {
+    if (zero.count(number) != 0)
+    {
+      pages.emplace_back(INNODB_PAGE, '\0');
+      continue;
+    }
+    uint8_t* p = noise.data() + number * INNODB_PAGE;
+    uint64_t lsn = 1000 + number * 7;
+    storeBE32(p + 4, number);
+    storeBE32(p + 8, 0xFFFFFFFF);
+    storeBE32(p + 12, 0xFFFFFFFF);
+    storeBE64(p + 16, lsn);
+    p[24] = number == 0 ? 0x00 : 0x45;  // FSP_HDR, INDEX
+    p[25] = number == 0 ? 0x08 : 0xBF;
+    storeBE64(p + 26, 0);
+    storeBE32(p + 34, space);
+    if (number == 0)
+    {
+      storeBE32(p + 38, space);
+      storeBE32(p + 42, 0);
+      storeBE32(p + 46, count);
+    }
+    else
+    {
+      storeBE64(p + 66, 100 + number % 3);
+    }
+    storeBE32(p + INNODB_PAGE - 4, static_cast<uint32_t>(lsn));
+    uint32_t crc = crc32c(p + 4, 22) ^ crc32c(p + 38, INNODB_PAGE - 8 - 38);
+    storeBE32(p, crc);
+    storeBE32(p + INNODB_PAGE - 8, crc);
+    pages.emplace_back(reinterpret_cast<const char*>(p), INNODB_PAGE);
+  }
+  return pages;
+}
+
+/// An ESE database: the header and its shadow, then `count` pages whose XOR
+/// checksums are seeded with their page numbers.
+std::vector<std::string> ese(uint32_t count, uint32_t seed, uint32_t state = 3)
+{
+  std::vector<uint8_t> noise = test::noise(ESE_PAGE * (count + 2), seed);
+  uint8_t* h = noise.data();
+  storeLE32(h + 4, 0x89ABCDEF);
+  storeLE32(h + 8, 0x620);
+  storeLE32(h + 12, 0);
+  storeLE64(h + 16, 5000);
+  storeLE32(h + 52, state);
+  storeLE32(h + 232, 0x14);
+  storeLE32(h + 236, ESE_PAGE);
+  std::vector<std::string> pages(2, std::string(reinterpret_cast<const char*>(h), ESE_PAGE));
+  for (uint32_t number = 1; number <= count; ++number)
+  {
+    uint8_t* p = noise.data() + (number + 1) * ESE_PAGE;
+    storeLE64(p + 8, 100 + number);
+    storeLE32(p + 16, number > 5 ? number - 1 : 0);
+    storeLE32(p + 20, number < count ? number + 1 : 0);
+    storeLE32(p + 24, 2 + number % 4);
+    p[28] = 100;
+    p[29] = 0;
+    p[30] = 0;
+    p[31] = 0;
+    p[32] = 0xD0;
+    p[33] = 0x07;
+    p[34] = 10;
+    p[35] = 0;
+    storeLE32(p + 36, 0x2802);
+    uint32_t x = 0;
+    for (size_t k = 8; k < ESE_PAGE; k += 4)
+    {
+      x ^= loadLE32(p + k);
+    }
+    storeLE32(p, 0x89ABCDEF ^ number ^ x);
+    pages.emplace_back(reinterpret_cast<const char*>(p), ESE_PAGE);
+  }
+  return pages;
+}
+
+std::string join(const std::vector<std::string>& pages, size_t begin = 0, size_t end = SIZE_MAX)
+{
+  std::string out;
+  for (size_t k = begin; k < std::min(end, pages.size()); ++k)
+  {
+    out += pages[k];
+  }
+  return out;
+}
+
+TEST(DatabaseCarveStage, InnodbContiguous_WithUnusedPage_Verified)
+{
+  std::string file = join(innodb(7, 12, 1, {7}));
+  std::vector<uint8_t> image = test::noise(2u << 20, 7);
+  test::put(image, 0x10000, file);
+  DatabaseCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "database/ibd");
+  EXPECT_EQ(files[0].offset, 0x10000u);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(files[0].description, "InnoDB tablespace 7, 12 pages of 16K, 3 indexes");
+  EXPECT_EQ(extract(image, files[0]), file);
+  EXPECT_EQ(stage.stats().innodb, 1u);
+}
+
+TEST(DatabaseCarveStage, InnodbSecondHalfFirst_Reassembled)
+{
+  std::vector<std::string> pages = innodb(9, 12, 2);
+  std::vector<uint8_t> image = test::noise(2u << 20, 7);
+  test::put(image, 0x40000, join(pages, 0, 5));
+  test::put(image, 0x10000, join(pages, 5));
+  DatabaseCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].offset, 0x40000u);
+  EXPECT_EQ(files[0].confidence, 0.85);
+  EXPECT_EQ(extract(image, files[0]), join(pages));
+  EXPECT_EQ(stage.stats().fragmented, 1u);
+}
+
+TEST(DatabaseCarveStage, InnodbCorruptPage_ReportedDamaged)
+{
+  std::string file = join(innodb(12, 6, 3));
+  file[3 * INNODB_PAGE + 5000] ^= 0x7F;
+  std::vector<uint8_t> image = test::noise(2u << 20, 7);
+  test::put(image, 0x80000, file);
+  DatabaseCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].confidence, 0.6);
+  EXPECT_NE(files[0].description.find("1 page damaged"), std::string::npos);
+  EXPECT_EQ(extract(image, files[0]), file);
+}
+
+TEST(DatabaseCarveStage, SecondRun_StartsOver)
+{
+  std::string file = join(innodb(7, 6, 6));
+  std::vector<uint8_t> image = test::noise(2u << 20, 7);
+  test::put(image, 0x10000, file);
+  DatabaseCarveStage stage;
+  ASSERT_EQ(carve(stage, image).size(), 1u);
+  uint64_t indexed = stage.stats().indexed;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(stage.stats().innodb, 1u);
+  EXPECT_EQ(stage.stats().indexed, indexed);
+}
+
+TEST(DatabaseCarveStage, EseContiguous_Verified)
+{
+  std::string file = join(ese(10, 4));
+  std::vector<uint8_t> image = test::noise(2u << 20, 7);
+  test::put(image, 0x40000, file);
+  DatabaseCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "database/edb");
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(extract(image, files[0]), file);
+  EXPECT_EQ(stage.stats().ese, 1u);
+}
+
+TEST(DatabaseCarveStage, EseDirtyShutdown_Described)
+{
+  std::string file = join(ese(6, 5, 2));
+  std::vector<uint8_t> image = test::noise(2u << 20, 7);
+  test::put(image, 0x40000, file);
+  DatabaseCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_NE(files[0].description.find("dirty shutdown"), std::string::npos);
+}
+
+}  // namespace
+}  // namespace rsn
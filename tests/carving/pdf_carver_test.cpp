@@ -0,0 +1,244 @@
+#include "carving/pdf_carver.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+using test::carve;
+using test::extract;
+
+/// Writes a PDF with classic cross-reference tables, one revision at a time.
+class PdfWriter
+{
+public:
+  explicit PdfWriter(const std::string& version = "1.4") : text_("%PDF-" + version + "\n") {}
+
+  void object(int number, const std::string& body)
+  {
+    pending_.emplace_back(number, text_.size());
+    text_ += std::to_string(number) + " 0 obj\n" + body + "\nendobj\n";
+  }
+
+  /// A Flate stream object whose data is `size` bytes of letters.
+  void stream(int number, size_t size, uint32_t seed)
+  {
+    std::string data = test::zlibStored(test::letters(size, seed));
+    object(number, "<< /Length " + std::to_string(data.size()) +
+                     " /Filter /FlateDecode >>\nstream\n" + data + "\nendstream");
+  }
+
+  /// End the revision: its table, trailer and "%%EOF". Returns the table's offset.
+  size_t revision(int size)
+  {
+    size_t at = text_.size();
+    text_ += "xref\n0 1\n0000000000 65535 f \n";
+    for (const auto& entry : pending_)
+    {
+      char line[64];
+      std::snprintf(line, sizeof(line), "%d 1\n%010zu 00000 n \n", entry.first, entry.second);
+      text_ += line;
+    }
+    text_ += "trailer\n<< /Size " + std::to_string(size) + " /Root 1 0 R";
+    if (prev_ != SIZE_MAX)
+    {
+      text_ += " /Prev " + std::to_string(prev_);
+    }
+    text_ += " >>\nstartxref\n" + std::to_string(at) + "\n%%EOF\n";
+    pending_.clear();
+    prev_ = at;
+    return at;
+  }
+
+  const std::string& text() const { return text_; }
+  size_t size() const { return text_.size(); }
+
+private:
+  std::string text_;
+  std::vector<std::pair<int, size_t>> pending_;
+  size_t prev_ = SIZE_MAX;
+};
+
+/// A one-page document; each update replaces the page's contents, of `first`
+/// letters in the first revision.
+std::string document(int revisions, std::vector<size_t>* ends = nullptr, size_t first = 40)
+{
+  PdfWriter pdf;
+  pdf.object(1, "<< /Type /Catalog /Pages 2 0 R >>");
+  pdf.object(2, "<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  pdf.object(3, "<< /Type /Page /Parent 2 0 R /Contents 4 0 R >>");
+  pdf.stream(4, first, 1);
+  pdf.revision(5);
+  for (int r = 1; r < revisions; ++r)
+  {
+    if (ends != nullptr)
+    {
+      ends->push_back(pdf.size());
+    }
+    int contents = 4 + r;
+    pdf.stream(contents, 2500, static_cast<uint32_t>(r + 1));
+    pdf.object(3, "<< /Type /Page /Parent 2 0 R /Contents " + std::to_string(contents) +
+                    " 0 R >>");
+    pdf.revision(contents + 1);
+  }
+  if (ends != nullptr)
+  {
+    ends->push_back(pdf.size());
+  }
+  return pdf.text();
+}
+
+TEST(PdfCarveStage, Contiguous_SingleRevision_Verified)
+{
+  std::string pdf = document(1);
+  std::vector<uint8_t> image = test::noise(4u << 20);
+  test::put(image, 1u << 20, pdf);
+  PdfCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "document/pdf");
+  EXPECT_EQ(files[0].offset, 1u << 20);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(files[0].description, "PDF 1.4, 4 objects");
+  EXPECT_EQ(extract(image, files[0]), pdf);
+  EXPECT_EQ(stage.stats().documents, 1u);
+}
+
+TEST(PdfCarveStage, Contiguous_IncrementalUpdates_AllRevisions)
+{
+  std::string pdf = document(3);
+  std::vector<uint8_t> image = test::noise(4u << 20);
+  test::put(image, 1u << 20, pdf);
+  PdfCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(files[0].description, "PDF 1.4, 6 objects, 3 revisions");
+  EXPECT_EQ(extract(image, files[0]), pdf);
+  EXPECT_EQ(stage.stats().updated, 1u);
+}
+
+TEST(PdfCarveStage, Fragmented_UpdateInLaterPiece_Reassembled)
+{
+  std::vector<size_t> ends;
+  std::string pdf = document(3, &ends);
+  for (size_t split : {(ends[0] + 511) / 512 * 512, size_t(2560)})
+  {
+    std::vector<uint8_t> image = test::noise(8u << 20);
+    test::put(image, 1u << 20, pdf.substr(0, split));
+    test::put(image, 5u << 20, pdf.substr(split));
+    PdfCarveStage stage;
+    std::vector<RecoveredFile> files = carve(stage, image);
+    ASSERT_EQ(files.size(), 1u) << split;
+    EXPECT_EQ(files[0].confidence, 0.85) << split;
+    EXPECT_EQ(files[0].description, "PDF 1.4, 6 objects, 3 revisions, 2 pieces") << split;
+    EXPECT_EQ(extract(image, files[0]), pdf) << split;
+  }
+}
+
+TEST(PdfCarveStage, Fragmented_LastRevisionBeforeMiddlePiece_Reassembled)
+{
+  std::string pdf = document(3);
+  std::vector<uint8_t> image = test::noise(8u << 20);
+  test::put(image, 1u << 20, pdf.substr(0, 512));
+  test::put(image, 5u << 20, pdf.substr(512, 4096 - 512));
+  test::put(image, 3u << 20, pdf.substr(4096));
+  PdfCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].confidence, 0.85);
+  EXPECT_EQ(files[0].description, "PDF 1.4, 6 objects, 3 revisions, 3 pieces");
+  EXPECT_EQ(extract(image, files[0]), pdf);
+}
+
+TEST(PdfCarveStage, Fragmented_BreakInFirstTrailer_Reassembled)
+{
+  std::vector<size_t> ends;
+  std::string pdf = document(3, &ends, 3696);
+  size_t split = 4096;
+  ASSERT_LT(pdf.rfind("trailer", ends[0]), split);
+  ASSERT_GT(ends[0], split);
+  for (uint64_t rest : {1ull << 20, 7ull << 20})
+  {
+    std::vector<uint8_t> image = test::noise(8u << 20);
+    test::put(image, 5u << 20, pdf.substr(0, split));
+    test::put(image, rest, pdf.substr(split));
+    PdfCarveStage stage;
+    std::vector<RecoveredFile> files = carve(stage, image);
+    ASSERT_EQ(files.size(), 1u) << rest;
+    EXPECT_EQ(files[0].confidence, 0.85) << rest;
+    EXPECT_EQ(files[0].description, "PDF 1.4, 6 objects, 3 revisions, 2 pieces") << rest;
+    EXPECT_EQ(extract(image, files[0]), pdf) << rest;
+  }
+}
+
+TEST(PdfCarveStage, OriginalAndUpdatedCopy_EachKeepsItsRevisions)
+{
+  std::string original = document(1);
+  std::string copy = document(2);
+  for (bool copy_first : {false, true})
+  {
+    uint64_t at_original = copy_first ? 3u << 20 : 1u << 20;
+    uint64_t at_copy = copy_first ? 1u << 20 : 3u << 20;
+    std::vector<uint8_t> image = test::noise(8u << 20);
+    test::put(image, at_original, original);
+    test::put(image, at_copy, copy);
+    PdfCarveStage stage;
+    std::vector<RecoveredFile> files = carve(stage, image);
+    ASSERT_EQ(files.size(), 2u) << copy_first;
+    const RecoveredFile& first = files[copy_first ? 1 : 0];
+    const RecoveredFile& second = files[copy_first ? 0 : 1];
+    EXPECT_EQ(first.offset, at_original);
+    EXPECT_EQ(first.description, "PDF 1.4, 4 objects") << copy_first;
+    EXPECT_EQ(extract(image, first), original) << copy_first;
+    EXPECT_EQ(second.offset, at_copy);
+    EXPECT_EQ(second.description, "PDF 1.4, 5 objects, 2 revisions") << copy_first;
+    EXPECT_EQ(extract(image, second), copy) << copy_first;
+  }
+}
+
+TEST(PdfCarveStage, SecondRun_StartsOver)
+{
+  std::string pdf = document(2);
+  std::vector<uint8_t> image = test::noise(2u << 20);
+  test::put(image, 1u << 20, pdf);
+  PdfCarveStage stage;
+  ASSERT_EQ(carve(stage, image).size(), 1u);
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].description, "PDF 1.4, 5 objects, 2 revisions");
+  EXPECT_EQ(stage.stats().documents, 1u);
+  EXPECT_EQ(stage.stats().embedded, 0u);
+}
+
+TEST(PdfCarveStage, HeaderOffSector_CountedEmbedded)
+{
+  std::string pdf = document(1);
+  std::vector<uint8_t> image = test::noise(2u << 20);
+  test::put(image, (1u << 20) + 100, pdf);
+  PdfCarveStage stage;
+  EXPECT_TRUE(carve(stage, image).empty());
+  EXPECT_EQ(stage.stats().embedded, 1u);
+}
+
+TEST(PdfCarveStage, NoEndOfFile_CountedOrphan)
+{
+  std::string pdf = document(1);
+  std::vector<uint8_t> image = test::noise(2u << 20);
+  test::put(image, 1u << 20, pdf.substr(0, pdf.size() - 8));
+  PdfCarveStage stage;
+  EXPECT_TRUE(carve(stage, image).empty());
+  EXPECT_EQ(stage.stats().orphans, 1u);
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,85 @@
+#include "carving/piece_map.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+TEST(PieceMap, DeviceAndExtents_ThroughPieces)
+{
+  PieceMap map(10000);
+  EXPECT_EQ(map.device(700), 10700u);
+  EXPECT_TRUE(map.extents(5000).empty());
+  map.add(1024, 50000);
+  map.add(2048, 51024);
+  EXPECT_EQ(map.count(), 3u);
+  EXPECT_EQ(map.device(1500), 50476u);
+  EXPECT_EQ(map.pieceStart(1500), 1024u);
+  EXPECT_EQ(map.nextStart(1500), 2048u);
+  EXPECT_EQ(map.nextStart(3000), UINT64_MAX);
+  std::vector<Extent> extents = map.extents(3000);
+  ASSERT_EQ(extents.size(), 2u);
+  EXPECT_EQ(extents[0].offset, 10000u);
+  EXPECT_EQ(extents[0].length, 1024u);
+  EXPECT_EQ(extents[1].offset, 50000u);
+  EXPECT_EQ(extents[1].length, 1976u);
+  EXPECT_TRUE(map.extents(1000).empty());
+}
+
+TEST(FindPiece, NearestFit_Kept)
+{
+  for (uint64_t actual : {4096 + 3 * 512, 4096 - 2 * 512})
+  {
+    PieceMap map(2048);
+    PieceSearch search;
+    int tries = 0;
+    bool found = findPiece(map, 2048, search, 1u << 20, [&](bool backward) {
+      ++tries;
+      EXPECT_EQ(backward, map.device(2048) < 4096);
+      return map.device(2048) == actual;
+    });
+    ASSERT_TRUE(found) << actual;
+    EXPECT_EQ(map.device(2048), actual);
+    EXPECT_EQ(tries, actual > 4096 ? 5 : 4) << actual;
+  }
+}
+
+TEST(FindPiece, NoFit_MapRestored)
+{
+  PieceMap map(2048);
+  map.add(1024, 9000);
+  PieceSearch search;
+  search.distance = 8192;
+  EXPECT_FALSE(findPiece(map, 1024, search, 1u << 20, [](bool) { return false; }));
+  EXPECT_EQ(map.device(1024), 9000u);
+  EXPECT_FALSE(findPiece(map, 4096, search, 1u << 20, [](bool) { return false; }));
+  EXPECT_EQ(map.count(), 2u);
+  EXPECT_EQ(map.device(4096), 12072u);
+}
+
+TEST(DeviceWindow, ReadsThroughMapAcrossPieces)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 91);
+  MemoryDevice device("image", image.data(), image.size());
+  DeviceWindow window(device, 4096);
+  PieceMap map(1000);
+  map.add(100, 500000);
+  std::vector<uint8_t> out(300);
+  ASSERT_TRUE(window.get(map, 0, out.data(), out.size()));
+  EXPECT_TRUE(std::equal(out.begin(), out.begin() + 100, image.begin() + 1000));
+  EXPECT_TRUE(std::equal(out.begin() + 100, out.end(), image.begin() + 500000));
+  ASSERT_TRUE(window.get(600000, out.data(), out.size(), true));
+  EXPECT_TRUE(std::equal(out.begin(), out.end(), image.begin() + 600000));
+  EXPECT_FALSE(window.get(image.size() - 10, out.data(), out.size()));
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,357 @@
+#include "carving/zip_carver.h"
+
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+using test::carve;
+using test::extract;
+
+void put16(std::string& out, uint32_t value)
+{
+  out += static_cast<char>(value & 0xFF);
+  out += static_cast<char>((value >> 8) & 0xFF);
+}
+
+void put32(std::string& out, uint32_t value)
+{
+  put16(out, value & 0xFFFF);
+  put16(out, value >> 16);
+}
+
+void put64(std::string& out, uint64_t value)
+{
+  put32(out, static_cast<uint32_t>(value));
+  put32(out, static_cast<uint32_t>(value >> 32));
+}
+
+/// Writes stored members, then the central directory and end records. With
+/// `segment_size` set, the member stream is cut into segments of a split set.
+class ZipWriter
+{
+public:
+  void member(const std::string& name, const std::string& data)
+  {
+    uint32_t crc = crc32(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    offsets_.push_back(stream_.size());
+    put32(stream_, 0x04034b50);
+    put16(stream_, 20);
+    put16(stream_, 0);
+    put16(stream_, 0);
+    put32(stream_, 0);
+    put32(stream_, crc);
+    put32(stream_, static_cast<uint32_t>(data.size()));
+    put32(stream_, static_cast<uint32_t>(data.size()));
+    put16(stream_, static_cast<uint32_t>(name.size()));
+    put16(stream_, 0);
+    stream_ += name;
+    stream_ += data;
+    entries_.push_back(Entry{name, crc, data.size(), offsets_.back()});
+  }
+
+  /// A whole archive; with `zip64`, the end records are the ZIP64 ones.
+  std::string archive(bool zip64 = false) const
+  {
+    std::string out = stream_;
+    std::string directory = centralDirectory(0);
+    uint64_t at = out.size();
+    out += directory;
+    if (zip64)
+    {
+      uint64_t record = out.size();
+      put32(out, 0x06064b50);
+      put64(out, 44);
+      put16(out, 45);
+      put16(out, 45);
+      put32(out, 0);
+      put32(out, 0);
+      put64(out, entries_.size());
+      put64(out, entries_.size());
+      put64(out, directory.size());
+      put64(out, at);
+      put32(out, 0x07064b50);
+      put32(out, 0);
+      put64(out, record);
+      put32(out, 1);
+      end(out, 0xFFFF, 0xFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
+    }
+    else
+    {
+      end(out, 0, static_cast<uint32_t>(entries_.size()), static_cast<uint32_t>(directory.size()),
+          static_cast<uint32_t>(at));
+    }
+    return out;
+  }
+
+  /// The segments of a split set: the member stream, after the spanning
+  /// signature, cut every `segment_size` bytes; the last holds the directory.
+  std::vector<std::string> split(size_t segment_size) const
+  {
+    std::string stream("PK\x07\x08", 4);
+    size_t shift = stream.size();
+    stream += stream_;
+    std::vector<std::string> segments;
+    for (size_t at = 0; at < stream.size(); at += segment_size)
+    {
+      segments.push_back(stream.substr(at, segment_size));
+    }
+    if (segments.back().size() == segment_size)
+    {
+      segments.emplace_back();
+    }
+    uint32_t last = static_cast<uint32_t>(segments.size() - 1);
+    std::string directory;
+    for (const Entry& entry : entries_)
+    {
+      uint64_t pos = entry.offset + shift;
+      central(directory, entry, static_cast<uint32_t>(pos / segment_size),
+              static_cast<uint32_t>(pos % segment_size));
+    }
+    std::string& tail = segments.back();
+    uint64_t at = tail.size();
+    tail += directory;
+    put32(tail, 0x06054b50);
+    put16(tail, last);
+    put16(tail, last);
+    put16(tail, static_cast<uint32_t>(entries_.size()));
+    put16(tail, static_cast<uint32_t>(entries_.size()));
+    put32(tail, static_cast<uint32_t>(directory.size()));
+    put32(tail, static_cast<uint32_t>(at));
+    put16(tail, 0);
+    return segments;
+  }
+
+  const std::vector<uint64_t>& offsets() const { return offsets_; }
+
+private:
+  struct Entry
+  {
+    std::string name;
+    uint32_t crc;
+    uint64_t size;
+    uint64_t offset;
+  };
+
+  static void central(std::string& out, const Entry& entry, uint32_t disk, uint32_t offset)
+  {
+    put32(out, 0x02014b50);
+    put16(out, 20);
+    put16(out, 20);
+    put16(out, 0);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, entry.crc);
+    put32(out, static_cast<uint32_t>(entry.size));
+    put32(out, static_cast<uint32_t>(entry.size));
+    put16(out, static_cast<uint32_t>(entry.name.size()));
+    put16(out, 0);
+    put16(out, 0);
+    put16(out, disk);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, offset);
+    out += entry.name;
+  }
+
+  std::string centralDirectory(uint32_t disk) const
+  {
+    std::string out;
+    for (const Entry& entry : entries_)
+    {
+      central(out, entry, disk, static_cast<uint32_t>(entry.offset));
+    }
+    return out;
+  }
+
+  static void end(std::string& out, uint32_t disk, uint32_t total, uint32_t size, uint32_t at)
+  {
+    put32(out, 0x06054b50);
+    put16(out, disk);
+    put16(out, disk);
+    put16(out, total);
+    put16(out, total);
+    put32(out, size);
+    put32(out, at);
+    put16(out, 0);
+  }
+
+  std::string stream_;
+  std::vector<uint64_t> offsets_;
+  std::vector<Entry> entries_;
+};
+
+ZipWriter fiveMembers()
+{
+  ZipWriter zip;
+  size_t sizes[] = {3000, 2000, 5000, 1000, 4000};
+  for (size_t k = 0; k < 5; ++k)
+  {
+    zip.member("file" + std::to_string(k) + ".bin",
+               test::letters(sizes[k], static_cast<uint32_t>(k + 1)));
+  }
+  return zip;
+}
+
+TEST(ZipCarveStage, Contiguous_Verified)
+{
+  std::string zip = fiveMembers().archive();
+  std::vector<uint8_t> image = test::noise(4u << 20, 9);
+  test::put(image, 1u << 20, zip);
+  ZipCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "archive/zip");
+  EXPECT_EQ(files[0].offset, 1u << 20);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(files[0].description, "ZIP, 5 members");
+  EXPECT_EQ(extract(image, files[0]), zip);
+}
+
+TEST(ZipCarveStage, OfficeMembers_ClassifiedDocx)
+{
+  ZipWriter writer;
+  writer.member("[Content_Types].xml", "<Types/>");
+  writer.member("word/document.xml", test::letters(3000, 4));
+  std::string zip = writer.archive();
+  std::vector<uint8_t> image = test::noise(2u << 20, 9);
+  test::put(image, 1u << 20, zip);
+  ZipCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].type, "document/docx");
+  EXPECT_EQ(files[0].description, "DOCX, 2 members");
+}
+
+TEST(ZipCarveStage, Zip64EndRecord_Read)
+{
+  std::string zip = fiveMembers().archive(true);
+  std::vector<uint8_t> image = test::noise(2u << 20, 9);
+  test::put(image, 1u << 20, zip);
+  ZipCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].description, "ZIP, 5 members, ZIP64");
+  EXPECT_EQ(extract(image, files[0]), zip);
+  EXPECT_EQ(stage.stats().zip64, 1u);
+}
+
+TEST(ZipCarveStage, DisplacedHeadPiece_Reassembled)
+{
+  ZipWriter writer = fiveMembers();
+  std::string zip = writer.archive();
+  for (size_t head = 1; head <= 3; ++head)
+  {
+    uint64_t split = writer.offsets()[head] / 512 * 512;
+    ASSERT_GT(split, writer.offsets()[head - 1]);
+    std::vector<uint8_t> image = test::noise(4u << 20, 9);
+    test::put(image, 1u << 20, zip.substr(0, split));
+    test::put(image, (3u << 20) + split, zip.substr(split));
+    ZipCarveStage stage;
+    std::vector<RecoveredFile> files = carve(stage, image);
+    ASSERT_EQ(files.size(), 1u) << head;
+    EXPECT_EQ(files[0].offset, 1u << 20) << head;
+    EXPECT_EQ(files[0].confidence, 0.85) << head;
+    EXPECT_EQ(extract(image, files[0]), zip) << head;
+  }
+}
+
+TEST(ZipCarveStage, DisplacedMiddlePiece_Reassembled)
+{
+  ZipWriter writer = fiveMembers();
+  std::string zip = writer.archive();
+  uint64_t begin = writer.offsets()[2] / 512 * 512;
+  uint64_t end = writer.offsets()[3] / 512 * 512;
+  std::vector<uint8_t> image = test::noise(4u << 20, 9);
+  test::put(image, 1u << 20, zip.substr(0, begin));
+  test::put(image, 2u << 20, zip.substr(begin, end - begin));
+  test::put(image, (1u << 20) + end, zip.substr(end));
+  ZipCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].description, "ZIP, 5 members, 3 pieces");
+  EXPECT_EQ(extract(image, files[0]), zip);
+}
+
+TEST(ZipCarveStage, SplitSet_SegmentsRegistered)
+{
+  ZipWriter writer;
+  for (uint32_t k = 0; k < 6; ++k)
+  {
+    writer.member("part" + std::to_string(k) + ".dat", test::letters(20000 + 1000 * k, k));
+  }
+  std::vector<std::string> segments = writer.split(32768);
+  ASSERT_GE(segments.size(), 3u);
+  std::vector<uint8_t> image = test::noise(8u << 20, 9);
+  for (size_t d = 0; d < segments.size(); ++d)
+  {
+    test::put(image, (1u << 20) + d * (256u << 10), segments[d]);
+  }
+  ZipCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), segments.size());
+  EXPECT_EQ(files[0].description,
+            "ZIP, 6 members, last of " + std::to_string(segments.size()) + " segments");
+  EXPECT_EQ(extract(image, files[0]), segments.back());
+  for (size_t d = 0; d + 1 < segments.size(); ++d)
+  {
+    const RecoveredFile& part = files[d + 1];
+    EXPECT_EQ(part.type, "archive/zip_segment");
+    EXPECT_EQ(part.offset, (1u << 20) + d * (256u << 10));
+    EXPECT_EQ(extract(image, part), segments[d]) << d;
+  }
+  EXPECT_EQ(stage.stats().segments, segments.size() - 1);
+}
+
+TEST(ZipCarveStage, SecondRun_StartsOver)
+{
+  std::string zip = fiveMembers().archive();
+  std::vector<uint8_t> image = test::noise(2u << 20, 9);
+  test::put(image, 1u << 20, zip);
+  ZipCarveStage stage;
+  ASSERT_EQ(carve(stage, image).size(), 1u);
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].confidence, 0.95);
+  EXPECT_EQ(stage.stats().archives, 1u);
+}
+
+TEST(ZipCarveStage, Zip64HugeDiskNumber_SegmentsBoundedByMembers)
+{
+  std::string zip = fiveMembers().archive(true);
+  size_t record = zip.size() - 22 - 20 - 56;
+  ASSERT_EQ(zip.compare(record, 4, "PK\x06\x06"), 0);
+  for (size_t field : {record + 16, record + 20})
+  {
+    zip.replace(field, 4, "\xF0\xFF\xFF\x7F");
+  }
+  std::vector<uint8_t> image = test::noise(2u << 20, 9);
+  test::put(image, 1u << 20, zip);
+  ZipCarveStage stage;
+  std::vector<RecoveredFile> files = carve(stage, image);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(files[0].description,
+            "ZIP, 5 members, ZIP64, last of 2147483633 segments (2147483632 not found)");
+  EXPECT_EQ(stage.stats().unresolved, 1u);
+}
+
+TEST(ZipCarveStage, StartOffSector_CountedEmbedded)
+{
+  std::string zip = fiveMembers().archive();
+  std::vector<uint8_t> image = test::noise(2u << 20, 9);
+  test::put(image, (1u << 20) + 100, zip);
+  ZipCarveStage stage;
+  EXPECT_TRUE(carve(stage, image).empty());
+  EXPECT_EQ(stage.stats().embedded, 1u);
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,143 @@
+#include "common/crypto.h"
+
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+std::vector<uint8_t> bytes(const std::string& hex)
+{
+  std::vector<uint8_t> out;
+  fromHex(hex, out);
+  return out;
+}
+
+TEST(Sha256, Abc_KnownDigest)
+{
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  sha256("abc", 3, digest);
+  EXPECT_EQ(toHex(digest, sizeof(digest)),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(Sha256, Streamed_MatchesOneShot)
+{
+  std::vector<uint8_t> data = test::noise(1000, 41);
+  uint8_t expected[SHA256_DIGEST_SIZE];
+  sha256(data.data(), data.size(), expected);
+  Sha256 hash;
+  for (size_t at = 0; at < data.size(); at += 37)
+  {
+    hash.update(data.data() + at, std::min<size_t>(37, data.size() - at));
+  }
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  hash.finish(digest);
+  EXPECT_EQ(toHex(digest, sizeof(digest)), toHex(expected, sizeof(expected)));
+}
+
+TEST(Sha512, Abc_KnownDigest)
+{
+  uint8_t digest[SHA512_DIGEST_SIZE];
+  sha512("abc", 3, digest);
+  EXPECT_EQ(toHex(digest, sizeof(digest)),
+            "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+            "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+}
+
+TEST(Sha512, Rehash_EveryLaneMatchesScalar)
+{
+  for (size_t count : {1u, 3u, 4u, 5u, 8u, 11u})
+  {
+    std::vector<uint8_t> lanes = test::noise(count * SHA512_DIGEST_SIZE, 42);
+    std::vector<uint8_t> expected = lanes;
+    for (size_t k = 0; k < count; ++k)
+    {
+      for (int round = 0; round < 3; ++round)
+      {
+        sha512(&expected[k * SHA512_DIGEST_SIZE], SHA512_DIGEST_SIZE,
+               &expected[k * SHA512_DIGEST_SIZE]);
+      }
+    }
+    sha512Rehash(lanes.data(), count, 3);
+    EXPECT_EQ(lanes, expected) << count;
+  }
+}
+
+TEST(Keccak256, Empty_EthereumDigest)
+{
+  uint8_t digest[KECCAK256_DIGEST_SIZE];
+  keccak256("", 0, digest);
+  EXPECT_EQ(toHex(digest, sizeof(digest)),
+            "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+}
+
+TEST(Aes256, Fips197_EncryptDecrypt)
+{
+  std::vector<uint8_t> key = bytes("000102030405060708090a0b0c0d0e0f"
+                                   "101112131415161718191a1b1c1d1e1f");
+  std::vector<uint8_t> plain = bytes("00112233445566778899aabbccddeeff");
+  Aes256 aes(key.data());
+  uint8_t block[AES_BLOCK_SIZE];
+  aes.encryptBlock(plain.data(), block);
+  EXPECT_EQ(toHex(block, sizeof(block)), "8ea2b7ca516745bfeafc49904b496089");
+  aes.decryptBlock(block, block);
+  EXPECT_EQ(toHex(block, sizeof(block)), toHex(plain.data(), plain.size()));
+}
+
+TEST(Aes256Gcm, NistZeroKey_KnownTags)
+{
+  uint8_t key[AES256_KEY_SIZE] = {};
+  uint8_t iv[GCM_IV_SIZE] = {};
+  uint8_t tag[GCM_TAG_SIZE];
+  Aes256Gcm gcm(key);
+  gcm.seal(iv, nullptr, 0, nullptr, nullptr, 0, tag);
+  EXPECT_EQ(toHex(tag, sizeof(tag)), "530f8afbc74536b9a963b4f1c4cb738b");
+  uint8_t block[AES_BLOCK_SIZE] = {};
+  gcm.seal(iv, nullptr, 0, block, block, sizeof(block), tag);
+  EXPECT_EQ(toHex(block, sizeof(block)), "cea7403d4d606b6e074ec5d3baf39d18");
+  EXPECT_EQ(toHex(tag, sizeof(tag)), "d0d1c8a799996bf0265b98b5d48ab919");
+}
+
+TEST(Aes256Gcm, RoundTrip_AllBlockCounts)
+{
+  std::vector<uint8_t> key = test::noise(AES256_KEY_SIZE, 43);
+  std::vector<uint8_t> iv = test::noise(GCM_IV_SIZE, 44);
+  std::vector<uint8_t> aad = test::noise(21, 45);
+  Aes256Gcm gcm(key.data());
+  for (size_t size : {1u, 15u, 16u, 127u, 128u, 129u, 511u, 512u, 1000u, 4099u})
+  {
+    std::vector<uint8_t> plain = test::noise(size, static_cast<uint32_t>(size));
+    std::vector<uint8_t> data = plain;
+    uint8_t tag[GCM_TAG_SIZE];
+    gcm.seal(iv.data(), aad.data(), aad.size(), data.data(), data.data(), size, tag);
+    EXPECT_NE(data, plain) << size;
+    std::vector<uint8_t> sealed = data;
+    ASSERT_TRUE(gcm.open(iv.data(), aad.data(), aad.size(), data.data(), data.data(), size, tag))
+      << size;
+    EXPECT_EQ(data, plain) << size;
+    sealed[size / 2] ^= 1;
+    EXPECT_FALSE(
+      gcm.open(iv.data(), aad.data(), aad.size(), sealed.data(), data.data(), size, tag))
+      << size;
+    EXPECT_EQ(data, std::vector<uint8_t>(size, 0)) << size;
+  }
+}
+
+TEST(SecureZero, Buffer_Cleared)
+{
+  std::vector<uint8_t> data = test::noise(100, 46);
+  secureZero(data.data(), data.size());
+  EXPECT_EQ(data, std::vector<uint8_t>(100, 0));
+}
+
+}  // namespace
+}  // namespace rsn
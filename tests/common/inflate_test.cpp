@@ -0,0 +1,112 @@
+#include "common/inflate.h"
+
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+std::vector<uint8_t> bytes(const std::string& hex)
+{
+  std::vector<uint8_t> out;
+  fromHex(hex, out);
+  return out;
+}
+
+/// zlib level 9 output (fixed Huffman codes) for "hello hello hello hello".
+const char HELLO[] = "78dacb48cdc9c957c8402701680308b1";
+
+/// zlib level 9 output (dynamic Huffman codes) for `lines()`.
+const char LINES[] =
+  "78daedd64d4ec3400c86e13da7c8114826994c380ea8888aaa150804c7475ce0597857e95b5be3f1cf67fbbd"
+  "9cafa7e9f169fa7a3b4d1fdfe797f7e9f9f3f6739d5e6fbf0f977fdb0cdb0adb219f1dc66583b1e9e5aa3fbb"
+  "821dcab22958795d7718f7456e158e62ed7a79b0b24a73a742f4e726b707bb49755196fc536e37e539547795"
+  "76910e86dc6e0a7651dd07678172572ab35e0eb5b3b3d72a42539e33bb221d48244335d855da9d2f5bd9580e"
+  "88a9b008bd5a76368cada64828afb92c690e03c78803c8d1e5d0735d70d18cea6ae352f43a9dcb2bbc57cf06"
+  "0f0e4f158f1ccf632f9fe4a50a01c4078247aba20e218978d5ca4847183c8af4a92443bba1ddd06e6837b41b"
+  "da0ded867643bba1ddd06e6837b41bda0ded867643bba1ddd06e6837b41bdabd27dafd03d58a6d5e";
+
+std::string lines()
+{
+  std::string out;
+  for (int i = 0; i < 300; ++i)
+  {
+    out += "line " + std::to_string(i * i % 97) + ": the quick brown fox\n";
+  }
+  return out;
+}
+
+std::string text(const std::vector<uint8_t>& data)
+{
+  return std::string(data.begin(), data.end());
+}
+
+TEST(InflateZlib, FixedHuffman_Decoded)
+{
+  std::vector<uint8_t> in = bytes(HELLO);
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(inflateZlib(in.data(), in.size(), out, 1000));
+  EXPECT_EQ(text(out), "hello hello hello hello");
+}
+
+TEST(InflateZlib, DynamicHuffman_Decoded)
+{
+  std::vector<uint8_t> in = bytes(LINES);
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(inflateZlib(in.data(), in.size(), out, 1u << 20));
+  EXPECT_EQ(text(out), lines());
+}
+
+TEST(InflateZlib, StoredBlocks_Decoded)
+{
+  std::string data = test::letters(70000, 51);
+  std::string stream = test::zlibStored(data);
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(inflateZlib(reinterpret_cast<const uint8_t*>(stream.data()), stream.size(), out,
+                          1u << 20));
+  EXPECT_EQ(text(out), data);
+}
+
+TEST(InflateZlib, BadAdler_Rejected)
+{
+  std::vector<uint8_t> in = bytes(HELLO);
+  in.back() ^= 1;
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(inflateZlib(in.data(), in.size(), out, 1000));
+}
+
+TEST(InflateZlib, OutputCap_Rejected)
+{
+  std::vector<uint8_t> in = bytes(LINES);
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(inflateZlib(in.data(), in.size(), out, 1000));
+  EXPECT_LE(out.size(), 1000u);
+}
+
+TEST(InflateRaw, Truncated_Rejected)
+{
+  std::vector<uint8_t> in = bytes(LINES);
+  std::vector<uint8_t> out;
+  EXPECT_FALSE(inflateRaw(in.data() + 2, in.size() / 2, out, 1u << 20));
+}
+
+TEST(InflateRaw, TrailingBytes_ConsumedStopsAtFinalBlock)
+{
+  std::vector<uint8_t> in = bytes(HELLO);
+  size_t raw = in.size() - 6;
+  in.push_back(0xEE);
+  std::vector<uint8_t> out;
+  size_t consumed = 0;
+  ASSERT_TRUE(inflateRaw(in.data() + 2, in.size() - 2, out, 1000, &consumed));
+  EXPECT_EQ(consumed, raw);
+}
+
+}  // namespace
+}  // namespace rsn
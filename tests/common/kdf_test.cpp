@@ -0,0 +1,55 @@
+#include "common/kdf.h"
+
+#include "common/utils.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+namespace rsn
+{
+namespace
+{
+
+TEST(HmacSha256, Rfc4231Case2_KnownMac)
+{
+  HmacSha256 hmac("Jefe", 4);
+  const char* data = "what do ya want for nothing?";
+  hmac.update(data, std::strlen(data));
+  uint8_t mac[SHA256_DIGEST_SIZE];
+  hmac.finish(mac);
+  EXPECT_EQ(toHex(mac, sizeof(mac)),
+            "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+}
+
+TEST(Pbkdf2HmacSha256, PasswordSalt_KnownKeys)
+{
+  uint8_t out[32];
+  pbkdf2HmacSha256("password", 8, "salt", 4, 1, out, sizeof(out));
+  EXPECT_EQ(toHex(out, sizeof(out)),
+            "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b");
+  pbkdf2HmacSha256("password", 8, "salt", 4, 2, out, sizeof(out));
+  EXPECT_EQ(toHex(out, sizeof(out)),
+            "ae4d0c95af6b46d32d0adff928f06dd02a303f8ef3c251dfd6e2d85a95474c43");
+}
+
+TEST(ScryptContext, Rfc7914Empty_KnownKey)
+{
+  ScryptContext scrypt(16, 1, 1);
+  uint8_t out[64];
+  ASSERT_TRUE(scrypt.derive("", 0, "", 0, out, sizeof(out)));
+  EXPECT_EQ(toHex(out, sizeof(out)),
+            "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+            "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906");
+}
+
+TEST(ScryptContext, OddN_Refused)
+{
+  ScryptContext scrypt(15, 1, 1);
+  uint8_t out[32];
+  EXPECT_FALSE(scrypt.derive("a", 1, "b", 1, out, sizeof(out)));
+}
+
+}  // namespace
+}  // namespace rsn
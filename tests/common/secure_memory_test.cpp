@@ -0,0 +1,60 @@
+#include "common/secure_memory.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+TEST(LockedPool, FreedBlock_WipedAndReused)
+{
+  LockedPool& pool = LockedPool::instance();
+  size_t used = pool.used();
+  uint8_t* first = static_cast<uint8_t*>(pool.allocate(100));
+  std::memset(first, 0xA5, 100);
+  EXPECT_EQ(pool.used(), used + 112);
+  pool.free(first, 100);
+  EXPECT_EQ(pool.used(), used);
+  uint8_t* second = static_cast<uint8_t*>(pool.allocate(100));
+  EXPECT_EQ(second, first);
+  EXPECT_TRUE(std::all_of(second, second + 100, [](uint8_t b) { return b == 0; }));
+  pool.free(second, 100);
+}
+
+TEST(LockedPool, OversizedBlock_OwnArena)
+{
+  LockedPool& pool = LockedPool::instance();
+  size_t used = pool.used();
+  size_t size = 1u << 20;
+  uint8_t* block = static_cast<uint8_t*>(pool.allocate(size));
+  block[0] = 1;
+  block[size - 1] = 2;
+  EXPECT_EQ(pool.used(), used + size);
+  pool.free(block, size);
+  EXPECT_EQ(pool.used(), used);
+}
+
+TEST(SecureBytes, Growth_KeepsContents)
+{
+  size_t used = LockedPool::instance().used();
+  {
+    SecureBytes bytes;
+    for (size_t k = 0; k < 10000; ++k)
+    {
+      bytes.push_back(static_cast<uint8_t>(k));
+    }
+    ASSERT_EQ(bytes.size(), 10000u);
+    EXPECT_EQ(bytes[9999], static_cast<uint8_t>(9999));
+    SecureBytes copy = bytes;
+    EXPECT_EQ(copy, bytes);
+  }
+  EXPECT_EQ(LockedPool::instance().used(), used);
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,85 @@
+#include "common/utils.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+const uint8_t* text(const char* s)
+{
+  return reinterpret_cast<const uint8_t*>(s);
+}
+
+TEST(Utils, LoadersAndStores_BothOrders)
+{
+  uint8_t buffer[8];
+  storeLE64(buffer, 0x0102030405060708ull);
+  EXPECT_EQ(buffer[0], 0x08);
+  EXPECT_EQ(loadLE64(buffer), 0x0102030405060708ull);
+  EXPECT_EQ(loadBE32(buffer), 0x08070605u);
+  storeBE64(buffer, 0x0102030405060708ull);
+  EXPECT_EQ(buffer[0], 0x01);
+  EXPECT_EQ(loadBE64(buffer), 0x0102030405060708ull);
+  EXPECT_EQ(loadLE16(buffer), 0x0201);
+  EXPECT_EQ(loadBE16(buffer + 6), 0x0708);
+}
+
+TEST(Utils, ByteViewSub_ClampedToView)
+{
+  const uint8_t data[4] = {1, 2, 3, 4};
+  ByteView view(data, sizeof(data));
+  EXPECT_EQ(view.sub(1, 2).size, 2u);
+  EXPECT_EQ(view.sub(3).size, 1u);
+  EXPECT_EQ(view.sub(2, 100).size, 2u);
+  EXPECT_TRUE(view.sub(9).empty());
+}
+
+TEST(Utils, FindBytes_FirstOccurrence)
+{
+  ByteView hay(text("abcabcabd"), 9);
+  EXPECT_EQ(findBytes(hay, "abd", 3), 6u);
+  EXPECT_EQ(findBytes(hay, "bc", 2), 1u);
+  EXPECT_EQ(findBytes(hay, "abe", 3), SIZE_MAX);
+  EXPECT_EQ(findBytes(hay.sub(0, 2), "abc", 3), SIZE_MAX);
+}
+
+TEST(Utils, Crc32_CheckValues)
+{
+  EXPECT_EQ(crc32(text("123456789"), 9), 0xCBF43926u);
+  EXPECT_EQ(crc32(text("56789"), 5, crc32(text("1234"), 4)), 0xCBF43926u);
+  EXPECT_EQ(crc32c(text("123456789"), 9), 0xE3069283u);
+  EXPECT_EQ(crc32c(text("6789"), 4, crc32c(text("12345"), 5)), 0xE3069283u);
+}
+
+TEST(Utils, Hex_RoundTripAndRejects)
+{
+  const uint8_t data[3] = {0x00, 0xAB, 0x7F};
+  EXPECT_EQ(toHex(data, 3), "00ab7f");
+  std::vector<uint8_t> out;
+  ASSERT_TRUE(fromHex("00AB7f", out));
+  EXPECT_EQ(out, std::vector<uint8_t>(data, data + 3));
+  EXPECT_FALSE(fromHex("abc", out));
+  EXPECT_FALSE(fromHex("zz", out));
+}
+
+TEST(Utils, Utf8AndUtf16BE_Encoded)
+{
+  std::string out;
+  for (uint32_t cp : {0x41u, 0xE9u, 0x20ACu, 0x1F600u, 0x110000u})
+  {
+    appendUtf8(out, cp);
+  }
+  EXPECT_EQ(out, "A\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xEF\xBF\xBD");
+  const uint8_t utf16[] = {0x00, 0x41, 0xD8, 0x3D, 0xDE, 0x00, 0xDC, 0x00, 0x00};
+  out.clear();
+  appendUtf16BE(out, utf16, sizeof(utf16));
+  EXPECT_EQ(out, "A\xF0\x9F\x98\x80\xEF\xBF\xBD");
+}
+
+}  // namespace
+}  // namespace rsn
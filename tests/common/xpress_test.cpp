@@ -0,0 +1,63 @@
+#include "common/xpress.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+// The plain LZ77 examples of [MS-XCA] section 3.1.
+TEST(XpressDecompress, LiteralsOnly_Decoded)
+{
+  std::vector<uint8_t> in = {0x3f, 0x00, 0x00, 0x00};
+  for (char c = 'a'; c <= 'z'; ++c)
+  {
+    in.push_back(static_cast<uint8_t>(c));
+  }
+  std::string out(26, '\0');
+  size_t consumed = 0;
+  ASSERT_TRUE(xpressDecompress(in.data(), in.size(), reinterpret_cast<uint8_t*>(&out[0]),
+                               out.size(), &consumed));
+  EXPECT_EQ(out, "abcdefghijklmnopqrstuvwxyz");
+  EXPECT_EQ(consumed, in.size());
+}
+
+TEST(XpressDecompress, LongOverlappingMatch_Decoded)
+{
+  std::vector<uint8_t> in = {0xff, 0xff, 0xff, 0x1f, 0x61, 0x62, 0x63,
+                             0x17, 0x00, 0x0f, 0xff, 0x26, 0x01};
+  std::string out(300, '\0');
+  ASSERT_TRUE(
+    xpressDecompress(in.data(), in.size(), reinterpret_cast<uint8_t*>(&out[0]), out.size()));
+  std::string expected;
+  for (int k = 0; k < 100; ++k)
+  {
+    expected += "abc";
+  }
+  EXPECT_EQ(out, expected);
+}
+
+TEST(XpressDecompress, MatchBeforeStart_Rejected)
+{
+  std::vector<uint8_t> in = {0x00, 0x00, 0x00, 0x80, 0x17, 0x00};
+  std::vector<uint8_t> out(16);
+  EXPECT_FALSE(xpressDecompress(in.data(), in.size(), out.data(), out.size()));
+}
+
+TEST(XpressHuffmanTable, KraftSum_Checked)
+{
+  std::vector<uint8_t> table(256, 0x99);
+  EXPECT_TRUE(xpressHuffmanTable(table.data()));
+  std::fill(table.begin(), table.end(), 0x11);
+  EXPECT_FALSE(xpressHuffmanTable(table.data()));
+  std::fill(table.begin(), table.end(), 0x00);
+  EXPECT_FALSE(xpressHuffmanTable(table.data()));
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,173 @@
+#include "core/carve_pipeline.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+/// Records the device offsets of its hits and the ranges of the chunks it sees.
+class RecordingStage : public CarveStage
+{
+public:
+  RecordingStage(std::string pattern, bool accept, bool chunks = false)
+    : pattern_(std::move(pattern)), accept_(accept), chunks_(chunks)
+  {
+  }
+
+  const char* name() const override { return "recording"; }
+  void registerPatterns(PatternSet& patterns) override { patterns.add(pattern_, 7); }
+
+  bool onHit(uint32_t tag, size_t pos, const ChunkView& chunk, CarveContext& ctx) override
+  {
+    EXPECT_EQ(tag, 7u);
+    SecureBytes bytes = ctx.readAt(chunk.offset + pos, pattern_.size());
+    EXPECT_EQ(std::string(bytes.begin(), bytes.end()), pattern_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    hits_.push_back(chunk.offset + pos);
+    return accept_;
+  }
+
+  bool wantsChunks() const override { return chunks_; }
+  size_t lookahead() const override { return chunks_ ? 1000 : 0; }
+
+  void onChunk(const ChunkView& chunk, CarveContext&) override
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunks_seen_.push_back(Extent{chunk.offset, chunk.body});
+    EXPECT_GE(chunk.size, chunk.body);
+  }
+
+  void finish(CarveContext&) override { ++finished_; }
+
+  std::vector<uint64_t> hits()
+  {
+    std::sort(hits_.begin(), hits_.end());
+    return hits_;
+  }
+
+  std::vector<Extent> chunks()
+  {
+    std::sort(chunks_seen_.begin(), chunks_seen_.end(),
+              [](const Extent& a, const Extent& b) { return a.offset < b.offset; });
+    return chunks_seen_;
+  }
+
+  int finished() const { return finished_; }
+
+private:
+  std::string pattern_;
+  bool accept_;
+  bool chunks_;
+  std::mutex mutex_;
+  std::vector<uint64_t> hits_;
+  std::vector<Extent> chunks_seen_;
+  int finished_ = 0;
+};
+
+PipelineOptions smallChunks(unsigned threads)
+{
+  PipelineOptions options;
+  options.chunk_size = 64u << 10;
+  options.threads = threads;
+  return options;
+}
+
+TEST(CarvePipeline, HitsAcrossChunkBoundaries_ReportedOnce)
+{
+  std::vector<uint8_t> image = test::noise(1u << 20, 81);
+  std::vector<uint64_t> expected = {0, 1000, (64u << 10) - 3, 128u << 10, (192u << 10) - 1,
+                                    (1u << 20) - 8};
+  for (uint64_t at : expected)
+  {
+    test::put(image, at, std::string("RSNMAGIC"));
+  }
+  for (unsigned threads : {1u, 3u})
+  {
+    RecordingStage stage("RSNMAGIC", true);
+    MemoryDevice device("image", image.data(), image.size());
+    FileRegistry registry;
+    CarvePipeline pipeline(smallChunks(threads));
+    pipeline.addStage(stage);
+    ASSERT_TRUE(pipeline.run(device, registry));
+    EXPECT_EQ(stage.hits(), expected) << threads;
+    EXPECT_EQ(stage.finished(), 1);
+    EXPECT_EQ(pipeline.stats().hits, expected.size());
+    EXPECT_EQ(pipeline.stats().bytes_scanned, image.size());
+    EXPECT_EQ(pipeline.stats().chunks, 16u);
+    std::vector<SignatureStats> signatures = pipeline.signatureStats();
+    ASSERT_EQ(signatures.size(), 1u);
+    EXPECT_EQ(signatures[0].stage, "recording");
+    EXPECT_EQ(signatures[0].accepted, expected.size());
+  }
+}
+
+TEST(CarvePipeline, ChunkStage_EveryByteOwnedOnce)
+{
+  std::vector<uint8_t> image = test::noise((1u << 20) + 123, 82);
+  RecordingStage stage("none", false, true);
+  MemoryDevice device("image", image.data(), image.size());
+  FileRegistry registry;
+  PipelineOptions options = smallChunks(2);
+  options.start = 1000;
+  CarvePipeline pipeline(options);
+  pipeline.addStage(stage);
+  ASSERT_TRUE(pipeline.run(device, registry));
+  uint64_t next = 1000;
+  for (const Extent& chunk : stage.chunks())
+  {
+    EXPECT_EQ(chunk.offset, next);
+    next += chunk.length;
+  }
+  EXPECT_EQ(next, image.size());
+}
+
+TEST(CarvePipeline, FruitlessSignature_ThrottledThenDisabled)
+{
+  std::vector<uint8_t> image(4u << 20, 0);
+  RecordingStage stage(std::string(2, '\0'), false);
+  MemoryDevice device("image", image.data(), image.size());
+  FileRegistry registry;
+  PipelineOptions options = smallChunks(1);
+  options.adaptive_min_hits = 2048;
+  options.adaptive_min_cost = 0;
+  std::vector<SignatureState> changes;
+  options.on_signature = [&](const SignatureStats& signature) {
+    changes.push_back(signature.state);
+  };
+  CarvePipeline pipeline(options);
+  pipeline.addStage(stage);
+  ASSERT_TRUE(pipeline.run(device, registry));
+  EXPECT_EQ(changes,
+            (std::vector<SignatureState>{SignatureState::Throttled, SignatureState::Disabled}));
+  EXPECT_EQ(pipeline.signatureStats()[0].state, SignatureState::Disabled);
+  EXPECT_GT(pipeline.stats().skipped, pipeline.stats().hits / 2);
+}
+
+TEST(CarvePipeline, MemoryOnly_PlaintextSpill_Refused)
+{
+  std::vector<uint8_t> image(1u << 20, 0);
+  RecordingStage stage("RSNMAGIC", true);
+  MemoryDevice device("image", image.data(), image.size());
+  RegistryOptions spill;
+  spill.resident_limit = 10;
+  FileRegistry registry(spill);
+  PipelineOptions options = smallChunks(1);
+  options.memory_only = true;
+  CarvePipeline pipeline(options);
+  pipeline.addStage(stage);
+  EXPECT_FALSE(pipeline.run(device, registry));
+  EXPECT_EQ(stage.finished(), 0);
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,62 @@
+#include "core/device.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+TEST(MemoryDevice, Read_PastEnd_ShortCount)
+{
+  std::vector<uint8_t> data(100);
+  for (size_t i = 0; i < data.size(); ++i)
+  {
+    data[i] = static_cast<uint8_t>(i);
+  }
+  MemoryDevice dev("mem", data.data(), data.size());
+  uint8_t buf[16] = {};
+  EXPECT_EQ(dev.read(90, buf, sizeof(buf)), 10u);
+  EXPECT_EQ(buf[0], 90);
+  EXPECT_EQ(buf[9], 99);
+  EXPECT_EQ(dev.read(100, buf, sizeof(buf)), 0u);
+  EXPECT_EQ(dev.getSectorCount(), 0u);
+}
+
+TEST(ImageFileDevice, Open_SizeAndReads)
+{
+  std::string path = ::testing::TempDir() + "rsn_device_image";
+  std::vector<uint8_t> data = test::noise(5000, 61);
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  std::fwrite(data.data(), 1, data.size(), file);
+  std::fclose(file);
+  std::unique_ptr<ImageFileDevice> dev = ImageFileDevice::open(path, 4096);
+  ASSERT_NE(dev, nullptr);
+  EXPECT_EQ(dev->size(), 5000u);
+  EXPECT_EQ(dev->sectorSize(), 4096u);
+  EXPECT_EQ(dev->getSectorCount(), 1u);
+  std::vector<uint8_t> buf(2000);
+  ASSERT_EQ(dev->read(4000, buf.data(), buf.size()), 1000u);
+  EXPECT_TRUE(std::equal(buf.begin(), buf.begin() + 1000, data.begin() + 4000));
+  EXPECT_EQ(dev->read(6000, buf.data(), buf.size()), 0u);
+  dev.reset();
+  std::remove(path.c_str());
+}
+
+TEST(ImageFileDevice, Open_Missing_Null)
+{
+  EXPECT_EQ(ImageFileDevice::open(::testing::TempDir() + "rsn_no_such_image"), nullptr);
+}
+
+}  // namespace
+}  // namespace rsn
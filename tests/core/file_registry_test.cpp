@@ -0,0 +1,88 @@
+#include "core/file_registry.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+RecoveredFile entry(size_t k)
+{
+  RecoveredFile file;
+  file.type = k % 3 == 0 ? "image/jpeg" : "document/pdf";
+  file.source = "test";
+  file.offset = k * 4096;
+  file.size = 1000 + k;
+  file.confidence = 0.5 + 0.01 * static_cast<double>(k % 10);
+  file.description = "entry " + std::to_string(k);
+  if (k % 4 == 0)
+  {
+    file.extents = {Extent{k * 4096, 600}, Extent{k * 8192, 400 + k}};
+  }
+  return file;
+}
+
+void expectEntries(const std::vector<RecoveredFile>& files, size_t count)
+{
+  ASSERT_EQ(files.size(), count);
+  for (size_t k = 0; k < count; ++k)
+  {
+    RecoveredFile expected = entry(k);
+    EXPECT_EQ(files[k].id, k + 1);
+    EXPECT_EQ(files[k].type, expected.type);
+    EXPECT_EQ(files[k].offset, expected.offset);
+    EXPECT_EQ(files[k].size, expected.size);
+    EXPECT_EQ(files[k].confidence, expected.confidence);
+    EXPECT_EQ(files[k].description, expected.description);
+    ASSERT_EQ(files[k].extents.size(), expected.extents.size());
+    for (size_t e = 0; e < expected.extents.size(); ++e)
+    {
+      EXPECT_EQ(files[k].extents[e].offset, expected.extents[e].offset);
+      EXPECT_EQ(files[k].extents[e].length, expected.extents[e].length);
+    }
+  }
+}
+
+TEST(FileRegistry, Resident_SnapshotInOrder)
+{
+  FileRegistry registry;
+  for (size_t k = 0; k < 20; ++k)
+  {
+    EXPECT_EQ(registry.add(entry(k)), k + 1);
+  }
+  EXPECT_EQ(registry.size(), 20u);
+  EXPECT_EQ(registry.spilledCount(), 0u);
+  EXPECT_FALSE(registry.spillsPlaintext());
+  expectEntries(registry.snapshot(), 20);
+  EXPECT_EQ(registry.byTypePrefix("image/").size(), 7u);
+}
+
+TEST(FileRegistry, ResidentLimit_SpillsAndReadsBack)
+{
+  for (bool encrypt : {false, true})
+  {
+    RegistryOptions options;
+    options.resident_limit = 8;
+    options.encrypt_spill = encrypt;
+    FileRegistry registry(options);
+    EXPECT_EQ(registry.spillsPlaintext(), !encrypt);
+    for (size_t k = 0; k < 50; ++k)
+    {
+      registry.add(entry(k));
+    }
+    EXPECT_EQ(registry.size(), 50u);
+    EXPECT_GE(registry.spilledCount(), 40u) << encrypt;
+    expectEntries(registry.snapshot(), 50);
+    size_t visited = 0;
+    registry.forEach([&](const RecoveredFile& file) { EXPECT_EQ(file.id, ++visited); });
+    EXPECT_EQ(visited, 50u);
+    EXPECT_EQ(registry.byTypePrefix("document/").size(), 33u);
+  }
+}
+
+}  // namespace
+}  // namespace rsn
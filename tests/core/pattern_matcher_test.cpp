@@ -0,0 +1,65 @@
+#include "core/pattern_matcher.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+using Hits = std::vector<std::pair<uint32_t, size_t>>;
+
+Hits scan(const MultiPatternMatcher& matcher, const std::string& text)
+{
+  Hits hits;
+  matcher.scan(reinterpret_cast<const uint8_t*>(text.data()), text.size(),
+               [&](uint32_t id, size_t start) { hits.emplace_back(id, start); });
+  return hits;
+}
+
+TEST(MultiPatternMatcher, OverlappingPatterns_AllReportedByEnd)
+{
+  MultiPatternMatcher matcher;
+  EXPECT_EQ(matcher.addPattern("he", 2), 0u);
+  EXPECT_EQ(matcher.addPattern("she", 3), 1u);
+  EXPECT_EQ(matcher.addPattern("his", 3), 2u);
+  EXPECT_EQ(matcher.addPattern("hers", 4), 3u);
+  ASSERT_TRUE(matcher.compile());
+  EXPECT_EQ(matcher.maxPatternLength(), 4u);
+  EXPECT_EQ(scan(matcher, "ushers"), (Hits{{1, 1}, {0, 2}, {3, 2}}));
+  EXPECT_EQ(scan(matcher, "hishe"), (Hits{{2, 0}, {1, 2}, {0, 3}}));
+}
+
+TEST(MultiPatternMatcher, BinaryPatterns_FoundInNoise)
+{
+  std::vector<uint8_t> data = test::noise(100000, 71);
+  const uint8_t zip[] = {0x50, 0x4b, 0x03, 0x04};
+  const uint8_t nul[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  std::copy(zip, zip + 4, data.begin() + 500);
+  std::copy(zip, zip + 4, data.begin() + 99996);
+  std::fill(data.begin() + 2000, data.begin() + 2007, 0);
+  MultiPatternMatcher matcher;
+  matcher.addPattern(zip, sizeof(zip));
+  matcher.addPattern(nul, sizeof(nul));
+  ASSERT_TRUE(matcher.compile());
+  Hits hits;
+  matcher.scan(data.data(), data.size(),
+               [&](uint32_t id, size_t start) { hits.emplace_back(id, start); });
+  EXPECT_EQ(hits, (Hits{{0, 500}, {1, 2000}, {1, 2001}, {0, 99996}}));
+}
+
+TEST(MultiPatternMatcher, Empty_CompileFails)
+{
+  MultiPatternMatcher matcher;
+  EXPECT_FALSE(matcher.compile());
+  EXPECT_FALSE(matcher.compiled());
+}
+
+}  // namespace
+}  // namespace rsn
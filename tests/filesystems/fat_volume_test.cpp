@@ -0,0 +1,402 @@
+#include "filesystems/fat_volume.h"
+
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+void put16(std::vector<uint8_t>& image, uint64_t at, uint32_t value)
+{
+  image[at] = static_cast<uint8_t>(value & 0xFF);
+  image[at + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+}
+
+void put16(std::string& out, size_t at, uint32_t value)
+{
+  out[at] = static_cast<char>(value & 0xFF);
+  out[at + 1] = static_cast<char>((value >> 8) & 0xFF);
+}
+
+void put32(std::string& out, size_t at, uint32_t value)
+{
+  put16(out, at, value & 0xFFFF);
+  put16(out, at + 2, value >> 16);
+}
+
+/// Short directory entry; `name` is the 11-byte 8.3 form.
+std::string shortEntry(const std::string& name, int attr, uint32_t cluster, uint32_t size)
+{
+  std::string e(32, '\0');
+  e.replace(0, 11, name);
+  e[11] = static_cast<char>(attr);
+  put16(e, 20, cluster >> 16);
+  put16(e, 26, cluster & 0xFFFF);
+  put32(e, 28, size);
+  return e;
+}
+
+uint8_t shortChecksum(const std::string& name)
+{
+  uint8_t sum = 0;
+  for (unsigned char c : name.substr(0, 11))
+  {
+    sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + c);
+  }
+  return sum;
+}
+
+/// Long-name slots (last first) followed by the short entry. A deleted set
+/// has 0xE5 in place of every first byte.
+std::string longEntries(const std::u16string& name, const std::string& short_name, int attr,
+                        uint32_t cluster, uint32_t size, bool deleted = false)
+{
+  std::u16string padded = name;
+  padded += u'\0';
+  while (padded.size() % 13 != 0)
+  {
+    padded += u'\xFFFF';
+  }
+  size_t slots = padded.size() / 13;
+  static const size_t OFFSETS[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+  std::string out;
+  for (size_t slot = slots; slot-- > 0;)
+  {
+    std::string e(32, '\0');
+    e[0] = static_cast<char>((slot + 1) | (slot + 1 == slots ? 0x40 : 0));
+    e[11] = 0x0F;
+    e[13] = static_cast<char>(shortChecksum(short_name));
+    for (size_t k = 0; k < 13; ++k)
+    {
+      put16(e, OFFSETS[k], padded[slot * 13 + k]);
+    }
+    out += e;
+  }
+  out += shortEntry(short_name, attr, cluster, size);
+  if (deleted)
+  {
+    for (size_t at = 0; at < out.size(); at += 32)
+    {
+      out[at] = '\xE5';
+    }
+  }
+  return out;
+}
+
+/// A FAT16 volume of 512-byte clusters.
+class Fat16Image
+{
+public:
+  static constexpr uint32_t CLUSTERS = 5000;
+  static constexpr uint32_t FAT_SECTORS = (CLUSTERS + 2) * 2 / 512 + 1;
+  static constexpr uint32_t ROOT_ENTRIES = 512;
+  static constexpr uint64_t FIRST_FAT = 512;
+  static constexpr uint64_t ROOT = FIRST_FAT + 2 * FAT_SECTORS * 512;
+  static constexpr uint64_t DATA = ROOT + ROOT_ENTRIES * 32;
+
+  Fat16Image() : bytes_(DATA + CLUSTERS * 512, 0)
+  {
+    std::string boot(512, '\0');
+    boot.replace(0, 11, "\xEB\x3C\x90MSDOS5.0", 11);
+    put16(boot, 11, 512);
+    boot[13] = 1;
+    put16(boot, 14, 1);
+    boot[16] = 2;
+    put16(boot, 17, ROOT_ENTRIES);
+    put16(boot, 19, static_cast<uint32_t>(bytes_.size() / 512));
+    boot[21] = '\xF8';
+    put16(boot, 22, FAT_SECTORS);
+    boot[510] = '\x55';
+    boot[511] = '\xAA';
+    test::put(bytes_, 0, boot);
+    link({0, 1});
+  }
+
+  /// Chain `clusters` in both table copies.
+  void link(const std::vector<uint32_t>& clusters)
+  {
+    for (size_t k = 0; k < clusters.size(); ++k)
+    {
+      uint32_t next = k + 1 < clusters.size() ? clusters[k + 1] : 0xFFFF;
+      for (uint64_t table : {FIRST_FAT, FIRST_FAT + FAT_SECTORS * 512})
+      {
+        put16(bytes_, table + 2 * clusters[k], next);
+      }
+    }
+  }
+
+  void write(const std::vector<uint32_t>& clusters, const std::string& data)
+  {
+    for (size_t k = 0; k * 512 < data.size(); ++k)
+    {
+      test::put(bytes_, DATA + (clusters[k] - 2) * 512ull, data.substr(k * 512, 512));
+    }
+  }
+
+  void root(const std::string& entries) { test::put(bytes_, ROOT, entries); }
+  std::vector<uint8_t>& bytes() { return bytes_; }
+
+private:
+  std::vector<uint8_t> bytes_;
+};
+
+const std::string LONG_FILE = test::letters(1800, 21);
+const std::string FRAGMENTED = test::letters(2000, 22);
+const std::string PHOTO = test::letters(1500, 23);
+
+/// Root: a long-named file, a directory holding a fragmented file, and a
+/// deleted long-named file whose name has a character outside the BMP.
+std::vector<uint8_t> fat16()
+{
+  Fat16Image img;
+  img.write({2, 3, 4, 5}, LONG_FILE);
+  img.link({2, 3, 4, 5});
+  img.link({6});
+  img.write({7, 8, 20, 21}, FRAGMENTED);
+  img.link({7, 8, 20, 21});
+  img.write({10, 11, 12}, PHOTO);
+  img.root(longEntries(u"Long File Name.txt", "LONGFI~1TXT", 0x20, 2, 1800) +
+           shortEntry("SUB        ", 0x10, 6, 0) +
+           longEntries(u"Photo \xD83D\xDE00.jpg", "PHOTO~1 JPG", 0x20, 10, 1500, true));
+  img.write({6}, shortEntry(".          ", 0x10, 6, 0) + shortEntry("..         ", 0x10, 0, 0) +
+                   shortEntry("FRAG    BIN", 0x20, 7, 2000));
+  return img.bytes();
+}
+
+std::map<std::string, FatEntry> byPath(const FatVolume& volume)
+{
+  std::map<std::string, FatEntry> out;
+  for (const FatEntry& entry : volume.entries())
+  {
+    out[entry.path] = entry;
+  }
+  return out;
+}
+
+std::string contents(const std::vector<uint8_t>& image, const FatVolume& volume,
+                     const FatEntry& entry)
+{
+  RecoveredFile file;
+  file.extents = volume.extents(volume.clusters(entry), entry.size);
+  file.offset = file.extents.empty() ? 0 : file.extents[0].offset;
+  file.size = entry.size;
+  if (file.extents.size() == 1)
+  {
+    file.extents.clear();
+  }
+  return test::extract(image, file);
+}
+
+TEST(FatVolume, Fat16_LongNamesChainsAndDeleted)
+{
+  std::vector<uint8_t> image = fat16();
+  MemoryDevice device("card", image.data(), image.size());
+  std::unique_ptr<FatVolume> volume = FatVolume::open(device);
+  ASSERT_NE(volume, nullptr);
+  EXPECT_EQ(volume->kind(), FatKind::Fat16);
+  EXPECT_EQ(volume->clusterSize(), 512u);
+  EXPECT_TRUE(volume->isAllocated(21));
+  EXPECT_FALSE(volume->isAllocated(10));
+  volume->scanDirectories();
+  std::map<std::string, FatEntry> entries = byPath(*volume);
+  ASSERT_EQ(entries.size(), 4u);
+  EXPECT_EQ(contents(image, *volume, entries.at("Long File Name.txt")), LONG_FILE);
+  EXPECT_TRUE(entries.at("SUB").directory);
+  const FatEntry& fragmented = entries.at("SUB/FRAG.BIN");
+  EXPECT_EQ(volume->clusters(fragmented), (std::vector<uint32_t>{7, 8, 20, 21}));
+  EXPECT_EQ(volume->extents(volume->clusters(fragmented), fragmented.size).size(), 2u);
+  EXPECT_EQ(contents(image, *volume, fragmented), FRAGMENTED);
+  const FatEntry& photo = entries.at("Photo \xF0\x9F\x98\x80.jpg");
+  EXPECT_TRUE(photo.deleted);
+  EXPECT_EQ(photo.first_cluster, 10u);
+  EXPECT_EQ(volume->clusters(photo), (std::vector<uint32_t>{10}));
+}
+
+TEST(FatVolume, Fat16_DeletedExcluded_WhenAsked)
+{
+  std::vector<uint8_t> image = fat16();
+  MemoryDevice device("card", image.data(), image.size());
+  std::unique_ptr<FatVolume> volume = FatVolume::open(device);
+  ASSERT_NE(volume, nullptr);
+  volume->scanDirectories(false);
+  EXPECT_EQ(volume->entries().size(), 3u);
+}
+
+TEST(FatVolume, UnreadableFatSector_TakenFromBackup)
+{
+  std::vector<uint8_t> image = fat16();
+  test::HoleyDevice device(image, 512, {1});
+  std::unique_ptr<FatVolume> volume = FatVolume::open(device);
+  ASSERT_NE(volume, nullptr);
+  EXPECT_EQ(volume->fatRepairs(), 1u);
+  volume->scanDirectories();
+  std::map<std::string, FatEntry> entries = byPath(*volume);
+  EXPECT_EQ(contents(image, *volume, entries.at("SUB/FRAG.BIN")), FRAGMENTED);
+}
+
+/// An exFAT volume of 4 KiB clusters.
+class ExfatImage
+{
+public:
+  static constexpr uint32_t CLUSTERS = 200;
+  static constexpr uint64_t FAT = 24 * 512;
+  static constexpr uint64_t HEAP = 40 * 512;
+  static constexpr uint32_t CLUSTER = 4096;
+
+  ExfatImage() : bytes_(HEAP + CLUSTERS * CLUSTER, 0), bitmap_((CLUSTERS + 7) / 8, '\0')
+  {
+    std::string boot(512, '\0');
+    boot.replace(0, 11, "\xEB\x76\x90" "EXFAT   ", 11);
+    put32(boot, 72, static_cast<uint32_t>(bytes_.size() / 512));
+    put32(boot, 80, FAT / 512);
+    put32(boot, 84, 4);
+    put32(boot, 88, HEAP / 512);
+    put32(boot, 92, CLUSTERS);
+    put32(boot, 96, 4);
+    boot[108] = 9;
+    boot[109] = 3;
+    boot[110] = 1;
+    boot[510] = '\x55';
+    boot[511] = '\xAA';
+    test::put(bytes_, 0, boot);
+  }
+
+  void allocate(const std::vector<uint32_t>& clusters, bool chain)
+  {
+    for (size_t k = 0; k < clusters.size(); ++k)
+    {
+      bitmap_[(clusters[k] - 2) / 8] |= static_cast<char>(1 << ((clusters[k] - 2) % 8));
+      if (chain)
+      {
+        uint32_t next = k + 1 < clusters.size() ? clusters[k + 1] : 0xFFFFFFFF;
+        std::string value(4, '\0');
+        put32(value, 0, next);
+        test::put(bytes_, FAT + 4 * clusters[k], value);
+      }
+    }
+  }
+
+  void write(uint32_t cluster, const std::string& data)
+  {
+    test::put(bytes_, HEAP + (cluster - 2) * static_cast<uint64_t>(CLUSTER), data);
+  }
+
+  std::vector<uint8_t>& finish()
+  {
+    write(2, bitmap_);
+    return bytes_;
+  }
+
+private:
+  std::vector<uint8_t> bytes_;
+  std::string bitmap_;
+};
+
+/// File, stream extension and name entries; in-use bits cleared when deleted.
+std::string entrySet(const std::u16string& name, int attr, uint32_t first, uint64_t size,
+                     bool no_fat_chain, bool deleted = false)
+{
+  size_t parts = (name.size() + 14) / 15;
+  char in_use = deleted ? 0 : '\x80';
+  std::string e(32 * (2 + parts), '\0');
+  e[0] = static_cast<char>(0x05 | in_use);
+  e[1] = static_cast<char>(1 + parts);
+  put16(e, 4, attr);
+  e[32] = static_cast<char>(0x40 | in_use);
+  e[33] = static_cast<char>(no_fat_chain ? 0x03 : 0x01);
+  e[35] = static_cast<char>(name.size());
+  put32(e, 40, static_cast<uint32_t>(size));
+  put32(e, 52, first);
+  put32(e, 56, static_cast<uint32_t>(size));
+  for (size_t part = 0; part < parts; ++part)
+  {
+    size_t at = 64 + 32 * part;
+    e[at] = static_cast<char>(0x41 | in_use);
+    for (size_t k = 0; k < 15 && part * 15 + k < name.size(); ++k)
+    {
+      put16(e, at + 2 + 2 * k, name[part * 15 + k]);
+    }
+  }
+  return e;
+}
+
+const std::string CLIP = test::letters(20000, 24);
+const std::string CAFE = test::letters(6000, 25);
+const std::string SPLIT = test::letters(30000, 26);
+const std::string ERASED = test::letters(9000, 27);
+
+std::vector<uint8_t> exfat()
+{
+  ExfatImage img;
+  img.allocate({2}, true);
+  img.allocate({4}, true);
+  img.allocate({5}, true);
+  std::string bitmap_entry(32, '\0');
+  bitmap_entry[0] = '\x81';
+  put32(bitmap_entry, 20, 2);
+  put32(bitmap_entry, 24, (ExfatImage::CLUSTERS + 7) / 8);
+  img.write(4, bitmap_entry + entrySet(u"DCIM", 0x10, 5, ExfatImage::CLUSTER, true));
+  img.allocate({6, 7, 8, 9, 10}, false);
+  img.write(6, CLIP);
+  img.allocate({11, 12}, false);
+  img.write(11, CAFE);
+  std::vector<uint32_t> split = {13, 14, 15, 16, 30, 31, 32, 33};
+  img.allocate(split, true);
+  for (size_t k = 0; k < split.size(); ++k)
+  {
+    img.write(split[k], SPLIT.substr(k * ExfatImage::CLUSTER, ExfatImage::CLUSTER));
+  }
+  img.write(40, ERASED);
+  img.write(5, entrySet(u"GOPR0001.MP4", 0x20, 6, CLIP.size(), true) +
+                 entrySet(u"Café déjà vu \xD83D\xDE00.JPG", 0x20, 11, CAFE.size(),
+                          true) +
+                 entrySet(u"GOPR0002.MP4", 0x20, 13, SPLIT.size(), false) +
+                 entrySet(u"GOPR0003.MP4", 0x20, 40, ERASED.size(), true, true));
+  return img.finish();
+}
+
+TEST(FatVolume, Exfat_BitmapChainsAndDeleted)
+{
+  std::vector<uint8_t> image = exfat();
+  MemoryDevice device("card", image.data(), image.size());
+  std::unique_ptr<FatVolume> volume = FatVolume::open(device);
+  ASSERT_NE(volume, nullptr);
+  EXPECT_EQ(volume->kind(), FatKind::Exfat);
+  EXPECT_STREQ(volume->kindName(), "exfat");
+  EXPECT_EQ(volume->clusterSize(), 4096u);
+  EXPECT_TRUE(volume->isAllocated(33));
+  EXPECT_FALSE(volume->isAllocated(40));
+  volume->scanDirectories();
+  std::map<std::string, FatEntry> entries = byPath(*volume);
+  ASSERT_EQ(entries.size(), 5u);
+  EXPECT_TRUE(entries.at("DCIM").directory);
+  EXPECT_TRUE(entries.at("DCIM/GOPR0001.MP4").contiguous);
+  EXPECT_EQ(contents(image, *volume, entries.at("DCIM/GOPR0001.MP4")), CLIP);
+  EXPECT_EQ(contents(image, *volume, entries.at("DCIM/Caf\xC3\xA9 d\xC3\xA9j\xC3\xA0 vu "
+                                                "\xF0\x9F\x98\x80.JPG")),
+            CAFE);
+  EXPECT_EQ(contents(image, *volume, entries.at("DCIM/GOPR0002.MP4")), SPLIT);
+  const FatEntry& erased = entries.at("DCIM/GOPR0003.MP4");
+  EXPECT_TRUE(erased.deleted);
+  EXPECT_TRUE(erased.contiguous);
+  EXPECT_EQ(contents(image, *volume, erased), ERASED);
+}
+
+TEST(FatVolume, NoBootSector_Null)
+{
+  std::vector<uint8_t> image(1u << 20, 0);
+  MemoryDevice device("card", image.data(), image.size());
+  EXPECT_EQ(FatVolume::open(device), nullptr);
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,254 @@
+#include "optical/iso9660.h"
+
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+constexpr size_t SECTOR = DISC_SECTOR_SIZE;
+
+std::string both32(uint32_t value)
+{
+  std::string out;
+  for (int k = 0; k < 4; ++k)
+  {
+    out += static_cast<char>((value >> (8 * k)) & 0xFF);
+  }
+  for (int k = 3; k >= 0; --k)
+  {
+    out += static_cast<char>((value >> (8 * k)) & 0xFF);
+  }
+  return out;
+}
+
+std::string both16(uint32_t value)
+{
+  return std::string{static_cast<char>(value & 0xFF), static_cast<char>(value >> 8),
+                     static_cast<char>(value >> 8), static_cast<char>(value & 0xFF)};
+}
+
+/// Directory record; `use` is the system use area (Rock Ridge entries).
+std::string record(uint32_t lba, uint32_t size, bool directory, const std::string& name,
+                   const std::string& use = std::string())
+{
+  std::string body = both32(lba) + both32(size) + std::string(7, '\0');
+  body += static_cast<char>(directory ? 2 : 0);
+  body += std::string(2, '\0') + both16(1);
+  body += static_cast<char>(name.size());
+  body += name;
+  if (name.size() % 2 == 0)
+  {
+    body += '\0';
+  }
+  body += use;
+  std::string out = std::string(1, '\0') + '\0' + body;
+  if (out.size() % 2 != 0)
+  {
+    out += '\0';
+  }
+  out[0] = static_cast<char>(out.size());
+  return out;
+}
+
+std::string rockName(const std::string& name)
+{
+  return std::string("NM") + static_cast<char>(5 + name.size()) + '\x01' + '\0' + name;
+}
+
+const std::string SUSP("SP\x07\x01\xBE\xEF\x00", 7);
+
+std::string utf16be(const std::u16string& text)
+{
+  std::string out;
+  for (char16_t unit : text)
+  {
+    out += static_cast<char>(unit >> 8);
+    out += static_cast<char>(unit & 0xFF);
+  }
+  return out;
+}
+
+/// A disc image built sector by sector.
+class IsoImage
+{
+public:
+  explicit IsoImage(size_t sectors) : bytes_(sectors * SECTOR, 0) {}
+
+  void put(uint32_t lba, const std::string& data) { test::put(bytes_, lba * SECTOR, data); }
+
+  void directory(uint32_t self, uint32_t parent, const std::vector<std::string>& entries,
+                 bool rock_ridge = false)
+  {
+    std::string out = record(self, SECTOR, true, std::string(1, '\0'), rock_ridge ? SUSP : "") +
+                      record(parent, SECTOR, true, std::string(1, '\1'));
+    for (const std::string& entry : entries)
+    {
+      out += entry;
+    }
+    ASSERT_LE(out.size(), SECTOR);
+    put(self, out);
+  }
+
+  /// Volume descriptor of `type` (1 primary, 2 supplementary, 255 terminator).
+  void descriptor(uint32_t lba, int type, uint32_t blocks = 0, uint32_t root = 0,
+                  bool joliet = false)
+  {
+    std::string v(SECTOR, '\0');
+    v[0] = static_cast<char>(type);
+    v.replace(1, 6, "CD001\x01", 6);
+    if (type != 255)
+    {
+      v.replace(80, 8, both32(blocks));
+      v.replace(128, 4, both16(SECTOR));
+      v.replace(156, 34, record(root, SECTOR, true, std::string(1, '\0')));
+    }
+    if (joliet)
+    {
+      v.replace(88, 3, "%/E");
+    }
+    put(lba, v);
+  }
+
+  std::vector<uint8_t>& bytes() { return bytes_; }
+
+private:
+  std::vector<uint8_t> bytes_;
+};
+
+const std::string ALPHA = test::letters(3000, 1);
+const std::string BRAVO = test::letters(5000, 2);
+const std::string OLD = test::letters(2400, 3);
+const std::string CHARLIE = test::letters(4900, 4);
+const std::string SMILE = test::letters(700, 5);
+
+/// Two sessions. The first has plain and Joliet trees; the second, with
+/// Rock Ridge names, keeps alpha and bravo, adds charlie and drops the rest.
+std::vector<uint8_t> twoSessions()
+{
+  IsoImage img(400);
+  img.put(30, ALPHA);
+  img.put(32, BRAVO);
+  img.put(40, OLD);
+  img.put(44, SMILE);
+  img.directory(20, 20,
+                {record(30, ALPHA.size(), false, "A.TXT;1"), record(21, SECTOR, true, "SUB"),
+                 record(40, OLD.size(), false, "OLD.TXT;1"),
+                 record(44, SMILE.size(), false, "SMILE.TXT;1")});
+  img.directory(21, 20, {record(32, BRAVO.size(), false, "B.TXT;1")});
+  img.directory(22, 22,
+                {record(30, ALPHA.size(), false, utf16be(u"alpha long name.txt;1")),
+                 record(23, SECTOR, true, utf16be(u"Sub Dir")),
+                 record(40, OLD.size(), false, utf16be(u"old file.txt;1")),
+                 record(44, SMILE.size(), false, utf16be(u"smile \xD83D\xDE00.txt;1"))});
+  img.directory(23, 22, {record(32, BRAVO.size(), false, utf16be(u"bravo long.txt;1"))});
+  img.descriptor(16, 1, 100, 20);
+  img.descriptor(17, 2, 100, 22, true);
+  img.descriptor(18, 255);
+
+  img.put(240, CHARLIE);
+  img.directory(220, 220,
+                {record(30, ALPHA.size(), false, "A.TXT;1", rockName("alpha.txt")),
+                 record(221, SECTOR, true, "SUB", rockName("subdir")),
+                 record(240, CHARLIE.size(), false, "C.TXT;1", rockName("charlie-new.txt"))},
+                true);
+  img.directory(221, 220,
+                {record(32, BRAVO.size(), false, "B.TXT;1", rockName("bravo.txt"))}, true);
+  img.descriptor(216, 1, 260, 220);
+  img.descriptor(217, 255);
+  return img.bytes();
+}
+
+std::map<std::string, const DiscFile*> byPath(const DiscIndex& index)
+{
+  std::map<std::string, const DiscFile*> out;
+  for (const DiscFile& file : index.files)
+  {
+    out[file.path] = &file;
+  }
+  return out;
+}
+
+TEST(Iso9660, TwoSessions_NewestNamesAndOlderFiles)
+{
+  std::vector<uint8_t> image = twoSessions();
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  ASSERT_TRUE(probeIso9660(reader));
+  DiscIndex index;
+  ASSERT_TRUE(indexIso9660(reader, index));
+  EXPECT_EQ(index.sessions, (std::vector<uint64_t>{0, 200}));
+  std::map<std::string, const DiscFile*> files = byPath(index);
+  std::map<std::string, std::pair<std::string, uint32_t>> expected = {
+    {"alpha.txt", {ALPHA, 1}},
+    {"subdir/bravo.txt", {BRAVO, 1}},
+    {"charlie-new.txt", {CHARLIE, 1}},
+    {"old file.txt", {OLD, 0}},
+    {"smile \xF0\x9F\x98\x80.txt", {SMILE, 0}},
+  };
+  for (const auto& entry : expected)
+  {
+    auto it = files.find(entry.first);
+    ASSERT_NE(it, files.end()) << entry.first;
+    const DiscFile& file = *it->second;
+    EXPECT_EQ(file.session, entry.second.second) << entry.first;
+    EXPECT_FALSE(file.directory);
+    RecoveredFile recovered;
+    recovered.size = file.size;
+    recovered.extents = file.extents;
+    EXPECT_EQ(test::extract(image, recovered), entry.second.first) << entry.first;
+  }
+  EXPECT_TRUE(files.count("subdir") != 0 && files.at("subdir")->directory);
+  EXPECT_EQ(index.files.size(), expected.size() + 2);
+}
+
+TEST(Iso9660, RockRidgeDisabled_PlainNames)
+{
+  std::vector<uint8_t> image = twoSessions();
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  IsoOptions options;
+  options.rock_ridge = false;
+  options.joliet = false;
+  DiscIndex index;
+  ASSERT_TRUE(indexIso9660(reader, index, options));
+  std::map<std::string, const DiscFile*> files = byPath(index);
+  EXPECT_EQ(files.count("C.TXT"), 1u);
+  EXPECT_EQ(files.count("SUB/B.TXT"), 1u);
+  EXPECT_EQ(files.count("OLD.TXT"), 1u);
+}
+
+TEST(Iso9660, ScratchedDirectory_RestStillIndexed)
+{
+  std::vector<uint8_t> image = twoSessions();
+  test::HoleyDevice device(image, SECTOR, {221});
+  DiscReader reader(device);
+  DiscIndex index;
+  ASSERT_TRUE(indexIso9660(reader, index));
+  EXPECT_EQ(index.unreadable_sectors, 1u);
+  std::map<std::string, const DiscFile*> files = byPath(index);
+  EXPECT_EQ(files.count("charlie-new.txt"), 1u);
+  ASSERT_EQ(files.count("subdir"), 1u);
+  EXPECT_TRUE(files.at("subdir")->damaged);
+}
+
+TEST(Iso9660, NoDescriptor_ProbeFails)
+{
+  std::vector<uint8_t> image(100 * SECTOR, 0);
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  EXPECT_FALSE(probeIso9660(reader));
+  DiscIndex index;
+  EXPECT_FALSE(indexIso9660(reader, index));
+}
+
+}  // namespace
+}  // namespace rsn
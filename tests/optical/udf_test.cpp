@@ -0,0 +1,340 @@
+#include "optical/udf.h"
+
+#include "common/utils.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+constexpr size_t BLOCK = DISC_SECTOR_SIZE;
+
+void put16(std::string& out, size_t at, uint32_t value)
+{
+  out[at] = static_cast<char>(value & 0xFF);
+  out[at + 1] = static_cast<char>((value >> 8) & 0xFF);
+}
+
+void put32(std::string& out, size_t at, uint32_t value)
+{
+  put16(out, at, value & 0xFFFF);
+  put16(out, at + 2, value >> 16);
+}
+
+void put64(std::string& out, size_t at, uint64_t value)
+{
+  put32(out, at, static_cast<uint32_t>(value));
+  put32(out, at + 4, static_cast<uint32_t>(value >> 32));
+}
+
+std::string le32(uint32_t value)
+{
+  std::string out(4, '\0');
+  put32(out, 0, value);
+  return out;
+}
+
+uint16_t crcItu(const std::string& data)
+{
+  uint32_t crc = 0;
+  for (unsigned char byte : data)
+  {
+    crc ^= static_cast<uint32_t>(byte) << 8;
+    for (int bit = 0; bit < 8; ++bit)
+    {
+      crc = (crc & 0x8000) != 0 ? (crc << 1) ^ 0x1021 : crc << 1;
+      crc &= 0xFFFF;
+    }
+  }
+  return static_cast<uint16_t>(crc);
+}
+
+/// Fill in the descriptor tag; the CRC covers `length - 16` bytes of body.
+std::string tag(std::string buffer, uint32_t ident, uint32_t location, size_t length = 0)
+{
+  size_t body = (length != 0 ? length : buffer.size()) - 16;
+  put16(buffer, 0, ident);
+  put16(buffer, 2, 2);
+  put16(buffer, 6, 1);
+  put16(buffer, 8, crcItu(buffer.substr(16, body)));
+  put16(buffer, 10, static_cast<uint32_t>(body));
+  put32(buffer, 12, location);
+  buffer[4] = 0;
+  uint32_t sum = 0;
+  for (size_t k = 0; k < 16; ++k)
+  {
+    sum += static_cast<unsigned char>(buffer[k]);
+  }
+  buffer[4] = static_cast<char>(sum & 0xFF);
+  return buffer;
+}
+
+/// File entry; `type` 4 directory, 5 file, 248 VAT. `ad_type` 3 embeds data.
+std::string fileEntry(uint32_t location, int type, uint64_t size, const std::string& ads,
+                      int ad_type = 0)
+{
+  std::string b(BLOCK, '\0');
+  b[27] = static_cast<char>(type);
+  put16(b, 34, ad_type);
+  put64(b, 56, size);
+  put32(b, 168, 0);
+  put32(b, 172, static_cast<uint32_t>(ads.size()));
+  b.replace(176, ads.size(), ads);
+  return tag(b, 261, location, 176 + ads.size());
+}
+
+std::string shortAd(uint32_t length, uint32_t block)
+{
+  return le32(length) + le32(block);
+}
+
+/// File identifier; flags 0x02 directory, 0x04 deleted, 0x08 parent.
+std::string identifier(const std::string& name, uint32_t block, uint32_t partition = 0,
+                       int flags = 0)
+{
+  std::string encoded = name.empty() ? std::string() : "\x08" + name;
+  std::string b(38 + encoded.size(), '\0');
+  b[18] = static_cast<char>(flags);
+  b[19] = static_cast<char>(encoded.size());
+  put32(b, 20, BLOCK);
+  put32(b, 24, block);
+  put16(b, 28, partition);
+  b.replace(38, encoded.size(), encoded);
+  b.append((4 - b.size() % 4) % 4, '\0');
+  return tag(b, 257, 0);
+}
+
+std::string parent(uint32_t partition = 0)
+{
+  return identifier("", 1, partition, 0x0A);
+}
+
+/// A UDF volume: descriptor sequence at 32, anchor at 256, partition at `start`.
+class UdfImage
+{
+public:
+  UdfImage(uint32_t start, uint32_t length) : start_(start), bytes_((start + length) * BLOCK, 0)
+  {
+  }
+
+  void volume(const std::string& maps, uint32_t map_count, uint32_t length, uint32_t fsd_part)
+  {
+    std::string pd(BLOCK, '\0');
+    put32(pd, 188, start_);
+    put32(pd, 192, length);
+    sector(32, tag(pd, 5, 32, 512));
+    std::string lvd(BLOCK, '\0');
+    put32(lvd, 212, BLOCK);
+    put32(lvd, 248, BLOCK);
+    put32(lvd, 252, 0);
+    put16(lvd, 256, fsd_part);
+    put32(lvd, 264, static_cast<uint32_t>(maps.size()));
+    put32(lvd, 268, map_count);
+    lvd.replace(440, maps.size(), maps);
+    sector(33, tag(lvd, 6, 33, 440 + maps.size()));
+    sector(34, tag(std::string(BLOCK, '\0'), 8, 34, 512));
+    std::string anchor(BLOCK, '\0');
+    put32(anchor, 16, 16 * BLOCK);
+    put32(anchor, 20, 32);
+    put32(anchor, 24, 16 * BLOCK);
+    put32(anchor, 28, 48);
+    sector(256, tag(anchor, 2, 256, 512));
+  }
+
+  void fileSet(uint32_t block, uint32_t root, uint32_t partition)
+  {
+    std::string b(BLOCK, '\0');
+    put32(b, 400, BLOCK);
+    put32(b, 404, root);
+    put16(b, 408, partition);
+    put(block, tag(b, 256, 0, 512));
+  }
+
+  void put(uint32_t block, const std::string& data) { sector(start_ + block, data); }
+  std::vector<uint8_t>& bytes() { return bytes_; }
+
+private:
+  void sector(uint32_t lba, const std::string& data) { test::put(bytes_, lba * BLOCK, data); }
+
+  uint32_t start_;
+  std::vector<uint8_t> bytes_;
+};
+
+const std::string PHYSICAL_MAP("\x01\x06\x01\x00\x00\x00", 6);
+
+const std::string ALPHA = test::letters(3300, 11);
+const std::string BRAVO = "embedded bravo\n";
+const std::string GONE = test::letters(4000, 12);
+
+/// Physical partition: a file, a subdirectory with an embedded file, and a
+/// deleted identifier whose entry is intact.
+std::vector<uint8_t> physicalVolume()
+{
+  UdfImage img(300, 20);
+  img.volume(PHYSICAL_MAP, 1, 20, 0);
+  img.fileSet(0, 1, 0);
+  std::string root = parent() + identifier("a.txt", 5) + identifier("sub", 3, 0, 0x02) +
+                     identifier("gone.bin", 8, 0, 0x04);
+  img.put(1, fileEntry(1, 4, root.size(), shortAd(static_cast<uint32_t>(root.size()), 2)));
+  img.put(2, root);
+  std::string sub = parent() + identifier("b.txt", 7);
+  img.put(3, fileEntry(3, 4, sub.size(), shortAd(static_cast<uint32_t>(sub.size()), 4)));
+  img.put(4, sub);
+  img.put(5, fileEntry(5, 5, ALPHA.size(), shortAd(static_cast<uint32_t>(ALPHA.size()), 10)));
+  img.put(10, ALPHA);
+  img.put(7, fileEntry(7, 5, BRAVO.size(), BRAVO, 3));
+  img.put(8, fileEntry(8, 5, GONE.size(), shortAd(static_cast<uint32_t>(GONE.size()), 13)));
+  img.put(13, GONE);
+  return img.bytes();
+}
+
+std::string vat(const std::vector<uint32_t>& table, uint32_t previous)
+{
+  std::string header(152, '\0');
+  put16(header, 0, 152);
+  put32(header, 132, previous);
+  for (uint32_t entry : table)
+  {
+    header += le32(entry);
+  }
+  return header;
+}
+
+const std::string OLD = test::letters(1500, 13);
+const std::string NEW = test::letters(1920, 14);
+
+/// Write-once volume with two VAT generations; the second replaces old.txt.
+std::vector<uint8_t> virtualVolume()
+{
+  UdfImage img(300, 11);
+  std::string vmap(64, '\0');
+  vmap[0] = 2;
+  vmap[1] = 64;
+  vmap.replace(5, 22, "*UDF Virtual Partition");
+  put16(vmap, 36, 1);
+  img.volume(PHYSICAL_MAP + vmap, 2, 11, 1);
+  img.fileSet(0, 1, 1);
+  std::string root = parent(1) + identifier("old.txt", 3, 1);
+  img.put(1, fileEntry(1, 4, root.size(), shortAd(static_cast<uint32_t>(root.size()), 2)));
+  img.put(2, root);
+  img.put(3, fileEntry(3, 5, OLD.size(), shortAd(static_cast<uint32_t>(OLD.size()), 4)));
+  img.put(4, OLD);
+  std::string first = vat({0, 1, 2, 3, 4}, 0xFFFFFFFF);
+  img.put(5, fileEntry(5, 248, first.size(), first, 3));
+  root = parent(1) + identifier("new.txt", 5, 1);
+  img.put(7, root);
+  img.put(6, fileEntry(6, 4, root.size(), shortAd(static_cast<uint32_t>(root.size()), 2)));
+  img.put(8, fileEntry(8, 5, NEW.size(), shortAd(static_cast<uint32_t>(NEW.size()), 6)));
+  img.put(9, NEW);
+  std::string second = vat({0, 6, 7, 3, 4, 8, 9}, 5);
+  img.put(10, fileEntry(10, 248, second.size(), second, 3));
+  return img.bytes();
+}
+
+std::map<std::string, const DiscFile*> byPath(const DiscIndex& index)
+{
+  std::map<std::string, const DiscFile*> out;
+  for (const DiscFile& file : index.files)
+  {
+    out[file.path] = &file;
+  }
+  return out;
+}
+
+std::string contents(const std::vector<uint8_t>& image, const DiscFile& file)
+{
+  RecoveredFile recovered;
+  recovered.size = file.size;
+  recovered.extents = file.extents;
+  return test::extract(image, recovered);
+}
+
+TEST(Udf, PhysicalPartition_TreeIndexed)
+{
+  std::vector<uint8_t> image = physicalVolume();
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  ASSERT_TRUE(probeUdf(reader));
+  DiscIndex index;
+  ASSERT_TRUE(indexUdf(reader, index));
+  std::map<std::string, const DiscFile*> files = byPath(index);
+  ASSERT_EQ(files.size(), 4u);
+  EXPECT_EQ(contents(image, *files.at("a.txt")), ALPHA);
+  EXPECT_TRUE(files.at("sub")->directory);
+  EXPECT_EQ(contents(image, *files.at("sub/b.txt")), BRAVO);
+  EXPECT_TRUE(files.at("gone.bin")->deleted);
+  EXPECT_EQ(contents(image, *files.at("gone.bin")), GONE);
+}
+
+TEST(Udf, DeletedExcluded_WhenAsked)
+{
+  std::vector<uint8_t> image = physicalVolume();
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  UdfOptions options;
+  options.include_deleted = false;
+  DiscIndex index;
+  ASSERT_TRUE(indexUdf(reader, index, options));
+  EXPECT_EQ(byPath(index).count("gone.bin"), 0u);
+  EXPECT_EQ(index.files.size(), 3u);
+}
+
+TEST(Udf, VirtualPartition_EveryGenerationIndexed)
+{
+  std::vector<uint8_t> image = virtualVolume();
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  DiscIndex index;
+  ASSERT_TRUE(indexUdf(reader, index));
+  EXPECT_EQ(index.sessions.size(), 2u);
+  std::map<std::string, const DiscFile*> files = byPath(index);
+  ASSERT_EQ(files.size(), 2u);
+  EXPECT_EQ(files.at("new.txt")->session, 1u);
+  EXPECT_EQ(contents(image, *files.at("new.txt")), NEW);
+  EXPECT_EQ(files.at("old.txt")->session, 0u);
+  EXPECT_EQ(contents(image, *files.at("old.txt")), OLD);
+}
+
+TEST(Udf, UnknownTypeTwoMap_LaterMapKeepsItsNumber)
+{
+  UdfImage img(300, 8);
+  std::string unknown(64, '\0');
+  unknown[0] = 2;
+  unknown[1] = 64;
+  unknown.replace(5, 19, "*Vendor Private Map");
+  img.volume(unknown + PHYSICAL_MAP, 2, 8, 1);
+  img.fileSet(0, 1, 1);
+  std::string root = parent(1) + identifier("a.txt", 3, 1);
+  img.put(1, fileEntry(1, 4, root.size(), shortAd(static_cast<uint32_t>(root.size()), 2)));
+  img.put(2, root);
+  img.put(3, fileEntry(3, 5, ALPHA.size(), shortAd(static_cast<uint32_t>(ALPHA.size()), 4)));
+  img.put(4, ALPHA);
+  std::vector<uint8_t> image = img.bytes();
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  DiscIndex index;
+  ASSERT_TRUE(indexUdf(reader, index));
+  std::map<std::string, const DiscFile*> files = byPath(index);
+  ASSERT_EQ(files.size(), 1u);
+  EXPECT_EQ(contents(image, *files.at("a.txt")), ALPHA);
+}
+
+TEST(Udf, NoAnchor_ProbeFails)
+{
+  std::vector<uint8_t> image = physicalVolume();
+  std::fill(image.begin() + 256 * BLOCK, image.begin() + 257 * BLOCK, 0);
+  MemoryDevice device("disc", image.data(), image.size());
+  DiscReader reader(device);
+  EXPECT_FALSE(probeUdf(reader));
+}
+
+}  // namespace
+}  // namespace rsn
@@ -0,0 +1,144 @@
+#include "tape/ltfs_index.h"
+
+#include "tape/tape_test_support.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+const char LABEL[] = R"(<?xml version="1.0" encoding="UTF-8"?>
+<ltfslabel version="2.4.0">
+  <creator>test</creator>
+  <volumeuuid>30a91a08-daf1-4c6b-8bc5-5a5a5a5a5a5a</volumeuuid>
+  <location><partition>b</partition></location>
+  <partitions><index>a</index><data>b</data></partitions>
+  <blocksize>524288</blocksize>
+</ltfslabel>
+)";
+
+std::string index(uint64_t generation, const std::string& files)
+{
+  return R"(<?xml version="1.0" encoding="UTF-8"?>
+<ltfsindex version="2.4.0">
+  <volumeuuid>30a91a08-daf1-4c6b-8bc5-5a5a5a5a5a5a</volumeuuid>
+  <generationnumber>)" +
+         std::to_string(generation) + R"(</generationnumber>
+  <location><partition>a</partition><startblock>6</startblock></location>
+  <directory>
+    <name>root</name>
+    <contents>)" +
+         files + R"(</contents>
+  </directory>
+</ltfsindex>
+)";
+}
+
+std::string file(const std::string& name, uint64_t length, uint64_t uid,
+                 const std::string& extents, const std::string& extra = std::string())
+{
+  return "<file><name" + extra + ">" + name + "</name><length>" + std::to_string(length) +
+         "</length><fileuid>" + std::to_string(uid) + "</fileuid><extentinfo>" + extents +
+         "</extentinfo></file>";
+}
+
+std::string extent(uint64_t block, uint64_t offset, uint64_t count, uint64_t file_offset)
+{
+  return "<extent><fileoffset>" + std::to_string(file_offset) +
+         "</fileoffset><partition>b</partition><startblock>" + std::to_string(block) +
+         "</startblock><byteoffset>" + std::to_string(offset) + "</byteoffset><bytecount>" +
+         std::to_string(count) + "</bytecount></extent>";
+}
+
+const std::string TREE =
+  file("plain.txt", 100, 7, extent(4, 0, 100, 0)) +
+  "<directory><name>docs &amp; notes</name><contents>" +
+  file("split.bin", 3000, 8, extent(5, 0, 1000, 0) + extent(9, 24, 2000, 1000)) +
+  file("na%2Fme", 0, 9, "", " percentencoded=\"true\"") +
+  "<file><name>link</name><length>0</length><fileuid>10</fileuid>"
+  "<symlink>../plain.txt</symlink></file>"
+  "</contents></directory>" +
+  file("caf&#xE9; &#x1F600;.txt", 5, 11, extent(12, 0, 5, 0));
+
+TEST(ParseLtfsLabel, Fields_Read)
+{
+  LtfsLabel label;
+  ASSERT_TRUE(parseLtfsLabel(LABEL, sizeof(LABEL) - 1, label));
+  EXPECT_EQ(label.volume_uuid, "30a91a08-daf1-4c6b-8bc5-5a5a5a5a5a5a");
+  EXPECT_EQ(label.block_size, 524288u);
+  EXPECT_EQ(label.partition, 'b');
+  EXPECT_EQ(label.index_partition, 'a');
+  EXPECT_EQ(label.data_partition, 'b');
+}
+
+TEST(ParseLtfsIndex, NestedTree_Flattened)
+{
+  std::string xml = index(3, TREE);
+  LtfsIndex parsed;
+  ASSERT_TRUE(parseLtfsIndex(xml.data(), xml.size(), parsed));
+  EXPECT_EQ(parsed.generation, 3u);
+  EXPECT_EQ(parsed.partition, 'a');
+  EXPECT_EQ(parsed.start_block, 6u);
+  ASSERT_EQ(parsed.files.size(), 5u);
+  EXPECT_EQ(parsed.files[0].path, "plain.txt");
+  EXPECT_EQ(parsed.files[0].uid, 7u);
+  const LtfsFile& split = parsed.files[1];
+  EXPECT_EQ(split.path, "docs & notes/split.bin");
+  EXPECT_EQ(split.length, 3000u);
+  ASSERT_EQ(split.extents.size(), 2u);
+  EXPECT_EQ(split.extents[1].partition, 'b');
+  EXPECT_EQ(split.extents[1].start_block, 9u);
+  EXPECT_EQ(split.extents[1].byte_offset, 24u);
+  EXPECT_EQ(split.extents[1].byte_count, 2000u);
+  EXPECT_EQ(split.extents[1].file_offset, 1000u);
+  EXPECT_EQ(parsed.files[2].path, "docs & notes/na_me");
+  EXPECT_EQ(parsed.files[3].symlink, "../plain.txt");
+  EXPECT_EQ(parsed.files[4].path, "caf\xC3\xA9 \xF0\x9F\x98\x80.txt");
+}
+
+TEST(ParseLtfsIndex, Malformed_Rejected)
+{
+  std::string xml = index(3, TREE);
+  LtfsIndex parsed;
+  EXPECT_FALSE(parseLtfsIndex(xml.data(), xml.size() / 2, parsed));
+  std::string label(LABEL);
+  EXPECT_FALSE(parseLtfsIndex(label.data(), label.size(), parsed));
+}
+
+std::string vol1()
+{
+  std::string label = "VOL1ABC123" + std::string(70, ' ');
+  label.replace(24, 4, "LTFS");
+  return label;
+}
+
+TEST(FindLatestLtfsIndex, NewestGenerationOnPartition)
+{
+  test::SimhWriter writer;
+  writer.file(vol1(), 80);
+  writer.file(LABEL, 4096);
+  writer.file(index(1, file("old.txt", 3, 1, extent(4, 0, 3, 0))), 4096);
+  writer.file(test::letters(5000, 34), 4096);
+  writer.file(index(2, TREE), 4096);
+  std::vector<uint8_t> image = writer.finish();
+  MemoryDevice container("ltfs.tap", image.data(), image.size());
+  std::unique_ptr<TapeImageDevice> tape = TapeImageDevice::open(container);
+  ASSERT_NE(tape, nullptr);
+  LtfsLabel label;
+  ASSERT_TRUE(readLtfsLabel(*tape, label));
+  EXPECT_EQ(label.block_size, 524288u);
+  LtfsIndex latest;
+  ASSERT_TRUE(findLatestLtfsIndex(*tape, latest));
+  EXPECT_EQ(latest.generation, 2u);
+  EXPECT_EQ(latest.files.size(), 5u);
+}
+
+}  // namespace
+}  // namespace rsn
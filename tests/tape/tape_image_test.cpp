@@ -0,0 +1,64 @@
+#include "tape/tape_image.h"
+
+#include "tape/tape_test_support.h"
+#include "test_support.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace
+{
+
+TEST(TapeImageDevice, Simh_BlocksAndFilemarks)
+{
+  test::SimhWriter writer;
+  writer.file("first file, one block", 512);
+  std::string second = test::letters(1500, 31);
+  writer.file(second, 512);
+  std::vector<uint8_t> image = writer.finish();
+  MemoryDevice container("tape.tap", image.data(), image.size());
+  std::unique_ptr<TapeImageDevice> tape = TapeImageDevice::open(container);
+  ASSERT_NE(tape, nullptr);
+  EXPECT_EQ(tape->format(), TapeFormat::Simh);
+  EXPECT_FALSE(tape->truncated());
+  ASSERT_EQ(tape->files().size(), 2u);
+  EXPECT_EQ(tape->objects().size(), 6u);
+  EXPECT_EQ(tape->size(), 21u + second.size());
+  const TapeFile& file = tape->files()[1];
+  EXPECT_EQ(file.block_count, 3u);
+  EXPECT_EQ(file.first_block, 2u);
+  std::string read(static_cast<size_t>(file.length), '\0');
+  ASSERT_EQ(tape->read(file.offset, &read[0], read.size()), second.size());
+  EXPECT_EQ(read, second);
+  EXPECT_EQ(tape->blockOffset(3), file.offset + 512);
+  EXPECT_EQ(tape->blockOffset(100), UINT64_MAX);
+}
+
+TEST(TapeImageDevice, TornTail_Truncated)
+{
+  test::SimhWriter writer;
+  writer.file(test::letters(1000, 32), 512);
+  std::vector<uint8_t> image = writer.finish();
+  image.resize(image.size() - 4);
+  image.insert(image.end(), {0x00, 0x02, 0x00, 0x00, 'a', 'b'});
+  MemoryDevice container("tape.tap", image.data(), image.size());
+  std::unique_ptr<TapeImageDevice> tape = TapeImageDevice::open(container);
+  ASSERT_NE(tape, nullptr);
+  EXPECT_TRUE(tape->truncated());
+  EXPECT_EQ(tape->files().size(), 1u);
+}
+
+TEST(TapeImageDevice, NotTape_Null)
+{
+  std::vector<uint8_t> image = test::noise(4096, 33);
+  MemoryDevice container("noise", image.data(), image.size());
+  EXPECT_EQ(TapeImageDevice::open(container), nullptr);
+}
+
+}  // namespace
+}  // namespace rsn
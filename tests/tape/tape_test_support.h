@@ -0,0 +1,61 @@
+// RecoverySoftNetz — tape test helpers
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rsn
+{
+namespace test
+{
+
+/// Builds a SIMH .tap container: length-framed blocks, zero-word filemarks.
+class SimhWriter
+{
+public:
+  void block(const std::string& data, bool damaged = false)
+  {
+    uint32_t word = static_cast<uint32_t>(data.size()) | (damaged ? 0x80000000u : 0);
+    le32(word);
+    bytes_ += data;
+    if (data.size() % 2 != 0)
+    {
+      bytes_ += '\0';
+    }
+    le32(word);
+  }
+
+  /// `data` cut into blocks of `block_size`, then a filemark.
+  void file(const std::string& data, size_t block_size)
+  {
+    for (size_t at = 0; at < data.size(); at += block_size)
+    {
+      block(data.substr(at, block_size));
+    }
+    filemark();
+  }
+
+  void filemark() { le32(0); }
+
+  std::vector<uint8_t> finish()
+  {
+    le32(0xFFFFFFFF);
+    return std::vector<uint8_t>(bytes_.begin(), bytes_.end());
+  }
+
+private:
+  void le32(uint32_t value)
+  {
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+      bytes_ += static_cast<char>((value >> shift) & 0xFF);
+    }
+  }
+
+  std::string bytes_;
+};
+
+}  // namespace test
+}  // namespace rsn
@@ -0,0 +1,154 @@
+// RecoverySoftNetz — unit test helpers
+//
+// Carver tests build a device image in memory: deterministic noise with the
+// files under test written at chosen offsets, optionally split into pieces.
+// `carve` runs one stage over it on the real pipeline and `extract` reads a
+// registered entry back through its extents.
+
+#pragma once
+
+#include "core/carve_pipeline.h"
+#include "core/device.h"
+#include "core/file_registry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rsn
+{
+namespace test
+{
+
+inline std::vector<uint8_t> noise(size_t size, uint32_t seed = 1)
+{
+  std::vector<uint8_t> out(size);
+  std::mt19937 random(seed);
+  for (uint8_t& byte : out)
+  {
+    byte = static_cast<uint8_t>(random());
+  }
+  return out;
+}
+
+inline void put(std::vector<uint8_t>& image, uint64_t offset, const std::string& bytes)
+{
+  std::memcpy(image.data() + offset, bytes.data(), bytes.size());
+}
+
+inline void put(std::vector<uint8_t>& image, uint64_t offset, const std::vector<uint8_t>& bytes)
+{
+  std::memcpy(image.data() + offset, bytes.data(), bytes.size());
+}
+
+/// Memory device on which reads of the listed `unit`-sized sectors fail, as
+/// on scratched or worn media: a read stops short at the first of them.
+class HoleyDevice : public MemoryDevice
+{
+public:
+  HoleyDevice(const std::vector<uint8_t>& image, uint32_t unit, std::set<uint64_t> bad)
+    : MemoryDevice("holey", image.data(), image.size()), unit_(unit), bad_(std::move(bad))
+  {
+  }
+
+  size_t read(uint64_t offset, void* buffer, size_t length) override
+  {
+    for (uint64_t sector = offset / unit_; sector * unit_ < offset + length; ++sector)
+    {
+      if (bad_.count(sector) != 0)
+      {
+        size_t good = sector * unit_ > offset ? static_cast<size_t>(sector * unit_ - offset) : 0;
+        return MemoryDevice::read(offset, buffer, good);
+      }
+    }
+    return MemoryDevice::read(offset, buffer, length);
+  }
+
+private:
+  uint32_t unit_;
+  std::set<uint64_t> bad_;
+};
+
+/// Run `stage` alone over `image` and return what it registered.
+inline std::vector<RecoveredFile> carve(CarveStage& stage, const std::vector<uint8_t>& image,
+                                        size_t chunk_size = 256u << 10, unsigned threads = 2)
+{
+  MemoryDevice device("image", image.data(), image.size());
+  FileRegistry registry;
+  PipelineOptions options;
+  options.chunk_size = chunk_size;
+  options.threads = threads;
+  CarvePipeline pipeline(options);
+  pipeline.addStage(stage);
+  pipeline.run(device, registry);
+  return registry.snapshot();
+}
+
+/// The bytes of a registered entry, read through its extents.
+inline std::string extract(const std::vector<uint8_t>& image, const RecoveredFile& file)
+{
+  std::vector<Extent> extents = file.extents;
+  if (extents.empty())
+  {
+    extents.push_back(Extent{file.offset, file.size});
+  }
+  std::string out;
+  for (const Extent& extent : extents)
+  {
+    out.append(reinterpret_cast<const char*>(image.data() + extent.offset),
+               static_cast<size_t>(extent.length));
+  }
+  return out;
+}
+
+/// A zlib stream of stored DEFLATE blocks: valid Flate data, with an Adler-32
+/// trailer that catches misplaced bytes, without needing a compressor.
+inline std::string zlibStored(const std::string& data)
+{
+  std::string out("\x78\x01", 2);
+  size_t pos = 0;
+  do
+  {
+    size_t length = std::min<size_t>(data.size() - pos, 65535);
+    bool last = pos + length == data.size();
+    out += static_cast<char>(last ? 1 : 0);
+    out += static_cast<char>(length & 0xFF);
+    out += static_cast<char>(length >> 8);
+    out += static_cast<char>(~length & 0xFF);
+    out += static_cast<char>((~length >> 8) & 0xFF);
+    out.append(data, pos, length);
+    pos += length;
+  } while (pos < data.size());
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (unsigned char c : data)
+  {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  uint32_t adler = b << 16 | a;
+  for (int shift = 24; shift >= 0; shift -= 8)
+  {
+    out += static_cast<char>((adler >> shift) & 0xFF);
+  }
+  return out;
+}
+
+inline std::string letters(size_t size, uint32_t seed)
+{
+  std::string out(size, 'a');
+  std::mt19937 random(seed);
+  for (char& c : out)
+  {
+    c = static_cast<char>('a' + random() % 26);
+  }
+  return out;
+}
+
+}  // namespace test
+}  // namespace rsn